@@ -22,8 +22,41 @@ cbuffer SceneData : register(b1)
     float3 CameraPosition;
 };
 
+cbuffer MaterialConstants : register(b3)
+{
+    uint MaterialIndex;
+};
+
+// point lights binned per cluster on the CPU (ClusteredLighting)
+struct PointLight
+{
+    float3 Position;
+    float Radius;
+    float3 Color;
+    float Intensity;
+};
+
+cbuffer ClusterConstants : register(b5)
+{
+    float4 ViewDepth; // view-space depth = dot(float4(worldPos, 1), ViewDepth)
+    uint3 ClusterCount;
+    uint PointLightCount; // 0 = point lights disabled
+    float2 ClusterScale; // pixel -> cluster column/row
+    float DepthScale; // slice = log(depth) * DepthScale + DepthBias
+    float DepthBias;
+};
+
+StructuredBuffer<PointLight> PointLights : register(t1, space2);
+// [offset, count] per cluster, followed by the light indices
+StructuredBuffer<uint> ClusterLightLists : register(t2, space2);
+
 SamplerState smp : register(s0);
-Texture2D _MainTex : register(t0);
+// every texture SRV in the descriptor heap (bindless), or only the material's SRV
+// when the table is rebound per material. Set by the application; the default must match HANDLE_MAX (DescriptorHeap.h)
+#ifndef MATERIAL_TABLE_SIZE
+#define MATERIAL_TABLE_SIZE 512
+#endif
+Texture2D _Textures[MATERIAL_TABLE_SIZE] : register(t0, space1);
 
 inline float3 FresnelSchlick(float cosTheta, float3 F0)
 {
@@ -65,6 +98,37 @@ float GeometrySmith(float3 N, float3 V, float3 L, float roughness)
     return ggx1 * ggx2;
 }
 
+float3 EvaluateLight(float3 N, float3 V, float3 L, float3 F0, float3 albedo, float roughness, float metallic)
+{
+    float3 H = normalize(V + L);
+    
+    float NDF = DistributionGGX(N, H, roughness);
+    float G = GeometrySmith(N, V, L, roughness);
+    float3 F = FresnelSchlick(saturate(dot(H, V)), F0);
+    
+    float3 Ks = F;
+    float3 Kd = float3(1.0, 1.0, 1.0) - Ks;
+    Kd *= 1.0 - metallic;
+    
+    float esp = 1.0e-5;
+    float3 numerator = NDF * G * F;
+    float denominator = 4.0 * saturate(dot(N, V)) * saturate(dot(N, L)) + esp;
+    
+    float3 specular = numerator / denominator;
+    
+    float NdotL = saturate(dot(N, L));
+    return (Kd * albedo / PI + specular) * NdotL;
+}
+
+uint ClusterIndex(float4 svpos, float3 worldPos)
+{
+    float depth = max(dot(float4(worldPos, 1.0), ViewDepth), 1.0e-4);
+    uint3 cluster;
+    cluster.xy = min(uint2(svpos.xy * ClusterScale), ClusterCount.xy - 1);
+    cluster.z = (uint)clamp(log(depth) * DepthScale + DepthBias, 0.0, (float)(ClusterCount.z - 1));
+    return (cluster.z * ClusterCount.y + cluster.y) * ClusterCount.x + cluster.x;
+}
+
 float4 main(VSOutput input) : SV_TARGET
 {
     float roughness = 0.5;
@@ -81,27 +145,30 @@ float4 main(VSOutput input) : SV_TARGET
     for (int i = 0; i < LightCount; i++)
     {
         float3 L = normalize(Lights[i].Position - input.pos.xyz);
-        float3 H = normalize(V + L);
-        
-        float NDF = DistributionGGX(N, H, roughness);
-        float G = GeometrySmith(N, V, L, roughness);
-        float3 F = FresnelSchlick(saturate(dot(H, V)), F0);
-        
-        float3 Ks = F;
-        float3 Kd = float3(1.0, 1.0, 1.0) - Ks;
-        Kd *= 1.0 - metallic;
-        
-        float esp = 1.0e-5;
-        float3 numerator = NDF * G * F;
-        float denominator = 4.0 * saturate(dot(N, V)) * saturate(dot(N, L)) + esp;
-        
-        float3 specular = numerator / denominator;
-        
-        float NdotL = saturate(dot(N, L));
-        Lo += (Kd * albedo / PI + specular) * NdotL;
+        Lo += EvaluateLight(N, V, L, F0, albedo, roughness, metallic);
+    }
+    
+    // only the point lights binned into this pixel's cluster
+    if (PointLightCount > 0)
+    {
+        uint cluster = ClusterIndex(input.svpos, input.pos.xyz);
+        uint offset = ClusterLightLists[cluster * 2];
+        uint count = ClusterLightLists[cluster * 2 + 1];
+        for (uint j = 0; j < count; j++)
+        {
+            PointLight light = PointLights[ClusterLightLists[offset + j]];
+            float3 toLight = light.Position - input.pos.xyz;
+            float distance = length(toLight);
+            // windowed inverse square falloff: reaches 0 at Radius
+            float ratio = distance / light.Radius;
+            float window = saturate(1.0 - ratio * ratio * ratio * ratio);
+            float attenuation = window * window / (distance * distance + 1.0);
+            float3 radiance = light.Color * light.Intensity * attenuation;
+            Lo += EvaluateLight(N, V, toLight / max(distance, 1.0e-4), F0, albedo, roughness, metallic) * radiance;
+        }
     }
     
-    float3 color = Lo * _MainTex.Sample(smp, input.uv);
+    float3 color = Lo * _Textures[MaterialIndex].Sample(smp, input.uv);
     color = color / (color + float3(1.0, 1.0, 1.0));
     color = pow(color, float3(1.0 / 2.2, 1.0 / 2.2, 1.0 / 2.2));
     
@@ -1,5 +1,6 @@
 #pragma once
 #include <Windows.h>
+#include <string>
 
 const UINT WINDOW_WIDTH = 1920;
 const UINT WINDOW_HEIGHT = 1080;
@@ -9,5 +10,54 @@ extern float g_LastFrame;
 
 extern bool g_KeyStates[256];
 
+// コマンドライン引数で切り替える設定
+struct AppOptions
+{
+	bool UsePipelineCache = true; // --no-pipeline-cache で無効
+	std::wstring ShaderDirectory = L"."; // --shader-dir <dir> でHLSLのあるディレクトリを指定
+	double TargetFrameRate = 60.0; // --fps <n> で指定（0なら制限しない）
+	UINT FramesInFlight = 2; // --frames-in-flight <2～4> で同時に処理するフレーム数を指定
+	UINT RecordThreads = 4; // --record-threads <n> で描画の記録に使うスレッド数を指定（1ならメインスレッドだけ）
+	UINT JobThreads = 0; // --job-threads <n> でジョブシステムのスレッド数を指定（0ならコア数）
+	UINT JobStressRounds = 0; // --job-stress <n> で入れ子のParallelForとRunAfterの連鎖をn回実行して確かめ、終了する
+	UINT SortBenchmarkDraws = 0; // --sort-benchmark <n> で描画n個の並べ替えを計測して終了する
+	UINT NullFrameMeshes = 0; // --null-frame <n> でメッシュn個のフレームをヌルのバックエンドで記録して終了する
+	UINT InstanceCount = 1; // --instances <n> でモデルをn個並べる
+	UINT MovingObjectCount = 0; // --moving-objects <n> で並べたモデルのうちn個を毎フレーム回す（ヌルのフレームではn個の物体を動かす）
+	bool UseInstancing = true; // --no-instancing で同じメッシュもインスタンスごとに描画する
+	bool UseGpuCulling = false; // --gpu-culling でカリングと描画の発行をGPUで行う（ExecuteIndirect。--moving-objectsとは併用できない）
+	bool UseOcclusionCulling = false; // --occlusion-culling で手前の物体をCPUでラスタライズし、隠れている物体を描画しない
+	UINT OcclusionBenchmarkBlocks = 0; // --occlusion-benchmark <n> でn x n区画の街でオクルージョンカリングを計測して終了する
+	std::wstring SoftwareRenderPath; // --software-render <file> でテストのシーンをCPUで描いて時間を出力し、PNGとEXRに書き出して終了する
+	std::wstring SoftwareReferencePath; // --software-reference <file> でCPUで描いた画像を基準のEXRと比べる（違えば終了コード1）
+	UINT PointLightCount = 0; // --lights <n> でモデルの周りに点光源をn個置き、クラスターごとに振り分けて照らす
+	bool RunLightBenchmark = false; // --light-benchmark で点光源のクラスターへの振り分けを計測して終了する
+	UINT SceneGraphBenchmarkNodes = 0; // --scene-graph-benchmark <n> でノードn個のシーングラフの更新を計測して終了する
+	UINT EntityBenchmarkCount = 0; // --entity-benchmark <n> でエンティティn個のクエリとコマンドバッファを計測して終了する
+	bool RunStateTrackerTest = false; // --state-tracker-test でリソースの状態の追跡が出すバリアをデバイスなしで確かめて終了する
+	bool RunFramePacerTest = false; // --frame-pacer-test で偽の時計を使い、フレームの間隔の揃え方を確かめて終了する
+	bool RunFrameSchedulerTest = false; // --frame-scheduler-test でフェンスとGPUを模擬し、使用中のフレームスロットを再利用しないことを確かめて終了する
+	bool RunPipelineKeyTest = false; // --pipeline-key-test でパイプラインキャッシュのキーの作り方と引き当てを確かめて終了する
+	bool RunCommandListFilterTest = false; // --command-list-filter-test で記録するだけのリストを使い、状態の設定の重複を捨てる条件を確かめて終了する
+	bool RunRenderGraphTest = false; // --render-graph-test でレンダーグラフのパスの削除・バリア・メモリ配置を確かめて終了する
+	bool RunBenchmarkTest = false; // --benchmark-test で計測の結果のJSONの書き出しと読み戻しを確かめて終了する
+	bool RunDrawPartitionerTest = false; // --draw-partitioner-test で描画の分け方（決定性・釣り合い・最低の描画数）を確かめて終了する
+	bool RunShaderKeyTest = false; // --shader-key-test でシェーダーのキャッシュのキーが.hlsliやマクロの変更で変わることを確かめて終了する
+	bool RunBakeSimulation = false; // --bake-simulation で環境マップの焼き込みとキュー間の同期を模擬して終了する
+	std::wstring ProfilePath; // --profile <file> でCPUとGPUの区間を測り、Chromeのトレース形式で書き出す
+	UINT ProfileFrames = 300; // --profile-frames <n> で測るフレーム数を指定
+	std::wstring ProfileTestPath; // --profile-test <file> でデバイスを使わずに区間を記録して書き出し、終了する
+	std::wstring StatsPath = L"stats"; // --stats <file> でF2キーを押した時に統計の履歴を書き出す先を指定（拡張子は.csvと.json）
+	std::wstring StatsTestPath; // --stats-test <file> でデバイスを使わずに統計を集めて書き出し、終了する
+	bool RunStatsMonitor = false; // --stats-monitor で他のプロセスが共有メモリに公開している統計を出力し続ける
+	std::wstring BenchmarkPath; // --benchmark <file> でCPUの処理を計測してJSONに書き出し、終了する
+	std::wstring BenchmarkBaseline; // --benchmark-baseline <file> で計測の結果を基準のJSONと比べる
+	double BenchmarkThreshold = 10.0; // --benchmark-threshold <percent> で基準より何%遅くなったら回帰とするか
+	std::wstring BenchmarkFilter; // --benchmark-filter <text> で名前にtextを含む計測だけを実行する
+};
+
+extern AppOptions g_AppOptions;
+extern int g_ExitCode; // mainの戻り値（計測で回帰があれば1）
+
 void StartApp(const TCHAR* appName);
 void ProcessInput(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
\ No newline at end of file
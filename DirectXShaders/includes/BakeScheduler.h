@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+
+// 環境マップの焼き込みを計算キューで行う時の、結果の切り替えとキュー間で待つフェンス値を決める（デバイスを使わない）
+// 結果は2組を交互に使う。描画は表の組を読み、焼き込みは裏の組に書くので、焼き込みの間も描画キューは止まらない
+// - 焼き込みは、裏の組を最後に読んだフレームの完了を計算キュー側で待ってから始める
+// - 焼き込みの完了をCPUが確かめてから表と裏を入れ替えるので、描画キューは計算キューを待たない
+//   （最初の1回だけは読める組が無いので、描画キューが焼き込みの完了を待つ）
+// 計算キューで同時に走る焼き込みは1つだけにし、コマンドアロケーターを使い回せるようにする
+class BakeScheduler
+{
+public:
+	enum { TARGET_COUNT = 2 };
+	static const uint32_t NO_TARGET = 0xffffffff;
+
+	struct BakePlan
+	{
+		bool StartBake; // このフレームで焼き込みを計算キューに投げる
+		uint32_t Target; // 焼き込む組
+		uint64_t WaitValue; // 焼き込みの前に計算キューが待つ描画キューのフェンス値
+	};
+
+	// resourceReadyValue: 焼き込みで読み書きするリソースが使えるようになる描画キューのフェンス値
+	void Init(uint64_t resourceReadyValue);
+	void RequestBake() { m_IsRequested = true; }
+
+	// フレームの始めに、計算キューのフェンスの現在の値を渡す。終わった焼き込みを表にし、必要なら次の焼き込みを決める
+	BakePlan BeginFrame(uint64_t bakeCompletedValue);
+	// StartBakeの焼き込みを計算キューに投げたら、シグナルする値を渡す
+	void BakeSubmitted(uint64_t bakeFenceValue);
+	// このフレームで描画が読む組を返す（無ければNO_TARGET）。frameFenceValueはこのフレームがシグナルする値
+	// 描画キューが先に計算キューを待つ必要があれば、その値をpWaitValueに入れる（待たなくていいなら0）
+	uint32_t AcquireFront(uint64_t frameFenceValue, uint64_t* pWaitValue);
+
+	uint32_t FrontTarget() const { return m_Front; }
+	bool IsBaking() const { return m_InFlightTarget != NO_TARGET; }
+	uint32_t CompletedBakes() const { return m_CompletedBakes; }
+
+	// 描画キューと計算キューを模擬し、焼き込みの間も描画が止まらず、読み書きが重ならないことを確かめる
+	// 同じ焼き込みを描画キューで行った場合と比べて結果を出力する
+	// キューが止まる、焼き込み中の組を読む、最初のフレームの後に描画キューが待つ、焼き込みの回数が合わない場合は失敗
+	static bool RunSimulation();
+
+private:
+	bool m_IsRequested = false;
+	uint32_t m_Front = NO_TARGET;
+	uint32_t m_InFlightTarget = NO_TARGET;
+	uint64_t m_InFlightValue = 0;
+	uint64_t m_LastBakeValue = 0; // 最後に投げた焼き込みの値（これが終わるまで次を投げない）
+	uint64_t m_LastReadValues[TARGET_COUNT] = {}; // 各組を最後に読んだフレームの描画キューのフェンス値
+	uint32_t m_CompletedBakes = 0;
+};
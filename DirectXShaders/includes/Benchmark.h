@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// 1つの計測に渡す状態。while (state.KeepRunning()) の中を決められた回数だけ繰り返し、その時間を測る
+// 入力の準備など測りたくない処理はPauseTimingとResumeTimingで挟む
+class BenchmarkState
+{
+public:
+	explicit BenchmarkState(uint64_t iterations) : m_Remaining(iterations) {}
+
+	bool KeepRunning()
+	{
+		if (!m_IsStarted)
+		{
+			m_IsStarted = true;
+			m_Begin = Now();
+		}
+		if (m_Remaining > 0)
+		{
+			m_Remaining--;
+			return true;
+		}
+		m_Elapsed += Now() - m_Begin;
+		return false;
+	}
+
+	void PauseTiming() { m_Elapsed += Now() - m_Begin; }
+	void ResumeTiming() { m_Begin = Now(); }
+
+	// 全ての繰り返しで処理した数（1秒あたりの数として出力する）
+	void SetItemsProcessed(int64_t items) { m_Items = items; }
+
+	int64_t Elapsed() const { return m_Elapsed; } // ナノ秒
+	int64_t Items() const { return m_Items; }
+
+private:
+	static int64_t Now();
+
+	uint64_t m_Remaining;
+	bool m_IsStarted = false;
+	int64_t m_Begin = 0;
+	int64_t m_Elapsed = 0;
+	int64_t m_Items = 0;
+};
+
+// CPUの処理の計測をまとめて実行し、JSONに書き出す。デバイスもウィンドウも使わない
+// 入力は全て固定の種から作るので、同じビルドなら毎回同じ処理を測る
+// 基準のJSONを渡すと同じ名前の計測と比べ、閾値より遅くなったものを回帰として出力する
+class Benchmark
+{
+public:
+	using Function = std::function<void(BenchmarkState&)>;
+
+	struct Result
+	{
+		std::string Name;
+		uint64_t Iterations;
+		double MedianTime; // 1回あたりのナノ秒（繰り返しの中央値）
+		double MinTime;
+		double MaxTime;
+		double ItemsPerSecond; // 数えていなければ0
+	};
+
+	static void Register(const std::string& name, Function function);
+	// エンジンの計測を登録する（BenchmarkCases.cpp）
+	static void RegisterEngineCases();
+
+	// nameにfilterを含む計測を実行する（空なら全て）
+	static std::vector<Result> Run(const std::string& filter);
+	static bool WriteJson(std::ostream& out, const std::vector<Result>& results);
+	static bool ReadJson(const std::filesystem::path& path, std::vector<Result>* pResults);
+	// 空白や改行、キーの順番によらずに読む（整形し直した基準のファイルも読める）。知らないキーは読み飛ばす
+	static bool ParseJson(const std::string& text, std::vector<Result>* pResults);
+	// 基準より閾値（0.1なら10%）を超えて遅くなった計測があればfalse（中央値と最小値の両方で比べる）
+	static bool Compare(const std::vector<Result>& results, const std::vector<Result>& baseline, double threshold);
+
+	// エンジンの計測を実行してoutputに書き出し、baselineがあれば比べる。回帰があればfalse
+	static bool RunSuite(const std::filesystem::path& output, const std::filesystem::path& baseline, double threshold, const std::string& filter);
+
+	// 書き出したJSONと、それを整形し直したものを読み戻して同じ結果になること、壊れたJSONを読まないことを確かめる
+	static bool RunTest();
+};
@@ -20,7 +20,7 @@ Camera::Camera(float posX, float posY, float posZ, float upX, float upY, float u
 	updateCameraVectors();
 }
 
-DirectX::CXMMATRIX Camera::GetViewMatrix() const
+DirectX::XMMATRIX Camera::GetViewMatrix() const
 {
 	auto posVecotor = DirectX::XMLoadFloat3(&m_Position);
 	auto frontVector = DirectX::XMVectorAdd(DirectX::XMLoadFloat3(&m_Position), DirectX::XMLoadFloat3(&m_Front));
@@ -74,6 +74,7 @@ void Camera::ProcessKeyboard(CameraMovement direction, float deltaTime)
 	}
 
 	DirectX::XMStoreFloat3(&m_Position, position);
+	m_Version++;
 }
 
 void Camera::ProcessMouseMovement(float xOffset, float yOffset, bool constrainPitch)
@@ -100,6 +101,7 @@ void Camera::ProcessMouseScroll(float yOffset)
 		m_Zoom = 1.0f;
 	if (m_Zoom >= 45.0f)
 		m_Zoom = 45.0f;
+	m_Version++;
 }
 
 DirectX::XMFLOAT3 Camera::GetCameraPosition()
@@ -126,4 +128,5 @@ void Camera::updateCameraVectors()
 	
 	up = DirectX::XMVector3Normalize(up);
 	DirectX::XMStoreFloat3(&m_Up, up);
+	m_Version++;
 }
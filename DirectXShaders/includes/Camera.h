@@ -1,6 +1,7 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <cstdint>
 
 enum CameraMovement
 {
@@ -19,8 +20,10 @@ class Camera
 public:
 	Camera(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 up, float yaw, float pitch);
 	Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch);
-	DirectX::CXMMATRIX GetViewMatrix() const;
+	DirectX::XMMATRIX GetViewMatrix() const;
 	float GetZoom() const { return m_Zoom; }
+	// 位置、向き、ズームを変えるたびに増える（変わっていなければ行列を作り直さなくていい）
+	uint32_t GetVersion() const { return m_Version; }
 	void ProcessKeyboard(CameraMovement direction, float deltaTime);
 	void ProcessMouseMovement(float xOffset, float yOffset, bool constrainPitch = true);
 	void ProcessMouseScroll(float yOffset);
@@ -37,6 +40,7 @@ private:
 	float m_MovementSpeed;
 	float m_MouseSensitivity;
 	float m_Zoom;
+	uint32_t m_Version = 0;
 
 	void updateCameraVectors();
 };
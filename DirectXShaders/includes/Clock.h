@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+
+// 時刻の取得と待機の抽象。時刻はナノ秒
+// FramePacerはこれを通してしか時間に触らないので、偽の時計に差し替えて確かめられる
+class Clock
+{
+public:
+	virtual ~Clock() = default;
+
+	virtual int64_t Now() = 0;
+	// timeの少し前まで眠る。OSのタイマー精度によっては多少過ぎることがある
+	virtual void SleepUntil(int64_t time) = 0;
+};
+
+// 実際の時計。Windowsでは高精度のWaitable Timerで眠る
+class SystemClock : public Clock
+{
+public:
+	SystemClock();
+	~SystemClock() override;
+
+	int64_t Now() override;
+	void SleepUntil(int64_t time) override;
+
+	// Now()と同じ時計の時刻。オブジェクトを作らずに読める（Profilerなど）
+	static int64_t Timestamp();
+#ifdef _WIN32
+	// QueryPerformanceCounterの値をTimestamp()と同じナノ秒に直す（GPUの時刻合わせに使う）
+	static int64_t CounterToNanoseconds(int64_t counter);
+#endif
+
+	SystemClock(const SystemClock&) = delete;
+	void operator = (const SystemClock&) = delete;
+
+private:
+	void* m_hTimer = nullptr;
+};
+
+// テスト用の偽の時計。Now()を呼ぶたびにstepだけ進む（スピンの待ちが終わるように）
+// SleepUntilは指定の時刻からoversleepだけ過ぎて起きる（OSのタイマーの遅れを模擬する）
+class FakeClock : public Clock
+{
+public:
+	explicit FakeClock(int64_t step = 1000, int64_t oversleep = 0)
+		: m_Step(step), m_Oversleep(oversleep)
+	{
+	}
+
+	int64_t Now() override
+	{
+		m_Time += m_Step;
+		return m_Time;
+	}
+
+	void SleepUntil(int64_t time) override
+	{
+		if (time + m_Oversleep > m_Time)
+		{
+			m_Time = time + m_Oversleep;
+		}
+		m_SleepCount++;
+	}
+
+	// フレームの処理にかかった時間だけ進める
+	void Advance(int64_t time) { m_Time += time; }
+	void SetOversleep(int64_t oversleep) { m_Oversleep = oversleep; }
+	int64_t Time() const { return m_Time; }
+	uint32_t SleepCount() const { return m_SleepCount; }
+
+private:
+	int64_t m_Time = 1000000000; // 0は「まだ無い」の意味で使われるので1秒から始める
+	int64_t m_Step;
+	int64_t m_Oversleep;
+	uint32_t m_SleepCount = 0;
+};
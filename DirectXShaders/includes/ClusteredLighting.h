@@ -0,0 +1,112 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 点光源。PBR.hlslのPointLightと同じ並び（32バイト）
+struct PointLight
+{
+	float Position[3]; // ワールド空間
+	float Radius; // 光の届く距離（ここで0になるように減衰させる）
+	float Color[3];
+	float Intensity;
+};
+
+// PBR.hlslのClusterConstants（b5）と同じ並び
+struct alignas(256) ClusterConstants
+{
+	float ViewDepth[4]; // カメラの前を正とするビュー空間の深度 = dot(float4(ワールド座標, 1), ViewDepth)
+	uint32_t ClusterCount[3];
+	uint32_t LightCount; // 0なら点光源を使わない（SceneDataのLightsだけで照らす）
+	float ClusterScale[2]; // 画素の座標に掛けるとクラスターの列と行になる
+	float DepthScale; // スライス = log(深度) * DepthScale + DepthBias
+	float DepthBias;
+};
+
+// 視錐台を画面のタイルと深度のスライスで区切ったクラスター（froxel）ごとに、届く点光源の番号を並べる（クラスターシェーディング）
+// スライスは近い面から遠い面まで指数的に厚くする。グリッドは射影行列から作り、ピクセルシェーダーは自分のクラスターのライトだけを回す
+//   1. ライトをビュー空間に移し、SSE2で4個ずつ、タイルの分割面と深度の境目との距離から掛かる列、行、スライスを求める（ジョブで並列）
+//   2. スライスごとのジョブで、掛かる列と行のクラスターの箱（ビュー空間のAABB）と球を比べ、クラスターの並びに足す
+//   3. クラスターごとの並びを1本に詰める。GPUには「クラスターごとの(先頭, 数)」の後に「ライトの番号」が続く1つのバッファで渡す
+// ライトが入るのは「球が列、行、スライスの境目の内側に掛かり、かつクラスターの箱に掛かる」時。並びの中はライトの番号の順
+// 行列はXMFLOAT4X4と同じ並びの行ベクトル（v * M）とする。デバイスを使わないので、Windows以外でも動く
+class ClusteredLighting
+{
+public:
+	// 分割数は境目の位置を浮動小数点で求める式にも入るので、列挙子にはしない
+	static constexpr int CLUSTER_X = 16;
+	static constexpr int CLUSTER_Y = 9;
+	static constexpr int CLUSTER_Z = 24;
+	static constexpr int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+	static constexpr size_t LIGHT_GRAIN = 1024; // 1のジョブ1つで変換するライトの数
+
+	struct Stats
+	{
+		uint32_t LightCount;
+		uint32_t VisibleLights; // 列、行、スライスの判定で視錐台に掛かったライト
+		uint32_t IndexCount; // ライトの番号の数（クラスターの並びの合計）
+		uint32_t MaxClusterLights; // 1つのクラスターに入った最大の数
+		uint32_t OccupiedClusters; // ライトが1つ以上入ったクラスター
+		double TransformTime; // 1の時間（ミリ秒）
+		double BinTime; // 2と3の時間
+	};
+
+	// 画面の大きさと射影（XMMatrixPerspectiveFovRHかLH）からグリッドを作る。前と同じなら何もしない
+	void Init(uint32_t width, uint32_t height, const float projection[16]);
+	// ライトをクラスターに振り分ける。parallelならジョブシステムで並列に行う
+	void Build(const float view[16], const PointLight* lights, uint32_t lightCount, bool parallel = true);
+
+	// 最後のBuildの定数とバッファ（先頭のCLUSTER_COUNT * 2個がクラスターごとの先頭と数で、先頭はバッファの頭からの位置）
+	ClusterConstants MakeConstants() const;
+	const std::vector<uint32_t>& Lists() const { return m_Lists; }
+	const Stats& GetStats() const { return m_Stats; }
+
+	// 全てのクラスターと全てのライトの組を1つずつ調べた結果と、最後のBuildの結果が一致すればtrue（遅い）
+	bool Validate(const PointLight* lights, uint32_t lightCount) const;
+
+	// ライトが1000個、1万個、10万個の時の振り分けの時間を並列と1スレッドで測り、総当たりの結果と比べる
+	static bool RunBenchmark(int iterations);
+	// 計測用のライトとカメラ。ライトはカメラの前の地面の上にばらまき、数が増えるほど広い範囲に置く（密度は同じ）
+	static void MakeTestLights(uint32_t count, uint32_t seed, std::vector<PointLight>& lights);
+	static void MakeTestCamera(float view[16], float projection[16]);
+
+private:
+	// ビュー空間のライトと、掛かる列、行、スライスのビット
+	struct LightBounds
+	{
+		float Center[3]; // x, y, 深度
+		float Radius;
+		uint32_t Columns;
+		uint32_t Rows;
+		uint32_t Slices;
+	};
+
+	struct Box
+	{
+		float Min[3];
+		float Max[3];
+	};
+
+	void TransformLights(const PointLight* lights, uint32_t begin, uint32_t end);
+	void TransformLight(const PointLight& light, LightBounds* pBounds) const;
+	void BinSlice(uint32_t slice);
+	bool Overlaps(const float center[3], float radius, uint32_t x, uint32_t y, uint32_t z) const;
+	static bool SphereIntersectsBox(const float center[3], float radius, const Box& box);
+
+	uint32_t m_Width = 0;
+	uint32_t m_Height = 0;
+	float m_Projection[16] = {};
+	float m_DepthSign = 1.0f; // 右手系の射影ならビュー空間のzを反転して深度にする
+	float m_PlanesX[CLUSTER_X + 1][2]; // 列の境目の面（xと深度の係数、正規化済み）。正なら境目より右
+	float m_PlanesY[CLUSTER_Y + 1][2]; // 行の境目の面（yと深度の係数）。正なら境目より上
+	float m_SliceDepths[CLUSTER_Z + 1];
+	std::vector<Box> m_Boxes; // クラスターごとのビュー空間の箱
+
+	float m_View[16] = {};
+	uint32_t m_LightCount = 0;
+	std::vector<LightBounds> m_Bounds;
+	std::vector<std::vector<uint32_t>> m_SliceLights; // スライスごとに、掛かるライトの番号
+	std::vector<std::vector<uint32_t>> m_ClusterLights; // クラスターごとの並び（フレームをまたいで使い回す）
+	std::vector<uint32_t> m_Lists;
+	Stats m_Stats = {};
+};
@@ -0,0 +1,338 @@
+#pragma once
+#include "Rhi.h"
+#include <climits>
+#include <cstdint>
+
+// コマンドリストに設定済みの状態を覚えておき、何も変えない呼び出しを捨てる薄いラッパー
+// TはID3D12GraphicsCommandListと同じ名前と引数のメソッドを持つ型（既定はRhiBackendのリスト。ヌルのバックエンドのリストにも差し替えられる）
+// ルートシグネチャやヒープはバックエンドごとに型が違うので、同じものかどうかはポインタの値だけで比べる
+// 状態を変える呼び出しは全てこのラッパーを通すこと。通さずに変えた後や、リストをResetした後はInvalidateを呼ぶ
+template<typename T = RhiBackend::CommandList>
+class CommandListFilter
+{
+public:
+	enum
+	{
+		MAX_ROOT_PARAMETERS = 64,
+		MAX_VERTEX_BUFFERS = RHI_MAX_VERTEX_BUFFERS,
+		MAX_RENDER_TARGETS = RHI_MAX_RENDER_TARGETS,
+		MAX_DESCRIPTOR_HEAPS = 2, // CBV/SRV/UAVとサンプラー
+	};
+
+	explicit CommandListFilter(T* commandList) : m_pCommandList(commandList)
+	{
+		Invalidate();
+	}
+
+	T* Get() const { return m_pCommandList; }
+
+	// 覚えている状態を全て忘れる（次の設定は必ず発行される）
+	void Invalidate()
+	{
+		m_HasRootSignature = false;
+		m_HasPipelineState = false;
+		m_HasTopology = false;
+		m_HasIndexBuffer = false;
+		m_HasRenderTargets = false;
+		m_DescriptorHeapCount = UINT_MAX;
+		InvalidateRootArguments();
+		for (auto& hasView : m_HasVertexBuffers)
+		{
+			hasView = false;
+		}
+	}
+
+	uint32_t IssuedCount() const { return m_Issued; }
+	uint32_t ElidedCount() const { return m_Elided; }
+	void ResetCounts() { m_Issued = 0; m_Elided = 0; }
+
+	// 状態の設定 ------------------------------------------------------------------------------
+	template<typename RootSignature>
+	void SetGraphicsRootSignature(RootSignature* pRootSignature)
+	{
+		if (m_HasRootSignature && m_pRootSignature == pRootSignature)
+		{
+			m_Elided++;
+			return;
+		}
+
+		// ルートシグネチャが変わるとルート引数は全て無効になる
+		m_pRootSignature = pRootSignature;
+		m_HasRootSignature = true;
+		InvalidateRootArguments();
+		Issue();
+		m_pCommandList->SetGraphicsRootSignature(pRootSignature);
+	}
+
+	template<typename PipelineState>
+	void SetPipelineState(PipelineState* pPipelineState)
+	{
+		if (m_HasPipelineState && m_pPipelineState == pPipelineState)
+		{
+			m_Elided++;
+			return;
+		}
+
+		m_pPipelineState = pPipelineState;
+		m_HasPipelineState = true;
+		Issue();
+		m_pCommandList->SetPipelineState(pPipelineState);
+	}
+
+	template<typename DescriptorHeap>
+	void SetDescriptorHeaps(UINT count, DescriptorHeap* const* ppHeaps)
+	{
+		bool same = count == m_DescriptorHeapCount;
+		for (UINT i = 0; i < count && same; i++)
+		{
+			same = m_pDescriptorHeaps[i] == ppHeaps[i];
+		}
+		if (same)
+		{
+			m_Elided++;
+			return;
+		}
+
+		// ヒープが変わると、前のヒープを指していたテーブルは使えない
+		m_DescriptorHeapCount = count <= MAX_DESCRIPTOR_HEAPS ? count : UINT_MAX;
+		for (UINT i = 0; i < count && i < MAX_DESCRIPTOR_HEAPS; i++)
+		{
+			m_pDescriptorHeaps[i] = ppHeaps[i];
+		}
+		for (auto& argument : m_RootArguments)
+		{
+			if (argument.Kind == ROOT_TABLE)
+			{
+				argument.Kind = ROOT_UNKNOWN;
+			}
+		}
+		Issue();
+		m_pCommandList->SetDescriptorHeaps(count, ppHeaps);
+	}
+
+	void SetGraphicsRootConstantBufferView(UINT index, RhiGpuAddress address)
+	{
+		if (SetRootArgument(index, ROOT_CBV, address))
+		{
+			m_pCommandList->SetGraphicsRootConstantBufferView(index, address);
+		}
+	}
+
+	void SetGraphicsRootShaderResourceView(UINT index, RhiGpuAddress address)
+	{
+		if (SetRootArgument(index, ROOT_SRV, address))
+		{
+			m_pCommandList->SetGraphicsRootShaderResourceView(index, address);
+		}
+	}
+
+	void SetGraphicsRootDescriptorTable(UINT index, RhiGpuDescriptor handle)
+	{
+		if (SetRootArgument(index, ROOT_TABLE, handle.ptr))
+		{
+			m_pCommandList->SetGraphicsRootDescriptorTable(index, handle);
+		}
+	}
+
+	// 同じパラメーターでは最後に設定したオフセットの値だけを覚える
+	void SetGraphicsRoot32BitConstant(UINT index, UINT value, UINT offset)
+	{
+		if (SetRootArgument(index, ROOT_CONSTANT, (static_cast<uint64_t>(offset) << 32) | value))
+		{
+			m_pCommandList->SetGraphicsRoot32BitConstant(index, value, offset);
+		}
+	}
+
+	void IASetPrimitiveTopology(RhiPrimitiveTopology topology)
+	{
+		if (m_HasTopology && m_Topology == topology)
+		{
+			m_Elided++;
+			return;
+		}
+
+		m_Topology = topology;
+		m_HasTopology = true;
+		Issue();
+		m_pCommandList->IASetPrimitiveTopology(topology);
+	}
+
+	// pViewsがnullptrならスロットを外す
+	void IASetVertexBuffers(UINT startSlot, UINT count, const RhiVertexBufferView* pViews)
+	{
+		bool same = startSlot + count <= MAX_VERTEX_BUFFERS;
+		for (UINT i = 0; i < count && same; i++)
+		{
+			auto view = pViews != nullptr ? pViews[i] : RhiVertexBufferView{};
+			same = m_HasVertexBuffers[startSlot + i] && Equal(m_VertexBuffers[startSlot + i], view);
+		}
+		if (same)
+		{
+			m_Elided++;
+			return;
+		}
+
+		for (UINT i = 0; i < count && startSlot + i < MAX_VERTEX_BUFFERS; i++)
+		{
+			m_VertexBuffers[startSlot + i] = pViews != nullptr ? pViews[i] : RhiVertexBufferView{};
+			m_HasVertexBuffers[startSlot + i] = true;
+		}
+		Issue();
+		m_pCommandList->IASetVertexBuffers(startSlot, count, pViews);
+	}
+
+	void IASetIndexBuffer(const RhiIndexBufferView* pView)
+	{
+		auto view = pView != nullptr ? *pView : RhiIndexBufferView{};
+		if (m_HasIndexBuffer && Equal(m_IndexBuffer, view))
+		{
+			m_Elided++;
+			return;
+		}
+
+		m_IndexBuffer = view;
+		m_HasIndexBuffer = true;
+		Issue();
+		m_pCommandList->IASetIndexBuffer(pView);
+	}
+
+	void OMSetRenderTargets(UINT count, const RhiCpuDescriptor* pRtvs, BOOL singleHandleToRange,
+		const RhiCpuDescriptor* pDsv)
+	{
+		// 連続した範囲の場合は先頭のハンドルだけを見る
+		auto handleCount = singleHandleToRange ? (count > 0 ? 1u : 0u) : count;
+		bool same = m_HasRenderTargets && count <= MAX_RENDER_TARGETS
+			&& m_RenderTargetCount == count
+			&& m_SingleHandleToRange == (singleHandleToRange != FALSE)
+			&& m_HasDepthStencil == (pDsv != nullptr)
+			&& (pDsv == nullptr || m_DepthStencil.ptr == pDsv->ptr);
+		for (UINT i = 0; i < handleCount && same; i++)
+		{
+			same = m_RenderTargets[i].ptr == pRtvs[i].ptr;
+		}
+		if (same)
+		{
+			m_Elided++;
+			return;
+		}
+
+		m_HasRenderTargets = count <= MAX_RENDER_TARGETS;
+		m_RenderTargetCount = count;
+		m_SingleHandleToRange = singleHandleToRange != FALSE;
+		m_HasDepthStencil = pDsv != nullptr;
+		m_DepthStencil = pDsv != nullptr ? *pDsv : RhiCpuDescriptor{};
+		for (UINT i = 0; i < handleCount && i < MAX_RENDER_TARGETS; i++)
+		{
+			m_RenderTargets[i] = pRtvs[i];
+		}
+		Issue();
+		m_pCommandList->OMSetRenderTargets(count, pRtvs, singleHandleToRange, pDsv);
+	}
+
+	// 状態を持たない呼び出し（そのまま発行して数える） ----------------------------------------
+	void DrawInstanced(UINT vertexCount, UINT instanceCount, UINT startVertex, UINT startInstance)
+	{
+		Issue();
+		m_pCommandList->DrawInstanced(vertexCount, instanceCount, startVertex, startInstance);
+	}
+
+	void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+	{
+		Issue();
+		m_pCommandList->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+	}
+
+	CommandListFilter(const CommandListFilter&) = delete;
+	void operator = (const CommandListFilter&) = delete;
+
+	// 何も変えない呼び出しを捨て、ルートシグネチャやヒープを変えた後の呼び出しは残すことを、
+	// 記録されたコマンドの並びで確かめる。記録するリストが要るので、ヌルのバックエンドのリストだけで定義する
+	static bool RunTest();
+
+private:
+	enum RootArgumentKind
+	{
+		ROOT_UNKNOWN,
+		ROOT_CBV,
+		ROOT_SRV,
+		ROOT_TABLE,
+		ROOT_CONSTANT,
+	};
+
+	struct RootArgument
+	{
+		RootArgumentKind Kind;
+		uint64_t Value;
+	};
+
+	static bool Equal(const RhiVertexBufferView& a, const RhiVertexBufferView& b)
+	{
+		return a.BufferLocation == b.BufferLocation && a.SizeInBytes == b.SizeInBytes && a.StrideInBytes == b.StrideInBytes;
+	}
+
+	static bool Equal(const RhiIndexBufferView& a, const RhiIndexBufferView& b)
+	{
+		return a.BufferLocation == b.BufferLocation && a.SizeInBytes == b.SizeInBytes && a.Format == b.Format;
+	}
+
+	void Issue() { m_Issued++; }
+
+	void InvalidateRootArguments()
+	{
+		for (auto& argument : m_RootArguments)
+		{
+			argument.Kind = ROOT_UNKNOWN;
+		}
+	}
+
+	// 値が変わる（発行が必要な）場合はtrue
+	bool SetRootArgument(UINT index, RootArgumentKind kind, uint64_t value)
+	{
+		if (index >= MAX_ROOT_PARAMETERS)
+		{
+			Issue();
+			return true;
+		}
+
+		auto& argument = m_RootArguments[index];
+		if (argument.Kind == kind && argument.Value == value)
+		{
+			m_Elided++;
+			return false;
+		}
+
+		argument.Kind = kind;
+		argument.Value = value;
+		Issue();
+		return true;
+	}
+
+	T* m_pCommandList;
+	uint32_t m_Issued = 0;
+	uint32_t m_Elided = 0;
+
+	bool m_HasRootSignature;
+	const void* m_pRootSignature = nullptr;
+	bool m_HasPipelineState;
+	const void* m_pPipelineState = nullptr;
+	UINT m_DescriptorHeapCount; // UINT_MAXなら不明
+	const void* m_pDescriptorHeaps[MAX_DESCRIPTOR_HEAPS] = {};
+	RootArgument m_RootArguments[MAX_ROOT_PARAMETERS] = {};
+
+	bool m_HasTopology;
+	RhiPrimitiveTopology m_Topology = RHI_TOPOLOGY_UNDEFINED;
+	bool m_HasVertexBuffers[MAX_VERTEX_BUFFERS];
+	RhiVertexBufferView m_VertexBuffers[MAX_VERTEX_BUFFERS] = {};
+	bool m_HasIndexBuffer;
+	RhiIndexBufferView m_IndexBuffer = {};
+
+	bool m_HasRenderTargets;
+	UINT m_RenderTargetCount = 0;
+	bool m_SingleHandleToRange = false;
+	RhiCpuDescriptor m_RenderTargets[MAX_RENDER_TARGETS] = {};
+	bool m_HasDepthStencil = false;
+	RhiCpuDescriptor m_DepthStencil = {};
+};
+
+template<>
+bool CommandListFilter<NullCommandList>::RunTest();
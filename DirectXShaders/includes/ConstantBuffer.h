@@ -1,13 +1,15 @@
 #pragma once
-#include <d3dx12.h>
-#include "ComPtr.h"
+#include "Rhi.h"
 
-class ConstantBuffer
+// Backendは描画APIのバックエンド（Rhi.h）
+template<typename Backend>
+class BasicConstantBuffer
 {
 public:
-	ConstantBuffer(size_t size);
-	D3D12_GPU_VIRTUAL_ADDRESS GetAddress() const;
-	D3D12_CONSTANT_BUFFER_VIEW_DESC ViewDesc() const;
+	BasicConstantBuffer(size_t size);
+	~BasicConstantBuffer();
+	RhiGpuAddress GetAddress() const;
+	RhiConstantBufferViewDesc ViewDesc() const;
 	bool IsValid();
 
 	void* GetPtr() const;
@@ -18,13 +20,15 @@ public:
 		return reinterpret_cast<T*>(GetPtr());
 	}
 
-	ConstantBuffer(const ConstantBuffer&) = delete;
-	void operator = (const ConstantBuffer&) = delete;
+	BasicConstantBuffer(const BasicConstantBuffer&) = delete;
+	void operator = (const BasicConstantBuffer&) = delete;
 
 private:
 	bool m_IsValid = false;
-	ComPtr<ID3D12Resource> m_pBuffer = nullptr;
-	D3D12_CONSTANT_BUFFER_VIEW_DESC m_Desc = {};
+	typename Backend::Buffer m_Buffer;
+	RhiConstantBufferViewDesc m_Desc = {};
 	void* m_pMappedPtr = nullptr;
 
-};
\ No newline at end of file
+};
+
+using ConstantBuffer = BasicConstantBuffer<RhiBackend>;
@@ -0,0 +1,55 @@
+#pragma once
+#include "Rhi.h"
+
+struct ConstantAllocation
+{
+	void* Ptr = nullptr;
+	RhiGpuAddress Address = 0;
+	size_t Offset = 0; // バッファの先頭から（コピー元に指定する時に使う）
+};
+
+// フレームスロットごとの定数用アップロードバッファ
+// フレーム中は先頭から詰めて割り当て、スロットのGPU処理が終わったらResetで丸ごと使い直す
+// Backendは描画APIのバックエンド（Rhi.h）
+template<typename Backend>
+class BasicConstantRing
+{
+public:
+	BasicConstantRing(size_t size);
+	bool IsValid();
+
+	ConstantAllocation Allocate(size_t size);
+
+	// 値をコピーしてGPUアドレスを返す（割り当てられなければ0）
+	template<typename T>
+	RhiGpuAddress Push(const T& value)
+	{
+		auto allocation = Allocate(sizeof(T));
+		if (allocation.Ptr == nullptr)
+		{
+			return 0;
+		}
+		*reinterpret_cast<T*>(allocation.Ptr) = value;
+		return allocation.Address;
+	}
+
+	void Reset();
+	// コピーのコマンドに渡すリソース
+	typename Backend::Resource* Resource() const { return m_Buffer.Resource(); }
+	size_t UsedBytes() const;
+	size_t PeakBytes() const;
+
+	BasicConstantRing(const BasicConstantRing&) = delete;
+	void operator = (const BasicConstantRing&) = delete;
+
+private:
+	bool m_IsValid = false;
+	typename Backend::Buffer m_Buffer;
+	UINT8* m_pMappedPtr = nullptr;
+	RhiGpuAddress m_BaseAddress = 0;
+	size_t m_Size = 0;
+	size_t m_Offset = 0;
+	size_t m_PeakBytes = 0;
+};
+
+using ConstantRing = BasicConstantRing<RhiBackend>;
@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// GPUが使い終わるまでオブジェクトの解放を遅らせるキュー
+// 解放要求は現在のフェンス値を付けて積まれ、フェンスの完了値がそれを超えたらまとめて解放する
+// 積む側（ロード用スレッドなど）はロックを取らない。回収するのはメインスレッドのみ
+class DeferredReleaseQueue
+{
+public:
+	typedef void (*Deleter)(void* pObject);
+
+	DeferredReleaseQueue() = default;
+	~DeferredReleaseQueue();
+
+	// COMオブジェクト(ID3D12Resourceなど)をRelease()で解放する
+	template<typename T>
+	void Release(T* pObject, uint64_t size = 0)
+	{
+		if (pObject != nullptr)
+		{
+			Enqueue(pObject, [](void* p) { static_cast<T*>(p)->Release(); }, size);
+		}
+	}
+
+	// newで確保したオブジェクトをdeleteで解放する
+	template<typename T>
+	void Delete(T* pObject, uint64_t size = 0)
+	{
+		if (pObject != nullptr)
+		{
+			Enqueue(pObject, [](void* p) { delete static_cast<T*>(p); }, size);
+		}
+	}
+
+	void Enqueue(void* pObject, Deleter deleter, uint64_t size);
+
+	// 次にシグナルされるフェンス値。以降に積まれた要求にはこの値が付く
+	void SetCurrentFenceValue(uint64_t fenceValue);
+	// completedFenceValue以下の値が付いた要求をまとめて解放する（メインスレッドから呼ぶ）
+	size_t Collect(uint64_t completedFenceValue);
+	// GPUの完了を待たずに全て解放する（終了時用）
+	size_t ReleaseAll();
+
+	uint64_t RetainedBytes() const { return m_RetainedBytes.load(std::memory_order_relaxed); }
+	uint64_t PeakRetainedBytes() const { return m_PeakRetainedBytes.load(std::memory_order_relaxed); }
+	size_t PendingCount() const { return m_Pending.size(); }
+
+	DeferredReleaseQueue(const DeferredReleaseQueue&) = delete;
+	void operator = (const DeferredReleaseQueue&) = delete;
+
+private:
+	struct Node
+	{
+		void* pObject;
+		Deleter pDeleter;
+		uint64_t Size;
+		uint64_t FenceValue;
+		Node* pNext;
+	};
+
+	void TakeIncoming();
+	void Free(Node* pNode);
+
+	std::atomic<Node*> m_pIncoming = nullptr; // 積む側が使うロックフリーのスタック
+	std::atomic<uint64_t> m_CurrentFenceValue = 0;
+	std::atomic<uint64_t> m_RetainedBytes = 0;
+	std::atomic<uint64_t> m_PeakRetainedBytes = 0;
+	std::vector<Node*> m_Pending; // 回収側だけが触る、まだ解放できない要求
+};
@@ -3,14 +3,17 @@
 #include <d3dx12.h>
 #include <vector>
 
-class ConstantBuffer;
 class Texture2D;
 
+// シェーダーの_Textures（PBR.hlsl、SamplePS.hlsl）の既定の数と同じにする。実際の数はMATERIAL_TABLE_SIZEで渡す
+const UINT HANDLE_MAX = 512;
+
 class DescriptorHandle
 {
 public:
 	D3D12_CPU_DESCRIPTOR_HANDLE HandleCPU;
 	D3D12_GPU_DESCRIPTOR_HANDLE HandleGPU;
+	UINT Index; // ヒープ先頭からのインデックス（バインドレス描画でシェーダーに渡す）
 };
 
 class DescriptorHeap
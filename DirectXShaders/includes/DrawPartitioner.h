@@ -0,0 +1,59 @@
+#pragma once
+#include "JobSystem.h"
+#include <cstdint>
+#include <vector>
+
+// 描画の連続した範囲
+struct DrawRange
+{
+	uint32_t Begin;
+	uint32_t End; // 含まない
+	uint64_t Cost;
+
+	bool operator==(const DrawRange& other) const { return Begin == other.Begin && End == other.End && Cost == other.Cost; }
+	bool operator!=(const DrawRange& other) const { return !(*this == other); }
+};
+
+// 描画の記録を複数のスレッドに分ける
+// 描画順を保つため連続した範囲に区切り、見積もったコストがなるべく均等になるようにする
+// 同じ入力なら必ず同じ分け方になる。デバイスを使わないので記録を模したスタブで計測できる
+class DrawPartitioner
+{
+public:
+	// costsは描画順の見積もりコスト。最大partitionCount個に分け、1つの範囲にはminDrawsPerPartition個以上の描画を入れる
+	// （描画がminDrawsPerPartition個に満たなければ、全てを1つの範囲にする）
+	static std::vector<DrawRange> Partition(const std::vector<uint32_t>& costs, uint32_t partitionCount, uint32_t minDrawsPerPartition = 1);
+
+	// 範囲ごとにrecord(範囲の番号, 範囲)を呼ぶ。最初の範囲は呼び出したスレッドで、残りはジョブシステムで処理する
+	template<typename Func>
+	static void Record(const std::vector<DrawRange>& ranges, Func&& record)
+	{
+		if (ranges.empty())
+		{
+			return;
+		}
+
+		JobCounter counter;
+		for (uint32_t i = 1; i < ranges.size(); i++)
+		{
+			if (g_JobSystem != nullptr)
+			{
+				g_JobSystem->Run([&record, &ranges, i]() { record(i, ranges[i]); }, &counter);
+			}
+			else
+			{
+				record(i, ranges[i]);
+			}
+		}
+
+		record(0u, ranges[0]);
+
+		if (g_JobSystem != nullptr)
+		{
+			g_JobSystem->Wait(counter);
+		}
+	}
+
+	// 同じ入力で同じ分け方になること、範囲の数と最低の描画数、コストの釣り合い、Recordの呼び出しを確かめる
+	static bool RunTest();
+};
@@ -0,0 +1,134 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 描画を並べ替えるための64bitのキー。上位のフィールドほど切り替えの手間が大きい
+// | パス 4bit | パイプライン 12bit | マテリアル 16bit | 深度 12bit | ジオメトリ 20bit |
+// 深度は同じマテリアルの中で手前から描くためのもので、状態の切り替えはない
+struct DrawKey
+{
+	enum Field
+	{
+		FIELD_PASS = 1 << 0,
+		FIELD_PIPELINE = 1 << 1,
+		FIELD_MATERIAL = 1 << 2,
+		FIELD_DEPTH = 1 << 3,
+		FIELD_GEOMETRY = 1 << 4,
+		FIELD_ALL = FIELD_PASS | FIELD_PIPELINE | FIELD_MATERIAL | FIELD_DEPTH | FIELD_GEOMETRY,
+	};
+
+	enum
+	{
+		GEOMETRY_SHIFT = 0, GEOMETRY_BITS = 20,
+		DEPTH_SHIFT = 20, DEPTH_BITS = 12,
+		MATERIAL_SHIFT = 32, MATERIAL_BITS = 16,
+		PIPELINE_SHIFT = 48, PIPELINE_BITS = 12,
+		PASS_SHIFT = 60, PASS_BITS = 4,
+	};
+
+	// 各値はフィールドの幅に収まっていること（はみ出した分は捨てる）
+	static uint64_t Make(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t depth, uint32_t geometry)
+	{
+		return Put(pass, PASS_SHIFT, PASS_BITS)
+			| Put(pipeline, PIPELINE_SHIFT, PIPELINE_BITS)
+			| Put(material, MATERIAL_SHIFT, MATERIAL_BITS)
+			| Put(depth, DEPTH_SHIFT, DEPTH_BITS)
+			| Put(geometry, GEOMETRY_SHIFT, GEOMETRY_BITS);
+	}
+
+	static uint32_t Pass(uint64_t key) { return Get(key, PASS_SHIFT, PASS_BITS); }
+	static uint32_t Pipeline(uint64_t key) { return Get(key, PIPELINE_SHIFT, PIPELINE_BITS); }
+	static uint32_t Material(uint64_t key) { return Get(key, MATERIAL_SHIFT, MATERIAL_BITS); }
+	static uint32_t Depth(uint64_t key) { return Get(key, DEPTH_SHIFT, DEPTH_BITS); }
+	static uint32_t Geometry(uint64_t key) { return Get(key, GEOMETRY_SHIFT, GEOMETRY_BITS); }
+
+	// 0(手前)～1(奥)の深度をバケットの番号にする。範囲外は端に寄せる
+	static uint32_t DepthBucket(float normalizedDepth);
+
+	// aとbで値の異なるフィールド（Fieldの組み合わせ）
+	static uint32_t ChangedFields(uint64_t a, uint64_t b);
+
+private:
+	static uint64_t Put(uint32_t value, int shift, int bits) { return (static_cast<uint64_t>(value) & ((1ull << bits) - 1)) << shift; }
+	static uint32_t Get(uint64_t key, int shift, int bits) { return static_cast<uint32_t>((key >> shift) & ((1ull << bits) - 1)); }
+};
+
+struct DrawItem
+{
+	uint64_t Key;
+	uint32_t Draw; // 呼び出し側の描画の番号
+};
+
+// 発行した状態の切り替えの数
+struct DrawStateChanges
+{
+	uint32_t Pass;
+	uint32_t Pipeline;
+	uint32_t Material;
+	uint32_t Geometry;
+	uint32_t Draws;
+
+	void Add(const DrawStateChanges& other)
+	{
+		Pass += other.Pass;
+		Pipeline += other.Pipeline;
+		Material += other.Material;
+		Geometry += other.Geometry;
+		Draws += other.Draws;
+	}
+};
+
+// 描画をキーで並べ替え、変わったフィールドの分だけ状態を設定しながら順に渡す
+// デバイスを使わないので、GPUなしで並べ替えと切り替えの数を計測できる
+class DrawQueue
+{
+public:
+	void Clear() { m_Items.clear(); }
+	void Reserve(size_t count) { m_Items.reserve(count); }
+	void Push(uint64_t key, uint32_t draw) { m_Items.push_back({ key, draw }); }
+
+	// キーの昇順に並べる。同じキーは追加した順のまま
+	void Sort();
+
+	const std::vector<DrawItem>& Items() const { return m_Items; }
+	uint32_t Size() const { return static_cast<uint32_t>(m_Items.size()); }
+
+	// 並べた後のbegin～end番目の描画についてsubmit(描画, 前の描画から変わったフィールド)を呼ぶ
+	// コマンドリストの間では状態が引き継がれないので、範囲の最初の描画は全てのフィールドが変わったものとして渡す
+	template<typename Func>
+	DrawStateChanges Submit(uint32_t begin, uint32_t end, Func&& submit) const
+	{
+		DrawStateChanges changes = {};
+		for (auto i = begin; i < end; i++)
+		{
+			auto changed = i == begin ? static_cast<uint32_t>(DrawKey::FIELD_ALL) : DrawKey::ChangedFields(m_Items[i - 1].Key, m_Items[i].Key);
+			Count(changes, changed);
+			submit(m_Items[i], changed);
+		}
+		return changes;
+	}
+
+	// 並べた結果を変えずに、Submitで発行される切り替えの数だけ数える
+	DrawStateChanges CountStateChanges(uint32_t begin, uint32_t end) const;
+
+	// LSDの基数ソート（8bitずつ）。parallelでジョブシステムがあれば区間ごとに並列で数えて並べる
+	// 全てのキーで同じ値の桁は飛ばすので、使っていない上位のフィールドの分は手間がかからない
+	static void RadixSort(std::vector<DrawItem>& items, std::vector<DrawItem>& scratch, bool parallel = true);
+
+	// 擬似的な描画をdrawCount個作り、並べ替えの時間と切り替えの数を出力する
+	static void RunBenchmark(uint32_t drawCount);
+
+private:
+	static void Count(DrawStateChanges& changes, uint32_t changed)
+	{
+		changes.Pass += (changed & DrawKey::FIELD_PASS) ? 1 : 0;
+		changes.Pipeline += (changed & DrawKey::FIELD_PIPELINE) ? 1 : 0;
+		changes.Material += (changed & DrawKey::FIELD_MATERIAL) ? 1 : 0;
+		changes.Geometry += (changed & DrawKey::FIELD_GEOMETRY) ? 1 : 0;
+		changes.Draws++;
+	}
+
+	std::vector<DrawItem> m_Items;
+	std::vector<DrawItem> m_Scratch; // 並べ替えの作業用（毎フレーム確保しないよう使い回す）
+};
@@ -3,6 +3,15 @@
 #include <dxgi.h>
 #include <dxgi1_4.h>
 #include "ComPtr.h"
+#include "ResourceStateTracker.h"
+#include "DeferredReleaseQueue.h"
+#include "PipelineCache.h"
+#include "ShaderCompiler.h"
+#include "FrameScheduler.h"
+#include "ConstantRing.h"
+#include "RenderGraphExecutor.h"
+#include "GpuProfiler.h"
+#include "Timer.h"
 
 #pragma comment(lib, "d3d12.lib")
 #pragma comment(lib, "dxgi.lib")
@@ -10,7 +19,8 @@
 class Engine
 {
 public:
-	enum { FRAME_BUFFER_COUNT = 2 };
+	enum { MAX_FRAMES_IN_FLIGHT = FrameScheduler::MAX_FRAMES_IN_FLIGHT };
+	enum { MAX_RECORD_THREADS = 8 };
 
 public:
 	bool Init(HWND hWnd, UINT windowWidth, UINT windowHeight);
@@ -18,15 +28,41 @@ public:
 	void DrawIrradianceMap();
 
 	void BeginRender();
+	void ExecuteFrameGraph(); // 登録されたパスを実行する（BeginRenderとEndRenderの間で1回）
 	void EndRender();
 
+	// シーンがパスを登録し終えたら一度だけ呼ぶ（グラフの構造はフレーム間で変わらない）
+	bool CompileFrameGraph();
+
 	void UpdateFrameCount();
+	void PrintReleaseStats(); // 遅延解放した数と最大保持メモリ（終了時に呼ぶ）
 
 public: // Getters
 	ID3D12Device6* Device();
 	ID3D12GraphicsCommandList* CommandList();
 	UINT CurrentBackBufferIndex();
+	UINT FramesInFlight();
+	UINT CurrentFrameSlot(); // フレームごとのリソースはバックバッファではなくこの番号で使い分ける
+	ConstantRing* FrameConstants(); // 現在のフレームスロットの定数用リングバッファ
+	UINT RecordThreadCount(); // 描画の記録に使えるスレッド数
+	// ワーカースレッド用のコマンドリスト。BeginRenderでリセットされ、レンダーターゲットとビューポートは設定済み
+	ID3D12GraphicsCommandList* WorkerCommandList(UINT worker);
+	// このフレームでは0～count-1番のワーカー用リストを、メインのリストの後に順に実行する
+	void SubmitWorkerLists(UINT count);
 	UINT FrameCount();
+	ResourceStateTracker* StateTracker();
+	DeferredReleaseQueue* ReleaseQueue();
+	PipelineCache* PSOCache();
+	ShaderCompiler* Shaders();
+	RenderGraph* FrameGraph();
+	RenderGraphExecutor* FrameGraphExecutor(); // シーンが持つリソースをフレームのグラフに取り込む時に使う
+	RenderGraph::ResourceHandle BackBufferTarget(); // 現在のバックバッファ
+	RenderGraph::ResourceHandle DepthTarget(); // フレーム内だけで使う深度バッファ（一時リソース）
+	ID3D12CommandQueue* Queue(); // 描画キュー
+	ID3D12CommandQueue* ComputeQueue(); // 描画と並行して動かす計算キュー
+	ID3D12Fence* Fence(); // 描画キューのフェンス
+	UINT64 NextFenceValue(); // 現在のフレーム（初期化中なら初期化のコマンド）を投げた時にシグナルされる値
+	void DeferRelease(ID3D12Resource* resource); // GPUが使い終わってからresourceを解放する
 
 private: // DX12初期化
 	bool CreateDevice();
@@ -34,6 +70,7 @@ private: // DX12初期化
 	bool CreateSwapChain();
 	bool CreateCommandList();
 	bool CreateFence();
+	bool CreateFrameResources();
 	void CreateViewPort();
 	D3D12_VIEWPORT CreateViewPort(UINT height, UINT width);
 	void CreateScissorRect();
@@ -48,30 +85,59 @@ private:
 
 	ComPtr<ID3D12Device6> m_pDevice = nullptr; // デバイス
 	ComPtr<ID3D12CommandQueue> m_pQueue = nullptr; // コマンドキュー
+	ComPtr<ID3D12CommandQueue> m_pComputeQueue = nullptr; // 計算キュー
 	ComPtr<IDXGISwapChain3> m_pSwapChain = nullptr; // スワップチェイン
-	ComPtr<ID3D12CommandAllocator> m_pAllocator[FRAME_BUFFER_COUNT] = { nullptr }; // コマンドアロケーたー
+	ComPtr<ID3D12CommandAllocator> m_pAllocator[MAX_FRAMES_IN_FLIGHT] = { nullptr }; // コマンドアロケーたー（フレームスロットごと）
 	ComPtr<ID3D12GraphicsCommandList> m_pCommandList = nullptr; // コマンドリスト
+	ComPtr<ID3D12CommandAllocator> m_pEndAllocator[MAX_FRAMES_IN_FLIGHT] = { nullptr };
+	ComPtr<ID3D12GraphicsCommandList> m_pEndCommandList = nullptr; // ワーカーの描画の後に実行する、Present前の遷移用
+	UINT m_RecordThreadCount = 1;
+	UINT m_SubmittedWorkerLists = 0;
+	ComPtr<ID3D12CommandAllocator> m_pWorkerAllocators[MAX_FRAMES_IN_FLIGHT][MAX_RECORD_THREADS] = {}; // フレームスロットとスレッドごと
+	ComPtr<ID3D12GraphicsCommandList> m_pWorkerLists[MAX_RECORD_THREADS] = {};
 	HANDLE m_fenceEvent = nullptr; // フェンスで使うイベント
 	ComPtr<ID3D12Fence> m_pFence = nullptr; // フェンス
-	UINT64 m_fenceValue[FRAME_BUFFER_COUNT]; // フェンスの値（ダブルバッファリング用に2個）
+	FrameScheduler m_Scheduler; // フレームスロットとフェンス値の管理
+	ConstantRing* m_pConstantRings[MAX_FRAMES_IN_FLIGHT] = { nullptr }; // フレームスロットごとの定数
 	D3D12_VIEWPORT m_Viewport; // ビューポート
 	D3D12_RECT m_Scissor; // シザー矩形
+	ResourceStateTracker m_StateTracker; // m_pCommandListで使うリソースの状態
+	DeferredReleaseQueue m_ReleaseQueue; // フェンスの完了を待ってから解放するオブジェクト
+	uint64_t m_ReleasedObjects = 0; // m_ReleaseQueueで解放した数の合計
+	PipelineCache m_PipelineCache; // ルートシグネチャとPSOのキャッシュ
+	ShaderCompiler m_ShaderCompiler; // シェーダーのコンパイルとキャッシュ
 
 private: // 描画に使うオブジェクトとその生成関数たち
 	bool CreateRenderTarget(); // レンダーターゲットを生成
-	bool CreateDepthStencil(); // 深度ステンシルバッファを生成
+	bool CreateFrameGraph(); // バックバッファと深度バッファを宣言し、クリアのパスを登録する
 
 	UINT m_RtvDescriptorSize = 0; // レンダーターゲットビューのディスクリプタサイズ
 	ComPtr<ID3D12DescriptorHeap> m_pRtvHeap = nullptr; // レンダーターゲットのディスクリプタヒープ
-	ComPtr<ID3D12Resource> m_pRenderTargets[FRAME_BUFFER_COUNT] = { nullptr }; // レンダーターゲット（ダブルバッファリングするので2個）
+	UINT m_BackBufferCount = 0; // 同時に処理するフレーム数と同じ
+	ComPtr<ID3D12Resource> m_pRenderTargets[MAX_FRAMES_IN_FLIGHT] = { nullptr }; // レンダーターゲット
 
-	UINT m_DsvDescriptorSize = 0; // 深度ステンシルのディスクリプターサイズ
-	ComPtr<ID3D12DescriptorHeap> m_pDsvHeap = nullptr; // 深度ステンシルのディスクリプタヒープ
-	ComPtr<ID3D12Resource> m_pDepthStencilBuffer = nullptr; // 深度ステンシルバッファ（こっちは1つでいい）
+	RenderGraph m_FrameGraph; // 毎フレームの描画パス
+	RenderGraphExecutor m_FrameGraphExecutor;
+	RenderGraph::ResourceHandle m_BackBufferTarget = RenderGraph::INVALID_RESOURCE;
+	RenderGraph::ResourceHandle m_DepthTarget = RenderGraph::INVALID_RESOURCE;
 
 private: // 描画ループで使用するもの
 	ID3D12Resource* m_currentRenderTarget = nullptr; // 現在のフレームのレンダーターゲットを一時的に保存しておく関数
-	void WaitRender(); // 描画完了を待つ処理
+	void WaitRender(); // 現在のフレームスロットを前回使ったフレームの完了を待つ処理
+	void ReadTimestamps(UINT slot); // 完了したフレームのGPU時間を計測結果に加える
+
+	// フレーム時間の計測
+	Timer m_FrameTimer;
+	double m_LastFrameStart = -1.0;
+	ComPtr<ID3D12QueryHeap> m_pTimestampHeap = nullptr; // スロットごとに開始と終了の2つ
+	ComPtr<ID3D12Resource> m_pTimestampBuffer = nullptr;
+	UINT64* m_pTimestamps = nullptr;
+	UINT64 m_TimestampFrequency = 0;
+	bool m_HasTimestamps[MAX_FRAMES_IN_FLIGHT] = { false };
+
+	// Profilerが有効な時の区間の計測（パスごとの区間はレンダーグラフが測る）
+	GpuProfiler m_GpuProfiler;
+	UINT m_GpuFrameScope = GpuProfiler::INVALID_SCOPE;
 
 };
 
@@ -0,0 +1,256 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// エンティティの番号。番号は消した後に使い回すので、世代が違えば別のエンティティ
+struct Entity
+{
+	uint32_t Index = 0xffffffff;
+	uint32_t Generation = 0;
+
+	bool operator == (const Entity& other) const { return Index == other.Index && Generation == other.Generation; }
+	bool operator != (const Entity& other) const { return !(*this == other); }
+};
+
+// 部品の種類の集合（部品の番号のビット）
+typedef uint64_t ComponentMask;
+
+// 部品の種類ごとの番号。最初に使った時に振り、プロセスの中で共通
+// 部品はmemcpyで動かすので、コピーできる構造体だけにする（値は0で埋めてから作る）
+template<class T>
+uint32_t ComponentId();
+
+template<class... Ts>
+ComponentMask ComponentMaskOf()
+{
+	return (ComponentMask(0) | ... | (ComponentMask(1) << ComponentId<std::remove_const_t<Ts>>()));
+}
+
+class EntityWorld;
+
+// 持っている部品がall全てを含み、noneのどれも含まない部品の組み合わせ（アーキタイプ）を探す条件
+// 合うアーキタイプの一覧を覚えておき、次に使う時は新しくできたアーキタイプだけを調べる
+class EntityQuery
+{
+public:
+	explicit EntityQuery(ComponentMask all = 0, ComponentMask none = 0) : m_All(all), m_None(none) {}
+
+	ComponentMask All() const { return m_All; }
+	ComponentMask None() const { return m_None; }
+
+private:
+	friend class EntityWorld;
+	ComponentMask m_All;
+	ComponentMask m_None;
+	uint64_t m_World = 0; // 覚えている一覧のワールド
+	uint32_t m_CheckedArchetypes = 0; // ここまでのアーキタイプは調べた
+	std::vector<uint32_t> m_Archetypes;
+};
+
+// 1つのチャンクの中身。部品ごとに配列が並ぶ（行の番号はどの配列でも同じエンティティ）
+class EntityChunk
+{
+public:
+	uint32_t Count() const { return m_Count; }
+	const Entity* Entities() const { return reinterpret_cast<const Entity*>(m_pData); }
+	// 部品の配列。このチャンクに無い部品ならnullptr
+	template<class T>
+	T* Get() const { return static_cast<T*>(Column(ComponentId<std::remove_const_t<T>>())); }
+	void* Column(uint32_t component) const { return m_pOffsets[component] == NO_COLUMN ? nullptr : m_pData + m_pOffsets[component]; }
+
+private:
+	friend class EntityWorld;
+	enum : uint32_t { NO_COLUMN = 0xffffffff };
+	uint8_t* m_pData;
+	const uint32_t* m_pOffsets;
+	uint32_t m_Count;
+};
+
+// 構造を変える操作（作る、消す、部品を足す、外す）を貯めておき、EntityWorld::Playbackでまとめて行う
+// 記録はどのスレッドからでもできるので、並列に回すシステムの中から使う。Playbackでは記録した順に行う
+// Createで返すエンティティは仮のもので、同じバッファの中でしか使えない（Playbackで本物に置き換える）
+class EntityCommandBuffer
+{
+public:
+	Entity Create(ComponentMask components);
+	void Destroy(Entity entity);
+	template<class T>
+	void Add(Entity entity, const T& value) { Record(COMMAND_ADD, entity, ComponentId<T>(), &value, sizeof(T)); }
+	template<class T>
+	void Set(Entity entity, const T& value) { Record(COMMAND_SET, entity, ComponentId<T>(), &value, sizeof(T)); }
+	template<class T>
+	void Remove(Entity entity) { Record(COMMAND_REMOVE, entity, ComponentId<T>(), nullptr, 0); }
+
+	bool IsEmpty() const { return m_Commands.empty(); }
+	size_t Size() const { return m_Commands.size(); }
+	void Clear();
+
+	// Createで返す仮のエンティティの世代（本物のエンティティには使わない）
+	enum : uint32_t { PENDING_GENERATION = 0xffffffff };
+
+private:
+	friend class EntityWorld;
+	enum : uint32_t
+	{
+		COMMAND_CREATE,
+		COMMAND_DESTROY,
+		COMMAND_ADD,
+		COMMAND_SET,
+		COMMAND_REMOVE,
+	};
+
+	struct Command
+	{
+		uint32_t Type;
+		uint32_t Component; // CREATEでは使わない
+		Entity Target;
+		ComponentMask Components; // CREATEの部品
+		uint32_t DataOffset; // m_Dataの中の値
+	};
+
+	void Record(uint32_t type, Entity entity, uint32_t component, const void* pValue, size_t size);
+
+	std::mutex m_Mutex;
+	std::vector<Command> m_Commands;
+	std::vector<uint8_t> m_Data;
+	uint32_t m_PendingCount = 0;
+};
+
+// アーキタイプ（部品の組み合わせ）ごとに、16KBのチャンクに部品の配列（SoA）を並べてエンティティを持つ
+// 同じアーキタイプのエンティティはチャンクの先頭から詰めて置き、消したら最後のエンティティを空いた所に動かす
+// クエリは条件に合うアーキタイプのチャンクだけを回し、システムは部品の配列を頭から順に読む
+// 構造を変える操作はすぐに行う版とEntityCommandBufferに貯める版がある。すぐに行う版と部品の読み書き以外の操作は、
+// チャンクを回している間（並列のシステムの中も）には使えない
+class EntityWorld
+{
+public:
+	enum : uint32_t
+	{
+		CHUNK_SIZE = 16 * 1024,
+		MAX_COMPONENTS = 64,
+		CHUNK_GRAIN = 4, // 1つのジョブで回すチャンクの数
+	};
+
+	// 部品の大きさと整列（ComponentIdから呼ぶ）
+	static uint32_t RegisterComponent(size_t size, size_t alignment);
+
+	EntityWorld();
+	~EntityWorld();
+
+	// 部品の値は0で埋める。Addは持っていれば値を書き換え、消したエンティティならnullptrを返す
+	Entity Create(ComponentMask components);
+	void Destroy(Entity entity);
+	bool IsAlive(Entity entity) const;
+	template<class T>
+	T* Add(Entity entity, const T& value)
+	{
+		auto pComponent = static_cast<T*>(AddComponent(entity, ComponentId<T>()));
+		if (pComponent != nullptr)
+		{
+			*pComponent = value;
+		}
+		return pComponent;
+	}
+	template<class T>
+	void Remove(Entity entity) { RemoveComponent(entity, ComponentId<T>()); }
+	// 持っていなければnullptr
+	template<class T>
+	T* Get(Entity entity) const { return static_cast<T*>(GetComponent(entity, ComponentId<std::remove_const_t<T>>())); }
+	ComponentMask GetComponents(Entity entity) const;
+	void Clear();
+
+	// 番号indexの今のエンティティ（使っていなければ世代0）
+	Entity EntityAt(uint32_t index) const;
+	uint32_t EntityCount() const { return m_EntityCount; }
+	// エンティティの番号の上限（番号で引く配列の大きさ）
+	uint32_t IndexCount() const { return static_cast<uint32_t>(m_Records.size()); }
+	uint32_t ArchetypeCount() const { return static_cast<uint32_t>(m_Archetypes.size()); }
+	uint32_t Count(EntityQuery& query) const;
+
+	// 条件に合うチャンクを回す
+	void ForEachChunk(EntityQuery& query, const std::function<void(const EntityChunk&)>& func) const;
+	// ジョブシステムでチャンクをCHUNK_GRAIN個ずつ並列に回す（ジョブシステムが無ければ順に回す）
+	void ParallelForEachChunk(EntityQuery& query, const std::function<void(const EntityChunk&)>& func) const;
+
+	// func(Entity, Ts&...)を条件に合う全てのエンティティで呼ぶ。Tsはqueryの条件に含まれている部品にする
+	template<class... Ts, class F>
+	void Each(EntityQuery& query, F&& func) const
+	{
+		ForEachChunk(query, [&func](const EntityChunk& chunk) { EachInChunk<Ts...>(chunk, func); });
+	}
+	template<class... Ts, class F>
+	void ParallelEach(EntityQuery& query, F&& func) const
+	{
+		ParallelForEachChunk(query, [&func](const EntityChunk& chunk) { EachInChunk<Ts...>(chunk, func); });
+	}
+
+	// 記録した操作を順に行い、バッファを空にする。消したエンティティへの操作は飛ばす
+	void Playback(EntityCommandBuffer& buffer);
+
+	// 100万エンティティで、クエリで部品を回す速さ（1スレッドと並列、全ての値を1つの構造体に持つ配列との比較）と、
+	// コマンドバッファでの構造の変更の時間を測り、別に求めた結果と比べる
+	static bool RunBenchmark(uint32_t entityCount, int iterations);
+
+	EntityWorld(const EntityWorld&) = delete;
+	void operator = (const EntityWorld&) = delete;
+
+private:
+	struct Archetype;
+	struct Chunk;
+
+	// 番号ごとの置き場所
+	struct Record
+	{
+		uint32_t Archetype; // NO_ARCHETYPEなら使っていない
+		uint32_t Chunk;
+		uint32_t Row;
+		uint32_t Generation;
+	};
+
+	template<class... Ts, class F>
+	static void EachInChunk(const EntityChunk& chunk, F& func)
+	{
+		auto entities = chunk.Entities();
+		auto count = chunk.Count();
+		auto run = [&](Ts*... columns)
+		{
+			for (uint32_t i = 0; i < count; i++)
+			{
+				func(entities[i], columns[i]...);
+			}
+		};
+		run(chunk.Get<Ts>()...);
+	}
+
+	const Record* Find(Entity entity) const;
+	uint32_t GetArchetype(ComponentMask components);
+	void AllocateRow(uint32_t archetype, Entity entity, Record* pRecord);
+	void FreeRow(const Record& record);
+	void MoveEntity(Entity entity, ComponentMask components);
+	void* AddComponent(Entity entity, uint32_t component);
+	void RemoveComponent(Entity entity, uint32_t component);
+	void* GetComponent(Entity entity, uint32_t component) const;
+	void* GetComponent(const Record& record, uint32_t component) const;
+	void UpdateQuery(EntityQuery& query) const;
+	void GatherChunks(EntityQuery& query, std::vector<EntityChunk>& chunks) const;
+
+	std::vector<std::unique_ptr<Archetype>> m_Archetypes;
+	std::unordered_map<ComponentMask, uint32_t> m_ArchetypeOfMask;
+	std::vector<Record> m_Records;
+	std::vector<uint32_t> m_FreeIndices;
+	uint32_t m_EntityCount = 0;
+	uint64_t m_Id; // クエリが覚えている一覧と照らし合わせる
+};
+
+template<class T>
+uint32_t ComponentId()
+{
+	static_assert(std::is_trivially_copyable<T>::value, "部品はmemcpyで動かせる型にする");
+	static const uint32_t id = EntityWorld::RegisterComponent(sizeof(T), alignof(T));
+	return id;
+}
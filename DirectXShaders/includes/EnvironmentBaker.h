@@ -0,0 +1,55 @@
+#pragma once
+#include <d3d12.h>
+#include <cstdint>
+#include "ComPtr.h"
+#include "BakeScheduler.h"
+
+// 環境マップ（キューブマップ）からイラディアンスマップと、粗さごとにプリフィルタした鏡面反射用のマップを
+// コンピュートシェーダーで焼き込む。焼き込みは計算キューに投げ、描画キューとはフェンスで同期する
+// 結果は2組あり、どちらを読んでどちらに書くか、キュー同士で待つ値はBakeSchedulerが決める
+// 結果のリソースはCOMMONのまま描画キューに渡し、描画キューでは暗黙の昇格で読む
+class EnvironmentBaker
+{
+public:
+	enum { IRRADIANCE_SIZE = 32, PREFILTER_SIZE = 128, PREFILTER_MIPS = 5, PREFILTER_SAMPLES = 256 };
+
+	// environmentはPIXEL_SHADER_RESOURCEのキューブマップ。計算キューからも読めるように、
+	// 初期化用のコマンドリストで遷移させるので、Engine::DrawIrradianceMapより前に呼ぶ
+	bool Init(ID3D12Resource* environment, ID3DBlob* irradianceShader, ID3DBlob* prefilterShader);
+
+	// 次のフレームの始めに焼き直す（焼き込み中なら終わってから）
+	void RequestBake() { m_Scheduler.RequestBake(); }
+	// BeginRenderの後、このフレームの描画を投げる前に呼ぶ
+	// 必要なら焼き込みを計算キューに投げ、最初の焼き込みの時だけ描画キューに完了を待たせる
+	void BeginFrame();
+
+	uint32_t FrontTarget() const { return m_Scheduler.FrontTarget(); } // このフレームで読む組（まだ無ければNO_TARGET）
+	ID3D12Resource* IrradianceMap(uint32_t target) const { return m_pIrradianceMaps[target].Get(); }
+	ID3D12Resource* PrefilterMap(uint32_t target) const { return m_pPrefilterMaps[target].Get(); }
+
+private:
+	bool CreateTargets();
+	void CreateViews(ID3D12Resource* environment);
+	void RecordBake(uint32_t target);
+	void ReadBakeTime(); // 終わった焼き込みのGPU時間を出力する
+
+	BakeScheduler m_Scheduler;
+	ComPtr<ID3D12CommandAllocator> m_pAllocator; // 同時に走る焼き込みは1つだけなので1つでいい
+	ComPtr<ID3D12GraphicsCommandList> m_pCommandList;
+	ComPtr<ID3D12Fence> m_pFence; // 計算キューのフェンス
+	uint64_t m_FenceValue = 0;
+	uint64_t m_ReportedValue = 0; // GPU時間を出力した焼き込みの値
+
+	ComPtr<ID3D12RootSignature> m_pRootSignature;
+	ComPtr<ID3D12PipelineState> m_pIrradiancePipeline;
+	ComPtr<ID3D12PipelineState> m_pPrefilterPipeline;
+	ComPtr<ID3D12DescriptorHeap> m_pHeap; // 環境マップのSRVと、組ごとに出力先のUAV
+	UINT m_DescriptorSize = 0;
+
+	ComPtr<ID3D12Resource> m_pIrradianceMaps[BakeScheduler::TARGET_COUNT];
+	ComPtr<ID3D12Resource> m_pPrefilterMaps[BakeScheduler::TARGET_COUNT];
+
+	ComPtr<ID3D12QueryHeap> m_pTimestampHeap; // 焼き込みの開始と終了
+	ComPtr<ID3D12Resource> m_pTimestampBuffer;
+	UINT64 m_TimestampFrequency = 0;
+};
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Clock.h"
+
+// フレームの開始時刻を一定の間隔に揃える
+// 目標時刻の少し手前まで眠り、残りはスピンで待つ。目標時刻は前回の目標＋間隔で決めるので誤差が溜まらない
+class FramePacer
+{
+public:
+	explicit FramePacer(Clock& clock);
+
+	void SetTargetFrameRate(double frameRate); // 0以下なら待たない
+	void SetSpinTime(int64_t spinTime) { m_SpinTime = spinTime; } // スピンで待つ時間（ナノ秒）
+
+	// 次のフレームの開始時刻まで待ち、前のフレームの開始からの経過時間（ミリ秒）を返す
+	double WaitForNextFrame();
+
+	// 直近のフレーム時間のパーセンタイル（ミリ秒, percentileは0～100）
+	double Percentile(double percentile) const;
+	uint32_t FrameCount() const { return m_FrameCount; }
+	uint32_t MissedFrames() const { return m_MissedFrames; }
+	void PrintStats() const;
+
+	// 偽の時計で、タイマーが遅れて起きてもずれが溜まらないこと、1フレーム以上の遅れでは数え直すことを確かめる
+	static bool RunTest();
+
+private:
+	Clock& m_Clock;
+	int64_t m_Period = 0; // ナノ秒
+	int64_t m_SpinTime = 1000000;
+	int64_t m_NextTarget = 0; // 次のフレームを始めるべき時刻
+	int64_t m_LastFrameStart = 0;
+	uint32_t m_FrameCount = 0;
+	uint32_t m_MissedFrames = 0; // 目標時刻を1フレーム以上過ぎてしまった回数
+
+	std::vector<double> m_FrameTimes; // 直近のフレーム時間（リングバッファ）
+	size_t m_FrameTimeIndex = 0;
+};
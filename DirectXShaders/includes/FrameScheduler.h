@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+
+// 同時にGPUへ投げておけるフレーム（フレームスロット）とフェンス値の管理
+// 各スロットは最後にそのスロットを使ったフレームのフェンス値だけを覚えておき、
+// スロットを再利用する直前にその値を待てばよい。デバイスを使わないのでGPUの進み方を模擬して確かめられる
+class FrameScheduler
+{
+public:
+	enum { MIN_FRAMES_IN_FLIGHT = 2, MAX_FRAMES_IN_FLIGHT = 4 };
+
+	void Init(uint32_t framesInFlight); // 2～4に丸める
+
+	uint32_t FramesInFlight() const { return m_FramesInFlight; }
+	uint32_t CurrentSlot() const { return m_CurrentSlot; }
+
+	// 現在のスロットを再利用する前に完了を待つべきフェンス値（0なら待たなくていい）
+	uint64_t WaitValue() const { return m_SlotFenceValues[m_CurrentSlot]; }
+	// 次のSubmitでシグナルされる値。遅延解放のタグに使う
+	uint64_t NextFenceValue() const { return m_NextFenceValue; }
+	uint64_t LastSubmittedValue() const { return m_NextFenceValue - 1; }
+
+	// 現在のスロットのコマンドを投げたら呼ぶ。シグナルする値を返し、次のスロットへ進む
+	uint64_t Submit();
+
+	// 計測 --------------------------------------------------------------------
+	// CPUでの1フレームの時間と、そのうちフェンスを待っていた時間（ミリ秒）
+	void RecordCpuFrame(double frameTime, double waitTime);
+	// 完了したフレームのGPUタイムスタンプ。完了した順（=投げた順）に渡す
+	void RecordGpuFrame(uint64_t beginTick, uint64_t endTick, uint64_t frequency);
+
+	struct Stats
+	{
+		uint32_t FrameCount;
+		double CpuFrameTime; // 平均（ミリ秒）
+		double CpuWaitTime;
+		double GpuBusyTime;
+		double GpuIdleTime; // 前のフレームの終わりから次のフレームの始まりまで
+		double MaxGpuIdleTime;
+	};
+
+	Stats GetStats() const;
+	void ResetStats();
+	void PrintStats() const;
+
+	// フェンスとGPUの進み方を模擬し、GPUが使っている間にスロットや遅延解放のオブジェクトを再利用しないこと、
+	// GPUが律速の時にGPUが空かないことを、同時に処理するフレーム数ごとに確かめる
+	static bool RunTest();
+
+private:
+	uint32_t m_FramesInFlight = MIN_FRAMES_IN_FLIGHT;
+	uint32_t m_CurrentSlot = 0;
+	uint64_t m_NextFenceValue = 1;
+	uint64_t m_SlotFenceValues[MAX_FRAMES_IN_FLIGHT] = {};
+
+	uint32_t m_CpuFrames = 0;
+	double m_CpuFrameTime = 0.0;
+	double m_CpuWaitTime = 0.0;
+	uint32_t m_GpuFrames = 0;
+	uint32_t m_GpuGaps = 0;
+	double m_GpuBusyTime = 0.0;
+	double m_GpuIdleTime = 0.0;
+	double m_MaxGpuIdleTime = 0.0;
+	uint64_t m_LastGpuEndTick = 0;
+};
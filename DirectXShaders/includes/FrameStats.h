@@ -0,0 +1,101 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+
+// 集める値。STAT_FIRST_GAUGEより前はフレームごとの数で、後ろは生きている物の数（フレームをまたいで増減する）
+enum StatCounter : uint32_t
+{
+	STAT_DRAW_CALLS, // 描画の発行数（ExecuteIndirectは1つ）
+	STAT_INSTANCES,
+	STAT_TRIANGLES,
+	STAT_STATE_CHANGES, // パイプライン、マテリアル、ジオメトリの切り替え
+	STAT_API_CALLS, // コマンドリストに発行した呼び出し
+	STAT_UPLOAD_BYTES, // CPUからGPUが読むメモリに書いたバイト数
+	STAT_DESCRIPTORS, // 使っているディスクリプタ
+	STAT_RESOURCE_COUNT,
+	STAT_RESOURCE_BYTES,
+	STAT_COUNT,
+	STAT_FIRST_GAUGE = STAT_DESCRIPTORS,
+};
+
+// 共有メモリに置く最新のフレームの値。外部のモニタはこのヘッダーを使って読む
+// Sequenceは書いている間だけ奇数になる。読む側はコピーの前後でSequenceが同じ偶数なら、そのコピーを使っていい
+struct SharedStatsBlock
+{
+	enum { MAGIC = 0x54535844, VERSION = 1, NAME_LENGTH = 32 }; // MAGICは"DXST"
+
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t CounterCount;
+	uint32_t Reserved;
+	std::atomic<uint64_t> Sequence;
+	uint64_t Frame;
+	double FrameTime; // ミリ秒
+	int64_t Values[STAT_COUNT];
+	int64_t Limits[STAT_COUNT]; // 上限（無ければ0）
+	char Names[STAT_COUNT][NAME_LENGTH];
+};
+
+// 描画の統計。各スレッドは自分のカウンタに足すだけで、ロックもアトミックな加算も使わない
+// メインスレッドが1フレームに1回全スレッドのカウンタを集め、履歴と共有メモリに入れる
+// 1回の加算はスレッドローカルの読み込みと書き込みだけなので、製品のビルドでも有効のままにしておける
+// EndFrame、履歴、書き出しはメインスレッドから呼ぶ。デバイスを使わないので、Windows以外でも動く
+class FrameStats
+{
+public:
+	enum { HISTORY_SIZE = 600 };
+
+	// スレッドごとのカウンタ。書くのは持ち主のスレッドだけで、集める側は読むだけ
+	struct ThreadCounters
+	{
+		std::atomic<int64_t> Values[STAT_COUNT];
+	};
+
+	struct Record
+	{
+		uint64_t Frame;
+		double FrameTime; // ミリ秒
+		int64_t Values[STAT_COUNT];
+	};
+
+	static void Add(StatCounter counter, int64_t value)
+	{
+		auto counters = t_pCounters != nullptr ? t_pCounters : RegisterThread();
+		auto& slot = counters->Values[counter];
+		slot.store(slot.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	static const char* Name(StatCounter counter);
+	static void SetLimit(StatCounter counter, int64_t limit);
+	static int64_t Limit(StatCounter counter);
+
+	// 全スレッドのカウンタを集めてframeの値として履歴に入れ、共有メモリに公開する
+	static void EndFrame(uint64_t frame, double frameTime);
+	static uint32_t HistoryCount();
+	static const Record& History(uint32_t index); // 0が一番古い
+	static const Record& Latest();
+
+	static bool WriteCsv(std::ostream& out);
+	static bool WriteJson(std::ostream& out);
+	// pathの拡張子を.csvと.jsonにした2つのファイルに書き出す
+	static bool Export(const std::filesystem::path& path);
+
+	// 共有メモリを作り、以降のEndFrameで最新の値を書く
+	static bool OpenSharedMemory();
+	static void CloseSharedMemory();
+	// 他のプロセスが公開している値を読む
+	static bool ReadSharedMemory(SharedStatsBlock* pBlock);
+	// 他のプロセスが公開している値を1秒ごとに出力する（値が5秒間変わらなければ終える）
+	static void RunMonitor();
+
+	// 1回の加算の手間を測って出力する
+	static void MeasureOverhead();
+	// デバイスを使わずに複数のスレッドからカウンタを足し、集めた値と書き出し、共有メモリを確かめる
+	static bool RunHeadlessTest(const std::filesystem::path& path);
+
+private:
+	static ThreadCounters* RegisterThread();
+	static thread_local ThreadCounters* t_pCounters;
+};
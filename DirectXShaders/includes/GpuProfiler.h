@@ -0,0 +1,52 @@
+#pragma once
+#include <d3d12.h>
+#include <cstdint>
+#include "ComPtr.h"
+#include "FrameScheduler.h"
+
+// キューのタイムスタンプをProfiler::Nowと同じ時計の時刻に直す（キューごとに合わせる）
+struct GpuClock
+{
+	UINT64 GpuTick = 0;
+	int64_t CpuTime = 0;
+	UINT64 Frequency = 0;
+
+	bool Calibrate(ID3D12CommandQueue* queue);
+	int64_t ToCpuTime(UINT64 tick) const;
+};
+
+// フレームスロットごとにタイムスタンプで区間を測り、スロットの完了を待った後でProfilerのGPUの行に送る
+// Profilerが無効のフレームではクエリを発行しない
+class GpuProfiler
+{
+public:
+	enum { MAX_SLOTS = FrameScheduler::MAX_FRAMES_IN_FLIGHT, MAX_SCOPES = 32 }; // 1フレームで測れる区間の数
+	static const UINT INVALID_SCOPE = 0xffffffff;
+
+	// trackはタイムライン上の行の名前
+	bool Init(ID3D12Device* device, ID3D12CommandQueue* queue, const char* track);
+
+	// スロットのフェンスを待った後に呼ぶ。前回そのスロットで測った区間をProfilerに送る
+	void BeginFrame(UINT slot);
+	// 区間の始まりと終わりは、同じフレームで順に実行されるリストなら別のリストに置いてもいい
+	UINT Begin(ID3D12GraphicsCommandList* commandList, const char* name);
+	void End(ID3D12GraphicsCommandList* commandList, UINT scope);
+	// フレームで最後に実行するリストで、全ての区間を閉じてから呼ぶ
+	void Resolve(ID3D12GraphicsCommandList* commandList);
+
+private:
+	UINT QueryIndex(UINT slot, UINT scope) const { return (slot * MAX_SCOPES + scope) * 2; }
+	void ReadSlot(UINT slot);
+
+	ID3D12CommandQueue* m_pQueue = nullptr;
+	const char* m_Track = nullptr;
+	GpuClock m_Clock;
+	ComPtr<ID3D12QueryHeap> m_pQueryHeap;
+	ComPtr<ID3D12Resource> m_pReadbackBuffer;
+	UINT64* m_pTimestamps = nullptr; // 読むのはスロットのフェンスを待った後だけなので、Mapしたままにしておく
+
+	UINT m_Slot = 0;
+	bool m_IsActive = false; // このフレームで測っているか
+	UINT m_ScopeCounts[MAX_SLOTS] = {};
+	const char* m_Names[MAX_SLOTS][MAX_SCOPES] = {};
+};
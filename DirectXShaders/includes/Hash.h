@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+
+// FNV-1a (64bit) によるハッシュ。キャッシュのキー作成に使う
+class Hasher
+{
+public:
+	void Add(const void* data, size_t size)
+	{
+		auto bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			m_Value ^= bytes[i];
+			m_Value *= 1099511628211ull;
+		}
+	}
+
+	template<typename T>
+	void Add(const T& value)
+	{
+		Add(&value, sizeof(T));
+	}
+
+	// 終端文字まで含めて加える（nullptrは空文字列として扱う）
+	void AddString(const char* str)
+	{
+		if (str == nullptr)
+		{
+			str = "";
+		}
+		Add(str, strlen(str) + 1);
+	}
+
+	void AddString(const wchar_t* str)
+	{
+		if (str == nullptr)
+		{
+			str = L"";
+		}
+		Add(str, (wcslen(str) + 1) * sizeof(wchar_t));
+	}
+
+	uint64_t Value() const { return m_Value; }
+
+private:
+	uint64_t m_Value = 14695981039346656037ull;
+};
+
+inline uint64_t HashBytes(const void* data, size_t size)
+{
+	Hasher hasher;
+	hasher.Add(data, size);
+	return hasher.Value();
+}
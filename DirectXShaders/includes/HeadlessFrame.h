@@ -0,0 +1,114 @@
+#pragma once
+#include "CommandListFilter.h"
+#include "ConstantBuffer.h"
+#include "ConstantRing.h"
+#include "DrawQueue.h"
+#include "IndexBuffer.h"
+#include "ObjectBuffer.h"
+#include "PipelineState.h"
+#include "RootSignature.h"
+#include "VertexBuffer.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// ヌルのバックエンド（RhiNull.h）で、Sceneと同じ流れのフレームを記録する。GPUもウィンドウも使わない
+// 定数のリング、描画の並べ替えと分割、コマンドの記録にかかるCPUの時間を測り、記録したコマンドと割り当てを確かめる
+// 物体の定数はSceneと同じく、変わった物体だけをコピーする。GPUの代わりにコピーを行い、結果がCPUの写しと同じか確かめる
+class HeadlessFrame
+{
+public:
+	enum
+	{
+		FRAMES_IN_FLIGHT = 2,
+		INSTANCES_PER_MESH = 4,
+		MATERIAL_COUNT = 64,
+	};
+
+	// meshCount種類のメッシュと、メッシュごとにINSTANCES_PER_MESH個の物体を作る。recordThreadsは記録に使う最大のスレッド数
+	// movingObjectsはフレームごとに動かす物体の数（物体全体に散らばるように選ぶ）
+	bool Init(uint32_t meshCount, uint32_t recordThreads, uint32_t movingObjects = 0);
+	// frame番目のフレームの定数を書き、描画を並べる（物体を動かして変わった物体の定数を詰め、同じメッシュをまとめて並べ替える）
+	void BuildDrawList(uint32_t frame);
+	// 物体の定数のコピーと並べた描画をコマンドリストに記録する。記録したコマンドが描画と呼び出しの数に合っていればtrue
+	bool Record();
+	// 記録したコピーをCPUで行い、GPUの物体の定数がCPUの写しと同じになればtrue
+	bool ExecuteCopies();
+
+	uint32_t ObjectCount() const { return static_cast<uint32_t>(m_Objects.size()); }
+	uint32_t DrawCount() const { return m_Queue.Size(); }
+	uint32_t ApiCallCount() const { return m_ApiCallCount; }
+	uint32_t ApiElidedCount() const { return m_ApiElidedCount; }
+	uint32_t RangeCount() const { return m_RangeCount; }
+	const DrawStateChanges& StateChanges() const { return m_StateChanges; }
+	const NullCommandList& FirstList() const { return m_RangeCount > 1 ? m_WorkerLists[0] : m_MainList; }
+	size_t RingSize() const { return m_RingSize; }
+	size_t RingPeakBytes() const;
+	// 最後のフレームで送った定数（ビュー、物体、インスタンスごとの物体の番号）
+	uint64_t ViewUploadBytes() const { return m_ViewUploadBytes; }
+	uint64_t InstanceUploadBytes() const { return m_InstanceUploadBytes; }
+	const BasicObjectBuffer<NullBackend>& ObjectConstants() const { return m_ObjectConstants; }
+
+	// meshCount種類のメッシュを並べたフレームをframeCount回記録し、時間と結果を出力する
+	// movingObjects個の物体を毎フレーム動かす（0なら動かない物体だけのシーン）
+	static bool RunBenchmark(uint32_t meshCount, uint32_t frameCount, uint32_t recordThreads, uint32_t movingObjects = 0);
+
+private:
+	struct Object
+	{
+		uint32_t Mesh;
+		float Depth; // 0(手前)～1(奥)
+	};
+
+	struct Batch
+	{
+		uint32_t Mesh;
+		uint32_t FirstInstance;
+		uint32_t InstanceCount;
+		uint32_t Depth;
+	};
+
+	void RecordMeshes(CommandListFilter<NullCommandList>& commandList, uint32_t begin, uint32_t end, DrawStateChanges* pChanges);
+	void RecordSkybox(CommandListFilter<NullCommandList>& commandList);
+
+	std::vector<std::unique_ptr<BasicVertexBuffer<NullBackend>>> m_VertexBuffers;
+	std::vector<std::unique_ptr<BasicIndexBuffer<NullBackend>>> m_IndexBuffers;
+	std::vector<uint32_t> m_IndexCounts;
+	std::unique_ptr<BasicVertexBuffer<NullBackend>> m_pSkyboxVertexBuffer;
+	std::unique_ptr<BasicIndexBuffer<NullBackend>> m_pSkyboxIndexBuffer;
+	std::unique_ptr<BasicRootSignature<NullBackend>> m_pRootSignature;
+	std::unique_ptr<BasicRootSignature<NullBackend>> m_pSkyboxRootSignature;
+	std::unique_ptr<BasicPipelineState<NullBackend>> m_pPipelineState;
+	std::unique_ptr<BasicPipelineState<NullBackend>> m_pSkyboxPipelineState;
+	NullDescriptorHeap* m_pDescriptorHeap = nullptr;
+	std::vector<std::unique_ptr<BasicConstantRing<NullBackend>>> m_Rings; // フレームスロットごと
+	size_t m_RingSize = 0;
+	// カメラで決まる定数はスロットごとのバッファに持ち、版が古い時だけ書き直す
+	std::vector<std::unique_ptr<BasicConstantBuffer<NullBackend>>> m_ViewBuffers;
+	std::vector<uint32_t> m_ViewVersions;
+	uint32_t m_ViewVersion = 1;
+	BasicObjectBuffer<NullBackend> m_ObjectConstants;
+	uint32_t m_MovingObjects = 0;
+	uint64_t m_ViewUploadBytes = 0;
+	uint64_t m_InstanceUploadBytes = 0;
+
+	std::vector<Object> m_Objects;
+	DrawQueue m_ObjectQueue; // メッシュの順に並べた物体（インスタンスをまとめる元）
+	DrawQueue m_Queue;
+	std::vector<Batch> m_Batches;
+	std::vector<uint32_t> m_DrawCosts;
+
+	RhiGpuAddress m_TransformAddress = 0;
+	RhiGpuAddress m_SceneAddress = 0;
+	RhiGpuAddress m_SkyboxAddress = 0;
+	RhiGpuAddress m_InstanceAddress = 0;
+	RhiGpuAddress m_ClusterAddress = 0;
+
+	uint32_t m_RecordThreads = 1;
+	NullCommandList m_MainList;
+	std::vector<NullCommandList> m_WorkerLists;
+	uint32_t m_ApiCallCount = 0;
+	uint32_t m_ApiElidedCount = 0;
+	uint32_t m_RangeCount = 0;
+	DrawStateChanges m_StateChanges = {};
+};
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// 画像ファイルの書き出しと読み込み。外部のライブラリを使わないので、Windows以外でも動く
+// PNGは8ビットのRGBで、圧縮しない（deflateの無圧縮ブロック）。どのビューアーでも開ける
+// EXRは32ビット浮動小数のRGBのスキャンラインで、圧縮しない。読み込みは同じ形式（非圧縮、FLOATかHALF）だけに対応する
+class ImageFile
+{
+public:
+	// pixelsはwidth * height * 3個のRGB（0～1に丸めて8ビットにする）
+	static bool WritePng(const std::filesystem::path& path, uint32_t width, uint32_t height, const std::vector<float>& pixels);
+	static bool WriteExr(const std::filesystem::path& path, uint32_t width, uint32_t height, const std::vector<float>& pixels);
+	static bool ReadExr(const std::filesystem::path& path, uint32_t* pWidth, uint32_t* pHeight, std::vector<float>& pixels);
+
+	static uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+};
@@ -1,21 +1,25 @@
 #pragma once
 #include <cstdint>
-#include <d3d12.h>
-#include "ComPtr.h"
+#include "Rhi.h"
 
-class IndexBuffer
+// Backendは描画APIのバックエンド（Rhi.h）
+template<typename Backend>
+class BasicIndexBuffer
 {
 public:
 
-	IndexBuffer(size_t size, const void* pIndices = nullptr);
-	D3D12_INDEX_BUFFER_VIEW View() const;
+	BasicIndexBuffer(size_t size, const void* pIndices = nullptr);
+	~BasicIndexBuffer();
+	RhiIndexBufferView View() const;
 	bool IsValid();
 
-	IndexBuffer(const IndexBuffer&) = delete;
-	void operator = (const IndexBuffer&) = delete;
+	BasicIndexBuffer(const BasicIndexBuffer&) = delete;
+	void operator = (const BasicIndexBuffer&) = delete;
 
 private:
 	bool m_IsValid = false;
-	ComPtr<ID3D12Resource> m_pBuffer = nullptr;
-	D3D12_INDEX_BUFFER_VIEW m_View = {};
-};
\ No newline at end of file
+	typename Backend::Buffer m_Buffer;
+	RhiIndexBufferView m_View = {};
+};
+
+using IndexBuffer = BasicIndexBuffer<RhiBackend>;
@@ -0,0 +1,56 @@
+#ifndef INDIRECT_CULL_HLSLI
+#define INDIRECT_CULL_HLSLI
+
+#ifdef __cplusplus
+#include <cstdint>
+
+namespace IndirectCull
+{
+typedef uint32_t uint;
+struct float4 { float x, y, z, w; };
+#define CULL_PRECISE
+#define CULL_IN(type) const type&
+#define CULL_FUNCTION inline
+#else
+#define CULL_PRECISE precise
+#define CULL_IN(type) type
+#define CULL_FUNCTION
+#endif
+
+#define CULL_GROUP_SIZE 256
+static const uint COMMAND_WORDS = 16;
+
+struct CullObject
+{
+    float4 Sphere;
+    uint Command[COMMAND_WORDS];
+};
+
+struct CullConstants
+{
+    float4 Planes[6];
+    uint ObjectCount;
+    uint Padding[3];
+};
+
+CULL_FUNCTION bool IsSphereVisible(CULL_IN(CullConstants) constants, CULL_IN(float4) sphere)
+{
+    for (uint i = 0; i < 6; i++)
+    {
+        CULL_PRECISE float distance = constants.Planes[i].x * sphere.x;
+        distance = distance + constants.Planes[i].y * sphere.y;
+        distance = distance + constants.Planes[i].z * sphere.z;
+        distance = distance + constants.Planes[i].w;
+        if (distance < -sphere.w)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+#include <d3d12.h>
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+#include "ComPtr.h"
+#include "IndirectCull.hlsli"
+
+// ExecuteIndirectの1描画分の引数（コマンドシグネチャの引数と同じ順に詰めて並べる）
+// 頂点・インデックスバッファ、マテリアル番号、インスタンスの先頭番号を描画ごとに切り替える
+struct IndirectCommand
+{
+	D3D12_VERTEX_BUFFER_VIEW VertexBuffer;
+	D3D12_INDEX_BUFFER_VIEW IndexBuffer;
+	uint32_t Material; // ルート定数(b3)
+	uint32_t FirstInstance; // ルート定数(b4)
+	D3D12_DRAW_INDEXED_ARGUMENTS Draw;
+	uint32_t Padding; // 次のコマンドのアドレスを8バイト境界に揃える
+};
+static_assert(sizeof(IndirectCommand) == IndirectCull::COMMAND_WORDS * sizeof(uint32_t), "IndirectCull.hlsliのCOMMAND_WORDSと合わせる");
+
+// 境界球による視錐台カリングと描画コマンドの詰め込みをコンピュートシェーダーで行い、ExecuteIndirectで描く
+// 判定はIndirectCull.hlsliをHLSLとC++で共有し、同じ順に同じ演算をするので、CullOnCpuの結果はGPUとビット単位で一致する
+// GPUは1グループで物体の順に詰めるので、出力されるコマンドの順番も同じになる
+class IndirectCuller
+{
+public:
+	// drawRootSignatureはコマンドが切り替えるルート定数を持つ描画用のもの
+	bool Init(ID3D12RootSignature* drawRootSignature, ID3DBlob* cullShader, const std::vector<IndirectCull::CullObject>& objects);
+
+	// コマンドバッファと描画数を書き込む（どちらもUAVの状態で呼ぶ）
+	void Cull(ID3D12GraphicsCommandList* commandList, D3D12_GPU_VIRTUAL_ADDRESS constants);
+	// 描画用のルートシグネチャ・パイプライン・共通のルート引数を設定してから呼ぶ
+	void Draw(ID3D12GraphicsCommandList* commandList);
+
+	// 結果をリードバックバッファにコピーする（コピー元の状態で呼ぶ）
+	void CopyResults(ID3D12GraphicsCommandList* commandList);
+	// コピーした結果をCPUで同じ定数から求めたものと比べる（GPUがコピーを終えてから呼ぶ）
+	bool VerifyResults(const IndirectCull::CullConstants& constants, uint32_t* pVisibleCount);
+
+	ID3D12Resource* CommandBuffer() const { return m_pCommandBuffer.Get(); }
+	ID3D12Resource* CountBuffer() const { return m_pCountBuffer.Get(); }
+	uint32_t ObjectCount() const { return static_cast<uint32_t>(m_Objects.size()); }
+
+	// デバイスを使わない部分 ------------------------------------------------------------
+	// view * projectionから視錐台の6平面を取り出す（法線は内向きで正規化済み）
+	static IndirectCull::CullConstants MakeConstants(DirectX::FXMMATRIX viewProjection, uint32_t objectCount);
+	static IndirectCull::CullObject MakeObject(const DirectX::XMFLOAT3& center, float radius, const IndirectCommand& command);
+	// GPUと同じ判定と詰め込み。commandsには見えた物体のコマンドをCOMMAND_WORDS個ずつ詰め、見えた数を返す
+	static uint32_t CullOnCpu(const IndirectCull::CullConstants& constants, const std::vector<IndirectCull::CullObject>& objects, std::vector<uint32_t>& commands);
+
+private:
+	std::vector<IndirectCull::CullObject> m_Objects;
+	ComPtr<ID3D12RootSignature> m_pCullRootSignature;
+	ComPtr<ID3D12PipelineState> m_pCullPipeline;
+	ComPtr<ID3D12CommandSignature> m_pCommandSignature;
+	ComPtr<ID3D12Resource> m_pObjectBuffer; // アップロードヒープ（物体は動かさないので初期化時に一度だけ書く。--moving-objectsとはScene::Initで併用させない）
+	ComPtr<ID3D12Resource> m_pCommandBuffer;
+	ComPtr<ID3D12Resource> m_pCountBuffer;
+	ComPtr<ID3D12Resource> m_pReadbackBuffer; // コマンドの後に描画数を置く
+};
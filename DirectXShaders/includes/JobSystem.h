@@ -0,0 +1,127 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Job;
+
+// 残りのジョブ数。0になったら待っている側が進め、後に続くジョブが投入される
+class JobCounter
+{
+public:
+	JobCounter() = default;
+	// 最後のジョブがカウンターを触り終えるまでは終わっていない扱いにする
+	bool IsDone() const { return m_Count.load(std::memory_order_seq_cst) == 0 && m_Busy.load(std::memory_order_seq_cst) == 0; }
+
+	JobCounter(const JobCounter&) = delete;
+	void operator = (const JobCounter&) = delete;
+
+private:
+	friend class JobSystem;
+	std::atomic<int> m_Count = 0;
+	std::atomic<int> m_Busy = 0; // Finishの途中のスレッド数
+	std::mutex m_Mutex;
+	std::vector<Job*> m_Continuations; // このカウンターが0になったら投入するジョブ
+};
+
+// Chase-Levの両端キュー。持ち主のスレッドだけが末尾に積んで取り出し、他のスレッドは先頭から盗む
+class WorkStealingDeque
+{
+public:
+	WorkStealingDeque();
+	~WorkStealingDeque();
+
+	void Push(Job* pJob); // 持ち主のみ
+	Job* Pop(); // 持ち主のみ
+	Job* Steal(); // どのスレッドからでも
+	bool IsEmpty() const;
+
+	WorkStealingDeque(const WorkStealingDeque&) = delete;
+	void operator = (const WorkStealingDeque&) = delete;
+
+private:
+	struct Buffer
+	{
+		int64_t Capacity;
+		std::atomic<Job*>* pItems;
+
+		Job* Get(int64_t index) const { return pItems[index & (Capacity - 1)].load(std::memory_order_relaxed); }
+		void Put(int64_t index, Job* pJob) { pItems[index & (Capacity - 1)].store(pJob, std::memory_order_relaxed); }
+	};
+
+	Buffer* Grow(Buffer* pOld, int64_t bottom, int64_t top);
+
+	std::atomic<int64_t> m_Top = 0;
+	std::atomic<int64_t> m_Bottom = 0;
+	std::atomic<Buffer*> m_pBuffer = nullptr;
+	std::vector<Buffer*> m_Retired; // 盗む側がまだ読んでいるかもしれないので、古いバッファは最後まで残す
+};
+
+// ワークスティーリングのジョブシステム
+// スレッドごとに両端キューを持ち、自分のキューが空になったら他のスレッドから盗む
+// Initを呼んだスレッド（メインスレッド）も0番のワーカーとして扱い、Waitの間は他のジョブを手伝う
+class JobSystem
+{
+public:
+	typedef std::function<void()> Function;
+
+	JobSystem() = default;
+	~JobSystem();
+
+	void Init(uint32_t workerCount = 0); // 0ならコア数に合わせる（呼び出したスレッドも含む）
+	void Shutdown();
+	uint32_t WorkerCount() const { return static_cast<uint32_t>(m_Queues.size()); }
+
+	// funcを投入する。counterが指定されていれば、終わったときに1減らす
+	void Run(Function func, JobCounter* pCounter = nullptr);
+	// dependencyが0になってからfuncを投入する
+	void RunAfter(JobCounter& dependency, Function func, JobCounter* pCounter = nullptr);
+	// counterが0になるまで、他のジョブを実行しながら待つ
+	void Wait(JobCounter& counter);
+
+	// [begin, end)をgrain個ずつに分けてfunc(begin, end)を並列に呼び、全て終わるまで待つ
+	void ParallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& func);
+
+	// 統計（計測用）
+	uint64_t ExecutedCount() const { return m_Executed.load(std::memory_order_relaxed); }
+	uint64_t StolenCount() const { return m_Stolen.load(std::memory_order_relaxed); }
+
+	// 入れ子のParallelForとRunAfterの連鎖をrounds回繰り返し、全ての要素と段が1回ずつ実行されたこと、
+	// 実行したジョブの数がExecutedCountと合うことを確かめる（他のジョブが動いていない時に呼ぶ）
+	bool RunStressTest(uint32_t rounds);
+
+	JobSystem(const JobSystem&) = delete;
+	void operator = (const JobSystem&) = delete;
+
+private:
+	void Push(Job* pJob);
+	Job* FindJob(uint32_t worker);
+	void Execute(Job* pJob);
+	void Finish(JobCounter* pCounter);
+	void WorkerMain(uint32_t worker);
+	uint32_t CurrentWorker() const;
+
+	std::vector<WorkStealingDeque*> m_Queues;
+	std::vector<std::thread> m_Threads;
+	std::atomic<bool> m_IsRunning = false;
+
+	// ワーカー以外のスレッドから投入されたジョブ
+	std::mutex m_InjectMutex;
+	std::vector<Job*> m_Injected;
+
+	// 仕事が無いワーカーを眠らせる
+	std::mutex m_SleepMutex;
+	std::condition_variable m_WakeUp;
+	std::atomic<int> m_Sleeping = 0;
+	std::atomic<int64_t> m_Queued = 0; // 投入されてまだ取り出されていないジョブの数
+
+	std::atomic<uint64_t> m_Executed = 0;
+	std::atomic<uint64_t> m_Stolen = 0;
+};
+
+extern JobSystem* g_JobSystem;
@@ -0,0 +1,96 @@
+#pragma once
+#include "ConstantRing.h"
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// 物体ごとの定数（InstanceDataなど）を、フレームをまたいで残すGPUのバッファ（デフォルトヒープ）に物体の番号の順で持つ
+// 値はCPUの写しに書いて印を付け、Uploadで印の付いた物体だけをフレームのリングバッファに詰めて、RecordCopiesでまとめてコピーする
+// 印の付いた物体が近くに並んでいれば1回のコピーにまとめる（間の印の無い物体もMERGE_GAP個までは一緒に送る）
+// 印は物体ごとに1バイトなので、違う物体ならジョブから並列に書いていい。Uploadとは同時に呼ばない
+// Backendは描画APIのバックエンド（Rhi.h）
+template<typename Backend>
+class BasicObjectBuffer
+{
+public:
+	enum : uint32_t
+	{
+		MERGE_GAP = 2,
+	};
+
+	// コピー先はこのバッファの先頭から、コピー元はリングバッファの先頭から
+	struct Copy
+	{
+		uint64_t DestOffset;
+		uint64_t SourceOffset;
+		uint64_t Size;
+	};
+
+	struct Stats
+	{
+		uint32_t DirtyObjects; // 最後のUploadで印の付いていた物体
+		uint32_t SentObjects; // まとめた間の物体を含めて送った物体
+		uint32_t CopyCount;
+		uint64_t UploadBytes;
+	};
+
+	// 全ての物体に印を付けておく（最初のUploadで全て送る）
+	bool Init(uint32_t count, uint32_t stride);
+	bool IsValid() const { return m_IsValid; }
+	uint32_t Count() const { return m_Count; }
+	uint32_t Stride() const { return m_Stride; }
+
+	const void* Data(uint32_t object) const { return m_Shadow.data() + static_cast<size_t>(object) * m_Stride; }
+	template<typename T>
+	void Write(uint32_t object, const T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "memcpyで送れる型にする");
+		memcpy(m_Shadow.data() + static_cast<size_t>(object) * m_Stride, &value, sizeof(T) < m_Stride ? sizeof(T) : m_Stride);
+		m_Dirty[object] = 1;
+	}
+	void MarkDirty(uint32_t object) { m_Dirty[object] = 1; }
+	void MarkAllDirty();
+
+	// 印の付いた物体をringに詰めてコピーの一覧を作り、印を消す。ringに入らなければ印を残してfalse
+	bool Upload(BasicConstantRing<Backend>* ring);
+
+	// Uploadで作ったコピーを記録する（このバッファはコピー先の状態にしておく）
+	template<typename CommandList>
+	void RecordCopies(CommandList* commandList) const
+	{
+		for (auto& copy : m_Copies)
+		{
+			commandList->CopyBufferRegion(Resource(), copy.DestOffset, m_pSource, copy.SourceOffset, copy.Size);
+		}
+	}
+
+	RhiGpuAddress GpuAddress() const { return m_Buffer.GpuAddress(); }
+	typename Backend::Resource* Resource() const { return m_Buffer.Resource(); }
+	const std::vector<Copy>& Copies() const { return m_Copies; }
+	// 最後のUploadで詰めた先（コピー元のCPUのアドレスが要る時に使う）
+	const ConstantAllocation& Staging() const { return m_Staging; }
+	const Stats& GetStats() const { return m_Stats; }
+
+private:
+	// 印の付いた物体の並び[Begin, End)
+	struct Run
+	{
+		uint32_t Begin;
+		uint32_t End;
+	};
+
+	bool m_IsValid = false;
+	typename Backend::Buffer m_Buffer;
+	uint32_t m_Count = 0;
+	uint32_t m_Stride = 0;
+	std::vector<uint8_t> m_Shadow;
+	std::vector<uint8_t> m_Dirty;
+	std::vector<Run> m_Runs;
+	std::vector<Copy> m_Copies;
+	ConstantAllocation m_Staging;
+	typename Backend::Resource* m_pSource = nullptr;
+	Stats m_Stats = {};
+};
+
+using ObjectBuffer = BasicObjectBuffer<RhiBackend>;
@@ -0,0 +1,124 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 物体を囲む箱（ワールド空間）
+struct OcclusionBounds
+{
+	float Min[3];
+	float Max[3];
+};
+
+// CPUで遮蔽物を低解像度の深度バッファにラスタライズし、描画の前に隠れている物体を除く（ソフトウェアのオクルージョンカリング）
+// 深度はピクセルごとには持たず、8x4ピクセルのタイルごとに「覆われたピクセルのマスク」と2つの深度だけを持つ
+//   Z0: タイルの全てのピクセルについて、一番手前の遮蔽物はこれより手前にある
+//   Z1: マスクのピクセルについて、一番手前の遮蔽物はこれより手前にある（マスクが埋まったらZ0に畳み込む）
+// どちらも遮蔽物の奥側の境界なので、物体の一番手前がそれより奥なら確実に隠れている（見える物を除くことは無い）
+// 深度は射影後のz/w（0が手前、1が奥）。行列はXMFLOAT4X4と同じ並びの行ベクトル（v * M）とする
+// 三角形の準備はAddOccluderを呼んだスレッドで行い、ラスタライズはタイルの行の帯ごとにジョブシステムで並列に行う
+// 判定（IsOccluded）はバッファを読むだけなので、Rasterizeの後なら複数のスレッドから呼べる。デバイスを使わないので、Windows以外でも動く
+class OcclusionCuller
+{
+public:
+	// 浮動小数点の座標とも計算するので、列挙子ではなく整数の定数にする
+	static constexpr int TILE_WIDTH = 8;
+	static constexpr int TILE_HEIGHT = 4;
+	static constexpr int BLOCK_TILES = 4; // 階層の上の段は4x4タイルごとの一番奥の深度
+	static constexpr int DEFAULT_WIDTH = 320;
+	static constexpr int DEFAULT_HEIGHT = 192;
+	static constexpr int BAND_TILE_ROWS = 4; // 1つのジョブでラスタライズするタイルの行数
+
+	struct Stats
+	{
+		uint32_t OccluderTriangles; // AddOccluderに渡された三角形
+		uint32_t RasterizedTriangles; // 切り取りで分かれた分も含めて、実際にラスタライズした三角形
+		uint32_t TestedObjects;
+		uint32_t OccludedObjects;
+		double SetupTime; // AddOccluderの合計（ミリ秒）
+		double RasterizeTime;
+	};
+
+	// 幅と高さはタイルの倍数に切り上げる
+	void Init(uint32_t width, uint32_t height);
+	// バッファを空にし、このフレームの変換を設定する
+	void BeginFrame(const float viewProjection[16]);
+	// 遮蔽物を足す。positionsはstrideバイトおきのfloat3がvertexCount個、worldは3x4の行列で各行がワールド座標のx, y, z（InstanceData::Worldと同じ）
+	// worldがnullptrなら頂点はワールド空間にある。近い面で切れる三角形は切り取り、裏向きの三角形も描く（閉じていないメッシュも遮蔽物にできる）
+	void AddOccluder(const float* positions, size_t vertexCount, size_t stride, const uint32_t* indices, size_t indexCount, const float* world);
+	// 足した遮蔽物をラスタライズする。parallelならタイルの行の帯ごとにジョブシステムで並列に行う
+	void Rasterize(bool parallel = true);
+
+	// 箱が遮蔽物に完全に隠れていればtrue（画面の外や近すぎる物、判断できない物はfalse）
+	bool IsOccluded(const OcclusionBounds& bounds) const;
+	bool IsSphereOccluded(const float center[3], float radius) const;
+	// 判定の数を統計に足す（IsOccludedは統計を書かないので、呼んだ側でまとめて足す）
+	void CountTests(uint32_t tested, uint32_t occluded) { m_Stats.TestedObjects += tested; m_Stats.OccludedObjects += occluded; }
+
+	uint32_t Width() const { return m_Width; }
+	uint32_t Height() const { return m_Height; }
+	uint32_t TriangleCount() const { return static_cast<uint32_t>(m_Triangles.size()); }
+	const Stats& GetStats() const { return m_Stats; }
+	// ピクセル(x, y)の一番手前の遮蔽物の奥側の境界（確認用）
+	float PixelDepthBound(uint32_t x, uint32_t y) const;
+
+	// 箱の建物を格子状に並べた街を作り、通りの中からの視点での遮蔽の割合とラスタライズと判定の時間を出力する
+	// 結果はピクセルごとに深度を持つ単純なラスタライザと比べ、見える物を隠れていると判定していないことを確かめる
+	static bool RunBenchmark(uint32_t blocks, int iterations);
+
+	// 計測用の街。建物（遮蔽物と判定の対象の両方）と通りに置いた小物（判定の対象だけ）
+	struct TestScene
+	{
+		std::vector<float> Positions; // 建物の頂点（ワールド空間のfloat3）
+		std::vector<uint32_t> Indices;
+		std::vector<OcclusionBounds> Objects;
+		float ViewProjection[16];
+	};
+	static void MakeCity(uint32_t blocks, uint32_t seed, TestScene* pScene);
+
+private:
+	// 画面の座標に直し、辺と深度の平面の式まで求めた三角形
+	struct Triangle
+	{
+		float EdgeA[3], EdgeB[3], EdgeC[3]; // 辺の関数 A * x + B * y + C が3つとも0以上なら内側
+		float DepthA, DepthB, DepthC; // 深度の平面 z = A * x + B * y + C
+		float MinDepth, MaxDepth;
+		int32_t MinTileX, MaxTileX, MinTileY, MaxTileY;
+	};
+
+	// 箱を画面に投影した範囲（ピクセルの番号、両端を含む）と一番手前の深度
+	struct ScreenRect
+	{
+		int32_t MinX, MaxX, MinY, MaxY;
+		float NearDepth;
+	};
+
+	struct Tile
+	{
+		uint32_t Mask;
+		float Z0;
+		float Z1;
+	};
+
+	void SetupTriangle(const float screen[3][3]);
+	bool ProjectBounds(const OcclusionBounds& bounds, ScreenRect* pRect) const;
+	void RasterizeBand(uint32_t band);
+	void RasterizeTriangle(const Triangle& triangle, int32_t minTileY, int32_t maxTileY);
+	static void UpdateTile(Tile& tile, uint32_t coverage, float depth);
+	float TileDepthBound(const Tile& tile, uint32_t pixels) const;
+
+	uint32_t m_Width = 0;
+	uint32_t m_Height = 0;
+	uint32_t m_TilesX = 0;
+	uint32_t m_TilesY = 0;
+	uint32_t m_BlocksX = 0;
+	uint32_t m_BlocksY = 0;
+	uint32_t m_BandCount = 0;
+	float m_ViewProjection[16] = {};
+	std::vector<Tile> m_Tiles;
+	std::vector<float> m_BlockDepths; // 4x4タイルごとのZ0の最大（これより奥の物はそのブロックの中では隠れている）
+	std::vector<Triangle> m_Triangles;
+	std::vector<std::vector<uint32_t>> m_Bands; // 帯ごとに、掛かる三角形の番号
+	std::vector<float> m_Clip; // AddOccluderで変換した頂点（x, y, z, w）
+	Stats m_Stats = {};
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <d3d12.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ComPtr.h"
+#include "PipelineKey.h"
+
+// ルートシグネチャとパイプラインステートのキャッシュ
+// プロセス内では記述の中身を並べたキー（PipelineKey.h）で重複を除き、
+// コンパイル済みのPSOはID3D12PipelineLibraryでファイルに保存して次回の起動で再利用する
+class PipelineCache
+{
+public:
+	bool Init(ID3D12Device1* device, const wchar_t* path);
+	void SetEnabled(bool enabled) { m_IsEnabled = enabled; }
+	bool Save();
+
+	ComPtr<ID3D12RootSignature> GetRootSignature(const void* blob, size_t size);
+	ComPtr<ID3D12PipelineState> GetGraphicsPipeline(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+	ComPtr<ID3D12PipelineState> GetComputePipeline(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc);
+
+	void PrintStats() const;
+
+private:
+	struct FileHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t DriverHash; // アダプタとドライバのバージョン。変わったらファイルごと捨てる
+		uint64_t DataSize;
+	};
+
+	uint64_t QueryDriverHash(ID3D12Device1* device);
+	bool LoadFromFile();
+	PipelineKey FindRootSignatureKey(ID3D12RootSignature* rootSignature) const;
+	// キャッシュとライブラリから探し、無ければcreateで作る（loadとcreateはHRESULTを返す）
+	template<typename Load, typename Create>
+	ComPtr<ID3D12PipelineState> GetPipeline(PipelineKey&& key, Load&& load, Create&& create);
+
+	bool m_IsEnabled = true;
+	ComPtr<ID3D12Device1> m_pDevice;
+	ComPtr<ID3D12PipelineLibrary> m_pLibrary;
+	std::vector<char> m_LibraryData; // ライブラリが生きている間は保持しておく必要がある
+	std::wstring m_Path;
+	uint64_t m_DriverHash = 0;
+	bool m_IsDirty = false;
+
+	PipelineKeyMap<ComPtr<ID3D12RootSignature>> m_RootSignatures;
+	std::unordered_map<ID3D12RootSignature*, PipelineKey> m_RootSignatureKeys;
+	PipelineKeyMap<ComPtr<ID3D12PipelineState>> m_Pipelines;
+
+	// 統計
+	UINT m_RootSignatureRequests = 0;
+	UINT m_RootSignatureHits = 0;
+	UINT m_PipelineRequests = 0;
+	UINT m_PipelineHits = 0; // プロセス内で再利用した数
+	UINT m_LibraryHits = 0; // ファイルから読み込めた数
+	double m_PipelineCreateTime = 0.0; // ミリ秒
+};
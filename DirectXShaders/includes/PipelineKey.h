@@ -0,0 +1,170 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Hash.h"
+
+// パイプラインキャッシュのキー。記述の各メンバーを、ポインタではなく指している中身で並べたバイト列
+// ハッシュはバイト列のFNV-1aで、比較はバイト列で行うので、ハッシュが衝突しても別のPSOを返すことはない
+// 構造体をまとめて加えるとパディングの不定な値まで入るので、メンバーは1つずつ加える
+// デバイスを使わないので、D3D12の無い環境でも同じメンバーを持つ型で確かめられる
+class PipelineKey
+{
+public:
+	void Add(const void* data, size_t size);
+
+	template<typename T>
+	void Add(const T& value)
+	{
+		Add(&value, sizeof(T));
+	}
+
+	// 終端文字まで含めて加える（nullptrは空文字列として扱う）
+	void AddString(const char* str);
+	// 長さと中身を加える（長さ0やnullptrは中身を加えない）
+	void AddShader(const void* bytecode, size_t length);
+	// ルートシグネチャなど、他のキーを長さと中身で加える
+	void AddKey(const PipelineKey& key);
+
+	uint64_t Hash() const { return m_Hasher.Value(); }
+	const std::vector<uint8_t>& Bytes() const { return m_Bytes; }
+	std::wstring Name() const; // パイプラインライブラリでの名前（ハッシュの16進数）
+
+	bool operator==(const PipelineKey& other) const { return Hash() == other.Hash() && m_Bytes == other.m_Bytes; }
+	bool operator!=(const PipelineKey& other) const { return !(*this == other); }
+
+	// 記述のメンバーを1つずつ変えてキーが変わること、中身が同じならポインタが違っても同じキーになること、
+	// ハッシュを縮めて衝突させても引き当てを間違えないことを確かめる
+	static bool RunTest();
+
+private:
+	std::vector<uint8_t> m_Bytes;
+	Hasher m_Hasher;
+};
+
+struct PipelineKeyHash
+{
+	size_t operator()(const PipelineKey& key) const { return static_cast<size_t>(key.Hash()); }
+};
+
+template<typename T, typename KeyHash = PipelineKeyHash>
+using PipelineKeyMap = std::unordered_map<PipelineKey, T, KeyHash>;
+
+// ルートシグネチャはシリアライズしたバイナリがそのままキーになる
+inline PipelineKey MakeRootSignatureKey(const void* blob, size_t size)
+{
+	PipelineKey key;
+	key.Add(blob, size);
+	return key;
+}
+
+// DescはD3D12_GRAPHICS_PIPELINE_STATE_DESCか、同じ名前のメンバーを持つ型
+// pRootSignatureとCachedPSOは使わない（ルートシグネチャは中身のキーを別に渡す）
+// ストリーム出力は使っていないので数だけを加える
+template<typename Desc>
+PipelineKey MakeGraphicsPipelineKey(const Desc& desc, const PipelineKey& rootSignature)
+{
+	const uint32_t GraphicsTag = 0x50415247; // 'GRAP'
+
+	PipelineKey key;
+	key.Add(GraphicsTag);
+	key.AddKey(rootSignature);
+
+	for (auto shader : { &desc.VS, &desc.PS, &desc.DS, &desc.HS, &desc.GS })
+	{
+		key.AddShader(shader->pShaderBytecode, shader->BytecodeLength);
+	}
+
+	key.Add(desc.StreamOutput.NumEntries);
+
+	auto& blend = desc.BlendState;
+	key.Add(blend.AlphaToCoverageEnable);
+	key.Add(blend.IndependentBlendEnable);
+	for (auto& target : blend.RenderTarget)
+	{
+		key.Add(target.BlendEnable);
+		key.Add(target.LogicOpEnable);
+		key.Add(target.SrcBlend);
+		key.Add(target.DestBlend);
+		key.Add(target.BlendOp);
+		key.Add(target.SrcBlendAlpha);
+		key.Add(target.DestBlendAlpha);
+		key.Add(target.BlendOpAlpha);
+		key.Add(target.LogicOp);
+		key.Add(target.RenderTargetWriteMask);
+	}
+	key.Add(desc.SampleMask);
+
+	auto& rasterizer = desc.RasterizerState;
+	key.Add(rasterizer.FillMode);
+	key.Add(rasterizer.CullMode);
+	key.Add(rasterizer.FrontCounterClockwise);
+	key.Add(rasterizer.DepthBias);
+	key.Add(rasterizer.DepthBiasClamp);
+	key.Add(rasterizer.SlopeScaledDepthBias);
+	key.Add(rasterizer.DepthClipEnable);
+	key.Add(rasterizer.MultisampleEnable);
+	key.Add(rasterizer.AntialiasedLineEnable);
+	key.Add(rasterizer.ForcedSampleCount);
+	key.Add(rasterizer.ConservativeRaster);
+
+	auto& depthStencil = desc.DepthStencilState;
+	key.Add(depthStencil.DepthEnable);
+	key.Add(depthStencil.DepthWriteMask);
+	key.Add(depthStencil.DepthFunc);
+	key.Add(depthStencil.StencilEnable);
+	key.Add(depthStencil.StencilReadMask);
+	key.Add(depthStencil.StencilWriteMask);
+	for (auto face : { &depthStencil.FrontFace, &depthStencil.BackFace })
+	{
+		key.Add(face->StencilFailOp);
+		key.Add(face->StencilDepthFailOp);
+		key.Add(face->StencilPassOp);
+		key.Add(face->StencilFunc);
+	}
+
+	key.Add(desc.InputLayout.NumElements);
+	for (uint32_t i = 0; i < desc.InputLayout.NumElements; i++)
+	{
+		auto& element = desc.InputLayout.pInputElementDescs[i];
+		key.AddString(element.SemanticName);
+		key.Add(element.SemanticIndex);
+		key.Add(element.Format);
+		key.Add(element.InputSlot);
+		key.Add(element.AlignedByteOffset);
+		key.Add(element.InputSlotClass);
+		key.Add(element.InstanceDataStepRate);
+	}
+
+	key.Add(desc.IBStripCutValue);
+	key.Add(desc.PrimitiveTopologyType);
+	key.Add(desc.NumRenderTargets);
+	for (auto& format : desc.RTVFormats)
+	{
+		key.Add(format);
+	}
+	key.Add(desc.DSVFormat);
+	key.Add(desc.SampleDesc.Count);
+	key.Add(desc.SampleDesc.Quality);
+	key.Add(desc.NodeMask);
+	key.Add(desc.Flags);
+	return key;
+}
+
+// DescはD3D12_COMPUTE_PIPELINE_STATE_DESCか、同じ名前のメンバーを持つ型
+template<typename Desc>
+PipelineKey MakeComputePipelineKey(const Desc& desc, const PipelineKey& rootSignature)
+{
+	// 同じシェーダーのグラフィックスのPSOと区別する
+	const uint32_t ComputeTag = 0x504D4F43; // 'COMP'
+
+	PipelineKey key;
+	key.Add(ComputeTag);
+	key.AddKey(rootSignature);
+	key.AddShader(desc.CS.pShaderBytecode, desc.CS.BytecodeLength);
+	key.Add(desc.NodeMask);
+	key.Add(desc.Flags);
+	return key;
+}
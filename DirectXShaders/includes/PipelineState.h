@@ -1,26 +1,29 @@
 #pragma once
-#include "ComPtr.h"
-#include <d3dx12.h>
+#include "Rhi.h"
 #include <string>
 
-class PipelineState
+// Backendは描画APIのバックエンド（Rhi.h）。記述の持ち方と作り方はバックエンドごとに違う
+template<typename Backend>
+class BasicPipelineState
 {
 public:
-	PipelineState();
+	BasicPipelineState();
 	bool IsValid();
 
-	void SetInputLayout(D3D12_INPUT_LAYOUT_DESC layout);
-	void SetRootSignature(ID3D12RootSignature* rootSignature);
+	void SetInputLayout(RhiInputLayoutDesc layout);
+	void SetRootSignature(typename Backend::RootSignature* rootSignature);
 	void SetVertexShader(std::wstring path);
 	void SetPixelShader(std::wstring path);
+	void SetVertexShader(RhiShaderBlob* bytecode);
+	void SetPixelShader(RhiShaderBlob* bytecode);
 	void Create();
 
-	ID3D12PipelineState* Get();
+	typename Backend::PipelineState* Get();
 
 private:
 	bool m_IsValid = false;
-	D3D12_GRAPHICS_PIPELINE_STATE_DESC desc = {};
-	ComPtr<ID3D12PipelineState> m_pPipelineState;
-	ComPtr<ID3DBlob> m_pVSBlob;
-	ComPtr<ID3DBlob> m_pPSBlob;
-};
\ No newline at end of file
+	typename Backend::GraphicsPipelineDesc m_Desc = {};
+	typename Backend::template Ref<typename Backend::PipelineState> m_pPipelineState;
+};
+
+using PipelineState = BasicPipelineState<RhiBackend>;
@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+
+// 区間の計測。CPUとGPUの区間を1本のタイムラインに集め、Chrome/Perfettoのトレース形式(JSON)で書き出す
+// CPUの区間はスレッドごとのバッファにロックなしで書く（書くのはそのスレッドだけで、書き出す側は書き終えた数までしか読まない）
+// 無効の時はフラグを1回読むだけで何も記録しない。デバイスを使わないので、GPUの区間以外はWindows以外でも動く
+class Profiler
+{
+public:
+	enum { MAX_EVENTS_PER_THREAD = 1 << 16 }; // これを超えた区間は捨てる
+
+	static void SetEnabled(bool enabled) { s_IsEnabled.store(enabled, std::memory_order_relaxed); }
+	static bool IsEnabled() { return s_IsEnabled.load(std::memory_order_relaxed); }
+
+	// 時刻（ナノ秒）。SystemClock::Timestamp()をそのまま返す
+	static int64_t Now();
+
+	// 呼び出したスレッドの行に区間を足す。nameは書き出すまで有効な文字列にする
+	static void AddCpuEvent(const char* name, int64_t begin, int64_t end);
+	// GPUの区間を足す（時刻はNowと同じ時計に直したもの）。trackはタイムライン上の行の名前
+	static void AddGpuEvent(const char* track, const char* name, int64_t begin, int64_t end);
+	// 呼び出したスレッドの行の名前（最初の区間を記録する前に呼ぶ）
+	static void SetThreadName(const char* name);
+
+	static bool WriteChromeTrace(std::ostream& out);
+	static bool WriteChromeTrace(const std::filesystem::path& path);
+	static uint32_t EventCount(); // 記録した区間の数
+	static uint32_t DroppedCount(); // バッファがいっぱいで捨てた数
+
+	// 区間1つを記録する手間を無効・有効それぞれで測って出力する
+	static void MeasureOverhead();
+	// デバイスを使わずに複数のスレッドから区間を記録し、トレースを書き出す
+	static bool RunHeadlessTest(const std::filesystem::path& path);
+
+private:
+	static std::atomic<bool> s_IsEnabled;
+};
+
+// 作ってから破棄するまでを1つの区間として記録する
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name)
+		: m_Name(name), m_IsActive(Profiler::IsEnabled())
+	{
+		m_Begin = m_IsActive ? Profiler::Now() : 0;
+	}
+
+	~ProfileScope()
+	{
+		if (m_IsActive)
+		{
+			Profiler::AddCpuEvent(m_Name, m_Begin, Profiler::Now());
+		}
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	void operator = (const ProfileScope&) = delete;
+
+private:
+	const char* m_Name;
+	bool m_IsActive;
+	int64_t m_Begin;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 複数のコマンドキューとフェンスの進み方をCPUだけで模擬する（デバイスを使わない）
+// 各キューは積まれた順に1つずつ処理し、処理が終わるとそのキューのフェンスに1から順に値をシグナルする
+// Waitはそのキューに次に積む処理の開始を、他のキューのフェンスが値に達するまで遅らせる（ID3D12CommandQueue::Waitと同じ）
+class QueueModel
+{
+public:
+	uint32_t AddQueue(const char* name);
+
+	// CPUが時刻submitTimeにqueueへ長さdurationの処理を積み、シグナルされる値を返す（時間はミリ秒）
+	uint64_t Submit(uint32_t queue, double submitTime, double duration, const char* label);
+	// 次にSubmitする処理の前に、signalQueueのフェンスがvalueに達するのを待つ
+	void Wait(uint32_t queue, uint32_t signalQueue, uint64_t value);
+	// 次のSubmitでシグナルされる値
+	uint64_t NextValue(uint32_t queue) const;
+
+	// 時刻timeにqueueのフェンスが達している値（ID3D12Fence::GetCompletedValue）
+	uint64_t CompletedValue(uint32_t queue, double time);
+	// valueがシグナルされる時刻。まだ決まらない（待っている値がまだ積まれていない）なら負
+	double SignalTime(uint32_t queue, uint64_t value);
+
+	struct Work
+	{
+		std::string Label;
+		double SubmitTime;
+		double Duration;
+		std::vector<std::pair<uint32_t, uint64_t>> Waits; // 開始前に待つ（キュー, 値）
+		double Start; // 時刻が決まるまでは負
+		double End;
+		double StallTime; // 他のキューのフェンスを待って始められなかった時間
+	};
+
+	const std::vector<Work>& Works(uint32_t queue);
+	// 時刻が決まらない処理が残っているか（互いに待ち合っているとデッドロックになる）
+	bool HasUnresolved();
+
+private:
+	void Resolve(); // 始められる処理の時刻を順に決める
+
+	struct Queue
+	{
+		std::string Name;
+		std::vector<Work> Works;
+		std::vector<std::pair<uint32_t, uint64_t>> PendingWaits; // 次のSubmitに付ける待ち
+		size_t ResolvedCount = 0; // 時刻が決まった処理の数（=シグナル済みとして扱える値）
+	};
+	std::vector<Queue> m_Queues;
+};
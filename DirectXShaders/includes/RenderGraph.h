@@ -0,0 +1,173 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class RenderGraphExecutor;
+
+// パスが読み書きするリソースを宣言し、実行順・不要なパスの削除・バリア・一時リソースのメモリ配置を求める
+// コンパイルはデバイスを使わないので、GPUなしで確かめたり計測したりできる（D3D12への反映はRenderGraphExecutor）
+// パス間の依存は宣言順から決まる。あるパスの読み込みは、それより前に宣言された最後の書き込みの後になる
+class RenderGraph
+{
+public:
+	typedef uint32_t ResourceHandle;
+	typedef std::function<void(RenderGraphExecutor&)> ExecuteFunc;
+
+	enum { INVALID_RESOURCE = 0xffffffff };
+
+	// リソースの使い方。読み込み同士は組み合わせられる
+	enum Access : uint32_t
+	{
+		ACCESS_NONE = 0,
+		ACCESS_RENDER_TARGET = 1 << 0,
+		ACCESS_DEPTH_WRITE = 1 << 1,
+		ACCESS_UNORDERED_ACCESS = 1 << 2,
+		ACCESS_COPY_DEST = 1 << 3,
+		ACCESS_DEPTH_READ = 1 << 4,
+		ACCESS_PIXEL_SHADER = 1 << 5,
+		ACCESS_NON_PIXEL_SHADER = 1 << 6,
+		ACCESS_COPY_SOURCE = 1 << 7,
+		ACCESS_PRESENT = 1 << 8,
+		ACCESS_INDIRECT_ARGUMENT = 1 << 9, // ExecuteIndirectの引数と描画数
+
+		ACCESS_WRITE_MASK = ACCESS_RENDER_TARGET | ACCESS_DEPTH_WRITE | ACCESS_UNORDERED_ACCESS | ACCESS_COPY_DEST,
+	};
+
+	enum BarrierType
+	{
+		BARRIER_TRANSITION,
+		BARRIER_ALIASING, // AliasBeforeが使っていたメモリをResourceが使い始める
+		BARRIER_UAV,
+	};
+
+	struct Barrier
+	{
+		BarrierType Type;
+		ResourceHandle Resource;
+		ResourceHandle AliasBefore; // BARRIER_ALIASINGのみ
+		uint32_t Before;
+		uint32_t After;
+	};
+
+	// コンパイル後の実行単位。Barrierを発行し、Discardの一時リソースを初期化してからパスを実行する
+	struct Step
+	{
+		uint32_t Pass;
+		uint32_t BarrierBegin;
+		uint32_t BarrierCount;
+		uint32_t DiscardBegin;
+		uint32_t DiscardCount;
+	};
+
+	struct Stats
+	{
+		uint32_t PassCount;
+		uint32_t CulledPassCount;
+		uint32_t BarrierCount; // 最後の遷移も含む
+		uint32_t AliasingBarrierCount;
+		uint32_t TransientCount;
+		uint64_t TransientBytes; // 一時リソースを別々に確保した場合の合計
+		uint64_t HeapSize; // 寿命の重ならないものを重ねた後の大きさ
+	};
+
+	// 構築 ------------------------------------------------------------------------------
+	// グラフの外で作られたリソース。グラフの最後にfinalAccessへ戻し、書き込むパスは削除しない
+	ResourceHandle Import(const char* name, uint32_t initialAccess, uint32_t finalAccess);
+	// このグラフの中だけで使うリソース。sizeとalignmentはヒープに置く時の大きさ
+	ResourceHandle CreateTransient(const char* name, uint64_t size, uint64_t alignment);
+
+	uint32_t AddPass(const char* name, ExecuteFunc func);
+	void Read(uint32_t pass, ResourceHandle resource, uint32_t access);
+	void Write(uint32_t pass, ResourceHandle resource, uint32_t access);
+	// 出力が読まれなくても削除しない（Presentやデバッグ出力など）
+	void SetSideEffect(uint32_t pass);
+
+	// コンパイル ----------------------------------------------------------------------
+	bool Compile();
+
+	const std::vector<Step>& Steps() const { return m_Steps; }
+	const std::vector<Barrier>& Barriers() const { return m_Barriers; }
+	const std::vector<ResourceHandle>& Discards() const { return m_Discards; }
+	const std::vector<Barrier>& FinalBarriers() const { return m_FinalBarriers; } // グラフの最後に発行する
+	const ExecuteFunc& PassFunction(uint32_t pass) const { return m_Passes[pass].Func; }
+	const char* PassName(uint32_t pass) const { return m_Passes[pass].Name.c_str(); }
+	bool IsCulled(uint32_t pass) const { return m_Passes[pass].IsCulled; }
+
+	uint32_t ResourceCount() const { return static_cast<uint32_t>(m_Resources.size()); }
+	const char* ResourceName(ResourceHandle resource) const { return m_Resources[resource].Name.c_str(); }
+	bool IsImported(ResourceHandle resource) const { return m_Resources[resource].IsImported; }
+	bool IsUsed(ResourceHandle resource) const { return m_Resources[resource].FirstUse != UINT32_MAX; }
+	// 一時リソースのヒープ上の位置と、作る時の状態（フレームの最後の状態と同じにしておけば毎フレーム戻さなくていい）
+	uint64_t HeapOffset(ResourceHandle resource) const { return m_Resources[resource].HeapOffset; }
+	uint32_t CreationAccess(ResourceHandle resource) const { return m_Resources[resource].CreationAccess; }
+	uint64_t HeapSize() const { return m_Stats.HeapSize; }
+	const Stats& GetStats() const { return m_Stats; }
+	void PrintStats() const;
+
+	static bool IsReadOnly(uint32_t access) { return access != ACCESS_NONE && (access & ACCESS_WRITE_MASK) == 0 && access != ACCESS_PRESENT; }
+
+	// 後処理が連なるpassCount個のパスのグラフを作る（計測とテスト用。同じ種なら同じグラフになる）
+	// 約1/8のパスは出力が読まれないので削除される
+	static void BuildSyntheticGraph(RenderGraph& graph, uint32_t passCount, uint32_t seed);
+	// 手で求めた結果と比べる小さなグラフと、合成した大きなグラフのコンパイル結果を確かめる
+	static bool RunTest();
+
+private:
+	struct ResourceNode
+	{
+		std::string Name;
+		bool IsImported;
+		uint32_t InitialAccess;
+		uint32_t FinalAccess;
+		uint64_t Size;
+		uint64_t Alignment;
+
+		// コンパイル結果（FirstUseとLastUseは実行順の番号）
+		uint32_t FirstUse;
+		uint32_t LastUse;
+		uint32_t CreationAccess;
+		uint64_t HeapOffset;
+	};
+
+	struct PassUse
+	{
+		ResourceHandle Resource;
+		uint32_t Access;
+		bool IsWrite;
+	};
+
+	struct PassNode
+	{
+		std::string Name;
+		ExecuteFunc Func;
+		std::vector<PassUse> Uses;
+		bool HasSideEffect;
+		bool IsCulled;
+	};
+
+	struct ResourceUse
+	{
+		uint32_t Step;
+		uint32_t Access;
+		bool IsWrite;
+	};
+
+	void AddUse(uint32_t pass, ResourceHandle resource, uint32_t access, bool isWrite);
+	void SortPasses(const std::vector<std::vector<uint32_t>>& successors, const std::vector<bool>& needed);
+	void PlaceTransients();
+	void BuildBarriers(const std::vector<std::vector<ResourceUse>>& uses);
+	// コンパイル結果を実行順に追い、各パスの前にリソースが宣言通りの状態になっていること、
+	// 寿命の重なる一時リソースがヒープ上で重ならないこと、削除したパスの出力を誰も読まないことを確かめる
+	bool Validate() const;
+
+	std::vector<ResourceNode> m_Resources;
+	std::vector<PassNode> m_Passes;
+
+	std::vector<Step> m_Steps;
+	std::vector<Barrier> m_Barriers;
+	std::vector<ResourceHandle> m_Discards;
+	std::vector<Barrier> m_FinalBarriers;
+	Stats m_Stats = {};
+};
@@ -0,0 +1,80 @@
+#pragma once
+#include <d3d12.h>
+#include <vector>
+#include "ComPtr.h"
+#include "RenderGraph.h"
+
+class GpuProfiler;
+
+// RenderGraphのコンパイル結果をD3D12のリソースとバリアにして実行する
+// 一時リソースは1つのヒープに置き、寿命の重ならないもの同士で同じメモリを使う
+// ヒープはRT/DS専用なので、一時リソースにできるのはレンダーターゲットと深度バッファだけ
+class RenderGraphExecutor
+{
+public:
+	RenderGraphExecutor() = default;
+	~RenderGraphExecutor();
+
+	void Init(ID3D12Device* device, RenderGraph* graph);
+
+	// 一時テクスチャを宣言する。実体はCompileでヒープ上に作る
+	RenderGraph::ResourceHandle CreateTexture(const char* name, const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE* pClearValue = nullptr);
+	// 外部のリソースを宣言する。実体とビューは使う前にSetImportedで渡す（バックバッファのように毎フレーム変わってもいい）
+	RenderGraph::ResourceHandle Import(const char* name, uint32_t initialAccess, uint32_t finalAccess);
+	void SetImported(RenderGraph::ResourceHandle handle, ID3D12Resource* resource,
+		D3D12_CPU_DESCRIPTOR_HANDLE rtv = {}, D3D12_CPU_DESCRIPTOR_HANDLE dsv = {});
+
+	// グラフをコンパイルし、一時リソースを作り直す
+	bool Compile();
+	// 削除されなかったパスを順に実行する。各パスの前に必要なバリアだけをまとめて発行する
+	void Execute(ID3D12GraphicsCommandList* commandList);
+	// 外部のリソースを最後の状態に戻す（Executeとは別のリストに記録してもいい）
+	void FlushFinalBarriers(ID3D12GraphicsCommandList* commandList);
+	// パスごとにGPUの時間も測る（CPUの時間はProfilerが有効なら常に測る）
+	void SetProfiler(GpuProfiler* profiler) { m_pProfiler = profiler; }
+
+	// パスの中で使う。最初に取り出した時に、このリストでパスのGPUの区間を始める
+	ID3D12GraphicsCommandList* CommandList();
+	// パスの描画をワーカーのリストなど別のリストに記録する場合は、CommandListの代わりにこれらで区間を置く
+	// 記録を始める前にfirstの先頭で始め、全ての記録が終わった後にlastの最後で閉じる（どちらもパスを実行しているスレッドから呼ぶ）
+	void BeginGpuScopeOn(ID3D12GraphicsCommandList* first);
+	void EndGpuScopeOn(ID3D12GraphicsCommandList* last);
+	ID3D12Resource* Resource(RenderGraph::ResourceHandle handle) const { return m_Entries[handle].pResource; }
+	D3D12_CPU_DESCRIPTOR_HANDLE RenderTargetView(RenderGraph::ResourceHandle handle) const { return m_Entries[handle].Rtv; }
+	D3D12_CPU_DESCRIPTOR_HANDLE DepthStencilView(RenderGraph::ResourceHandle handle) const { return m_Entries[handle].Dsv; }
+
+	static D3D12_RESOURCE_STATES ToResourceState(uint32_t access);
+
+	RenderGraphExecutor(const RenderGraphExecutor&) = delete;
+	void operator = (const RenderGraphExecutor&) = delete;
+
+private:
+	struct Entry
+	{
+		ID3D12Resource* pResource = nullptr;
+		bool IsTransient = false;
+		D3D12_RESOURCE_DESC Desc = {};
+		bool HasClearValue = false;
+		D3D12_CLEAR_VALUE ClearValue = {};
+		D3D12_CPU_DESCRIPTOR_HANDLE Rtv = {};
+		D3D12_CPU_DESCRIPTOR_HANDLE Dsv = {};
+	};
+
+	bool CreateTransients();
+	void ReleaseTransients();
+	void AddBarriers(const RenderGraph::Barrier* pBarriers, uint32_t count);
+
+	ID3D12Device* m_pDevice = nullptr;
+	RenderGraph* m_pGraph = nullptr;
+	GpuProfiler* m_pProfiler = nullptr;
+	ID3D12GraphicsCommandList* m_pCommandList = nullptr;
+	const char* m_PassName = nullptr; // 実行中のパス
+	bool m_HasPassGpuScope = false; // このパスの区間を始めた（測っていないフレームでも立てる）
+	bool m_IsPassGpuScopeOnMainList = false;
+	UINT m_PassGpuScope = 0;
+	std::vector<Entry> m_Entries; // グラフのリソース番号と同じ並び
+	ComPtr<ID3D12Heap> m_pHeap = nullptr;
+	ComPtr<ID3D12DescriptorHeap> m_pRtvHeap = nullptr;
+	ComPtr<ID3D12DescriptorHeap> m_pDsvHeap = nullptr;
+	std::vector<D3D12_RESOURCE_BARRIER> m_Barriers; // 毎回確保しないよう使い回す
+};
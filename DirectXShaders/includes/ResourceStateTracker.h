@@ -0,0 +1,89 @@
+#pragma once
+#include "Rhi.h"
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// コマンドリストごとにリソースの状態を追跡し、必要なバリアを遅延してまとめて発行する
+// 状態の扱いはRhiTypes.hの型だけで書いてあり、デバイスには触れない（ヌルのバックエンドでGPUなしに確かめられる）
+// COMMONからの暗黙の昇格（バッファは全ての状態、テクスチャはシェーダーリソースとコピー）はバリアを出さず、
+// CommitFinalStatesで実行後の減衰（バッファと、読み取りに昇格したテクスチャはCOMMONに戻る）を反映する
+// Backendは描画APIのバックエンド（Rhi.h）
+template<typename Backend>
+class BasicResourceStateTracker
+{
+public:
+	using Resource = typename Backend::Resource;
+	using Barrier = typename Backend::ResourceBarrier;
+
+	// コマンドリストの実行が終わった後の状態（全コマンドリストで共有）を登録する
+	// isBufferならバッファ（同時アクセスのテクスチャも同じ）として昇格と減衰を扱う
+	static void Register(Resource* resource, RhiResourceStates state, UINT subresourceCount = 1, bool isBuffer = false);
+	static void Unregister(Resource* resource);
+	static bool GetKnownState(Resource* resource, UINT subresource, RhiResourceStates* pState);
+
+	// resourceを指定の状態にする。バリアはFlushBarriersまで溜めておく
+	void Transition(Resource* resource, RhiResourceStates after, UINT subresource = RHI_ALL_SUBRESOURCES);
+
+	// 分割バリアの開始。次に同じ状態へTransitionされた時に終了側のバリアを出す
+	// 分割バリアが無効の場合と、昇格で済む場合は通常のTransitionと同じ
+	void BeginTransition(Resource* resource, RhiResourceStates after, UINT subresource = RHI_ALL_SUBRESOURCES);
+
+	// 溜まっているバリアを1回のResourceBarrierで発行する（描画・コピーの直前に呼ぶ）
+	void FlushBarriers(typename Backend::CommandList* commandList);
+
+	// コマンドリストをExecuteした後に呼び、最終状態を共有の状態に反映する
+	void CommitFinalStates();
+	void Reset();
+
+	void SetSplitBarriersEnabled(bool enabled) { m_SplitBarriersEnabled = enabled; }
+	const std::vector<Barrier>& PendingBarriers() const { return m_PendingBarriers; }
+	UINT FlushCount() const { return m_FlushCount; }
+	UINT BarrierCount() const { return m_BarrierCount; }
+
+	// 合流、サブリソース、昇格と減衰、分割バリアの場合に溜まるバリアの並びを、手で求めたものと比べる
+	// ヌルのバッファをリソースに使うので、ヌルのバックエンドだけで定義する
+	static bool RunTest();
+
+private:
+	struct TrackedState
+	{
+		RhiResourceStates State = RHI_STATE_COMMON; // 全サブリソース共通の状態
+		std::vector<RhiResourceStates> Subresources; // サブリソースごとに異なる場合のみ使う
+		UINT SubresourceCount = 1;
+		bool IsBuffer = false;
+		bool Promoted = false; // このコマンドリストでCOMMONから暗黙に昇格した（全サブリソース共通の時だけ）
+
+		RhiResourceStates Get(UINT subresource) const;
+		bool IsUniform() const { return Subresources.empty(); }
+	};
+
+	struct SplitTransition
+	{
+		UINT Subresource;
+		RhiResourceStates Before;
+		RhiResourceStates After;
+	};
+
+	TrackedState* FindOrFetch(Resource* resource);
+	void AddBarrier(Resource* resource, UINT subresource, RhiResourceStates before, RhiResourceStates after, RhiBarrierFlags flags);
+	void ResolveTransition(Resource* resource, TrackedState& state, RhiResourceStates after, UINT subresource, RhiBarrierFlags flags);
+	void EndSplitTransition(Resource* resource);
+	static bool CanPromote(const TrackedState& state, RhiResourceStates after);
+	static void Decay(TrackedState& state);
+
+	bool m_SplitBarriersEnabled = false;
+	std::unordered_map<Resource*, TrackedState> m_States; // このコマンドリスト上での最新の状態
+	std::unordered_map<Resource*, SplitTransition> m_SplitTransitions;
+	std::vector<Barrier> m_PendingBarriers;
+	UINT m_FlushCount = 0;
+	UINT m_BarrierCount = 0;
+
+	static std::mutex s_Mutex;
+	static std::unordered_map<Resource*, TrackedState> s_KnownStates;
+};
+
+template<>
+bool BasicResourceStateTracker<NullBackend>::RunTest();
+
+using ResourceStateTracker = BasicResourceStateTracker<RhiBackend>;
@@ -0,0 +1,16 @@
+#pragma once
+#include "RhiTypes.h"
+#include "RhiNull.h"
+#ifdef RHI_HAS_D3D12
+#include "RhiD3D12.h"
+#endif
+
+// 描画APIの薄い層。バックエンドは型（D3D12Backend、NullBackend）で、使う側のクラスはバックエンドを引数に取るテンプレートにする
+// 呼び出しはコンパイル時に決まるので、描画ごとの呼び出しに仮想関数の手間は無い
+// RhiBackendはアプリが使うバックエンド。RHI_NULLを定義した時とD3D12が無い環境ではヌルになる
+// ヌルのバックエンドはどの環境でもコンパイルするので、D3D12のビルドからもGPUを使わない計測に使える
+#if defined(RHI_NULL) || !defined(RHI_HAS_D3D12)
+using RhiBackend = NullBackend;
+#else
+using RhiBackend = D3D12Backend;
+#endif
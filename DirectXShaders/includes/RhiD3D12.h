@@ -0,0 +1,52 @@
+#pragma once
+#include "RhiTypes.h"
+#include "ComPtr.h"
+#include <d3d12.h>
+
+// D3D12のバックエンド。デバイスはEngineが作ってSetDeviceで渡す
+
+class D3D12Buffer
+{
+public:
+	D3D12Buffer() = default;
+
+	bool Create(size_t size, RhiHeap heap);
+	void* Map();
+	void Unmap();
+	RhiGpuAddress GpuAddress() const;
+	size_t Size() const { return m_Size; }
+	ID3D12Resource* Resource() const { return m_pResource.Get(); }
+
+	D3D12Buffer(const D3D12Buffer&) = delete;
+	void operator = (const D3D12Buffer&) = delete;
+
+private:
+	ComPtr<ID3D12Resource> m_pResource;
+	size_t m_Size = 0;
+};
+
+// パイプラインの記述と、生成するまで参照を持っておくシェーダー
+struct D3D12PipelineDesc
+{
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc = {};
+	ComPtr<ID3DBlob> pVSBlob;
+	ComPtr<ID3DBlob> pPSBlob;
+};
+
+struct D3D12Backend
+{
+	using Buffer = D3D12Buffer;
+	using Resource = ID3D12Resource;
+	using ResourceBarrier = D3D12_RESOURCE_BARRIER;
+	using CommandList = ID3D12GraphicsCommandList;
+	using RootSignature = ID3D12RootSignature;
+	using PipelineState = ID3D12PipelineState;
+	using DescriptorHeap = ID3D12DescriptorHeap;
+	using GraphicsPipelineDesc = D3D12PipelineDesc;
+	template<typename T> using Ref = ComPtr<T>;
+
+	static const char* Name() { return "D3D12"; }
+
+	static void SetDevice(ID3D12Device* device);
+	static ID3D12Device* Device();
+};
@@ -0,0 +1,218 @@
+#pragma once
+#include "RhiTypes.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+// ヌルのバックエンド。GPUを使わず、バッファはCPUのメモリに割り当て、コマンドは記録するだけ
+// GPUの無い環境で、1フレームの記録にかかるCPUの時間や、割り当てと状態の扱いを確かめるのに使う
+
+// ヌルのオブジェクトはNullDeviceが持つので、参照は数えずにポインタだけを持つ（ComPtrと同じくGetで取り出す）
+template<typename T>
+class NullRef
+{
+public:
+	NullRef() = default;
+	NullRef(T* p) : m_p(p) {}
+	T* Get() const { return m_p; }
+	bool operator == (std::nullptr_t) const { return m_p == nullptr; }
+	bool operator != (std::nullptr_t) const { return m_p != nullptr; }
+
+private:
+	T* m_p = nullptr;
+};
+
+struct NullRootSignature
+{
+	uint32_t ParameterCount;
+};
+
+struct NullPipelineDesc
+{
+	NullRootSignature* pRootSignature = nullptr;
+	UINT InputElementCount = 0;
+	bool HasVertexShader = false;
+	bool HasPixelShader = false;
+};
+
+struct NullPipelineState
+{
+	NullPipelineDesc Desc;
+};
+
+struct NullDescriptorHeap
+{
+	RhiGpuDescriptor GpuStart;
+	UINT Count;
+};
+
+// オブジェクトを作り、割り当てを数える。作ったオブジェクトは終了まで残す（D3D12でのパイプラインキャッシュと同じ）
+// GPUのアドレスは重ならないように割り当てるだけで、指す先は無い
+class NullDevice
+{
+public:
+	static RhiGpuAddress AllocateAddress(size_t size);
+	static NullRootSignature* CreateRootSignature(uint32_t parameterCount);
+	static NullPipelineState* CreatePipelineState(const NullPipelineDesc& desc);
+	static NullDescriptorHeap* CreateDescriptorHeap(UINT count);
+
+	static void BufferCreated(size_t size);
+	static void BufferDestroyed(size_t size);
+	static uint64_t LiveBuffers();
+	static uint64_t LiveBytes();
+};
+
+class NullBuffer
+{
+public:
+	NullBuffer() = default;
+	~NullBuffer();
+
+	bool Create(size_t size, RhiHeap heap);
+	void* Map() { return m_pData.get(); }
+	void Unmap() {}
+	RhiGpuAddress GpuAddress() const { return m_Address; }
+	size_t Size() const { return m_Size; }
+	// コピーのコマンドで指すリソース（D3D12BufferのResourceと同じく、constでも書き込める先を返す）
+	NullBuffer* Resource() const { return const_cast<NullBuffer*>(this); }
+
+	NullBuffer(const NullBuffer&) = delete;
+	void operator = (const NullBuffer&) = delete;
+
+private:
+	std::unique_ptr<uint8_t[]> m_pData;
+	size_t m_Size = 0;
+	RhiGpuAddress m_Address = 0;
+};
+
+// D3D12_RESOURCE_BARRIERの遷移のバリアと同じ名前のメンバーを持つ
+struct NullResourceBarrier
+{
+	RhiBarrierType Type;
+	RhiBarrierFlags Flags;
+	struct
+	{
+		NullBuffer* pResource;
+		UINT Subresource;
+		RhiResourceStates StateBefore;
+		RhiResourceStates StateAfter;
+	} Transition;
+};
+
+enum NullCommandType : uint8_t
+{
+	NULL_COMMAND_SET_ROOT_SIGNATURE,
+	NULL_COMMAND_SET_PIPELINE_STATE,
+	NULL_COMMAND_SET_DESCRIPTOR_HEAPS,
+	NULL_COMMAND_SET_ROOT_CBV,
+	NULL_COMMAND_SET_ROOT_SRV,
+	NULL_COMMAND_SET_ROOT_TABLE,
+	NULL_COMMAND_SET_ROOT_CONSTANT,
+	NULL_COMMAND_SET_TOPOLOGY,
+	NULL_COMMAND_SET_VERTEX_BUFFERS,
+	NULL_COMMAND_SET_INDEX_BUFFER,
+	NULL_COMMAND_SET_RENDER_TARGETS,
+	NULL_COMMAND_DRAW,
+	NULL_COMMAND_DRAW_INDEXED,
+	NULL_COMMAND_COPY_BUFFER,
+	NULL_COMMAND_RESOURCE_BARRIER,
+	NULL_COMMAND_COUNT,
+};
+
+struct NullCommand
+{
+	NullCommandType Type;
+	uint64_t Args[3];
+};
+
+// ID3D12GraphicsCommandListと同じ名前と引数で、呼ばれたコマンドを順に記録する（CommandListFilterのTに使える）
+class NullCommandList
+{
+public:
+	void Reset() { m_Commands.clear(); m_IsClosed = false; }
+	void Close() { m_IsClosed = true; }
+	bool IsClosed() const { return m_IsClosed; }
+
+	void SetGraphicsRootSignature(NullRootSignature* pRootSignature) { Push(NULL_COMMAND_SET_ROOT_SIGNATURE, Id(pRootSignature)); }
+	void SetPipelineState(NullPipelineState* pPipelineState) { Push(NULL_COMMAND_SET_PIPELINE_STATE, Id(pPipelineState)); }
+	void SetDescriptorHeaps(UINT count, NullDescriptorHeap* const* ppHeaps) { Push(NULL_COMMAND_SET_DESCRIPTOR_HEAPS, count, count > 0 ? Id(ppHeaps[0]) : 0); }
+	void SetGraphicsRootConstantBufferView(UINT index, RhiGpuAddress address) { Push(NULL_COMMAND_SET_ROOT_CBV, index, address); }
+	void SetGraphicsRootShaderResourceView(UINT index, RhiGpuAddress address) { Push(NULL_COMMAND_SET_ROOT_SRV, index, address); }
+	void SetGraphicsRootDescriptorTable(UINT index, RhiGpuDescriptor handle) { Push(NULL_COMMAND_SET_ROOT_TABLE, index, handle.ptr); }
+	void SetGraphicsRoot32BitConstant(UINT index, UINT value, UINT offset) { Push(NULL_COMMAND_SET_ROOT_CONSTANT, index, value, offset); }
+	void IASetPrimitiveTopology(RhiPrimitiveTopology topology) { Push(NULL_COMMAND_SET_TOPOLOGY, topology); }
+
+	void IASetVertexBuffers(UINT startSlot, UINT count, const RhiVertexBufferView* pViews)
+	{
+		Push(NULL_COMMAND_SET_VERTEX_BUFFERS, startSlot, count, pViews != nullptr && count > 0 ? pViews[0].BufferLocation : 0);
+	}
+
+	void IASetIndexBuffer(const RhiIndexBufferView* pView)
+	{
+		Push(NULL_COMMAND_SET_INDEX_BUFFER, pView != nullptr ? pView->BufferLocation : 0, pView != nullptr ? pView->SizeInBytes : 0);
+	}
+
+	// 先頭のハンドルだけを記録する（範囲の指定かどうかは記録しない）
+	void OMSetRenderTargets(UINT count, const RhiCpuDescriptor* pRtvs, BOOL /*singleHandleToRange*/, const RhiCpuDescriptor* pDsv)
+	{
+		Push(NULL_COMMAND_SET_RENDER_TARGETS, count, count > 0 ? pRtvs[0].ptr : 0, pDsv != nullptr ? pDsv->ptr : 0);
+	}
+
+	void DrawInstanced(UINT vertexCount, UINT instanceCount, UINT startVertex, UINT startInstance)
+	{
+		Push(NULL_COMMAND_DRAW, vertexCount, instanceCount, (static_cast<uint64_t>(startVertex) << 32) | startInstance);
+	}
+
+	// 頂点番号に足す値は記録しない（メッシュは全て頂点番号0から始まる）
+	void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT /*baseVertex*/, UINT startInstance)
+	{
+		Push(NULL_COMMAND_DRAW_INDEXED, indexCount, instanceCount, (static_cast<uint64_t>(startIndex) << 32) | startInstance);
+	}
+
+	// 記録するのはコピー先と元のアドレスと大きさだけ（中身は動かさない）
+	void CopyBufferRegion(NullBuffer* pDest, UINT64 destOffset, NullBuffer* pSource, UINT64 sourceOffset, UINT64 size)
+	{
+		Push(NULL_COMMAND_COPY_BUFFER, pDest->GpuAddress() + destOffset, pSource->GpuAddress() + sourceOffset, size);
+	}
+
+	// バリアはまとめた数と先頭のリソースだけを記録する
+	void ResourceBarrier(UINT count, const NullResourceBarrier* pBarriers)
+	{
+		Push(NULL_COMMAND_RESOURCE_BARRIER, count, count > 0 ? Id(pBarriers[0].Transition.pResource) : 0);
+	}
+
+	const std::vector<NullCommand>& Commands() const { return m_Commands; }
+	uint32_t Count(NullCommandType type) const;
+	// 記録したコマンドを1行ずつ書き出す（maxCommandsを超えた分は数だけ）
+	void Dump(std::ostream& out, size_t maxCommands) const;
+	static const char* Name(NullCommandType type);
+
+private:
+	template<typename P>
+	static uint64_t Id(P* p) { return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(p)); }
+
+	void Push(NullCommandType type, uint64_t a = 0, uint64_t b = 0, uint64_t c = 0)
+	{
+		m_Commands.push_back({ type, { a, b, c } });
+	}
+
+	std::vector<NullCommand> m_Commands; // Resetしても容量は残すので、同じリストを使い回せば確保は最初だけ
+	bool m_IsClosed = false;
+};
+
+struct NullBackend
+{
+	using Buffer = NullBuffer;
+	using Resource = NullBuffer;
+	using ResourceBarrier = NullResourceBarrier;
+	using CommandList = NullCommandList;
+	using RootSignature = NullRootSignature;
+	using PipelineState = NullPipelineState;
+	using DescriptorHeap = NullDescriptorHeap;
+	using GraphicsPipelineDesc = NullPipelineDesc;
+	template<typename T> using Ref = NullRef<T>;
+
+	static const char* Name() { return "Null"; }
+};
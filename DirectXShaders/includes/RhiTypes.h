@@ -0,0 +1,159 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// 描画APIの層（Rhi.h）で使う値の型。バックエンドに依らず同じ型を使う
+// WindowsではD3D12の型そのもの（D3D12のバックエンドに渡す時に変換しない）
+// D3D12が無い環境では、同じ名前のメンバーを持つ型を用意してヌルのバックエンドだけを使う
+#ifdef _WIN32
+#define RHI_HAS_D3D12 1
+#include <d3d12.h>
+
+using RhiGpuAddress = D3D12_GPU_VIRTUAL_ADDRESS;
+using RhiVertexBufferView = D3D12_VERTEX_BUFFER_VIEW;
+using RhiIndexBufferView = D3D12_INDEX_BUFFER_VIEW;
+using RhiConstantBufferViewDesc = D3D12_CONSTANT_BUFFER_VIEW_DESC;
+using RhiCpuDescriptor = D3D12_CPU_DESCRIPTOR_HANDLE;
+using RhiGpuDescriptor = D3D12_GPU_DESCRIPTOR_HANDLE;
+using RhiPrimitiveTopology = D3D12_PRIMITIVE_TOPOLOGY;
+using RhiFormat = DXGI_FORMAT;
+using RhiInputElementDesc = D3D12_INPUT_ELEMENT_DESC;
+using RhiInputLayoutDesc = D3D12_INPUT_LAYOUT_DESC;
+using RhiShaderBlob = ID3DBlob;
+
+const RhiFormat RHI_FORMAT_R32_UINT = DXGI_FORMAT_R32_UINT;
+const RhiPrimitiveTopology RHI_TOPOLOGY_UNDEFINED = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+const RhiPrimitiveTopology RHI_TOPOLOGY_TRIANGLELIST = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+using RhiResourceStates = D3D12_RESOURCE_STATES;
+using RhiBarrierType = D3D12_RESOURCE_BARRIER_TYPE;
+using RhiBarrierFlags = D3D12_RESOURCE_BARRIER_FLAGS;
+
+const RhiResourceStates RHI_STATE_COMMON = D3D12_RESOURCE_STATE_COMMON;
+const RhiResourceStates RHI_STATE_VERTEX_AND_CONSTANT_BUFFER = D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+const RhiResourceStates RHI_STATE_INDEX_BUFFER = D3D12_RESOURCE_STATE_INDEX_BUFFER;
+const RhiResourceStates RHI_STATE_RENDER_TARGET = D3D12_RESOURCE_STATE_RENDER_TARGET;
+const RhiResourceStates RHI_STATE_UNORDERED_ACCESS = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+const RhiResourceStates RHI_STATE_DEPTH_WRITE = D3D12_RESOURCE_STATE_DEPTH_WRITE;
+const RhiResourceStates RHI_STATE_DEPTH_READ = D3D12_RESOURCE_STATE_DEPTH_READ;
+const RhiResourceStates RHI_STATE_NON_PIXEL_SHADER_RESOURCE = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+const RhiResourceStates RHI_STATE_PIXEL_SHADER_RESOURCE = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+const RhiResourceStates RHI_STATE_INDIRECT_ARGUMENT = D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT;
+const RhiResourceStates RHI_STATE_COPY_DEST = D3D12_RESOURCE_STATE_COPY_DEST;
+const RhiResourceStates RHI_STATE_COPY_SOURCE = D3D12_RESOURCE_STATE_COPY_SOURCE;
+const RhiResourceStates RHI_STATE_PRESENT = D3D12_RESOURCE_STATE_PRESENT;
+
+const RhiBarrierType RHI_BARRIER_TYPE_TRANSITION = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+const RhiBarrierFlags RHI_BARRIER_FLAG_NONE = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+const RhiBarrierFlags RHI_BARRIER_FLAG_BEGIN_ONLY = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+const RhiBarrierFlags RHI_BARRIER_FLAG_END_ONLY = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+const UINT RHI_ALL_SUBRESOURCES = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+#else
+typedef uint8_t UINT8;
+typedef uint32_t UINT;
+typedef int32_t INT;
+typedef uint64_t UINT64;
+typedef int BOOL;
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+using RhiGpuAddress = uint64_t;
+enum RhiFormat : uint32_t { RHI_FORMAT_UNKNOWN = 0, RHI_FORMAT_R32_UINT = 42 }; // 値はDXGI_FORMATと同じ
+enum RhiPrimitiveTopology : uint32_t { RHI_TOPOLOGY_UNDEFINED = 0, RHI_TOPOLOGY_TRIANGLELIST = 4 };
+
+// リソースの状態とバリア（値はD3D12_RESOURCE_STATESとD3D12_RESOURCE_BARRIER_FLAGSと同じ）
+enum RhiResourceStates : uint32_t
+{
+	RHI_STATE_COMMON = 0,
+	RHI_STATE_VERTEX_AND_CONSTANT_BUFFER = 0x1,
+	RHI_STATE_INDEX_BUFFER = 0x2,
+	RHI_STATE_RENDER_TARGET = 0x4,
+	RHI_STATE_UNORDERED_ACCESS = 0x8,
+	RHI_STATE_DEPTH_WRITE = 0x10,
+	RHI_STATE_DEPTH_READ = 0x20,
+	RHI_STATE_NON_PIXEL_SHADER_RESOURCE = 0x40,
+	RHI_STATE_PIXEL_SHADER_RESOURCE = 0x80,
+	RHI_STATE_INDIRECT_ARGUMENT = 0x200,
+	RHI_STATE_COPY_DEST = 0x400,
+	RHI_STATE_COPY_SOURCE = 0x800,
+	RHI_STATE_PRESENT = 0,
+};
+enum RhiBarrierType : uint32_t { RHI_BARRIER_TYPE_TRANSITION = 0 };
+enum RhiBarrierFlags : uint32_t { RHI_BARRIER_FLAG_NONE = 0, RHI_BARRIER_FLAG_BEGIN_ONLY = 0x1, RHI_BARRIER_FLAG_END_ONLY = 0x2 };
+const UINT RHI_ALL_SUBRESOURCES = 0xffffffff;
+
+struct RhiVertexBufferView
+{
+	RhiGpuAddress BufferLocation;
+	UINT SizeInBytes;
+	UINT StrideInBytes;
+};
+
+struct RhiIndexBufferView
+{
+	RhiGpuAddress BufferLocation;
+	UINT SizeInBytes;
+	RhiFormat Format;
+};
+
+struct RhiConstantBufferViewDesc
+{
+	RhiGpuAddress BufferLocation;
+	UINT SizeInBytes;
+};
+
+struct RhiCpuDescriptor
+{
+	size_t ptr;
+};
+
+struct RhiGpuDescriptor
+{
+	uint64_t ptr;
+};
+
+struct RhiInputElementDesc
+{
+	const char* SemanticName;
+	UINT SemanticIndex;
+	uint32_t Format;
+	UINT InputSlot;
+	UINT AlignedByteOffset;
+	uint32_t InputSlotClass;
+	UINT InstanceDataStepRate;
+};
+
+struct RhiInputLayoutDesc
+{
+	const RhiInputElementDesc* pInputElementDescs;
+	UINT NumElements;
+};
+
+// シェーダーのバイトコード（ID3DBlobと同じメソッドを持つ）
+class RhiShaderBlob
+{
+public:
+	RhiShaderBlob(const void* data, size_t size) : m_pData(data), m_Size(size) {}
+	const void* GetBufferPointer() const { return m_pData; }
+	size_t GetBufferSize() const { return m_Size; }
+
+private:
+	const void* m_pData;
+	size_t m_Size;
+};
+#endif
+
+enum RhiHeap
+{
+	RHI_HEAP_UPLOAD, // CPUから書き込める（Mapしたままにできる）
+	RHI_HEAP_DEFAULT, // GPUだけが読み書きする
+};
+
+enum
+{
+	RHI_CONSTANT_BUFFER_ALIGNMENT = 256, // D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT
+	RHI_MAX_VERTEX_BUFFERS = 32, // D3D12_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT
+	RHI_MAX_RENDER_TARGETS = 8, // D3D12_SIMULTANEOUS_RENDER_TARGET_COUNT
+};
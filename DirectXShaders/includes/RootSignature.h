@@ -1,15 +1,20 @@
 #pragma once
-#include "ComPtr.h"
+#include "Rhi.h"
+#include <cstdint>
 
-struct ID3D12RootSignature;
-class RootSignature
+// Backendは描画APIのバックエンド（Rhi.h）。作り方はバックエンドごとに違う
+template<typename Backend>
+class BasicRootSignature
 {
 public:
-	RootSignature();
+	// materialTableSizeはメッシュ用のテクスチャのテーブル(space1)のSRVの数。0ならヒープ全体（HANDLE_MAX個）
+	BasicRootSignature(bool forMeshes = false, uint32_t materialTableSize = 0);
 	bool IsValid();
-	ID3D12RootSignature* Get();
+	typename Backend::RootSignature* Get();
 
 private:
 	bool m_IsValid = false;
-	ComPtr<ID3D12RootSignature> m_pRootSignature = nullptr;
-};
\ No newline at end of file
+	typename Backend::template Ref<typename Backend::RootSignature> m_pRootSignature = nullptr;
+};
+
+using RootSignature = BasicRootSignature<RhiBackend>;
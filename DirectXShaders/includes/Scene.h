@@ -1,5 +1,11 @@
 #pragma once
 #include "Camera.h"
+#include "SceneGraph.h"
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+struct SceneObjects;
 
 class Scene
 {
@@ -10,6 +16,8 @@ public:
 	void Draw();
 	bool CreateIrradianceMapResource();
 	void RenderIrradianceMap();
+	// 今のフレームをCPUのリファレンスレンダラーでも描き、PNGとEXRに書き出す
+	bool RenderSoftwareFrame(const std::filesystem::path& path);
 
 	void ProcessMouseMovement(int xPos,  int yPos);
 
@@ -17,6 +25,13 @@ public:
 
 private:
 	Camera* m_pCamera;
+	// 物体の変換の階層。モデル全体の変換（meshTransform.World）を根にし、並べたモデルをその子にする
+	// Updateでは変えたノードとその子孫だけを求め直すので、動かない物体は逆行列も含めて毎フレームの計算が要らない
+	SceneGraph m_SceneGraph;
+	uint32_t m_ModelNode = 0;
+	std::vector<uint32_t> m_CopyNodes; // 並べたモデルのノード
+	std::vector<SceneGraph::Transform> m_CopyLocals; // 並べたモデルの動かす前のローカルの変換
+	SceneObjects* m_pObjects = nullptr; // 並べたモデルの物体とカリングの状態（Scene.cppで定義）
 	void ProcessInput();
 };
 
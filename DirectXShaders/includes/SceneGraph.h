@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// 親子関係のある物体の変換を、要素ごとの配列（SoA）で持つシーングラフ
+// ノードは深さの順（幅優先）に並べ直して持つので、親は必ず子より前にある。同じ深さのノードは互いに依存しないので、深さごとにジョブで並列に更新する
+// 更新するのは、ローカルの変換を変えたノードとその子孫だけ。ワールド行列の積と逆転置はSSE2で求める（それ以外は同じ順の計算で1要素ずつ。結果は同じ）
+// 行列はInstanceDataと同じ3x4（列ベクトル、各行がワールド座標の1成分）で、ワールド = 親のワールド * T * R * S
+// ノードの番号は追加した順で、並べ直しても変わらない。デバイスを使わないので、Windows以外でも動く
+class SceneGraph
+{
+public:
+	enum : uint32_t
+	{
+		NO_PARENT = 0xffffffff,
+		UPDATE_GRAIN = 2048, // 1つのジョブで更新するノードの数
+	};
+
+	// ローカルの変換。回転は正規化した四元数(x, y, z, w)
+	struct Transform
+	{
+		float Translation[3];
+		float Rotation[4];
+		float Scale[3];
+	};
+
+	struct alignas(16) Matrix
+	{
+		float Rows[3][4];
+	};
+
+	struct Stats
+	{
+		uint32_t NodeCount;
+		uint32_t Levels; // 深さの数
+		uint32_t UpdatedNodes; // 最後のUpdateでワールド行列を求め直したノード
+		double SortTime; // ノードを追加した後の並べ直しの時間（ミリ秒）
+		double UpdateTime;
+	};
+
+	// parentはすでに追加したノード（NO_PARENTなら根）。新しいノードの番号を返す
+	uint32_t AddNode(uint32_t parent, const Transform& local);
+	void SetLocal(uint32_t node, const Transform& local);
+	const Transform& GetLocal(uint32_t node) const { return m_Locals[m_SlotOfNode[node]]; }
+	uint32_t GetParent(uint32_t node) const;
+	void Reserve(uint32_t count);
+	void Clear();
+
+	// 変えたノードとその子孫のワールド行列と逆転置を求める。parallelならジョブシステムで深さごとに並列に行う
+	void Update(bool parallel = true);
+
+	uint32_t NodeCount() const { return static_cast<uint32_t>(m_SlotOfNode.size()); }
+	const Matrix& World(uint32_t node) const { return m_World[m_SlotOfNode[node]]; }
+	const Matrix& WorldInvTranspose(uint32_t node) const { return m_WorldInvTranspose[m_SlotOfNode[node]]; }
+	// 最後のUpdateでワールド行列が変わったならtrue
+	bool WorldChanged(uint32_t node) const { return (m_Flags[m_SlotOfNode[node]] & FLAG_WORLD_CHANGED) != 0; }
+	const Stats& GetStats() const { return m_Stats; }
+
+	// 全てのノードを1つずつ求め直した結果と、最後のUpdateの結果が丸めの誤差の範囲で一致すればtrue（遅い）
+	bool Validate() const;
+
+	// 根がいくつかある木を作る。親は前のノードから選ぶので、深さは10段ほどになる
+	static void MakeTestHierarchy(uint32_t nodeCount, uint32_t seed, SceneGraph* pGraph);
+	// nodeCount個のノードで、全て、1%、変更なしの3通りの更新を並列と1スレッドで測り、求め直した結果と比べる
+	static bool RunBenchmark(uint32_t nodeCount, int iterations);
+
+private:
+	enum : uint8_t
+	{
+		FLAG_LOCAL_DIRTY = 1,
+		FLAG_WORLD_CHANGED = 2,
+	};
+
+	void Sort();
+	uint32_t UpdateRange(uint32_t begin, uint32_t end);
+	static void ComposeLocal(const Transform& local, Matrix* pOut);
+	static void Multiply(const Matrix& parent, const Matrix& local, Matrix* pOut);
+	static void InverseTranspose(const Matrix& world, Matrix* pOut);
+
+	// ノードの番号と並べた位置（スロット）の対応
+	std::vector<uint32_t> m_SlotOfNode;
+	std::vector<uint32_t> m_NodeOfSlot;
+
+	// ここから下はスロットの順
+	std::vector<uint32_t> m_Parents; // 親のスロット
+	std::vector<uint32_t> m_Depths;
+	std::vector<Transform> m_Locals;
+	std::vector<Matrix> m_World;
+	std::vector<Matrix> m_WorldInvTranspose;
+	std::vector<uint8_t> m_Flags;
+
+	std::vector<uint32_t> m_LevelStart; // 深さごとの先頭のスロット（深さの数 + 1個）
+	std::vector<uint8_t> m_LevelDirty; // SetLocalで変えたノードがある深さ
+	std::vector<uint8_t> m_LevelChanged; // 最後のUpdateで変わったノードがある深さ
+	bool m_NeedsSort = false;
+	Stats m_Stats = {};
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include <d3dcommon.h>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "ComPtr.h"
+#include "ShaderKey.h"
+
+// HLSLをDXCでコンパイルするサービス
+// ソース・インクルード・マクロ・コンパイラのバージョンから作ったハッシュ（ShaderKey）でバイトコードをキャッシュし、
+// 変更があったシェーダーだけをスレッドプールで並列にコンパイルする
+class ShaderCompiler
+{
+public:
+	bool Init(const wchar_t* sourceDir, const wchar_t* cacheDir);
+	void Add(const ShaderDesc& desc);
+	bool CompileAll(); // 失敗したシェーダーが1つでもあればfalse
+
+	ID3DBlob* Get(const wchar_t* name);
+
+	void PrintStats() const;
+
+private:
+	enum class Status
+	{
+		Pending,
+		CacheHit, // キャッシュから読み込んだ
+		Compiled, // コンパイルした
+		Prebuilt, // ソースが無いのでビルド済みの.csoを読み込んだ
+		Failed,
+	};
+
+	struct Entry
+	{
+		ShaderDesc Desc;
+		uint64_t Key = 0;
+		ComPtr<ID3DBlob> pBytecode;
+		Status State = Status::Pending;
+		double Time = 0.0; // ミリ秒
+		std::string Errors;
+	};
+
+	uint64_t QueryCompilerHash();
+	void Process(Entry& entry);
+	bool Compile(Entry& entry);
+	std::filesystem::path CachePath(uint64_t key) const;
+
+	std::filesystem::path m_SourceDir;
+	std::filesystem::path m_CacheDir;
+	uint64_t m_CompilerHash = 0; // 0ならDXCが使えない
+	std::vector<Entry> m_Entries;
+	double m_TotalTime = 0.0; // ミリ秒
+};
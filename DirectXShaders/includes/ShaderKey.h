@@ -0,0 +1,31 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+class Hasher;
+
+struct ShaderDesc
+{
+	std::wstring Name; // Get()で使う名前
+	std::wstring Path; // ソースディレクトリからの相対パス
+	std::wstring EntryPoint;
+	std::wstring Target; // "vs_6_0"など
+	std::vector<std::wstring> Defines; // "NAME" または "NAME=VALUE"
+};
+
+// シェーダーのキャッシュのキー。ソース・インクルード・マクロ・コンパイラのハッシュから作る
+// デバイスもコンパイラも使わないので、D3D12の無い環境でも確かめられる
+class ShaderKey
+{
+public:
+	// ファイルが読めなければ0
+	static uint64_t Compute(const ShaderDesc& desc, const std::filesystem::path& sourceDir, uint64_t compilerHash);
+	// ファイルの中身と、#includeしているファイルの中身を再帰的に加える。visitedは加えたファイル
+	static bool HashSourceFile(const std::filesystem::path& path, const std::filesystem::path& sourceDir,
+		Hasher& hasher, std::vector<std::filesystem::path>& visited);
+
+	// 一時ディレクトリにソースを書き、インクルードやマクロを変えた時だけキーが変わることを確かめる
+	static bool RunTest();
+};
@@ -36,6 +36,16 @@ struct alignas(256) Transform
 	DirectX::XMMATRIX WorldInvTranspose;
 };
 
+// インスタンスごとのデータ（SampleVS.hlslのInstanceDataと同じ並び）
+// 行列は最後の列を省いた3x4で、各行がワールド座標の1成分になる（dot(行, float4(pos, 1))）
+struct InstanceData
+{
+	DirectX::XMFLOAT4 World[3];
+	DirectX::XMFLOAT4 WorldInvTranspose[3];
+
+	void Set(DirectX::FXMMATRIX world);
+};
+
 struct Mesh
 {
 	std::vector<Vertex> Vertices;
@@ -0,0 +1,168 @@
+#pragma once
+#include "ClusteredLighting.h"
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// 線形のRGBAのテクスチャ。サンプラーはシーンのルートシグネチャと同じくバイリニアで、UVはラップする
+// ミップマップは使わないので、縮小して貼られる所はGPUの画像とは少し違う
+struct SoftwareTexture
+{
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	std::vector<float> Texels; // 1テクセルにRGBAの4つ
+
+	void Sample(float u, float v, float out[4]) const;
+	void SampleClamp(float u, float v, float out[4]) const; // キューブマップの面の中で使う
+};
+
+// 面の順と向きはD3D12のキューブマップと同じ（+X, -X, +Y, -Y, +Z, -Z）
+struct SoftwareCubeMap
+{
+	SoftwareTexture Faces[6];
+
+	void Sample(const float direction[3], float out[4]) const;
+};
+
+// 頂点はVertexの中でシェーダーが使う位置、法線、UVだけを持つ
+struct SoftwareMesh
+{
+	enum { NO_TEXTURE = 0xffffffff }; // テクスチャが無ければ白
+
+	std::vector<float> Positions; // 1頂点に3つ
+	std::vector<float> Normals; // 1頂点に3つ
+	std::vector<float> UVs; // 1頂点に2つ
+	std::vector<uint32_t> Indices;
+	uint32_t Texture = NO_TEXTURE; // SoftwareScene::Texturesの番号
+};
+
+// InstanceDataと同じ並び（3x4の行列で、各行がワールド座標の1成分）
+struct SoftwareInstance
+{
+	uint32_t Mesh;
+	float World[12];
+	float WorldInvTranspose[12];
+};
+
+// Scene::Drawが描くものと同じ入力。行列はXMMATRIXと同じ並びの行ベクトル（v * M）
+struct SoftwareScene
+{
+	struct Light
+	{
+		float Position[3];
+		float Intensity;
+	};
+
+	std::vector<SoftwareMesh> Meshes;
+	std::vector<SoftwareInstance> Instances;
+	std::vector<SoftwareTexture> Textures;
+	SoftwareCubeMap Sky;
+	bool HasSky = false;
+
+	float View[16]; // meshTransform
+	float Projection[16];
+	float SkyWorld[16]; // skyboxTransform
+	float SkyView[16];
+	float SkyProjection[16];
+	Light Lights[4]; // SceneData
+	int LightCount = 0;
+	std::vector<PointLight> PointLights; // クラスターに分けず、画素ごとに全てのライトを回す（GPUの振り分けの確かめにも使う）
+	float CameraPosition[3];
+};
+
+// CPUだけでScene::Drawと同じ絵を描くリファレンスレンダラー。GPUの無い環境での画像の回帰テストと、計算とカリングの処理量の計測に使う
+// スカイボックス、メッシュの順に描き、頂点はSampleVSとSkyboxVS、画素はPBR.hlsl（LambertとGGX）とSkyboxPSと同じ計算をする
+//   1. 幾何: 三角形を2048個ずつの塊に分けてジョブで並列に変換し、近い面、遠い面、ガードバンドで切り取り、64x64ピクセルのタイルに振り分ける
+//   2. タイル: タイルごとのジョブで、塊の順（描画の順）に三角形をSSE2で4ピクセルずつラスタライズし、深度と三角形の番号だけを残す
+//      最後に残った三角形だけを画素ごとにシェーディングする（重なった分のシェーディングをしない）
+// ラスタライズはD3D12と同じく、座標を1/256ピクセルに丸め、画素の中心で判定し、辺の上の画素はトップレフトの規則で決める
+// 画素はどのスレッドで描いても同じ順に同じ計算をするので、スレッドの数によらず同じ画像になる
+class SoftwareRenderer
+{
+public:
+	enum
+	{
+		TILE_SIZE = 64,
+		CHUNK_TRIANGLES = 2048,
+	};
+
+	// 1080p（1920x1080）の1フレームの目標（ミリ秒）。8スレッドのジョブシステムで、テストのシーン（三角形約15万）を描いた時
+	static const double TargetFrameTime1080p;
+
+	// 1フレームの時間（ミリ秒）と数
+	struct Timings
+	{
+		double Geometry; // 変換、切り取り、振り分け
+		double Tiles; // タイルのラスタライズとシェーディング（経過時間）
+		double RasterCpu; // タイルの中のラスタライズの、全スレッドの合計
+		double ShadeCpu; // タイルの中のシェーディングの、全スレッドの合計
+		double Total;
+		uint32_t InputTriangles;
+		uint32_t Triangles; // 切り取りと画面外の除去の後
+		uint32_t BinnedTriangles; // タイルに振り分けた数（複数のタイルに掛かる三角形はその数だけ）
+		uint64_t ShadedPixels;
+	};
+
+	void Init(uint32_t width, uint32_t height);
+	// sceneを描く。画素はシェーダーの出力そのまま（メッシュはトーンマップとガンマの後）のRGB
+	void Render(const SoftwareScene& scene);
+
+	uint32_t Width() const { return m_Width; }
+	uint32_t Height() const { return m_Height; }
+	const std::vector<float>& Pixels() const { return m_Pixels; }
+	const Timings& GetTimings() const { return m_Timings; }
+
+	// pathの拡張子を.pngと.exrにした2つのファイルに書き出す
+	bool Write(const std::filesystem::path& path) const;
+	// 基準のEXRと比べ、どのチャンネルもtolerance以内ならtrue。違う画素があり、diffPathが空でなければ差を10倍した画像を書き出す
+	bool Compare(const std::filesystem::path& referencePath, float tolerance, const std::filesystem::path& diffPath) const;
+
+	// テストのシーン。格子状に並べた球とトーラス（Sceneのインスタンスの並べ方と同じ）、手続きで作った空、Sceneと同じライトとカメラの作り方
+	static void MakeTestScene(uint32_t width, uint32_t height, SoftwareScene* pScene);
+	// テストのシーンを1080pでframes回描いて時間を出力し、outputに書き出す。referenceがあれば比べる（違えばfalse）
+	static bool RunHeadless(const std::filesystem::path& output, const std::filesystem::path& reference, uint32_t frames);
+
+private:
+	// 画面の座標に直し、辺と深度の平面の式まで求めた三角形
+	struct Triangle
+	{
+		// 辺kは頂点kの向かい側で、A * x + B * y + C が正なら内側。Cは丸めた座標から誤差なしで求まるのでdoubleで持ち、
+		// タイルの原点での値に直してから使う（隣り合う三角形の共有する辺で、符号がちょうど反対になる）
+		float EdgeA[3], EdgeB[3];
+		double EdgeC[3];
+		uint32_t TopLeft[3]; // 辺の上（0）の画素を含むなら全ビット1
+		float DepthA, DepthB; // z/w = A * x + B * y + C
+		double DepthC;
+		float InvW[3];
+		float Attributes[3][8]; // ワールド座標、法線、UV（スカイボックスは方向だけ）
+		int32_t MinX, MaxX, MinY, MaxY; // 中心が掛かる画素の範囲
+		uint32_t Texture;
+	};
+
+	// 幾何の処理の単位。三角形とタイルへの振り分けを塊ごとに持つので、ジョブの間でロックは要らない
+	struct Chunk
+	{
+		uint32_t Instance;
+		uint32_t FirstTriangle;
+		uint32_t TriangleCount;
+		std::vector<Triangle> Triangles;
+		std::vector<uint32_t> TileStart; // タイルごとの三角形の並びの先頭（タイルの数 + 1個）
+		std::vector<uint16_t> TileTriangles;
+	};
+
+	struct ClipVertex;
+
+	void ProcessChunk(const SoftwareScene& scene, Chunk& chunk);
+	void SetupTriangle(const ClipVertex* vertices[3], uint32_t texture, Chunk& chunk);
+	static void RasterizeTriangle(const Triangle& triangle, int32_t originX, int32_t originY, float* depths, uint32_t* ids, uint32_t id);
+	void ProcessTile(const SoftwareScene& scene, uint32_t tile, int64_t* pRasterTime, int64_t* pShadeTime, uint64_t* pShadedPixels);
+	void ShadePixel(const SoftwareScene& scene, const Triangle& triangle, double x, double y, float* pColor) const;
+
+	uint32_t m_Width = 0;
+	uint32_t m_Height = 0;
+	uint32_t m_TilesX = 0;
+	uint32_t m_TilesY = 0;
+	std::vector<Chunk> m_Chunks; // フレームをまたいで使い回す（確保は最初のフレームだけ）
+	std::vector<float> m_Pixels;
+	Timings m_Timings = {};
+};
@@ -2,9 +2,11 @@
 #include "ComPtr.h"
 #include <d3dx12.h>
 #include <string>
+#include <vector>
 
 class DescriptorHeap;
 class DescriptorHandle;
+struct SoftwareTexture;
 
 class Texture2D
 {
@@ -13,6 +15,9 @@ public:
 	static Texture2D* Get(std::wstring path);
 	static Texture2D* Get(ID3D12Resource* buffer);
 	static Texture2D* GetWhite();
+	// ファイルをCPUで読み、RGBAの浮動小数に直す（リファレンスレンダラー用）。キューブマップなら6面
+	static bool ReadPixels(const std::wstring& path, std::vector<SoftwareTexture>& images);
+	~Texture2D(); // リソースはGPUが使い終わるまで解放を遅らせる
 	bool IsValid();
 
 	ID3D12Resource* Resource();
@@ -28,6 +33,8 @@ private:
 	ComPtr<ID3D12Resource> m_pResource;
 	bool Load(std::string& path);
 	bool Load(std::wstring& path);
+	void TrackMemory(); // リソースのメモリを統計に足す（破棄する時に引く）
+	UINT64 m_MemorySize = 0;
 
 	static ID3D12Resource* GetDefaultResource(size_t width, size_t height);
 	static ID3D12Resource* GetTextureCubeResource(size_t width, size_t height);
@@ -1,6 +1,10 @@
 #pragma once
 
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <cstdint>
+#endif
 #include <iostream>
 
 class Timer
@@ -12,8 +16,12 @@ public:
 	double GetDeltaTime();
 
 private:
+#ifdef _WIN32
 	LARGE_INTEGER m_StartTime;
 	LARGE_INTEGER m_Frequency;
 	LARGE_INTEGER m_LastFrameTime;
+#else
+	int64_t m_StartTime; // ナノ秒（steady_clock）
+#endif
 	double m_ElapsedTime;
-};
\ No newline at end of file
+};
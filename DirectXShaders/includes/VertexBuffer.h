@@ -1,22 +1,26 @@
 #pragma once
-#include <d3d12.h>
-#include "ComPtr.h"
+#include "Rhi.h"
 
-class VertexBuffer
+// Backendは描画APIのバックエンド（Rhi.h）
+template<typename Backend>
+class BasicVertexBuffer
 {
 public:
-	VertexBuffer(size_t size, size_t stride, const void* pInitData);
-	D3D12_VERTEX_BUFFER_VIEW View() const;
+	BasicVertexBuffer(size_t size, size_t stride, const void* pInitData);
+	~BasicVertexBuffer();
+	RhiVertexBufferView View() const;
 	bool IsValid();
 
 	// コピー禁止
 	// 自身を引数にとるコンストラクタ（コピーコンストラクタ）を禁止
-	VertexBuffer(const VertexBuffer&) = delete;
+	BasicVertexBuffer(const BasicVertexBuffer&) = delete;
 	// 代入演算子を禁止
-	void operator = (const VertexBuffer&) = delete;
+	void operator = (const BasicVertexBuffer&) = delete;
 
 private:
 	bool m_IsValid = false;
-	ComPtr<ID3D12Resource> m_pBuffer = nullptr;
-	D3D12_VERTEX_BUFFER_VIEW m_View = {};
-};
\ No newline at end of file
+	typename Backend::Buffer m_Buffer;
+	RhiVertexBufferView m_View = {};
+};
+
+using VertexBuffer = BasicVertexBuffer<RhiBackend>;
@@ -1,7 +1,26 @@
 #include "App.h"
 #include "Engine.h"
 #include "Scene.h"
-#include "Timer.h"
+#include "FramePacer.h"
+#include "JobSystem.h"
+#include "DrawQueue.h"
+#include "BakeScheduler.h"
+#include "CommandListFilter.h"
+#include "Profiler.h"
+#include "FrameStats.h"
+#include "FrameScheduler.h"
+#include "HeadlessFrame.h"
+#include "PipelineKey.h"
+#include "RenderGraph.h"
+#include "ResourceStateTracker.h"
+#include "Benchmark.h"
+#include "ClusteredLighting.h"
+#include "EntityWorld.h"
+#include "OcclusionCuller.h"
+#include "SceneGraph.h"
+#include "SoftwareRenderer.h"
+#include "DrawPartitioner.h"
+#include "ShaderKey.h"
 #include <stdio.h>
 #include <windowsx.h>
 
@@ -13,6 +32,9 @@ float g_LastFrame = 0.0f;
 
 bool g_KeyStates[256] = { false };
 
+AppOptions g_AppOptions;
+int g_ExitCode = 0;
+
 LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 {
 	switch (message)
@@ -122,8 +144,12 @@ void EnableDebugLayer()
 
 void MainLoop()
 {
-	Timer timer;
-	const float targetFrameRate = (1.0f / 60.0f) * 1000.0f;
+	SystemClock clock;
+	FramePacer pacer(clock);
+	pacer.SetTargetFrameRate(g_AppOptions.TargetFrameRate);
+
+	bool wasStatsKeyDown = false;
+	bool wasSoftwareKeyDown = false;
 
 	MSG msg = {};
 	while (msg.message != WM_QUIT)
@@ -135,27 +161,208 @@ void MainLoop()
 		}
 		else
 		{
-			float currentTime = timer.GetElapsedTime();
-			g_DeltaTime = currentTime - g_LastFrame;
-			g_LastFrame = currentTime;
+			PROFILE_SCOPE("Frame");
 
-			if (g_DeltaTime < targetFrameRate)
+			// 待った後の実際の経過時間をそのまま使う
+			{
+				PROFILE_SCOPE("WaitForNextFrame");
+				g_DeltaTime = static_cast<float>(pacer.WaitForNextFrame());
+			}
+			g_LastFrame += g_DeltaTime;
+			if (pacer.FrameCount() > 0 && pacer.FrameCount() % 300 == 0)
 			{
-				Sleep(static_cast<DWORD>((targetFrameRate - g_DeltaTime)));
-				g_DeltaTime = targetFrameRate;
+				pacer.PrintStats();
 			}
 
 			g_Scene->Update();
 			g_Engine->BeginRender();
 			g_Scene->Draw();
 			g_Engine->EndRender();
+			FrameStats::EndFrame(g_Engine->FrameCount(), g_DeltaTime * 1000.0);
 			g_Engine->UpdateFrameCount();
+
+			// F2キーで統計の履歴を書き出す（押した瞬間だけ）
+			if (g_KeyStates[VK_F2] && !wasStatsKeyDown)
+			{
+				FrameStats::Export(g_AppOptions.StatsPath);
+			}
+			wasStatsKeyDown = g_KeyStates[VK_F2];
+
+			// F3キーで今のフレームをCPUでも描いて書き出す（GPUの画像とシェーディングを比べる時に使う）
+			if (g_KeyStates[VK_F3] && !wasSoftwareKeyDown)
+			{
+				g_Scene->RenderSoftwareFrame(L"software_frame");
+			}
+			wasSoftwareKeyDown = g_KeyStates[VK_F3];
+
+			// GPUの区間は数フレーム遅れて届くので、その分待ってから書き出す
+			if (Profiler::IsEnabled() && g_Engine->FrameCount() == g_AppOptions.ProfileFrames + g_Engine->FramesInFlight())
+			{
+				Profiler::SetEnabled(false);
+				if (Profiler::WriteChromeTrace(g_AppOptions.ProfilePath))
+				{
+					printf("トレースを書き出した: %ls (区間 %u, 捨てた数 %u)\n", g_AppOptions.ProfilePath.c_str(), Profiler::EventCount(), Profiler::DroppedCount());
+				}
+			}
 		}
 	}
 }
 
 void StartApp(const TCHAR* appName)
 {
+	Profiler::SetThreadName("Main");
+
+	// 区間の計測はデバイスを使わないので、ウィンドウを作らずに終える
+	if (!g_AppOptions.ProfileTestPath.empty())
+	{
+		Profiler::RunHeadlessTest(g_AppOptions.ProfileTestPath);
+		return;
+	}
+
+	// 統計もデバイスを使わずに確かめられる。モニタは他のプロセスの統計を読むだけ
+	if (!g_AppOptions.StatsTestPath.empty())
+	{
+		FrameStats::RunHeadlessTest(g_AppOptions.StatsTestPath);
+		return;
+	}
+
+	if (g_AppOptions.RunStateTrackerTest)
+	{
+		g_ExitCode = BasicResourceStateTracker<NullBackend>::RunTest() ? 0 : 1;
+		return;
+	}
+
+	if (g_AppOptions.RunFramePacerTest)
+	{
+		g_ExitCode = FramePacer::RunTest() ? 0 : 1;
+		return;
+	}
+
+	if (g_AppOptions.RunFrameSchedulerTest)
+	{
+		g_ExitCode = FrameScheduler::RunTest() ? 0 : 1;
+		return;
+	}
+
+	if (g_AppOptions.RunPipelineKeyTest)
+	{
+		g_ExitCode = PipelineKey::RunTest() ? 0 : 1;
+		return;
+	}
+
+	if (g_AppOptions.RunCommandListFilterTest)
+	{
+		g_ExitCode = CommandListFilter<NullCommandList>::RunTest() ? 0 : 1;
+		return;
+	}
+
+	if (g_AppOptions.RunRenderGraphTest)
+	{
+		g_ExitCode = RenderGraph::RunTest() ? 0 : 1;
+		return;
+	}
+
+	if (g_AppOptions.RunBenchmarkTest)
+	{
+		g_ExitCode = Benchmark::RunTest() ? 0 : 1;
+		return;
+	}
+
+	if (g_AppOptions.RunDrawPartitionerTest)
+	{
+		g_ExitCode = DrawPartitioner::RunTest() ? 0 : 1;
+		return;
+	}
+
+	if (g_AppOptions.RunShaderKeyTest)
+	{
+		g_ExitCode = ShaderKey::RunTest() ? 0 : 1;
+		return;
+	}
+
+	if (g_AppOptions.RunStatsMonitor)
+	{
+		FrameStats::RunMonitor();
+		return;
+	}
+
+	// 有効にする前に、1区間あたりの手間を測っておく
+	if (!g_AppOptions.ProfilePath.empty())
+	{
+		Profiler::MeasureOverhead();
+		Profiler::SetEnabled(true);
+	}
+
+	// 読み込みや描画の記録で使うので最初に用意する
+	g_JobSystem = new JobSystem();
+	g_JobSystem->Init(g_AppOptions.JobThreads);
+	printf("ジョブシステム: %uスレッド\n", g_JobSystem->WorkerCount());
+
+	if (g_AppOptions.JobStressRounds > 0)
+	{
+		g_ExitCode = g_JobSystem->RunStressTest(g_AppOptions.JobStressRounds) ? 0 : 1;
+		return;
+	}
+
+	// 並べ替えの計測はデバイスを使わないので、ウィンドウを作らずに終える
+	if (g_AppOptions.SortBenchmarkDraws > 0)
+	{
+		DrawQueue::RunBenchmark(g_AppOptions.SortBenchmarkDraws);
+		return;
+	}
+
+	if (g_AppOptions.OcclusionBenchmarkBlocks > 0)
+	{
+		g_ExitCode = OcclusionCuller::RunBenchmark(g_AppOptions.OcclusionBenchmarkBlocks, 20) ? 0 : 1;
+		return;
+	}
+
+	if (!g_AppOptions.SoftwareRenderPath.empty() || !g_AppOptions.SoftwareReferencePath.empty())
+	{
+		g_ExitCode = SoftwareRenderer::RunHeadless(g_AppOptions.SoftwareRenderPath, g_AppOptions.SoftwareReferencePath, 10) ? 0 : 1;
+		return;
+	}
+
+	if (g_AppOptions.SceneGraphBenchmarkNodes > 0)
+	{
+		g_ExitCode = SceneGraph::RunBenchmark(g_AppOptions.SceneGraphBenchmarkNodes, 10) ? 0 : 1;
+		return;
+	}
+
+	if (g_AppOptions.EntityBenchmarkCount > 0)
+	{
+		g_ExitCode = EntityWorld::RunBenchmark(g_AppOptions.EntityBenchmarkCount, 10) ? 0 : 1;
+		return;
+	}
+
+	if (g_AppOptions.RunLightBenchmark)
+	{
+		g_ExitCode = ClusteredLighting::RunBenchmark(10) ? 0 : 1;
+		return;
+	}
+
+	if (!g_AppOptions.BenchmarkPath.empty() || !g_AppOptions.BenchmarkBaseline.empty())
+	{
+		namespace fs = std::filesystem;
+		bool passed = Benchmark::RunSuite(g_AppOptions.BenchmarkPath, g_AppOptions.BenchmarkBaseline,
+			g_AppOptions.BenchmarkThreshold / 100.0, fs::path(g_AppOptions.BenchmarkFilter).string());
+		g_ExitCode = passed ? 0 : 1;
+		return;
+	}
+
+	// ヌルのバックエンドはGPUを使わないので、フレームの記録もウィンドウを作らずに測れる
+	if (g_AppOptions.NullFrameMeshes > 0)
+	{
+		HeadlessFrame::RunBenchmark(g_AppOptions.NullFrameMeshes, 300, g_AppOptions.RecordThreads, g_AppOptions.MovingObjectCount);
+		return;
+	}
+
+	if (g_AppOptions.RunBakeSimulation)
+	{
+		g_ExitCode = BakeScheduler::RunSimulation() ? 0 : 1;
+		return;
+	}
+
 	InitWindow(appName);
 
 #ifdef _DEBUG
@@ -176,9 +383,26 @@ void StartApp(const TCHAR* appName)
 		return;
 	}
 
+	if (!g_Engine->CompileFrameGraph())
+	{
+		MessageBox(nullptr, L"Render graph compilation failed", L"Error", MB_OK);
+		return;
+	}
+
 	g_Engine->DrawIrradianceMap();
 
+	g_Engine->PSOCache()->PrintStats();
+	g_Engine->PSOCache()->Save();
+
+	// 外部のモニタ（--stats-monitor）から実行中の統計を読めるようにする
+	if (FrameStats::OpenSharedMemory())
+	{
+		printf("統計を共有メモリに公開\n");
+	}
+
 	MainLoop();
+	g_Engine->PrintReleaseStats();
+	FrameStats::CloseSharedMemory();
 }
 
 void ProcessInput(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
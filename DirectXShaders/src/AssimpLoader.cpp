@@ -1,5 +1,6 @@
 #include "AssimpLoader.h"
 #include "SharedStruct.h"
+#include "JobSystem.h"
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -83,12 +84,25 @@ bool AssimpLoader::Load(ImportSettings settings)
     meshes.clear();
     meshes.resize(scene->mNumMeshes);
 
-    for (size_t i = 0; i < meshes.size(); ++i)
+    // メッシュごとの変換は互いに独立しているので並列に行う
+    auto load = [&](size_t begin, size_t end)
     {
-        const auto pMesh = scene->mMeshes[i];
-        LoadMesh(meshes[i], pMesh, flipU, flipV);
-        const auto pMaterial = scene->mMaterials[i];
-        LoadTexture(settings.filename, meshes[i], pMaterial);
+        for (size_t i = begin; i < end; ++i)
+        {
+            const auto pMesh = scene->mMeshes[i];
+            LoadMesh(meshes[i], pMesh, flipU, flipV);
+            const auto pMaterial = scene->mMaterials[i];
+            LoadTexture(settings.filename, meshes[i], pMaterial);
+        }
+    };
+
+    if (g_JobSystem != nullptr)
+    {
+        g_JobSystem->ParallelFor(0, meshes.size(), 1, load);
+    }
+    else
+    {
+        load(0, meshes.size());
     }
 
     scene = nullptr;
@@ -0,0 +1,254 @@
+#include "BakeScheduler.h"
+#include "QueueModel.h"
+#include <algorithm>
+#include <vector>
+#include <stdio.h>
+
+void BakeScheduler::Init(uint64_t resourceReadyValue)
+{
+	m_IsRequested = false;
+	m_Front = NO_TARGET;
+	m_InFlightTarget = NO_TARGET;
+	m_InFlightValue = 0;
+	m_LastBakeValue = 0;
+	m_CompletedBakes = 0;
+	for (auto& value : m_LastReadValues)
+	{
+		value = resourceReadyValue;
+	}
+}
+
+BakeScheduler::BakePlan BakeScheduler::BeginFrame(uint64_t bakeCompletedValue)
+{
+	BakePlan plan = {};
+	plan.Target = NO_TARGET;
+
+	// 終わった焼き込みを表にする
+	if (m_InFlightTarget != NO_TARGET && bakeCompletedValue >= m_InFlightValue)
+	{
+		m_Front = m_InFlightTarget;
+		m_InFlightTarget = NO_TARGET;
+		m_CompletedBakes++;
+	}
+
+	// 前の焼き込みが計算キューで終わっていれば、裏の組に次を焼き込む
+	if (m_IsRequested && m_InFlightTarget == NO_TARGET && bakeCompletedValue >= m_LastBakeValue)
+	{
+		auto target = m_Front == NO_TARGET ? 0 : (m_Front + 1) % TARGET_COUNT;
+		plan.StartBake = true;
+		plan.Target = target;
+		plan.WaitValue = m_LastReadValues[target];
+
+		m_InFlightTarget = target;
+		m_InFlightValue = UINT64_MAX; // BakeSubmittedで決まる
+		m_IsRequested = false;
+	}
+
+	return plan;
+}
+
+void BakeScheduler::BakeSubmitted(uint64_t bakeFenceValue)
+{
+	m_InFlightValue = bakeFenceValue;
+	m_LastBakeValue = bakeFenceValue;
+}
+
+uint32_t BakeScheduler::AcquireFront(uint64_t frameFenceValue, uint64_t* pWaitValue)
+{
+	*pWaitValue = 0;
+
+	// 最初は読める組が無いので、描画キューを焼き込みの完了まで待たせてその組を読む
+	if (m_Front == NO_TARGET && m_InFlightTarget != NO_TARGET && m_InFlightValue != UINT64_MAX)
+	{
+		*pWaitValue = m_InFlightValue;
+		m_Front = m_InFlightTarget;
+		m_InFlightTarget = NO_TARGET;
+		m_CompletedBakes++;
+	}
+
+	if (m_Front != NO_TARGET)
+	{
+		m_LastReadValues[m_Front] = frameFenceValue;
+	}
+	return m_Front;
+}
+
+namespace
+{
+	const uint32_t SIM_FRAMES = 600;
+	const uint32_t SIM_FRAMES_IN_FLIGHT = 2;
+	const uint32_t SIM_REBAKE_INTERVAL = 120; // このフレーム数ごとに焼き直す
+	const double SIM_CPU_FRAME_TIME = 1000.0 / 60.0;
+	const double SIM_GPU_FRAME_TIME = 10.0;
+	const double SIM_BAKE_TIME = 40.0;
+
+	struct SimResult
+	{
+		double MaxFrameInterval; // 描画キューのフレームの終わりの間隔の最大（ミリ秒）
+		double GraphicsStallTime; // 描画キューが計算キューを待った時間（最初のフレームを除く）
+		uint32_t BakeCount;
+		uint32_t Conflicts; // 焼き込み中の組を描画が読んだ回数
+		bool IsDeadlocked;
+	};
+
+	double MaxFrameInterval(const std::vector<QueueModel::Work>& frames)
+	{
+		double maxInterval = 0.0;
+		for (size_t i = 1; i < frames.size(); i++)
+		{
+			maxInterval = std::max<double>(maxInterval, frames[i].End - frames[i - 1].End);
+		}
+		return maxInterval;
+	}
+
+	// CPUはフレームごとに1つ描画キューに積み、同時に処理するフレーム数を超える前に古いフレームの完了を待つ
+	SimResult SimulateAsync()
+	{
+		QueueModel model;
+		auto graphics = model.AddQueue("Graphics");
+		auto compute = model.AddQueue("Compute");
+
+		BakeScheduler scheduler;
+		scheduler.Init(0);
+
+		struct Access { uint32_t Target; uint64_t Value; };
+		std::vector<Access> bakes;
+		std::vector<Access> reads;
+		SimResult result = {};
+
+		double cpuTime = 0.0;
+		for (uint32_t frame = 0; frame < SIM_FRAMES; frame++)
+		{
+			if (frame >= SIM_FRAMES_IN_FLIGHT)
+			{
+				auto t = model.SignalTime(graphics, frame + 1 - SIM_FRAMES_IN_FLIGHT);
+				if (t < 0.0)
+				{
+					result.IsDeadlocked = true;
+					return result;
+				}
+				cpuTime = std::max<double>(cpuTime, t);
+			}
+
+			if (frame % SIM_REBAKE_INTERVAL == 0)
+			{
+				scheduler.RequestBake();
+			}
+
+			auto plan = scheduler.BeginFrame(model.CompletedValue(compute, cpuTime));
+			if (plan.StartBake)
+			{
+				model.Wait(compute, graphics, plan.WaitValue);
+				auto value = model.Submit(compute, cpuTime, SIM_BAKE_TIME, "Bake");
+				scheduler.BakeSubmitted(value);
+				bakes.push_back({ plan.Target, value });
+			}
+
+			uint64_t waitValue;
+			auto front = scheduler.AcquireFront(model.NextValue(graphics), &waitValue);
+			model.Wait(graphics, compute, waitValue);
+			auto value = model.Submit(graphics, cpuTime, SIM_GPU_FRAME_TIME, "Frame");
+			reads.push_back({ front, value });
+
+			cpuTime += SIM_CPU_FRAME_TIME;
+		}
+
+		if (model.HasUnresolved())
+		{
+			result.IsDeadlocked = true;
+			return result;
+		}
+
+		auto& frames = model.Works(graphics);
+		auto& bakeWorks = model.Works(compute);
+		for (auto& bake : bakes)
+		{
+			auto& b = bakeWorks[bake.Value - 1];
+			for (auto& read : reads)
+			{
+				auto& f = frames[read.Value - 1];
+				if (read.Target == bake.Target && f.Start < b.End && b.Start < f.End)
+				{
+					result.Conflicts++;
+				}
+			}
+		}
+
+		for (size_t i = 1; i < frames.size(); i++)
+		{
+			result.GraphicsStallTime += frames[i].StallTime;
+		}
+		result.MaxFrameInterval = MaxFrameInterval(frames);
+		result.BakeCount = static_cast<uint32_t>(bakes.size());
+		return result;
+	}
+
+	// 焼き込みをそのフレームの描画キューで行う場合（以前の実装）
+	SimResult SimulateSync()
+	{
+		QueueModel model;
+		auto graphics = model.AddQueue("Graphics");
+		SimResult result = {};
+
+		double cpuTime = 0.0;
+		for (uint32_t frame = 0; frame < SIM_FRAMES; frame++)
+		{
+			if (frame >= SIM_FRAMES_IN_FLIGHT)
+			{
+				cpuTime = std::max<double>(cpuTime, model.SignalTime(graphics, frame + 1 - SIM_FRAMES_IN_FLIGHT));
+			}
+
+			auto duration = SIM_GPU_FRAME_TIME;
+			if (frame % SIM_REBAKE_INTERVAL == 0)
+			{
+				duration += SIM_BAKE_TIME;
+				result.BakeCount++;
+			}
+			model.Submit(graphics, cpuTime, duration, "Frame");
+
+			cpuTime += SIM_CPU_FRAME_TIME;
+		}
+
+		result.MaxFrameInterval = MaxFrameInterval(model.Works(graphics));
+		return result;
+	}
+}
+
+bool BakeScheduler::RunSimulation()
+{
+	auto async = SimulateAsync();
+	auto sync = SimulateSync();
+
+	printf("環境マップの焼き込みの模擬: %uフレーム (CPU %.2f ms, 描画 %.1f ms, 焼き込み %.1f ms, %uフレームごとに焼き直す)\n",
+		SIM_FRAMES, SIM_CPU_FRAME_TIME, SIM_GPU_FRAME_TIME, SIM_BAKE_TIME, SIM_REBAKE_INTERVAL);
+	if (async.IsDeadlocked)
+	{
+		printf("  計算キュー: キュー同士が待ち合って進まない\n");
+		printf("環境マップの焼き込みの模擬: 失敗\n");
+		return false;
+	}
+	printf("  計算キュー: 焼き込み %u回, フレーム間隔の最大 %.2f ms, 描画キューの待ち %.2f ms (最初のフレームを除く), 読み書きの重なり %u\n",
+		async.BakeCount, async.MaxFrameInterval, async.GraphicsStallTime, async.Conflicts);
+	printf("  描画キュー: 焼き込み %u回, フレーム間隔の最大 %.2f ms\n", sync.BakeCount, sync.MaxFrameInterval);
+
+	// 焼き直しの依頼は間隔より短い時間で終わるので、依頼した回数だけ焼き込む
+	const uint32_t expectedBakes = (SIM_FRAMES + SIM_REBAKE_INTERVAL - 1) / SIM_REBAKE_INTERVAL;
+	bool passed = true;
+	if (async.Conflicts > 0)
+	{
+		printf("  焼き込み中の組を描画が読んだ (%u回)\n", async.Conflicts);
+		passed = false;
+	}
+	if (async.GraphicsStallTime > 0.0)
+	{
+		printf("  最初のフレームの後に描画キューが計算キューを待った (%.2f ms)\n", async.GraphicsStallTime);
+		passed = false;
+	}
+	if (async.BakeCount != expectedBakes || sync.BakeCount != expectedBakes)
+	{
+		printf("  焼き込みの回数が合わない (計算キュー %u回, 描画キュー %u回, 期待 %u回)\n", async.BakeCount, sync.BakeCount, expectedBakes);
+		passed = false;
+	}
+	printf("環境マップの焼き込みの模擬: %s\n", passed ? "成功" : "失敗");
+	return passed;
+}
@@ -0,0 +1,584 @@
+#include "Benchmark.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdio.h>
+
+namespace
+{
+	const int64_t MinTime = 50 * 1000 * 1000; // 1回の計測で繰り返す最短の時間（ナノ秒）
+	const int Repetitions = 5; // 同じ回数で何度測り、中央値をとるか
+	const uint64_t MaxIterations = 1000000000;
+
+	struct BenchmarkCase
+	{
+		std::string Name;
+		Benchmark::Function Function;
+	};
+
+	std::vector<BenchmarkCase>& Cases()
+	{
+		static std::vector<BenchmarkCase> s_Cases;
+		return s_Cases;
+	}
+
+	// 計測の結果を読むための最小限のJSONの読み取り。トークンの間の空白と改行は読み飛ばす
+	class JsonReader
+	{
+	public:
+		explicit JsonReader(const std::string& text) : m_Text(text) {}
+
+		// 次のトークンがcなら読み進めてtrue
+		bool Consume(char c)
+		{
+			SkipSpace();
+			if (m_Pos < m_Text.size() && m_Text[m_Pos] == c)
+			{
+				m_Pos++;
+				return true;
+			}
+			return false;
+		}
+
+		bool ReadString(std::string* pValue)
+		{
+			if (!Consume('"'))
+			{
+				return false;
+			}
+			pValue->clear();
+			while (m_Pos < m_Text.size())
+			{
+				auto c = m_Text[m_Pos++];
+				if (c == '"')
+				{
+					return true;
+				}
+				if (c != '\\')
+				{
+					pValue->push_back(c);
+					continue;
+				}
+				if (m_Pos >= m_Text.size())
+				{
+					return false;
+				}
+				c = m_Text[m_Pos++];
+				switch (c)
+				{
+				case 'b': pValue->push_back('\b'); break;
+				case 'f': pValue->push_back('\f'); break;
+				case 'n': pValue->push_back('\n'); break;
+				case 'r': pValue->push_back('\r'); break;
+				case 't': pValue->push_back('\t'); break;
+				case 'u':
+				{
+					// 名前はASCIIなので、サロゲートペアは組み合わせずに1文字ずつUTF-8にする
+					if (m_Pos + 4 > m_Text.size())
+					{
+						return false;
+					}
+					char* end;
+					auto code = static_cast<uint32_t>(strtoul(m_Text.substr(m_Pos, 4).c_str(), &end, 16));
+					if (*end != '\0')
+					{
+						return false;
+					}
+					m_Pos += 4;
+					if (code < 0x80)
+					{
+						pValue->push_back(static_cast<char>(code));
+					}
+					else if (code < 0x800)
+					{
+						pValue->push_back(static_cast<char>(0xc0 | (code >> 6)));
+						pValue->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+					}
+					else
+					{
+						pValue->push_back(static_cast<char>(0xe0 | (code >> 12)));
+						pValue->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+						pValue->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+					}
+					break;
+				}
+				default: pValue->push_back(c); break; // \" \\ \/
+				}
+			}
+			return false;
+		}
+
+		bool ReadNumber(double* pValue)
+		{
+			SkipSpace();
+			auto begin = m_Text.c_str() + m_Pos;
+			char* end;
+			*pValue = strtod(begin, &end);
+			if (end == begin)
+			{
+				return false;
+			}
+			m_Pos += end - begin;
+			return true;
+		}
+
+		// 値を1つ読み飛ばす（オブジェクトと配列は中身ごと）
+		bool SkipValue()
+		{
+			SkipSpace();
+			if (m_Pos >= m_Text.size())
+			{
+				return false;
+			}
+
+			std::string str;
+			switch (m_Text[m_Pos])
+			{
+			case '"':
+				return ReadString(&str);
+			case '{':
+				m_Pos++;
+				if (Consume('}'))
+				{
+					return true;
+				}
+				do
+				{
+					if (!ReadString(&str) || !Consume(':') || !SkipValue())
+					{
+						return false;
+					}
+				} while (Consume(','));
+				return Consume('}');
+			case '[':
+				m_Pos++;
+				if (Consume(']'))
+				{
+					return true;
+				}
+				do
+				{
+					if (!SkipValue())
+					{
+						return false;
+					}
+				} while (Consume(','));
+				return Consume(']');
+			}
+
+			for (auto literal : { "true", "false", "null" })
+			{
+				if (m_Text.compare(m_Pos, strlen(literal), literal) == 0)
+				{
+					m_Pos += strlen(literal);
+					return true;
+				}
+			}
+			double number;
+			return ReadNumber(&number);
+		}
+
+		// 値の後ろに空白以外が残っていないか
+		bool IsEnd()
+		{
+			SkipSpace();
+			return m_Pos == m_Text.size();
+		}
+
+		size_t Position() const { return m_Pos; }
+
+	private:
+		void SkipSpace()
+		{
+			while (m_Pos < m_Text.size() && (m_Text[m_Pos] == ' ' || m_Text[m_Pos] == '\t' || m_Text[m_Pos] == '\n' || m_Text[m_Pos] == '\r'))
+			{
+				m_Pos++;
+			}
+		}
+
+		const std::string& m_Text;
+		size_t m_Pos = 0;
+	};
+
+	// "benchmarks"の1つの計測を読む（無いキーは0のまま）
+	bool ReadResult(JsonReader& reader, Benchmark::Result* pResult)
+	{
+		*pResult = {};
+		if (!reader.Consume('{'))
+		{
+			return false;
+		}
+		if (reader.Consume('}'))
+		{
+			return true;
+		}
+
+		do
+		{
+			std::string key;
+			if (!reader.ReadString(&key) || !reader.Consume(':'))
+			{
+				return false;
+			}
+
+			double* pNumber = nullptr;
+			double iterations = 0.0;
+			if (key == "name")
+			{
+				if (!reader.ReadString(&pResult->Name))
+				{
+					return false;
+				}
+				continue;
+			}
+			else if (key == "iterations") { pNumber = &iterations; }
+			else if (key == "median_ns") { pNumber = &pResult->MedianTime; }
+			else if (key == "min_ns") { pNumber = &pResult->MinTime; }
+			else if (key == "max_ns") { pNumber = &pResult->MaxTime; }
+			else if (key == "items_per_second") { pNumber = &pResult->ItemsPerSecond; }
+
+			if (pNumber == nullptr)
+			{
+				if (!reader.SkipValue())
+				{
+					return false;
+				}
+				continue;
+			}
+			if (!reader.ReadNumber(pNumber))
+			{
+				return false;
+			}
+			if (pNumber == &iterations)
+			{
+				pResult->Iterations = static_cast<uint64_t>(iterations);
+			}
+		} while (reader.Consume(','));
+		return reader.Consume('}');
+	}
+
+	bool SameResults(const std::vector<Benchmark::Result>& a, const std::vector<Benchmark::Result>& b)
+	{
+		if (a.size() != b.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (a[i].Name != b[i].Name || a[i].Iterations != b[i].Iterations || a[i].MedianTime != b[i].MedianTime ||
+				a[i].MinTime != b[i].MinTime || a[i].MaxTime != b[i].MaxTime || a[i].ItemsPerSecond != b[i].ItemsPerSecond)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+int64_t BenchmarkState::Now()
+{
+	return Profiler::Now();
+}
+
+void Benchmark::Register(const std::string& name, Function function)
+{
+	for (auto& benchmarkCase : Cases())
+	{
+		if (benchmarkCase.Name == name)
+		{
+			benchmarkCase.Function = function;
+			return;
+		}
+	}
+	Cases().push_back({ name, function });
+}
+
+std::vector<Benchmark::Result> Benchmark::Run(const std::string& filter)
+{
+	std::vector<Result> results;
+	for (auto& benchmarkCase : Cases())
+	{
+		if (!filter.empty() && benchmarkCase.Name.find(filter) == std::string::npos)
+		{
+			continue;
+		}
+
+		// MinTimeを超えるまで回数を増やす（この間の実行は暖機を兼ねる）
+		uint64_t iterations = 1;
+		for (;;)
+		{
+			BenchmarkState state(iterations);
+			benchmarkCase.Function(state);
+			if (state.Elapsed() >= MinTime || iterations >= MaxIterations)
+			{
+				break;
+			}
+
+			// 足りない分だけ増やす。1回で増やすのは10倍まで
+			auto scale = state.Elapsed() > 0 ? static_cast<double>(MinTime) * 1.4 / state.Elapsed() : 10.0;
+			auto next = static_cast<uint64_t>(iterations * std::min<double>(scale, 10.0));
+			iterations = std::min<uint64_t>(std::max<uint64_t>(next, iterations + 1), MaxIterations);
+		}
+
+		std::vector<double> times;
+		std::vector<double> itemRates;
+		for (int i = 0; i < Repetitions; i++)
+		{
+			BenchmarkState state(iterations);
+			benchmarkCase.Function(state);
+			auto elapsed = std::max<int64_t>(state.Elapsed(), 1);
+			times.push_back(static_cast<double>(elapsed) / iterations);
+			itemRates.push_back(state.Items() * 1e9 / elapsed);
+		}
+
+		auto sorted = times;
+		std::sort(sorted.begin(), sorted.end());
+		auto median = sorted[sorted.size() / 2];
+		auto medianIndex = std::find(times.begin(), times.end(), median) - times.begin();
+
+		Result result = { benchmarkCase.Name, iterations, median, sorted.front(), sorted.back(), itemRates[medianIndex] };
+		results.push_back(result);
+		printf("%-44s %14.1f ns (%.1f～%.1f) %10llu回\n", result.Name.c_str(), result.MedianTime, result.MinTime, result.MaxTime,
+			static_cast<unsigned long long>(result.Iterations));
+	}
+	return results;
+}
+
+bool Benchmark::WriteJson(std::ostream& out, const std::vector<Result>& results)
+{
+	// 1つの計測を1行に書く（差分を見やすくするため。ReadJsonは整形し直したものも読める）
+	out << std::fixed << std::setprecision(3);
+	out << "{\"context\":{\"platform\":\"" <<
+#ifdef _WIN32
+		"Windows"
+#else
+		"Posix"
+#endif
+		<< "\",\"build\":\"" <<
+#ifdef _DEBUG
+		"Debug"
+#else
+		"Release"
+#endif
+		<< "\",\"repetitions\":" << Repetitions << ",\"min_time_ms\":" << MinTime / 1000000 << "},\n\"benchmarks\":[";
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		auto& result = results[i];
+		out << (i == 0 ? "\n" : ",\n") << "{\"name\":\"" << result.Name << "\",\"iterations\":" << result.Iterations
+			<< ",\"median_ns\":" << result.MedianTime << ",\"min_ns\":" << result.MinTime << ",\"max_ns\":" << result.MaxTime
+			<< ",\"items_per_second\":" << result.ItemsPerSecond << '}';
+	}
+	out << "\n]}\n";
+	return out.good();
+}
+
+bool Benchmark::ReadJson(const std::filesystem::path& path, std::vector<Result>* pResults)
+{
+	std::ifstream in(path);
+	if (!in)
+	{
+		printf("計測の結果を開けない: %s\n", path.string().c_str());
+		return false;
+	}
+	std::stringstream buffer;
+	buffer << in.rdbuf();
+	auto text = buffer.str();
+
+	if (!ParseJson(buffer.str(), pResults))
+	{
+		printf("計測の結果のJSONを読めない: %s\n", path.string().c_str());
+		return false;
+	}
+	if (pResults->empty())
+	{
+		printf("計測の結果がありません: %s\n", path.string().c_str());
+		return false;
+	}
+	return true;
+}
+
+bool Benchmark::ParseJson(const std::string& text, std::vector<Result>* pResults)
+{
+	pResults->clear();
+	JsonReader reader(text);
+	if (!reader.Consume('{'))
+	{
+		return false;
+	}
+	if (reader.Consume('}'))
+	{
+		return reader.IsEnd();
+	}
+
+	do
+	{
+		std::string key;
+		if (!reader.ReadString(&key) || !reader.Consume(':'))
+		{
+			return false;
+		}
+		if (key != "benchmarks")
+		{
+			if (!reader.SkipValue())
+			{
+				return false;
+			}
+			continue;
+		}
+
+		if (!reader.Consume('['))
+		{
+			return false;
+		}
+		if (reader.Consume(']'))
+		{
+			continue;
+		}
+		do
+		{
+			Result result;
+			if (!ReadResult(reader, &result))
+			{
+				return false;
+			}
+			pResults->push_back(result);
+		} while (reader.Consume(','));
+		if (!reader.Consume(']'))
+		{
+			return false;
+		}
+	} while (reader.Consume(','));
+	return reader.Consume('}') && reader.IsEnd();
+}
+
+bool Benchmark::Compare(const std::vector<Result>& results, const std::vector<Result>& baseline, double threshold)
+{
+	printf("基準との比較 (閾値 %.1f%%):\n", threshold * 100.0);
+	uint32_t regressions = 0;
+	for (auto& result : results)
+	{
+		auto base = std::find_if(baseline.begin(), baseline.end(), [&](const Result& r) { return r.Name == result.Name; });
+		if (base == baseline.end() || base->MedianTime <= 0.0)
+		{
+			printf("  %-44s 基準なし\n", result.Name.c_str());
+			continue;
+		}
+
+		// 中央値と最小値の両方が閾値を超えて遅くなった時だけ回帰とする（1回だけ他の処理に邪魔された分では出さない）
+		auto change = result.MedianTime / base->MedianTime - 1.0;
+		auto minChange = base->MinTime > 0.0 ? result.MinTime / base->MinTime - 1.0 : change;
+		bool isRegression = change > threshold && minChange > threshold;
+		auto mark = isRegression ? "回帰" : (change < -threshold ? "改善" : "");
+		regressions += isRegression ? 1 : 0;
+		printf("  %-44s %14.1f ns -> %14.1f ns (%+.1f%%) %s\n", result.Name.c_str(), base->MedianTime, result.MedianTime, change * 100.0, mark);
+	}
+
+	printf("回帰: %u個\n", regressions);
+	return regressions == 0;
+}
+
+bool Benchmark::RunSuite(const std::filesystem::path& output, const std::filesystem::path& baseline, double threshold, const std::string& filter)
+{
+	RegisterEngineCases();
+	auto results = Run(filter);
+	if (results.empty())
+	{
+		printf("実行する計測がありません\n");
+		return false;
+	}
+
+	if (!output.empty())
+	{
+		std::ofstream out(output, std::ios::trunc);
+		if (!out || !WriteJson(out, results))
+		{
+			printf("計測の結果を書き出せない: %s\n", output.string().c_str());
+			return false;
+		}
+		printf("計測の結果を書き出した: %s (%zu個)\n", output.string().c_str(), results.size());
+	}
+
+	if (baseline.empty())
+	{
+		return true;
+	}
+
+	std::vector<Result> baselineResults;
+	if (!ReadJson(baseline, &baselineResults))
+	{
+		return false;
+	}
+	return Compare(results, baselineResults, threshold);
+}
+
+bool Benchmark::RunTest()
+{
+	bool passed = true;
+	auto check = [&](bool condition, const char* message)
+	{
+		if (!condition)
+		{
+			printf("  %s\n", message);
+			passed = false;
+		}
+	};
+
+	// 書き出す桁（小数点以下3桁）で割り切れる値にして、読み戻した値が一致するようにする
+	std::vector<Result> expected =
+	{
+		{ "RenderGraph/Compile/100", 1200, 41250.5, 40000.25, 52000.125, 0.0 },
+		{ "DrawQueue/Sort/10000", 35, 1.5e6, 1.25e6, 2.0e6, 6666666.5 },
+		{ "SceneGraph/Update", 1, 0.0, 0.0, 0.0, 0.0 },
+	};
+
+	std::stringstream out;
+	check(WriteJson(out, expected), "書き出しに失敗");
+	std::vector<Result> results;
+	check(ParseJson(out.str(), &results) && SameResults(results, expected), "書き出したJSONを読み戻した結果が合わない");
+
+	// 整形し直した基準（json.dumpのindent=2の形）。キーの順番を変え、知らないキーと\/のエスケープ、指数表記を入れる
+	const char* pretty =
+		"{\n"
+		"  \"context\": {\n"
+		"    \"platform\": \"Posix\",\n"
+		"    \"build\": \"Release\",\n"
+		"    \"repetitions\": 5,\n"
+		"    \"tags\": [\"ci\", {\"nested\": [1, 2.5, true, null]}]\n"
+		"  },\n"
+		"  \"benchmarks\": [\n"
+		"    {\n"
+		"      \"iterations\": 1200,\n"
+		"      \"name\": \"RenderGraph\\/Compile\\/100\",\n"
+		"      \"median_ns\": 41250.5,\n"
+		"      \"min_ns\": 40000.25,\n"
+		"      \"max_ns\": 52000.125,\n"
+		"      \"items_per_second\": 0.0,\n"
+		"      \"unit\": \"ns\"\n"
+		"    },\n"
+		"    {\r\n"
+		"      \"name\" : \"DrawQueue/Sort/10000\" ,\r\n"
+		"      \"iterations\" : 35 ,\r\n"
+		"      \"median_ns\" : 1.5e6 ,\r\n"
+		"      \"min_ns\" : 1.25E+6 ,\r\n"
+		"      \"max_ns\" : 2000000 ,\r\n"
+		"      \"items_per_second\" : 6666666.5\r\n"
+		"    },\n"
+		"    {\"name\": \"SceneGraph\\u002fUpdate\", \"iterations\": 1}\n"
+		"  ]\n"
+		"}\n";
+	check(ParseJson(pretty, &results) && SameResults(results, expected), "整形し直したJSONを読んだ結果が合わない");
+
+	// 壊れたJSONは一部だけ読んだ結果にせず、失敗にする
+	auto text = out.str();
+	check(!ParseJson(text.substr(0, text.size() / 2), &results), "途中で切れたJSONを読んでしまった");
+	check(!ParseJson(text + "}", &results), "後ろに余計な文字があるJSONを読んでしまった");
+	check(!ParseJson("{\"benchmarks\": [{\"name\": \"A\", \"iterations\": }]}", &results), "値の無いキーを読んでしまった");
+
+	printf("計測の結果のJSONのテスト: %s\n", passed ? "成功" : "失敗");
+	return passed;
+}
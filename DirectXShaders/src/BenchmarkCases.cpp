@@ -0,0 +1,749 @@
+#include "Benchmark.h"
+#include "ClusteredLighting.h"
+#include "ConstantRing.h"
+#include "DrawQueue.h"
+#include "EntityWorld.h"
+#include "HeadlessFrame.h"
+#include "JobSystem.h"
+#include "ObjectBuffer.h"
+#include "OcclusionCuller.h"
+#include "RenderGraph.h"
+#include "SceneGraph.h"
+#include "SoftwareRenderer.h"
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include "AssimpLoader.h"
+#include "Camera.h"
+#include "ComPtr.h"
+#include "DescriptorHeap.h"
+#include "SharedStruct.h"
+#include <DirectXMath.h>
+#include <DirectXTex.h>
+#include <d3dx12.h>
+
+using namespace DirectX;
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	// 入力を作るための乱数。種が同じなら必ず同じ列になる
+	class BenchmarkRandom
+	{
+	public:
+		explicit BenchmarkRandom(uint32_t seed) : m_Seed(seed) {}
+		uint32_t Next() { m_Seed = m_Seed * 1664525u + 1013904223u; return m_Seed >> 8; }
+		float NextFloat() { return (Next() & 0xffff) / 65535.0f; }
+
+	private:
+		uint32_t m_Seed;
+	};
+
+	// DrawQueue::RunBenchmarkと同じ分布の描画を作る
+	void MakeDrawKeys(uint32_t drawCount, std::vector<uint64_t>& keys)
+	{
+		BenchmarkRandom random(12345);
+		keys.resize(drawCount);
+		for (auto& key : keys)
+		{
+			auto geometry = random.Next() % 4096;
+			auto material = (geometry * 2654435761u >> 16) % 1024;
+			key = DrawKey::Make(random.Next() % 2, material % 32, material, DrawKey::DepthBucket(random.NextFloat()), geometry);
+		}
+	}
+
+	void RegisterDrawListCases()
+	{
+		for (uint32_t drawCount : { 1000u, 10000u, 100000u })
+		{
+			Benchmark::Register("DrawQueue/Sort/" + std::to_string(drawCount), [drawCount](BenchmarkState& state)
+			{
+				std::vector<uint64_t> keys;
+				MakeDrawKeys(drawCount, keys);
+				DrawQueue queue;
+				queue.Reserve(drawCount);
+				int64_t items = 0;
+				while (state.KeepRunning())
+				{
+					state.PauseTiming();
+					queue.Clear();
+					for (uint32_t i = 0; i < drawCount; i++)
+					{
+						queue.Push(keys[i], i);
+					}
+					state.ResumeTiming();
+					queue.Sort();
+					items += drawCount;
+				}
+				state.SetItemsProcessed(items);
+			});
+		}
+
+		// ヌルのバックエンドでSceneと同じ描画の並べ方と記録をする（物体はメッシュの4倍）
+		for (uint32_t meshCount : { 100u, 1000u, 10000u })
+		{
+			Benchmark::Register("DrawList/Build/" + std::to_string(meshCount), [meshCount](BenchmarkState& state)
+			{
+				HeadlessFrame frame;
+				if (!frame.Init(meshCount, 4))
+				{
+					return;
+				}
+				uint32_t index = 0;
+				int64_t items = 0;
+				while (state.KeepRunning())
+				{
+					frame.BuildDrawList(index++);
+					items += frame.ObjectCount();
+				}
+				state.SetItemsProcessed(items);
+			});
+
+			Benchmark::Register("DrawList/Record/" + std::to_string(meshCount), [meshCount](BenchmarkState& state)
+			{
+				HeadlessFrame frame;
+				if (!frame.Init(meshCount, 4))
+				{
+					return;
+				}
+				frame.BuildDrawList(0);
+				int64_t items = 0;
+				while (state.KeepRunning())
+				{
+					frame.Record();
+					items += frame.DrawCount();
+				}
+				state.SetItemsProcessed(items);
+			});
+		}
+	}
+
+	// 中身の無いジョブを投入して終わるまで待ち、ジョブシステムそのものの手間を測る
+	void RegisterJobCases()
+	{
+		for (uint32_t jobCount : { 1000u, 10000u })
+		{
+			// 呼び出したスレッド（0番のワーカー）が自分のキューに積み、Waitの間は自分でも取り出す
+			Benchmark::Register("JobSystem/Spawn/" + std::to_string(jobCount), [jobCount](BenchmarkState& state)
+			{
+				int64_t items = 0;
+				while (state.KeepRunning())
+				{
+					JobCounter counter;
+					for (uint32_t i = 0; i < jobCount; i++)
+					{
+						g_JobSystem->Run([]() {}, &counter);
+					}
+					g_JobSystem->Wait(counter);
+					items += jobCount;
+				}
+				state.SetItemsProcessed(items);
+			});
+
+			// 積んだスレッドは手伝わずに待つので、全てのジョブを他のワーカーが盗んで実行する
+			// ワーカーが1つなら盗む側がいないので登録しない
+			if (g_JobSystem->WorkerCount() < 2)
+			{
+				continue;
+			}
+			Benchmark::Register("JobSystem/Steal/" + std::to_string(jobCount), [jobCount](BenchmarkState& state)
+			{
+				int64_t items = 0;
+				while (state.KeepRunning())
+				{
+					JobCounter counter;
+					for (uint32_t i = 0; i < jobCount; i++)
+					{
+						g_JobSystem->Run([]() {}, &counter);
+					}
+					while (!counter.IsDone())
+					{
+						std::this_thread::yield();
+					}
+					items += jobCount;
+				}
+				state.SetItemsProcessed(items);
+			});
+		}
+	}
+
+	// 後処理を連ねたグラフを毎フレームコンパイルし直す場合の手間を測る（構築は含めない）
+	void RegisterRenderGraphCases()
+	{
+		for (uint32_t passCount : { 100u, 500u, 1000u })
+		{
+			Benchmark::Register("RenderGraph/Compile/" + std::to_string(passCount), [passCount](BenchmarkState& state)
+			{
+				RenderGraph graph;
+				RenderGraph::BuildSyntheticGraph(graph, passCount, 1);
+				int64_t items = 0;
+				while (state.KeepRunning())
+				{
+					graph.Compile();
+					items += passCount;
+				}
+				state.SetItemsProcessed(items);
+			});
+		}
+	}
+
+	// 1フレーム分の定数（変換3つ）をリングに書く
+	void RegisterConstantCases()
+	{
+		Benchmark::Register("ConstantRing/Push", [](BenchmarkState& state)
+		{
+			struct alignas(16) Matrices
+			{
+				float Values[4][16];
+			};
+			BasicConstantRing<NullBackend> ring(64 * 1024);
+			Matrices matrices = {};
+			int64_t items = 0;
+			while (state.KeepRunning())
+			{
+				ring.Reset();
+				matrices.Values[0][0] += 1.0f;
+				ring.Push(matrices);
+				ring.Push(matrices);
+				ring.Push(matrices);
+				items += 3;
+			}
+			state.SetItemsProcessed(items);
+		});
+
+		// 10万物体（1物体96バイト）のうち、全て、1%（散らばった物体）、変更なしの時に変わった物体を詰める
+		const std::pair<const char*, uint32_t> UploadCases[] =
+		{
+			{ "ObjectBuffer/Upload/100k/All", 1 },
+			{ "ObjectBuffer/Upload/100k/Dirty1pct", 100 },
+			{ "ObjectBuffer/Upload/100k/Clean", 0 },
+		};
+		for (auto& entry : UploadCases)
+		{
+			auto stride = entry.second;
+			Benchmark::Register(entry.first, [stride](BenchmarkState& state)
+			{
+				const uint32_t ObjectCount = 100000;
+				const uint32_t ObjectSize = 96;
+				BasicObjectBuffer<NullBackend> objects;
+				objects.Init(ObjectCount, ObjectSize);
+				BasicConstantRing<NullBackend> ring(static_cast<size_t>(ObjectCount) * ObjectSize);
+				ring.Reset();
+				objects.Upload(&ring);
+				int64_t items = 0;
+				while (state.KeepRunning())
+				{
+					ring.Reset();
+					for (uint32_t object = 0; stride > 0 && object < ObjectCount; object += stride)
+					{
+						objects.MarkDirty(object);
+					}
+					objects.Upload(&ring);
+					items += ObjectCount;
+				}
+				state.SetItemsProcessed(items);
+			});
+		}
+	}
+
+
+	// 箱の建物を並べた街（16x16区画）を通りの中から見て、遮蔽物のラスタライズと隠れているかの判定を測る
+	void RegisterOcclusionCases()
+	{
+		auto scene = std::make_shared<OcclusionCuller::TestScene>();
+		OcclusionCuller::MakeCity(16, 12345, scene.get());
+
+		Benchmark::Register("Occlusion/Rasterize/City16", [scene](BenchmarkState& state)
+		{
+			OcclusionCuller culler;
+			culler.Init(OcclusionCuller::DEFAULT_WIDTH, OcclusionCuller::DEFAULT_HEIGHT);
+			int64_t items = 0;
+			while (state.KeepRunning())
+			{
+				culler.BeginFrame(scene->ViewProjection);
+				culler.AddOccluder(scene->Positions.data(), scene->Positions.size() / 3, sizeof(float) * 3, scene->Indices.data(), scene->Indices.size(), nullptr);
+				culler.Rasterize();
+				items += culler.GetStats().OccluderTriangles;
+			}
+			state.SetItemsProcessed(items);
+		});
+
+		Benchmark::Register("Occlusion/Test/City16", [scene](BenchmarkState& state)
+		{
+			OcclusionCuller culler;
+			culler.Init(OcclusionCuller::DEFAULT_WIDTH, OcclusionCuller::DEFAULT_HEIGHT);
+			culler.BeginFrame(scene->ViewProjection);
+			culler.AddOccluder(scene->Positions.data(), scene->Positions.size() / 3, sizeof(float) * 3, scene->Indices.data(), scene->Indices.size(), nullptr);
+			culler.Rasterize();
+			int64_t items = 0;
+			while (state.KeepRunning())
+			{
+				uint32_t occluded = 0;
+				for (auto& bounds : scene->Objects)
+				{
+					occluded += culler.IsOccluded(bounds) ? 1 : 0;
+				}
+				culler.CountTests(static_cast<uint32_t>(scene->Objects.size()), occluded);
+				items += scene->Objects.size();
+			}
+			state.SetItemsProcessed(items);
+		});
+	}
+
+	// 点光源（1000個、1万個、10万個）をクラスターに振り分ける（変換、箱との判定、詰め直しの全て）
+	void RegisterLightCases()
+	{
+		const std::pair<const char*, uint32_t> Cases[] =
+		{
+			{ "Lights/Bin/1k", 1000 },
+			{ "Lights/Bin/10k", 10000 },
+			{ "Lights/Bin/100k", 100000 },
+		};
+		for (auto& entry : Cases)
+		{
+			auto lights = std::make_shared<std::vector<PointLight>>();
+			ClusteredLighting::MakeTestLights(entry.second, 12345, *lights);
+			Benchmark::Register(entry.first, [lights](BenchmarkState& state)
+			{
+				float view[16];
+				float projection[16];
+				ClusteredLighting::MakeTestCamera(view, projection);
+				ClusteredLighting clusters;
+				clusters.Init(1920, 1080, projection);
+				int64_t items = 0;
+				while (state.KeepRunning())
+				{
+					clusters.Build(view, lights->data(), static_cast<uint32_t>(lights->size()));
+					items += lights->size();
+				}
+				state.SetItemsProcessed(items);
+			});
+		}
+	}
+
+	// 100万ノードのシーングラフのワールド行列の更新。全て、1%（とその子孫）、変更なしの3通り
+	void RegisterSceneGraphCases()
+	{
+		const std::pair<const char*, uint32_t> Cases[] =
+		{
+			{ "SceneGraph/Update/1M/All", 1 },
+			{ "SceneGraph/Update/1M/Dirty1pct", 100 },
+			{ "SceneGraph/Update/1M/Clean", 0 },
+		};
+		auto graph = std::make_shared<SceneGraph>();
+		SceneGraph::MakeTestHierarchy(1000000, 12345, graph.get());
+		graph->Update();
+		for (auto& entry : Cases)
+		{
+			auto stride = entry.second;
+			Benchmark::Register(entry.first, [graph, stride](BenchmarkState& state)
+			{
+				int64_t items = 0;
+				while (state.KeepRunning())
+				{
+					for (uint32_t node = 0; stride > 0 && node < graph->NodeCount(); node += stride)
+					{
+						graph->SetLocal(node, graph->GetLocal(node));
+					}
+					graph->Update();
+					items += graph->NodeCount();
+				}
+				state.SetItemsProcessed(items);
+			});
+		}
+	}
+
+	// エンティティの部品（EntityWorld::RunBenchmarkと同じ形）
+	struct BenchmarkPosition
+	{
+		float X, Y, Z;
+	};
+
+	struct BenchmarkVelocity
+	{
+		float X, Y, Z;
+	};
+
+	struct BenchmarkPayload
+	{
+		float Values[24];
+	};
+
+	struct BenchmarkSleeping
+	{
+		uint32_t Frames;
+	};
+
+	// 100万エンティティ（アーキタイプ3つ）をクエリで回す。コマンドバッファは1万個に部品を足して外す
+	void RegisterEntityCases()
+	{
+		auto world = std::make_shared<EntityWorld>();
+		BenchmarkRandom random(12345);
+		for (uint32_t i = 0; i < 1000000; i++)
+		{
+			auto components = ComponentMaskOf<BenchmarkPosition, BenchmarkVelocity>();
+			components |= i % 2 == 0 ? ComponentMaskOf<BenchmarkPayload>() : 0;
+			components |= i % 4 == 3 ? ComponentMaskOf<BenchmarkSleeping>() : 0;
+			auto entity = world->Create(components);
+			*world->Get<BenchmarkVelocity>(entity) = { random.NextFloat(), random.NextFloat(), random.NextFloat() };
+		}
+
+		auto move = [](Entity, BenchmarkPosition& position, const BenchmarkVelocity& velocity)
+		{
+			position.X += velocity.X * (1.0f / 60.0f);
+			position.Y += velocity.Y * (1.0f / 60.0f);
+			position.Z += velocity.Z * (1.0f / 60.0f);
+		};
+		Benchmark::Register("Entities/Each/1M", [world, move](BenchmarkState& state)
+		{
+			EntityQuery query(ComponentMaskOf<BenchmarkPosition, BenchmarkVelocity>(), ComponentMaskOf<BenchmarkSleeping>());
+			int64_t items = 0;
+			while (state.KeepRunning())
+			{
+				world->Each<BenchmarkPosition, const BenchmarkVelocity>(query, move);
+				items += world->Count(query);
+			}
+			state.SetItemsProcessed(items);
+		});
+
+		Benchmark::Register("Entities/ParallelEach/1M", [world, move](BenchmarkState& state)
+		{
+			EntityQuery query(ComponentMaskOf<BenchmarkPosition, BenchmarkVelocity>(), ComponentMaskOf<BenchmarkSleeping>());
+			int64_t items = 0;
+			while (state.KeepRunning())
+			{
+				world->ParallelEach<BenchmarkPosition, const BenchmarkVelocity>(query, move);
+				items += world->Count(query);
+			}
+			state.SetItemsProcessed(items);
+		});
+
+		Benchmark::Register("Entities/Playback/10k", [world](BenchmarkState& state)
+		{
+			std::vector<Entity> targets;
+			for (uint32_t i = 0; i < 10000; i++)
+			{
+				targets.push_back(world->EntityAt(i * 100));
+			}
+			EntityCommandBuffer commands;
+			int64_t items = 0;
+			while (state.KeepRunning())
+			{
+				for (auto entity : targets)
+				{
+					commands.Add(entity, BenchmarkSleeping{ 1 });
+				}
+				world->Playback(commands);
+				for (auto entity : targets)
+				{
+					commands.Remove<BenchmarkSleeping>(entity);
+				}
+				world->Playback(commands);
+				items += targets.size() * 2;
+			}
+			state.SetItemsProcessed(items);
+		});
+	}
+
+	// CPUのリファレンスレンダラーでテストのシーン（三角形約15万）を1フレーム描く
+	void RegisterSoftwareRendererCases()
+	{
+		auto scene = std::make_shared<SoftwareScene>();
+		SoftwareRenderer::MakeTestScene(1920, 1080, scene.get());
+
+		Benchmark::Register("SoftwareRenderer/Frame/1080p", [scene](BenchmarkState& state)
+		{
+			SoftwareRenderer renderer;
+			renderer.Init(1920, 1080);
+			int64_t items = 0;
+			while (state.KeepRunning())
+			{
+				renderer.Render(*scene);
+				items += renderer.GetTimings().InputTriangles;
+			}
+			state.SetItemsProcessed(items);
+		});
+	}
+#ifdef _WIN32
+	// 格子状の地形をOBJで書き出す（頂点の高さは固定の種から作る）
+	bool WriteGridObj(const fs::path& path, uint32_t side)
+	{
+		std::ofstream out(path, std::ios::trunc);
+		if (!out)
+		{
+			return false;
+		}
+
+		BenchmarkRandom random(side);
+		for (uint32_t z = 0; z <= side; z++)
+		{
+			for (uint32_t x = 0; x <= side; x++)
+			{
+				out << "v " << x << ' ' << random.NextFloat() << ' ' << z << '\n';
+				out << "vt " << static_cast<float>(x) / side << ' ' << static_cast<float>(z) / side << '\n';
+			}
+		}
+
+		for (uint32_t z = 0; z < side; z++)
+		{
+			for (uint32_t x = 0; x < side; x++)
+			{
+				auto i0 = z * (side + 1) + x + 1; // OBJの番号は1から
+				auto i1 = i0 + 1;
+				auto i2 = i0 + side + 1;
+				auto i3 = i2 + 1;
+				out << "f " << i0 << '/' << i0 << ' ' << i2 << '/' << i2 << ' ' << i1 << '/' << i1 << '\n';
+				out << "f " << i1 << '/' << i1 << ' ' << i2 << '/' << i2 << ' ' << i3 << '/' << i3 << '\n';
+			}
+		}
+		return out.good();
+	}
+
+	// 32bitの無圧縮TGAを書き出す（模様は固定の種から作る）
+	bool WriteTga(const fs::path& path, uint32_t size)
+	{
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		if (!out)
+		{
+			return false;
+		}
+
+		uint8_t header[18] = {};
+		header[2] = 2; // 無圧縮のフルカラー
+		header[12] = static_cast<uint8_t>(size & 0xff);
+		header[13] = static_cast<uint8_t>(size >> 8);
+		header[14] = static_cast<uint8_t>(size & 0xff);
+		header[15] = static_cast<uint8_t>(size >> 8);
+		header[16] = 32;
+		header[17] = 0x28; // 左上から、アルファ8bit
+		out.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+		BenchmarkRandom random(size);
+		std::vector<uint32_t> row(size);
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (auto& pixel : row)
+			{
+				pixel = random.Next() | 0xff000000;
+			}
+			out.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(uint32_t));
+		}
+		return out.good();
+	}
+
+	void RegisterCameraCases()
+	{
+		// Scene::Updateでの行列の計算と、定数とインスタンスのデータの書き込み
+		for (uint32_t objectCount : { 1u, 1000u })
+		{
+			Benchmark::Register("Scene/UpdateConstants/" + std::to_string(objectCount), [objectCount](BenchmarkState& state)
+			{
+				Camera camera(XMFLOAT3(0.0f, 120.0f, 75.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), 0.0f, 0.0f);
+				BasicConstantRing<NullBackend> ring(sizeof(Transform) * 4 + sizeof(InstanceData) * objectCount + 4096);
+				Transform transform = {};
+				transform.World = XMMatrixTranslation(0.0f, -60.0f, 0.0f) * XMMatrixScaling(2.0f, 2.0f, 2.0f);
+				float rotateY = 0.0f;
+				int64_t items = 0;
+				while (state.KeepRunning())
+				{
+					ring.Reset();
+					rotateY += 0.02f;
+					camera.ProcessMouseMovement(1.0f, 0.5f);
+					transform.WorldInvTranspose = XMMatrixTranspose(XMMatrixInverse(nullptr, transform.World));
+					transform.View = camera.GetViewMatrix();
+					transform.Projection = XMMatrixPerspectiveFovRH(XMConvertToRadians(camera.GetZoom()), 16.0f / 9.0f, 0.3f, 1000.0f);
+					ring.Push(transform);
+
+					auto allocation = ring.Allocate(sizeof(InstanceData) * objectCount);
+					auto pInstances = static_cast<InstanceData*>(allocation.Ptr);
+					for (uint32_t i = 0; i < objectCount && pInstances != nullptr; i++)
+					{
+						pInstances[i].Set(XMMatrixRotationY(rotateY) * XMMatrixTranslation(static_cast<float>(i), 0.0f, 0.0f));
+					}
+					items += objectCount;
+				}
+				state.SetItemsProcessed(items);
+			});
+		}
+
+		Benchmark::Register("Camera/Update", [](BenchmarkState& state)
+		{
+			Camera camera(XMFLOAT3(0.0f, 120.0f, 75.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), 0.0f, 0.0f);
+			XMFLOAT4X4 view;
+			while (state.KeepRunning())
+			{
+				camera.ProcessKeyboard(FORWARD_LEFT, 0.016f);
+				camera.ProcessMouseMovement(1.0f, -0.5f);
+				XMStoreFloat4x4(&view, camera.GetViewMatrix());
+			}
+		});
+	}
+
+	void RegisterAssetCases(const fs::path& directory)
+	{
+		// 格子の一辺の数。三角形は2*side*side個
+		for (uint32_t side : { 16u, 64u, 256u })
+		{
+			auto path = directory / ("grid" + std::to_string(side) + ".obj");
+			if (!WriteGridObj(path, side))
+			{
+				printf("計測用のモデルを書き出せない: %s\n", path.string().c_str());
+				continue;
+			}
+			Benchmark::Register("AssimpLoader/Load/Grid" + std::to_string(side), [path, side](BenchmarkState& state)
+			{
+				AssimpLoader loader;
+				auto filename = path.wstring();
+				int64_t items = 0;
+				while (state.KeepRunning())
+				{
+					std::vector<Mesh> meshes;
+					ImportSettings settings = { filename.c_str(), meshes, false, true };
+					loader.Load(settings);
+					items += 2 * side * side;
+				}
+				state.SetItemsProcessed(items);
+			});
+		}
+
+		// リポジトリの外にあるモデルは、置いてある時だけ測る
+		fs::path referenceModel = L"Assets/bunny.fbx";
+		if (fs::exists(referenceModel))
+		{
+			Benchmark::Register("AssimpLoader/Load/bunny", [referenceModel](BenchmarkState& state)
+			{
+				AssimpLoader loader;
+				auto filename = referenceModel.wstring();
+				while (state.KeepRunning())
+				{
+					std::vector<Mesh> meshes;
+					ImportSettings settings = { filename.c_str(), meshes, false, true };
+					loader.Load(settings);
+				}
+			});
+		}
+
+		// Texture2D::Loadのデコード（リソースの作成とアップロードはデバイスが要るので含めない）
+		for (uint32_t size : { 256u, 1024u, 2048u })
+		{
+			auto path = directory / ("texture" + std::to_string(size) + ".tga");
+			if (!WriteTga(path, size))
+			{
+				printf("計測用のテクスチャを書き出せない: %s\n", path.string().c_str());
+				continue;
+			}
+			Benchmark::Register("Texture2D/DecodeTga/" + std::to_string(size), [path, size](BenchmarkState& state)
+			{
+				auto filename = path.wstring();
+				int64_t items = 0;
+				while (state.KeepRunning())
+				{
+					TexMetadata metadata = {};
+					ScratchImage scratchImg = {};
+					if (FAILED(LoadFromTGAFile(filename.c_str(), &metadata, scratchImg)))
+					{
+						printf("テクスチャの読み込みに失敗\n");
+						return;
+					}
+					items += static_cast<int64_t>(size) * size;
+				}
+				state.SetItemsProcessed(items);
+			});
+		}
+	}
+
+	// DescriptorHeap::Registerと同じくヒープの先頭から順にSRVを作る
+	// Engineを使わずにデバイスだけを作る。作れない環境では測らない
+	void RegisterDescriptorCases()
+	{
+		ComPtr<ID3D12Device> device;
+		if (FAILED(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(device.GetAddressOf()))))
+		{
+			printf("デバイスを作れないので、ディスクリプタの登録は測らない\n");
+			return;
+		}
+
+		D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+		heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+		heapDesc.NumDescriptors = HANDLE_MAX;
+		ComPtr<ID3D12DescriptorHeap> heap;
+		auto prop = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+		auto textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, 4, 4, 1, 1);
+		ComPtr<ID3D12Resource> texture;
+		if (FAILED(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(heap.GetAddressOf())))
+			|| FAILED(device->CreateCommittedResource(&prop, D3D12_HEAP_FLAG_NONE, &textureDesc,
+				D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(texture.GetAddressOf()))))
+		{
+			printf("ディスクリプタの登録を測るリソースを作れない\n");
+			return;
+		}
+
+		Benchmark::Register("DescriptorHeap/Register/" + std::to_string(HANDLE_MAX), [device, heap, texture](BenchmarkState& state)
+		{
+			D3D12_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+			viewDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+			viewDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+			viewDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+			viewDesc.Texture2D.MipLevels = 1;
+
+			auto incrementSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+			std::vector<DescriptorHandle*> handles;
+			handles.reserve(HANDLE_MAX);
+			int64_t items = 0;
+			while (state.KeepRunning())
+			{
+				for (UINT i = 0; i < HANDLE_MAX; i++)
+				{
+					auto pHandle = new DescriptorHandle();
+					pHandle->HandleCPU = heap->GetCPUDescriptorHandleForHeapStart();
+					pHandle->HandleCPU.ptr += static_cast<SIZE_T>(incrementSize) * i;
+					pHandle->Index = i;
+					device->CreateShaderResourceView(texture.Get(), &viewDesc, pHandle->HandleCPU);
+					handles.push_back(pHandle);
+				}
+				items += HANDLE_MAX;
+
+				state.PauseTiming();
+				for (auto pHandle : handles)
+				{
+					delete pHandle;
+				}
+				handles.clear();
+				state.ResumeTiming();
+			}
+			state.SetItemsProcessed(items);
+		});
+	}
+#endif
+}
+
+void Benchmark::RegisterEngineCases()
+{
+	RegisterDrawListCases();
+	RegisterJobCases();
+	RegisterRenderGraphCases();
+	RegisterConstantCases();
+	RegisterOcclusionCases();
+	RegisterLightCases();
+	RegisterSceneGraphCases();
+	RegisterEntityCases();
+	RegisterSoftwareRendererCases();
+
+#ifdef _WIN32
+	// 読み込みの計測に使うファイルは毎回同じ内容で書き出す
+	auto directory = fs::temp_directory_path() / "DirectXShadersBenchmark";
+	std::error_code error;
+	fs::create_directories(directory, error);
+	RegisterCameraCases();
+	RegisterAssetCases(directory);
+	RegisterDescriptorCases();
+#endif
+}
@@ -0,0 +1,105 @@
+#include "Clock.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+SystemClock::SystemClock()
+{
+	// 高精度タイマー（Windows 10 1803以降）。使えなければ通常のタイマーにする
+	m_hTimer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (m_hTimer == nullptr)
+	{
+		m_hTimer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+	}
+}
+
+SystemClock::~SystemClock()
+{
+	if (m_hTimer != nullptr)
+	{
+		CloseHandle(m_hTimer);
+	}
+}
+
+int64_t SystemClock::CounterToNanoseconds(int64_t counter)
+{
+	static const int64_t frequency = []()
+	{
+		LARGE_INTEGER value;
+		QueryPerformanceFrequency(&value);
+		return value.QuadPart;
+	}();
+
+	// 桁あふれしないよう秒と余りに分けて変換する
+	auto seconds = counter / frequency;
+	auto remainder = counter % frequency;
+	return seconds * 1000000000 + remainder * 1000000000 / frequency;
+}
+
+int64_t SystemClock::Timestamp()
+{
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return CounterToNanoseconds(counter.QuadPart);
+}
+
+void SystemClock::SleepUntil(int64_t time)
+{
+	auto duration = time - Now();
+	if (duration <= 0)
+	{
+		return;
+	}
+
+	if (m_hTimer == nullptr)
+	{
+		Sleep(static_cast<DWORD>(duration / 1000000));
+		return;
+	}
+
+	// 負の値は相対時間（100ナノ秒単位）
+	LARGE_INTEGER dueTime;
+	dueTime.QuadPart = -(duration / 100);
+	if (SetWaitableTimer(m_hTimer, &dueTime, 0, nullptr, nullptr, FALSE))
+	{
+		WaitForSingleObject(m_hTimer, INFINITE);
+	}
+}
+
+#else
+#include <chrono>
+#include <thread>
+
+SystemClock::SystemClock()
+{
+}
+
+SystemClock::~SystemClock()
+{
+}
+
+int64_t SystemClock::Timestamp()
+{
+	auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+void SystemClock::SleepUntil(int64_t time)
+{
+	auto duration = time - Now();
+	if (duration > 0)
+	{
+		std::this_thread::sleep_for(std::chrono::nanoseconds(duration));
+	}
+}
+
+#endif
+
+int64_t SystemClock::Now()
+{
+	return Timestamp();
+}
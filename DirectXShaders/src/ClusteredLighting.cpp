@@ -0,0 +1,576 @@
+#include "ClusteredLighting.h"
+#include "JobSystem.h"
+#include "Timer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <stdio.h>
+
+// SSE2はx64では必ず使えるので、x64のビルドではSSE2で4個ずつライトを変換する（それ以外は1個ずつ。結果は同じ）
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define CLUSTER_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+	const uint32_t DEFAULT_WIDTH = 1920;
+	const uint32_t DEFAULT_HEIGHT = 1080;
+
+	// 0でないビットの一番下の位置
+	inline uint32_t CountTrailingZeros(uint32_t bits)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, bits);
+		return index;
+#else
+		return static_cast<uint32_t>(__builtin_ctz(bits));
+#endif
+	}
+
+	// 境目の面 (a, b) との距離。a * 座標 + b * 深度（SSE2の方と同じ順に計算する）
+	inline float PlaneDistance(const float plane[2], float coordinate, float depth)
+	{
+		return plane[0] * coordinate + plane[1] * depth;
+	}
+}
+
+void ClusteredLighting::Init(uint32_t width, uint32_t height, const float projection[16])
+{
+	if (width == m_Width && height == m_Height && memcmp(projection, m_Projection, sizeof(m_Projection)) == 0)
+	{
+		return;
+	}
+	m_Width = width;
+	m_Height = height;
+	memcpy(m_Projection, projection, sizeof(m_Projection));
+
+	// 右手系はP[11] = -1、左手系は1で、どちらもw = z * P[11]がカメラの前で正の深度になる
+	m_DepthSign = projection[11] < 0.0f ? -1.0f : 1.0f;
+	auto p10 = projection[10] * m_DepthSign;
+	auto nearZ = -projection[14] / p10;
+	auto farZ = projection[14] / (1.0f - p10);
+
+	// 画面のxは P[0] * x / 深度 なので、NDCのaの境目は P[0] * x - a * 深度 = 0 の面になる
+	for (int i = 0; i <= CLUSTER_X; i++)
+	{
+		auto a = -1.0f + 2.0f * i / CLUSTER_X;
+		auto length = std::sqrt(projection[0] * projection[0] + a * a);
+		m_PlanesX[i][0] = projection[0] / length;
+		m_PlanesX[i][1] = -a / length;
+	}
+	// 行は画面の上から下へ並ぶので、NDCのyは1から-1へ減っていく
+	for (int j = 0; j <= CLUSTER_Y; j++)
+	{
+		auto b = 1.0f - 2.0f * j / CLUSTER_Y;
+		auto length = std::sqrt(projection[5] * projection[5] + b * b);
+		m_PlanesY[j][0] = projection[5] / length;
+		m_PlanesY[j][1] = -b / length;
+	}
+	for (int k = 0; k <= CLUSTER_Z; k++)
+	{
+		m_SliceDepths[k] = nearZ * std::pow(farZ / nearZ, static_cast<float>(k) / CLUSTER_Z);
+	}
+	m_SliceDepths[0] = nearZ;
+	m_SliceDepths[CLUSTER_Z] = farZ;
+
+	// 箱はクラスターの4つの境目の面と2つの深度で囲まれた錐台の8つの角を囲む
+	m_Boxes.resize(CLUSTER_COUNT);
+	for (int k = 0; k < CLUSTER_Z; k++)
+	{
+		for (int j = 0; j < CLUSTER_Y; j++)
+		{
+			for (int i = 0; i < CLUSTER_X; i++)
+			{
+				auto& box = m_Boxes[(k * CLUSTER_Y + j) * CLUSTER_X + i];
+				float xs[2] = { -1.0f + 2.0f * i / CLUSTER_X, -1.0f + 2.0f * (i + 1) / CLUSTER_X };
+				float ys[2] = { 1.0f - 2.0f * j / CLUSTER_Y, 1.0f - 2.0f * (j + 1) / CLUSTER_Y };
+				float depths[2] = { m_SliceDepths[k], m_SliceDepths[k + 1] };
+				box.Min[0] = box.Min[1] = FLT_MAX;
+				box.Max[0] = box.Max[1] = -FLT_MAX;
+				for (auto depth : depths)
+				{
+					for (int n = 0; n < 2; n++)
+					{
+						auto x = xs[n] * depth / projection[0];
+						auto y = ys[n] * depth / projection[5];
+						box.Min[0] = std::min<float>(box.Min[0], x);
+						box.Max[0] = std::max<float>(box.Max[0], x);
+						box.Min[1] = std::min<float>(box.Min[1], y);
+						box.Max[1] = std::max<float>(box.Max[1], y);
+					}
+				}
+				box.Min[2] = depths[0];
+				box.Max[2] = depths[1];
+			}
+		}
+	}
+
+	m_SliceLights.resize(CLUSTER_Z);
+	m_ClusterLights.resize(CLUSTER_COUNT);
+}
+
+void ClusteredLighting::TransformLight(const PointLight& light, LightBounds* pBounds) const
+{
+	auto& v = m_View;
+	auto x = light.Position[0] * v[0] + light.Position[1] * v[4] + light.Position[2] * v[8] + v[12];
+	auto y = light.Position[0] * v[1] + light.Position[1] * v[5] + light.Position[2] * v[9] + v[13];
+	auto depth = (light.Position[0] * v[2] + light.Position[1] * v[6] + light.Position[2] * v[10] + v[14]) * m_DepthSign;
+	auto r = light.Radius;
+	pBounds->Center[0] = x;
+	pBounds->Center[1] = y;
+	pBounds->Center[2] = depth;
+	pBounds->Radius = r;
+
+	// 列iに掛かるのは、球が境目iより右にはみ出し、境目i + 1より左にはみ出す時
+	uint32_t columns = 0;
+	for (int i = 0; i < CLUSTER_X; i++)
+	{
+		auto inside = PlaneDistance(m_PlanesX[i], x, depth) > -r && PlaneDistance(m_PlanesX[i + 1], x, depth) < r;
+		columns |= (inside ? 1u : 0u) << i;
+	}
+	uint32_t rows = 0;
+	for (int j = 0; j < CLUSTER_Y; j++)
+	{
+		auto inside = PlaneDistance(m_PlanesY[j], y, depth) < r && PlaneDistance(m_PlanesY[j + 1], y, depth) > -r;
+		rows |= (inside ? 1u : 0u) << j;
+	}
+	uint32_t slices = 0;
+	auto front = depth - r;
+	auto back = depth + r;
+	for (int k = 0; k < CLUSTER_Z; k++)
+	{
+		auto inside = front < m_SliceDepths[k + 1] && back > m_SliceDepths[k];
+		slices |= (inside ? 1u : 0u) << k;
+	}
+	auto visible = columns != 0 && rows != 0 && slices != 0;
+	pBounds->Columns = visible ? columns : 0;
+	pBounds->Rows = visible ? rows : 0;
+	pBounds->Slices = visible ? slices : 0;
+}
+
+void ClusteredLighting::TransformLights(const PointLight* lights, uint32_t begin, uint32_t end)
+{
+	auto index = begin;
+#if CLUSTER_USE_SSE2
+	auto& v = m_View;
+	auto sign = _mm_set1_ps(m_DepthSign);
+	auto zero = _mm_setzero_ps();
+	for (; index + 4 <= end; index += 4)
+	{
+		// 4個のライトの位置と半径を並べ替え、ライトを4つのレーンに置く
+		auto px = _mm_loadu_ps(lights[index + 0].Position);
+		auto py = _mm_loadu_ps(lights[index + 1].Position);
+		auto pz = _mm_loadu_ps(lights[index + 2].Position);
+		auto r = _mm_loadu_ps(lights[index + 3].Position);
+		_MM_TRANSPOSE4_PS(px, py, pz, r);
+
+		auto transform = [&](int column)
+		{
+			auto value = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(v[column])), _mm_mul_ps(py, _mm_set1_ps(v[4 + column])));
+			value = _mm_add_ps(value, _mm_mul_ps(pz, _mm_set1_ps(v[8 + column])));
+			return _mm_add_ps(value, _mm_set1_ps(v[12 + column]));
+		};
+		auto x = transform(0);
+		auto y = transform(1);
+		auto depth = _mm_mul_ps(transform(2), sign);
+		auto negativeR = _mm_sub_ps(zero, r);
+		auto distance = [&](const float plane[2], __m128 coordinate)
+		{
+			return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), coordinate), _mm_mul_ps(_mm_set1_ps(plane[1]), depth));
+		};
+
+		// 比較の結果（レーンごとに全ビット1か0）と列のビットの論理積を重ねていく
+		auto columns = _mm_setzero_si128();
+		auto previous = distance(m_PlanesX[0], x);
+		for (int i = 0; i < CLUSTER_X; i++)
+		{
+			auto next = distance(m_PlanesX[i + 1], x);
+			auto inside = _mm_castps_si128(_mm_and_ps(_mm_cmpgt_ps(previous, negativeR), _mm_cmplt_ps(next, r)));
+			columns = _mm_or_si128(columns, _mm_and_si128(inside, _mm_set1_epi32(1 << i)));
+			previous = next;
+		}
+		auto rows = _mm_setzero_si128();
+		previous = distance(m_PlanesY[0], y);
+		for (int j = 0; j < CLUSTER_Y; j++)
+		{
+			auto next = distance(m_PlanesY[j + 1], y);
+			auto inside = _mm_castps_si128(_mm_and_ps(_mm_cmplt_ps(previous, r), _mm_cmpgt_ps(next, negativeR)));
+			rows = _mm_or_si128(rows, _mm_and_si128(inside, _mm_set1_epi32(1 << j)));
+			previous = next;
+		}
+		auto slices = _mm_setzero_si128();
+		auto front = _mm_sub_ps(depth, r);
+		auto back = _mm_add_ps(depth, r);
+		for (int k = 0; k < CLUSTER_Z; k++)
+		{
+			auto inside = _mm_castps_si128(_mm_and_ps(
+				_mm_cmplt_ps(front, _mm_set1_ps(m_SliceDepths[k + 1])), _mm_cmpgt_ps(back, _mm_set1_ps(m_SliceDepths[k]))));
+			slices = _mm_or_si128(slices, _mm_and_si128(inside, _mm_set1_epi32(1 << k)));
+		}
+
+		// どれかが0なら視錐台の外なので、全て0にする
+		auto zeroInt = _mm_setzero_si128();
+		auto outside = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi32(columns, zeroInt), _mm_cmpeq_epi32(rows, zeroInt)), _mm_cmpeq_epi32(slices, zeroInt));
+		uint32_t laneColumns[4];
+		uint32_t laneRows[4];
+		uint32_t laneSlices[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(laneColumns), _mm_andnot_si128(outside, columns));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(laneRows), _mm_andnot_si128(outside, rows));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(laneSlices), _mm_andnot_si128(outside, slices));
+
+		float centers[3][4];
+		float radii[4];
+		_mm_storeu_ps(centers[0], x);
+		_mm_storeu_ps(centers[1], y);
+		_mm_storeu_ps(centers[2], depth);
+		_mm_storeu_ps(radii, r);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			auto& bounds = m_Bounds[index + lane];
+			bounds.Center[0] = centers[0][lane];
+			bounds.Center[1] = centers[1][lane];
+			bounds.Center[2] = centers[2][lane];
+			bounds.Radius = radii[lane];
+			bounds.Columns = laneColumns[lane];
+			bounds.Rows = laneRows[lane];
+			bounds.Slices = laneSlices[lane];
+		}
+	}
+#endif
+	for (; index < end; index++)
+	{
+		TransformLight(lights[index], &m_Bounds[index]);
+	}
+}
+
+bool ClusteredLighting::SphereIntersectsBox(const float center[3], float radius, const Box& box)
+{
+	auto distance = 0.0f;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		auto outside = center[axis] < box.Min[axis] ? box.Min[axis] - center[axis] : center[axis] > box.Max[axis] ? center[axis] - box.Max[axis] : 0.0f;
+		distance += outside * outside;
+	}
+	return distance < radius * radius;
+}
+
+void ClusteredLighting::BinSlice(uint32_t slice)
+{
+	// スライスのクラスターはこのジョブだけが書くので、ロックは要らない
+	auto first = slice * CLUSTER_X * CLUSTER_Y;
+	for (uint32_t cluster = first; cluster < first + CLUSTER_X * CLUSTER_Y; cluster++)
+	{
+		m_ClusterLights[cluster].clear();
+	}
+	for (auto light : m_SliceLights[slice])
+	{
+		auto& bounds = m_Bounds[light];
+		for (auto rows = bounds.Rows; rows != 0; rows &= rows - 1)
+		{
+			auto row = first + CountTrailingZeros(rows) * CLUSTER_X;
+			for (auto columns = bounds.Columns; columns != 0; columns &= columns - 1)
+			{
+				auto cluster = row + CountTrailingZeros(columns);
+				if (SphereIntersectsBox(bounds.Center, bounds.Radius, m_Boxes[cluster]))
+				{
+					m_ClusterLights[cluster].push_back(light);
+				}
+			}
+		}
+	}
+}
+
+void ClusteredLighting::Build(const float view[16], const PointLight* lights, uint32_t lightCount, bool parallel)
+{
+	memcpy(m_View, view, sizeof(m_View));
+	m_LightCount = lightCount;
+	m_Bounds.resize(lightCount);
+	parallel = parallel && g_JobSystem != nullptr;
+
+	// 1. ライトごとに掛かる列、行、スライスを求める
+	Timer timer;
+	if (parallel && lightCount > LIGHT_GRAIN)
+	{
+		g_JobSystem->ParallelFor(0, lightCount, LIGHT_GRAIN, [this, lights](size_t begin, size_t end)
+		{
+			TransformLights(lights, static_cast<uint32_t>(begin), static_cast<uint32_t>(end));
+		});
+	}
+	else
+	{
+		TransformLights(lights, 0, lightCount);
+	}
+	m_Stats.TransformTime = timer.GetElapsedTime();
+
+	// スライスごとのライトの並び。番号の順に足すので、クラスターの並びも番号の順になる
+	timer.Reset();
+	for (auto& slice : m_SliceLights)
+	{
+		slice.clear();
+	}
+	uint32_t visibleLights = 0;
+	for (uint32_t light = 0; light < lightCount; light++)
+	{
+		auto slices = m_Bounds[light].Slices;
+		visibleLights += slices != 0 ? 1 : 0;
+		for (; slices != 0; slices &= slices - 1)
+		{
+			m_SliceLights[CountTrailingZeros(slices)].push_back(light);
+		}
+	}
+
+	// 2. スライスごとにクラスターの箱と比べる
+	if (parallel)
+	{
+		g_JobSystem->ParallelFor(0, CLUSTER_Z, 1, [this](size_t begin, size_t end)
+		{
+			for (auto slice = begin; slice < end; slice++)
+			{
+				BinSlice(static_cast<uint32_t>(slice));
+			}
+		});
+	}
+	else
+	{
+		for (uint32_t slice = 0; slice < CLUSTER_Z; slice++)
+		{
+			BinSlice(slice);
+		}
+	}
+
+	// 3. 先頭と数を決めてから、スライスごとに番号を写す
+	uint32_t offset = CLUSTER_COUNT * 2;
+	m_Stats.MaxClusterLights = 0;
+	m_Stats.OccupiedClusters = 0;
+	m_Lists.resize(offset);
+	for (uint32_t cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+	{
+		auto count = static_cast<uint32_t>(m_ClusterLights[cluster].size());
+		m_Lists[cluster * 2 + 0] = offset;
+		m_Lists[cluster * 2 + 1] = count;
+		offset += count;
+		m_Stats.MaxClusterLights = std::max<uint32_t>(m_Stats.MaxClusterLights, count);
+		m_Stats.OccupiedClusters += count != 0 ? 1 : 0;
+	}
+	m_Lists.resize(offset);
+	auto copySlice = [this](uint32_t slice)
+	{
+		for (auto cluster = slice * CLUSTER_X * CLUSTER_Y; cluster < (slice + 1) * CLUSTER_X * CLUSTER_Y; cluster++)
+		{
+			auto& lights = m_ClusterLights[cluster];
+			if (!lights.empty())
+			{
+				memcpy(&m_Lists[m_Lists[cluster * 2]], lights.data(), lights.size() * sizeof(uint32_t));
+			}
+		}
+	};
+	if (parallel)
+	{
+		g_JobSystem->ParallelFor(0, CLUSTER_Z, 1, [&copySlice](size_t begin, size_t end)
+		{
+			for (auto slice = begin; slice < end; slice++)
+			{
+				copySlice(static_cast<uint32_t>(slice));
+			}
+		});
+	}
+	else
+	{
+		for (uint32_t slice = 0; slice < CLUSTER_Z; slice++)
+		{
+			copySlice(slice);
+		}
+	}
+	m_Stats.BinTime = timer.GetElapsedTime();
+	m_Stats.LightCount = lightCount;
+	m_Stats.VisibleLights = visibleLights;
+	m_Stats.IndexCount = offset - CLUSTER_COUNT * 2;
+}
+
+ClusterConstants ClusteredLighting::MakeConstants() const
+{
+	ClusterConstants constants = {};
+	for (int i = 0; i < 4; i++)
+	{
+		constants.ViewDepth[i] = m_View[i * 4 + 2] * m_DepthSign;
+	}
+	constants.ClusterCount[0] = CLUSTER_X;
+	constants.ClusterCount[1] = CLUSTER_Y;
+	constants.ClusterCount[2] = CLUSTER_Z;
+	constants.LightCount = m_LightCount;
+	constants.ClusterScale[0] = static_cast<float>(CLUSTER_X) / m_Width;
+	constants.ClusterScale[1] = static_cast<float>(CLUSTER_Y) / m_Height;
+	auto logRange = std::log(m_SliceDepths[CLUSTER_Z] / m_SliceDepths[0]);
+	constants.DepthScale = CLUSTER_Z / logRange;
+	constants.DepthBias = -CLUSTER_Z * std::log(m_SliceDepths[0]) / logRange;
+	return constants;
+}
+
+bool ClusteredLighting::Overlaps(const float center[3], float radius, uint32_t x, uint32_t y, uint32_t z) const
+{
+	return PlaneDistance(m_PlanesX[x], center[0], center[2]) > -radius && PlaneDistance(m_PlanesX[x + 1], center[0], center[2]) < radius
+		&& PlaneDistance(m_PlanesY[y], center[1], center[2]) < radius && PlaneDistance(m_PlanesY[y + 1], center[1], center[2]) > -radius
+		&& center[2] - radius < m_SliceDepths[z + 1] && center[2] + radius > m_SliceDepths[z]
+		&& SphereIntersectsBox(center, radius, m_Boxes[(z * CLUSTER_Y + y) * CLUSTER_X + x]);
+}
+
+bool ClusteredLighting::Validate(const PointLight* lights, uint32_t lightCount) const
+{
+	if (lightCount != m_LightCount || m_Lists.size() < CLUSTER_COUNT * 2)
+	{
+		return false;
+	}
+	std::vector<LightBounds> bounds(lightCount);
+	for (uint32_t light = 0; light < lightCount; light++)
+	{
+		TransformLight(lights[light], &bounds[light]);
+	}
+
+	// クラスターごとに全てのライトを調べる。クラスターの間は独立なので並列に調べる
+	std::vector<uint8_t> matched(CLUSTER_COUNT, 1);
+	auto validateCluster = [&](uint32_t cluster)
+	{
+		auto x = cluster % CLUSTER_X;
+		auto y = cluster / CLUSTER_X % CLUSTER_Y;
+		auto z = cluster / (CLUSTER_X * CLUSTER_Y);
+		auto list = &m_Lists[m_Lists[cluster * 2]];
+		auto count = m_Lists[cluster * 2 + 1];
+		uint32_t found = 0;
+		for (uint32_t light = 0; light < lightCount; light++)
+		{
+			if (Overlaps(bounds[light].Center, bounds[light].Radius, x, y, z))
+			{
+				if (found >= count || list[found] != light)
+				{
+					matched[cluster] = 0;
+					return;
+				}
+				found++;
+			}
+		}
+		matched[cluster] = found == count ? 1 : 0;
+	};
+	if (g_JobSystem != nullptr)
+	{
+		g_JobSystem->ParallelFor(0, CLUSTER_COUNT, 16, [&validateCluster](size_t begin, size_t end)
+		{
+			for (auto cluster = begin; cluster < end; cluster++)
+			{
+				validateCluster(static_cast<uint32_t>(cluster));
+			}
+		});
+	}
+	else
+	{
+		for (uint32_t cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+		{
+			validateCluster(cluster);
+		}
+	}
+	return std::find(matched.begin(), matched.end(), 0) == matched.end();
+}
+
+void ClusteredLighting::MakeTestLights(uint32_t count, uint32_t seed, std::vector<PointLight>& lights)
+{
+	auto random = [&seed]()
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8 & 0xffff) / 65535.0f;
+	};
+
+	// 1000個で100m四方になる地面の上（高さ0～20m）に、半径1～4mのライトを置く。カメラは手前の辺の真ん中から奥を向く
+	auto half = 50.0f * std::sqrt(count / 1000.0f);
+	lights.resize(count);
+	for (auto& light : lights)
+	{
+		light.Position[0] = (random() * 2.0f - 1.0f) * half;
+		light.Position[1] = random() * 20.0f;
+		light.Position[2] = -random() * half * 2.0f;
+		light.Radius = 1.0f + random() * 3.0f;
+		light.Color[0] = 0.2f + random() * 0.8f;
+		light.Color[1] = 0.2f + random() * 0.8f;
+		light.Color[2] = 0.2f + random() * 0.8f;
+		light.Intensity = light.Radius * light.Radius;
+	}
+}
+
+void ClusteredLighting::MakeTestCamera(float view[16], float projection[16])
+{
+	// XMMatrixLookAtRHで目の高さ10m、原点から少し下を向いたカメラと、Sceneと同じXMMatrixPerspectiveFovRH
+	const float Pitch = 0.15f;
+	auto c = std::cos(Pitch);
+	auto s = std::sin(Pitch);
+	const float EyeY = 10.0f;
+	float cameraView[16] =
+	{
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, c, s, 0.0f,
+		0.0f, -s, c, 0.0f,
+		0.0f, -c * EyeY, -s * EyeY, 1.0f,
+	};
+	memcpy(view, cameraView, sizeof(cameraView));
+
+	const float NearZ = 0.3f;
+	const float FarZ = 1000.0f;
+	auto yScale = 1.0f / std::tan(3.14159265f / 8.0f);
+	auto xScale = yScale / (static_cast<float>(DEFAULT_WIDTH) / DEFAULT_HEIGHT);
+	auto range = FarZ / (NearZ - FarZ);
+	float cameraProjection[16] =
+	{
+		xScale, 0.0f, 0.0f, 0.0f,
+		0.0f, yScale, 0.0f, 0.0f,
+		0.0f, 0.0f, range, -1.0f,
+		0.0f, 0.0f, range * NearZ, 0.0f,
+	};
+	memcpy(projection, cameraProjection, sizeof(cameraProjection));
+}
+
+bool ClusteredLighting::RunBenchmark(int iterations)
+{
+	float view[16];
+	float projection[16];
+	MakeTestCamera(view, projection);
+
+	bool allMatched = true;
+	const uint32_t Counts[] = { 1000, 10000, 100000 };
+	for (auto count : Counts)
+	{
+		std::vector<PointLight> lights;
+		MakeTestLights(count, 12345, lights);
+		ClusteredLighting clusters;
+		clusters.Init(DEFAULT_WIDTH, DEFAULT_HEIGHT, projection);
+
+		// 並列と1スレッドで振り分け、どちらも総当たりと同じ並びになる
+		double transformTime[2] = {};
+		double binTime[2] = {};
+		bool matched = true;
+		for (int pass = 0; pass < 2; pass++)
+		{
+			for (int i = 0; i < iterations; i++)
+			{
+				clusters.Build(view, lights.data(), count, pass == 0);
+				transformTime[pass] += clusters.GetStats().TransformTime;
+				binTime[pass] += clusters.GetStats().BinTime;
+			}
+			matched = matched && clusters.Validate(lights.data(), count);
+		}
+		allMatched = allMatched && matched;
+
+		auto& stats = clusters.GetStats();
+		printf("クラスターライティング: ライト %u個, クラスター %dx%dx%d, %d回の平均\n",
+			count, CLUSTER_X, CLUSTER_Y, CLUSTER_Z, iterations);
+		printf("  振り分け: %.3f ms (変換 %.3f ms, %uスレッド), %.3f ms (変換 %.3f ms, 1スレッド)\n",
+			(transformTime[0] + binTime[0]) / iterations, transformTime[0] / iterations, g_JobSystem != nullptr ? g_JobSystem->WorkerCount() : 1,
+			(transformTime[1] + binTime[1]) / iterations, transformTime[1] / iterations);
+		printf("  視錐台に掛かるライト: %u個, 番号: %u個, ライトのあるクラスター: %u個, 1クラスターの最大: %u個\n",
+			stats.VisibleLights, stats.IndexCount, stats.OccupiedClusters, stats.MaxClusterLights);
+		printf("  総当たりとの比較: %s\n", matched ? "一致" : "不一致");
+	}
+	return allMatched;
+}
@@ -0,0 +1,187 @@
+#include "CommandListFilter.h"
+#include <initializer_list>
+#include <stdio.h>
+
+namespace
+{
+	struct ExpectedCommand
+	{
+		NullCommandType Type;
+		uint64_t Args[3];
+	};
+
+	template<typename P>
+	uint64_t Id(P* p)
+	{
+		return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(p));
+	}
+
+	// リストに記録されたコマンドが期待通りか比べ、次の確認のために空にする
+	bool Matches(const char* label, NullCommandList& commandList, std::initializer_list<ExpectedCommand> expected)
+	{
+		auto& commands = commandList.Commands();
+		bool isValid = commands.size() == expected.size();
+		size_t index = 0;
+		for (auto& e : expected)
+		{
+			if (!isValid)
+			{
+				break;
+			}
+			auto& c = commands[index++];
+			isValid = c.Type == e.Type && c.Args[0] == e.Args[0] && c.Args[1] == e.Args[1] && c.Args[2] == e.Args[2];
+		}
+
+		if (!isValid)
+		{
+			printf("  %s: 記録されたコマンドが違う (%zu個, 期待 %zu個)\n", label, commands.size(), expected.size());
+			for (auto& c : commands)
+			{
+				printf("    %s %llu %llu %llu\n", NullCommandList::Name(c.Type), static_cast<unsigned long long>(c.Args[0]),
+					static_cast<unsigned long long>(c.Args[1]), static_cast<unsigned long long>(c.Args[2]));
+			}
+		}
+		commandList.Reset();
+		return isValid;
+	}
+}
+
+template<>
+bool CommandListFilter<NullCommandList>::RunTest()
+{
+	// オブジェクトは中身を使わないので、アドレスを名前の代わりにする
+	NullRootSignature rootSignatures[2] = {};
+	NullPipelineState pipelineStates[2] = {};
+	NullDescriptorHeap heaps[2] = {};
+	NullDescriptorHeap* heap0[] = { &heaps[0] };
+	NullDescriptorHeap* heap1[] = { &heaps[1] };
+	const RhiGpuAddress ConstantAddress = 0x10000;
+	const RhiGpuDescriptor Table = { 0x20000 };
+	const RhiVertexBufferView VertexBuffer = { 0x30000, 1024, 32 };
+	const RhiVertexBufferView OtherStride = { 0x30000, 1024, 16 };
+	const RhiIndexBufferView IndexBuffer = { 0x40000, 512, RHI_FORMAT_R32_UINT };
+	const RhiCpuDescriptor RenderTarget = { 0x50000 };
+	const RhiCpuDescriptor DepthStencil = { 0x60000 };
+
+	bool isValid = true;
+	NullCommandList commandList;
+	CommandListFilter<NullCommandList> filter(&commandList);
+
+	// 同じ状態の設定を続けても、最初の1回だけが発行される
+	for (int i = 0; i < 2; i++)
+	{
+		filter.SetGraphicsRootSignature(&rootSignatures[0]);
+		filter.SetPipelineState(&pipelineStates[0]);
+		filter.IASetPrimitiveTopology(RHI_TOPOLOGY_TRIANGLELIST);
+		filter.IASetVertexBuffers(0, 1, &VertexBuffer);
+		filter.IASetIndexBuffer(&IndexBuffer);
+		filter.OMSetRenderTargets(1, &RenderTarget, FALSE, &DepthStencil);
+		filter.DrawIndexedInstanced(36, 1, 0, 0, 0);
+	}
+	isValid &= Matches("重複する設定", commandList,
+	{
+		{ NULL_COMMAND_SET_ROOT_SIGNATURE, { Id(&rootSignatures[0]), 0, 0 } },
+		{ NULL_COMMAND_SET_PIPELINE_STATE, { Id(&pipelineStates[0]), 0, 0 } },
+		{ NULL_COMMAND_SET_TOPOLOGY, { RHI_TOPOLOGY_TRIANGLELIST, 0, 0 } },
+		{ NULL_COMMAND_SET_VERTEX_BUFFERS, { 0, 1, VertexBuffer.BufferLocation } },
+		{ NULL_COMMAND_SET_INDEX_BUFFER, { IndexBuffer.BufferLocation, IndexBuffer.SizeInBytes, 0 } },
+		{ NULL_COMMAND_SET_RENDER_TARGETS, { 1, RenderTarget.ptr, DepthStencil.ptr } },
+		{ NULL_COMMAND_DRAW_INDEXED, { 36, 1, 0 } },
+		{ NULL_COMMAND_DRAW_INDEXED, { 36, 1, 0 } },
+	});
+	if (filter.IssuedCount() != 8 || filter.ElidedCount() != 6)
+	{
+		printf("  発行 %u回, 破棄 %u回 (期待 8回, 6回)\n", filter.IssuedCount(), filter.ElidedCount());
+		isValid = false;
+	}
+
+	// 一部でも変われば発行する（頂点バッファはアドレスが同じでもストライドが違えば別のもの）
+	filter.SetPipelineState(&pipelineStates[1]);
+	filter.IASetPrimitiveTopology(RHI_TOPOLOGY_UNDEFINED);
+	filter.IASetVertexBuffers(0, 1, &OtherStride);
+	filter.IASetIndexBuffer(nullptr);
+	filter.OMSetRenderTargets(1, &RenderTarget, FALSE, nullptr);
+	isValid &= Matches("変わった設定", commandList,
+	{
+		{ NULL_COMMAND_SET_PIPELINE_STATE, { Id(&pipelineStates[1]), 0, 0 } },
+		{ NULL_COMMAND_SET_TOPOLOGY, { RHI_TOPOLOGY_UNDEFINED, 0, 0 } },
+		{ NULL_COMMAND_SET_VERTEX_BUFFERS, { 0, 1, OtherStride.BufferLocation } },
+		{ NULL_COMMAND_SET_INDEX_BUFFER, { 0, 0, 0 } },
+		{ NULL_COMMAND_SET_RENDER_TARGETS, { 1, RenderTarget.ptr, 0 } },
+	});
+
+	// ルート引数は同じ値なら捨てる。同じルートシグネチャの設定し直しでは忘れないが、
+	// 別のルートシグネチャにすると全て無効になるので、同じ値でも発行し直す
+	filter.SetDescriptorHeaps(1, heap0);
+	filter.SetGraphicsRootConstantBufferView(0, ConstantAddress);
+	filter.SetGraphicsRootDescriptorTable(1, Table);
+	filter.SetGraphicsRootConstantBufferView(0, ConstantAddress);
+	filter.SetGraphicsRootDescriptorTable(1, Table);
+	filter.SetGraphicsRootSignature(&rootSignatures[0]);
+	filter.SetGraphicsRootConstantBufferView(0, ConstantAddress);
+	filter.SetGraphicsRootSignature(&rootSignatures[1]);
+	filter.SetGraphicsRootConstantBufferView(0, ConstantAddress);
+	filter.SetGraphicsRootDescriptorTable(1, Table);
+	isValid &= Matches("ルートシグネチャの変更", commandList,
+	{
+		{ NULL_COMMAND_SET_DESCRIPTOR_HEAPS, { 1, Id(&heaps[0]), 0 } },
+		{ NULL_COMMAND_SET_ROOT_CBV, { 0, ConstantAddress, 0 } },
+		{ NULL_COMMAND_SET_ROOT_TABLE, { 1, Table.ptr, 0 } },
+		{ NULL_COMMAND_SET_ROOT_SIGNATURE, { Id(&rootSignatures[1]), 0, 0 } },
+		{ NULL_COMMAND_SET_ROOT_CBV, { 0, ConstantAddress, 0 } },
+		{ NULL_COMMAND_SET_ROOT_TABLE, { 1, Table.ptr, 0 } },
+	});
+
+	// ヒープを変えるとテーブルだけが無効になる（CBVはヒープを指さないので残る）。同じヒープなら何も忘れない
+	filter.SetDescriptorHeaps(1, heap0);
+	filter.SetGraphicsRootDescriptorTable(1, Table);
+	filter.SetDescriptorHeaps(1, heap1);
+	filter.SetGraphicsRootConstantBufferView(0, ConstantAddress);
+	filter.SetGraphicsRootDescriptorTable(1, Table);
+	isValid &= Matches("ヒープの変更", commandList,
+	{
+		{ NULL_COMMAND_SET_DESCRIPTOR_HEAPS, { 1, Id(&heaps[1]), 0 } },
+		{ NULL_COMMAND_SET_ROOT_TABLE, { 1, Table.ptr, 0 } },
+	});
+
+	// ルート定数は同じパラメーターでは最後のオフセットしか覚えないので、別のオフセットを挟むと
+	// 同じ値の設定でも発行し直す（捨てられる呼び出しが残るだけで、必要な呼び出しを捨てることはない）
+	// 同じ値でもオフセットが違えば別の設定
+	filter.SetGraphicsRoot32BitConstant(2, 5, 0);
+	filter.SetGraphicsRoot32BitConstant(2, 5, 0);
+	filter.SetGraphicsRoot32BitConstant(2, 7, 1);
+	filter.SetGraphicsRoot32BitConstant(2, 5, 0);
+	filter.SetGraphicsRoot32BitConstant(2, 6, 0);
+	filter.SetGraphicsRoot32BitConstant(3, 6, 0);
+	filter.SetGraphicsRoot32BitConstant(3, 6, 1);
+	isValid &= Matches("ルート定数のオフセット", commandList,
+	{
+		{ NULL_COMMAND_SET_ROOT_CONSTANT, { 2, 5, 0 } },
+		{ NULL_COMMAND_SET_ROOT_CONSTANT, { 2, 7, 1 } },
+		{ NULL_COMMAND_SET_ROOT_CONSTANT, { 2, 5, 0 } },
+		{ NULL_COMMAND_SET_ROOT_CONSTANT, { 2, 6, 0 } },
+		{ NULL_COMMAND_SET_ROOT_CONSTANT, { 3, 6, 0 } },
+		{ NULL_COMMAND_SET_ROOT_CONSTANT, { 3, 6, 1 } },
+	});
+
+	// 種類の違うルート引数で同じ値を設定しても捨てない
+	filter.SetGraphicsRootShaderResourceView(0, ConstantAddress);
+	isValid &= Matches("ルート引数の種類", commandList, { { NULL_COMMAND_SET_ROOT_SRV, { 0, ConstantAddress, 0 } } });
+
+	// Invalidateの後（フィルターを通さずにリストを変えた後）は全て発行し直す
+	filter.Invalidate();
+	filter.SetGraphicsRootSignature(&rootSignatures[1]);
+	filter.SetPipelineState(&pipelineStates[1]);
+	filter.SetDescriptorHeaps(1, heap1);
+	filter.IASetPrimitiveTopology(RHI_TOPOLOGY_UNDEFINED);
+	isValid &= Matches("Invalidateの後", commandList,
+	{
+		{ NULL_COMMAND_SET_ROOT_SIGNATURE, { Id(&rootSignatures[1]), 0, 0 } },
+		{ NULL_COMMAND_SET_PIPELINE_STATE, { Id(&pipelineStates[1]), 0, 0 } },
+		{ NULL_COMMAND_SET_DESCRIPTOR_HEAPS, { 1, Id(&heaps[1]), 0 } },
+		{ NULL_COMMAND_SET_TOPOLOGY, { RHI_TOPOLOGY_UNDEFINED, 0, 0 } },
+	});
+
+	printf("コマンドリストのフィルターのテスト: %s\n", isValid ? "成功" : "失敗");
+	return isValid;
+}
@@ -1,61 +1,72 @@
 #include "ConstantBuffer.h"
-#include "Engine.h"
+#include "FrameStats.h"
+#include <stdio.h>
 
-ConstantBuffer::ConstantBuffer(size_t size)
+template<typename Backend>
+BasicConstantBuffer<Backend>::BasicConstantBuffer(size_t size)
 {
-	size_t align = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT;
+	size_t align = RHI_CONSTANT_BUFFER_ALIGNMENT;
 	UINT64 sizeAligned = (size + (align - 1)) & ~(align - 1);
 
-	auto prop = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-	auto desc = CD3DX12_RESOURCE_DESC::Buffer(sizeAligned);
-
-	auto hr = g_Engine->Device()->CreateCommittedResource(
-		&prop,
-		D3D12_HEAP_FLAG_NONE,
-		&desc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(m_pBuffer.GetAddressOf())
-	);
-
-	if(FAILED(hr))
+	if (!m_Buffer.Create(sizeAligned, RHI_HEAP_UPLOAD))
 	{
 		printf("定数バッファリソースの生成に失敗\n");
 		return;
 	}
 
 	// 更新するのでMapしたまま
-	hr = m_pBuffer->Map(0, nullptr, &m_pMappedPtr);
-	if(FAILED(hr))
+	m_pMappedPtr = m_Buffer.Map();
+	if (m_pMappedPtr == nullptr)
 	{
 		printf("定数バッファリソースのマップに失敗\n");
 		return;
 	}
 
 	m_Desc = {};
-	m_Desc.BufferLocation = m_pBuffer->GetGPUVirtualAddress();
+	m_Desc.BufferLocation = m_Buffer.GpuAddress();
 	m_Desc.SizeInBytes = static_cast<UINT>(sizeAligned);
 
+	FrameStats::Add(STAT_RESOURCE_COUNT, 1);
+	FrameStats::Add(STAT_RESOURCE_BYTES, m_Desc.SizeInBytes);
 	m_IsValid = true;
 }
 
-bool ConstantBuffer::IsValid()
+template<typename Backend>
+BasicConstantBuffer<Backend>::~BasicConstantBuffer()
+{
+	if (m_IsValid)
+	{
+		FrameStats::Add(STAT_RESOURCE_COUNT, -1);
+		FrameStats::Add(STAT_RESOURCE_BYTES, -static_cast<int64_t>(m_Desc.SizeInBytes));
+	}
+}
+
+template<typename Backend>
+bool BasicConstantBuffer<Backend>::IsValid()
 {
 	return m_IsValid;
 }
 
-D3D12_GPU_VIRTUAL_ADDRESS ConstantBuffer::GetAddress() const
+template<typename Backend>
+RhiGpuAddress BasicConstantBuffer<Backend>::GetAddress() const
 {
 	return m_Desc.BufferLocation;
 }
 
-D3D12_CONSTANT_BUFFER_VIEW_DESC ConstantBuffer::ViewDesc() const
+template<typename Backend>
+RhiConstantBufferViewDesc BasicConstantBuffer<Backend>::ViewDesc() const
 {
 	return m_Desc;
 }
 
 // ここに値を入れればマップされる、アドレスの先頭から、サイズ<T>分だけ持ってくる
-void* ConstantBuffer::GetPtr() const
+template<typename Backend>
+void* BasicConstantBuffer<Backend>::GetPtr() const
 {
 	return m_pMappedPtr;
-}
\ No newline at end of file
+}
+
+template class BasicConstantBuffer<NullBackend>;
+#ifdef RHI_HAS_D3D12
+template class BasicConstantBuffer<D3D12Backend>;
+#endif
@@ -0,0 +1,84 @@
+#include "ConstantRing.h"
+#include "FrameStats.h"
+#include <stdio.h>
+
+template<typename Backend>
+BasicConstantRing<Backend>::BasicConstantRing(size_t size)
+{
+	size_t align = RHI_CONSTANT_BUFFER_ALIGNMENT;
+	UINT64 sizeAligned = (size + (align - 1)) & ~(align - 1);
+
+	if (!m_Buffer.Create(sizeAligned, RHI_HEAP_UPLOAD))
+	{
+		printf("定数リングバッファの生成に失敗\n");
+		return;
+	}
+
+	// 書き込むだけなのでMapしたまま
+	m_pMappedPtr = static_cast<UINT8*>(m_Buffer.Map());
+	if (m_pMappedPtr == nullptr)
+	{
+		printf("定数リングバッファのマップに失敗\n");
+		return;
+	}
+
+	m_BaseAddress = m_Buffer.GpuAddress();
+	m_Size = static_cast<size_t>(sizeAligned);
+
+	m_IsValid = true;
+}
+
+template<typename Backend>
+bool BasicConstantRing<Backend>::IsValid()
+{
+	return m_IsValid;
+}
+
+template<typename Backend>
+ConstantAllocation BasicConstantRing<Backend>::Allocate(size_t size)
+{
+	size_t align = RHI_CONSTANT_BUFFER_ALIGNMENT;
+	size_t sizeAligned = (size + (align - 1)) & ~(align - 1);
+
+	ConstantAllocation allocation;
+	if (m_Offset + sizeAligned > m_Size)
+	{
+		printf("定数リングバッファが足りません (%zu / %zu bytes)\n", m_Offset + sizeAligned, m_Size);
+		return allocation;
+	}
+
+	allocation.Ptr = m_pMappedPtr + m_Offset;
+	allocation.Address = m_BaseAddress + m_Offset;
+	allocation.Offset = m_Offset;
+	m_Offset += sizeAligned;
+	FrameStats::Add(STAT_UPLOAD_BYTES, size);
+	if (m_Offset > m_PeakBytes)
+	{
+		m_PeakBytes = m_Offset;
+	}
+
+	return allocation;
+}
+
+template<typename Backend>
+void BasicConstantRing<Backend>::Reset()
+{
+	m_Offset = 0;
+}
+
+template<typename Backend>
+size_t BasicConstantRing<Backend>::UsedBytes() const
+{
+	return m_Offset;
+}
+
+template<typename Backend>
+size_t BasicConstantRing<Backend>::PeakBytes() const
+{
+	return m_PeakBytes;
+}
+
+template class BasicConstantRing<NullBackend>;
+#ifdef RHI_HAS_D3D12
+template class BasicConstantRing<D3D12Backend>;
+#endif
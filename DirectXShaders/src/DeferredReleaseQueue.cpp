@@ -0,0 +1,89 @@
+#include "DeferredReleaseQueue.h"
+
+DeferredReleaseQueue::~DeferredReleaseQueue()
+{
+	ReleaseAll();
+}
+
+void DeferredReleaseQueue::Enqueue(void* pObject, Deleter deleter, uint64_t size)
+{
+	Node* pNode = new Node();
+	pNode->pObject = pObject;
+	pNode->pDeleter = deleter;
+	pNode->Size = size;
+	pNode->FenceValue = m_CurrentFenceValue.load(std::memory_order_acquire);
+
+	// 先頭に繋ぐだけなのでCASで済む（取り出しは回収側が一括で行うのでABAは起きない）
+	pNode->pNext = m_pIncoming.load(std::memory_order_relaxed);
+	while (!m_pIncoming.compare_exchange_weak(pNode->pNext, pNode,
+		std::memory_order_release, std::memory_order_relaxed))
+	{
+	}
+
+	auto retained = m_RetainedBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	auto peak = m_PeakRetainedBytes.load(std::memory_order_relaxed);
+	while (peak < retained && !m_PeakRetainedBytes.compare_exchange_weak(peak, retained, std::memory_order_relaxed))
+	{
+	}
+}
+
+void DeferredReleaseQueue::SetCurrentFenceValue(uint64_t fenceValue)
+{
+	m_CurrentFenceValue.store(fenceValue, std::memory_order_release);
+}
+
+void DeferredReleaseQueue::TakeIncoming()
+{
+	Node* pNode = m_pIncoming.exchange(nullptr, std::memory_order_acquire);
+	while (pNode != nullptr)
+	{
+		m_Pending.push_back(pNode);
+		pNode = pNode->pNext;
+	}
+}
+
+void DeferredReleaseQueue::Free(Node* pNode)
+{
+	pNode->pDeleter(pNode->pObject);
+	m_RetainedBytes.fetch_sub(pNode->Size, std::memory_order_relaxed);
+	delete pNode;
+}
+
+size_t DeferredReleaseQueue::Collect(uint64_t completedFenceValue)
+{
+	TakeIncoming();
+
+	// 完了したものを一度に解放し、残りだけ詰め直す
+	size_t released = 0;
+	size_t kept = 0;
+	for (size_t i = 0; i < m_Pending.size(); i++)
+	{
+		auto pNode = m_Pending[i];
+		if (pNode->FenceValue <= completedFenceValue)
+		{
+			Free(pNode);
+			released++;
+		}
+		else
+		{
+			m_Pending[kept++] = pNode;
+		}
+	}
+	m_Pending.resize(kept);
+
+	return released;
+}
+
+size_t DeferredReleaseQueue::ReleaseAll()
+{
+	TakeIncoming();
+
+	size_t released = m_Pending.size();
+	for (auto pNode : m_Pending)
+	{
+		Free(pNode);
+	}
+	m_Pending.clear();
+
+	return released;
+}
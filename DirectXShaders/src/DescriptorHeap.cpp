@@ -2,8 +2,7 @@
 #include "Texture2D.h"
 #include <d3dx12.h>
 #include "Engine.h"
-
-const UINT HANDLE_MAX = 512;
+#include "FrameStats.h"
 
 DescriptorHeap::DescriptorHeap()
 {
@@ -28,6 +27,7 @@ DescriptorHeap::DescriptorHeap()
 	}
 
 	m_IncrementSize = device->GetDescriptorHandleIncrementSize(desc.Type);
+	FrameStats::SetLimit(STAT_DESCRIPTORS, HANDLE_MAX);
 	m_IsValid = true;
 }
 
@@ -54,6 +54,7 @@ DescriptorHandle* DescriptorHeap::Register(Texture2D* texture)
 
 	pHandle->HandleCPU = handleCPU;
 	pHandle->HandleGPU = handleGPU;
+	pHandle->Index = static_cast<UINT>(count);
 
 	auto device = g_Engine->Device();
 	auto resource = texture->Resource();
@@ -61,5 +62,6 @@ DescriptorHandle* DescriptorHeap::Register(Texture2D* texture)
 	device->CreateShaderResourceView(resource, &desc, pHandle->HandleCPU);
 
 	m_pHandles.push_back(pHandle);
+	FrameStats::Add(STAT_DESCRIPTORS, 1);
 	return pHandle;
 }
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "DrawPartitioner.h"
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+
+std::vector<DrawRange> DrawPartitioner::Partition(const std::vector<uint32_t>& costs, uint32_t partitionCount, uint32_t minDrawsPerPartition)
+{
+	std::vector<DrawRange> ranges;
+	auto drawCount = static_cast<uint32_t>(costs.size());
+	if (drawCount == 0)
+	{
+		return ranges;
+	}
+
+	// 描画が少なければスレッドを減らす（1スレッドあたりの固定の手間の方が大きくなる）
+	// どの範囲にも最低の数が入るように切り捨てる。最低の数に満たなければ1つの範囲にまとめる
+	minDrawsPerPartition = std::max(minDrawsPerPartition, 1u);
+	auto count = std::max(1u, std::min(partitionCount, drawCount / minDrawsPerPartition));
+
+	uint64_t total = 0;
+	for (auto cost : costs)
+	{
+		total += cost;
+	}
+
+	ranges.reserve(count);
+	uint32_t begin = 0;
+	uint64_t accumulated = 0;
+	for (uint32_t k = 0; k < count; k++)
+	{
+		DrawRange range = { begin, begin, 0 };
+
+		if (k + 1 == count)
+		{
+			// 最後の範囲は残り全部
+			range.End = drawCount;
+		}
+		else
+		{
+			// 累積コストがk+1番目の境界に一番近くなるところで区切る
+			auto boundary = total * (k + 1) / count;
+			auto limit = drawCount - (count - k - 1) * minDrawsPerPartition; // 後ろの範囲に最低の数ずつは残す
+			uint32_t end = begin + minDrawsPerPartition;
+			auto sum = accumulated;
+			for (auto i = begin; i < end; i++)
+			{
+				sum += costs[i];
+			}
+			while (end < limit && (sum + costs[end] / 2) < boundary)
+			{
+				sum += costs[end];
+				end++;
+			}
+			range.End = end;
+		}
+
+		for (auto i = range.Begin; i < range.End; i++)
+		{
+			range.Cost += costs[i];
+		}
+		accumulated += range.Cost;
+		begin = range.End;
+		ranges.push_back(range);
+	}
+
+	return ranges;
+}
+
+bool DrawPartitioner::RunTest()
+{
+	bool passed = true;
+	auto fail = [&](const char* message, uint32_t drawCount, uint32_t partitionCount, uint32_t minDraws)
+	{
+		printf("  %s (描画 %u, 分割 %u, 最低 %u)\n", message, drawCount, partitionCount, minDraws);
+		passed = false;
+	};
+
+	// 最低の数に満たない範囲は作らない（65個を最低64個で分けても1つのまま）
+	std::vector<uint32_t> uniform(65, 1);
+	if (Partition(uniform, 4, 64).size() != 1)
+	{
+		fail("最低の数に満たない範囲を作った", 65, 4, 64);
+	}
+	uniform.assign(128, 1);
+	if (Partition(uniform, 4, 64).size() != 2)
+	{
+		fail("最低の数ずつ入る分だけ分けていない", 128, 4, 64);
+	}
+	if (!Partition({}, 4, 1).empty())
+	{
+		fail("描画が無いのに範囲を作った", 0, 4, 1);
+	}
+
+	// 固定の種でばらつきのあるコストを作り、分け方の条件を確かめる
+	uint32_t seed = 12345;
+	auto random = [&seed](uint32_t range)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) % range;
+	};
+	for (uint32_t trial = 0; trial < 200; trial++)
+	{
+		auto drawCount = random(2000);
+		auto partitionCount = 1 + random(8);
+		auto minDraws = 1 + random(100);
+		std::vector<uint32_t> costs(drawCount);
+		uint64_t total = 0;
+		uint32_t maxCost = 0;
+		for (auto& cost : costs)
+		{
+			cost = 2 + random(trial % 2 == 0 ? 15 : 200); // 状態の切り替えの有無で呼び出しの数は2～14ほど変わる
+			total += cost;
+			maxCost = std::max(maxCost, cost);
+		}
+
+		auto ranges = Partition(costs, partitionCount, minDraws);
+		if (ranges != Partition(costs, partitionCount, minDraws))
+		{
+			fail("同じ入力で分け方が変わった", drawCount, partitionCount, minDraws);
+			continue;
+		}
+		if (drawCount == 0)
+		{
+			continue;
+		}
+
+		uint32_t expectedCount = std::max(1u, std::min(partitionCount, drawCount / minDraws));
+		if (ranges.size() != expectedCount)
+		{
+			fail("範囲の数が合わない", drawCount, partitionCount, minDraws);
+			continue;
+		}
+
+		uint32_t begin = 0;
+		for (auto& range : ranges)
+		{
+			uint64_t cost = 0;
+			for (auto i = range.Begin; i < range.End; i++)
+			{
+				cost += costs[i];
+			}
+			if (range.Begin != begin || range.End <= range.Begin || range.Cost != cost)
+			{
+				fail("範囲が続いていないか、コストが合わない", drawCount, partitionCount, minDraws);
+				break;
+			}
+			if (ranges.size() > 1 && range.End - range.Begin < minDraws)
+			{
+				fail("最低の数に満たない範囲がある", drawCount, partitionCount, minDraws);
+				break;
+			}
+			// 最低の数で押し出されない限り、境界は1つの描画のコストの範囲でずれるだけ
+			if (drawCount >= 4 * minDraws * ranges.size() && range.Cost > total / ranges.size() + 2 * maxCost)
+			{
+				fail("範囲のコストが偏っている", drawCount, partitionCount, minDraws);
+				break;
+			}
+			begin = range.End;
+		}
+		if (begin != drawCount)
+		{
+			fail("全ての描画を範囲に入れていない", drawCount, partitionCount, minDraws);
+		}
+	}
+
+	// Recordは範囲ごとにちょうど1回ずつ呼ぶ
+	uniform.assign(1000, 1);
+	auto ranges = Partition(uniform, 6, 1);
+	std::vector<std::atomic<uint32_t>> calls(ranges.size());
+	Record(ranges, [&](uint32_t index, const DrawRange&) { calls[index]++; });
+	for (auto& call : calls)
+	{
+		if (call != 1)
+		{
+			fail("範囲ごとに1回ずつ記録していない", 1000, 6, 1);
+			break;
+		}
+	}
+
+	printf("描画の分割のテスト: %s\n", passed ? "成功" : "失敗");
+	return passed;
+}
@@ -0,0 +1,248 @@
+#include "DrawQueue.h"
+#include "JobSystem.h"
+#include "Timer.h"
+#include <algorithm>
+#include <stdio.h>
+
+namespace
+{
+	const int RadixBits = 8;
+	const uint32_t RadixSize = 1 << RadixBits;
+	const int RadixPasses = 64 / RadixBits;
+	const size_t MinItemsPerChunk = 4096; // これより細かく分けても並列にした得が無い
+
+	uint64_t FieldMask(int shift, int bits)
+	{
+		return ((1ull << bits) - 1) << shift;
+	}
+
+	// 区間ごとにfunc(区間の番号)を呼ぶ
+	template<typename Func>
+	void ForEachChunk(size_t chunkCount, bool parallel, Func&& func)
+	{
+		if (parallel && chunkCount > 1)
+		{
+			g_JobSystem->ParallelFor(0, chunkCount, 1, [&func](size_t begin, size_t end)
+			{
+				for (auto chunk = begin; chunk < end; chunk++)
+				{
+					func(chunk);
+				}
+			});
+		}
+		else
+		{
+			for (size_t chunk = 0; chunk < chunkCount; chunk++)
+			{
+				func(chunk);
+			}
+		}
+	}
+}
+
+uint32_t DrawKey::DepthBucket(float normalizedDepth)
+{
+	const uint32_t MaxBucket = (1u << DEPTH_BITS) - 1;
+	if (!(normalizedDepth > 0.0f))
+	{
+		return 0; // NaNも手前に寄せる
+	}
+	if (normalizedDepth >= 1.0f)
+	{
+		return MaxBucket;
+	}
+	return static_cast<uint32_t>(normalizedDepth * MaxBucket + 0.5f);
+}
+
+uint32_t DrawKey::ChangedFields(uint64_t a, uint64_t b)
+{
+	auto diff = a ^ b;
+	uint32_t changed = 0;
+	changed |= (diff & FieldMask(PASS_SHIFT, PASS_BITS)) ? FIELD_PASS : 0;
+	changed |= (diff & FieldMask(PIPELINE_SHIFT, PIPELINE_BITS)) ? FIELD_PIPELINE : 0;
+	changed |= (diff & FieldMask(MATERIAL_SHIFT, MATERIAL_BITS)) ? FIELD_MATERIAL : 0;
+	changed |= (diff & FieldMask(DEPTH_SHIFT, DEPTH_BITS)) ? FIELD_DEPTH : 0;
+	changed |= (diff & FieldMask(GEOMETRY_SHIFT, GEOMETRY_BITS)) ? FIELD_GEOMETRY : 0;
+	return changed;
+}
+
+void DrawQueue::Sort()
+{
+	RadixSort(m_Items, m_Scratch);
+}
+
+DrawStateChanges DrawQueue::CountStateChanges(uint32_t begin, uint32_t end) const
+{
+	return Submit(begin, end, [](const DrawItem&, uint32_t) {});
+}
+
+void DrawQueue::RadixSort(std::vector<DrawItem>& items, std::vector<DrawItem>& scratch, bool parallel)
+{
+	auto count = items.size();
+	if (count < 2)
+	{
+		return;
+	}
+	scratch.resize(count);
+
+	parallel = parallel && g_JobSystem != nullptr;
+	size_t chunkCount = 1;
+	if (parallel)
+	{
+		chunkCount = std::min<size_t>(g_JobSystem->WorkerCount() * 2, (count + MinItemsPerChunk - 1) / MinItemsPerChunk);
+		chunkCount = std::max<size_t>(chunkCount, 1);
+	}
+	auto chunkSize = (count + chunkCount - 1) / chunkCount;
+	auto chunkBegin = [&](size_t chunk) { return std::min<size_t>(chunk * chunkSize, count); };
+
+	// 先頭のキーと違うビットを集める。0のままの桁は全てのキーで同じなので並べる必要が無い
+	std::vector<uint64_t> chunkDiffs(chunkCount, 0);
+	ForEachChunk(chunkCount, parallel, [&](size_t chunk)
+	{
+		auto first = items[0].Key;
+		uint64_t diff = 0;
+		auto end = chunkBegin(chunk + 1);
+		for (auto i = chunkBegin(chunk); i < end; i++)
+		{
+			diff |= items[i].Key ^ first;
+		}
+		chunkDiffs[chunk] = diff;
+	});
+	uint64_t diff = 0;
+	for (auto chunkDiff : chunkDiffs)
+	{
+		diff |= chunkDiff;
+	}
+
+	// 区間ごとの度数（桁の値が主、区間が従の順に並べると、そのまま書き込み先の先頭になる）
+	std::vector<uint32_t> offsets(chunkCount * RadixSize);
+	auto pSrc = &items;
+	auto pDst = &scratch;
+
+	for (int pass = 0; pass < RadixPasses; pass++)
+	{
+		auto shift = pass * RadixBits;
+		if (((diff >> shift) & (RadixSize - 1)) == 0)
+		{
+			continue;
+		}
+
+		auto src = pSrc->data();
+		auto dst = pDst->data();
+
+		ForEachChunk(chunkCount, parallel, [&](size_t chunk)
+		{
+			uint32_t histogram[RadixSize] = {};
+			auto end = chunkBegin(chunk + 1);
+			for (auto i = chunkBegin(chunk); i < end; i++)
+			{
+				histogram[(src[i].Key >> shift) & (RadixSize - 1)]++;
+			}
+			for (uint32_t digit = 0; digit < RadixSize; digit++)
+			{
+				offsets[digit * chunkCount + chunk] = histogram[digit];
+			}
+		});
+
+		uint32_t sum = 0;
+		for (auto& offset : offsets)
+		{
+			auto value = offset;
+			offset = sum;
+			sum += value;
+		}
+
+		// 区間の中は前から順に書くので、同じ桁の値の間では元の順番が保たれる
+		ForEachChunk(chunkCount, parallel, [&](size_t chunk)
+		{
+			uint32_t cursor[RadixSize];
+			for (uint32_t digit = 0; digit < RadixSize; digit++)
+			{
+				cursor[digit] = offsets[digit * chunkCount + chunk];
+			}
+			auto end = chunkBegin(chunk + 1);
+			for (auto i = chunkBegin(chunk); i < end; i++)
+			{
+				dst[cursor[(src[i].Key >> shift) & (RadixSize - 1)]++] = src[i];
+			}
+		});
+
+		std::swap(pSrc, pDst);
+	}
+
+	if (pSrc != &items)
+	{
+		items.swap(scratch);
+	}
+}
+
+void DrawQueue::RunBenchmark(uint32_t drawCount)
+{
+	// ジオメトリごとにマテリアルが、マテリアルごとにパイプラインが決まる、実際のシーンに近い分布にする
+	const uint32_t PassCount = 2;
+	const uint32_t PipelineCount = 32;
+	const uint32_t MaterialCount = 1024;
+	const uint32_t GeometryCount = 4096;
+	const int Iterations = 20;
+
+	DrawQueue queue;
+	queue.Reserve(drawCount);
+	uint32_t seed = 12345;
+	auto random = [&seed]()
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return seed >> 8;
+	};
+	for (uint32_t i = 0; i < drawCount; i++)
+	{
+		auto geometry = random() % GeometryCount;
+		auto material = (geometry * 2654435761u >> 16) % MaterialCount;
+		auto pipeline = material % PipelineCount;
+		auto pass = random() % PassCount;
+		auto depth = DrawKey::DepthBucket((random() & 0xffff) / 65535.0f);
+		queue.Push(DrawKey::Make(pass, pipeline, material, depth, geometry), i);
+	}
+
+	auto unsortedChanges = queue.CountStateChanges(0, queue.Size());
+	auto original = queue.m_Items;
+
+	// 何度か並べ替えた平均をとる（毎回並べる前の順番に戻す）
+	auto measure = [&](auto&& sort)
+	{
+		double total = 0.0;
+		for (int i = 0; i < Iterations; i++)
+		{
+			queue.m_Items = original;
+			Timer timer;
+			sort();
+			total += timer.GetElapsedTime();
+		}
+		return total / Iterations;
+	};
+
+	auto singleTime = measure([&]() { RadixSort(queue.m_Items, queue.m_Scratch, false); });
+	auto referenceTime = measure([&]()
+	{
+		std::stable_sort(queue.m_Items.begin(), queue.m_Items.end(), [](const DrawItem& a, const DrawItem& b) { return a.Key < b.Key; });
+	});
+	auto reference = queue.m_Items;
+	auto parallelTime = measure([&]() { queue.Sort(); });
+
+	bool matched = true;
+	for (uint32_t i = 0; i < queue.Size() && matched; i++)
+	{
+		matched = queue.m_Items[i].Key == reference[i].Key && queue.m_Items[i].Draw == reference[i].Draw;
+	}
+
+	auto sortedChanges = queue.CountStateChanges(0, queue.Size());
+
+	printf("描画の並べ替え: %u個 (パス %u, パイプライン %u, マテリアル %u, ジオメトリ %u, %d回の平均)\n",
+		drawCount, PassCount, PipelineCount, MaterialCount, GeometryCount, Iterations);
+	printf("  基数ソート(%uスレッド): %.3f ms\n", g_JobSystem != nullptr ? g_JobSystem->WorkerCount() : 1, parallelTime);
+	printf("  基数ソート(1スレッド): %.3f ms\n", singleTime);
+	printf("  std::stable_sort: %.3f ms%s\n", referenceTime, matched ? "" : " (結果が一致しない)");
+	printf("  状態の切り替え 並べ替え前: パス %u, パイプライン %u, マテリアル %u, ジオメトリ %u\n",
+		unsortedChanges.Pass, unsortedChanges.Pipeline, unsortedChanges.Material, unsortedChanges.Geometry);
+	printf("  状態の切り替え 並べ替え後: パス %u, パイプライン %u, マテリアル %u, ジオメトリ %u\n",
+		sortedChanges.Pass, sortedChanges.Pipeline, sortedChanges.Material, sortedChanges.Geometry);
+}
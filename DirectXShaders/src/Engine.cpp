@@ -1,4 +1,7 @@
 #include "Engine.h"
+#include "Profiler.h"
+#include "App.h"
+#include "ClusteredLighting.h"
 #include <d3d12.h>
 #include <d3dx12.h>
 #include <stdio.h>
@@ -18,6 +21,14 @@ bool Engine::Init(HWND hWnd, UINT windowWidth, UINT windowHeight)
 		printf("デバイスの生成に失敗\n");
 		return false;
 	}
+	D3D12Backend::SetDevice(m_pDevice.Get()); // バッファのテンプレートはバックエンドからデバイスを使う
+
+	m_PipelineCache.SetEnabled(g_AppOptions.UsePipelineCache);
+	m_PipelineCache.Init(m_pDevice.Get(), L"PipelineLibrary.bin");
+	m_ShaderCompiler.Init(g_AppOptions.ShaderDirectory.c_str(), L"ShaderCache");
+	m_Scheduler.Init(g_AppOptions.FramesInFlight);
+	m_BackBufferCount = m_Scheduler.FramesInFlight();
+	m_RecordThreadCount = max(1u, min(g_AppOptions.RecordThreads, static_cast<UINT>(MAX_RECORD_THREADS)));
 
 	if (!CreateCommandQueue())
 	{
@@ -43,6 +54,12 @@ bool Engine::Init(HWND hWnd, UINT windowWidth, UINT windowHeight)
 		return false;
 	}
 
+	if (!CreateFrameResources())
+	{
+		printf("フレームごとのリソースの生成に失敗\n");
+		return false;
+	}
+
 	CreateViewPort();
 	CreateScissorRect();
 
@@ -52,9 +69,9 @@ bool Engine::Init(HWND hWnd, UINT windowWidth, UINT windowHeight)
 		return false;
 	}
 
-	if (!CreateDepthStencil())
+	if (!CreateFrameGraph())
 	{
-		printf("深度ステンシルの生成に失敗\n");
+		printf("レンダーグラフの準備に失敗\n");
 		return false;
 	}
 
@@ -70,24 +87,26 @@ bool Engine::Init(HWND hWnd, UINT windowWidth, UINT windowHeight)
 
 bool Engine::InitIrradianceMap()
 {
-	m_pAllocator[m_CurrentBackBufferIndex]->Reset();
-	m_pCommandList->Reset(m_pAllocator[m_CurrentBackBufferIndex].Get(), nullptr);
-
-	auto viewport = CreateViewPort(32, 32);
-	auto scissor = CreateScissorRect(32, 32);
-	m_pCommandList->RSSetViewports(1, &viewport);
-	m_pCommandList->RSSetScissorRects(1, &scissor);
+	auto slot = m_Scheduler.CurrentSlot();
+	m_pAllocator[slot]->Reset();
+	m_pCommandList->Reset(m_pAllocator[slot].Get(), nullptr);
 
+	// 焼き込み自体は計算キューで行う。このリストには焼き込み元の遷移などの初期化のコマンドを積む
 	return true;
 }
 
 void Engine::DrawIrradianceMap()
 {
+	m_StateTracker.FlushBarriers(m_pCommandList.Get());
 	m_pCommandList->Close();
 
 	ID3D12CommandList* ppCommandLists[] = { m_pCommandList.Get() };
 	m_pQueue->ExecuteCommandLists(1, ppCommandLists);
+	m_StateTracker.CommitFinalStates();
 
+	// 初期化のコマンドも1フレームとして扱い、スロットを進める（計算キューはこの値を待ってから焼き込む）
+	m_pQueue->Signal(m_pFence.Get(), m_Scheduler.Submit());
+	m_ReleaseQueue.SetCurrentFenceValue(m_Scheduler.NextFenceValue());
 }
 
 ID3D12Device6* Engine::Device()
@@ -105,11 +124,119 @@ UINT Engine::CurrentBackBufferIndex()
 	return m_CurrentBackBufferIndex;
 }
 
+UINT Engine::FramesInFlight()
+{
+	return m_Scheduler.FramesInFlight();
+}
+
+UINT Engine::CurrentFrameSlot()
+{
+	return m_Scheduler.CurrentSlot();
+}
+
+ConstantRing* Engine::FrameConstants()
+{
+	return m_pConstantRings[m_Scheduler.CurrentSlot()];
+}
+
+UINT Engine::RecordThreadCount()
+{
+	return m_RecordThreadCount;
+}
+
+ID3D12GraphicsCommandList* Engine::WorkerCommandList(UINT worker)
+{
+	return m_pWorkerLists[worker].Get();
+}
+
+void Engine::SubmitWorkerLists(UINT count)
+{
+	m_SubmittedWorkerLists = min(count, m_RecordThreadCount);
+}
+
 UINT Engine::FrameCount()
 {
 	return m_FrameCount;
 }
 
+void Engine::PrintReleaseStats()
+{
+	printf("遅延解放: %llu個を解放 (最大保持メモリ %.2f MB, 未解放 %zu個)\n", static_cast<unsigned long long>(m_ReleasedObjects),
+		m_ReleaseQueue.PeakRetainedBytes() / (1024.0 * 1024.0), m_ReleaseQueue.PendingCount());
+}
+
+ResourceStateTracker* Engine::StateTracker()
+{
+	return &m_StateTracker;
+}
+
+DeferredReleaseQueue* Engine::ReleaseQueue()
+{
+	return &m_ReleaseQueue;
+}
+
+PipelineCache* Engine::PSOCache()
+{
+	return &m_PipelineCache;
+}
+
+ShaderCompiler* Engine::Shaders()
+{
+	return &m_ShaderCompiler;
+}
+
+RenderGraph* Engine::FrameGraph()
+{
+	return &m_FrameGraph;
+}
+
+RenderGraphExecutor* Engine::FrameGraphExecutor()
+{
+	return &m_FrameGraphExecutor;
+}
+
+RenderGraph::ResourceHandle Engine::BackBufferTarget()
+{
+	return m_BackBufferTarget;
+}
+
+RenderGraph::ResourceHandle Engine::DepthTarget()
+{
+	return m_DepthTarget;
+}
+
+ID3D12CommandQueue* Engine::Queue()
+{
+	return m_pQueue.Get();
+}
+
+ID3D12CommandQueue* Engine::ComputeQueue()
+{
+	return m_pComputeQueue.Get();
+}
+
+ID3D12Fence* Engine::Fence()
+{
+	return m_pFence.Get();
+}
+
+UINT64 Engine::NextFenceValue()
+{
+	return m_Scheduler.NextFenceValue();
+}
+
+void Engine::DeferRelease(ID3D12Resource* resource)
+{
+	if (resource == nullptr)
+	{
+		return;
+	}
+
+	auto desc = resource->GetDesc();
+	auto info = m_pDevice->GetResourceAllocationInfo(0, 1, &desc);
+	m_ReleaseQueue.Release(resource, info.SizeInBytes);
+}
+
 bool Engine::CreateDevice()
 {
 	auto hr = D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_11_0, 
@@ -127,6 +254,13 @@ bool Engine::CreateCommandQueue()
 	desc.NodeMask = 0;
 
 	auto hr = m_pDevice->CreateCommandQueue(&desc, IID_PPV_ARGS(m_pQueue.ReleaseAndGetAddressOf()));
+	if (FAILED(hr))
+	{
+		return false;
+	}
+
+	desc.Type = D3D12_COMMAND_LIST_TYPE_COMPUTE;
+	hr = m_pDevice->CreateCommandQueue(&desc, IID_PPV_ARGS(m_pComputeQueue.ReleaseAndGetAddressOf()));
 
 	return SUCCEEDED(hr);
 }
@@ -153,7 +287,7 @@ bool Engine::CreateSwapChain()
 	desc.SampleDesc.Count = 1;
 	desc.SampleDesc.Quality = 0;
 	desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	desc.BufferCount = FRAME_BUFFER_COUNT;
+	desc.BufferCount = m_BackBufferCount;
 	desc.OutputWindow = m_hWnd;
 	desc.Windowed = TRUE;
 	desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
@@ -189,7 +323,7 @@ bool Engine::CreateSwapChain()
 bool Engine::CreateCommandList()
 {
 	HRESULT hr;
-	for (size_t i = 0; i < FRAME_BUFFER_COUNT; i++)
+	for (size_t i = 0; i < m_Scheduler.FramesInFlight(); i++)
 	{
 		hr = m_pDevice->CreateCommandAllocator(
 			D3D12_COMMAND_LIST_TYPE_DIRECT, 
@@ -204,7 +338,7 @@ bool Engine::CreateCommandList()
 	hr = m_pDevice->CreateCommandList(
 		0,
 		D3D12_COMMAND_LIST_TYPE_DIRECT,
-		m_pAllocator[m_CurrentBackBufferIndex].Get(),
+		m_pAllocator[m_Scheduler.CurrentSlot()].Get(),
 		nullptr,
 		IID_PPV_ARGS(m_pCommandList.ReleaseAndGetAddressOf())
 	);
@@ -216,28 +350,110 @@ bool Engine::CreateCommandList()
 
 	m_pCommandList->Close();
 
+	// Present前の遷移を記録するリストと、ワーカースレッド用のリスト
+	for (size_t i = 0; i < m_Scheduler.FramesInFlight(); i++)
+	{
+		hr = m_pDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(m_pEndAllocator[i].ReleaseAndGetAddressOf()));
+		if (FAILED(hr))
+		{
+			return false;
+		}
+
+		for (size_t j = 0; j < m_RecordThreadCount; j++)
+		{
+			hr = m_pDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(m_pWorkerAllocators[i][j].ReleaseAndGetAddressOf()));
+			if (FAILED(hr))
+			{
+				return false;
+			}
+		}
+	}
+
+	auto slot = m_Scheduler.CurrentSlot();
+	hr = m_pDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_pEndAllocator[slot].Get(), nullptr,
+		IID_PPV_ARGS(m_pEndCommandList.ReleaseAndGetAddressOf()));
+	if (FAILED(hr))
+	{
+		return false;
+	}
+	m_pEndCommandList->Close();
+
+	for (size_t j = 0; j < m_RecordThreadCount; j++)
+	{
+		hr = m_pDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_pWorkerAllocators[slot][j].Get(), nullptr,
+			IID_PPV_ARGS(m_pWorkerLists[j].ReleaseAndGetAddressOf()));
+		if (FAILED(hr))
+		{
+			return false;
+		}
+		m_pWorkerLists[j]->Close();
+	}
+
 	return true;
 }
 
 bool Engine::CreateFence()
 {
-	for(auto i = 0u; i < FRAME_BUFFER_COUNT; i++)
-	{
-		m_fenceValue[i] = 0;
-	}
-
 	auto hr = m_pDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(m_pFence.ReleaseAndGetAddressOf()));
 	if (FAILED(hr))
 	{
 		return false;
 	}
 
-	m_fenceValue[m_CurrentBackBufferIndex]++;
+	m_ReleaseQueue.SetCurrentFenceValue(m_Scheduler.NextFenceValue());
 
 	m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 	return m_fenceEvent != nullptr;
 }
 
+bool Engine::CreateFrameResources()
+{
+	// 定数のほかに、変わった物体の定数（1物体96バイト）とインスタンスごとの物体の番号（4バイト）も置く
+	// 全ての物体を送る最初のフレームでも、1万物体で約1MB
+	// 点光源とクラスターごとのライトの並びも置く（1個のライトが平均8クラスター程度に入るとして見積もる）
+	size_t ringSize = 4 * 1024 * 1024;
+	ringSize += static_cast<size_t>(g_AppOptions.PointLightCount) * (sizeof(PointLight) + sizeof(uint32_t) * 8);
+	ringSize += ClusteredLighting::CLUSTER_COUNT * 2 * sizeof(uint32_t);
+	for (UINT i = 0; i < m_Scheduler.FramesInFlight(); i++)
+	{
+		m_pConstantRings[i] = new ConstantRing(ringSize);
+		if (!m_pConstantRings[i]->IsValid())
+		{
+			return false;
+		}
+	}
+
+	// GPUの処理時間と空き時間を測るタイムスタンプ
+	D3D12_QUERY_HEAP_DESC queryDesc = {};
+	queryDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	queryDesc.Count = MAX_FRAMES_IN_FLIGHT * 2;
+	auto hr = m_pDevice->CreateQueryHeap(&queryDesc, IID_PPV_ARGS(m_pTimestampHeap.ReleaseAndGetAddressOf()));
+	if (FAILED(hr))
+	{
+		return false;
+	}
+
+	auto prop = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+	auto desc = CD3DX12_RESOURCE_DESC::Buffer(sizeof(UINT64) * queryDesc.Count);
+	hr = m_pDevice->CreateCommittedResource(&prop, D3D12_HEAP_FLAG_NONE, &desc,
+		D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(m_pTimestampBuffer.ReleaseAndGetAddressOf()));
+	if (FAILED(hr))
+	{
+		return false;
+	}
+
+	// 読むのはスロットのフェンスを待った後だけなので、Mapしたままにしておく
+	hr = m_pTimestampBuffer->Map(0, nullptr, reinterpret_cast<void**>(&m_pTimestamps));
+	if (FAILED(hr))
+	{
+		return false;
+	}
+
+	m_pQueue->GetTimestampFrequency(&m_TimestampFrequency);
+
+	return m_GpuProfiler.Init(m_pDevice.Get(), m_pQueue.Get(), "Graphics");
+}
+
 void Engine::CreateViewPort()
 {
 	m_Viewport.TopLeftX = 0;
@@ -285,7 +501,7 @@ bool Engine::CreateRenderTarget()
 {
 	// RTV用のディスクリプタヒープを生成
 	D3D12_DESCRIPTOR_HEAP_DESC desc = {};
-	desc.NumDescriptors = FRAME_BUFFER_COUNT;
+	desc.NumDescriptors = m_BackBufferCount;
 	desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
 	desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 	auto hr = m_pDevice->CreateDescriptorHeap(&desc, IID_PPV_ARGS(m_pRtvHeap.ReleaseAndGetAddressOf()));
@@ -297,66 +513,110 @@ bool Engine::CreateRenderTarget()
 	m_RtvDescriptorSize = m_pDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
 	D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = m_pRtvHeap->GetCPUDescriptorHandleForHeapStart();
 
-	for(UINT i = 0; i < FRAME_BUFFER_COUNT; i++)
+	for(UINT i = 0; i < m_BackBufferCount; i++)
 	{
 		m_pSwapChain->GetBuffer(i, IID_PPV_ARGS(m_pRenderTargets[i].ReleaseAndGetAddressOf()));
 		m_pDevice->CreateRenderTargetView(m_pRenderTargets[i].Get(), nullptr, rtvHandle);
+		ResourceStateTracker::Register(m_pRenderTargets[i].Get(), D3D12_RESOURCE_STATE_PRESENT);
 		rtvHandle.ptr += m_RtvDescriptorSize;
 	}
 
 	return true;
 }
 
-bool Engine::CreateDepthStencil()
+bool Engine::CreateFrameGraph()
 {
-	// Depthバッファ用のディスクリプタヒープ
-	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
-	heapDesc.NumDescriptors = 1;
-	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
-	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-	auto hr = m_pDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&m_pDsvHeap));
-
-	if (FAILED(hr))
-	{
-		return false;
-	}
+	m_FrameGraphExecutor.Init(m_pDevice.Get(), &m_FrameGraph);
+	m_FrameGraphExecutor.SetProfiler(&m_GpuProfiler);
 
-	m_DsvDescriptorSize = m_pDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+	// バックバッファはフレームごとに差し替える。Presentの状態で受け取り、Presentの状態で返す
+	m_BackBufferTarget = m_FrameGraphExecutor.Import("BackBuffer", RenderGraph::ACCESS_PRESENT, RenderGraph::ACCESS_PRESENT);
 
+	// 深度バッファはフレームの外に持ち越さないので一時リソースにする
 	D3D12_CLEAR_VALUE dsvClearValue;
 	dsvClearValue.Format = DXGI_FORMAT_D32_FLOAT;
 	dsvClearValue.DepthStencil.Depth = 1.0f;
 	dsvClearValue.DepthStencil.Stencil = 0;
 
-	auto heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-	CD3DX12_RESOURCE_DESC resourceDesc(
-		D3D12_RESOURCE_DIMENSION_TEXTURE2D, 0, m_FrameBufferWidth, m_FrameBufferHeight, 
-		1, 1, DXGI_FORMAT_D32_FLOAT, 1, 0, 
+	CD3DX12_RESOURCE_DESC depthDesc(
+		D3D12_RESOURCE_DIMENSION_TEXTURE2D, 0, m_FrameBufferWidth, m_FrameBufferHeight,
+		1, 1, DXGI_FORMAT_D32_FLOAT, 1, 0,
 		D3D12_TEXTURE_LAYOUT_UNKNOWN, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
+	m_DepthTarget = m_FrameGraphExecutor.CreateTexture("Depth", depthDesc, &dsvClearValue);
 
-	hr = m_pDevice->CreateCommittedResource(
-		&heapProp, D3D12_HEAP_FLAG_NONE, &resourceDesc,
-		D3D12_RESOURCE_STATE_DEPTH_WRITE, &dsvClearValue,
-		IID_PPV_ARGS(m_pDepthStencilBuffer.ReleaseAndGetAddressOf()));
+	// 最初のパスで両方をクリアする
+	auto backBuffer = m_BackBufferTarget;
+	auto depth = m_DepthTarget;
+	auto clearPass = m_FrameGraph.AddPass("Clear", [backBuffer, depth](RenderGraphExecutor& context)
+	{
+		auto commandList = context.CommandList();
+		auto rtv = context.RenderTargetView(backBuffer);
+		auto dsv = context.DepthStencilView(depth);
+		commandList->OMSetRenderTargets(1, &rtv, FALSE, &dsv);
+
+		const float clearColor[] = { 0.25f, 0.25f, 0.25f, 1.0f };
+		commandList->ClearRenderTargetView(rtv, clearColor, 0, nullptr);
+		commandList->ClearDepthStencilView(dsv, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+	});
+	m_FrameGraph.Write(clearPass, m_BackBufferTarget, RenderGraph::ACCESS_RENDER_TARGET);
+	m_FrameGraph.Write(clearPass, m_DepthTarget, RenderGraph::ACCESS_DEPTH_WRITE);
 
-	if (FAILED(hr))
+	return true;
+}
+
+bool Engine::CompileFrameGraph()
+{
+	Timer timer;
+	if (!m_FrameGraphExecutor.Compile())
 	{
+		printf("レンダーグラフのコンパイルに失敗\n");
 		return false;
 	}
 
-	D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = m_pDsvHeap->GetCPUDescriptorHandleForHeapStart();
-
-	m_pDevice->CreateDepthStencilView(m_pDepthStencilBuffer.Get(), nullptr, dsvHandle);
-
+	m_FrameGraph.PrintStats();
+	printf("レンダーグラフのコンパイル: %.3f ms\n", timer.GetElapsedTime());
 	return true;
 }
 
+void Engine::ExecuteFrameGraph()
+{
+	m_FrameGraphExecutor.Execute(m_pCommandList.Get());
+}
+
 void Engine::BeginRender()
 {
+	PROFILE_SCOPE("BeginRender");
+
+	// このスロットを前回使ったフレームが終わるまでだけ待つ（直前のフレームはGPUで実行中のままでいい）
+	auto frameStart = m_FrameTimer.GetElapsedTime();
+	WaitRender();
+	auto waitTime = m_FrameTimer.GetElapsedTime() - frameStart;
+	if (m_LastFrameStart >= 0.0)
+	{
+		m_Scheduler.RecordCpuFrame(frameStart - m_LastFrameStart, waitTime);
+	}
+	m_LastFrameStart = frameStart;
+
+	auto slot = m_Scheduler.CurrentSlot();
+	ReadTimestamps(slot);
+	m_GpuProfiler.BeginFrame(slot);
+	if (m_Scheduler.GetStats().FrameCount >= 300)
+	{
+		m_Scheduler.PrintStats();
+		m_Scheduler.ResetStats();
+	}
+
+	// GPUが使い終わったオブジェクトをまとめて解放する（数は終了時にPrintReleaseStatsで出力する）
+	m_ReleasedObjects += m_ReleaseQueue.Collect(m_pFence->GetCompletedValue());
+
+	m_CurrentBackBufferIndex = m_pSwapChain->GetCurrentBackBufferIndex();
 	m_currentRenderTarget = m_pRenderTargets[m_CurrentBackBufferIndex].Get();
 
-	m_pAllocator[m_CurrentBackBufferIndex]->Reset();
-	m_pCommandList->Reset(m_pAllocator[m_CurrentBackBufferIndex].Get(), nullptr);
+	m_pConstantRings[slot]->Reset();
+	m_pAllocator[slot]->Reset();
+	m_pCommandList->Reset(m_pAllocator[slot].Get(), nullptr);
+	m_pCommandList->EndQuery(m_pTimestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, slot * 2);
+	m_GpuFrameScope = m_GpuProfiler.Begin(m_pCommandList.Get(), "Frame");
 
 	m_pCommandList->RSSetViewports(1, &m_Viewport);
 	m_pCommandList->RSSetScissorRects(1, &m_Scissor);
@@ -365,28 +625,27 @@ void Engine::BeginRender()
 	auto currentRtvHandle = m_pRtvHeap->GetCPUDescriptorHandleForHeapStart();
 	// 現在のRTVの先頭
 	currentRtvHandle.ptr += m_CurrentBackBufferIndex * m_RtvDescriptorSize;
-	// DSV
-	auto currentDsvHandle = m_pDsvHeap->GetCPUDescriptorHandleForHeapStart();
-	// GPUにレンダーターゲットの状態遷移を伝える
-	auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-		m_currentRenderTarget, D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-	m_pCommandList->ResourceBarrier(1, &barrier);
-
-	m_pCommandList->OMSetRenderTargets(1, &currentRtvHandle, FALSE, &currentDsvHandle);
-
-	const float clearColor[] = { 0.25f, 0.25f, 0.25f, 1.0f };
-	m_pCommandList->ClearRenderTargetView(currentRtvHandle, clearColor, 0, nullptr);
+	// 状態遷移と出力先の設定はレンダーグラフのパスで行う
+	m_FrameGraphExecutor.SetImported(m_BackBufferTarget, m_currentRenderTarget, currentRtvHandle);
 
-	m_pCommandList->ClearDepthStencilView(currentDsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+	// ワーカー用のリストはコマンドリスト間で状態が引き継がれないので、同じビューポートを設定しておく
+	m_SubmittedWorkerLists = 0;
+	for (UINT i = 0; i < m_RecordThreadCount; i++)
+	{
+		auto workerList = m_pWorkerLists[i].Get();
+		m_pWorkerAllocators[slot][i]->Reset();
+		workerList->Reset(m_pWorkerAllocators[slot][i].Get(), nullptr);
+		workerList->RSSetViewports(1, &m_Viewport);
+		workerList->RSSetScissorRects(1, &m_Scissor);
+	}
 }
 
 void Engine::WaitRender()
 {
-	const UINT64 fenceValue = m_fenceValue[m_CurrentBackBufferIndex];
-	// fenceValue = GPUの処理終了時になっているべきfenceValue
-	m_pQueue->Signal(m_pFence.Get(), fenceValue);
-	m_fenceValue[m_CurrentBackBufferIndex]++;
+	PROFILE_SCOPE("WaitForGpu");
 
+	// fenceValue = このスロットを前回使ったフレームの終了時になっているべきfenceValue
+	const UINT64 fenceValue = m_Scheduler.WaitValue();
 	if (m_pFence->GetCompletedValue() < fenceValue)
 	{
 		auto hr = m_pFence->SetEventOnCompletion(fenceValue, m_fenceEvent);
@@ -402,23 +661,73 @@ void Engine::WaitRender()
 	}
 }
 
+void Engine::ReadTimestamps(UINT slot)
+{
+	if (!m_HasTimestamps[slot])
+	{
+		return;
+	}
+
+	m_Scheduler.RecordGpuFrame(m_pTimestamps[slot * 2], m_pTimestamps[slot * 2 + 1], m_TimestampFrequency);
+	m_HasTimestamps[slot] = false;
+}
+
 void Engine::EndRender()
 {
-	auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(
-		m_currentRenderTarget, D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
-	// barrier実行後にRTとして扱われてたリソースがPresent状態になる
-	m_pCommandList->ResourceBarrier(1, &barrier);
+	PROFILE_SCOPE("EndRender");
+	auto slot = m_Scheduler.CurrentSlot();
 
+	// ワーカーのリストはメインのリストの後に続けて実行されるので、メインの最後からPresent前のリストの最初までで測る
+	auto workerScope = GpuProfiler::INVALID_SCOPE;
+	if (m_SubmittedWorkerLists > 0)
+	{
+		workerScope = m_GpuProfiler.Begin(m_pCommandList.Get(), "WorkerLists");
+	}
+
+	m_StateTracker.FlushBarriers(m_pCommandList.Get());
 	m_pCommandList->Close();
 
-	ID3D12CommandList* ppCommandLists[] = { m_pCommandList.Get() };
-	m_pQueue->ExecuteCommandLists(1, ppCommandLists);
+	for (UINT i = 0; i < m_RecordThreadCount; i++)
+	{
+		m_pWorkerLists[i]->Close();
+	}
 
-	m_pSwapChain->Present(1, 0);
+	// barrier実行後にRTとして扱われてたリソースがPresent状態になる
+	// ワーカーの描画より後に実行されるよう、別のリストに記録する
+	m_pEndAllocator[slot]->Reset();
+	m_pEndCommandList->Reset(m_pEndAllocator[slot].Get(), nullptr);
+	m_GpuProfiler.End(m_pEndCommandList.Get(), workerScope);
+	m_FrameGraphExecutor.FlushFinalBarriers(m_pEndCommandList.Get());
+
+	m_pEndCommandList->EndQuery(m_pTimestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, slot * 2 + 1);
+	m_pEndCommandList->ResolveQueryData(m_pTimestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, slot * 2, 2,
+		m_pTimestampBuffer.Get(), slot * 2 * sizeof(UINT64));
+	m_HasTimestamps[slot] = true;
+	m_GpuProfiler.End(m_pEndCommandList.Get(), m_GpuFrameScope);
+	m_GpuProfiler.Resolve(m_pEndCommandList.Get());
+
+	m_pEndCommandList->Close();
+
+	// メイン、ワーカー、Present前の順に一度にまとめて実行する
+	ID3D12CommandList* ppCommandLists[MAX_RECORD_THREADS + 2];
+	UINT listCount = 0;
+	ppCommandLists[listCount++] = m_pCommandList.Get();
+	for (UINT i = 0; i < m_SubmittedWorkerLists; i++)
+	{
+		ppCommandLists[listCount++] = m_pWorkerLists[i].Get();
+	}
+	ppCommandLists[listCount++] = m_pEndCommandList.Get();
+	m_pQueue->ExecuteCommandLists(listCount, ppCommandLists);
+	m_StateTracker.CommitFinalStates();
 
-	WaitRender();
+	{
+		PROFILE_SCOPE("Present");
+		m_pSwapChain->Present(1, 0);
+	}
 
-	m_CurrentBackBufferIndex = m_pSwapChain->GetCurrentBackBufferIndex();
+	// 完了は待たずに次のスロットへ進む
+	m_pQueue->Signal(m_pFence.Get(), m_Scheduler.Submit());
+	m_ReleaseQueue.SetCurrentFenceValue(m_Scheduler.NextFenceValue());
 }
 
 void Engine::UpdateFrameCount()
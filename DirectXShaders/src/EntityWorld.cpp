@@ -0,0 +1,688 @@
+#include "EntityWorld.h"
+#include "JobSystem.h"
+#include "Timer.h"
+#include <atomic>
+#include <cstring>
+#include <stdio.h>
+
+namespace
+{
+	struct ComponentInfo
+	{
+		uint32_t Size;
+		uint32_t Alignment;
+	};
+
+	// 部品の番号は全てのワールドで共通
+	std::mutex& ComponentMutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+	ComponentInfo componentInfos[EntityWorld::MAX_COMPONENTS];
+	uint32_t componentCount = 0;
+
+	std::atomic<uint64_t> nextWorldId = 1;
+
+	const uint32_t NO_ARCHETYPE = 0xffffffff;
+	const uint32_t NO_COLUMN = 0xffffffff;
+
+	// チャンクのメモリ。キャッシュラインに揃える
+	struct alignas(64) ChunkBlock
+	{
+		uint8_t Bytes[64];
+	};
+
+	uint32_t AlignUp(uint32_t value, uint32_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	uint32_t NextGeneration(uint32_t generation)
+	{
+		generation++;
+		return generation == 0 || generation == EntityCommandBuffer::PENDING_GENERATION ? 1 : generation;
+	}
+}
+
+struct EntityWorld::Chunk
+{
+	std::unique_ptr<ChunkBlock[]> Memory;
+	uint32_t Count;
+
+	uint8_t* Data() const { return Memory[0].Bytes; }
+};
+
+// 部品の組み合わせ1つ。チャンクの中は「エンティティの配列、部品ごとの配列」の順で、配列の長さはどれもCapacity
+struct EntityWorld::Archetype
+{
+	ComponentMask Components;
+	std::vector<uint32_t> Columns; // 持っている部品の番号
+	uint32_t Offsets[MAX_COMPONENTS]; // 部品の配列のチャンクの中での位置（無ければNO_COLUMN）
+	uint32_t Capacity; // 1つのチャンクに入るエンティティの数
+	uint32_t ChunkBlocks; // 1つのチャンクの大きさ（64バイト単位）
+	uint32_t Count;
+	std::vector<Chunk> Chunks; // 最後のチャンク以外は埋まっている
+};
+
+uint32_t EntityWorld::RegisterComponent(size_t size, size_t alignment)
+{
+	std::lock_guard<std::mutex> lock(ComponentMutex());
+	if (componentCount >= MAX_COMPONENTS || alignment > sizeof(ChunkBlock))
+	{
+		printf("部品の種類が多すぎるか、整列が大きすぎる\n");
+		return MAX_COMPONENTS - 1;
+	}
+	componentInfos[componentCount] = { static_cast<uint32_t>(size), static_cast<uint32_t>(alignment) };
+	return componentCount++;
+}
+
+EntityWorld::EntityWorld()
+	: m_Id(nextWorldId.fetch_add(1))
+{
+}
+
+EntityWorld::~EntityWorld() = default;
+
+Entity EntityWorld::Create(ComponentMask components)
+{
+	uint32_t index;
+	if (!m_FreeIndices.empty())
+	{
+		index = m_FreeIndices.back();
+		m_FreeIndices.pop_back();
+	}
+	else
+	{
+		index = static_cast<uint32_t>(m_Records.size());
+		m_Records.push_back({ NO_ARCHETYPE, 0, 0, 1 });
+	}
+
+	Entity entity = { index, m_Records[index].Generation };
+	AllocateRow(GetArchetype(components), entity, &m_Records[index]);
+	m_EntityCount++;
+	return entity;
+}
+
+void EntityWorld::Destroy(Entity entity)
+{
+	auto pRecord = Find(entity);
+	if (pRecord == nullptr)
+	{
+		return;
+	}
+	FreeRow(*pRecord);
+	auto& record = m_Records[entity.Index];
+	record.Archetype = NO_ARCHETYPE;
+	record.Generation = NextGeneration(record.Generation);
+	m_FreeIndices.push_back(entity.Index);
+	m_EntityCount--;
+}
+
+bool EntityWorld::IsAlive(Entity entity) const
+{
+	return Find(entity) != nullptr;
+}
+
+ComponentMask EntityWorld::GetComponents(Entity entity) const
+{
+	auto pRecord = Find(entity);
+	return pRecord != nullptr ? m_Archetypes[pRecord->Archetype]->Components : 0;
+}
+
+// アーキタイプは残すので、クエリが覚えている一覧はそのまま使える
+void EntityWorld::Clear()
+{
+	for (auto& archetype : m_Archetypes)
+	{
+		archetype->Chunks.clear();
+		archetype->Count = 0;
+	}
+	m_Records.clear();
+	m_FreeIndices.clear();
+	m_EntityCount = 0;
+}
+
+Entity EntityWorld::EntityAt(uint32_t index) const
+{
+	if (index < m_Records.size() && m_Records[index].Archetype != NO_ARCHETYPE)
+	{
+		return { index, m_Records[index].Generation };
+	}
+	return { index, 0 };
+}
+
+uint32_t EntityWorld::Count(EntityQuery& query) const
+{
+	UpdateQuery(query);
+	uint32_t count = 0;
+	for (auto archetype : query.m_Archetypes)
+	{
+		count += m_Archetypes[archetype]->Count;
+	}
+	return count;
+}
+
+void EntityWorld::ForEachChunk(EntityQuery& query, const std::function<void(const EntityChunk&)>& func) const
+{
+	UpdateQuery(query);
+	EntityChunk view;
+	for (auto index : query.m_Archetypes)
+	{
+		auto& archetype = *m_Archetypes[index];
+		view.m_pOffsets = archetype.Offsets;
+		for (auto& chunk : archetype.Chunks)
+		{
+			view.m_pData = chunk.Data();
+			view.m_Count = chunk.Count;
+			func(view);
+		}
+	}
+}
+
+void EntityWorld::ParallelForEachChunk(EntityQuery& query, const std::function<void(const EntityChunk&)>& func) const
+{
+	std::vector<EntityChunk> chunks;
+	GatherChunks(query, chunks);
+	if (g_JobSystem == nullptr || chunks.size() <= CHUNK_GRAIN)
+	{
+		for (auto& chunk : chunks)
+		{
+			func(chunk);
+		}
+		return;
+	}
+
+	g_JobSystem->ParallelFor(0, chunks.size(), CHUNK_GRAIN, [&](size_t begin, size_t end)
+	{
+		for (auto i = begin; i < end; i++)
+		{
+			func(chunks[i]);
+		}
+	});
+}
+
+void EntityWorld::Playback(EntityCommandBuffer& buffer)
+{
+	std::lock_guard<std::mutex> lock(buffer.m_Mutex);
+	std::vector<Entity> created(buffer.m_PendingCount);
+	auto resolve = [&](Entity entity)
+	{
+		return entity.Generation == EntityCommandBuffer::PENDING_GENERATION ? created[entity.Index] : entity;
+	};
+
+	for (auto& command : buffer.m_Commands)
+	{
+		auto pValue = buffer.m_Data.data() + command.DataOffset;
+		switch (command.Type)
+		{
+		case EntityCommandBuffer::COMMAND_CREATE:
+			created[command.Target.Index] = Create(command.Components);
+			break;
+		case EntityCommandBuffer::COMMAND_DESTROY:
+			Destroy(resolve(command.Target));
+			break;
+		case EntityCommandBuffer::COMMAND_ADD:
+			if (auto pComponent = AddComponent(resolve(command.Target), command.Component))
+			{
+				memcpy(pComponent, pValue, componentInfos[command.Component].Size);
+			}
+			break;
+		case EntityCommandBuffer::COMMAND_SET:
+			if (auto pComponent = GetComponent(resolve(command.Target), command.Component))
+			{
+				memcpy(pComponent, pValue, componentInfos[command.Component].Size);
+			}
+			break;
+		case EntityCommandBuffer::COMMAND_REMOVE:
+			RemoveComponent(resolve(command.Target), command.Component);
+			break;
+		}
+	}
+
+	buffer.m_Commands.clear();
+	buffer.m_Data.clear();
+	buffer.m_PendingCount = 0;
+}
+
+const EntityWorld::Record* EntityWorld::Find(Entity entity) const
+{
+	if (entity.Index >= m_Records.size())
+	{
+		return nullptr;
+	}
+	auto& record = m_Records[entity.Index];
+	return record.Archetype != NO_ARCHETYPE && record.Generation == entity.Generation ? &record : nullptr;
+}
+
+// 部品の組み合わせのアーキタイプを返す。無ければチャンクの中の並びを決めて作る
+uint32_t EntityWorld::GetArchetype(ComponentMask components)
+{
+	auto found = m_ArchetypeOfMask.find(components);
+	if (found != m_ArchetypeOfMask.end())
+	{
+		return found->second;
+	}
+
+	auto archetype = std::make_unique<Archetype>();
+	archetype->Components = components;
+	archetype->Count = 0;
+	uint32_t rowSize = sizeof(Entity);
+	for (uint32_t component = 0; component < MAX_COMPONENTS; component++)
+	{
+		archetype->Offsets[component] = NO_COLUMN;
+		if (components & ComponentMask(1) << component)
+		{
+			archetype->Columns.push_back(component);
+			rowSize += componentInfos[component].Size;
+		}
+	}
+
+	// 入るだけ詰め、整列の隙間で溢れたら1つずつ減らす。1つも入らない大きさならチャンクを大きくする
+	auto layout = [&](uint32_t capacity)
+	{
+		uint32_t offset = capacity * sizeof(Entity);
+		for (auto component : archetype->Columns)
+		{
+			offset = AlignUp(offset, componentInfos[component].Alignment);
+			archetype->Offsets[component] = offset;
+			offset += capacity * componentInfos[component].Size;
+		}
+		return offset;
+	};
+	auto capacity = CHUNK_SIZE / rowSize;
+	while (capacity > 1 && layout(capacity) > CHUNK_SIZE)
+	{
+		capacity--;
+	}
+	capacity = capacity > 1 ? capacity : 1;
+	auto size = layout(capacity);
+	archetype->Capacity = capacity;
+	archetype->ChunkBlocks = AlignUp(size > CHUNK_SIZE ? size : CHUNK_SIZE, sizeof(ChunkBlock)) / sizeof(ChunkBlock);
+
+	auto index = static_cast<uint32_t>(m_Archetypes.size());
+	m_Archetypes.push_back(std::move(archetype));
+	m_ArchetypeOfMask[components] = index;
+	return index;
+}
+
+// 最後のチャンクの末尾に行を足し、部品を0で埋める
+void EntityWorld::AllocateRow(uint32_t index, Entity entity, Record* pRecord)
+{
+	auto& archetype = *m_Archetypes[index];
+	if (archetype.Chunks.empty() || archetype.Chunks.back().Count == archetype.Capacity)
+	{
+		Chunk chunk;
+		chunk.Memory.reset(new ChunkBlock[archetype.ChunkBlocks]);
+		chunk.Count = 0;
+		archetype.Chunks.push_back(std::move(chunk));
+	}
+
+	auto& chunk = archetype.Chunks.back();
+	auto row = chunk.Count++;
+	auto data = chunk.Data();
+	reinterpret_cast<Entity*>(data)[row] = entity;
+	for (auto component : archetype.Columns)
+	{
+		auto size = componentInfos[component].Size;
+		memset(data + archetype.Offsets[component] + row * size, 0, size);
+	}
+	archetype.Count++;
+
+	pRecord->Archetype = index;
+	pRecord->Chunk = static_cast<uint32_t>(archetype.Chunks.size() - 1);
+	pRecord->Row = row;
+}
+
+// アーキタイプの最後のエンティティを空いた行に動かし、チャンクを詰めたままにする
+void EntityWorld::FreeRow(const Record& record)
+{
+	auto& archetype = *m_Archetypes[record.Archetype];
+	auto lastChunk = static_cast<uint32_t>(archetype.Chunks.size() - 1);
+	auto& last = archetype.Chunks[lastChunk];
+	auto lastRow = last.Count - 1;
+	if (record.Chunk != lastChunk || record.Row != lastRow)
+	{
+		auto source = last.Data();
+		auto destination = archetype.Chunks[record.Chunk].Data();
+		auto moved = reinterpret_cast<Entity*>(source)[lastRow];
+		reinterpret_cast<Entity*>(destination)[record.Row] = moved;
+		for (auto component : archetype.Columns)
+		{
+			auto size = componentInfos[component].Size;
+			auto offset = archetype.Offsets[component];
+			memcpy(destination + offset + record.Row * size, source + offset + lastRow * size, size);
+		}
+		m_Records[moved.Index].Chunk = record.Chunk;
+		m_Records[moved.Index].Row = record.Row;
+	}
+
+	last.Count--;
+	archetype.Count--;
+	if (last.Count == 0)
+	{
+		archetype.Chunks.pop_back();
+	}
+}
+
+// 部品の組み合わせを変える。両方にある部品は値を移し、新しい部品は0で埋める
+void EntityWorld::MoveEntity(Entity entity, ComponentMask components)
+{
+	auto oldRecord = m_Records[entity.Index];
+	auto index = GetArchetype(components);
+	if (index == oldRecord.Archetype)
+	{
+		return;
+	}
+
+	Record newRecord = oldRecord;
+	AllocateRow(index, entity, &newRecord);
+	for (auto component : m_Archetypes[index]->Columns)
+	{
+		if (auto pSource = GetComponent(oldRecord, component))
+		{
+			memcpy(GetComponent(newRecord, component), pSource, componentInfos[component].Size);
+		}
+	}
+	FreeRow(oldRecord);
+	m_Records[entity.Index] = newRecord;
+}
+
+void* EntityWorld::AddComponent(Entity entity, uint32_t component)
+{
+	auto pRecord = Find(entity);
+	if (pRecord == nullptr)
+	{
+		return nullptr;
+	}
+	auto components = m_Archetypes[pRecord->Archetype]->Components;
+	MoveEntity(entity, components | ComponentMask(1) << component);
+	return GetComponent(m_Records[entity.Index], component);
+}
+
+void EntityWorld::RemoveComponent(Entity entity, uint32_t component)
+{
+	auto pRecord = Find(entity);
+	if (pRecord != nullptr)
+	{
+		auto components = m_Archetypes[pRecord->Archetype]->Components;
+		MoveEntity(entity, components & ~(ComponentMask(1) << component));
+	}
+}
+
+void* EntityWorld::GetComponent(Entity entity, uint32_t component) const
+{
+	auto pRecord = Find(entity);
+	return pRecord != nullptr ? GetComponent(*pRecord, component) : nullptr;
+}
+
+void* EntityWorld::GetComponent(const Record& record, uint32_t component) const
+{
+	auto& archetype = *m_Archetypes[record.Archetype];
+	auto offset = archetype.Offsets[component];
+	if (offset == NO_COLUMN)
+	{
+		return nullptr;
+	}
+	return archetype.Chunks[record.Chunk].Data() + offset + record.Row * componentInfos[component].Size;
+}
+
+// 前に調べた後にできたアーキタイプだけを条件と比べる
+void EntityWorld::UpdateQuery(EntityQuery& query) const
+{
+	if (query.m_World != m_Id)
+	{
+		query.m_World = m_Id;
+		query.m_CheckedArchetypes = 0;
+		query.m_Archetypes.clear();
+	}
+	for (auto i = query.m_CheckedArchetypes; i < m_Archetypes.size(); i++)
+	{
+		auto components = m_Archetypes[i]->Components;
+		if ((components & query.m_All) == query.m_All && (components & query.m_None) == 0)
+		{
+			query.m_Archetypes.push_back(i);
+		}
+	}
+	query.m_CheckedArchetypes = static_cast<uint32_t>(m_Archetypes.size());
+}
+
+void EntityWorld::GatherChunks(EntityQuery& query, std::vector<EntityChunk>& chunks) const
+{
+	ForEachChunk(query, [&chunks](const EntityChunk& chunk) { chunks.push_back(chunk); });
+}
+
+Entity EntityCommandBuffer::Create(ComponentMask components)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Entity entity = { m_PendingCount++, PENDING_GENERATION };
+	m_Commands.push_back({ COMMAND_CREATE, 0, entity, components, 0 });
+	return entity;
+}
+
+void EntityCommandBuffer::Destroy(Entity entity)
+{
+	Record(COMMAND_DESTROY, entity, 0, nullptr, 0);
+}
+
+void EntityCommandBuffer::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Commands.clear();
+	m_Data.clear();
+	m_PendingCount = 0;
+}
+
+void EntityCommandBuffer::Record(uint32_t type, Entity entity, uint32_t component, const void* pValue, size_t size)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	auto offset = static_cast<uint32_t>(m_Data.size());
+	if (size > 0)
+	{
+		m_Data.resize(offset + size);
+		memcpy(m_Data.data() + offset, pValue, size);
+	}
+	m_Commands.push_back({ type, component, entity, 0, offset });
+}
+
+namespace
+{
+	// 計測用の部品
+	struct Position
+	{
+		float X, Y, Z;
+	};
+
+	struct Velocity
+	{
+		float X, Y, Z;
+	};
+
+	// システムが読まない部品（InstanceDataと同じ大きさ）
+	struct Payload
+	{
+		float Values[24];
+	};
+
+	struct Sleeping
+	{
+		uint32_t Frames;
+	};
+
+	// 比べる相手の配列の番号
+	struct Original
+	{
+		uint32_t Number;
+	};
+
+	// 比べる相手。全ての値を1つの構造体に持つ配列（AoS）
+	struct ObjectAoS
+	{
+		Position Place;
+		Velocity Speed;
+		Payload Data;
+		uint32_t Sleeping;
+		uint32_t Number;
+	};
+
+	const float DeltaTime = 1.0f / 60.0f;
+
+	void Move(Position& position, const Velocity& velocity)
+	{
+		position.X += velocity.X * DeltaTime;
+		position.Y += velocity.Y * DeltaTime;
+		position.Z += velocity.Z * DeltaTime;
+	}
+}
+
+bool EntityWorld::RunBenchmark(uint32_t entityCount, int iterations)
+{
+	// 半分はPayloadを持ち、4つに1つは止まっている（Sleeping）。アーキタイプは3つ
+	EntityWorld world;
+	std::vector<ObjectAoS> objects(entityCount);
+	auto movable = ComponentMaskOf<Position, Velocity, Original>();
+	uint32_t seed = 12345;
+	auto random = [&seed]()
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8 & 0xffff) / 65535.0f * 2.0f - 1.0f;
+	};
+	for (uint32_t i = 0; i < entityCount; i++)
+	{
+		auto& object = objects[i];
+		object = {};
+		object.Place = { random() * 100.0f, random() * 100.0f, random() * 100.0f };
+		object.Speed = { random(), random(), random() };
+		object.Sleeping = i % 4 == 3 ? 1 : 0;
+		object.Number = i;
+
+		auto components = movable;
+		components |= i % 2 == 0 ? ComponentMaskOf<Payload>() : 0;
+		components |= object.Sleeping ? ComponentMaskOf<Sleeping>() : 0;
+		auto entity = world.Create(components);
+		*world.Get<Position>(entity) = object.Place;
+		*world.Get<Velocity>(entity) = object.Speed;
+		world.Get<Original>(entity)->Number = i;
+	}
+
+	EntityQuery moving(ComponentMaskOf<Position, Velocity>(), ComponentMaskOf<Sleeping>());
+	EntityQuery all(ComponentMaskOf<Position>());
+	uint32_t chunkCount = 0;
+	world.ForEachChunk(all, [&chunkCount](const EntityChunk&) { chunkCount++; });
+	auto movingCount = world.Count(moving);
+
+	// 1スレッド、並列、AoSの順に測る。AoSは後で回数を揃えて比べる
+	double times[3] = {};
+	for (int mode = 0; mode < 3; mode++)
+	{
+		for (int i = 0; i < iterations; i++)
+		{
+			Timer timer;
+			if (mode == 0)
+			{
+				world.Each<Position, const Velocity>(moving, [](Entity, Position& position, const Velocity& velocity) { Move(position, velocity); });
+			}
+			else if (mode == 1)
+			{
+				world.ParallelEach<Position, const Velocity>(moving, [](Entity, Position& position, const Velocity& velocity) { Move(position, velocity); });
+			}
+			else
+			{
+				for (auto& object : objects)
+				{
+					if (!object.Sleeping)
+					{
+						Move(object.Place, object.Speed);
+					}
+				}
+			}
+			times[mode] += timer.GetElapsedTime();
+		}
+	}
+	for (int i = 0; i < iterations; i++)
+	{
+		for (auto& object : objects)
+		{
+			if (!object.Sleeping)
+			{
+				Move(object.Place, object.Speed);
+			}
+		}
+	}
+
+	bool matched = movingCount == entityCount - entityCount / 4;
+	world.Each<const Original, const Position>(all, [&](Entity entity, const Original& original, const Position& position)
+	{
+		auto& expected = objects[original.Number].Place;
+		matched = matched && position.X == expected.X && position.Y == expected.Y && position.Z == expected.Z
+			&& world.Get<Original>(entity)->Number == original.Number;
+	});
+
+	// 並列のシステムから構造の変更を記録する。100個に1つを消し、1つを止め、1つを起こし、1つ増やす
+	EntityCommandBuffer commands;
+	Timer recordTimer;
+	world.ParallelEach<const Original>(all, [&commands, entityCount](Entity entity, const Original& original)
+	{
+		switch (original.Number % 100)
+		{
+		case 0:
+			commands.Destroy(entity);
+			break;
+		case 1:
+			commands.Add(entity, Sleeping{ 1 });
+			break;
+		case 3:
+			commands.Remove<Sleeping>(entity);
+			break;
+		case 5:
+		{
+			auto created = commands.Create(ComponentMaskOf<Position, Velocity, Original>());
+			commands.Set(created, Original{ original.Number + entityCount });
+			break;
+		}
+		}
+	});
+	auto recordTime = recordTimer.GetElapsedTime();
+	auto commandCount = commands.Size();
+	Timer playbackTimer;
+	world.Playback(commands);
+	auto playbackTime = playbackTimer.GetElapsedTime();
+
+	// 変更の後の数を数え直し、番号からも部品を引けるか確かめる
+	uint32_t expectedAlive = 0;
+	uint32_t expectedSleeping = 0;
+	for (uint32_t i = 0; i < entityCount; i++)
+	{
+		auto bucket = i % 100;
+		if (bucket == 0)
+		{
+			continue;
+		}
+		expectedAlive += bucket == 5 ? 2 : 1;
+		expectedSleeping += bucket == 1 || (objects[i].Sleeping && bucket != 3) ? 1 : 0;
+	}
+	EntityQuery sleeping(ComponentMaskOf<Sleeping>());
+	matched = matched && world.EntityCount() == expectedAlive && world.Count(sleeping) == expectedSleeping && commands.IsEmpty();
+	world.Each<const Original, const Position>(all, [&](Entity entity, const Original& original, const Position& position)
+	{
+		if (original.Number >= entityCount)
+		{
+			matched = matched && (original.Number - entityCount) % 100 == 5 && position.X == 0.0f;
+		}
+		else
+		{
+			auto& expected = objects[original.Number].Place;
+			matched = matched && original.Number % 100 != 0 && position.X == expected.X && world.EntityAt(entity.Index) == entity;
+		}
+	});
+
+	auto workers = g_JobSystem != nullptr ? g_JobSystem->WorkerCount() : 1;
+	printf("エンティティ: %u個, アーキタイプ %u, チャンク %u個, %d回の平均\n", entityCount, world.ArchetypeCount(), chunkCount, iterations);
+	printf("  クエリ(Position, Velocity): 更新 %u個, %.3f ms (%uスレッド), %.3f ms (1スレッド, 1個あたり %.2f ns)\n",
+		movingCount, times[1] / iterations, workers, times[0] / iterations, movingCount > 0 ? times[0] / iterations / movingCount * 1e6 : 0.0);
+	printf("  全ての値を持つ構造体の配列: %.3f ms (1スレッド, 1個あたり %.2f ns)\n",
+		times[2] / iterations, movingCount > 0 ? times[2] / iterations / movingCount * 1e6 : 0.0);
+	printf("  コマンドバッファ: 操作 %zu個, 記録 %.3f ms (%uスレッド), 反映 %.3f ms\n", commandCount, recordTime, workers, playbackTime);
+	printf("  別に求めた結果との比較: %s\n", matched ? "一致" : "不一致");
+	return matched;
+}
@@ -0,0 +1,341 @@
+#include "EnvironmentBaker.h"
+#include "Engine.h"
+#include "Profiler.h"
+#include <d3dx12.h>
+#include <iterator>
+#include <stdio.h>
+
+namespace
+{
+	// CubeBake.hlsliのBakeParamsと同じ並び（ルート定数で渡す）
+	struct BakeConstants
+	{
+		uint32_t Size;
+		float Roughness;
+		uint32_t SampleCount;
+		uint32_t Padding;
+	};
+
+	const UINT THREAD_GROUP_SIZE = 8; // シェーダーのnumthreadsと合わせる
+	const UINT VIEWS_PER_TARGET = 1 + EnvironmentBaker::PREFILTER_MIPS; // イラディアンスマップとプリフィルタのミップごとのUAV
+
+	// ヒープの先頭は環境マップのSRV。その後に組ごとのUAVを並べる（slotは0がイラディアンス、1からがプリフィルタのミップ）
+	UINT UavIndex(uint32_t target, UINT slot)
+	{
+		return 1 + target * VIEWS_PER_TARGET + slot;
+	}
+
+	UINT GroupCount(UINT size)
+	{
+		return (size + THREAD_GROUP_SIZE - 1) / THREAD_GROUP_SIZE;
+	}
+
+	ComPtr<ID3D12Resource> CreateCubeTarget(UINT size, UINT16 mipLevels)
+	{
+		auto prop = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+		auto desc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R16G16B16A16_FLOAT, size, size, 6, mipLevels, 1, 0,
+			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+
+		// キューをまたいで渡すので、COMMONで作って描画キューでは暗黙の昇格で読む
+		ComPtr<ID3D12Resource> pResource;
+		auto hr = g_Engine->Device()->CreateCommittedResource(
+			&prop,
+			D3D12_HEAP_FLAG_NONE,
+			&desc,
+			D3D12_RESOURCE_STATE_COMMON,
+			nullptr,
+			IID_PPV_ARGS(pResource.GetAddressOf())
+		);
+		if (FAILED(hr))
+		{
+			return nullptr;
+		}
+		return pResource;
+	}
+}
+
+bool EnvironmentBaker::Init(ID3D12Resource* environment, ID3DBlob* irradianceShader, ID3DBlob* prefilterShader)
+{
+	if (environment == nullptr || irradianceShader == nullptr || prefilterShader == nullptr)
+	{
+		return false;
+	}
+	auto device = g_Engine->Device();
+
+	auto hr = device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COMPUTE, IID_PPV_ARGS(m_pAllocator.GetAddressOf()));
+	if (FAILED(hr))
+	{
+		printf("焼き込み用のコマンドアロケーターの生成に失敗\n");
+		return false;
+	}
+
+	hr = device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COMPUTE, m_pAllocator.Get(), nullptr, IID_PPV_ARGS(m_pCommandList.GetAddressOf()));
+	if (FAILED(hr))
+	{
+		printf("焼き込み用のコマンドリストの生成に失敗\n");
+		return false;
+	}
+	m_pCommandList->Close();
+
+	hr = device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(m_pFence.GetAddressOf()));
+	if (FAILED(hr))
+	{
+		printf("計算キューのフェンスの生成に失敗\n");
+		return false;
+	}
+
+	// ルートシグネチャ（定数、環境マップ、出力先）
+	CD3DX12_DESCRIPTOR_RANGE srvRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+	CD3DX12_DESCRIPTOR_RANGE uavRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0);
+	CD3DX12_ROOT_PARAMETER rootParam[3] = {};
+	rootParam[0].InitAsConstants(sizeof(BakeConstants) / sizeof(uint32_t), 0);
+	rootParam[1].InitAsDescriptorTable(1, &srvRange);
+	rootParam[2].InitAsDescriptorTable(1, &uavRange);
+
+	CD3DX12_STATIC_SAMPLER_DESC sampler(0, D3D12_FILTER_MIN_MAG_MIP_LINEAR);
+
+	D3D12_ROOT_SIGNATURE_DESC rootDesc = {};
+	rootDesc.NumParameters = static_cast<UINT>(std::size(rootParam));
+	rootDesc.pParameters = rootParam;
+	rootDesc.NumStaticSamplers = 1;
+	rootDesc.pStaticSamplers = &sampler;
+
+	ComPtr<ID3DBlob> pBlob;
+	ComPtr<ID3DBlob> pErrorBlob;
+	hr = D3D12SerializeRootSignature(&rootDesc, D3D_ROOT_SIGNATURE_VERSION_1, pBlob.GetAddressOf(), pErrorBlob.GetAddressOf());
+	if (FAILED(hr))
+	{
+		printf("焼き込み用のルートシグネチャのシリアライズに失敗\n");
+		return false;
+	}
+
+	m_pRootSignature = g_Engine->PSOCache()->GetRootSignature(pBlob->GetBufferPointer(), pBlob->GetBufferSize());
+	if (m_pRootSignature == nullptr)
+	{
+		printf("焼き込み用のルートシグネチャの生成に失敗\n");
+		return false;
+	}
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC pipelineDesc = {};
+	pipelineDesc.pRootSignature = m_pRootSignature.Get();
+	pipelineDesc.CS = CD3DX12_SHADER_BYTECODE(irradianceShader);
+	m_pIrradiancePipeline = g_Engine->PSOCache()->GetComputePipeline(pipelineDesc);
+	pipelineDesc.CS = CD3DX12_SHADER_BYTECODE(prefilterShader);
+	m_pPrefilterPipeline = g_Engine->PSOCache()->GetComputePipeline(pipelineDesc);
+	if (m_pIrradiancePipeline == nullptr || m_pPrefilterPipeline == nullptr)
+	{
+		printf("焼き込み用のパイプラインステートの生成に失敗\n");
+		return false;
+	}
+
+	if (!CreateTargets())
+	{
+		printf("焼き込み先のリソースの生成に失敗\n");
+		return false;
+	}
+	CreateViews(environment);
+
+	// 焼き込みのGPU時間を計算キューのタイムスタンプで測る
+	D3D12_QUERY_HEAP_DESC queryDesc = {};
+	queryDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	queryDesc.Count = 2;
+	hr = device->CreateQueryHeap(&queryDesc, IID_PPV_ARGS(m_pTimestampHeap.GetAddressOf()));
+	if (FAILED(hr))
+	{
+		printf("焼き込み用のクエリヒープの生成に失敗\n");
+		return false;
+	}
+
+	auto prop = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+	auto desc = CD3DX12_RESOURCE_DESC::Buffer(sizeof(UINT64) * queryDesc.Count);
+	hr = device->CreateCommittedResource(&prop, D3D12_HEAP_FLAG_NONE, &desc,
+		D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(m_pTimestampBuffer.GetAddressOf()));
+	if (FAILED(hr))
+	{
+		printf("焼き込み用のタイムスタンプのバッファの生成に失敗\n");
+		return false;
+	}
+	g_Engine->ComputeQueue()->GetTimestampFrequency(&m_TimestampFrequency);
+
+	// 計算キューではPIXEL_SHADER_RESOURCEを扱えないので、初期化のコマンドリストで全てのシェーダーから読める状態にしておく
+	ResourceStateTracker::Register(environment, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	g_Engine->StateTracker()->Transition(environment,
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+
+	// 初期化のコマンドリストが終われば焼き込める
+	m_Scheduler.Init(g_Engine->NextFenceValue());
+	return true;
+}
+
+bool EnvironmentBaker::CreateTargets()
+{
+	for (int i = 0; i < BakeScheduler::TARGET_COUNT; i++)
+	{
+		m_pIrradianceMaps[i] = CreateCubeTarget(IRRADIANCE_SIZE, 1);
+		m_pPrefilterMaps[i] = CreateCubeTarget(PREFILTER_SIZE, PREFILTER_MIPS);
+		if (m_pIrradianceMaps[i] == nullptr || m_pPrefilterMaps[i] == nullptr)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void EnvironmentBaker::CreateViews(ID3D12Resource* environment)
+{
+	auto device = g_Engine->Device();
+
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = UavIndex(BakeScheduler::TARGET_COUNT, 0);
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(m_pHeap.ReleaseAndGetAddressOf()));
+	m_DescriptorSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	auto start = m_pHeap->GetCPUDescriptorHandleForHeapStart();
+
+	auto environmentDesc = environment->GetDesc();
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = environmentDesc.Format;
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+	srvDesc.TextureCube.MipLevels = environmentDesc.MipLevels;
+	device->CreateShaderResourceView(environment, &srvDesc, start);
+
+	// 出力先はキューブの6面を配列として書く
+	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+	uavDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_TEXTURE2DARRAY;
+	uavDesc.Texture2DArray.FirstArraySlice = 0;
+	uavDesc.Texture2DArray.ArraySize = 6;
+	for (uint32_t target = 0; target < BakeScheduler::TARGET_COUNT; target++)
+	{
+		uavDesc.Texture2DArray.MipSlice = 0;
+		device->CreateUnorderedAccessView(m_pIrradianceMaps[target].Get(), nullptr, &uavDesc,
+			CD3DX12_CPU_DESCRIPTOR_HANDLE(start, UavIndex(target, 0), m_DescriptorSize));
+
+		for (UINT mip = 0; mip < PREFILTER_MIPS; mip++)
+		{
+			uavDesc.Texture2DArray.MipSlice = mip;
+			device->CreateUnorderedAccessView(m_pPrefilterMaps[target].Get(), nullptr, &uavDesc,
+				CD3DX12_CPU_DESCRIPTOR_HANDLE(start, UavIndex(target, 1 + mip), m_DescriptorSize));
+		}
+	}
+}
+
+void EnvironmentBaker::BeginFrame()
+{
+	PROFILE_SCOPE("EnvironmentBaker");
+
+	// 次の焼き込みがタイムスタンプを上書きする前に読む
+	ReadBakeTime();
+
+	auto plan = m_Scheduler.BeginFrame(m_pFence->GetCompletedValue());
+	if (plan.StartBake)
+	{
+		RecordBake(plan.Target);
+
+		// 焼き込む組を最後に読んだフレームが描画キューで終わるまで、計算キューを待たせる
+		auto queue = g_Engine->ComputeQueue();
+		queue->Wait(g_Engine->Fence(), plan.WaitValue);
+
+		ID3D12CommandList* ppCommandLists[] = { m_pCommandList.Get() };
+		queue->ExecuteCommandLists(1, ppCommandLists);
+		queue->Signal(m_pFence.Get(), ++m_FenceValue);
+		m_Scheduler.BakeSubmitted(m_FenceValue);
+	}
+
+	uint64_t waitValue;
+	m_Scheduler.AcquireFront(g_Engine->NextFenceValue(), &waitValue);
+	if (waitValue != 0)
+	{
+		g_Engine->Queue()->Wait(m_pFence.Get(), waitValue);
+	}
+}
+
+void EnvironmentBaker::RecordBake(uint32_t target)
+{
+	m_pAllocator->Reset();
+	m_pCommandList->Reset(m_pAllocator.Get(), nullptr);
+	auto commandList = m_pCommandList.Get();
+
+	ID3D12DescriptorHeap* heaps[] = { m_pHeap.Get() };
+	commandList->SetDescriptorHeaps(1, heaps);
+	commandList->SetComputeRootSignature(m_pRootSignature.Get());
+	auto heapStart = m_pHeap->GetGPUDescriptorHandleForHeapStart();
+	commandList->SetComputeRootDescriptorTable(1, heapStart);
+
+	commandList->EndQuery(m_pTimestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0);
+
+	// 描画キューからはCOMMONで渡されるので、書き込む間だけUAVにする
+	auto irradianceMap = m_pIrradianceMaps[target].Get();
+	auto prefilterMap = m_pPrefilterMaps[target].Get();
+	D3D12_RESOURCE_BARRIER barriers[2] =
+	{
+		CD3DX12_RESOURCE_BARRIER::Transition(irradianceMap, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+		CD3DX12_RESOURCE_BARRIER::Transition(prefilterMap, D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+	};
+	commandList->ResourceBarrier(2, barriers);
+
+	BakeConstants constants = { IRRADIANCE_SIZE, 0.0f, 0, 0 };
+	commandList->SetPipelineState(m_pIrradiancePipeline.Get());
+	commandList->SetComputeRoot32BitConstants(0, 4, &constants, 0);
+	commandList->SetComputeRootDescriptorTable(2, CD3DX12_GPU_DESCRIPTOR_HANDLE(heapStart, UavIndex(target, 0), m_DescriptorSize));
+	commandList->Dispatch(GroupCount(IRRADIANCE_SIZE), GroupCount(IRRADIANCE_SIZE), 6);
+
+	// ミップが下がるほど粗い面の反射にする
+	commandList->SetPipelineState(m_pPrefilterPipeline.Get());
+	for (UINT mip = 0; mip < PREFILTER_MIPS; mip++)
+	{
+		constants.Size = PREFILTER_SIZE >> mip;
+		constants.Roughness = static_cast<float>(mip) / (PREFILTER_MIPS - 1);
+		constants.SampleCount = PREFILTER_SAMPLES;
+		commandList->SetComputeRoot32BitConstants(0, 4, &constants, 0);
+		commandList->SetComputeRootDescriptorTable(2, CD3DX12_GPU_DESCRIPTOR_HANDLE(heapStart, UavIndex(target, 1 + mip), m_DescriptorSize));
+		commandList->Dispatch(GroupCount(constants.Size), GroupCount(constants.Size), 6);
+	}
+
+	// COMMONに戻して描画キューに渡す
+	for (auto& barrier : barriers)
+	{
+		barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+		barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COMMON;
+	}
+	commandList->ResourceBarrier(2, barriers);
+
+	commandList->EndQuery(m_pTimestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 1);
+	commandList->ResolveQueryData(m_pTimestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0, 2, m_pTimestampBuffer.Get(), 0);
+	commandList->Close();
+}
+
+void EnvironmentBaker::ReadBakeTime()
+{
+	if (m_ReportedValue == m_FenceValue || m_pFence->GetCompletedValue() < m_FenceValue)
+	{
+		return;
+	}
+	m_ReportedValue = m_FenceValue;
+
+	D3D12_RANGE readRange = { 0, sizeof(UINT64) * 2 };
+	UINT64* pTimestamps;
+	auto hr = m_pTimestampBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pTimestamps));
+	if (FAILED(hr))
+	{
+		return;
+	}
+
+	if (m_TimestampFrequency != 0)
+	{
+		auto time = static_cast<double>(pTimestamps[1] - pTimestamps[0]) * 1000.0 / m_TimestampFrequency;
+		printf("環境マップの焼き込み(計算キュー): %.3f ms\n", time);
+	}
+
+	// 計算キューの区間もタイムラインに載せる（時計は描画キューとは別に合わせる）
+	GpuClock clock;
+	if (Profiler::IsEnabled() && clock.Calibrate(g_Engine->ComputeQueue()))
+	{
+		Profiler::AddGpuEvent("Compute", "EnvironmentBake", clock.ToCpuTime(pTimestamps[0]), clock.ToCpuTime(pTimestamps[1]));
+	}
+
+	D3D12_RANGE writeRange = { 0, 0 };
+	m_pTimestampBuffer->Unmap(0, &writeRange);
+}
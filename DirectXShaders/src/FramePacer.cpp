@@ -0,0 +1,192 @@
+#include "FramePacer.h"
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+
+namespace
+{
+	const size_t FrameTimeHistory = 1024;
+}
+
+FramePacer::FramePacer(Clock& clock)
+	: m_Clock(clock)
+{
+	m_FrameTimes.reserve(FrameTimeHistory);
+}
+
+void FramePacer::SetTargetFrameRate(double frameRate)
+{
+	m_Period = frameRate > 0.0 ? static_cast<int64_t>(1000000000.0 / frameRate) : 0;
+	m_NextTarget = 0;
+}
+
+double FramePacer::WaitForNextFrame()
+{
+	auto now = m_Clock.Now();
+
+	if (m_Period > 0)
+	{
+		if (m_NextTarget == 0)
+		{
+			m_NextTarget = now;
+		}
+
+		// 1フレーム以上遅れている場合は追いつこうとせず、今から数え直す
+		if (now - m_NextTarget > m_Period)
+		{
+			m_MissedFrames++;
+			m_NextTarget = now;
+		}
+
+		// 粗い待ちはタイマーで、最後の少しだけスピンする
+		if (m_NextTarget - now > m_SpinTime)
+		{
+			m_Clock.SleepUntil(m_NextTarget - m_SpinTime);
+		}
+		while ((now = m_Clock.Now()) < m_NextTarget)
+		{
+		}
+
+		// 実際に起きた時刻ではなく目標時刻から次を決める（ずれを次のフレームで打ち消す）
+		m_NextTarget += m_Period;
+	}
+
+	double frameTime = 0.0;
+	if (m_LastFrameStart != 0)
+	{
+		frameTime = (now - m_LastFrameStart) / 1000000.0;
+
+		if (m_FrameTimes.size() < FrameTimeHistory)
+		{
+			m_FrameTimes.push_back(frameTime);
+		}
+		else
+		{
+			m_FrameTimes[m_FrameTimeIndex] = frameTime;
+			m_FrameTimeIndex = (m_FrameTimeIndex + 1) % FrameTimeHistory;
+		}
+		m_FrameCount++;
+	}
+	m_LastFrameStart = now;
+
+	return frameTime;
+}
+
+double FramePacer::Percentile(double percentile) const
+{
+	if (m_FrameTimes.empty())
+	{
+		return 0.0;
+	}
+
+	auto sorted = m_FrameTimes;
+	auto rank = static_cast<size_t>(percentile / 100.0 * (sorted.size() - 1) + 0.5);
+	rank = std::min(rank, sorted.size() - 1);
+	std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+	return sorted[rank];
+}
+
+void FramePacer::PrintStats() const
+{
+	printf("フレーム時間: 50%% %.2f ms, 90%% %.2f ms, 99%% %.2f ms, 最大 %.2f ms (目標 %.2f ms, 遅れ %u回)\n",
+		Percentile(50.0), Percentile(90.0), Percentile(99.0), Percentile(100.0),
+		m_Period / 1000000.0, m_MissedFrames);
+}
+
+bool FramePacer::RunTest()
+{
+	const int64_t Millisecond = 1000000;
+	const int64_t WorkTime = 5 * Millisecond; // 1フレームの処理にかかる時間
+	const int64_t ClockStep = 1000; // 偽の時計がNow()の1回で進む時間
+	bool isValid = true;
+
+	auto isNear = [](double value, double expected, double tolerance) { return std::abs(value - expected) <= tolerance; };
+
+	// 起きるのが遅れても、目標時刻は前回の目標＋間隔なので、開始時刻と目標の列とのずれは積み重ならない
+	// スピンの時間より遅れた分だけは毎フレーム遅れる
+	for (int64_t oversleep : { int64_t(0), Millisecond / 2, 3 * Millisecond / 2 })
+	{
+		FakeClock clock(ClockStep, oversleep);
+		FramePacer pacer(clock);
+		pacer.SetTargetFrameRate(60.0);
+		pacer.WaitForNextFrame();
+		auto firstStart = clock.Time();
+
+		const int64_t FrameCount = 600;
+		int64_t maxError = 0;
+		for (int64_t frame = 1; frame <= FrameCount; frame++)
+		{
+			clock.Advance(WorkTime);
+			pacer.WaitForNextFrame();
+			auto error = clock.Time() - (firstStart + frame * pacer.m_Period);
+			maxError = std::max(maxError, std::abs(error));
+		}
+
+		auto allowedError = std::max<int64_t>(oversleep - pacer.m_SpinTime, 0) + 2 * ClockStep;
+		bool isStable = maxError <= allowedError && pacer.MissedFrames() == 0
+			&& clock.SleepCount() == FrameCount && isNear(pacer.Percentile(50.0), pacer.m_Period / 1e6, 0.01);
+		if (!isStable)
+		{
+			printf("  起きる遅れ %.1f ms: 目標とのずれ 最大 %.3f ms (許容 %.3f ms), 遅れ %u回, 眠った回数 %u\n",
+				oversleep / 1e6, maxError / 1e6, allowedError / 1e6, pacer.MissedFrames(), clock.SleepCount());
+		}
+		isValid &= isStable;
+	}
+
+	// 1フレーム未満の遅れは次のフレームを早めて取り戻し、1フレーム以上の遅れは追いつこうとせずに今から数え直す
+	{
+		FakeClock clock(ClockStep);
+		FramePacer pacer(clock);
+		pacer.SetTargetFrameRate(60.0);
+		pacer.WaitForNextFrame();
+		for (int i = 0; i < 10; i++)
+		{
+			clock.Advance(WorkTime);
+			pacer.WaitForNextFrame();
+		}
+		auto period = pacer.m_Period / 1e6;
+		const double Tolerance = 0.01;
+
+		clock.Advance(pacer.m_Period * 3 / 2);
+		auto lateFrame = pacer.WaitForNextFrame();
+		clock.Advance(WorkTime);
+		auto catchUpFrame = pacer.WaitForNextFrame();
+		bool caughtUp = pacer.MissedFrames() == 0 && isNear(lateFrame, period * 1.5, Tolerance)
+			&& isNear(catchUpFrame, period * 0.5, Tolerance);
+
+		clock.Advance(pacer.m_Period * 3);
+		auto missedFrame = pacer.WaitForNextFrame();
+		bool restarted = pacer.MissedFrames() == 1 && isNear(missedFrame, period * 3.0, Tolerance);
+		for (int i = 0; i < 3; i++)
+		{
+			clock.Advance(WorkTime);
+			restarted &= isNear(pacer.WaitForNextFrame(), period, Tolerance);
+		}
+
+		if (!caughtUp || !restarted)
+		{
+			printf("  遅れの扱い: 取り戻し %.3f ms → %.3f ms, 数え直し %.3f ms (遅れ %u回)\n",
+				lateFrame, catchUpFrame, missedFrame, pacer.MissedFrames());
+		}
+		isValid &= caughtUp && restarted;
+	}
+
+	// フレームレートの指定が無ければ待たない
+	{
+		FakeClock clock(ClockStep);
+		FramePacer pacer(clock);
+		pacer.SetTargetFrameRate(0.0);
+		pacer.WaitForNextFrame();
+		clock.Advance(WorkTime);
+		auto frameTime = pacer.WaitForNextFrame();
+		bool isFree = clock.SleepCount() == 0 && isNear(frameTime, WorkTime / 1e6, 0.01);
+		if (!isFree)
+		{
+			printf("  制限なし: %.3f ms, 眠った回数 %u\n", frameTime, clock.SleepCount());
+		}
+		isValid &= isFree;
+	}
+
+	printf("フレームの間隔のテスト: %s\n", isValid ? "成功" : "失敗");
+	return isValid;
+}
@@ -0,0 +1,299 @@
+#include "FrameScheduler.h"
+#include "DeferredReleaseQueue.h"
+#include <algorithm>
+#include <stdio.h>
+#include <vector>
+
+void FrameScheduler::Init(uint32_t framesInFlight)
+{
+	m_FramesInFlight = std::clamp<uint32_t>(framesInFlight, MIN_FRAMES_IN_FLIGHT, MAX_FRAMES_IN_FLIGHT);
+	m_CurrentSlot = 0;
+	m_NextFenceValue = 1;
+	for (auto& value : m_SlotFenceValues)
+	{
+		value = 0;
+	}
+	ResetStats();
+}
+
+uint64_t FrameScheduler::Submit()
+{
+	// フェンス値は全スロットで共通の単調増加にする（遅延解放も同じ値で判定できる）
+	auto fenceValue = m_NextFenceValue++;
+	m_SlotFenceValues[m_CurrentSlot] = fenceValue;
+	m_CurrentSlot = (m_CurrentSlot + 1) % m_FramesInFlight;
+	return fenceValue;
+}
+
+void FrameScheduler::RecordCpuFrame(double frameTime, double waitTime)
+{
+	m_CpuFrames++;
+	m_CpuFrameTime += frameTime;
+	m_CpuWaitTime += waitTime;
+}
+
+void FrameScheduler::RecordGpuFrame(uint64_t beginTick, uint64_t endTick, uint64_t frequency)
+{
+	if (frequency == 0 || endTick < beginTick)
+	{
+		return;
+	}
+
+	auto toMs = 1000.0 / static_cast<double>(frequency);
+	m_GpuFrames++;
+	m_GpuBusyTime += (endTick - beginTick) * toMs;
+
+	// 前のフレームが終わってから次が始まるまでGPUは何もしていない
+	if (m_LastGpuEndTick != 0 && beginTick > m_LastGpuEndTick)
+	{
+		auto idle = (beginTick - m_LastGpuEndTick) * toMs;
+		m_GpuIdleTime += idle;
+		m_MaxGpuIdleTime = std::max(m_MaxGpuIdleTime, idle);
+	}
+	if (m_LastGpuEndTick != 0)
+	{
+		m_GpuGaps++;
+	}
+	m_LastGpuEndTick = endTick;
+}
+
+FrameScheduler::Stats FrameScheduler::GetStats() const
+{
+	Stats stats = {};
+	stats.FrameCount = m_CpuFrames;
+	if (m_CpuFrames > 0)
+	{
+		stats.CpuFrameTime = m_CpuFrameTime / m_CpuFrames;
+		stats.CpuWaitTime = m_CpuWaitTime / m_CpuFrames;
+	}
+	if (m_GpuFrames > 0)
+	{
+		stats.GpuBusyTime = m_GpuBusyTime / m_GpuFrames;
+	}
+	if (m_GpuGaps > 0)
+	{
+		stats.GpuIdleTime = m_GpuIdleTime / m_GpuGaps;
+	}
+	stats.MaxGpuIdleTime = m_MaxGpuIdleTime;
+	return stats;
+}
+
+void FrameScheduler::ResetStats()
+{
+	m_CpuFrames = 0;
+	m_CpuFrameTime = 0.0;
+	m_CpuWaitTime = 0.0;
+	m_GpuFrames = 0;
+	m_GpuGaps = 0;
+	m_GpuBusyTime = 0.0;
+	m_GpuIdleTime = 0.0;
+	m_MaxGpuIdleTime = 0.0;
+	// m_LastGpuEndTickは残し、次の区間の最初の隙間も数える
+}
+
+void FrameScheduler::PrintStats() const
+{
+	auto stats = GetStats();
+	printf("フレーム(%u枚を同時に処理): CPU %.2f ms (フェンス待ち %.2f ms), GPU %.2f ms, GPUの空き 平均 %.3f ms / 最大 %.3f ms\n",
+		m_FramesInFlight, stats.CpuFrameTime, stats.CpuWaitTime, stats.GpuBusyTime, stats.GpuIdleTime, stats.MaxGpuIdleTime);
+}
+
+namespace
+{
+	// シグナルした値ごとにGPUが終える時刻を覚えておき、時刻を渡すとその時点の完了値を返すフェンス
+	// GPUはキューに積まれた順に1フレームずつ処理する
+	class FakeFence
+	{
+	public:
+		// CPUが時刻submitTimeに投げたフレームの完了時刻を返す
+		double Signal(uint64_t value, double submitTime, double gpuTime)
+		{
+			auto start = std::max(submitTime, m_LastEndTime);
+			m_LastEndTime = start + gpuTime;
+			m_Frames.push_back({ value, start, m_LastEndTime });
+			return m_LastEndTime;
+		}
+
+		uint64_t CompletedValue(double time) const
+		{
+			uint64_t value = 0;
+			for (auto& frame : m_Frames)
+			{
+				if (frame.EndTime <= time)
+				{
+					value = std::max(value, frame.Value);
+				}
+			}
+			return value;
+		}
+
+		// valueが完了する時刻（CPUがフェンスを待って起きる時刻）
+		double CompletionTime(uint64_t value) const
+		{
+			for (auto& frame : m_Frames)
+			{
+				if (frame.Value == value)
+				{
+					return frame.EndTime;
+				}
+			}
+			return 0.0;
+		}
+
+		struct Frame
+		{
+			uint64_t Value;
+			double StartTime;
+			double EndTime;
+		};
+		const std::vector<Frame>& Frames() const { return m_Frames; }
+
+	private:
+		std::vector<Frame> m_Frames;
+		double m_LastEndTime = 0.0;
+	};
+
+	// 遅延解放されたオブジェクト。解放された時点でGPUが使い終わっているかを数える
+	struct ReleasedObject
+	{
+		uint64_t FenceValue;
+		static uint64_t s_CompletedValue;
+		static uint32_t s_EarlyReleases;
+
+		~ReleasedObject()
+		{
+			if (s_CompletedValue < FenceValue)
+			{
+				s_EarlyReleases++;
+			}
+		}
+	};
+	uint64_t ReleasedObject::s_CompletedValue = 0;
+	uint32_t ReleasedObject::s_EarlyReleases = 0;
+
+	struct Workload
+	{
+		const char* Name;
+		double CpuTime; // 1フレームの記録にかかる時間（ミリ秒）
+		double GpuTime;
+	};
+
+	// Engine::BeginRender/EndRenderと同じ順に、待つ、回収する、記録する、投げる、を繰り返す
+	bool Simulate(uint32_t framesInFlight, const Workload& workload)
+	{
+		const uint32_t FrameCount = 200;
+		FrameScheduler scheduler;
+		scheduler.Init(framesInFlight);
+		FakeFence fence;
+		DeferredReleaseQueue releaseQueue;
+		releaseQueue.SetCurrentFenceValue(scheduler.NextFenceValue());
+		ReleasedObject::s_CompletedValue = 0;
+		ReleasedObject::s_EarlyReleases = 0;
+
+		// スケジューラーとは別に、各スロットを最後に使ったフレームのフェンス値を覚えておく
+		uint64_t slotOwners[FrameScheduler::MAX_FRAMES_IN_FLIGHT] = {};
+		uint32_t reusedSlots = 0;
+		uint32_t maxInFlight = 0;
+		double time = 0.0;
+		uint32_t seed = 12345;
+
+		for (uint32_t frame = 0; frame < FrameCount; frame++)
+		{
+			auto slot = scheduler.CurrentSlot();
+			auto waitValue = scheduler.WaitValue();
+			double waitTime = 0.0;
+			if (fence.CompletedValue(time) < waitValue)
+			{
+				auto wakeTime = fence.CompletionTime(waitValue);
+				waitTime = wakeTime - time;
+				time = wakeTime;
+			}
+
+			auto completed = fence.CompletedValue(time);
+			if (completed < slotOwners[slot])
+			{
+				reusedSlots++;
+			}
+			// これから投げるフレームも含めて、GPUに投げてあるフレームの数
+			auto inFlight = static_cast<uint32_t>(scheduler.LastSubmittedValue() - completed) + 1;
+			maxInFlight = std::max(maxInFlight, inFlight);
+			ReleasedObject::s_CompletedValue = completed;
+			releaseQueue.Collect(completed);
+
+			// 記録中に手放したオブジェクトは、このフレームのフェンス値が完了するまで残る
+			releaseQueue.Delete(new ReleasedObject{ scheduler.NextFenceValue() });
+
+			// CPUとGPUの時間を±25%揺らす
+			seed = seed * 1664525u + 1013904223u;
+			auto jitter = 0.75 + 0.5 * (seed >> 8) / static_cast<double>(1u << 24);
+			time += workload.CpuTime * jitter;
+			scheduler.RecordCpuFrame(workload.CpuTime * jitter + waitTime, waitTime);
+			auto fenceValue = scheduler.Submit();
+			fence.Signal(fenceValue, time, workload.GpuTime * (2.0 - jitter));
+			releaseQueue.SetCurrentFenceValue(scheduler.NextFenceValue());
+			slotOwners[slot] = fenceValue;
+		}
+
+		// GPUのタイムスタンプはマイクロ秒で渡す
+		for (auto& gpuFrame : fence.Frames())
+		{
+			scheduler.RecordGpuFrame(static_cast<uint64_t>(gpuFrame.StartTime * 1000.0),
+				static_cast<uint64_t>(gpuFrame.EndTime * 1000.0), 1000000);
+		}
+		auto stats = scheduler.GetStats();
+
+		ReleasedObject::s_CompletedValue = scheduler.LastSubmittedValue();
+		releaseQueue.Collect(scheduler.LastSubmittedValue());
+
+		bool isValid = reusedSlots == 0 && ReleasedObject::s_EarlyReleases == 0 && maxInFlight <= scheduler.FramesInFlight();
+		// GPUが律速なら、CPUは先に投げて待っているのでGPUは空かない。CPUが律速ならCPUはフェンスを待たない
+		if (workload.GpuTime > workload.CpuTime * 2.0)
+		{
+			isValid &= stats.MaxGpuIdleTime == 0.0;
+		}
+		if (workload.CpuTime > workload.GpuTime * 2.0)
+		{
+			isValid &= stats.CpuWaitTime == 0.0;
+		}
+		if (!isValid)
+		{
+			printf("  %s, %u枚: 使用中のスロットの再利用 %u回, 早すぎる解放 %u個, 最大 %u枚を処理中, フェンス待ち %.3f ms, GPUの空き 最大 %.3f ms\n",
+				workload.Name, scheduler.FramesInFlight(), reusedSlots, ReleasedObject::s_EarlyReleases, maxInFlight,
+				stats.CpuWaitTime, stats.MaxGpuIdleTime);
+		}
+		return isValid;
+	}
+}
+
+bool FrameScheduler::RunTest()
+{
+	bool isValid = true;
+
+	// 範囲外のフレーム数は丸める
+	FrameScheduler scheduler;
+	scheduler.Init(1);
+	isValid &= scheduler.FramesInFlight() == MIN_FRAMES_IN_FLIGHT;
+	scheduler.Init(8);
+	isValid &= scheduler.FramesInFlight() == MAX_FRAMES_IN_FLIGHT;
+	if (!isValid)
+	{
+		printf("  同時に処理するフレーム数が丸められていない\n");
+	}
+
+	const Workload workloads[] =
+	{
+		{ "CPUが律速", 8.0, 3.0 },
+		{ "GPUが律速", 2.0, 7.0 },
+		{ "釣り合い", 5.0, 5.0 },
+	};
+	for (uint32_t framesInFlight = MIN_FRAMES_IN_FLIGHT; framesInFlight <= MAX_FRAMES_IN_FLIGHT; framesInFlight++)
+	{
+		for (auto& workload : workloads)
+		{
+			isValid &= Simulate(framesInFlight, workload);
+		}
+	}
+
+	printf("フレームのスケジューラーのテスト: %s\n", isValid ? "成功" : "失敗");
+	return isValid;
+}
@@ -0,0 +1,491 @@
+#include "FrameStats.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+thread_local FrameStats::ThreadCounters* FrameStats::t_pCounters = nullptr;
+
+namespace
+{
+	const char* s_Names[STAT_COUNT] =
+	{
+		"DrawCalls",
+		"Instances",
+		"Triangles",
+		"StateChanges",
+		"ApiCalls",
+		"UploadBytes",
+		"Descriptors",
+		"Resources",
+		"ResourceBytes",
+	};
+
+	std::mutex s_CounterMutex; // カウンタの登録と集める時だけ取る
+	std::vector<std::unique_ptr<FrameStats::ThreadCounters>> s_Counters; // スレッドが終わっても足した値は残す
+
+	int64_t s_Limits[STAT_COUNT] = {};
+	int64_t s_LastTotals[STAT_COUNT] = {}; // 前のフレームまでの合計（フレームごとの数は差で求める）
+	FrameStats::Record s_History[FrameStats::HISTORY_SIZE];
+	uint32_t s_HistoryCount = 0;
+	uint32_t s_HistoryNext = 0;
+
+#ifdef _WIN32
+	const wchar_t* SharedMemoryName = L"Local\\DirectXShadersStats";
+	HANDLE s_hMapping = nullptr;
+#else
+	const char* SharedMemoryName = "/DirectXShadersStats";
+#endif
+	SharedStatsBlock* s_pShared = nullptr;
+
+	void* MapSharedMemory(bool create)
+	{
+#ifdef _WIN32
+		HANDLE mapping = create
+			? CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, sizeof(SharedStatsBlock), SharedMemoryName)
+			: OpenFileMappingW(FILE_MAP_READ, FALSE, SharedMemoryName);
+		if (mapping == nullptr)
+		{
+			return nullptr;
+		}
+		if (create && GetLastError() == ERROR_ALREADY_EXISTS)
+		{
+			printf("統計の共有メモリは他のプロセスが使っている\n");
+			CloseHandle(mapping);
+			return nullptr;
+		}
+
+		auto p = MapViewOfFile(mapping, create ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, sizeof(SharedStatsBlock));
+		if (p == nullptr || !create)
+		{
+			// 読む側はビューが残っていればいいので、ハンドルはすぐ閉じる
+			CloseHandle(mapping);
+			return p;
+		}
+		s_hMapping = mapping;
+		return p;
+#else
+		auto fd = create
+			? shm_open(SharedMemoryName, O_CREAT | O_EXCL | O_RDWR, 0644)
+			: shm_open(SharedMemoryName, O_RDONLY, 0);
+		if (fd < 0)
+		{
+			if (create)
+			{
+				printf("統計の共有メモリは他のプロセスが使っている\n");
+			}
+			return nullptr;
+		}
+		if (create && ftruncate(fd, sizeof(SharedStatsBlock)) != 0)
+		{
+			close(fd);
+			shm_unlink(SharedMemoryName);
+			return nullptr;
+		}
+
+		auto p = mmap(nullptr, sizeof(SharedStatsBlock), create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (p == MAP_FAILED)
+		{
+			if (create)
+			{
+				shm_unlink(SharedMemoryName);
+			}
+			return nullptr;
+		}
+		return p;
+#endif
+	}
+
+	void UnmapSharedMemory(const void* p)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(p);
+#else
+		munmap(const_cast<void*>(p), sizeof(SharedStatsBlock));
+#endif
+	}
+
+	void Publish(const FrameStats::Record& record)
+	{
+		// 書いている間はSequenceを奇数にしておく
+		auto sequence = s_pShared->Sequence.load(std::memory_order_relaxed);
+		s_pShared->Sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		s_pShared->Frame = record.Frame;
+		s_pShared->FrameTime = record.FrameTime;
+		memcpy(s_pShared->Values, record.Values, sizeof(record.Values));
+		memcpy(s_pShared->Limits, s_Limits, sizeof(s_Limits));
+
+		s_pShared->Sequence.store(sequence + 2, std::memory_order_release);
+	}
+}
+
+FrameStats::ThreadCounters* FrameStats::RegisterThread()
+{
+	auto counters = std::make_unique<ThreadCounters>();
+	for (auto& value : counters->Values)
+	{
+		value.store(0, std::memory_order_relaxed);
+	}
+
+	std::lock_guard<std::mutex> lock(s_CounterMutex);
+	s_Counters.push_back(std::move(counters));
+	t_pCounters = s_Counters.back().get();
+	return t_pCounters;
+}
+
+const char* FrameStats::Name(StatCounter counter)
+{
+	return counter < STAT_COUNT ? s_Names[counter] : "";
+}
+
+void FrameStats::SetLimit(StatCounter counter, int64_t limit)
+{
+	s_Limits[counter] = limit;
+}
+
+int64_t FrameStats::Limit(StatCounter counter)
+{
+	return s_Limits[counter];
+}
+
+void FrameStats::EndFrame(uint64_t frame, double frameTime)
+{
+	int64_t totals[STAT_COUNT] = {};
+	{
+		std::lock_guard<std::mutex> lock(s_CounterMutex);
+		for (auto& counters : s_Counters)
+		{
+			for (uint32_t i = 0; i < STAT_COUNT; i++)
+			{
+				totals[i] += counters->Values[i].load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	auto& record = s_History[s_HistoryNext];
+	record.Frame = frame;
+	record.FrameTime = frameTime;
+	for (uint32_t i = 0; i < STAT_COUNT; i++)
+	{
+		record.Values[i] = i < STAT_FIRST_GAUGE ? totals[i] - s_LastTotals[i] : totals[i];
+		s_LastTotals[i] = totals[i];
+	}
+	s_HistoryNext = (s_HistoryNext + 1) % HISTORY_SIZE;
+	s_HistoryCount = std::min<uint32_t>(s_HistoryCount + 1, HISTORY_SIZE);
+
+	if (s_pShared != nullptr)
+	{
+		Publish(record);
+	}
+}
+
+uint32_t FrameStats::HistoryCount()
+{
+	return s_HistoryCount;
+}
+
+const FrameStats::Record& FrameStats::History(uint32_t index)
+{
+	return s_History[(s_HistoryNext + HISTORY_SIZE - s_HistoryCount + index) % HISTORY_SIZE];
+}
+
+const FrameStats::Record& FrameStats::Latest()
+{
+	static const Record empty = {};
+	return s_HistoryCount > 0 ? History(s_HistoryCount - 1) : empty;
+}
+
+bool FrameStats::WriteCsv(std::ostream& out)
+{
+	out << "Frame,FrameTime";
+	for (auto name : s_Names)
+	{
+		out << ',' << name;
+	}
+	out << '\n';
+
+	out << std::fixed << std::setprecision(3);
+	for (uint32_t i = 0; i < s_HistoryCount; i++)
+	{
+		auto& record = History(i);
+		out << record.Frame << ',' << record.FrameTime;
+		for (auto value : record.Values)
+		{
+			out << ',' << value;
+		}
+		out << '\n';
+	}
+	return out.good();
+}
+
+bool FrameStats::WriteJson(std::ostream& out)
+{
+	out << std::fixed << std::setprecision(3);
+	out << "{\"limits\":{";
+	bool isFirst = true;
+	for (uint32_t i = 0; i < STAT_COUNT; i++)
+	{
+		if (s_Limits[i] != 0)
+		{
+			out << (isFirst ? "" : ",") << '"' << s_Names[i] << "\":" << s_Limits[i];
+			isFirst = false;
+		}
+	}
+	out << "},\n\"frames\":[";
+
+	for (uint32_t i = 0; i < s_HistoryCount; i++)
+	{
+		auto& record = History(i);
+		out << (i == 0 ? "\n" : ",\n") << "{\"Frame\":" << record.Frame << ",\"FrameTime\":" << record.FrameTime;
+		for (uint32_t c = 0; c < STAT_COUNT; c++)
+		{
+			out << ",\"" << s_Names[c] << "\":" << record.Values[c];
+		}
+		out << '}';
+	}
+	out << "\n]}\n";
+	return out.good();
+}
+
+bool FrameStats::Export(const std::filesystem::path& path)
+{
+	auto csvPath = path;
+	auto jsonPath = path;
+	csvPath.replace_extension(".csv");
+	jsonPath.replace_extension(".json");
+
+	std::ofstream csv(csvPath, std::ios::trunc);
+	std::ofstream json(jsonPath, std::ios::trunc);
+	if (!csv || !json)
+	{
+		printf("統計のファイルを開けない: %s\n", path.string().c_str());
+		return false;
+	}
+
+	if (!WriteCsv(csv) || !WriteJson(json))
+	{
+		return false;
+	}
+	printf("統計を書き出した: %s, %s (%uフレーム)\n", csvPath.string().c_str(), jsonPath.string().c_str(), s_HistoryCount);
+	return true;
+}
+
+bool FrameStats::OpenSharedMemory()
+{
+	if (s_pShared != nullptr)
+	{
+		return true;
+	}
+
+	auto p = MapSharedMemory(true);
+	if (p == nullptr)
+	{
+		return false;
+	}
+
+	// 作った直後は0で埋まっている。Magicは名前を書いてから入れる
+	auto block = static_cast<SharedStatsBlock*>(p);
+	block->Version = SharedStatsBlock::VERSION;
+	block->CounterCount = STAT_COUNT;
+	for (uint32_t i = 0; i < STAT_COUNT; i++)
+	{
+		memcpy(block->Names[i], s_Names[i], std::min<size_t>(strlen(s_Names[i]), SharedStatsBlock::NAME_LENGTH - 1));
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+	block->Magic = SharedStatsBlock::MAGIC;
+
+	s_pShared = block;
+	return true;
+}
+
+void FrameStats::CloseSharedMemory()
+{
+	if (s_pShared == nullptr)
+	{
+		return;
+	}
+
+	UnmapSharedMemory(s_pShared);
+	s_pShared = nullptr;
+#ifdef _WIN32
+	CloseHandle(s_hMapping);
+	s_hMapping = nullptr;
+#else
+	shm_unlink(SharedMemoryName);
+#endif
+}
+
+bool FrameStats::ReadSharedMemory(SharedStatsBlock* pBlock)
+{
+	auto p = MapSharedMemory(false);
+	if (p == nullptr)
+	{
+		return false;
+	}
+
+	auto block = static_cast<const SharedStatsBlock*>(p);
+	bool isRead = false;
+	if (block->Magic == SharedStatsBlock::MAGIC && block->Version == SharedStatsBlock::VERSION && block->CounterCount == STAT_COUNT)
+	{
+		// 書いている途中を読んだら読み直す
+		for (int retry = 0; retry < 1000 && !isRead; retry++)
+		{
+			auto sequence = block->Sequence.load(std::memory_order_acquire);
+			if (sequence & 1)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			pBlock->Magic = block->Magic;
+			pBlock->Version = block->Version;
+			pBlock->CounterCount = block->CounterCount;
+			pBlock->Frame = block->Frame;
+			pBlock->FrameTime = block->FrameTime;
+			memcpy(pBlock->Values, block->Values, sizeof(block->Values));
+			memcpy(pBlock->Limits, block->Limits, sizeof(block->Limits));
+			memcpy(pBlock->Names, block->Names, sizeof(block->Names));
+			std::atomic_thread_fence(std::memory_order_acquire);
+
+			isRead = block->Sequence.load(std::memory_order_relaxed) == sequence;
+			pBlock->Sequence.store(sequence, std::memory_order_relaxed);
+		}
+	}
+
+	UnmapSharedMemory(p);
+	return isRead;
+}
+
+void FrameStats::RunMonitor()
+{
+	SharedStatsBlock block = {};
+	if (!ReadSharedMemory(&block))
+	{
+		printf("統計の共有メモリが見つからない（描画しているプロセスが無い）\n");
+		return;
+	}
+
+	// 描画しているプロセスが終わると共有メモリが無くなるので、読めなくなるまで続ける
+	do
+	{
+		printf("フレーム %llu (%.2f ms):", static_cast<unsigned long long>(block.Frame), block.FrameTime);
+		for (uint32_t i = 0; i < STAT_COUNT; i++)
+		{
+			printf(" %s %lld", block.Names[i], static_cast<long long>(block.Values[i]));
+			if (block.Limits[i] != 0)
+			{
+				printf("/%lld", static_cast<long long>(block.Limits[i]));
+			}
+		}
+		printf("\n");
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	} while (ReadSharedMemory(&block));
+
+	printf("統計の共有メモリが無くなったので終了\n");
+}
+
+void FrameStats::MeasureOverhead()
+{
+	const uint32_t iterations = 1000000;
+	Add(STAT_DRAW_CALLS, 0); // カウンタの登録は計測から外す
+
+	// 足して引くので、集めた値は変わらない
+	auto begin = Profiler::Now();
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		Add(STAT_DRAW_CALLS, 1);
+		Add(STAT_DRAW_CALLS, -1);
+	}
+	auto time = static_cast<double>(Profiler::Now() - begin) / (iterations * 2);
+
+	printf("統計のカウンタの手間: 加算1回あたり %.2f ns\n", time);
+}
+
+bool FrameStats::RunHeadlessTest(const std::filesystem::path& path)
+{
+	const uint32_t threadCount = 4;
+	const uint32_t frameCount = 120;
+	const uint32_t resourceLifetime = 10; // 各スレッドは毎フレーム1つ作り、このフレーム数の後に1つ捨てる
+	const int64_t resourceSize = 1024;
+
+	MeasureOverhead();
+	auto isShared = OpenSharedMemory();
+	SetLimit(STAT_DESCRIPTORS, 512);
+
+	// フレームごとにスレッドを作り直すので、終わったスレッドの値が残ることも確かめられる
+	bool isValid = true;
+	for (uint32_t frame = 0; frame < frameCount; frame++)
+	{
+		std::vector<std::thread> threads;
+		for (uint32_t t = 0; t < threadCount; t++)
+		{
+			threads.emplace_back([=]()
+			{
+				for (uint32_t draw = 0; draw <= frame; draw++)
+				{
+					Add(STAT_DRAW_CALLS, 1);
+					Add(STAT_TRIANGLES, 12);
+					Add(STAT_UPLOAD_BYTES, 256);
+				}
+				Add(STAT_RESOURCE_COUNT, 1);
+				Add(STAT_RESOURCE_BYTES, resourceSize);
+				if (frame >= resourceLifetime)
+				{
+					Add(STAT_RESOURCE_COUNT, -1);
+					Add(STAT_RESOURCE_BYTES, -resourceSize);
+				}
+			});
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		Add(STAT_DESCRIPTORS, 1);
+		EndFrame(frame, 16.667);
+
+		int64_t draws = threadCount * (frame + 1);
+		int64_t resources = threadCount * (std::min<int64_t>(frame + 1, resourceLifetime));
+		auto& record = Latest();
+		isValid &= record.Frame == frame
+			&& record.Values[STAT_DRAW_CALLS] == draws
+			&& record.Values[STAT_TRIANGLES] == draws * 12
+			&& record.Values[STAT_UPLOAD_BYTES] == draws * 256
+			&& record.Values[STAT_DESCRIPTORS] == frame + 1
+			&& record.Values[STAT_RESOURCE_COUNT] == resources
+			&& record.Values[STAT_RESOURCE_BYTES] == resources * resourceSize;
+	}
+
+	// 共有メモリから読んだ値が最新のフレームと同じか
+	bool isSharedValid = false;
+	SharedStatsBlock block = {};
+	if (isShared && ReadSharedMemory(&block))
+	{
+		auto& latest = Latest();
+		isSharedValid = block.Frame == latest.Frame && memcmp(block.Values, latest.Values, sizeof(latest.Values)) == 0
+			&& block.Limits[STAT_DESCRIPTORS] == 512 && strcmp(block.Names[STAT_TRIANGLES], "Triangles") == 0;
+	}
+	CloseSharedMemory();
+
+	auto isWritten = Export(path);
+	printf("統計のテスト: 集計 %s, 共有メモリ %s, 書き出し %s\n",
+		isValid ? "一致" : "不一致", isSharedValid ? "一致" : "不一致", isWritten ? "成功" : "失敗");
+	return isValid && isSharedValid && isWritten;
+}
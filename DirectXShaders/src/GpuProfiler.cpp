@@ -0,0 +1,123 @@
+#include "GpuProfiler.h"
+#include "Profiler.h"
+#include "Clock.h"
+#include <d3dx12.h>
+#include <stdio.h>
+
+bool GpuClock::Calibrate(ID3D12CommandQueue* queue)
+{
+	UINT64 gpuTick;
+	UINT64 cpuCounter;
+	if (FAILED(queue->GetTimestampFrequency(&Frequency)) || FAILED(queue->GetClockCalibration(&gpuTick, &cpuCounter)))
+	{
+		return false;
+	}
+
+	// Profiler::Nowと同じ時計なので、同じ変換でQueryPerformanceCounterの値をナノ秒にする
+	GpuTick = gpuTick;
+	CpuTime = SystemClock::CounterToNanoseconds(static_cast<int64_t>(cpuCounter));
+	return Frequency != 0;
+}
+
+int64_t GpuClock::ToCpuTime(UINT64 tick) const
+{
+	// 合わせた時より前のタイムスタンプも変換するので、差は符号付きで扱う
+	auto delta = static_cast<int64_t>(tick - GpuTick);
+	return CpuTime + static_cast<int64_t>(static_cast<double>(delta) * 1000000000.0 / Frequency);
+}
+
+bool GpuProfiler::Init(ID3D12Device* device, ID3D12CommandQueue* queue, const char* track)
+{
+	m_pQueue = queue;
+	m_Track = track;
+
+	D3D12_QUERY_HEAP_DESC queryDesc = {};
+	queryDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	queryDesc.Count = MAX_SLOTS * MAX_SCOPES * 2;
+	auto hr = device->CreateQueryHeap(&queryDesc, IID_PPV_ARGS(m_pQueryHeap.ReleaseAndGetAddressOf()));
+	if (FAILED(hr))
+	{
+		printf("プロファイラのクエリヒープの生成に失敗\n");
+		return false;
+	}
+
+	auto prop = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+	auto desc = CD3DX12_RESOURCE_DESC::Buffer(sizeof(UINT64) * queryDesc.Count);
+	hr = device->CreateCommittedResource(&prop, D3D12_HEAP_FLAG_NONE, &desc,
+		D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(m_pReadbackBuffer.ReleaseAndGetAddressOf()));
+	if (FAILED(hr))
+	{
+		printf("プロファイラのリードバックバッファの生成に失敗\n");
+		return false;
+	}
+
+	hr = m_pReadbackBuffer->Map(0, nullptr, reinterpret_cast<void**>(&m_pTimestamps));
+	if (FAILED(hr))
+	{
+		printf("プロファイラのリードバックバッファのマップに失敗\n");
+		return false;
+	}
+
+	return true;
+}
+
+void GpuProfiler::BeginFrame(UINT slot)
+{
+	ReadSlot(slot);
+
+	m_Slot = slot;
+	m_ScopeCounts[slot] = 0;
+	// フレームの途中で切り替わっても区間の始まりと終わりが揃うよう、フレームの始めに決める
+	m_IsActive = m_pTimestamps != nullptr && Profiler::IsEnabled();
+}
+
+UINT GpuProfiler::Begin(ID3D12GraphicsCommandList* commandList, const char* name)
+{
+	auto& count = m_ScopeCounts[m_Slot];
+	if (!m_IsActive || count >= MAX_SCOPES)
+	{
+		return INVALID_SCOPE;
+	}
+
+	auto scope = count++;
+	m_Names[m_Slot][scope] = name;
+	commandList->EndQuery(m_pQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, QueryIndex(m_Slot, scope));
+	return scope;
+}
+
+void GpuProfiler::End(ID3D12GraphicsCommandList* commandList, UINT scope)
+{
+	if (scope == INVALID_SCOPE)
+	{
+		return;
+	}
+	commandList->EndQuery(m_pQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, QueryIndex(m_Slot, scope) + 1);
+}
+
+void GpuProfiler::Resolve(ID3D12GraphicsCommandList* commandList)
+{
+	auto count = m_ScopeCounts[m_Slot];
+	if (count == 0)
+	{
+		return;
+	}
+
+	auto first = QueryIndex(m_Slot, 0);
+	commandList->ResolveQueryData(m_pQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, first, count * 2,
+		m_pReadbackBuffer.Get(), first * sizeof(UINT64));
+}
+
+void GpuProfiler::ReadSlot(UINT slot)
+{
+	auto count = m_ScopeCounts[slot];
+	if (count == 0 || !m_Clock.Calibrate(m_pQueue))
+	{
+		return;
+	}
+
+	for (UINT i = 0; i < count; i++)
+	{
+		auto index = QueryIndex(slot, i);
+		Profiler::AddGpuEvent(m_Track, m_Names[slot][i], m_Clock.ToCpuTime(m_pTimestamps[index]), m_Clock.ToCpuTime(m_pTimestamps[index + 1]));
+	}
+}
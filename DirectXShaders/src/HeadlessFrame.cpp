@@ -0,0 +1,603 @@
+#include "HeadlessFrame.h"
+#include "ClusteredLighting.h"
+#include "DrawPartitioner.h"
+#include "FrameStats.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <stdio.h>
+
+namespace
+{
+	const uint32_t MinDrawsPerRecordThread = 64;
+	const uint32_t MeshPass = 1;
+	const uint32_t MeshPipeline = 0;
+	const size_t DumpCommands = 24;
+	const RhiCpuDescriptor RenderTarget = { 0x1000 };
+	const RhiCpuDescriptor DepthStencil = { 0x2000 };
+
+	// シェーダーの定数と同じ大きさ（中身は使わない）
+	struct alignas(256) HeadlessTransform
+	{
+		float World[16];
+		float View[16];
+		float Projection[16];
+		float WorldInvTranspose[16];
+	};
+
+	// SceneのViewConstantsと同じく、カメラで決まる定数を1つのバッファに並べる
+	struct HeadlessView
+	{
+		HeadlessTransform Mesh;
+		HeadlessTransform Scene;
+		HeadlessTransform Skybox;
+	};
+
+	// SampleVS.hlslのInstanceDataと同じ並び（3x4の行列が2つ）
+	struct HeadlessInstance
+	{
+		float World[12];
+		float WorldInvTranspose[12];
+	};
+
+	struct HeadlessVertex
+	{
+		float Position[3];
+		float Normal[3];
+		float UV[2];
+	};
+
+	// メッシュごとに大きさの違う箱を作る（面ごとに頂点を分けるので24頂点、36インデックス）
+	void MakeBox(float size, std::vector<HeadlessVertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		vertices.clear();
+		indices.clear();
+		for (int face = 0; face < 6; face++)
+		{
+			auto axis = face / 2;
+			auto sign = (face & 1) ? -1.0f : 1.0f;
+			auto base = static_cast<uint32_t>(vertices.size());
+			for (int corner = 0; corner < 4; corner++)
+			{
+				HeadlessVertex vertex = {};
+				float u = (corner & 1) ? 1.0f : -1.0f;
+				float v = (corner & 2) ? 1.0f : -1.0f;
+				vertex.Position[axis] = sign * size;
+				vertex.Position[(axis + 1) % 3] = u * size;
+				vertex.Position[(axis + 2) % 3] = v * size;
+				vertex.Normal[axis] = sign;
+				vertex.UV[0] = u * 0.5f + 0.5f;
+				vertex.UV[1] = v * 0.5f + 0.5f;
+				vertices.push_back(vertex);
+			}
+			uint32_t quad[6] = { 0, 1, 2, 2, 1, 3 };
+			for (auto index : quad)
+			{
+				indices.push_back(base + index);
+			}
+		}
+	}
+
+	// 物体ごとに位置をずらし、frameだけY軸の周りに回した変換
+	HeadlessInstance MakeInstance(uint32_t object, uint32_t frame)
+	{
+		auto angle = frame * 0.02f;
+		auto c = std::cos(angle);
+		auto s = std::sin(angle);
+		HeadlessInstance instance = {};
+		float rows[12] = { c, 0.0f, s, static_cast<float>(object % 100) * 2.0f, 0.0f, 1.0f, 0.0f, 0.0f, -s, 0.0f, c, -static_cast<float>(object / 100) * 2.0f };
+		memcpy(instance.World, rows, sizeof(rows));
+		// 回転だけなので逆転置は回転そのもの（平行移動の列は使わない）
+		memcpy(instance.WorldInvTranspose, rows, sizeof(rows));
+		instance.WorldInvTranspose[3] = instance.WorldInvTranspose[7] = instance.WorldInvTranspose[11] = 0.0f;
+		return instance;
+	}
+
+	uint64_t MeshKey(uint32_t mesh, uint32_t depth)
+	{
+		return DrawKey::Make(MeshPass, MeshPipeline, mesh % HeadlessFrame::MATERIAL_COUNT, depth, mesh);
+	}
+
+	// パイプラインが変わった時にRecordMeshesが設定し直す呼び出しの数（ルートシグネチャからテクスチャのテーブルまで）
+	const uint32_t MeshPipelineCallCount = 12;
+
+	// Sceneの見積もりと同じ（記録する呼び出しの数）。Recordで実際に記録した数と比べる
+	uint32_t MeshApiCallCount(uint32_t changed)
+	{
+		uint32_t count = 2;
+		if (changed & (DrawKey::FIELD_PASS | DrawKey::FIELD_PIPELINE))
+		{
+			count += MeshPipelineCallCount;
+			changed |= DrawKey::FIELD_MATERIAL;
+		}
+		count += (changed & DrawKey::FIELD_MATERIAL) ? 1 : 0;
+		count += (changed & DrawKey::FIELD_GEOMETRY) ? 2 : 0;
+		return count;
+	}
+}
+
+bool HeadlessFrame::Init(uint32_t meshCount, uint32_t recordThreads, uint32_t movingObjects)
+{
+	meshCount = std::max<uint32_t>(meshCount, 1);
+	m_RecordThreads = std::max<uint32_t>(recordThreads, 1);
+	m_WorkerLists.resize(m_RecordThreads);
+
+	std::vector<HeadlessVertex> vertices;
+	std::vector<uint32_t> indices;
+	for (uint32_t i = 0; i < meshCount; i++)
+	{
+		MakeBox(1.0f + (i % 16) * 0.25f, vertices, indices);
+		m_VertexBuffers.emplace_back(new BasicVertexBuffer<NullBackend>(sizeof(HeadlessVertex) * vertices.size(), sizeof(HeadlessVertex), vertices.data()));
+		m_IndexBuffers.emplace_back(new BasicIndexBuffer<NullBackend>(sizeof(uint32_t) * indices.size(), indices.data()));
+		m_IndexCounts.push_back(static_cast<uint32_t>(indices.size()));
+		if (!m_VertexBuffers.back()->IsValid() || !m_IndexBuffers.back()->IsValid())
+		{
+			printf("メッシュのバッファの生成に失敗\n");
+			return false;
+		}
+	}
+
+	MakeBox(500.0f, vertices, indices);
+	m_pSkyboxVertexBuffer.reset(new BasicVertexBuffer<NullBackend>(sizeof(HeadlessVertex) * vertices.size(), sizeof(HeadlessVertex), vertices.data()));
+	m_pSkyboxIndexBuffer.reset(new BasicIndexBuffer<NullBackend>(sizeof(uint32_t) * indices.size(), indices.data()));
+
+	// 入力レイアウトは要素の数だけを見る
+	RhiInputElementDesc elements[3] = {};
+	elements[0].SemanticName = "POSITION";
+	elements[1].SemanticName = "NORMAL";
+	elements[2].SemanticName = "TEXCOORD";
+	RhiInputLayoutDesc layout = { elements, 3 };
+
+	m_pRootSignature.reset(new BasicRootSignature<NullBackend>(true));
+	m_pSkyboxRootSignature.reset(new BasicRootSignature<NullBackend>(false));
+	m_pPipelineState.reset(new BasicPipelineState<NullBackend>());
+	m_pPipelineState->SetInputLayout(layout);
+	m_pPipelineState->SetRootSignature(m_pRootSignature->Get());
+	m_pPipelineState->SetVertexShader(L"SampleVS.cso");
+	m_pPipelineState->SetPixelShader(L"SamplePS.cso");
+	m_pPipelineState->Create();
+	m_pSkyboxPipelineState.reset(new BasicPipelineState<NullBackend>());
+	m_pSkyboxPipelineState->SetInputLayout(layout);
+	m_pSkyboxPipelineState->SetRootSignature(m_pSkyboxRootSignature->Get());
+	m_pSkyboxPipelineState->SetVertexShader(L"SkyboxVS.cso");
+	m_pSkyboxPipelineState->SetPixelShader(L"SkyboxPS.cso");
+	m_pSkyboxPipelineState->Create();
+	if (!m_pPipelineState->IsValid() || !m_pSkyboxPipelineState->IsValid())
+	{
+		printf("パイプラインステートの生成に失敗\n");
+		return false;
+	}
+
+	m_pDescriptorHeap = NullDevice::CreateDescriptorHeap(MATERIAL_COUNT);
+
+	// 物体はメッシュの順に並べておき、フレームごとには並べ直さない
+	m_Objects.resize(static_cast<size_t>(meshCount) * INSTANCES_PER_MESH);
+	for (uint32_t i = 0; i < m_Objects.size(); i++)
+	{
+		m_Objects[i] = { i % meshCount, 0.0f };
+		m_ObjectQueue.Push(MeshKey(m_Objects[i].Mesh, 0), i);
+	}
+	m_ObjectQueue.Sort();
+
+	// 物体の定数は最初のフレームで全て送る
+	auto objectCount = static_cast<uint32_t>(m_Objects.size());
+	m_MovingObjects = std::min<uint32_t>(movingObjects, objectCount);
+	if (!m_ObjectConstants.Init(objectCount, sizeof(HeadlessInstance)))
+	{
+		return false;
+	}
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		m_ObjectConstants.Write(i, MakeInstance(i, 0));
+	}
+
+	// フレームの定数と、全ての物体の定数とインスタンスごとの物体の番号が入る大きさのリングをスロットごとに持つ
+	m_RingSize = (sizeof(HeadlessInstance) + sizeof(uint32_t)) * m_Objects.size() + RHI_CONSTANT_BUFFER_ALIGNMENT * 4 + sizeof(ClusterConstants);
+	for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++)
+	{
+		m_Rings.emplace_back(new BasicConstantRing<NullBackend>(m_RingSize));
+		m_ViewBuffers.emplace_back(new BasicConstantBuffer<NullBackend>(sizeof(HeadlessView)));
+		if (!m_Rings.back()->IsValid() || !m_ViewBuffers.back()->IsValid())
+		{
+			return false;
+		}
+	}
+	m_ViewVersions.assign(FRAMES_IN_FLIGHT, 0);
+	return true;
+}
+
+// Scene::DrawとBuildMeshQueueと同じく、定数を書いてから同じメッシュの物体を1つの描画にまとめて並べ替える
+void HeadlessFrame::BuildDrawList(uint32_t frame)
+{
+	// GPUが無いので、スロットが回ってきた時には前のフレームは終わっている
+	auto slot = frame % FRAMES_IN_FLIGHT;
+	auto& ring = *m_Rings[slot];
+	ring.Reset();
+
+	// カメラは動かないので、ビューの定数はスロットごとに最初のフレームだけ書く
+	m_ViewUploadBytes = 0;
+	if (m_ViewVersions[slot] != m_ViewVersion)
+	{
+		memset(m_ViewBuffers[slot]->GetPtr(), 0, sizeof(HeadlessView));
+		m_ViewVersions[slot] = m_ViewVersion;
+		m_ViewUploadBytes = sizeof(HeadlessView);
+		FrameStats::Add(STAT_UPLOAD_BYTES, sizeof(HeadlessView));
+	}
+	auto viewAddress = m_ViewBuffers[slot]->GetAddress();
+	m_TransformAddress = viewAddress + offsetof(HeadlessView, Mesh);
+	m_SceneAddress = viewAddress + offsetof(HeadlessView, Scene);
+	m_SkyboxAddress = viewAddress + offsetof(HeadlessView, Skybox);
+	m_ClusterAddress = ring.Push(ClusterConstants{}); // 点光源は無いので、定数もSRVもこれを指す
+
+	// 動かす物体は全体に散らばるように選ぶ（番号が離れているので、多ければ近い物体のコピーがまとまる）
+	auto objectCount = static_cast<uint32_t>(m_Objects.size());
+	for (uint32_t i = 0; i < m_MovingObjects; i++)
+	{
+		auto object = static_cast<uint32_t>(static_cast<uint64_t>(i) * objectCount / m_MovingObjects);
+		m_ObjectConstants.Write(object, MakeInstance(object, frame));
+	}
+	m_ObjectConstants.Upload(&ring);
+
+	// 並べ替えの手間を測るため、カメラが動いた時と同じく物体の深度を毎フレーム変える（ビューの定数は変えない）
+	uint32_t seed = 12345 + frame * 7919;
+	for (auto& object : m_Objects)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		object.Depth = (seed >> 16) / 65535.0f;
+	}
+
+	m_Queue.Clear();
+	m_Batches.clear();
+	m_DrawCosts.clear();
+
+	auto allocation = ring.Allocate(sizeof(uint32_t) * objectCount);
+	if (allocation.Ptr == nullptr)
+	{
+		return;
+	}
+	m_InstanceAddress = allocation.Address;
+	m_InstanceUploadBytes = sizeof(uint32_t) * objectCount;
+	auto pInstances = static_cast<uint32_t*>(allocation.Ptr);
+
+	auto& objects = m_ObjectQueue.Items();
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		auto& object = m_Objects[objects[i].Draw];
+		pInstances[i] = objects[i].Draw;
+
+		auto depth = DrawKey::DepthBucket(object.Depth);
+		if (i == 0 || objects[i].Key != objects[i - 1].Key)
+		{
+			m_Batches.push_back({ object.Mesh, i, 0, depth });
+		}
+
+		auto& batch = m_Batches.back();
+		batch.InstanceCount++;
+		batch.Depth = depth < batch.Depth ? depth : batch.Depth;
+	}
+
+	for (uint32_t i = 0; i < m_Batches.size(); i++)
+	{
+		m_Queue.Push(MeshKey(m_Batches[i].Mesh, m_Batches[i].Depth), i);
+	}
+	m_Queue.Sort();
+
+	m_DrawCosts.resize(m_Queue.Size());
+	auto& items = m_Queue.Items();
+	for (uint32_t i = 0; i < items.size(); i++)
+	{
+		auto changed = i == 0 ? static_cast<uint32_t>(DrawKey::FIELD_ALL) : DrawKey::ChangedFields(items[i - 1].Key, items[i].Key);
+		m_DrawCosts[i] = MeshApiCallCount(changed);
+	}
+}
+
+bool HeadlessFrame::Record()
+{
+	// 物体の定数のコピーはメッシュより前にメインのリストに記録する（Sceneではレンダーグラフのパス）
+	m_MainList.Reset();
+	m_ObjectConstants.RecordCopies(&m_MainList);
+	m_ApiCallCount = static_cast<uint32_t>(m_ObjectConstants.Copies().size());
+	m_ApiElidedCount = 0;
+	m_StateChanges = {};
+
+	// 見積もり（m_DrawCosts）は、リストに記録したメッシュの呼び出し（省略した分も含む）の数と合っていなければならない
+	// リストの最初の描画では全ての状態を設定するので、その描画だけは全て変わった時の数で見積もる
+	bool costsMatched = true;
+	auto checkCosts = [&](uint32_t begin, uint32_t end, uint32_t recordedCalls)
+	{
+		uint32_t estimatedCalls = MeshApiCallCount(DrawKey::FIELD_ALL);
+		for (auto i = begin + 1; i < end; i++)
+		{
+			estimatedCalls += m_DrawCosts[i];
+		}
+		costsMatched &= begin == end ? recordedCalls == 0 : recordedCalls == estimatedCalls;
+	};
+
+	// 1つのリストに収まる数なら分けずにメインのリストに記録する
+	auto ranges = DrawPartitioner::Partition(m_DrawCosts, m_RecordThreads, MinDrawsPerRecordThread);
+	if (ranges.size() <= 1)
+	{
+		CommandListFilter<NullCommandList> commandList(&m_MainList);
+		commandList.OMSetRenderTargets(1, &RenderTarget, FALSE, &DepthStencil);
+		auto callsBefore = commandList.IssuedCount() + commandList.ElidedCount();
+		RecordMeshes(commandList, 0, m_Queue.Size(), &m_StateChanges);
+		checkCosts(0, m_Queue.Size(), commandList.IssuedCount() + commandList.ElidedCount() - callsBefore);
+		m_ApiCallCount += commandList.IssuedCount();
+		m_ApiElidedCount += commandList.ElidedCount();
+	}
+	else
+	{
+		std::vector<uint32_t> rangeCallCounts(ranges.size());
+		std::vector<uint32_t> rangeElidedCounts(ranges.size());
+		std::vector<uint32_t> rangeMeshCalls(ranges.size());
+		std::vector<DrawStateChanges> rangeChanges(ranges.size());
+		DrawPartitioner::Record(ranges, [&](uint32_t index, const DrawRange& range)
+		{
+			auto& list = m_WorkerLists[index];
+			list.Reset();
+			CommandListFilter<NullCommandList> workerList(&list);
+			workerList.OMSetRenderTargets(1, &RenderTarget, FALSE, &DepthStencil);
+			auto callsBefore = workerList.IssuedCount() + workerList.ElidedCount();
+			RecordMeshes(workerList, range.Begin, range.End, &rangeChanges[index]);
+			list.Close();
+			rangeCallCounts[index] = workerList.IssuedCount();
+			rangeElidedCounts[index] = workerList.ElidedCount();
+			rangeMeshCalls[index] = workerList.IssuedCount() + workerList.ElidedCount() - callsBefore;
+		});
+
+		for (uint32_t i = 0; i < ranges.size(); i++)
+		{
+			checkCosts(ranges[i].Begin, ranges[i].End, rangeMeshCalls[i]);
+			m_ApiCallCount += rangeCallCounts[i];
+			m_ApiElidedCount += rangeElidedCounts[i];
+			m_StateChanges.Add(rangeChanges[i]);
+		}
+	}
+	m_RangeCount = static_cast<uint32_t>(std::max<size_t>(ranges.size(), 1));
+
+	// スカイボックスはメインのリストに記録する（メッシュのリストの後に実行する）
+	{
+		CommandListFilter<NullCommandList> commandList(&m_MainList);
+		commandList.OMSetRenderTargets(1, &RenderTarget, FALSE, &DepthStencil);
+		RecordSkybox(commandList);
+		m_ApiCallCount += commandList.IssuedCount();
+		m_ApiElidedCount += commandList.ElidedCount();
+	}
+	m_MainList.Close();
+
+	FrameStats::Add(STAT_API_CALLS, m_ApiCallCount);
+	FrameStats::Add(STAT_STATE_CHANGES, m_StateChanges.Pipeline + m_StateChanges.Material + m_StateChanges.Geometry);
+
+	// 記録したコマンドの数が描画の数と合っているか確かめる（メッシュの描画とスカイボックス）
+	uint32_t drawCommands = m_MainList.Count(NULL_COMMAND_DRAW_INDEXED);
+	uint32_t issuedCommands = static_cast<uint32_t>(m_MainList.Commands().size());
+	for (uint32_t i = 0; m_RangeCount > 1 && i < m_RangeCount; i++)
+	{
+		drawCommands += m_WorkerLists[i].Count(NULL_COMMAND_DRAW_INDEXED);
+		issuedCommands += static_cast<uint32_t>(m_WorkerLists[i].Commands().size());
+	}
+	auto copyCommands = m_MainList.Count(NULL_COMMAND_COPY_BUFFER);
+	return costsMatched && drawCommands == m_Queue.Size() + 1 && issuedCommands == m_ApiCallCount && copyCommands == m_ObjectConstants.Copies().size();
+}
+
+bool HeadlessFrame::ExecuteCopies()
+{
+	// コマンドのアドレスから、コピー先のバッファとリングに詰めた領域の中の位置に戻す
+	auto& staging = m_ObjectConstants.Staging();
+	auto bufferSize = static_cast<uint64_t>(m_ObjectConstants.Count()) * m_ObjectConstants.Stride();
+	auto stagingSize = m_ObjectConstants.GetStats().UploadBytes;
+	auto pDest = static_cast<uint8_t*>(m_ObjectConstants.Resource()->Map());
+	for (auto& command : m_MainList.Commands())
+	{
+		if (command.Type != NULL_COMMAND_COPY_BUFFER)
+		{
+			continue;
+		}
+		auto destOffset = command.Args[0] - m_ObjectConstants.GpuAddress();
+		auto sourceOffset = command.Args[1] - staging.Address;
+		auto size = command.Args[2];
+		if (destOffset + size > bufferSize || sourceOffset + size > stagingSize)
+		{
+			return false;
+		}
+		memcpy(pDest + destOffset, static_cast<const uint8_t*>(staging.Ptr) + sourceOffset, static_cast<size_t>(size));
+	}
+	return memcmp(pDest, m_ObjectConstants.Data(0), static_cast<size_t>(bufferSize)) == 0;
+}
+
+size_t HeadlessFrame::RingPeakBytes() const
+{
+	size_t peak = 0;
+	for (auto& ring : m_Rings)
+	{
+		peak = std::max<size_t>(peak, ring->PeakBytes());
+	}
+	return peak;
+}
+
+// Sceneのバインドレスの記録と同じ呼び出しを発行する
+void HeadlessFrame::RecordMeshes(CommandListFilter<NullCommandList>& commandList, uint32_t begin, uint32_t end, DrawStateChanges* pChanges)
+{
+	auto materialHeap = m_pDescriptorHeap;
+	*pChanges = m_Queue.Submit(begin, end, [&](const DrawItem& item, uint32_t changed)
+	{
+		auto& batch = m_Batches[item.Draw];
+		auto i = batch.Mesh;
+
+		if (changed & (DrawKey::FIELD_PASS | DrawKey::FIELD_PIPELINE))
+		{
+			commandList.SetGraphicsRootSignature(m_pRootSignature->Get());
+			commandList.SetPipelineState(m_pPipelineState->Get());
+			commandList.SetGraphicsRootConstantBufferView(0, m_TransformAddress);
+			commandList.SetGraphicsRootConstantBufferView(2, m_SceneAddress);
+			commandList.SetGraphicsRootShaderResourceView(7, m_ObjectConstants.GpuAddress());
+			commandList.SetGraphicsRootShaderResourceView(11, m_InstanceAddress);
+			commandList.SetGraphicsRootConstantBufferView(8, m_ClusterAddress);
+			commandList.SetGraphicsRootShaderResourceView(9, m_ClusterAddress);
+			commandList.SetGraphicsRootShaderResourceView(10, m_ClusterAddress);
+			commandList.IASetPrimitiveTopology(RHI_TOPOLOGY_TRIANGLELIST);
+			commandList.SetDescriptorHeaps(1, &materialHeap);
+			commandList.SetGraphicsRootDescriptorTable(5, materialHeap->GpuStart);
+			changed |= DrawKey::FIELD_MATERIAL;
+		}
+
+		if (changed & DrawKey::FIELD_MATERIAL)
+		{
+			commandList.SetGraphicsRoot32BitConstant(4, i % MATERIAL_COUNT, 0);
+		}
+
+		if (changed & DrawKey::FIELD_GEOMETRY)
+		{
+			auto vbView = m_VertexBuffers[i]->View();
+			auto ibView = m_IndexBuffers[i]->View();
+			commandList.IASetVertexBuffers(0, 1, &vbView);
+			commandList.IASetIndexBuffer(&ibView);
+		}
+
+		commandList.SetGraphicsRoot32BitConstant(6, batch.FirstInstance, 0);
+		commandList.DrawIndexedInstanced(m_IndexCounts[i], batch.InstanceCount, 0, 0, 0);
+
+		FrameStats::Add(STAT_DRAW_CALLS, 1);
+		FrameStats::Add(STAT_INSTANCES, batch.InstanceCount);
+		FrameStats::Add(STAT_TRIANGLES, static_cast<int64_t>(m_IndexCounts[i] / 3) * batch.InstanceCount);
+	});
+}
+
+void HeadlessFrame::RecordSkybox(CommandListFilter<NullCommandList>& commandList)
+{
+	auto materialHeap = m_pDescriptorHeap;
+	auto vbView = m_pSkyboxVertexBuffer->View();
+	auto ibView = m_pSkyboxIndexBuffer->View();
+
+	commandList.SetGraphicsRootSignature(m_pSkyboxRootSignature->Get());
+	commandList.SetPipelineState(m_pSkyboxPipelineState->Get());
+	commandList.SetGraphicsRootConstantBufferView(0, m_SkyboxAddress);
+	commandList.SetDescriptorHeaps(1, &materialHeap);
+	commandList.SetGraphicsRootDescriptorTable(1, materialHeap->GpuStart);
+	commandList.IASetPrimitiveTopology(RHI_TOPOLOGY_TRIANGLELIST);
+	commandList.IASetVertexBuffers(0, 1, &vbView);
+	commandList.IASetIndexBuffer(&ibView);
+	commandList.DrawIndexedInstanced(36, 1, 0, 0, 0);
+
+	FrameStats::Add(STAT_DRAW_CALLS, 1);
+	FrameStats::Add(STAT_INSTANCES, 1);
+	FrameStats::Add(STAT_TRIANGLES, 12);
+}
+
+bool HeadlessFrame::RunBenchmark(uint32_t meshCount, uint32_t frameCount, uint32_t recordThreads, uint32_t movingObjects)
+{
+	meshCount = std::max<uint32_t>(meshCount, 1);
+	frameCount = std::max<uint32_t>(frameCount, 1);
+
+	auto liveBuffers = NullDevice::LiveBuffers();
+	auto liveBytes = NullDevice::LiveBytes();
+	bool passed = true;
+
+	{
+		HeadlessFrame frame;
+		if (!frame.Init(meshCount, recordThreads, movingObjects))
+		{
+			return false;
+		}
+
+		double totalTime = 0.0;
+		double sortTime = 0.0;
+		double recordTime = 0.0;
+		double minTime = 1e30;
+		double maxTime = 0.0;
+
+		// 全ての物体を送る最初のフレームと、それ以降で分けて数える
+		uint64_t firstUploadBytes = 0;
+		uint64_t viewBytes = 0;
+		uint64_t objectBytes = 0;
+		uint64_t instanceBytes = 0;
+		uint64_t copyCount = 0;
+
+		for (uint32_t i = 0; i < frameCount; i++)
+		{
+			auto frameBegin = Profiler::Now();
+			frame.BuildDrawList(i);
+			auto recordBegin = Profiler::Now();
+			bool matched = frame.Record();
+			auto frameEnd = Profiler::Now();
+
+			if (!frame.ExecuteCopies())
+			{
+				printf("フレーム%u: コピーした物体の定数がCPUの写しと合いません\n", i);
+				passed = false;
+			}
+			auto& objectStats = frame.ObjectConstants().GetStats();
+			if (i == 0)
+			{
+				firstUploadBytes = frame.ViewUploadBytes() + objectStats.UploadBytes + frame.InstanceUploadBytes();
+			}
+			else
+			{
+				viewBytes += frame.ViewUploadBytes();
+				objectBytes += objectStats.UploadBytes;
+				instanceBytes += frame.InstanceUploadBytes();
+				copyCount += objectStats.CopyCount;
+			}
+
+			auto frameTime = static_cast<double>(frameEnd - frameBegin) / 1000000.0;
+			FrameStats::EndFrame(i, frameTime);
+			totalTime += frameTime;
+			sortTime += static_cast<double>(recordBegin - frameBegin) / 1000000.0;
+			recordTime += static_cast<double>(frameEnd - recordBegin) / 1000000.0;
+			minTime = std::min<double>(minTime, frameTime);
+			maxTime = std::max<double>(maxTime, frameTime);
+
+			auto expectedDraws = frame.DrawCount() + 1;
+			if (!matched || FrameStats::Latest().Values[STAT_DRAW_CALLS] != static_cast<int64_t>(expectedDraws))
+			{
+				printf("フレーム%u: 記録したコマンドが合いません (描画 %u, 呼び出し %u)\n", i, expectedDraws, frame.ApiCallCount());
+
+				// 調べられるよう、最初に合わなかったフレームのコマンドだけを書き出す
+				if (passed)
+				{
+					printf("フレーム%uのコマンド (%s):\n", i, frame.RangeCount() > 1 ? "1つ目のワーカーのリスト" : "メインのリスト");
+					frame.FirstList().Dump(std::cout, DumpCommands);
+					std::cout.flush();
+				}
+				passed = false;
+			}
+		}
+
+		if (frame.RingPeakBytes() > frame.RingSize())
+		{
+			printf("定数リングバッファの使用量が大きさを超えています (%zu / %zu bytes)\n", frame.RingPeakBytes(), frame.RingSize());
+			passed = false;
+		}
+
+		auto& changes = frame.StateChanges();
+		printf("ヌルのフレーム: メッシュ %u, 物体 %u, 描画 %u, %uフレーム, 記録 %uスレッド\n",
+			meshCount, frame.ObjectCount(), frame.DrawCount(), frameCount, frame.RangeCount());
+		printf("  CPU: 平均 %.3f ms (最小 %.3f ms, 最大 %.3f ms), 並べ替え %.3f ms, 記録 %.3f ms\n",
+			totalTime / frameCount, minTime, maxTime, sortTime / frameCount, recordTime / frameCount);
+		printf("  呼び出し %u (省略 %u), 切り替え: パイプライン %u, マテリアル %u, ジオメトリ %u\n",
+			frame.ApiCallCount(), frame.ApiElidedCount(), changes.Pipeline, changes.Material, changes.Geometry);
+		auto laterFrames = static_cast<double>(std::max<uint32_t>(frameCount - 1, 1));
+		printf("  定数の送信: 最初のフレーム %llu bytes, 以降の平均 %.0f bytes (ビュー %.0f, 物体 %.0f, インスタンスの番号 %.0f), 物体のコピー %.1f回 (動かす物体 %u個)\n",
+			static_cast<unsigned long long>(firstUploadBytes), (viewBytes + objectBytes + instanceBytes) / laterFrames,
+			viewBytes / laterFrames, objectBytes / laterFrames, instanceBytes / laterFrames, copyCount / laterFrames, std::min<uint32_t>(movingObjects, frame.ObjectCount()));
+		printf("  バッファ %llu個 (%llu bytes), 定数の最大 %zu / %zu bytes\n",
+			static_cast<unsigned long long>(NullDevice::LiveBuffers() - liveBuffers),
+			static_cast<unsigned long long>(NullDevice::LiveBytes() - liveBytes),
+			frame.RingPeakBytes(), frame.RingSize());
+	}
+
+	// 作ったバッファは全て解放されている
+	if (NullDevice::LiveBuffers() != liveBuffers || NullDevice::LiveBytes() != liveBytes)
+	{
+		printf("解放されていないバッファがあります (%llu個, %llu bytes)\n",
+			static_cast<unsigned long long>(NullDevice::LiveBuffers() - liveBuffers),
+			static_cast<unsigned long long>(NullDevice::LiveBytes() - liveBytes));
+		passed = false;
+	}
+
+	printf("ヌルのフレームの確認: %s\n", passed ? "成功" : "失敗");
+	return passed;
+}
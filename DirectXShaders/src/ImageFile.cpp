@@ -0,0 +1,418 @@
+#include "ImageFile.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <stdio.h>
+
+namespace
+{
+	void PutBigEndian(std::vector<uint8_t>& out, uint32_t value)
+	{
+		out.push_back(static_cast<uint8_t>(value >> 24));
+		out.push_back(static_cast<uint8_t>(value >> 16));
+		out.push_back(static_cast<uint8_t>(value >> 8));
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	template<typename T>
+	void PutLittleEndian(std::vector<uint8_t>& out, T value)
+	{
+		uint8_t bytes[sizeof(T)];
+		memcpy(bytes, &value, sizeof(T)); // WindowsもLinuxもリトルエンディアンの前提
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	void PutString(std::vector<uint8_t>& out, const char* text)
+	{
+		out.insert(out.end(), text, text + strlen(text) + 1);
+	}
+
+	// 長さ、種類、データ、CRCの順に書く
+	void PutChunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data)
+	{
+		std::vector<uint8_t> chunk;
+		PutBigEndian(chunk, static_cast<uint32_t>(data.size()));
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		PutBigEndian(chunk, ImageFile::Crc32(chunk.data() + 4, chunk.size() - 4));
+		file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+	}
+
+	float HalfToFloat(uint16_t half)
+	{
+		auto sign = (half >> 15) & 1;
+		auto exponent = (half >> 10) & 0x1f;
+		auto mantissa = half & 0x3ff;
+		float value;
+		if (exponent == 0)
+		{
+			value = std::ldexp(static_cast<float>(mantissa), -24);
+		}
+		else if (exponent == 31)
+		{
+			value = mantissa == 0 ? INFINITY : NAN;
+		}
+		else
+		{
+			value = std::ldexp(static_cast<float>(mantissa + 1024), exponent - 25);
+		}
+		return sign ? -value : value;
+	}
+
+	template<typename T>
+	bool Take(const std::vector<uint8_t>& data, size_t& offset, T* pValue)
+	{
+		if (offset + sizeof(T) > data.size())
+		{
+			return false;
+		}
+		memcpy(pValue, data.data() + offset, sizeof(T));
+		offset += sizeof(T);
+		return true;
+	}
+
+	bool TakeString(const std::vector<uint8_t>& data, size_t& offset, std::string* pText)
+	{
+		auto end = offset;
+		while (end < data.size() && data[end] != 0)
+		{
+			end++;
+		}
+		if (end >= data.size())
+		{
+			return false;
+		}
+		pText->assign(reinterpret_cast<const char*>(data.data() + offset), end - offset);
+		offset = end + 1;
+		return true;
+	}
+}
+
+uint32_t ImageFile::Crc32(const uint8_t* data, size_t size, uint32_t crc)
+{
+	// 表は最初に呼ばれた時に一度だけ作る（関数内のstaticの初期化はスレッドセーフ）
+	struct Table
+	{
+		uint32_t Values[256];
+		Table()
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				auto value = i;
+				for (int bit = 0; bit < 8; bit++)
+				{
+					value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+				}
+				Values[i] = value;
+			}
+		}
+	};
+	static const Table table;
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc = table.Values[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+bool ImageFile::WritePng(const std::filesystem::path& path, uint32_t width, uint32_t height, const std::vector<float>& pixels)
+{
+	if (pixels.size() < static_cast<size_t>(width) * height * 3)
+	{
+		printf("PNGに書き出す画素が足りない\n");
+		return false;
+	}
+
+	// 行ごとにフィルター無し(0)を付けて並べる
+	std::vector<uint8_t> raw;
+	raw.reserve((static_cast<size_t>(width) * 3 + 1) * height);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		raw.push_back(0);
+		for (uint32_t x = 0; x < width * 3; x++)
+		{
+			// R8G8B8A8_UNORMに書く時と同じく、0～1に丸めてから最も近い値にする
+			auto value = pixels[static_cast<size_t>(y) * width * 3 + x];
+			value = value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+			raw.push_back(static_cast<uint8_t>(value * 255.0f + 0.5f));
+		}
+	}
+
+	// zlibの形式で、無圧縮のブロック（最大65535バイト）に分ける
+	std::vector<uint8_t> compressed = { 0x78, 0x01 };
+	for (size_t offset = 0; offset < raw.size(); offset += 65535)
+	{
+		auto length = static_cast<uint16_t>(raw.size() - offset < 65535 ? raw.size() - offset : 65535);
+		compressed.push_back(offset + length >= raw.size() ? 1 : 0);
+		PutLittleEndian<uint16_t>(compressed, length);
+		PutLittleEndian<uint16_t>(compressed, static_cast<uint16_t>(~length));
+		compressed.insert(compressed.end(), raw.begin() + offset, raw.begin() + offset + length);
+	}
+	uint32_t a = 1;
+	uint32_t b = 0;
+	for (auto byte : raw)
+	{
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	PutBigEndian(compressed, (b << 16) | a);
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		printf("画像を書き出せない: %s\n", path.string().c_str());
+		return false;
+	}
+
+	const uint8_t Signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	file.write(reinterpret_cast<const char*>(Signature), sizeof(Signature));
+
+	std::vector<uint8_t> header;
+	PutBigEndian(header, width);
+	PutBigEndian(header, height);
+	header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8ビット、RGB、deflate、フィルター0、インターレース無し
+	PutChunk(file, "IHDR", header);
+	PutChunk(file, "IDAT", compressed);
+	PutChunk(file, "IEND", {});
+	return static_cast<bool>(file);
+}
+
+bool ImageFile::WriteExr(const std::filesystem::path& path, uint32_t width, uint32_t height, const std::vector<float>& pixels)
+{
+	if (pixels.size() < static_cast<size_t>(width) * height * 3)
+	{
+		printf("EXRに書き出す画素が足りない\n");
+		return false;
+	}
+
+	std::vector<uint8_t> out;
+	PutLittleEndian<uint32_t>(out, 20000630); // マジックナンバー
+	PutLittleEndian<uint32_t>(out, 2); // バージョン2、スキャンライン
+
+	// チャンネルは名前の順（B, G, R）に並べる
+	std::vector<uint8_t> channels;
+	for (auto name : { "B", "G", "R" })
+	{
+		PutString(channels, name);
+		PutLittleEndian<int32_t>(channels, 2); // FLOAT
+		PutLittleEndian<uint32_t>(channels, 0); // pLinearと予約
+		PutLittleEndian<int32_t>(channels, 1);
+		PutLittleEndian<int32_t>(channels, 1);
+	}
+	channels.push_back(0);
+
+	auto attribute = [&out](const char* name, const char* type, const std::vector<uint8_t>& value)
+	{
+		PutString(out, name);
+		PutString(out, type);
+		PutLittleEndian<int32_t>(out, static_cast<int32_t>(value.size()));
+		out.insert(out.end(), value.begin(), value.end());
+	};
+	std::vector<uint8_t> window;
+	for (int32_t value : { 0, 0, static_cast<int32_t>(width) - 1, static_cast<int32_t>(height) - 1 })
+	{
+		PutLittleEndian(window, value);
+	}
+	std::vector<uint8_t> one;
+	PutLittleEndian(one, 1.0f);
+	std::vector<uint8_t> center;
+	PutLittleEndian(center, 0.0f);
+	PutLittleEndian(center, 0.0f);
+
+	attribute("channels", "chlist", channels);
+	attribute("compression", "compression", { 0 });
+	attribute("dataWindow", "box2i", window);
+	attribute("displayWindow", "box2i", window);
+	attribute("lineOrder", "lineOrder", { 0 });
+	attribute("pixelAspectRatio", "float", one);
+	attribute("screenWindowCenter", "v2f", center);
+	attribute("screenWindowWidth", "float", one);
+	out.push_back(0);
+
+	// 1行ずつのブロックの位置の表と、行の番号、大きさ、チャンネルごとの値
+	auto lineSize = static_cast<uint64_t>(width) * 3 * sizeof(float);
+	auto tableEnd = out.size() + static_cast<size_t>(height) * sizeof(uint64_t);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		PutLittleEndian<uint64_t>(out, tableEnd + y * (8 + lineSize));
+	}
+	out.reserve(out.size() + height * (8 + lineSize));
+	for (uint32_t y = 0; y < height; y++)
+	{
+		PutLittleEndian<int32_t>(out, static_cast<int32_t>(y));
+		PutLittleEndian<uint32_t>(out, static_cast<uint32_t>(lineSize));
+		for (int channel = 2; channel >= 0; channel--)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				PutLittleEndian(out, pixels[(static_cast<size_t>(y) * width + x) * 3 + channel]);
+			}
+		}
+	}
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		printf("画像を書き出せない: %s\n", path.string().c_str());
+		return false;
+	}
+	file.write(reinterpret_cast<const char*>(out.data()), out.size());
+	return static_cast<bool>(file);
+}
+
+bool ImageFile::ReadExr(const std::filesystem::path& path, uint32_t* pWidth, uint32_t* pHeight, std::vector<float>& pixels)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		printf("画像を読み込めない: %s\n", path.string().c_str());
+		return false;
+	}
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	size_t offset = 0;
+	uint32_t magic = 0;
+	uint32_t version = 0;
+	if (!Take(data, offset, &magic) || !Take(data, offset, &version) || magic != 20000630 || (version & 0xff) != 2 || (version & 0x200) != 0)
+	{
+		printf("EXRのスキャンラインの画像ではない: %s\n", path.string().c_str());
+		return false;
+	}
+
+	struct Channel
+	{
+		std::string Name;
+		int32_t Type;
+	};
+	std::vector<Channel> channels;
+	uint8_t compression = 0xff;
+	int32_t window[4] = {};
+	for (;;)
+	{
+		std::string name;
+		if (!TakeString(data, offset, &name))
+		{
+			return false;
+		}
+		if (name.empty())
+		{
+			break;
+		}
+		std::string type;
+		int32_t size = 0;
+		if (!TakeString(data, offset, &type) || !Take(data, offset, &size) || size < 0 || offset + size > data.size())
+		{
+			return false;
+		}
+
+		auto end = offset + size;
+		if (name == "channels")
+		{
+			std::string channelName;
+			while (offset < end && TakeString(data, offset, &channelName) && !channelName.empty())
+			{
+				Channel channel = { channelName, 0 };
+				Take(data, offset, &channel.Type);
+				offset += 12; // pLinear、予約、サンプリング
+				channels.push_back(channel);
+			}
+		}
+		else if (name == "compression")
+		{
+			compression = data[offset];
+		}
+		else if (name == "dataWindow")
+		{
+			memcpy(window, data.data() + offset, sizeof(window));
+		}
+		offset = end;
+	}
+
+	if (compression != 0)
+	{
+		printf("圧縮したEXRには対応していない: %s\n", path.string().c_str());
+		return false;
+	}
+
+	int rgb[3] = { -1, -1, -1 };
+	size_t pixelSize = 0;
+	for (size_t i = 0; i < channels.size(); i++)
+	{
+		auto& channel = channels[i];
+		if (channel.Type != 1 && channel.Type != 2)
+		{
+			printf("EXRのチャンネルの形式に対応していない: %s\n", channel.Name.c_str());
+			return false;
+		}
+		rgb[0] = channel.Name == "R" ? static_cast<int>(i) : rgb[0];
+		rgb[1] = channel.Name == "G" ? static_cast<int>(i) : rgb[1];
+		rgb[2] = channel.Name == "B" ? static_cast<int>(i) : rgb[2];
+		pixelSize += channel.Type == 1 ? 2 : 4;
+	}
+	if (rgb[0] < 0 || rgb[1] < 0 || rgb[2] < 0)
+	{
+		printf("EXRにRGBのチャンネルが無い: %s\n", path.string().c_str());
+		return false;
+	}
+
+	auto width = static_cast<uint32_t>(window[2] - window[0] + 1);
+	auto height = static_cast<uint32_t>(window[3] - window[1] + 1);
+	pixels.assign(static_cast<size_t>(width) * height * 3, 0.0f);
+
+	// 無圧縮なら1ブロックは1行で、チャンネルごとに1行分の値が並ぶ
+	auto table = offset;
+	for (uint32_t line = 0; line < height; line++)
+	{
+		uint64_t blockOffset = 0;
+		auto entry = table + line * sizeof(uint64_t);
+		int32_t y = 0;
+		uint32_t size = 0;
+		if (!Take(data, entry, &blockOffset) || blockOffset > data.size())
+		{
+			return false;
+		}
+		auto position = static_cast<size_t>(blockOffset);
+		if (!Take(data, position, &y) || !Take(data, position, &size) || size < pixelSize * width || position + size > data.size())
+		{
+			return false;
+		}
+		y -= window[1];
+		if (y < 0 || static_cast<uint32_t>(y) >= height)
+		{
+			continue;
+		}
+
+		for (size_t channel = 0; channel < channels.size(); channel++)
+		{
+			auto half = channels[channel].Type == 1;
+			for (uint32_t x = 0; x < width; x++)
+			{
+				float value = 0.0f;
+				if (half)
+				{
+					uint16_t bits = 0;
+					Take(data, position, &bits);
+					value = HalfToFloat(bits);
+				}
+				else
+				{
+					Take(data, position, &value);
+				}
+				for (int c = 0; c < 3; c++)
+				{
+					if (rgb[c] == static_cast<int>(channel))
+					{
+						pixels[(static_cast<size_t>(y) * width + x) * 3 + c] = value;
+					}
+				}
+			}
+		}
+	}
+
+	*pWidth = width;
+	*pHeight = height;
+	return true;
+}
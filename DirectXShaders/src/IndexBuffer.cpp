@@ -1,56 +1,64 @@
 #include "IndexBuffer.h"
-#include <d3dx12.h>
-#include "Engine.h"
+#include "FrameStats.h"
+#include <cstring>
+#include <stdio.h>
 
-IndexBuffer::IndexBuffer(size_t size, const void* pInitData)
+template<typename Backend>
+BasicIndexBuffer<Backend>::BasicIndexBuffer(size_t size, const void* pInitData)
 {
-	auto prop = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-	D3D12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(size);
-
-	auto hr = g_Engine->Device()->CreateCommittedResource(
-		&prop,
-		D3D12_HEAP_FLAG_NONE,
-		&desc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(m_pBuffer.GetAddressOf())
-	);
-
-	if (FAILED(hr))
+	if (!m_Buffer.Create(size, RHI_HEAP_UPLOAD))
 	{
 		printf("インデックスバッファリソースの生成に失敗\n");
 		return;
 	}
 
 	m_View = {};
-	m_View.BufferLocation = m_pBuffer->GetGPUVirtualAddress();
-	m_View.Format = DXGI_FORMAT_R32_UINT;
+	m_View.BufferLocation = m_Buffer.GpuAddress();
+	m_View.Format = RHI_FORMAT_R32_UINT;
 	m_View.SizeInBytes = static_cast<UINT>(size);
 
 	if(pInitData != nullptr)
 	{
-		void* p;
-		hr = m_pBuffer->Map(0, nullptr, &p);
-
-		if (FAILED(hr))
+		void* p = m_Buffer.Map();
+		if (p == nullptr)
 		{
 			printf("インデックスバッファリソースのマップに失敗\n");
 			return;
 		}
 
 		memcpy(p, pInitData, size);
-		m_pBuffer->Unmap(0, nullptr);
+		m_Buffer.Unmap();
+		FrameStats::Add(STAT_UPLOAD_BYTES, size);
 	}
 
+	FrameStats::Add(STAT_RESOURCE_COUNT, 1);
+	FrameStats::Add(STAT_RESOURCE_BYTES, size);
 	m_IsValid = true;
 }
 
-bool IndexBuffer::IsValid()
+template<typename Backend>
+BasicIndexBuffer<Backend>::~BasicIndexBuffer()
+{
+	if (m_IsValid)
+	{
+		FrameStats::Add(STAT_RESOURCE_COUNT, -1);
+		FrameStats::Add(STAT_RESOURCE_BYTES, -static_cast<int64_t>(m_View.SizeInBytes));
+	}
+}
+
+template<typename Backend>
+bool BasicIndexBuffer<Backend>::IsValid()
 {
 	return m_IsValid;
 }
 
-D3D12_INDEX_BUFFER_VIEW IndexBuffer::View() const
+template<typename Backend>
+RhiIndexBufferView BasicIndexBuffer<Backend>::View() const
 {
 	return m_View;
-}
\ No newline at end of file
+}
+
+template class BasicIndexBuffer<NullBackend>;
+#ifdef RHI_HAS_D3D12
+template class BasicIndexBuffer<D3D12Backend>;
+#endif
@@ -0,0 +1,233 @@
+#include "IndirectCuller.h"
+#include "Engine.h"
+#include <d3dx12.h>
+#include <cstring>
+#include <iterator>
+#include <stdio.h>
+
+using namespace DirectX;
+using namespace IndirectCull;
+
+namespace
+{
+	ComPtr<ID3D12Resource> CreateBuffer(D3D12_HEAP_TYPE heapType, UINT64 size, D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES state)
+	{
+		auto prop = CD3DX12_HEAP_PROPERTIES(heapType);
+		auto desc = CD3DX12_RESOURCE_DESC::Buffer(size, flags);
+
+		ComPtr<ID3D12Resource> pBuffer;
+		auto hr = g_Engine->Device()->CreateCommittedResource(
+			&prop,
+			D3D12_HEAP_FLAG_NONE,
+			&desc,
+			state,
+			nullptr,
+			IID_PPV_ARGS(pBuffer.GetAddressOf())
+		);
+		if (FAILED(hr))
+		{
+			return nullptr;
+		}
+		return pBuffer;
+	}
+}
+
+bool IndirectCuller::Init(ID3D12RootSignature* drawRootSignature, ID3DBlob* cullShader, const std::vector<CullObject>& objects)
+{
+	if (objects.empty() || cullShader == nullptr)
+	{
+		return false;
+	}
+	m_Objects = objects;
+	auto device = g_Engine->Device();
+
+	// カリング用のルートシグネチャ（定数、物体、出力のコマンド、描画数）
+	CD3DX12_ROOT_PARAMETER rootParam[4] = {};
+	rootParam[0].InitAsConstantBufferView(0);
+	rootParam[1].InitAsShaderResourceView(0);
+	rootParam[2].InitAsUnorderedAccessView(0);
+	rootParam[3].InitAsUnorderedAccessView(1);
+
+	D3D12_ROOT_SIGNATURE_DESC rootDesc = {};
+	rootDesc.NumParameters = static_cast<UINT>(std::size(rootParam));
+	rootDesc.pParameters = rootParam;
+
+	ComPtr<ID3DBlob> pBlob;
+	ComPtr<ID3DBlob> pErrorBlob;
+	auto hr = D3D12SerializeRootSignature(&rootDesc, D3D_ROOT_SIGNATURE_VERSION_1, pBlob.GetAddressOf(), pErrorBlob.GetAddressOf());
+	if (FAILED(hr))
+	{
+		printf("カリング用のルートシグネチャのシリアライズに失敗\n");
+		return false;
+	}
+
+	m_pCullRootSignature = g_Engine->PSOCache()->GetRootSignature(pBlob->GetBufferPointer(), pBlob->GetBufferSize());
+	if (m_pCullRootSignature == nullptr)
+	{
+		printf("カリング用のルートシグネチャの生成に失敗\n");
+		return false;
+	}
+
+	D3D12_COMPUTE_PIPELINE_STATE_DESC pipelineDesc = {};
+	pipelineDesc.pRootSignature = m_pCullRootSignature.Get();
+	pipelineDesc.CS = CD3DX12_SHADER_BYTECODE(cullShader);
+	m_pCullPipeline = g_Engine->PSOCache()->GetComputePipeline(pipelineDesc);
+	if (m_pCullPipeline == nullptr)
+	{
+		printf("カリング用のパイプラインステートの生成に失敗\n");
+		return false;
+	}
+
+	// IndirectCommandの並びと同じ順に引数を並べる
+	D3D12_INDIRECT_ARGUMENT_DESC arguments[5] = {};
+	arguments[0].Type = D3D12_INDIRECT_ARGUMENT_TYPE_VERTEX_BUFFER_VIEW;
+	arguments[0].VertexBuffer.Slot = 0;
+	arguments[1].Type = D3D12_INDIRECT_ARGUMENT_TYPE_INDEX_BUFFER_VIEW;
+	arguments[2].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+	arguments[2].Constant.RootParameterIndex = 4;
+	arguments[2].Constant.DestOffsetIn32BitValues = 0;
+	arguments[2].Constant.Num32BitValuesToSet = 1;
+	arguments[3].Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT;
+	arguments[3].Constant.RootParameterIndex = 6;
+	arguments[3].Constant.DestOffsetIn32BitValues = 0;
+	arguments[3].Constant.Num32BitValuesToSet = 1;
+	arguments[4].Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+	D3D12_COMMAND_SIGNATURE_DESC signatureDesc = {};
+	signatureDesc.ByteStride = sizeof(IndirectCommand);
+	signatureDesc.NumArgumentDescs = static_cast<UINT>(std::size(arguments));
+	signatureDesc.pArgumentDescs = arguments;
+
+	// ルート定数を切り替えるので、描画用のルートシグネチャが必要
+	hr = device->CreateCommandSignature(&signatureDesc, drawRootSignature, IID_PPV_ARGS(m_pCommandSignature.GetAddressOf()));
+	if (FAILED(hr))
+	{
+		printf("コマンドシグネチャの生成に失敗\n");
+		return false;
+	}
+
+	auto objectSize = sizeof(CullObject) * m_Objects.size();
+	auto commandSize = sizeof(IndirectCommand) * m_Objects.size();
+
+	m_pObjectBuffer = CreateBuffer(D3D12_HEAP_TYPE_UPLOAD, objectSize, D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_GENERIC_READ);
+	// バッファはCOMMONで作られる。以降の遷移はフレームのレンダーグラフに任せる
+	m_pCommandBuffer = CreateBuffer(D3D12_HEAP_TYPE_DEFAULT, commandSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON);
+	m_pCountBuffer = CreateBuffer(D3D12_HEAP_TYPE_DEFAULT, sizeof(uint32_t), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON);
+	m_pReadbackBuffer = CreateBuffer(D3D12_HEAP_TYPE_READBACK, commandSize + sizeof(uint32_t), D3D12_RESOURCE_FLAG_NONE, D3D12_RESOURCE_STATE_COPY_DEST);
+	if (m_pObjectBuffer == nullptr || m_pCommandBuffer == nullptr || m_pCountBuffer == nullptr || m_pReadbackBuffer == nullptr)
+	{
+		printf("カリング用のバッファの生成に失敗\n");
+		return false;
+	}
+
+	void* p;
+	hr = m_pObjectBuffer->Map(0, nullptr, &p);
+	if (FAILED(hr))
+	{
+		printf("カリング用のバッファのマップに失敗\n");
+		return false;
+	}
+	memcpy(p, m_Objects.data(), objectSize);
+	m_pObjectBuffer->Unmap(0, nullptr);
+
+	return true;
+}
+
+void IndirectCuller::Cull(ID3D12GraphicsCommandList* commandList, D3D12_GPU_VIRTUAL_ADDRESS constants)
+{
+	commandList->SetComputeRootSignature(m_pCullRootSignature.Get());
+	commandList->SetPipelineState(m_pCullPipeline.Get());
+	commandList->SetComputeRootConstantBufferView(0, constants);
+	commandList->SetComputeRootShaderResourceView(1, m_pObjectBuffer->GetGPUVirtualAddress());
+	commandList->SetComputeRootUnorderedAccessView(2, m_pCommandBuffer->GetGPUVirtualAddress());
+	commandList->SetComputeRootUnorderedAccessView(3, m_pCountBuffer->GetGPUVirtualAddress());
+
+	// 出力の順番を物体の順に固定するため、1グループで全ての物体を順に処理する
+	commandList->Dispatch(1, 1, 1);
+}
+
+void IndirectCuller::Draw(ID3D12GraphicsCommandList* commandList)
+{
+	commandList->ExecuteIndirect(m_pCommandSignature.Get(), ObjectCount(), m_pCommandBuffer.Get(), 0, m_pCountBuffer.Get(), 0);
+}
+
+void IndirectCuller::CopyResults(ID3D12GraphicsCommandList* commandList)
+{
+	auto commandSize = sizeof(IndirectCommand) * m_Objects.size();
+	commandList->CopyBufferRegion(m_pReadbackBuffer.Get(), 0, m_pCommandBuffer.Get(), 0, commandSize);
+	commandList->CopyBufferRegion(m_pReadbackBuffer.Get(), commandSize, m_pCountBuffer.Get(), 0, sizeof(uint32_t));
+}
+
+bool IndirectCuller::VerifyResults(const CullConstants& constants, uint32_t* pVisibleCount)
+{
+	std::vector<uint32_t> expected;
+	auto expectedCount = CullOnCpu(constants, m_Objects, expected);
+
+	auto commandSize = sizeof(IndirectCommand) * m_Objects.size();
+	D3D12_RANGE readRange = { 0, commandSize + sizeof(uint32_t) };
+	void* p;
+	auto hr = m_pReadbackBuffer->Map(0, &readRange, &p);
+	if (FAILED(hr))
+	{
+		printf("カリング結果のマップに失敗\n");
+		return false;
+	}
+
+	auto words = static_cast<const uint32_t*>(p);
+	auto count = words[commandSize / sizeof(uint32_t)];
+	bool matched = count == expectedCount && memcmp(words, expected.data(), expected.size() * sizeof(uint32_t)) == 0;
+
+	D3D12_RANGE writeRange = { 0, 0 };
+	m_pReadbackBuffer->Unmap(0, &writeRange);
+
+	*pVisibleCount = count;
+	return matched;
+}
+
+CullConstants IndirectCuller::MakeConstants(FXMMATRIX viewProjection, uint32_t objectCount)
+{
+	// 座標は行ベクトルとしてかけるので、クリップ座標の各成分は転置した行列の行との内積になる
+	auto m = XMMatrixTranspose(viewProjection);
+	XMVECTOR planes[6] =
+	{
+		XMVectorAdd(m.r[3], m.r[0]), // 左
+		XMVectorSubtract(m.r[3], m.r[0]), // 右
+		XMVectorAdd(m.r[3], m.r[1]), // 下
+		XMVectorSubtract(m.r[3], m.r[1]), // 上
+		m.r[2], // 手前（深度は0～1）
+		XMVectorSubtract(m.r[3], m.r[2]), // 奥
+	};
+
+	CullConstants constants = {};
+	for (int i = 0; i < 6; i++)
+	{
+		XMFLOAT4 plane;
+		XMStoreFloat4(&plane, XMPlaneNormalize(planes[i]));
+		constants.Planes[i] = { plane.x, plane.y, plane.z, plane.w };
+	}
+	constants.ObjectCount = objectCount;
+	return constants;
+}
+
+CullObject IndirectCuller::MakeObject(const XMFLOAT3& center, float radius, const IndirectCommand& command)
+{
+	CullObject object = {};
+	object.Sphere = { center.x, center.y, center.z, radius };
+	memcpy(object.Command, &command, sizeof(command));
+	return object;
+}
+
+uint32_t IndirectCuller::CullOnCpu(const CullConstants& constants, const std::vector<CullObject>& objects, std::vector<uint32_t>& commands)
+{
+	commands.clear();
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < constants.ObjectCount && i < objects.size(); i++)
+	{
+		if (IsSphereVisible(constants, objects[i].Sphere))
+		{
+			commands.insert(commands.end(), std::begin(objects[i].Command), std::end(objects[i].Command));
+			count++;
+		}
+	}
+	return count;
+}
@@ -0,0 +1,525 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "Timer.h"
+#include <algorithm>
+#include <memory>
+#include <stdio.h>
+#include <string>
+
+JobSystem* g_JobSystem;
+
+struct Job
+{
+	JobSystem::Function Func;
+	JobCounter* pCounter;
+};
+
+namespace
+{
+	const uint32_t InvalidWorker = UINT32_MAX;
+	const int64_t InitialDequeCapacity = 256; // 2のべき乗
+	const int SpinCountBeforeSleep = 64;
+
+	// 今のスレッドがどのジョブシステムの何番のワーカーか
+	thread_local JobSystem* t_pJobSystem = nullptr;
+	thread_local uint32_t t_WorkerIndex = InvalidWorker;
+}
+
+WorkStealingDeque::WorkStealingDeque()
+{
+	auto pBuffer = new Buffer;
+	pBuffer->Capacity = InitialDequeCapacity;
+	pBuffer->pItems = new std::atomic<Job*>[InitialDequeCapacity];
+	m_pBuffer.store(pBuffer, std::memory_order_relaxed);
+}
+
+WorkStealingDeque::~WorkStealingDeque()
+{
+	m_Retired.push_back(m_pBuffer.load(std::memory_order_relaxed));
+	for (auto pBuffer : m_Retired)
+	{
+		delete[] pBuffer->pItems;
+		delete pBuffer;
+	}
+}
+
+WorkStealingDeque::Buffer* WorkStealingDeque::Grow(Buffer* pOld, int64_t bottom, int64_t top)
+{
+	auto pBuffer = new Buffer;
+	pBuffer->Capacity = pOld->Capacity * 2;
+	pBuffer->pItems = new std::atomic<Job*>[pBuffer->Capacity];
+	for (auto i = top; i < bottom; i++)
+	{
+		pBuffer->Put(i, pOld->Get(i));
+	}
+
+	m_Retired.push_back(pOld);
+	m_pBuffer.store(pBuffer, std::memory_order_release);
+	return pBuffer;
+}
+
+void WorkStealingDeque::Push(Job* pJob)
+{
+	auto bottom = m_Bottom.load(std::memory_order_relaxed);
+	auto top = m_Top.load(std::memory_order_acquire);
+	auto pBuffer = m_pBuffer.load(std::memory_order_relaxed);
+
+	if (bottom - top > pBuffer->Capacity - 1)
+	{
+		pBuffer = Grow(pBuffer, bottom, top);
+	}
+
+	// ジョブの中身はbottomのreleaseで公開し、盗む側のbottomのacquireと対にする
+	// releaseのフェンスと緩いストアでも正しいが、ThreadSanitizerはフェンスを追わないので
+	// Runでの書き込みとExecuteでの読み込みの競合と誤って報告する（x86ではどちらも同じ命令になる）
+	pBuffer->Put(bottom, pJob);
+	m_Bottom.store(bottom + 1, std::memory_order_release);
+}
+
+Job* WorkStealingDeque::Pop()
+{
+	auto bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+	auto pBuffer = m_pBuffer.load(std::memory_order_relaxed);
+	m_Bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	auto top = m_Top.load(std::memory_order_relaxed);
+
+	if (top > bottom)
+	{
+		// 空だった
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	auto pJob = pBuffer->Get(bottom);
+	if (top == bottom)
+	{
+		// 最後の1つは盗む側と取り合いになるので、topを進められた方が取る
+		if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			pJob = nullptr;
+		}
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	return pJob;
+}
+
+Job* WorkStealingDeque::Steal()
+{
+	auto top = m_Top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	auto bottom = m_Bottom.load(std::memory_order_acquire);
+
+	if (top >= bottom)
+	{
+		return nullptr;
+	}
+
+	auto pBuffer = m_pBuffer.load(std::memory_order_acquire);
+	auto pJob = pBuffer->Get(top);
+	if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	{
+		// 他のスレッドに先を越された
+		return nullptr;
+	}
+	return pJob;
+}
+
+bool WorkStealingDeque::IsEmpty() const
+{
+	return m_Bottom.load(std::memory_order_relaxed) <= m_Top.load(std::memory_order_relaxed);
+}
+
+JobSystem::~JobSystem()
+{
+	Shutdown();
+}
+
+void JobSystem::Init(uint32_t workerCount)
+{
+	if (workerCount == 0)
+	{
+		workerCount = std::thread::hardware_concurrency();
+	}
+	if (workerCount == 0)
+	{
+		workerCount = 1;
+	}
+
+	m_Queues.resize(workerCount);
+	for (auto& pQueue : m_Queues)
+	{
+		pQueue = new WorkStealingDeque();
+	}
+
+	// 呼び出したスレッドが0番
+	t_pJobSystem = this;
+	t_WorkerIndex = 0;
+
+	m_IsRunning = true;
+	for (uint32_t i = 1; i < workerCount; i++)
+	{
+		m_Threads.emplace_back(&JobSystem::WorkerMain, this, i);
+	}
+}
+
+void JobSystem::Shutdown()
+{
+	if (m_Queues.empty())
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+		m_IsRunning = false;
+	}
+	m_WakeUp.notify_all();
+
+	for (auto& thread : m_Threads)
+	{
+		thread.join();
+	}
+	m_Threads.clear();
+
+	// 実行されずに残ったジョブは捨てる
+	for (auto pQueue : m_Queues)
+	{
+		while (auto pJob = pQueue->Pop())
+		{
+			delete pJob;
+		}
+		delete pQueue;
+	}
+	m_Queues.clear();
+
+	for (auto pJob : m_Injected)
+	{
+		delete pJob;
+	}
+	m_Injected.clear();
+
+	if (t_pJobSystem == this)
+	{
+		t_pJobSystem = nullptr;
+		t_WorkerIndex = InvalidWorker;
+	}
+}
+
+uint32_t JobSystem::CurrentWorker() const
+{
+	return t_pJobSystem == this ? t_WorkerIndex : InvalidWorker;
+}
+
+void JobSystem::Run(Function func, JobCounter* pCounter)
+{
+	if (pCounter != nullptr)
+	{
+		pCounter->m_Count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Push(new Job{ std::move(func), pCounter });
+}
+
+void JobSystem::RunAfter(JobCounter& dependency, Function func, JobCounter* pCounter)
+{
+	if (pCounter != nullptr)
+	{
+		pCounter->m_Count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	auto pJob = new Job{ std::move(func), pCounter };
+	{
+		std::lock_guard<std::mutex> lock(dependency.m_Mutex);
+		if (dependency.m_Count.load(std::memory_order_acquire) != 0)
+		{
+			dependency.m_Continuations.push_back(pJob);
+			return;
+		}
+	}
+
+	// 既に終わっていたのですぐ投入する
+	Push(pJob);
+}
+
+void JobSystem::Push(Job* pJob)
+{
+	auto worker = CurrentWorker();
+	if (worker != InvalidWorker)
+	{
+		m_Queues[worker]->Push(pJob);
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(m_InjectMutex);
+		m_Injected.push_back(pJob);
+	}
+
+	m_Queued.fetch_add(1, std::memory_order_seq_cst);
+	if (m_Sleeping.load(std::memory_order_seq_cst) > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+		m_WakeUp.notify_one();
+	}
+}
+
+Job* JobSystem::FindJob(uint32_t worker)
+{
+	Job* pJob = nullptr;
+
+	// 自分のキューから（最後に積んだものが一番キャッシュに残っている）
+	if (worker != InvalidWorker)
+	{
+		pJob = m_Queues[worker]->Pop();
+	}
+
+	// ワーカー以外から投入されたもの
+	if (pJob == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(m_InjectMutex);
+		if (!m_Injected.empty())
+		{
+			pJob = m_Injected.back();
+			m_Injected.pop_back();
+		}
+	}
+
+	// 他のワーカーから盗む。毎回同じ相手に偏らないよう自分の次から順に見る
+	if (pJob == nullptr)
+	{
+		auto count = static_cast<uint32_t>(m_Queues.size());
+		auto start = worker != InvalidWorker ? worker + 1 : 0;
+		for (uint32_t i = 0; i < count && pJob == nullptr; i++)
+		{
+			auto victim = (start + i) % count;
+			if (victim != worker)
+			{
+				pJob = m_Queues[victim]->Steal();
+			}
+		}
+		if (pJob != nullptr)
+		{
+			m_Stolen.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	if (pJob != nullptr)
+	{
+		m_Queued.fetch_sub(1, std::memory_order_relaxed);
+	}
+	return pJob;
+}
+
+void JobSystem::Execute(Job* pJob)
+{
+	pJob->Func();
+	m_Executed.fetch_add(1, std::memory_order_relaxed);
+
+	auto pCounter = pJob->pCounter;
+	delete pJob;
+	Finish(pCounter);
+}
+
+void JobSystem::Finish(JobCounter* pCounter)
+{
+	if (pCounter == nullptr)
+	{
+		return;
+	}
+
+	// 待っている側はm_Busyが0になるまで戻らないので、ここでカウンターを触っている間は破棄されない
+	pCounter->m_Busy.fetch_add(1, std::memory_order_seq_cst);
+	if (pCounter->m_Count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		std::vector<Job*> continuations;
+		{
+			std::lock_guard<std::mutex> lock(pCounter->m_Mutex);
+			continuations.swap(pCounter->m_Continuations);
+		}
+		for (auto pJob : continuations)
+		{
+			Push(pJob);
+		}
+	}
+	pCounter->m_Busy.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	auto worker = CurrentWorker();
+	while (!counter.IsDone())
+	{
+		// 待っている間も他のジョブを進める
+		if (auto pJob = FindJob(worker))
+		{
+			Execute(pJob);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::ParallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& func)
+{
+	if (end <= begin)
+	{
+		return;
+	}
+	if (grain == 0)
+	{
+		grain = 1;
+	}
+	if (end - begin <= grain)
+	{
+		func(begin, end);
+		return;
+	}
+
+	// 先頭の塊は自分でやり、残りを投入する（後ろから積むので、盗まれるのは後ろの方の塊になる）
+	JobCounter counter;
+	for (auto chunk = begin + grain; chunk < end; chunk += grain)
+	{
+		auto chunkEnd = end - chunk > grain ? chunk + grain : end;
+		Run([&func, chunk, chunkEnd]() { func(chunk, chunkEnd); }, &counter);
+	}
+
+	func(begin, begin + grain);
+	Wait(counter);
+}
+
+void JobSystem::WorkerMain(uint32_t worker)
+{
+	t_pJobSystem = this;
+	t_WorkerIndex = worker;
+	Profiler::SetThreadName(("Job " + std::to_string(worker)).c_str());
+
+	int idle = 0;
+	while (m_IsRunning.load(std::memory_order_relaxed))
+	{
+		if (auto pJob = FindJob(worker))
+		{
+			Execute(pJob);
+			idle = 0;
+			continue;
+		}
+
+		// しばらく空回りしても仕事が無ければ眠る
+		if (++idle < SpinCountBeforeSleep)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		m_Sleeping.fetch_add(1, std::memory_order_seq_cst);
+		{
+			std::unique_lock<std::mutex> lock(m_SleepMutex);
+			m_WakeUp.wait_for(lock, std::chrono::milliseconds(1), [this]()
+			{
+				return !m_IsRunning || m_Queued.load(std::memory_order_seq_cst) > 0;
+			});
+		}
+		m_Sleeping.fetch_sub(1, std::memory_order_seq_cst);
+		idle = 0;
+	}
+}
+
+bool JobSystem::RunStressTest(uint32_t rounds)
+{
+	// 入れ子のParallelFor: 外側の1要素ごとに内側のParallelForを回す
+	const size_t OuterCount = 64;
+	const size_t InnerCount = 1000;
+	const size_t InnerGrain = 16;
+	// RunAfterの連鎖: 各段は前の段のカウンターが0になってから投入される
+	const uint32_t ChainCount = 16;
+	const uint32_t ChainLength = 32;
+
+	// ParallelForは先頭の塊を呼び出したスレッドで実行するので、ジョブになるのは残りの塊
+	auto chunkJobs = [](size_t count, size_t grain) { return (count + grain - 1) / grain - 1; };
+	const uint64_t NestedJobs = chunkJobs(OuterCount, 1) + OuterCount * chunkJobs(InnerCount, InnerGrain);
+	const uint64_t ChainJobs = ChainCount * ChainLength;
+
+	bool isValid = true;
+	auto executedBefore = ExecutedCount();
+	auto stolenBefore = StolenCount();
+	Timer timer;
+
+	std::vector<uint8_t> visits(OuterCount * InnerCount);
+	for (uint32_t round = 0; round < rounds && isValid; round++)
+	{
+		auto executed = ExecutedCount();
+
+		// 要素ごとに書く場所が違うので、数えるのに排他は要らない
+		std::fill(visits.begin(), visits.end(), uint8_t(0));
+		ParallelFor(0, OuterCount, 1, [&](size_t outerBegin, size_t outerEnd)
+		{
+			for (auto outer = outerBegin; outer < outerEnd; outer++)
+			{
+				auto pVisits = &visits[outer * InnerCount];
+				ParallelFor(0, InnerCount, InnerGrain, [pVisits](size_t begin, size_t end)
+				{
+					for (auto i = begin; i < end; i++)
+					{
+						pVisits[i]++;
+					}
+				});
+			}
+		});
+		auto missed = std::count_if(visits.begin(), visits.end(), [](uint8_t count) { return count != 1; });
+
+		// 連鎖の段は前の段が終わった後にしか実行されないので、進み具合は順に1ずつ増える
+		std::unique_ptr<JobCounter[]> counters(new JobCounter[ChainCount * ChainLength]);
+		std::unique_ptr<std::atomic<uint32_t>[]> progress(new std::atomic<uint32_t>[ChainCount]);
+		std::atomic<uint32_t> outOfOrder = 0;
+		for (uint32_t chain = 0; chain < ChainCount; chain++)
+		{
+			progress[chain].store(0, std::memory_order_relaxed);
+			for (uint32_t step = 0; step < ChainLength; step++)
+			{
+				auto pCounter = &counters[chain * ChainLength + step];
+				auto func = [&progress, &outOfOrder, chain, step]()
+				{
+					if (progress[chain].load(std::memory_order_relaxed) != step)
+					{
+						outOfOrder.fetch_add(1, std::memory_order_relaxed);
+					}
+					progress[chain].store(step + 1, std::memory_order_relaxed);
+				};
+				if (step == 0)
+				{
+					Run(func, pCounter);
+				}
+				else
+				{
+					RunAfter(*(pCounter - 1), func, pCounter);
+				}
+			}
+		}
+		// 最後の段が終わっても、前の段のFinishがまだカウンターを触っているかもしれないので全て待つ
+		for (uint32_t i = 0; i < ChainCount * ChainLength; i++)
+		{
+			Wait(counters[i]);
+		}
+		uint32_t unfinished = 0;
+		for (uint32_t chain = 0; chain < ChainCount; chain++)
+		{
+			unfinished += progress[chain].load(std::memory_order_relaxed) != ChainLength;
+		}
+
+		auto executedJobs = ExecutedCount() - executed;
+		isValid = missed == 0 && outOfOrder.load() == 0 && unfinished == 0 && executedJobs == NestedJobs + ChainJobs;
+		if (!isValid)
+		{
+			printf("  %u回目: 1回ずつでない要素 %zu個, 順序の違う段 %u個, 終わらない連鎖 %u個, 実行したジョブ %llu個 (期待 %llu個)\n",
+				round, static_cast<size_t>(missed), outOfOrder.load(), unfinished,
+				static_cast<unsigned long long>(executedJobs), static_cast<unsigned long long>(NestedJobs + ChainJobs));
+		}
+	}
+
+	printf("ジョブシステムの負荷試験: %s (%uスレッド, %u回, ジョブ %llu個, 盗んだ %llu個, %.1f ms)\n",
+		isValid ? "成功" : "失敗", WorkerCount(), rounds,
+		static_cast<unsigned long long>(ExecutedCount() - executedBefore),
+		static_cast<unsigned long long>(StolenCount() - stolenBefore), timer.GetElapsedTime());
+	return isValid;
+}
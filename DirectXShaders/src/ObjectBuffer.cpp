@@ -0,0 +1,117 @@
+#include "ObjectBuffer.h"
+#include <stdio.h>
+
+template<typename Backend>
+bool BasicObjectBuffer<Backend>::Init(uint32_t count, uint32_t stride)
+{
+	m_IsValid = false;
+	m_Count = count;
+	m_Stride = stride;
+	m_Shadow.assign(static_cast<size_t>(count) * stride, 0);
+	m_Dirty.assign(count, 1);
+	m_Copies.clear();
+	m_Stats = {};
+
+	// コピーでしか書かないので、GPUだけが読み書きするヒープに置く
+	if (!m_Buffer.Create(m_Shadow.size() > 0 ? m_Shadow.size() : stride, RHI_HEAP_DEFAULT))
+	{
+		printf("物体の定数バッファの生成に失敗\n");
+		return false;
+	}
+
+	m_IsValid = true;
+	return true;
+}
+
+template<typename Backend>
+void BasicObjectBuffer<Backend>::MarkAllDirty()
+{
+	m_Dirty.assign(m_Count, 1);
+}
+
+template<typename Backend>
+bool BasicObjectBuffer<Backend>::Upload(BasicConstantRing<Backend>* ring)
+{
+	m_Copies.clear();
+	m_Runs.clear();
+	m_Stats = {};
+
+	// 印の無い物体は8個ずつ飛ばす（動かない物体が大半なら、ほとんどここで終わる）
+	auto pDirty = m_Dirty.data();
+	uint32_t dirtyCount = 0;
+	uint32_t i = 0;
+	while (i < m_Count)
+	{
+		if (i + 8 <= m_Count)
+		{
+			uint64_t flags;
+			memcpy(&flags, pDirty + i, sizeof(flags));
+			if (flags == 0)
+			{
+				i += 8;
+				continue;
+			}
+		}
+		if (pDirty[i] == 0)
+		{
+			i++;
+			continue;
+		}
+
+		// 印の無い物体がMERGE_GAP個より多く続くまでを1つの並びにする
+		Run run = { i, i + 1 };
+		dirtyCount++;
+		for (i++; i < m_Count && i - run.End <= MERGE_GAP; i++)
+		{
+			if (pDirty[i] != 0)
+			{
+				run.End = i + 1;
+				dirtyCount++;
+			}
+		}
+		m_Runs.push_back(run);
+	}
+
+	if (m_Runs.empty())
+	{
+		m_Staging = {};
+		return true;
+	}
+
+	size_t totalBytes = 0;
+	for (auto& run : m_Runs)
+	{
+		totalBytes += static_cast<size_t>(run.End - run.Begin) * m_Stride;
+	}
+
+	// 1つの領域に詰め、並びごとに1回コピーする
+	m_Staging = ring->Allocate(totalBytes);
+	if (m_Staging.Ptr == nullptr)
+	{
+		return false;
+	}
+	m_pSource = ring->Resource();
+
+	auto pStaging = static_cast<uint8_t*>(m_Staging.Ptr);
+	size_t packed = 0;
+	for (auto& run : m_Runs)
+	{
+		auto begin = static_cast<size_t>(run.Begin) * m_Stride;
+		auto size = static_cast<size_t>(run.End - run.Begin) * m_Stride;
+		memcpy(pStaging + packed, m_Shadow.data() + begin, size);
+		memset(pDirty + run.Begin, 0, run.End - run.Begin);
+		m_Copies.push_back({ begin, m_Staging.Offset + packed, size });
+		packed += size;
+		m_Stats.SentObjects += run.End - run.Begin;
+	}
+
+	m_Stats.DirtyObjects = dirtyCount;
+	m_Stats.CopyCount = static_cast<uint32_t>(m_Copies.size());
+	m_Stats.UploadBytes = totalBytes;
+	return true;
+}
+
+template class BasicObjectBuffer<NullBackend>;
+#ifdef RHI_HAS_D3D12
+template class BasicObjectBuffer<D3D12Backend>;
+#endif
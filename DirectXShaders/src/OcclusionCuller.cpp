@@ -0,0 +1,799 @@
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+#include "Timer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <stdio.h>
+
+// SSE2はx64では必ず使えるので、x64のビルドではSSE2で4ピクセルずつ辺の関数を求める（それ以外は1ピクセルずつ）
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define OCCLUSION_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const uint32_t FullMask = 0xffffffffu;
+	// 画面の外にこの倍率まで伸びた三角形はそのままラスタライズし、それより外は切り取る（座標が大きすぎると精度が落ちる）
+	const float GuardBand = 16.0f;
+	const int MaxClipVertices = 3 + 5;
+
+	// 行ベクトルの4x4行列の積（out = a * b）
+	void Multiply(const float a[16], const float b[16], float out[16])
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				out[row * 4 + column] = a[row * 4 + 0] * b[0 * 4 + column] + a[row * 4 + 1] * b[1 * 4 + column]
+					+ a[row * 4 + 2] * b[2 * 4 + column] + a[row * 4 + 3] * b[3 * 4 + column];
+			}
+		}
+	}
+
+	void Transform(const float p[3], const float m[16], float out[4])
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			out[i] = p[0] * m[0 * 4 + i] + p[1] * m[1 * 4 + i] + p[2] * m[2 * 4 + i] + m[3 * 4 + i];
+		}
+	}
+
+	// 切り取りに使うクリップ空間の面までの距離（0以上なら内側）。近い面（z >= 0）と、画面の外のガードバンドの4面
+	float PlaneDistance(const float v[4], int plane)
+	{
+		switch (plane)
+		{
+		case 0: return v[2];
+		case 1: return GuardBand * v[3] - v[0];
+		case 2: return GuardBand * v[3] + v[0];
+		case 3: return GuardBand * v[3] - v[1];
+		default: return GuardBand * v[3] + v[1];
+		}
+	}
+
+	// 多角形を5つの面で順に切り取る（Sutherland-Hodgman）。残った頂点の数を返す
+	int ClipPolygon(float vertices[MaxClipVertices][4], int count)
+	{
+		float scratch[MaxClipVertices][4];
+		for (int plane = 0; plane < 5 && count >= 3; plane++)
+		{
+			int outCount = 0;
+			for (int i = 0; i < count; i++)
+			{
+				auto& a = vertices[i];
+				auto& b = vertices[(i + 1) % count];
+				auto da = PlaneDistance(a, plane);
+				auto db = PlaneDistance(b, plane);
+				if (da >= 0.0f)
+				{
+					memcpy(scratch[outCount++], a, sizeof(a));
+				}
+				if ((da >= 0.0f) != (db >= 0.0f) && outCount < MaxClipVertices)
+				{
+					auto t = da / (da - db);
+					for (int k = 0; k < 4; k++)
+					{
+						scratch[outCount][k] = a[k] + (b[k] - a[k]) * t;
+					}
+					outCount++;
+				}
+			}
+			memcpy(vertices, scratch, sizeof(float) * 4 * outCount);
+			count = outCount;
+		}
+		return count;
+	}
+
+	// タイルの左上が(x0, y0)の時、8x4ピクセルの中心のうち3つの辺の内側にあるものをビットにする（ビットは行 * 8 + 列）
+	// ラスタライズと確認用のラスタライザで丸めが同じになるように、どちらも A * (列 + 0.5) + (A * x0 + B * y + C) の順に求める
+	uint32_t TileCoverage(const float edgeA[3], const float edgeB[3], const float edgeC[3], float x0, float y0)
+	{
+		uint32_t mask = 0;
+#ifdef OCCLUSION_USE_SSE2
+		const __m128 columns0 = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+		const __m128 columns1 = _mm_setr_ps(4.5f, 5.5f, 6.5f, 7.5f);
+		const __m128 zero = _mm_setzero_ps();
+		__m128 offsets0[3];
+		__m128 offsets1[3];
+		for (int k = 0; k < 3; k++)
+		{
+			auto a = _mm_set1_ps(edgeA[k]);
+			offsets0[k] = _mm_mul_ps(a, columns0);
+			offsets1[k] = _mm_mul_ps(a, columns1);
+		}
+		for (int row = 0; row < OcclusionCuller::TILE_HEIGHT; row++)
+		{
+			auto y = y0 + row + 0.5f;
+			__m128 inside0 = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			__m128 inside1 = inside0;
+			for (int k = 0; k < 3; k++)
+			{
+				auto base = _mm_set1_ps(edgeA[k] * x0 + edgeB[k] * y + edgeC[k]);
+				inside0 = _mm_and_ps(inside0, _mm_cmpge_ps(_mm_add_ps(offsets0[k], base), zero));
+				inside1 = _mm_and_ps(inside1, _mm_cmpge_ps(_mm_add_ps(offsets1[k], base), zero));
+			}
+			auto bits = static_cast<uint32_t>(_mm_movemask_ps(inside0) | (_mm_movemask_ps(inside1) << 4));
+			mask |= bits << (row * OcclusionCuller::TILE_WIDTH);
+		}
+#else
+		for (int row = 0; row < OcclusionCuller::TILE_HEIGHT; row++)
+		{
+			auto y = y0 + row + 0.5f;
+			for (int column = 0; column < OcclusionCuller::TILE_WIDTH; column++)
+			{
+				bool inside = true;
+				for (int k = 0; k < 3; k++)
+				{
+					inside = inside && edgeA[k] * (column + 0.5f) + (edgeA[k] * x0 + edgeB[k] * y + edgeC[k]) >= 0.0f;
+				}
+				mask |= inside ? 1u << (row * OcclusionCuller::TILE_WIDTH + column) : 0u;
+			}
+		}
+#endif
+		return mask;
+	}
+
+	// タイルの中の列c0～c1、行r0～r1のピクセルのビット
+	uint32_t RectMask(int32_t c0, int32_t c1, int32_t r0, int32_t r1)
+	{
+		auto rowBits = (0xffu >> (OcclusionCuller::TILE_WIDTH - 1 - (c1 - c0))) << c0;
+		uint32_t mask = 0;
+		for (auto row = r0; row <= r1; row++)
+		{
+			mask |= rowBits << (row * OcclusionCuller::TILE_WIDTH);
+		}
+		return mask;
+	}
+}
+
+void OcclusionCuller::Init(uint32_t width, uint32_t height)
+{
+	m_TilesX = (std::max<uint32_t>(width, 1) + TILE_WIDTH - 1) / TILE_WIDTH;
+	m_TilesY = (std::max<uint32_t>(height, 1) + TILE_HEIGHT - 1) / TILE_HEIGHT;
+	m_Width = m_TilesX * TILE_WIDTH;
+	m_Height = m_TilesY * TILE_HEIGHT;
+	m_BlocksX = (m_TilesX + BLOCK_TILES - 1) / BLOCK_TILES;
+	m_BlocksY = (m_TilesY + BLOCK_TILES - 1) / BLOCK_TILES;
+	m_BandCount = (m_TilesY + BAND_TILE_ROWS - 1) / BAND_TILE_ROWS;
+
+	m_Tiles.resize(m_TilesX * m_TilesY);
+	m_BlockDepths.resize(m_BlocksX * m_BlocksY);
+	m_Bands.resize(m_BandCount);
+
+	float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	BeginFrame(identity);
+}
+
+void OcclusionCuller::BeginFrame(const float viewProjection[16])
+{
+	memcpy(m_ViewProjection, viewProjection, sizeof(m_ViewProjection));
+	for (auto& tile : m_Tiles)
+	{
+		tile = { 0, 1.0f, 0.0f };
+	}
+	for (auto& depth : m_BlockDepths)
+	{
+		depth = 1.0f;
+	}
+	m_Triangles.clear();
+	for (auto& band : m_Bands)
+	{
+		band.clear();
+	}
+	m_Stats = {};
+}
+
+void OcclusionCuller::AddOccluder(const float* positions, size_t vertexCount, size_t stride, const uint32_t* indices, size_t indexCount, const float* world)
+{
+	Timer timer;
+
+	// ワールド行列とビュー射影行列をまとめ、頂点は1回ずつ変換する
+	float matrix[16];
+	if (world != nullptr)
+	{
+		float worldMatrix[16] =
+		{
+			world[0], world[4], world[8], 0.0f,
+			world[1], world[5], world[9], 0.0f,
+			world[2], world[6], world[10], 0.0f,
+			world[3], world[7], world[11], 1.0f,
+		};
+		Multiply(worldMatrix, m_ViewProjection, matrix);
+	}
+	else
+	{
+		memcpy(matrix, m_ViewProjection, sizeof(matrix));
+	}
+
+	m_Clip.resize(vertexCount * 4);
+	auto bytes = reinterpret_cast<const uint8_t*>(positions);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		Transform(reinterpret_cast<const float*>(bytes + stride * i), matrix, &m_Clip[i * 4]);
+	}
+
+	auto width = static_cast<float>(m_Width);
+	auto height = static_cast<float>(m_Height);
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		if (indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount)
+		{
+			continue;
+		}
+
+		// ほとんどの三角形は面の内側にあるので、切り取りは掛かるものだけにする
+		float polygon[MaxClipVertices][4];
+		bool inside = true;
+		for (int k = 0; k < 3; k++)
+		{
+			memcpy(polygon[k], &m_Clip[indices[i + k] * 4], sizeof(polygon[k]));
+			for (int plane = 0; plane < 5; plane++)
+			{
+				inside = inside && PlaneDistance(polygon[k], plane) >= 0.0f;
+			}
+		}
+		auto count = inside ? 3 : ClipPolygon(polygon, 3);
+
+		// 画面の座標（yは下向き）と深度に直し、扇形に三角形に分ける
+		float screen[MaxClipVertices][3];
+		for (int k = 0; k < count; k++)
+		{
+			auto invW = 1.0f / polygon[k][3];
+			screen[k][0] = (polygon[k][0] * invW * 0.5f + 0.5f) * width;
+			screen[k][1] = (0.5f - polygon[k][1] * invW * 0.5f) * height;
+			screen[k][2] = polygon[k][2] * invW;
+		}
+		for (int k = 1; k + 1 < count; k++)
+		{
+			float triangle[3][3];
+			memcpy(triangle[0], screen[0], sizeof(triangle[0]));
+			memcpy(triangle[1], screen[k], sizeof(triangle[1]));
+			memcpy(triangle[2], screen[k + 1], sizeof(triangle[2]));
+			SetupTriangle(triangle);
+		}
+	}
+
+	m_Stats.OccluderTriangles += static_cast<uint32_t>(indexCount / 3);
+	m_Stats.SetupTime += timer.GetElapsedTime();
+}
+
+void OcclusionCuller::SetupTriangle(const float screen[3][3])
+{
+	// 面積が0に近いものは描いても覆うピクセルが無い。裏向きなら辺の向きを逆にする
+	double area = (static_cast<double>(screen[1][0]) - screen[0][0]) * (static_cast<double>(screen[2][1]) - screen[0][1])
+		- (static_cast<double>(screen[2][0]) - screen[0][0]) * (static_cast<double>(screen[1][1]) - screen[0][1]);
+	if (std::fabs(area) < 1e-6)
+	{
+		return;
+	}
+
+	auto minX = std::min<float>(screen[0][0], std::min<float>(screen[1][0], screen[2][0]));
+	auto maxX = std::max<float>(screen[0][0], std::max<float>(screen[1][0], screen[2][0]));
+	auto minY = std::min<float>(screen[0][1], std::min<float>(screen[1][1], screen[2][1]));
+	auto maxY = std::max<float>(screen[0][1], std::max<float>(screen[1][1], screen[2][1]));
+	if (maxX < 0.0f || maxY < 0.0f || minX >= m_Width || minY >= m_Height)
+	{
+		return;
+	}
+
+	Triangle triangle;
+	auto sign = area > 0.0 ? 1.0 : -1.0;
+	for (int k = 0; k < 3; k++)
+	{
+		// 辺(a, b)の関数は向かいの頂点で面積の2倍になる
+		auto& a = screen[(k + 1) % 3];
+		auto& b = screen[(k + 2) % 3];
+		triangle.EdgeA[k] = static_cast<float>(sign * (static_cast<double>(a[1]) - b[1]));
+		triangle.EdgeB[k] = static_cast<float>(sign * (static_cast<double>(b[0]) - a[0]));
+		triangle.EdgeC[k] = static_cast<float>(sign * (static_cast<double>(a[0]) * b[1] - static_cast<double>(a[1]) * b[0]));
+	}
+
+	double dx1 = static_cast<double>(screen[1][0]) - screen[0][0];
+	double dy1 = static_cast<double>(screen[1][1]) - screen[0][1];
+	double dz1 = static_cast<double>(screen[1][2]) - screen[0][2];
+	double dx2 = static_cast<double>(screen[2][0]) - screen[0][0];
+	double dy2 = static_cast<double>(screen[2][1]) - screen[0][1];
+	double dz2 = static_cast<double>(screen[2][2]) - screen[0][2];
+	auto depthA = (dz1 * dy2 - dz2 * dy1) / area;
+	auto depthB = (dx1 * dz2 - dx2 * dz1) / area;
+	triangle.DepthA = static_cast<float>(depthA);
+	triangle.DepthB = static_cast<float>(depthB);
+	triangle.DepthC = static_cast<float>(screen[0][2] - depthA * screen[0][0] - depthB * screen[0][1]);
+	triangle.MinDepth = std::min<float>(screen[0][2], std::min<float>(screen[1][2], screen[2][2]));
+	triangle.MaxDepth = std::max<float>(screen[0][2], std::max<float>(screen[1][2], screen[2][2]));
+
+	triangle.MinTileX = std::max<int32_t>(static_cast<int32_t>(minX), 0) / TILE_WIDTH;
+	triangle.MaxTileX = std::min<int32_t>(static_cast<int32_t>(maxX), m_Width - 1) / TILE_WIDTH;
+	triangle.MinTileY = std::max<int32_t>(static_cast<int32_t>(minY), 0) / TILE_HEIGHT;
+	triangle.MaxTileY = std::min<int32_t>(static_cast<int32_t>(maxY), m_Height - 1) / TILE_HEIGHT;
+
+	auto index = static_cast<uint32_t>(m_Triangles.size());
+	m_Triangles.push_back(triangle);
+	for (auto band = triangle.MinTileY / BAND_TILE_ROWS; band <= triangle.MaxTileY / BAND_TILE_ROWS; band++)
+	{
+		m_Bands[band].push_back(index);
+	}
+	m_Stats.RasterizedTriangles++;
+}
+
+void OcclusionCuller::Rasterize(bool parallel)
+{
+	Timer timer;
+
+	// 帯ごとに書くタイルは重ならないので、ロックは要らない
+	if (parallel && g_JobSystem != nullptr)
+	{
+		g_JobSystem->ParallelFor(0, m_BandCount, 1, [this](size_t begin, size_t end)
+		{
+			for (auto band = begin; band < end; band++)
+			{
+				RasterizeBand(static_cast<uint32_t>(band));
+			}
+		});
+	}
+	else
+	{
+		for (uint32_t band = 0; band < m_BandCount; band++)
+		{
+			RasterizeBand(band);
+		}
+	}
+
+	// 階層の上の段を作る
+	for (uint32_t by = 0; by < m_BlocksY; by++)
+	{
+		for (uint32_t bx = 0; bx < m_BlocksX; bx++)
+		{
+			auto depth = 0.0f;
+			for (auto ty = by * BLOCK_TILES; ty < std::min<uint32_t>((by + 1) * BLOCK_TILES, m_TilesY); ty++)
+			{
+				for (auto tx = bx * BLOCK_TILES; tx < std::min<uint32_t>((bx + 1) * BLOCK_TILES, m_TilesX); tx++)
+				{
+					depth = std::max<float>(depth, m_Tiles[ty * m_TilesX + tx].Z0);
+				}
+			}
+			m_BlockDepths[by * m_BlocksX + bx] = depth;
+		}
+	}
+
+	m_Stats.RasterizeTime += timer.GetElapsedTime();
+}
+
+void OcclusionCuller::RasterizeBand(uint32_t band)
+{
+	auto minTileY = static_cast<int32_t>(band * BAND_TILE_ROWS);
+	auto maxTileY = std::min<int32_t>(minTileY + BAND_TILE_ROWS, m_TilesY) - 1;
+	// 手前の三角形から描くと、奥の三角形は埋まったタイルで早く捨てられる（遮蔽物を足す順によらない）
+	auto& indices = m_Bands[band];
+	std::sort(indices.begin(), indices.end(), [this](uint32_t a, uint32_t b) { return m_Triangles[a].MinDepth < m_Triangles[b].MinDepth; });
+	for (auto index : indices)
+	{
+		auto& triangle = m_Triangles[index];
+		RasterizeTriangle(triangle, std::max<int32_t>(triangle.MinTileY, minTileY), std::min<int32_t>(triangle.MaxTileY, maxTileY));
+	}
+}
+
+void OcclusionCuller::RasterizeTriangle(const Triangle& triangle, int32_t minTileY, int32_t maxTileY)
+{
+	for (auto ty = minTileY; ty <= maxTileY; ty++)
+	{
+		auto y0 = static_cast<float>(ty * TILE_HEIGHT);
+		for (auto tx = triangle.MinTileX; tx <= triangle.MaxTileX; tx++)
+		{
+			// 三角形の一番手前でもタイル全体の境界より奥なら、何も変わらない
+			auto& tile = m_Tiles[ty * m_TilesX + tx];
+			if (triangle.MinDepth >= tile.Z0)
+			{
+				continue;
+			}
+
+			// 辺の関数は1次式なので、タイルの隅のピクセルで調べれば、全て外か全て内側かが分かる
+			auto x0 = static_cast<float>(tx * TILE_WIDTH);
+			bool outside = false;
+			bool covered = true;
+			for (int k = 0; k < 3; k++)
+			{
+				auto nearColumn = triangle.EdgeA[k] > 0.0f ? TILE_WIDTH - 0.5f : 0.5f;
+				auto nearY = y0 + (triangle.EdgeB[k] > 0.0f ? TILE_HEIGHT - 0.5f : 0.5f);
+				auto farColumn = TILE_WIDTH - nearColumn;
+				auto farY = y0 + TILE_HEIGHT - (nearY - y0);
+				outside = outside || triangle.EdgeA[k] * nearColumn + (triangle.EdgeA[k] * x0 + triangle.EdgeB[k] * nearY + triangle.EdgeC[k]) < 0.0f;
+				covered = covered && triangle.EdgeA[k] * farColumn + (triangle.EdgeA[k] * x0 + triangle.EdgeB[k] * farY + triangle.EdgeC[k]) >= 0.0f;
+			}
+			if (outside)
+			{
+				continue;
+			}
+			auto coverage = covered ? FullMask : TileCoverage(triangle.EdgeA, triangle.EdgeB, triangle.EdgeC, x0, y0);
+			if (coverage == 0)
+			{
+				continue;
+			}
+
+			// タイルの中での三角形の一番奥は、平面の四隅での値の最大（三角形の頂点の最大を超えない）
+			auto x = triangle.DepthA > 0.0f ? x0 + TILE_WIDTH : x0;
+			auto y = triangle.DepthB > 0.0f ? y0 + TILE_HEIGHT : y0;
+			auto depth = std::min<float>(triangle.DepthA * x + triangle.DepthB * y + triangle.DepthC, triangle.MaxDepth);
+			UpdateTile(tile, coverage, depth);
+		}
+	}
+}
+
+void OcclusionCuller::UpdateTile(Tile& tile, uint32_t coverage, float depth)
+{
+	if (depth >= tile.Z0)
+	{
+		return;
+	}
+
+	// 三角形が作業中の層よりずっと手前なら（Z0よりZ1から遠ければ）作業中の層を捨てて三角形から始め直し、そうでなければ合わせる
+	// 捨てた層のピクセルはZ0に戻るだけなので、どちらを選んでも境界は奥側のまま
+	if (tile.Mask == 0 || tile.Z1 - depth > tile.Z0 - tile.Z1)
+	{
+		tile.Mask = coverage;
+		tile.Z1 = depth;
+	}
+	else
+	{
+		tile.Mask |= coverage;
+		tile.Z1 = std::max<float>(tile.Z1, depth);
+	}
+
+	// タイルが埋まったら、作業中の層をタイル全体の境界に畳み込む
+	if (tile.Mask == FullMask)
+	{
+		tile.Z0 = std::min<float>(tile.Z0, tile.Z1);
+		tile.Mask = 0;
+		tile.Z1 = 0.0f;
+	}
+}
+
+float OcclusionCuller::TileDepthBound(const Tile& tile, uint32_t pixels) const
+{
+	return tile.Mask != 0 && (pixels & ~tile.Mask) == 0 ? std::min<float>(tile.Z0, tile.Z1) : tile.Z0;
+}
+
+bool OcclusionCuller::ProjectBounds(const OcclusionBounds& bounds, ScreenRect* pRect) const
+{
+	auto minX = FLT_MAX;
+	auto maxX = -FLT_MAX;
+	auto minY = FLT_MAX;
+	auto maxY = -FLT_MAX;
+	auto nearDepth = FLT_MAX;
+	for (int corner = 0; corner < 8; corner++)
+	{
+		float p[3] =
+		{
+			(corner & 1) ? bounds.Max[0] : bounds.Min[0],
+			(corner & 2) ? bounds.Max[1] : bounds.Min[1],
+			(corner & 4) ? bounds.Max[2] : bounds.Min[2],
+		};
+		float clip[4];
+		Transform(p, m_ViewProjection, clip);
+
+		// 近い面より手前に掛かる物は判定しない
+		if (clip[2] < 0.0f || clip[3] <= 0.0f)
+		{
+			return false;
+		}
+		auto invW = 1.0f / clip[3];
+		auto x = (clip[0] * invW * 0.5f + 0.5f) * m_Width;
+		auto y = (0.5f - clip[1] * invW * 0.5f) * m_Height;
+		minX = std::min<float>(minX, x);
+		maxX = std::max<float>(maxX, x);
+		minY = std::min<float>(minY, y);
+		maxY = std::max<float>(maxY, y);
+		nearDepth = std::min<float>(nearDepth, clip[2] * invW);
+	}
+
+	// 画面の外の物は視錐台カリングに任せる
+	if (maxX < 0.0f || maxY < 0.0f || minX >= m_Width || minY >= m_Height)
+	{
+		return false;
+	}
+
+	// 箱が少しでも掛かるピクセルは全て調べる
+	pRect->MinX = std::max<int32_t>(static_cast<int32_t>(std::floor(minX)), 0);
+	pRect->MaxX = std::min<int32_t>(static_cast<int32_t>(std::floor(maxX)), m_Width - 1);
+	pRect->MinY = std::max<int32_t>(static_cast<int32_t>(std::floor(minY)), 0);
+	pRect->MaxY = std::min<int32_t>(static_cast<int32_t>(std::floor(maxY)), m_Height - 1);
+	pRect->NearDepth = nearDepth;
+	return true;
+}
+
+bool OcclusionCuller::IsOccluded(const OcclusionBounds& bounds) const
+{
+	ScreenRect rect;
+	if (!ProjectBounds(bounds, &rect))
+	{
+		return false;
+	}
+
+	auto minTileX = rect.MinX / TILE_WIDTH;
+	auto maxTileX = rect.MaxX / TILE_WIDTH;
+	auto minTileY = rect.MinY / TILE_HEIGHT;
+	auto maxTileY = rect.MaxY / TILE_HEIGHT;
+	for (auto by = minTileY / BLOCK_TILES; by <= maxTileY / BLOCK_TILES; by++)
+	{
+		for (auto bx = minTileX / BLOCK_TILES; bx <= maxTileX / BLOCK_TILES; bx++)
+		{
+			// ブロックの一番奥より奥なら、このブロックに掛かる部分は隠れている
+			if (rect.NearDepth > m_BlockDepths[by * m_BlocksX + bx])
+			{
+				continue;
+			}
+
+			for (auto ty = std::max<int32_t>(minTileY, by * BLOCK_TILES); ty <= std::min<int32_t>(maxTileY, by * BLOCK_TILES + BLOCK_TILES - 1); ty++)
+			{
+				for (auto tx = std::max<int32_t>(minTileX, bx * BLOCK_TILES); tx <= std::min<int32_t>(maxTileX, bx * BLOCK_TILES + BLOCK_TILES - 1); tx++)
+				{
+					auto pixels = RectMask(
+						std::max<int32_t>(rect.MinX - tx * TILE_WIDTH, 0), std::min<int32_t>(rect.MaxX - tx * TILE_WIDTH, TILE_WIDTH - 1),
+						std::max<int32_t>(rect.MinY - ty * TILE_HEIGHT, 0), std::min<int32_t>(rect.MaxY - ty * TILE_HEIGHT, TILE_HEIGHT - 1));
+					if (rect.NearDepth <= TileDepthBound(m_Tiles[ty * m_TilesX + tx], pixels))
+					{
+						return false;
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+bool OcclusionCuller::IsSphereOccluded(const float center[3], float radius) const
+{
+	OcclusionBounds bounds =
+	{
+		{ center[0] - radius, center[1] - radius, center[2] - radius },
+		{ center[0] + radius, center[1] + radius, center[2] + radius },
+	};
+	return IsOccluded(bounds);
+}
+
+float OcclusionCuller::PixelDepthBound(uint32_t x, uint32_t y) const
+{
+	auto& tile = m_Tiles[(y / TILE_HEIGHT) * m_TilesX + x / TILE_WIDTH];
+	return TileDepthBound(tile, 1u << ((y % TILE_HEIGHT) * TILE_WIDTH + x % TILE_WIDTH));
+}
+
+void OcclusionCuller::MakeCity(uint32_t blocks, uint32_t seed, TestScene* pScene)
+{
+	// 1区画は42m四方で、真ん中に30m四方の建物を建て、周りを12mの通りにする
+	const float BlockPitch = 42.0f;
+	const float BuildingSize = 30.0f;
+	const uint32_t PropsPerBlock = 6;
+	auto random = [&seed]()
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8 & 0xffff) / 65535.0f;
+	};
+
+	auto& positions = pScene->Positions;
+	auto& indices = pScene->Indices;
+	auto& objects = pScene->Objects;
+	positions.clear();
+	indices.clear();
+	objects.clear();
+
+	auto addBox = [&](const OcclusionBounds& box, bool occluder)
+	{
+		objects.push_back(box);
+		if (!occluder)
+		{
+			return;
+		}
+		auto base = static_cast<uint32_t>(positions.size() / 3);
+		for (int corner = 0; corner < 8; corner++)
+		{
+			positions.push_back((corner & 1) ? box.Max[0] : box.Min[0]);
+			positions.push_back((corner & 2) ? box.Max[1] : box.Min[1]);
+			positions.push_back((corner & 4) ? box.Max[2] : box.Min[2]);
+		}
+		// 6面を2つずつの三角形にする（底は見えないが、数を揃えるために含める）
+		const uint32_t Faces[6][4] = { { 0, 2, 6, 4 }, { 1, 5, 7, 3 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 1, 3, 2 }, { 4, 6, 7, 5 } };
+		for (auto& face : Faces)
+		{
+			for (auto index : { face[0], face[1], face[2], face[0], face[2], face[3] })
+			{
+				indices.push_back(base + index);
+			}
+		}
+	};
+
+	// 建物を先に並べる（Objectsの先頭のblocks * blocks個が建物）
+	auto half = blocks * BlockPitch * 0.5f;
+	for (uint32_t z = 0; z < blocks; z++)
+	{
+		for (uint32_t x = 0; x < blocks; x++)
+		{
+			auto left = x * BlockPitch - half + (BlockPitch - BuildingSize) * 0.5f;
+			auto front = z * BlockPitch - half + (BlockPitch - BuildingSize) * 0.5f;
+			auto height = 10.0f + random() * 50.0f;
+			addBox({ { left, 0.0f, front }, { left + BuildingSize, height, front + BuildingSize } }, true);
+		}
+	}
+
+	// 区画の周りの通りに車くらいの大きさの小物を置く
+	for (uint32_t z = 0; z < blocks; z++)
+	{
+		for (uint32_t x = 0; x < blocks; x++)
+		{
+			for (uint32_t i = 0; i < PropsPerBlock; i++)
+			{
+				auto along = random() * (BlockPitch - 2.0f);
+				auto across = 1.0f + random() * 3.0f;
+				auto alongX = random() < 0.5f;
+				auto px = x * BlockPitch - half + (alongX ? along : across);
+				auto pz = z * BlockPitch - half + (alongX ? across : along);
+				addBox({ { px, 0.0f, pz }, { px + 2.0f, 1.5f, pz + 2.0f } }, false);
+			}
+		}
+	}
+
+	// 街の端の通りから、斜め奥を見る（人の目の高さ）
+	auto streetX = -half + BlockPitch * 2.0f + (BlockPitch - BuildingSize) * 0.25f;
+	float eye[3] = { streetX, 1.7f, half + 5.0f };
+	float target[3] = { streetX + half * 0.5f, 1.7f, -half };
+
+	// XMMatrixLookAtRHとXMMatrixPerspectiveFovRHと同じ行列
+	float forward[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+	auto length = std::sqrt(forward[0] * forward[0] + forward[1] * forward[1] + forward[2] * forward[2]);
+	float zAxis[3] = { -forward[0] / length, -forward[1] / length, -forward[2] / length };
+	float up[3] = { 0.0f, 1.0f, 0.0f };
+	float xAxis[3] = { up[1] * zAxis[2] - up[2] * zAxis[1], up[2] * zAxis[0] - up[0] * zAxis[2], up[0] * zAxis[1] - up[1] * zAxis[0] };
+	length = std::sqrt(xAxis[0] * xAxis[0] + xAxis[1] * xAxis[1] + xAxis[2] * xAxis[2]);
+	for (auto& value : xAxis)
+	{
+		value /= length;
+	}
+	float yAxis[3] = { zAxis[1] * xAxis[2] - zAxis[2] * xAxis[1], zAxis[2] * xAxis[0] - zAxis[0] * xAxis[2], zAxis[0] * xAxis[1] - zAxis[1] * xAxis[0] };
+	auto dot = [&eye](const float axis[3]) { return axis[0] * eye[0] + axis[1] * eye[1] + axis[2] * eye[2]; };
+	float view[16] =
+	{
+		xAxis[0], yAxis[0], zAxis[0], 0.0f,
+		xAxis[1], yAxis[1], zAxis[1], 0.0f,
+		xAxis[2], yAxis[2], zAxis[2], 0.0f,
+		-dot(xAxis), -dot(yAxis), -dot(zAxis), 1.0f,
+	};
+
+	const float NearZ = 0.3f;
+	const float FarZ = 1000.0f;
+	auto yScale = 1.0f / std::tan(3.14159265f / 6.0f);
+	auto xScale = yScale / (static_cast<float>(DEFAULT_WIDTH) / DEFAULT_HEIGHT);
+	auto range = FarZ / (NearZ - FarZ);
+	float projection[16] =
+	{
+		xScale, 0.0f, 0.0f, 0.0f,
+		0.0f, yScale, 0.0f, 0.0f,
+		0.0f, 0.0f, range, -1.0f,
+		0.0f, 0.0f, range * NearZ, 0.0f,
+	};
+	Multiply(view, projection, pScene->ViewProjection);
+}
+
+bool OcclusionCuller::RunBenchmark(uint32_t blocks, int iterations)
+{
+	TestScene scene;
+	MakeCity(blocks, 12345, &scene);
+	auto vertexCount = scene.Positions.size() / 3;
+	auto buildingCount = static_cast<uint32_t>(scene.Indices.size() / 36);
+	auto objectCount = static_cast<uint32_t>(scene.Objects.size());
+
+	OcclusionCuller culler;
+	culler.Init(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+
+	// 並列と1スレッドでラスタライズし、判定はどちらも同じ結果になる
+	double setupTime = 0.0;
+	double rasterizeTime[2] = {};
+	double testTime = 0.0;
+	std::vector<uint8_t> occluded(objectCount);
+	uint32_t occludedCount = 0;
+	bool matched = true;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (int i = 0; i < iterations; i++)
+		{
+			culler.BeginFrame(scene.ViewProjection);
+			culler.AddOccluder(scene.Positions.data(), vertexCount, sizeof(float) * 3, scene.Indices.data(), scene.Indices.size(), nullptr);
+			culler.Rasterize(pass == 0);
+			rasterizeTime[pass] += culler.GetStats().RasterizeTime;
+			setupTime += culler.GetStats().SetupTime;
+
+			Timer timer;
+			uint32_t count = 0;
+			for (uint32_t object = 0; object < objectCount; object++)
+			{
+				bool result = culler.IsOccluded(scene.Objects[object]);
+				if (pass == 0 && i == 0)
+				{
+					occluded[object] = result;
+				}
+				matched = matched && occluded[object] == result;
+				count += result ? 1 : 0;
+			}
+			testTime += timer.GetElapsedTime();
+			occludedCount = count;
+		}
+	}
+
+	// ピクセルごとに一番手前の深度を持つ確認用のラスタライザ（同じ三角形を、同じ辺の関数で塗る）
+	std::vector<float> reference(culler.m_Width * culler.m_Height, 1.0f);
+	for (auto& triangle : culler.m_Triangles)
+	{
+		for (auto ty = triangle.MinTileY; ty <= triangle.MaxTileY; ty++)
+		{
+			for (auto tx = triangle.MinTileX; tx <= triangle.MaxTileX; tx++)
+			{
+				auto x0 = static_cast<float>(tx * TILE_WIDTH);
+				auto y0 = static_cast<float>(ty * TILE_HEIGHT);
+				for (int row = 0; row < TILE_HEIGHT; row++)
+				{
+					auto y = y0 + row + 0.5f;
+					for (int column = 0; column < TILE_WIDTH; column++)
+					{
+						bool inside = true;
+						for (int k = 0; k < 3; k++)
+						{
+							inside = inside && triangle.EdgeA[k] * (column + 0.5f) + (triangle.EdgeA[k] * x0 + triangle.EdgeB[k] * y + triangle.EdgeC[k]) >= 0.0f;
+						}
+						if (inside)
+						{
+							auto depth = triangle.DepthA * (x0 + column + 0.5f) + triangle.DepthB * y + triangle.DepthC;
+							auto& pixel = reference[(ty * TILE_HEIGHT + row) * culler.m_Width + tx * TILE_WIDTH + column];
+							pixel = std::min<float>(pixel, std::min<float>(depth, triangle.MaxDepth));
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// 隠れていると判定した物は、確認用のバッファでも掛かる全てのピクセルで遮蔽物より奥にある
+	uint32_t wrongCount = 0;
+	uint32_t boundViolations = 0;
+	uint32_t occludedBuildings = 0;
+	uint32_t referenceOccluded = 0;
+	for (uint32_t object = 0; object < objectCount; object++)
+	{
+		ScreenRect rect;
+		if (!culler.ProjectBounds(scene.Objects[object], &rect))
+		{
+			continue;
+		}
+		bool hidden = true;
+		for (auto y = rect.MinY; y <= rect.MaxY; y++)
+		{
+			for (auto x = rect.MinX; x <= rect.MaxX; x++)
+			{
+				hidden = hidden && rect.NearDepth > reference[y * culler.m_Width + x];
+			}
+		}
+		referenceOccluded += hidden ? 1 : 0;
+		wrongCount += occluded[object] && !hidden ? 1 : 0;
+		occludedBuildings += occluded[object] && object < buildingCount ? 1 : 0;
+	}
+	for (uint32_t y = 0; y < culler.m_Height; y++)
+	{
+		for (uint32_t x = 0; x < culler.m_Width; x++)
+		{
+			boundViolations += culler.PixelDepthBound(x, y) < reference[y * culler.m_Width + x] ? 1 : 0;
+		}
+	}
+
+	auto& stats = culler.GetStats();
+	printf("オクルージョンカリング: 建物 %u個 (三角形 %u, ラスタライズ %u), 判定 %u個, バッファ %ux%u, %d回の平均\n",
+		buildingCount, stats.OccluderTriangles, stats.RasterizedTriangles, objectCount, culler.m_Width, culler.m_Height, iterations);
+	printf("  変換と準備: %.3f ms\n", setupTime / (iterations * 2));
+	printf("  ラスタライズ: %.3f ms (%uスレッド), %.3f ms (1スレッド)\n",
+		rasterizeTime[0] / iterations, g_JobSystem != nullptr ? g_JobSystem->WorkerCount() : 1, rasterizeTime[1] / iterations);
+	printf("  判定: %.3f ms (1個あたり %.1f ns)\n", testTime / (iterations * 2), testTime / (iterations * 2) / objectCount * 1e6);
+	printf("  隠れている物: %u個 / %u個 (%.1f%%, 建物 %u個), ピクセルごとの深度での判定 %u個\n",
+		occludedCount, objectCount, 100.0 * occludedCount / objectCount, occludedBuildings, referenceOccluded);
+	printf("  並列と1スレッドの結果: %s, 見える物を隠れていると判定: %u個, 奥側の境界より手前の遮蔽物: %uピクセル\n",
+		matched ? "一致" : "不一致", wrongCount, boundViolations);
+	return matched && wrongCount == 0 && boundViolations == 0;
+}
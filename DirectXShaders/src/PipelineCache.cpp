@@ -0,0 +1,290 @@
+#include "PipelineCache.h"
+#include "Hash.h"
+#include "Timer.h"
+#include <dxgi1_4.h>
+#include <fstream>
+#include <stdio.h>
+
+namespace
+{
+	const uint32_t LibraryFileMagic = 0x4C4F5350; // 'PSOL'
+	const uint32_t LibraryFileVersion = 2;
+}
+
+bool PipelineCache::Init(ID3D12Device1* device, const wchar_t* path)
+{
+	m_pDevice = device;
+	m_Path = path;
+	m_DriverHash = QueryDriverHash(device);
+
+	if (!m_IsEnabled)
+	{
+		return true;
+	}
+
+	if (!LoadFromFile())
+	{
+		// 読み込めない場合は空のライブラリから始める
+		m_LibraryData.clear();
+		auto hr = m_pDevice->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(m_pLibrary.ReleaseAndGetAddressOf()));
+		if (FAILED(hr))
+		{
+			printf("パイプラインライブラリの生成に失敗（ファイルへの保存は行いません）\n");
+			m_pLibrary = nullptr;
+		}
+	}
+
+	return true;
+}
+
+uint64_t PipelineCache::QueryDriverHash(ID3D12Device1* device)
+{
+	Hasher hasher;
+	auto luid = device->GetAdapterLuid();
+	hasher.Add(luid);
+
+	ComPtr<IDXGIFactory4> pFactory;
+	if (FAILED(CreateDXGIFactory1(IID_PPV_ARGS(pFactory.GetAddressOf()))))
+	{
+		return hasher.Value();
+	}
+
+	ComPtr<IDXGIAdapter> pAdapter;
+	if (FAILED(pFactory->EnumAdapterByLuid(luid, IID_PPV_ARGS(pAdapter.GetAddressOf()))))
+	{
+		return hasher.Value();
+	}
+
+	DXGI_ADAPTER_DESC desc = {};
+	pAdapter->GetDesc(&desc);
+	hasher.Add(desc.VendorId);
+	hasher.Add(desc.DeviceId);
+	hasher.Add(desc.Revision);
+
+	// ユーザーモードドライバのバージョン
+	LARGE_INTEGER umdVersion = {};
+	if (SUCCEEDED(pAdapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &umdVersion)))
+	{
+		hasher.Add(umdVersion.QuadPart);
+	}
+
+	return hasher.Value();
+}
+
+bool PipelineCache::LoadFromFile()
+{
+	std::ifstream file(m_Path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	FileHeader header = {};
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || header.Magic != LibraryFileMagic || header.Version != LibraryFileVersion)
+	{
+		printf("パイプラインライブラリのファイルが不正なため破棄します\n");
+		return false;
+	}
+
+	if (header.DriverHash != m_DriverHash)
+	{
+		printf("ドライバが変わったためパイプラインライブラリを破棄します\n");
+		return false;
+	}
+
+	m_LibraryData.resize(static_cast<size_t>(header.DataSize));
+	file.read(m_LibraryData.data(), m_LibraryData.size());
+	if (!file)
+	{
+		return false;
+	}
+
+	auto hr = m_pDevice->CreatePipelineLibrary(m_LibraryData.data(), m_LibraryData.size(),
+		IID_PPV_ARGS(m_pLibrary.ReleaseAndGetAddressOf()));
+	if (FAILED(hr))
+	{
+		// D3D12_ERROR_DRIVER_VERSION_MISMATCHなど
+		printf("パイプラインライブラリの読み込みに失敗: HRESULT = 0x%08X\n", hr);
+		return false;
+	}
+
+	return true;
+}
+
+bool PipelineCache::Save()
+{
+	if (m_pLibrary == nullptr || !m_IsDirty)
+	{
+		return true;
+	}
+
+	// 今回使ったPSOだけを新しいライブラリに入れ直す（シェーダーが変わって使われなくなったものは捨てる）
+	ComPtr<ID3D12PipelineLibrary> pLibrary;
+	auto hr = m_pDevice->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(pLibrary.GetAddressOf()));
+	if (FAILED(hr))
+	{
+		return false;
+	}
+
+	for (auto& [key, pipeline] : m_Pipelines)
+	{
+		// 名前はハッシュなので、衝突した2つ目は保存できない（次回はコンパイルし直す）
+		pLibrary->StorePipeline(key.Name().c_str(), pipeline.Get());
+	}
+
+	std::vector<char> data(pLibrary->GetSerializedSize());
+	hr = pLibrary->Serialize(data.data(), data.size());
+	if (FAILED(hr))
+	{
+		printf("パイプラインライブラリのシリアライズに失敗\n");
+		return false;
+	}
+
+	std::ofstream file(m_Path, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		printf("パイプラインライブラリの保存に失敗\n");
+		return false;
+	}
+
+	FileHeader header = {};
+	header.Magic = LibraryFileMagic;
+	header.Version = LibraryFileVersion;
+	header.DriverHash = m_DriverHash;
+	header.DataSize = data.size();
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(data.data(), data.size());
+
+	m_IsDirty = false;
+	return true;
+}
+
+PipelineKey PipelineCache::FindRootSignatureKey(ID3D12RootSignature* rootSignature) const
+{
+	auto it = m_RootSignatureKeys.find(rootSignature);
+	if (it != m_RootSignatureKeys.end())
+	{
+		return it->second;
+	}
+
+	// キャッシュを通さずに作られたルートシグネチャはアドレスで区別する
+	PipelineKey key;
+	key.Add(reinterpret_cast<uintptr_t>(rootSignature));
+	return key;
+}
+
+ComPtr<ID3D12RootSignature> PipelineCache::GetRootSignature(const void* blob, size_t size)
+{
+	m_RootSignatureRequests++;
+
+	auto key = MakeRootSignatureKey(blob, size);
+	if (m_IsEnabled)
+	{
+		auto it = m_RootSignatures.find(key);
+		if (it != m_RootSignatures.end())
+		{
+			m_RootSignatureHits++;
+			return it->second;
+		}
+	}
+
+	ComPtr<ID3D12RootSignature> pRootSignature;
+	auto hr = m_pDevice->CreateRootSignature(0, blob, size, IID_PPV_ARGS(pRootSignature.GetAddressOf()));
+	if (FAILED(hr))
+	{
+		return nullptr;
+	}
+
+	if (m_IsEnabled)
+	{
+		m_RootSignatureKeys[pRootSignature.Get()] = key;
+		m_RootSignatures.emplace(std::move(key), pRootSignature);
+	}
+
+	return pRootSignature;
+}
+
+template<typename Load, typename Create>
+ComPtr<ID3D12PipelineState> PipelineCache::GetPipeline(PipelineKey&& key, Load&& load, Create&& create)
+{
+	m_PipelineRequests++;
+	Timer timer;
+
+	if (m_IsEnabled)
+	{
+		auto it = m_Pipelines.find(key);
+		if (it != m_Pipelines.end())
+		{
+			m_PipelineHits++;
+			m_PipelineCreateTime += timer.GetElapsedTime();
+			return it->second;
+		}
+	}
+
+	ComPtr<ID3D12PipelineState> pPipelineState;
+	auto name = key.Name();
+	HRESULT hr = E_INVALIDARG;
+	if (m_IsEnabled && m_pLibrary != nullptr)
+	{
+		hr = load(name.c_str(), pPipelineState);
+	}
+
+	if (SUCCEEDED(hr))
+	{
+		m_LibraryHits++;
+	}
+	else
+	{
+		hr = create(pPipelineState);
+		if (FAILED(hr))
+		{
+			printf("パイプラインステートの生成に失敗: HRESULT = 0x%08X\n", hr);
+			return nullptr;
+		}
+		m_IsDirty = true;
+	}
+
+	if (m_IsEnabled)
+	{
+		m_Pipelines.emplace(std::move(key), pPipelineState);
+	}
+
+	m_PipelineCreateTime += timer.GetElapsedTime();
+	return pPipelineState;
+}
+
+ComPtr<ID3D12PipelineState> PipelineCache::GetGraphicsPipeline(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc)
+{
+	return GetPipeline(MakeGraphicsPipelineKey(desc, FindRootSignatureKey(desc.pRootSignature)),
+		[&](const wchar_t* name, ComPtr<ID3D12PipelineState>& pPipelineState)
+		{
+			return m_pLibrary->LoadGraphicsPipeline(name, &desc, IID_PPV_ARGS(pPipelineState.GetAddressOf()));
+		},
+		[&](ComPtr<ID3D12PipelineState>& pPipelineState)
+		{
+			return m_pDevice->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(pPipelineState.ReleaseAndGetAddressOf()));
+		});
+}
+
+ComPtr<ID3D12PipelineState> PipelineCache::GetComputePipeline(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc)
+{
+	return GetPipeline(MakeComputePipelineKey(desc, FindRootSignatureKey(desc.pRootSignature)),
+		[&](const wchar_t* name, ComPtr<ID3D12PipelineState>& pPipelineState)
+		{
+			return m_pLibrary->LoadComputePipeline(name, &desc, IID_PPV_ARGS(pPipelineState.GetAddressOf()));
+		},
+		[&](ComPtr<ID3D12PipelineState>& pPipelineState)
+		{
+			return m_pDevice->CreateComputePipelineState(&desc, IID_PPV_ARGS(pPipelineState.ReleaseAndGetAddressOf()));
+		});
+}
+
+void PipelineCache::PrintStats() const
+{
+	auto compiled = m_PipelineRequests - m_PipelineHits - m_LibraryHits;
+	printf("PSO生成: %u個 %.2f ms (キャッシュ%s, 再利用 %u, ライブラリから読込 %u, コンパイル %u)\n",
+		m_PipelineRequests, m_PipelineCreateTime, m_IsEnabled ? "有効" : "無効",
+		m_PipelineHits, m_LibraryHits, compiled);
+	printf("ルートシグネチャ: %u個中%u個を再利用\n", m_RootSignatureRequests, m_RootSignatureHits);
+}
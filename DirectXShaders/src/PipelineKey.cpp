@@ -0,0 +1,428 @@
+#include "PipelineKey.h"
+#include "RhiTypes.h"
+#include <functional>
+#include <iterator>
+#include <stdio.h>
+#include <type_traits>
+#include <utility>
+
+void PipelineKey::Add(const void* data, size_t size)
+{
+	auto bytes = static_cast<const uint8_t*>(data);
+	m_Bytes.insert(m_Bytes.end(), bytes, bytes + size);
+	m_Hasher.Add(data, size);
+}
+
+void PipelineKey::AddString(const char* str)
+{
+	if (str == nullptr)
+	{
+		str = "";
+	}
+	Add(str, strlen(str) + 1);
+}
+
+void PipelineKey::AddShader(const void* bytecode, size_t length)
+{
+	if (bytecode == nullptr)
+	{
+		length = 0;
+	}
+	Add(static_cast<uint64_t>(length));
+	if (length > 0)
+	{
+		Add(bytecode, length);
+	}
+}
+
+void PipelineKey::AddKey(const PipelineKey& key)
+{
+	Add(static_cast<uint64_t>(key.m_Bytes.size()));
+	if (!key.m_Bytes.empty())
+	{
+		Add(key.m_Bytes.data(), key.m_Bytes.size());
+	}
+}
+
+std::wstring PipelineKey::Name() const
+{
+	wchar_t name[17];
+	swprintf(name, std::size(name), L"%016llX", static_cast<unsigned long long>(Hash()));
+	return name;
+}
+
+namespace
+{
+	// D3D12_GRAPHICS_PIPELINE_STATE_DESCと同じ名前のメンバーを持つ型（列挙型はUINTにしてある）
+	struct TestShaderBytecode
+	{
+		const void* pShaderBytecode;
+		size_t BytecodeLength;
+	};
+
+	struct TestRenderTargetBlendDesc
+	{
+		BOOL BlendEnable;
+		BOOL LogicOpEnable;
+		UINT SrcBlend;
+		UINT DestBlend;
+		UINT BlendOp;
+		UINT SrcBlendAlpha;
+		UINT DestBlendAlpha;
+		UINT BlendOpAlpha;
+		UINT LogicOp;
+		UINT8 RenderTargetWriteMask;
+	};
+
+	struct TestStencilOpDesc
+	{
+		UINT StencilFailOp;
+		UINT StencilDepthFailOp;
+		UINT StencilPassOp;
+		UINT StencilFunc;
+	};
+
+	struct TestInputElementDesc
+	{
+		const char* SemanticName;
+		UINT SemanticIndex;
+		UINT Format;
+		UINT InputSlot;
+		UINT AlignedByteOffset;
+		UINT InputSlotClass;
+		UINT InstanceDataStepRate;
+	};
+
+	struct TestCachedPipelineState
+	{
+		const void* pCachedBlob;
+		size_t CachedBlobSizeInBytes;
+	};
+
+	struct TestGraphicsPipelineDesc
+	{
+		void* pRootSignature;
+		TestShaderBytecode VS, PS, DS, HS, GS;
+		struct
+		{
+			const void* pSODeclaration;
+			UINT NumEntries;
+			const UINT* pBufferStrides;
+			UINT NumStrides;
+			UINT RasterizedStream;
+		} StreamOutput;
+		struct
+		{
+			BOOL AlphaToCoverageEnable;
+			BOOL IndependentBlendEnable;
+			TestRenderTargetBlendDesc RenderTarget[8];
+		} BlendState;
+		UINT SampleMask;
+		struct
+		{
+			UINT FillMode;
+			UINT CullMode;
+			BOOL FrontCounterClockwise;
+			INT DepthBias;
+			float DepthBiasClamp;
+			float SlopeScaledDepthBias;
+			BOOL DepthClipEnable;
+			BOOL MultisampleEnable;
+			BOOL AntialiasedLineEnable;
+			UINT ForcedSampleCount;
+			UINT ConservativeRaster;
+		} RasterizerState;
+		struct
+		{
+			BOOL DepthEnable;
+			UINT DepthWriteMask;
+			UINT DepthFunc;
+			BOOL StencilEnable;
+			UINT8 StencilReadMask;
+			UINT8 StencilWriteMask;
+			TestStencilOpDesc FrontFace;
+			TestStencilOpDesc BackFace;
+		} DepthStencilState;
+		struct
+		{
+			const TestInputElementDesc* pInputElementDescs;
+			UINT NumElements;
+		} InputLayout;
+		UINT IBStripCutValue;
+		UINT PrimitiveTopologyType;
+		UINT NumRenderTargets;
+		UINT RTVFormats[8];
+		UINT DSVFormat;
+		struct
+		{
+			UINT Count;
+			UINT Quality;
+		} SampleDesc;
+		UINT NodeMask;
+		TestCachedPipelineState CachedPSO;
+		UINT Flags;
+	};
+
+	struct TestComputePipelineDesc
+	{
+		void* pRootSignature;
+		TestShaderBytecode CS;
+		UINT NodeMask;
+		TestCachedPipelineState CachedPSO;
+		UINT Flags;
+	};
+
+	// 列挙型、整数、浮動小数点数のどれでも値を1つずらす
+	template<typename T>
+	void Bump(T& value)
+	{
+		value = static_cast<T>(static_cast<int64_t>(value) + 1);
+	}
+
+	template<typename T>
+	void Set(T& value, int64_t newValue)
+	{
+		value = static_cast<T>(newValue);
+	}
+
+	// ハッシュの下位2ビットだけを使い、どのキーも4通りのハッシュのどれかに衝突させる
+	struct CollidingHash
+	{
+		size_t operator()(const PipelineKey& key) const { return static_cast<size_t>(key.Hash() & 3); }
+	};
+
+	const uint8_t ShaderA[] = { 0x44, 0x58, 0x42, 0x43, 0x01, 0x02 };
+	const uint8_t ShaderACopy[] = { 0x44, 0x58, 0x42, 0x43, 0x01, 0x02 };
+	const uint8_t ShaderB[] = { 0x44, 0x58, 0x42, 0x43, 0x03, 0x04 };
+	char Position[] = "POSITION";
+	char PositionCopy[] = "POSITION";
+	char Normal[] = "NORMAL";
+
+	// Descのメンバーがどれもキーに入っていることを、1つずつ変えて確かめる
+	template<typename Desc>
+	bool CheckGraphicsKey(const char* name, std::vector<PipelineKey>& keys)
+	{
+		using Element = std::remove_const_t<std::remove_pointer_t<decltype(std::declval<Desc&>().InputLayout.pInputElementDescs)>>;
+		using Change = std::function<void(Desc&, Element*)>;
+
+		Element elements[2] = {};
+		elements[0].SemanticName = Position;
+		Set(elements[0].Format, 6);
+		elements[1].SemanticName = Normal;
+		Set(elements[1].Format, 6);
+		elements[1].AlignedByteOffset = 12;
+
+		Desc base = {};
+		base.VS = { ShaderA, sizeof(ShaderA) };
+		base.PS = { ShaderB, sizeof(ShaderB) };
+		base.SampleMask = ~0u;
+		base.InputLayout = { elements, 2 };
+		base.NumRenderTargets = 1;
+		Set(base.RTVFormats[0], 28);
+		base.SampleDesc.Count = 1;
+		auto rootSignature = MakeRootSignatureKey(ShaderA, sizeof(ShaderA));
+		auto baseKey = MakeGraphicsPipelineKey(base, rootSignature);
+		bool isValid = true;
+
+		// 中身が同じなら、ポインタやキーに入れないメンバーが違っても同じキーになる
+		Element copiedElements[2] = { elements[0], elements[1] };
+		copiedElements[0].SemanticName = PositionCopy;
+		Desc copied = base;
+		copied.VS.pShaderBytecode = ShaderACopy;
+		copied.InputLayout.pInputElementDescs = copiedElements;
+		copied.pRootSignature = reinterpret_cast<decltype(copied.pRootSignature)>(&copied);
+		copied.CachedPSO.pCachedBlob = ShaderB;
+		copied.CachedPSO.CachedBlobSizeInBytes = sizeof(ShaderB);
+		if (MakeGraphicsPipelineKey(copied, MakeRootSignatureKey(ShaderACopy, sizeof(ShaderACopy))) != baseKey)
+		{
+			printf("  %s: 中身が同じなのに違うキーになった\n", name);
+			isValid = false;
+		}
+
+		std::vector<std::pair<const char*, Change>> changes =
+		{
+			{ "VSの中身", [](Desc& d, Element*) { d.VS.pShaderBytecode = ShaderB; } },
+			{ "VSの長さ", [](Desc& d, Element*) { d.VS.BytecodeLength--; } },
+			{ "PS", [](Desc& d, Element*) { d.PS = { ShaderA, sizeof(ShaderA) }; } },
+			{ "DS", [](Desc& d, Element*) { d.DS = { ShaderA, sizeof(ShaderA) }; } },
+			{ "HS", [](Desc& d, Element*) { d.HS = { ShaderA, sizeof(ShaderA) }; } },
+			{ "GS", [](Desc& d, Element*) { d.GS = { ShaderA, sizeof(ShaderA) }; } },
+			{ "StreamOutput.NumEntries", [](Desc& d, Element*) { Bump(d.StreamOutput.NumEntries); } },
+			{ "AlphaToCoverageEnable", [](Desc& d, Element*) { Bump(d.BlendState.AlphaToCoverageEnable); } },
+			{ "IndependentBlendEnable", [](Desc& d, Element*) { Bump(d.BlendState.IndependentBlendEnable); } },
+			{ "RenderTarget[0].BlendEnable", [](Desc& d, Element*) { Bump(d.BlendState.RenderTarget[0].BlendEnable); } },
+			{ "RenderTarget[0].LogicOpEnable", [](Desc& d, Element*) { Bump(d.BlendState.RenderTarget[0].LogicOpEnable); } },
+			{ "RenderTarget[0].SrcBlend", [](Desc& d, Element*) { Bump(d.BlendState.RenderTarget[0].SrcBlend); } },
+			{ "RenderTarget[0].DestBlend", [](Desc& d, Element*) { Bump(d.BlendState.RenderTarget[0].DestBlend); } },
+			{ "RenderTarget[0].BlendOp", [](Desc& d, Element*) { Bump(d.BlendState.RenderTarget[0].BlendOp); } },
+			{ "RenderTarget[0].SrcBlendAlpha", [](Desc& d, Element*) { Bump(d.BlendState.RenderTarget[0].SrcBlendAlpha); } },
+			{ "RenderTarget[0].DestBlendAlpha", [](Desc& d, Element*) { Bump(d.BlendState.RenderTarget[0].DestBlendAlpha); } },
+			{ "RenderTarget[0].BlendOpAlpha", [](Desc& d, Element*) { Bump(d.BlendState.RenderTarget[0].BlendOpAlpha); } },
+			{ "RenderTarget[0].LogicOp", [](Desc& d, Element*) { Bump(d.BlendState.RenderTarget[0].LogicOp); } },
+			{ "RenderTarget[0].RenderTargetWriteMask", [](Desc& d, Element*) { Bump(d.BlendState.RenderTarget[0].RenderTargetWriteMask); } },
+			{ "RenderTarget[7].BlendEnable", [](Desc& d, Element*) { Bump(d.BlendState.RenderTarget[7].BlendEnable); } },
+			{ "SampleMask", [](Desc& d, Element*) { d.SampleMask = 1; } },
+			{ "FillMode", [](Desc& d, Element*) { Bump(d.RasterizerState.FillMode); } },
+			{ "CullMode", [](Desc& d, Element*) { Bump(d.RasterizerState.CullMode); } },
+			{ "FrontCounterClockwise", [](Desc& d, Element*) { Bump(d.RasterizerState.FrontCounterClockwise); } },
+			{ "DepthBias", [](Desc& d, Element*) { Bump(d.RasterizerState.DepthBias); } },
+			{ "DepthBiasClamp", [](Desc& d, Element*) { Bump(d.RasterizerState.DepthBiasClamp); } },
+			{ "SlopeScaledDepthBias", [](Desc& d, Element*) { Bump(d.RasterizerState.SlopeScaledDepthBias); } },
+			{ "DepthClipEnable", [](Desc& d, Element*) { Bump(d.RasterizerState.DepthClipEnable); } },
+			{ "MultisampleEnable", [](Desc& d, Element*) { Bump(d.RasterizerState.MultisampleEnable); } },
+			{ "AntialiasedLineEnable", [](Desc& d, Element*) { Bump(d.RasterizerState.AntialiasedLineEnable); } },
+			{ "ForcedSampleCount", [](Desc& d, Element*) { Bump(d.RasterizerState.ForcedSampleCount); } },
+			{ "ConservativeRaster", [](Desc& d, Element*) { Bump(d.RasterizerState.ConservativeRaster); } },
+			{ "DepthEnable", [](Desc& d, Element*) { Bump(d.DepthStencilState.DepthEnable); } },
+			{ "DepthWriteMask", [](Desc& d, Element*) { Bump(d.DepthStencilState.DepthWriteMask); } },
+			{ "DepthFunc", [](Desc& d, Element*) { Bump(d.DepthStencilState.DepthFunc); } },
+			{ "StencilEnable", [](Desc& d, Element*) { Bump(d.DepthStencilState.StencilEnable); } },
+			{ "StencilReadMask", [](Desc& d, Element*) { Bump(d.DepthStencilState.StencilReadMask); } },
+			{ "StencilWriteMask", [](Desc& d, Element*) { Bump(d.DepthStencilState.StencilWriteMask); } },
+			{ "FrontFace.StencilFailOp", [](Desc& d, Element*) { Bump(d.DepthStencilState.FrontFace.StencilFailOp); } },
+			{ "FrontFace.StencilDepthFailOp", [](Desc& d, Element*) { Bump(d.DepthStencilState.FrontFace.StencilDepthFailOp); } },
+			{ "FrontFace.StencilPassOp", [](Desc& d, Element*) { Bump(d.DepthStencilState.FrontFace.StencilPassOp); } },
+			{ "FrontFace.StencilFunc", [](Desc& d, Element*) { Bump(d.DepthStencilState.FrontFace.StencilFunc); } },
+			{ "BackFace.StencilFailOp", [](Desc& d, Element*) { Bump(d.DepthStencilState.BackFace.StencilFailOp); } },
+			{ "BackFace.StencilDepthFailOp", [](Desc& d, Element*) { Bump(d.DepthStencilState.BackFace.StencilDepthFailOp); } },
+			{ "BackFace.StencilPassOp", [](Desc& d, Element*) { Bump(d.DepthStencilState.BackFace.StencilPassOp); } },
+			{ "BackFace.StencilFunc", [](Desc& d, Element*) { Bump(d.DepthStencilState.BackFace.StencilFunc); } },
+			{ "NumElements", [](Desc& d, Element*) { d.InputLayout.NumElements--; } },
+			{ "SemanticName", [](Desc&, Element* e) { e[1].SemanticName = Position; } },
+			{ "SemanticIndex", [](Desc&, Element* e) { Bump(e[1].SemanticIndex); } },
+			{ "Format", [](Desc&, Element* e) { Bump(e[1].Format); } },
+			{ "InputSlot", [](Desc&, Element* e) { Bump(e[1].InputSlot); } },
+			{ "AlignedByteOffset", [](Desc&, Element* e) { Bump(e[1].AlignedByteOffset); } },
+			{ "InputSlotClass", [](Desc&, Element* e) { Bump(e[1].InputSlotClass); } },
+			{ "InstanceDataStepRate", [](Desc&, Element* e) { Bump(e[1].InstanceDataStepRate); } },
+			{ "IBStripCutValue", [](Desc& d, Element*) { Bump(d.IBStripCutValue); } },
+			{ "PrimitiveTopologyType", [](Desc& d, Element*) { Bump(d.PrimitiveTopologyType); } },
+			{ "NumRenderTargets", [](Desc& d, Element*) { Bump(d.NumRenderTargets); } },
+			{ "RTVFormats[0]", [](Desc& d, Element*) { Bump(d.RTVFormats[0]); } },
+			{ "RTVFormats[7]", [](Desc& d, Element*) { Bump(d.RTVFormats[7]); } },
+			{ "DSVFormat", [](Desc& d, Element*) { Bump(d.DSVFormat); } },
+			{ "SampleDesc.Count", [](Desc& d, Element*) { Bump(d.SampleDesc.Count); } },
+			{ "SampleDesc.Quality", [](Desc& d, Element*) { Bump(d.SampleDesc.Quality); } },
+			{ "NodeMask", [](Desc& d, Element*) { Bump(d.NodeMask); } },
+			{ "Flags", [](Desc& d, Element*) { Bump(d.Flags); } },
+		};
+
+		keys.push_back(baseKey);
+		for (auto& [member, change] : changes)
+		{
+			Element changedElements[2] = { elements[0], elements[1] };
+			Desc changed = base;
+			changed.InputLayout.pInputElementDescs = changedElements;
+			change(changed, changedElements);
+
+			auto key = MakeGraphicsPipelineKey(changed, rootSignature);
+			if (key == baseKey || key.Hash() == baseKey.Hash())
+			{
+				printf("  %s: %sを変えてもキーが変わらない\n", name, member);
+				isValid = false;
+			}
+			keys.push_back(key);
+		}
+
+		auto otherRootSignature = MakeRootSignatureKey(ShaderB, sizeof(ShaderB));
+		keys.push_back(MakeGraphicsPipelineKey(base, otherRootSignature));
+		if (keys.back() == baseKey)
+		{
+			printf("  %s: ルートシグネチャを変えてもキーが変わらない\n", name);
+			isValid = false;
+		}
+		return isValid;
+	}
+
+	template<typename Desc>
+	bool CheckComputeKey(const char* name, std::vector<PipelineKey>& keys)
+	{
+		auto rootSignature = MakeRootSignatureKey(ShaderA, sizeof(ShaderA));
+		Desc base = {};
+		base.CS = { ShaderA, sizeof(ShaderA) };
+		auto baseKey = MakeComputePipelineKey(base, rootSignature);
+		bool isValid = true;
+
+		Desc copied = base;
+		copied.CS.pShaderBytecode = ShaderACopy;
+		copied.CachedPSO.pCachedBlob = ShaderB;
+		if (MakeComputePipelineKey(copied, rootSignature) != baseKey)
+		{
+			printf("  %s: 中身が同じなのに違うキーになった\n", name);
+			isValid = false;
+		}
+
+		Desc changed[3] = { base, base, base };
+		changed[0].CS.pShaderBytecode = ShaderB;
+		Bump(changed[1].NodeMask);
+		Bump(changed[2].Flags);
+		keys.push_back(baseKey);
+		for (auto& desc : changed)
+		{
+			keys.push_back(MakeComputePipelineKey(desc, rootSignature));
+			isValid &= keys.back() != baseKey;
+		}
+		keys.push_back(MakeComputePipelineKey(base, MakeRootSignatureKey(ShaderB, sizeof(ShaderB))));
+		isValid &= keys.back() != baseKey;
+		if (!isValid)
+		{
+			printf("  %s: メンバーを変えてもキーが変わらない\n", name);
+		}
+		return isValid;
+	}
+}
+
+bool PipelineKey::RunTest()
+{
+	std::vector<PipelineKey> keys;
+	bool isValid = CheckGraphicsKey<TestGraphicsPipelineDesc>("グラフィックス", keys);
+	isValid &= CheckComputeKey<TestComputePipelineDesc>("コンピュート", keys);
+	auto distinctKeys = keys.size();
+#ifdef RHI_HAS_D3D12
+	isValid &= CheckGraphicsKey<D3D12_GRAPHICS_PIPELINE_STATE_DESC>("D3D12のグラフィックス", keys);
+	isValid &= CheckComputeKey<D3D12_COMPUTE_PIPELINE_STATE_DESC>("D3D12のコンピュート", keys);
+#endif
+
+	// キーの長さで区切るので、ルートシグネチャと続くメンバーの境目がずれても同じバイト列にならない
+	PipelineKey shortRoot, longRoot;
+	shortRoot.Add(uint8_t(1));
+	longRoot.Add(uint8_t(1));
+	longRoot.Add(uint8_t(2));
+	PipelineKey first, second;
+	first.AddKey(shortRoot);
+	first.Add(uint8_t(2));
+	second.AddKey(longRoot);
+	if (first == second)
+	{
+		printf("  キーの境目がずれても同じキーになった\n");
+		isValid = false;
+	}
+
+	// ハッシュを衝突させた表でも、同じキーは1つにまとまり、違うキーはそれぞれの値を引ける
+	// D3D12の型の記述はテスト用の型と同じ値なので、同じキーにまとまる
+	PipelineKeyMap<size_t, CollidingHash> colliding;
+	PipelineKeyMap<size_t> unique;
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		colliding.emplace(keys[i], i);
+		unique.emplace(keys[i], i);
+	}
+	if (colliding.size() != distinctKeys || unique.size() != distinctKeys)
+	{
+		printf("  キーの数が違う (%zu個, 期待 %zu個)\n", colliding.size(), distinctKeys);
+		isValid = false;
+	}
+	for (auto& key : keys)
+	{
+		auto it = colliding.find(key);
+		if (it == colliding.end() || keys[it->second] != key || it->second != unique[key])
+		{
+			printf("  衝突させた表から違うキーを引いた\n");
+			isValid = false;
+			break;
+		}
+	}
+
+	printf("パイプラインのキーのテスト: %s (%zu個のキー)\n", isValid ? "成功" : "失敗", unique.size());
+	return isValid;
+}
@@ -1,41 +1,42 @@
 #include "PipelineState.h"
+#include <stdio.h>
+
+#ifdef RHI_HAS_D3D12
 #include "Engine.h"
 #include <d3dx12.h>
 #include <d3dcompiler.h>
 
 #pragma comment(lib, "d3dcompiler.lib")
 
-PipelineState::PipelineState()
+template<>
+BasicPipelineState<D3D12Backend>::BasicPipelineState()
 {
-	desc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-	desc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
-	desc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-	desc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
-	desc.SampleMask = UINT_MAX;
-	desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-	desc.NumRenderTargets = 1;
-	desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-	desc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
-	desc.SampleDesc.Count = 1;
-	desc.SampleDesc.Quality = 0;
-}
-
-bool PipelineState::IsValid()
-{
-	return m_IsValid;
+	m_Desc.Desc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+	m_Desc.Desc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+	m_Desc.Desc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+	m_Desc.Desc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+	m_Desc.Desc.SampleMask = UINT_MAX;
+	m_Desc.Desc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	m_Desc.Desc.NumRenderTargets = 1;
+	m_Desc.Desc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+	m_Desc.Desc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
+	m_Desc.Desc.SampleDesc.Count = 1;
+	m_Desc.Desc.SampleDesc.Quality = 0;
 }
 
-void PipelineState::SetInputLayout(D3D12_INPUT_LAYOUT_DESC layout)
+template<>
+void BasicPipelineState<D3D12Backend>::SetInputLayout(RhiInputLayoutDesc layout)
 {
 	if (!layout.pInputElementDescs || layout.NumElements == 0)
 	{
 		printf("入力レイアウトが無効です\n");
 		return;
 	}
-	desc.InputLayout = layout;
+	m_Desc.Desc.InputLayout = layout;
 }
 
-void PipelineState::SetRootSignature(ID3D12RootSignature* rootSignature)
+template<>
+void BasicPipelineState<D3D12Backend>::SetRootSignature(ID3D12RootSignature* rootSignature)
 {
 	if (!rootSignature)
 	{
@@ -43,46 +44,155 @@ void PipelineState::SetRootSignature(ID3D12RootSignature* rootSignature)
 		return;
 	}
 
-	desc.pRootSignature = rootSignature;
+	m_Desc.Desc.pRootSignature = rootSignature;
 }
 
-void PipelineState::SetVertexShader(std::wstring path)
+template<>
+void BasicPipelineState<D3D12Backend>::SetVertexShader(std::wstring path)
 {
-	auto hr = D3DReadFileToBlob(path.c_str(), m_pVSBlob.GetAddressOf());
+	auto hr = D3DReadFileToBlob(path.c_str(), m_Desc.pVSBlob.GetAddressOf());
 	if (FAILED(hr))
 	{
 		printf("頂点シェーダの読み込みに失敗\n");
 		return;
 	}
 
-	desc.VS = CD3DX12_SHADER_BYTECODE(m_pVSBlob.Get());
+	m_Desc.Desc.VS = CD3DX12_SHADER_BYTECODE(m_Desc.pVSBlob.Get());
 }
 
-void PipelineState::SetPixelShader(std::wstring path)
+template<>
+void BasicPipelineState<D3D12Backend>::SetPixelShader(std::wstring path)
 {
-	auto hr = D3DReadFileToBlob(path.c_str(), m_pPSBlob.GetAddressOf());
+	auto hr = D3DReadFileToBlob(path.c_str(), m_Desc.pPSBlob.GetAddressOf());
 	if (FAILED(hr))
 	{
 		printf("ピクセルシェーダの読み込みに失敗\n");
 		return;
 	}
 
-	desc.PS = CD3DX12_SHADER_BYTECODE(m_pPSBlob.Get());
+	m_Desc.Desc.PS = CD3DX12_SHADER_BYTECODE(m_Desc.pPSBlob.Get());
 }
 
-void PipelineState::Create()
+template<>
+void BasicPipelineState<D3D12Backend>::SetVertexShader(RhiShaderBlob* bytecode)
 {
-	auto hr = g_Engine->Device()->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(m_pPipelineState.GetAddressOf()));
-	if (FAILED(hr))
+	if (!bytecode)
+	{
+		printf("頂点シェーダが無効です\n");
+		return;
+	}
+
+	m_Desc.pVSBlob = bytecode;
+	m_Desc.Desc.VS = CD3DX12_SHADER_BYTECODE(m_Desc.pVSBlob.Get());
+}
+
+template<>
+void BasicPipelineState<D3D12Backend>::SetPixelShader(RhiShaderBlob* bytecode)
+{
+	if (!bytecode)
+	{
+		printf("ピクセルシェーダが無効です\n");
+		return;
+	}
+
+	m_Desc.pPSBlob = bytecode;
+	m_Desc.Desc.PS = CD3DX12_SHADER_BYTECODE(m_Desc.pPSBlob.Get());
+}
+
+template<>
+void BasicPipelineState<D3D12Backend>::Create()
+{
+	// 生成に失敗した場合のエラー表示はキャッシュ側で行う
+	m_pPipelineState = g_Engine->PSOCache()->GetGraphicsPipeline(m_Desc.Desc);
+	if (m_pPipelineState == nullptr)
+	{
+		return;
+	}
+
+	m_IsValid = true;
+}
+
+#endif
+
+// ヌルでは記述の中身を覚えるだけで、シェーダーは読まない
+template<>
+BasicPipelineState<NullBackend>::BasicPipelineState()
+{
+}
+
+template<>
+void BasicPipelineState<NullBackend>::SetInputLayout(RhiInputLayoutDesc layout)
+{
+	if (!layout.pInputElementDescs || layout.NumElements == 0)
 	{
-		printf("パイプラインステートの生成に失敗: HRESULT = 0x%08X\n", hr);
+		printf("入力レイアウトが無効です\n");
 		return;
 	}
+	m_Desc.InputElementCount = layout.NumElements;
+}
 
+template<>
+void BasicPipelineState<NullBackend>::SetRootSignature(NullRootSignature* rootSignature)
+{
+	if (!rootSignature)
+	{
+		printf("ルートシグネチャが無効です\n");
+		return;
+	}
+	m_Desc.pRootSignature = rootSignature;
+}
+
+template<>
+void BasicPipelineState<NullBackend>::SetVertexShader(std::wstring path)
+{
+	m_Desc.HasVertexShader = !path.empty();
+}
+
+template<>
+void BasicPipelineState<NullBackend>::SetPixelShader(std::wstring path)
+{
+	m_Desc.HasPixelShader = !path.empty();
+}
+
+template<>
+void BasicPipelineState<NullBackend>::SetVertexShader(RhiShaderBlob* bytecode)
+{
+	m_Desc.HasVertexShader = bytecode != nullptr;
+}
+
+template<>
+void BasicPipelineState<NullBackend>::SetPixelShader(RhiShaderBlob* bytecode)
+{
+	m_Desc.HasPixelShader = bytecode != nullptr;
+}
+
+template<>
+void BasicPipelineState<NullBackend>::Create()
+{
+	// D3D12で生成に失敗する記述は、ヌルでも失敗させる
+	if (m_Desc.pRootSignature == nullptr || m_Desc.InputElementCount == 0 || !m_Desc.HasVertexShader)
+	{
+		printf("パイプラインステートの記述が足りない\n");
+		return;
+	}
+
+	m_pPipelineState = NullDevice::CreatePipelineState(m_Desc);
 	m_IsValid = true;
 }
 
-ID3D12PipelineState* PipelineState::Get()
+template<typename Backend>
+bool BasicPipelineState<Backend>::IsValid()
+{
+	return m_IsValid;
+}
+
+template<typename Backend>
+typename Backend::PipelineState* BasicPipelineState<Backend>::Get()
 {
 	return m_pPipelineState.Get();
-}
\ No newline at end of file
+}
+
+template class BasicPipelineState<NullBackend>;
+#ifdef RHI_HAS_D3D12
+template class BasicPipelineState<D3D12Backend>;
+#endif
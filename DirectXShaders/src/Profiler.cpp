@@ -0,0 +1,320 @@
+#include "Profiler.h"
+#include "Clock.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+std::atomic<bool> Profiler::s_IsEnabled(false);
+
+namespace
+{
+	struct Event
+	{
+		const char* Name;
+		int64_t Begin;
+		int64_t End;
+	};
+
+	// 1つの行の区間。書くのは持ち主（CPUならそのスレッド、GPUなら行を登録したスレッド）だけ
+	struct EventBuffer
+	{
+		std::string Name;
+		bool IsGpu = false;
+		bool IsHidden = false; // 手間の計測用（書き出さない）
+		std::unique_ptr<Event[]> Events;
+		std::atomic<uint32_t> Count{ 0 };
+		std::atomic<uint32_t> Dropped{ 0 };
+	};
+
+	std::mutex s_BufferMutex; // バッファの登録と書き出しの時だけ取る
+	std::vector<std::unique_ptr<EventBuffer>> s_Buffers; // スレッドが終わっても書き出すまで残す
+	std::mutex s_GpuMutex;
+
+	thread_local EventBuffer* t_pBuffer = nullptr;
+	thread_local std::string t_ThreadName;
+	thread_local bool t_IsHidden = false;
+
+	EventBuffer* CreateBuffer(const std::string& name, bool isGpu, bool isHidden)
+	{
+		auto buffer = std::make_unique<EventBuffer>();
+		buffer->IsGpu = isGpu;
+		buffer->IsHidden = isHidden;
+		buffer->Events.reset(new Event[Profiler::MAX_EVENTS_PER_THREAD]);
+
+		std::lock_guard<std::mutex> lock(s_BufferMutex);
+		buffer->Name = name.empty() ? "Thread " + std::to_string(s_Buffers.size()) : name;
+		s_Buffers.push_back(std::move(buffer));
+		return s_Buffers.back().get();
+	}
+
+	void Push(EventBuffer* buffer, const char* name, int64_t begin, int64_t end)
+	{
+		// 区間を書いてから数を公開するので、書き出す側は数を読めばそこまでは読んでいい
+		auto count = buffer->Count.load(std::memory_order_relaxed);
+		if (count >= Profiler::MAX_EVENTS_PER_THREAD)
+		{
+			buffer->Dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		buffer->Events[count] = { name, begin, end };
+		buffer->Count.store(count + 1, std::memory_order_release);
+	}
+
+	EventBuffer* FindGpuBuffer(const char* track)
+	{
+		{
+			std::lock_guard<std::mutex> lock(s_BufferMutex);
+			for (auto& buffer : s_Buffers)
+			{
+				if (buffer->IsGpu && buffer->Name == track)
+				{
+					return buffer.get();
+				}
+			}
+		}
+		return CreateBuffer(track, true, false);
+	}
+
+	void WriteString(std::ostream& out, const char* str)
+	{
+		out << '"';
+		for (auto p = str; *p != '\0'; p++)
+		{
+			auto c = static_cast<unsigned char>(*p);
+			if (c == '"' || c == '\\')
+			{
+				out << '\\' << static_cast<char>(c);
+			}
+			else if (c < 0x20)
+			{
+				out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec << std::setfill(' ');
+			}
+			else
+			{
+				out << static_cast<char>(c);
+			}
+		}
+		out << '"';
+	}
+
+	// 手間の計測とテストで、指定の時間だけ処理をしているふりをする
+	void Spin(int64_t nanoseconds)
+	{
+		auto end = Profiler::Now() + nanoseconds;
+		while (Profiler::Now() < end)
+		{
+		}
+	}
+}
+
+int64_t Profiler::Now()
+{
+	return SystemClock::Timestamp();
+}
+
+void Profiler::AddCpuEvent(const char* name, int64_t begin, int64_t end)
+{
+	if (t_pBuffer == nullptr)
+	{
+		t_pBuffer = CreateBuffer(t_ThreadName, false, t_IsHidden);
+	}
+	Push(t_pBuffer, name, begin, end);
+}
+
+void Profiler::AddGpuEvent(const char* track, const char* name, int64_t begin, int64_t end)
+{
+	if (!IsEnabled())
+	{
+		return;
+	}
+
+	// GPUの区間は1フレームに数個なので、行を探す時だけロックを取る
+	std::lock_guard<std::mutex> lock(s_GpuMutex);
+	Push(FindGpuBuffer(track), name, begin, end);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	t_ThreadName = name;
+}
+
+bool Profiler::WriteChromeTrace(std::ostream& out)
+{
+	std::lock_guard<std::mutex> lock(s_BufferMutex);
+
+	// 一番早い区間を0にする
+	int64_t origin = INT64_MAX;
+	for (auto& buffer : s_Buffers)
+	{
+		auto count = buffer->Count.load(std::memory_order_acquire);
+		for (uint32_t i = 0; i < count && !buffer->IsHidden; i++)
+		{
+			origin = std::min<int64_t>(origin, buffer->Events[i].Begin);
+		}
+	}
+	if (origin == INT64_MAX)
+	{
+		origin = 0;
+	}
+
+	// CPUとGPUを別のプロセスとして並べ、行はバッファごとに分ける（時間はマイクロ秒）
+	out << std::fixed << std::setprecision(3);
+	out << "{\"traceEvents\":[\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+	for (size_t i = 0; i < s_Buffers.size(); i++)
+	{
+		auto& buffer = s_Buffers[i];
+		if (buffer->IsHidden)
+		{
+			continue;
+		}
+
+		auto pid = buffer->IsGpu ? 2 : 1;
+		auto tid = i + 1;
+		out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << tid << ",\"args\":{\"name\":";
+		WriteString(out, buffer->Name.c_str());
+		out << "}}";
+
+		auto count = buffer->Count.load(std::memory_order_acquire);
+		for (uint32_t e = 0; e < count; e++)
+		{
+			auto& event = buffer->Events[e];
+			out << ",\n{\"name\":";
+			WriteString(out, event.Name);
+			out << ",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << tid
+				<< ",\"ts\":" << (event.Begin - origin) / 1000.0 << ",\"dur\":" << (event.End - event.Begin) / 1000.0 << "}";
+		}
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+	return out.good();
+}
+
+bool Profiler::WriteChromeTrace(const std::filesystem::path& path)
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file)
+	{
+		printf("トレースファイルを開けない: %s\n", path.string().c_str());
+		return false;
+	}
+	return WriteChromeTrace(file);
+}
+
+uint32_t Profiler::EventCount()
+{
+	std::lock_guard<std::mutex> lock(s_BufferMutex);
+	uint32_t count = 0;
+	for (auto& buffer : s_Buffers)
+	{
+		count += buffer->IsHidden ? 0 : buffer->Count.load(std::memory_order_acquire);
+	}
+	return count;
+}
+
+uint32_t Profiler::DroppedCount()
+{
+	std::lock_guard<std::mutex> lock(s_BufferMutex);
+	uint32_t count = 0;
+	for (auto& buffer : s_Buffers)
+	{
+		count += buffer->IsHidden ? 0 : buffer->Dropped.load(std::memory_order_relaxed);
+	}
+	return count;
+}
+
+void Profiler::MeasureOverhead()
+{
+	const uint32_t disabledIterations = 1000000;
+	const uint32_t enabledIterations = MAX_EVENTS_PER_THREAD; // バッファが溢れない数
+	auto wasEnabled = IsEnabled();
+
+	SetEnabled(false);
+	auto begin = Now();
+	for (uint32_t i = 0; i < disabledIterations; i++)
+	{
+		PROFILE_SCOPE("Overhead");
+	}
+	auto disabledTime = static_cast<double>(Now() - begin) / disabledIterations;
+
+	// 有効の時は、書き出さないバッファを持つ専用のスレッドで測る
+	SetEnabled(true);
+	double enabledTime = 0.0;
+	std::thread thread([&]()
+	{
+		t_IsHidden = true;
+		AddCpuEvent("Overhead", 0, 0); // バッファの確保は計測から外す
+
+		auto begin = Now();
+		for (uint32_t i = 1; i < enabledIterations; i++)
+		{
+			PROFILE_SCOPE("Overhead");
+		}
+		enabledTime = static_cast<double>(Now() - begin) / (enabledIterations - 1);
+	});
+	thread.join();
+	SetEnabled(wasEnabled);
+
+	printf("プロファイラの手間: 区間1つあたり 無効 %.2f ns, 有効 %.2f ns\n", disabledTime, enabledTime);
+}
+
+bool Profiler::RunHeadlessTest(const std::filesystem::path& path)
+{
+	const uint32_t threadCount = 4;
+	const uint32_t frameCount = 100;
+
+	MeasureOverhead();
+	SetEnabled(true);
+	SetThreadName("Main");
+
+	// ワーカーは入れ子の区間を記録し、メインはGPUの区間の代わりを足す
+	std::vector<std::thread> threads;
+	for (uint32_t t = 0; t < threadCount; t++)
+	{
+		threads.emplace_back([t]()
+		{
+			auto name = "Worker " + std::to_string(t);
+			SetThreadName(name.c_str());
+			for (uint32_t frame = 0; frame < frameCount; frame++)
+			{
+				PROFILE_SCOPE("Frame");
+				{
+					PROFILE_SCOPE("Update");
+					Spin(20000);
+				}
+				{
+					PROFILE_SCOPE("Record");
+					Spin(30000);
+				}
+			}
+		});
+	}
+
+	for (uint32_t frame = 0; frame < frameCount; frame++)
+	{
+		PROFILE_SCOPE("Submit");
+		auto begin = Now();
+		Spin(50000);
+		AddGpuEvent("Graphics", "Frame", begin, Now());
+	}
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	SetEnabled(false);
+
+	auto expected = threadCount * frameCount * 3 + frameCount * 2;
+	auto count = EventCount();
+	auto written = WriteChromeTrace(path);
+	printf("トレースの書き出し: %s (区間 %u, 期待 %u, 捨てた数 %u)%s\n",
+		path.string().c_str(), count, expected, DroppedCount(), written && count == expected ? "" : " (失敗)");
+	return written && count == expected;
+}
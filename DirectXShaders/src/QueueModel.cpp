@@ -0,0 +1,136 @@
+#include "QueueModel.h"
+#include <algorithm>
+
+uint32_t QueueModel::AddQueue(const char* name)
+{
+	Queue queue;
+	queue.Name = name;
+	m_Queues.push_back(queue);
+	return static_cast<uint32_t>(m_Queues.size() - 1);
+}
+
+uint64_t QueueModel::Submit(uint32_t queue, double submitTime, double duration, const char* label)
+{
+	auto& q = m_Queues[queue];
+
+	Work work = {};
+	work.Label = label;
+	work.SubmitTime = submitTime;
+	work.Duration = duration;
+	work.Waits.swap(q.PendingWaits);
+	work.Start = -1.0;
+	work.End = -1.0;
+	q.Works.push_back(work);
+
+	return q.Works.size();
+}
+
+void QueueModel::Wait(uint32_t queue, uint32_t signalQueue, uint64_t value)
+{
+	// 0は最初からシグナルされている
+	if (value == 0)
+	{
+		return;
+	}
+	m_Queues[queue].PendingWaits.emplace_back(signalQueue, value);
+}
+
+uint64_t QueueModel::NextValue(uint32_t queue) const
+{
+	return m_Queues[queue].Works.size() + 1;
+}
+
+uint64_t QueueModel::CompletedValue(uint32_t queue, double time)
+{
+	Resolve();
+
+	// 同じキューの処理は順に終わるので、終わった時刻も積んだ順に並んでいる
+	auto& q = m_Queues[queue];
+	uint64_t value = 0;
+	while (value < q.ResolvedCount && q.Works[value].End <= time)
+	{
+		value++;
+	}
+	return value;
+}
+
+double QueueModel::SignalTime(uint32_t queue, uint64_t value)
+{
+	if (value == 0)
+	{
+		return 0.0;
+	}
+
+	Resolve();
+
+	auto& q = m_Queues[queue];
+	if (value > q.ResolvedCount)
+	{
+		return -1.0;
+	}
+	return q.Works[value - 1].End;
+}
+
+const std::vector<QueueModel::Work>& QueueModel::Works(uint32_t queue)
+{
+	Resolve();
+	return m_Queues[queue].Works;
+}
+
+bool QueueModel::HasUnresolved()
+{
+	Resolve();
+	for (auto& q : m_Queues)
+	{
+		if (q.ResolvedCount < q.Works.size())
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void QueueModel::Resolve()
+{
+	// どこかのキューで時刻が決まると、それを待っていた他のキューの処理も決められるようになる
+	bool progressed = true;
+	while (progressed)
+	{
+		progressed = false;
+		for (auto& q : m_Queues)
+		{
+			while (q.ResolvedCount < q.Works.size())
+			{
+				auto& work = q.Works[q.ResolvedCount];
+				auto ready = work.SubmitTime;
+				if (q.ResolvedCount > 0)
+				{
+					ready = std::max<double>(ready, q.Works[q.ResolvedCount - 1].End);
+				}
+
+				auto start = ready;
+				bool blocked = false;
+				for (auto& wait : work.Waits)
+				{
+					auto& other = m_Queues[wait.first];
+					if (wait.second > other.ResolvedCount)
+					{
+						blocked = true;
+						break;
+					}
+					start = std::max<double>(start, other.Works[wait.second - 1].End);
+				}
+				if (blocked)
+				{
+					break;
+				}
+
+				work.Start = start;
+				work.End = start + work.Duration;
+				work.StallTime = start - ready;
+				q.ResolvedCount++;
+				progressed = true;
+			}
+		}
+	}
+}
@@ -0,0 +1,750 @@
+#include "RenderGraph.h"
+#include <algorithm>
+#include <iterator>
+#include <queue>
+#include <stdio.h>
+#include <string>
+
+RenderGraph::ResourceHandle RenderGraph::Import(const char* name, uint32_t initialAccess, uint32_t finalAccess)
+{
+	ResourceNode node = {};
+	node.Name = name;
+	node.IsImported = true;
+	node.InitialAccess = initialAccess;
+	node.FinalAccess = finalAccess;
+	m_Resources.push_back(node);
+	return static_cast<ResourceHandle>(m_Resources.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::CreateTransient(const char* name, uint64_t size, uint64_t alignment)
+{
+	ResourceNode node = {};
+	node.Name = name;
+	node.IsImported = false;
+	node.Size = size;
+	node.Alignment = alignment > 0 ? alignment : 1;
+	m_Resources.push_back(node);
+	return static_cast<ResourceHandle>(m_Resources.size() - 1);
+}
+
+uint32_t RenderGraph::AddPass(const char* name, ExecuteFunc func)
+{
+	PassNode node = {};
+	node.Name = name;
+	node.Func = std::move(func);
+	m_Passes.push_back(std::move(node));
+	return static_cast<uint32_t>(m_Passes.size() - 1);
+}
+
+void RenderGraph::Read(uint32_t pass, ResourceHandle resource, uint32_t access)
+{
+	AddUse(pass, resource, access, false);
+}
+
+void RenderGraph::Write(uint32_t pass, ResourceHandle resource, uint32_t access)
+{
+	AddUse(pass, resource, access, true);
+}
+
+void RenderGraph::SetSideEffect(uint32_t pass)
+{
+	m_Passes[pass].HasSideEffect = true;
+}
+
+void RenderGraph::AddUse(uint32_t pass, ResourceHandle resource, uint32_t access, bool isWrite)
+{
+	if (pass >= m_Passes.size() || resource >= m_Resources.size())
+	{
+		printf("レンダーグラフ: 無効なパスかリソースが指定された\n");
+		return;
+	}
+
+	// 同じパスで同じリソースを複数回使う場合は1つにまとめる
+	for (auto& use : m_Passes[pass].Uses)
+	{
+		if (use.Resource == resource)
+		{
+			use.Access |= access;
+			use.IsWrite |= isWrite;
+			return;
+		}
+	}
+
+	m_Passes[pass].Uses.push_back({ resource, access, isWrite });
+}
+
+bool RenderGraph::Compile()
+{
+	auto passCount = static_cast<uint32_t>(m_Passes.size());
+	auto resourceCount = static_cast<uint32_t>(m_Resources.size());
+
+	m_Steps.clear();
+	m_Barriers.clear();
+	m_Discards.clear();
+	m_FinalBarriers.clear();
+	m_Stats = {};
+	m_Stats.PassCount = passCount;
+
+	// 依存関係 ----------------------------------------------------------------------------
+	// producersはデータの依存（読む・上書きする内容を書いたパス）で、削除の判定に使う
+	// successorsは読み終わる前に上書きしないための依存も含み、並べ替えに使う
+	std::vector<std::vector<uint32_t>> producers(passCount);
+	std::vector<std::vector<uint32_t>> successors(passCount);
+	std::vector<uint32_t> lastWriter(resourceCount, UINT32_MAX);
+	std::vector<std::vector<uint32_t>> readers(resourceCount);
+
+	for (uint32_t pass = 0; pass < passCount; pass++)
+	{
+		for (auto& use : m_Passes[pass].Uses)
+		{
+			auto writer = lastWriter[use.Resource];
+			if (writer != UINT32_MAX)
+			{
+				producers[pass].push_back(writer);
+				successors[writer].push_back(pass);
+			}
+
+			if (use.IsWrite)
+			{
+				for (auto reader : readers[use.Resource])
+				{
+					if (reader != pass)
+					{
+						successors[reader].push_back(pass);
+					}
+				}
+				readers[use.Resource].clear();
+				lastWriter[use.Resource] = pass;
+			}
+			else
+			{
+				readers[use.Resource].push_back(pass);
+			}
+		}
+	}
+
+	// 不要なパスの削除 --------------------------------------------------------------------
+	// 外部のリソースに書くパスと副作用のあるパスから、内容を使っているパスを遡る
+	std::vector<bool> needed(passCount, false);
+	for (uint32_t pass = 0; pass < passCount; pass++)
+	{
+		needed[pass] = m_Passes[pass].HasSideEffect;
+		for (auto& use : m_Passes[pass].Uses)
+		{
+			if (use.IsWrite && m_Resources[use.Resource].IsImported)
+			{
+				needed[pass] = true;
+			}
+		}
+	}
+
+	for (auto pass = passCount; pass-- > 0;)
+	{
+		if (needed[pass])
+		{
+			for (auto producer : producers[pass])
+			{
+				needed[producer] = true;
+			}
+		}
+	}
+
+	for (uint32_t pass = 0; pass < passCount; pass++)
+	{
+		m_Passes[pass].IsCulled = !needed[pass];
+		if (!needed[pass])
+		{
+			m_Stats.CulledPassCount++;
+		}
+	}
+
+	SortPasses(successors, needed);
+	if (m_Steps.size() != passCount - m_Stats.CulledPassCount)
+	{
+		printf("レンダーグラフ: パスの依存関係が循環している\n");
+		m_Steps.clear();
+		return false;
+	}
+
+	// リソースごとの使われ方を実行順に集める ------------------------------------------------
+	std::vector<std::vector<ResourceUse>> uses(resourceCount);
+	for (auto& resource : m_Resources)
+	{
+		resource.FirstUse = UINT32_MAX;
+		resource.LastUse = 0;
+		resource.HeapOffset = 0;
+		resource.CreationAccess = resource.InitialAccess;
+	}
+
+	for (uint32_t step = 0; step < m_Steps.size(); step++)
+	{
+		for (auto& use : m_Passes[m_Steps[step].Pass].Uses)
+		{
+			auto& resource = m_Resources[use.Resource];
+			resource.FirstUse = std::min(resource.FirstUse, step);
+			resource.LastUse = std::max(resource.LastUse, step);
+			uses[use.Resource].push_back({ step, use.Access, use.IsWrite });
+		}
+	}
+
+	PlaceTransients();
+	BuildBarriers(uses);
+	return true;
+}
+
+void RenderGraph::SortPasses(const std::vector<std::vector<uint32_t>>& successors, const std::vector<bool>& needed)
+{
+	auto passCount = static_cast<uint32_t>(m_Passes.size());
+
+	// トポロジカルソート。実行できるものが複数あれば宣言順に並べ、同じグラフからは必ず同じ順序になるようにする
+	std::vector<uint32_t> inDegree(passCount, 0);
+	for (uint32_t pass = 0; pass < passCount; pass++)
+	{
+		if (!needed[pass])
+		{
+			continue;
+		}
+		for (auto next : successors[pass])
+		{
+			if (needed[next])
+			{
+				inDegree[next]++;
+			}
+		}
+	}
+
+	std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> ready;
+	for (uint32_t pass = 0; pass < passCount; pass++)
+	{
+		if (needed[pass] && inDegree[pass] == 0)
+		{
+			ready.push(pass);
+		}
+	}
+
+	while (!ready.empty())
+	{
+		auto pass = ready.top();
+		ready.pop();
+		m_Steps.push_back({ pass, 0, 0, 0, 0 });
+
+		for (auto next : successors[pass])
+		{
+			if (needed[next] && --inDegree[next] == 0)
+			{
+				ready.push(next);
+			}
+		}
+	}
+}
+
+void RenderGraph::PlaceTransients()
+{
+	// 大きいものから順に、寿命の重なるリソースと被らない一番手前の位置に置く
+	std::vector<ResourceHandle> transients;
+	for (ResourceHandle i = 0; i < m_Resources.size(); i++)
+	{
+		if (!m_Resources[i].IsImported && IsUsed(i))
+		{
+			transients.push_back(i);
+			m_Stats.TransientBytes += m_Resources[i].Size;
+		}
+	}
+	m_Stats.TransientCount = static_cast<uint32_t>(transients.size());
+
+	std::stable_sort(transients.begin(), transients.end(), [this](ResourceHandle a, ResourceHandle b)
+	{
+		return m_Resources[a].Size > m_Resources[b].Size;
+	});
+
+	struct Range
+	{
+		uint64_t Begin;
+		uint64_t End;
+	};
+
+	std::vector<ResourceHandle> placed; // ヒープ上の位置の順
+	std::vector<Range> occupied;
+	for (auto handle : transients)
+	{
+		auto& resource = m_Resources[handle];
+
+		occupied.clear();
+		for (auto other : placed)
+		{
+			auto& o = m_Resources[other];
+			if (o.FirstUse <= resource.LastUse && resource.FirstUse <= o.LastUse)
+			{
+				occupied.push_back({ o.HeapOffset, o.HeapOffset + o.Size });
+			}
+		}
+
+		uint64_t offset = 0;
+		for (auto& range : occupied)
+		{
+			offset = (offset + resource.Alignment - 1) / resource.Alignment * resource.Alignment;
+			if (offset + resource.Size <= range.Begin)
+			{
+				break;
+			}
+			offset = std::max(offset, range.End);
+		}
+		offset = (offset + resource.Alignment - 1) / resource.Alignment * resource.Alignment;
+
+		resource.HeapOffset = offset;
+		m_Stats.HeapSize = std::max(m_Stats.HeapSize, offset + resource.Size);
+		auto it = std::upper_bound(placed.begin(), placed.end(), offset, [this](uint64_t value, ResourceHandle other)
+		{
+			return value < m_Resources[other].HeapOffset;
+		});
+		placed.insert(it, handle);
+	}
+}
+
+void RenderGraph::BuildBarriers(const std::vector<std::vector<ResourceUse>>& uses)
+{
+	struct PendingBarrier
+	{
+		uint32_t Step;
+		Barrier Value;
+	};
+	std::vector<PendingBarrier> pending;
+	std::vector<std::pair<uint32_t, ResourceHandle>> discards;
+
+	for (ResourceHandle handle = 0; handle < m_Resources.size(); handle++)
+	{
+		auto& resource = m_Resources[handle];
+		auto& resourceUses = uses[handle];
+		if (resourceUses.empty())
+		{
+			continue;
+		}
+
+		// 一時リソースはフレームの最後の状態で作っておき、毎フレームその状態から始める
+		uint32_t lastAccess = resourceUses.back().Access;
+		if (!resource.IsImported)
+		{
+			for (auto it = resourceUses.rbegin(); it != resourceUses.rend() && !it->IsWrite; ++it)
+			{
+				lastAccess |= it->Access; // 最後が読み込みの並びなら、まとめた状態で終わる
+			}
+			resource.CreationAccess = lastAccess;
+
+			// 同じメモリを使う他のリソースがあれば、使い始める時にエイリアシングバリアを張って中身を初期化する
+			// 直前にそのメモリを使っていたもの（フレーム内に無ければ前のフレームの最後のもの）を前のリソースにする
+			ResourceHandle previous = INVALID_RESOURCE;
+			uint32_t previousLastUse = 0;
+			bool previousInFrame = false;
+			for (ResourceHandle other = 0; other < m_Resources.size(); other++)
+			{
+				auto& o = m_Resources[other];
+				if (other == handle || o.IsImported || !IsUsed(other) ||
+					o.HeapOffset >= resource.HeapOffset + resource.Size || resource.HeapOffset >= o.HeapOffset + o.Size)
+				{
+					continue;
+				}
+
+				bool inFrame = o.LastUse < resource.FirstUse;
+				if (previous == INVALID_RESOURCE || (inFrame && !previousInFrame) ||
+					(inFrame == previousInFrame && o.LastUse > previousLastUse))
+				{
+					previous = other;
+					previousLastUse = o.LastUse;
+					previousInFrame = inFrame;
+				}
+			}
+
+			if (previous != INVALID_RESOURCE)
+			{
+				pending.push_back({ resource.FirstUse, { BARRIER_ALIASING, handle, previous, 0, 0 } });
+				discards.push_back({ resource.FirstUse, handle });
+				m_Stats.AliasingBarrierCount++;
+			}
+		}
+
+		auto current = resource.CreationAccess;
+		for (size_t i = 0; i < resourceUses.size();)
+		{
+			auto& use = resourceUses[i];
+			if (use.IsWrite)
+			{
+				if (current != use.Access)
+				{
+					pending.push_back({ use.Step, { BARRIER_TRANSITION, handle, INVALID_RESOURCE, current, use.Access } });
+				}
+				else if (use.Access & ACCESS_UNORDERED_ACCESS)
+				{
+					// UAVへの書き込みが続く場合は、前の書き込みの完了だけを待つ
+					pending.push_back({ use.Step, { BARRIER_UAV, handle, INVALID_RESOURCE, current, current } });
+				}
+				current = use.Access;
+				i++;
+				continue;
+			}
+
+			// 次の書き込みまでの読み込みは1回の遷移でまとめる
+			uint32_t readAccess = 0;
+			auto first = i;
+			while (i < resourceUses.size() && !resourceUses[i].IsWrite)
+			{
+				readAccess |= resourceUses[i].Access;
+				i++;
+			}
+
+			if (!IsReadOnly(current) || (current & readAccess) != readAccess)
+			{
+				pending.push_back({ resourceUses[first].Step, { BARRIER_TRANSITION, handle, INVALID_RESOURCE, current, readAccess } });
+				current = readAccess;
+			}
+		}
+
+		if (resource.IsImported && current != resource.FinalAccess)
+		{
+			m_FinalBarriers.push_back({ BARRIER_TRANSITION, handle, INVALID_RESOURCE, current, resource.FinalAccess });
+		}
+	}
+
+	// パスごとにまとめる（同じパスの中ではリソースごとに積んだ順のまま）
+	std::stable_sort(pending.begin(), pending.end(), [](const PendingBarrier& a, const PendingBarrier& b) { return a.Step < b.Step; });
+	std::stable_sort(discards.begin(), discards.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+	size_t barrierIndex = 0;
+	size_t discardIndex = 0;
+	for (uint32_t step = 0; step < m_Steps.size(); step++)
+	{
+		auto& s = m_Steps[step];
+		s.BarrierBegin = static_cast<uint32_t>(m_Barriers.size());
+		while (barrierIndex < pending.size() && pending[barrierIndex].Step == step)
+		{
+			m_Barriers.push_back(pending[barrierIndex++].Value);
+		}
+		s.BarrierCount = static_cast<uint32_t>(m_Barriers.size()) - s.BarrierBegin;
+
+		s.DiscardBegin = static_cast<uint32_t>(m_Discards.size());
+		while (discardIndex < discards.size() && discards[discardIndex].first == step)
+		{
+			m_Discards.push_back(discards[discardIndex++].second);
+		}
+		s.DiscardCount = static_cast<uint32_t>(m_Discards.size()) - s.DiscardBegin;
+	}
+
+	m_Stats.BarrierCount = static_cast<uint32_t>(m_Barriers.size() + m_FinalBarriers.size());
+}
+
+void RenderGraph::PrintStats() const
+{
+	printf("レンダーグラフ: パス %u (削除 %u), バリア %u (エイリアシング %u), 一時リソース %u個 %.2f MB -> ヒープ %.2f MB\n",
+		m_Stats.PassCount, m_Stats.CulledPassCount, m_Stats.BarrierCount, m_Stats.AliasingBarrierCount,
+		m_Stats.TransientCount, m_Stats.TransientBytes / (1024.0 * 1024.0), m_Stats.HeapSize / (1024.0 * 1024.0));
+}
+
+bool RenderGraph::Validate() const
+{
+	bool isValid = true;
+	auto fail = [&isValid](const char* message, const char* name)
+	{
+		if (isValid)
+		{
+			printf("  %s: %s\n", message, name);
+		}
+		isValid = false;
+	};
+
+	// 削除されたパスの出力を、残ったパスが読んでいない
+	std::vector<uint32_t> lastWriter(m_Resources.size(), UINT32_MAX);
+	for (uint32_t pass = 0; pass < m_Passes.size(); pass++)
+	{
+		for (auto& use : m_Passes[pass].Uses)
+		{
+			auto writer = lastWriter[use.Resource];
+			if (!m_Passes[pass].IsCulled && writer != UINT32_MAX && m_Passes[writer].IsCulled)
+			{
+				fail("削除したパスの出力を読んでいる", m_Passes[pass].Name.c_str());
+			}
+			if (use.IsWrite)
+			{
+				lastWriter[use.Resource] = pass;
+			}
+		}
+		if (m_Passes[pass].IsCulled && m_Passes[pass].HasSideEffect)
+		{
+			fail("副作用のあるパスを削除した", m_Passes[pass].Name.c_str());
+		}
+	}
+
+	// 寿命の重なる一時リソースはヒープ上で重ならない
+	for (ResourceHandle a = 0; a < m_Resources.size(); a++)
+	{
+		auto& ra = m_Resources[a];
+		if (ra.IsImported || !IsUsed(a))
+		{
+			continue;
+		}
+		if (ra.HeapOffset % ra.Alignment != 0 || ra.HeapOffset + ra.Size > m_Stats.HeapSize)
+		{
+			fail("ヒープ上の位置が不正", ra.Name.c_str());
+		}
+		for (ResourceHandle b = a + 1; b < m_Resources.size(); b++)
+		{
+			auto& rb = m_Resources[b];
+			if (rb.IsImported || !IsUsed(b))
+			{
+				continue;
+			}
+			bool livesTogether = ra.FirstUse <= rb.LastUse && rb.FirstUse <= ra.LastUse;
+			bool sharesMemory = ra.HeapOffset < rb.HeapOffset + rb.Size && rb.HeapOffset < ra.HeapOffset + ra.Size;
+			if (livesTogether && sharesMemory)
+			{
+				fail("寿命の重なるリソースがメモリを共有している", rb.Name.c_str());
+			}
+		}
+	}
+
+	// バリアを実行順に適用し、各パスが使う前に宣言通りの状態になっていること
+	std::vector<uint32_t> states(m_Resources.size());
+	for (ResourceHandle i = 0; i < m_Resources.size(); i++)
+	{
+		states[i] = m_Resources[i].IsImported ? m_Resources[i].InitialAccess : m_Resources[i].CreationAccess;
+	}
+	auto apply = [&](const Barrier& barrier)
+	{
+		if (barrier.Type != BARRIER_TRANSITION)
+		{
+			return;
+		}
+		if (states[barrier.Resource] != barrier.Before)
+		{
+			fail("遷移前の状態が違う", m_Resources[barrier.Resource].Name.c_str());
+		}
+		states[barrier.Resource] = barrier.After;
+	};
+
+	for (auto& step : m_Steps)
+	{
+		for (uint32_t i = 0; i < step.BarrierCount; i++)
+		{
+			apply(m_Barriers[step.BarrierBegin + i]);
+		}
+		for (auto& use : m_Passes[step.Pass].Uses)
+		{
+			auto state = states[use.Resource];
+			bool isReady = use.IsWrite ? state == use.Access : (state & use.Access) == use.Access && IsReadOnly(state);
+			if (!isReady)
+			{
+				fail("パスの前の状態が違う", m_Passes[step.Pass].Name.c_str());
+			}
+		}
+	}
+	for (auto& barrier : m_FinalBarriers)
+	{
+		apply(barrier);
+	}
+
+	// フレームの最後は、外部のリソースは指定の状態に、一時リソースは作った時の状態に戻っている
+	for (ResourceHandle i = 0; i < m_Resources.size(); i++)
+	{
+		auto& resource = m_Resources[i];
+		auto expected = resource.IsImported ? resource.FinalAccess : resource.CreationAccess;
+		if (IsUsed(i) && states[i] != expected)
+		{
+			fail("フレームの最後の状態が違う", resource.Name.c_str());
+		}
+	}
+	return isValid;
+}
+
+void RenderGraph::BuildSyntheticGraph(RenderGraph& graph, uint32_t passCount, uint32_t seed)
+{
+	const uint64_t Megabyte = 1024 * 1024;
+	const uint64_t Alignment = 64 * 1024;
+	auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+
+	auto backBuffer = graph.Import("BackBuffer", ACCESS_PRESENT, ACCESS_PRESENT);
+	auto depth = graph.CreateTransient("Depth", 8 * Megabyte, Alignment);
+	auto depthPass = graph.AddPass("Depth", nullptr);
+	graph.Write(depthPass, depth, ACCESS_DEPTH_WRITE);
+
+	// 各パスは直近の出力を1～2個読み、新しい一時リソースに書く
+	std::vector<ResourceHandle> outputs = { depth };
+	for (uint32_t i = 1; i + 1 < passCount; i++)
+	{
+		auto name = "Pass" + std::to_string(i);
+		auto output = graph.CreateTransient(name.c_str(), (1 + next() % 8) * Megabyte, Alignment);
+		auto pass = graph.AddPass(name.c_str(), nullptr);
+
+		auto readCount = 1 + next() % 2;
+		for (uint32_t r = 0; r < readCount; r++)
+		{
+			auto window = std::min<size_t>(outputs.size(), 8);
+			auto input = outputs[outputs.size() - 1 - next() % window];
+			graph.Read(pass, input, input == depth ? ACCESS_DEPTH_READ : (next() % 2 == 0 ? ACCESS_PIXEL_SHADER : ACCESS_NON_PIXEL_SHADER));
+		}
+		graph.Write(pass, output, next() % 3 == 0 ? ACCESS_UNORDERED_ACCESS : ACCESS_RENDER_TARGET);
+
+		// 出力を誰も読まないパス（デバッグ表示など）は削除される
+		if (next() % 8 != 0)
+		{
+			outputs.push_back(output);
+		}
+	}
+
+	auto composite = graph.AddPass("Composite", nullptr);
+	graph.Read(composite, outputs.back(), ACCESS_PIXEL_SHADER);
+	graph.Write(composite, backBuffer, ACCESS_RENDER_TARGET);
+}
+
+bool RenderGraph::RunTest()
+{
+	const uint64_t Megabyte = 1024 * 1024;
+	const uint64_t Alignment = 64 * 1024;
+	bool isValid = true;
+
+	// 手で結果を求めた小さなグラフ。Debugの出力は誰も読まないので削除され、Readbackは副作用があるので残る
+	RenderGraph graph;
+	auto backBuffer = graph.Import("BackBuffer", ACCESS_PRESENT, ACCESS_PRESENT);
+	auto depth = graph.CreateTransient("Depth", 4 * Megabyte, Alignment);
+	auto gbuffer = graph.CreateTransient("GBuffer", 8 * Megabyte, Alignment);
+	auto lighting = graph.CreateTransient("Lighting", 8 * Megabyte, Alignment);
+	auto bloom = graph.CreateTransient("Bloom", 2 * Megabyte, Alignment);
+	auto debug = graph.CreateTransient("Debug", 1 * Megabyte, Alignment);
+	// 読み込みの状態で渡されるが、別の読み込みの状態で使うので遷移が要る
+	auto environment = graph.Import("Environment", ACCESS_PIXEL_SHADER, ACCESS_PIXEL_SHADER);
+
+	auto depthPass = graph.AddPass("Depth", nullptr);
+	graph.Write(depthPass, depth, ACCESS_DEPTH_WRITE);
+	auto gbufferPass = graph.AddPass("GBuffer", nullptr);
+	graph.Read(gbufferPass, depth, ACCESS_DEPTH_READ);
+	graph.Write(gbufferPass, gbuffer, ACCESS_RENDER_TARGET);
+	auto debugPass = graph.AddPass("Debug", nullptr);
+	graph.Read(debugPass, gbuffer, ACCESS_PIXEL_SHADER);
+	graph.Write(debugPass, debug, ACCESS_RENDER_TARGET);
+	auto lightingPass = graph.AddPass("Lighting", nullptr);
+	graph.Read(lightingPass, gbuffer, ACCESS_NON_PIXEL_SHADER);
+	graph.Read(lightingPass, environment, ACCESS_NON_PIXEL_SHADER);
+	graph.Write(lightingPass, lighting, ACCESS_UNORDERED_ACCESS);
+	auto resolvePass = graph.AddPass("Resolve", nullptr);
+	graph.Write(resolvePass, lighting, ACCESS_UNORDERED_ACCESS);
+	auto bloomPass = graph.AddPass("Bloom", nullptr);
+	graph.Read(bloomPass, lighting, ACCESS_PIXEL_SHADER);
+	graph.Write(bloomPass, bloom, ACCESS_RENDER_TARGET);
+	auto compositePass = graph.AddPass("Composite", nullptr);
+	graph.Read(compositePass, lighting, ACCESS_PIXEL_SHADER);
+	graph.Read(compositePass, bloom, ACCESS_PIXEL_SHADER);
+	graph.Write(compositePass, backBuffer, ACCESS_RENDER_TARGET);
+	auto readbackPass = graph.AddPass("Readback", nullptr);
+	graph.Read(readbackPass, bloom, ACCESS_COPY_SOURCE);
+	graph.SetSideEffect(readbackPass);
+
+	if (!graph.Compile() || !graph.Validate())
+	{
+		printf("  小さなグラフのコンパイル結果が不正\n");
+		printf("レンダーグラフのテスト: 失敗\n");
+		return false;
+	}
+
+	std::vector<uint32_t> expectedPasses = { depthPass, gbufferPass, lightingPass, resolvePass, bloomPass, compositePass, readbackPass };
+	bool passesMatch = graph.Steps().size() == expectedPasses.size() && graph.IsCulled(debugPass) && !graph.IsUsed(debug);
+	for (size_t i = 0; passesMatch && i < expectedPasses.size(); i++)
+	{
+		passesMatch = graph.Steps()[i].Pass == expectedPasses[i];
+	}
+	if (!passesMatch)
+	{
+		printf("  削除されたパスか実行順が違う\n");
+		isValid = false;
+	}
+
+	// 大きい順に置く。GBufferとBloom、LightingとDepthは寿命が重ならないので同じメモリを使う
+	bool placementMatches = graph.HeapOffset(gbuffer) == 0 && graph.HeapOffset(lighting) == 8 * Megabyte
+		&& graph.HeapOffset(depth) == 8 * Megabyte && graph.HeapOffset(bloom) == 0 && graph.HeapSize() == 16 * Megabyte
+		&& graph.GetStats().TransientBytes == 22 * Megabyte;
+	if (!placementMatches)
+	{
+		printf("  ヒープ上の位置が違う (Depth %llu, GBuffer %llu, Lighting %llu, Bloom %llu, ヒープ %llu)\n",
+			static_cast<unsigned long long>(graph.HeapOffset(depth)), static_cast<unsigned long long>(graph.HeapOffset(gbuffer)),
+			static_cast<unsigned long long>(graph.HeapOffset(lighting)), static_cast<unsigned long long>(graph.HeapOffset(bloom)),
+			static_cast<unsigned long long>(graph.HeapSize()));
+		isValid = false;
+	}
+
+	// 一時リソースはフレームの最後の状態で作られるので、最初の書き込みの前にもその状態からの遷移が要る
+	// 同じメモリを使い始める時は、直前の持ち主（フレーム内に無ければ前のフレームの最後の持ち主）とのエイリアシングバリアを張る
+	const uint32_t ShaderRead = ACCESS_PIXEL_SHADER | ACCESS_COPY_SOURCE;
+	struct ExpectedBarrier
+	{
+		uint32_t Step;
+		BarrierType Type;
+		ResourceHandle Resource;
+		ResourceHandle AliasBefore;
+		uint32_t Before;
+		uint32_t After;
+	};
+	const ExpectedBarrier expectedBarriers[] =
+	{
+		{ 0, BARRIER_ALIASING, depth, lighting, 0, 0 },
+		{ 0, BARRIER_TRANSITION, depth, INVALID_RESOURCE, ACCESS_DEPTH_READ, ACCESS_DEPTH_WRITE },
+		{ 1, BARRIER_TRANSITION, depth, INVALID_RESOURCE, ACCESS_DEPTH_WRITE, ACCESS_DEPTH_READ },
+		{ 1, BARRIER_ALIASING, gbuffer, bloom, 0, 0 },
+		{ 1, BARRIER_TRANSITION, gbuffer, INVALID_RESOURCE, ACCESS_NON_PIXEL_SHADER, ACCESS_RENDER_TARGET },
+		{ 2, BARRIER_TRANSITION, gbuffer, INVALID_RESOURCE, ACCESS_RENDER_TARGET, ACCESS_NON_PIXEL_SHADER },
+		{ 2, BARRIER_ALIASING, lighting, depth, 0, 0 },
+		{ 2, BARRIER_TRANSITION, lighting, INVALID_RESOURCE, ACCESS_PIXEL_SHADER, ACCESS_UNORDERED_ACCESS },
+		{ 2, BARRIER_TRANSITION, environment, INVALID_RESOURCE, ACCESS_PIXEL_SHADER, ACCESS_NON_PIXEL_SHADER },
+		{ 3, BARRIER_UAV, lighting, INVALID_RESOURCE, ACCESS_UNORDERED_ACCESS, ACCESS_UNORDERED_ACCESS },
+		{ 4, BARRIER_TRANSITION, lighting, INVALID_RESOURCE, ACCESS_UNORDERED_ACCESS, ACCESS_PIXEL_SHADER },
+		{ 4, BARRIER_ALIASING, bloom, gbuffer, 0, 0 },
+		{ 4, BARRIER_TRANSITION, bloom, INVALID_RESOURCE, ShaderRead, ACCESS_RENDER_TARGET },
+		{ 5, BARRIER_TRANSITION, backBuffer, INVALID_RESOURCE, ACCESS_PRESENT, ACCESS_RENDER_TARGET },
+		{ 5, BARRIER_TRANSITION, bloom, INVALID_RESOURCE, ACCESS_RENDER_TARGET, ShaderRead },
+	};
+
+	std::vector<ExpectedBarrier> actual;
+	for (uint32_t step = 0; step < graph.Steps().size(); step++)
+	{
+		auto& s = graph.Steps()[step];
+		for (uint32_t i = 0; i < s.BarrierCount; i++)
+		{
+			auto& b = graph.Barriers()[s.BarrierBegin + i];
+			actual.push_back({ step, b.Type, b.Resource, b.AliasBefore, b.Before, b.After });
+		}
+	}
+	bool barriersMatch = actual.size() == std::size(expectedBarriers);
+	for (size_t i = 0; barriersMatch && i < actual.size(); i++)
+	{
+		auto& a = actual[i];
+		auto& e = expectedBarriers[i];
+		barriersMatch = a.Step == e.Step && a.Type == e.Type && a.Resource == e.Resource
+			&& (a.Type != BARRIER_ALIASING || a.AliasBefore == e.AliasBefore)
+			&& (a.Type == BARRIER_ALIASING || (a.Before == e.Before && a.After == e.After));
+	}
+	auto& finalBarriers = graph.FinalBarriers();
+	bool finalMatches = finalBarriers.size() == 2
+		&& finalBarriers[0].Resource == backBuffer && finalBarriers[0].Before == ACCESS_RENDER_TARGET && finalBarriers[0].After == ACCESS_PRESENT
+		&& finalBarriers[1].Resource == environment && finalBarriers[1].Before == ACCESS_NON_PIXEL_SHADER && finalBarriers[1].After == ACCESS_PIXEL_SHADER;
+	std::vector<ResourceHandle> expectedDiscards = { depth, gbuffer, lighting, bloom };
+	if (!barriersMatch || !finalMatches || graph.Discards() != expectedDiscards || graph.GetStats().AliasingBarrierCount != 4)
+	{
+		printf("  バリアが違う (%zu個, 期待 %zu個)\n", actual.size(), std::size(expectedBarriers));
+		isValid = false;
+	}
+
+	// 合成した大きなグラフは、結果を手で求める代わりに実行順に追って確かめる
+	for (uint32_t seed : { 1u, 2u, 3u })
+	{
+		RenderGraph synthetic;
+		BuildSyntheticGraph(synthetic, 500, seed);
+		if (!synthetic.Compile() || !synthetic.Validate())
+		{
+			printf("  合成したグラフ (種 %u) の結果が不正\n", seed);
+			isValid = false;
+		}
+		else if (synthetic.GetStats().CulledPassCount == 0 || synthetic.HeapSize() >= synthetic.GetStats().TransientBytes)
+		{
+			printf("  合成したグラフ (種 %u) でパスが削除されていないか、メモリが重ねられていない\n", seed);
+			isValid = false;
+		}
+	}
+
+	printf("レンダーグラフのテスト: %s\n", isValid ? "成功" : "失敗");
+	return isValid;
+}
@@ -0,0 +1,313 @@
+#include "RenderGraphExecutor.h"
+#include "Engine.h"
+#include "GpuProfiler.h"
+#include "Profiler.h"
+#include <d3dx12.h>
+#include <stdio.h>
+
+RenderGraphExecutor::~RenderGraphExecutor()
+{
+	ReleaseTransients();
+}
+
+void RenderGraphExecutor::Init(ID3D12Device* device, RenderGraph* graph)
+{
+	m_pDevice = device;
+	m_pGraph = graph;
+}
+
+RenderGraph::ResourceHandle RenderGraphExecutor::CreateTexture(const char* name, const D3D12_RESOURCE_DESC& desc, const D3D12_CLEAR_VALUE* pClearValue)
+{
+	auto info = m_pDevice->GetResourceAllocationInfo(0, 1, &desc);
+	auto handle = m_pGraph->CreateTransient(name, info.SizeInBytes, info.Alignment);
+
+	m_Entries.resize(m_pGraph->ResourceCount());
+	auto& entry = m_Entries[handle];
+	entry.IsTransient = true;
+	entry.Desc = desc;
+	entry.HasClearValue = pClearValue != nullptr;
+	if (pClearValue != nullptr)
+	{
+		entry.ClearValue = *pClearValue;
+	}
+	return handle;
+}
+
+RenderGraph::ResourceHandle RenderGraphExecutor::Import(const char* name, uint32_t initialAccess, uint32_t finalAccess)
+{
+	auto handle = m_pGraph->Import(name, initialAccess, finalAccess);
+	m_Entries.resize(m_pGraph->ResourceCount());
+	return handle;
+}
+
+void RenderGraphExecutor::SetImported(RenderGraph::ResourceHandle handle, ID3D12Resource* resource,
+	D3D12_CPU_DESCRIPTOR_HANDLE rtv, D3D12_CPU_DESCRIPTOR_HANDLE dsv)
+{
+	auto& entry = m_Entries[handle];
+	entry.pResource = resource;
+	entry.Rtv = rtv;
+	entry.Dsv = dsv;
+}
+
+bool RenderGraphExecutor::Compile()
+{
+	if (!m_pGraph->Compile())
+	{
+		return false;
+	}
+
+	ReleaseTransients();
+	return CreateTransients();
+}
+
+bool RenderGraphExecutor::CreateTransients()
+{
+	auto heapSize = m_pGraph->HeapSize();
+	if (heapSize == 0)
+	{
+		return true;
+	}
+
+	D3D12_HEAP_DESC heapDesc = {};
+	heapDesc.SizeInBytes = heapSize;
+	heapDesc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+	auto hr = m_pDevice->CreateHeap(&heapDesc, IID_PPV_ARGS(m_pHeap.ReleaseAndGetAddressOf()));
+	if (FAILED(hr))
+	{
+		printf("レンダーグラフのヒープの生成に失敗\n");
+		return false;
+	}
+
+	// ビュー用のディスクリプタヒープ（一時リソースの数だけ）
+	UINT rtvCount = 0;
+	UINT dsvCount = 0;
+	for (RenderGraph::ResourceHandle i = 0; i < m_Entries.size(); i++)
+	{
+		if (m_Entries[i].IsTransient && m_pGraph->IsUsed(i))
+		{
+			rtvCount += (m_Entries[i].Desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET) ? 1 : 0;
+			dsvCount += (m_Entries[i].Desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL) ? 1 : 0;
+		}
+	}
+
+	D3D12_DESCRIPTOR_HEAP_DESC descriptorDesc = {};
+	if (rtvCount > 0)
+	{
+		descriptorDesc.NumDescriptors = rtvCount;
+		descriptorDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+		hr = m_pDevice->CreateDescriptorHeap(&descriptorDesc, IID_PPV_ARGS(m_pRtvHeap.ReleaseAndGetAddressOf()));
+		if (FAILED(hr))
+		{
+			return false;
+		}
+	}
+	if (dsvCount > 0)
+	{
+		descriptorDesc.NumDescriptors = dsvCount;
+		descriptorDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
+		hr = m_pDevice->CreateDescriptorHeap(&descriptorDesc, IID_PPV_ARGS(m_pDsvHeap.ReleaseAndGetAddressOf()));
+		if (FAILED(hr))
+		{
+			return false;
+		}
+	}
+
+	auto rtvSize = m_pDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+	auto dsvSize = m_pDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+	UINT rtvIndex = 0;
+	UINT dsvIndex = 0;
+
+	for (RenderGraph::ResourceHandle i = 0; i < m_Entries.size(); i++)
+	{
+		auto& entry = m_Entries[i];
+		if (!entry.IsTransient || !m_pGraph->IsUsed(i))
+		{
+			continue;
+		}
+
+		// フレームの最後の状態で作っておくと、毎フレーム同じ状態から始められる
+		auto state = ToResourceState(m_pGraph->CreationAccess(i));
+		hr = m_pDevice->CreatePlacedResource(m_pHeap.Get(), m_pGraph->HeapOffset(i), &entry.Desc, state,
+			entry.HasClearValue ? &entry.ClearValue : nullptr, IID_PPV_ARGS(&entry.pResource));
+		if (FAILED(hr))
+		{
+			printf("レンダーグラフの一時リソース(%s)の生成に失敗\n", m_pGraph->ResourceName(i));
+			return false;
+		}
+
+		if (entry.Desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET)
+		{
+			entry.Rtv = m_pRtvHeap->GetCPUDescriptorHandleForHeapStart();
+			entry.Rtv.ptr += rtvIndex++ * rtvSize;
+			m_pDevice->CreateRenderTargetView(entry.pResource, nullptr, entry.Rtv);
+		}
+		if (entry.Desc.Flags & D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)
+		{
+			entry.Dsv = m_pDsvHeap->GetCPUDescriptorHandleForHeapStart();
+			entry.Dsv.ptr += dsvIndex++ * dsvSize;
+			m_pDevice->CreateDepthStencilView(entry.pResource, nullptr, entry.Dsv);
+		}
+	}
+
+	return true;
+}
+
+void RenderGraphExecutor::ReleaseTransients()
+{
+	// 前のフレームで使っている可能性があるので、GPUが使い終わってから解放する
+	auto releaseQueue = g_Engine != nullptr ? g_Engine->ReleaseQueue() : nullptr;
+	for (auto& entry : m_Entries)
+	{
+		if (entry.IsTransient && entry.pResource != nullptr)
+		{
+			if (releaseQueue != nullptr)
+			{
+				releaseQueue->Release(entry.pResource);
+			}
+			else
+			{
+				entry.pResource->Release();
+			}
+			entry.pResource = nullptr;
+		}
+	}
+
+	if (releaseQueue != nullptr)
+	{
+		releaseQueue->Release(m_pHeap.Detach(), m_pGraph != nullptr ? m_pGraph->HeapSize() : 0);
+		releaseQueue->Release(m_pRtvHeap.Detach());
+		releaseQueue->Release(m_pDsvHeap.Detach());
+	}
+	else
+	{
+		m_pHeap.Reset();
+		m_pRtvHeap.Reset();
+		m_pDsvHeap.Reset();
+	}
+}
+
+D3D12_RESOURCE_STATES RenderGraphExecutor::ToResourceState(uint32_t access)
+{
+	D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COMMON;
+	if (access & RenderGraph::ACCESS_RENDER_TARGET) state |= D3D12_RESOURCE_STATE_RENDER_TARGET;
+	if (access & RenderGraph::ACCESS_DEPTH_WRITE) state |= D3D12_RESOURCE_STATE_DEPTH_WRITE;
+	if (access & RenderGraph::ACCESS_UNORDERED_ACCESS) state |= D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+	if (access & RenderGraph::ACCESS_COPY_DEST) state |= D3D12_RESOURCE_STATE_COPY_DEST;
+	if (access & RenderGraph::ACCESS_DEPTH_READ) state |= D3D12_RESOURCE_STATE_DEPTH_READ;
+	if (access & RenderGraph::ACCESS_PIXEL_SHADER) state |= D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+	if (access & RenderGraph::ACCESS_NON_PIXEL_SHADER) state |= D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+	if (access & RenderGraph::ACCESS_COPY_SOURCE) state |= D3D12_RESOURCE_STATE_COPY_SOURCE;
+	if (access & RenderGraph::ACCESS_PRESENT) state |= D3D12_RESOURCE_STATE_PRESENT;
+	if (access & RenderGraph::ACCESS_INDIRECT_ARGUMENT) state |= D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT;
+	return state;
+}
+
+void RenderGraphExecutor::AddBarriers(const RenderGraph::Barrier* pBarriers, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		auto& barrier = pBarriers[i];
+		auto resource = m_Entries[barrier.Resource].pResource;
+		switch (barrier.Type)
+		{
+		case RenderGraph::BARRIER_TRANSITION:
+			m_Barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(resource,
+				ToResourceState(barrier.Before), ToResourceState(barrier.After)));
+			break;
+
+		case RenderGraph::BARRIER_ALIASING:
+			m_Barriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(m_Entries[barrier.AliasBefore].pResource, resource));
+			break;
+
+		case RenderGraph::BARRIER_UAV:
+			m_Barriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(resource));
+			break;
+		}
+	}
+}
+
+void RenderGraphExecutor::Execute(ID3D12GraphicsCommandList* commandList)
+{
+	m_pCommandList = commandList;
+
+	auto& barriers = m_pGraph->Barriers();
+	auto& discards = m_pGraph->Discards();
+	for (auto& step : m_pGraph->Steps())
+	{
+		m_Barriers.clear();
+		AddBarriers(barriers.data() + step.BarrierBegin, step.BarrierCount);
+		if (!m_Barriers.empty())
+		{
+			commandList->ResourceBarrier(static_cast<UINT>(m_Barriers.size()), m_Barriers.data());
+		}
+
+		// 他のリソースとメモリを共有している場合、内容は不定なのでRT/DSは使う前に初期化する
+		for (uint32_t i = 0; i < step.DiscardCount; i++)
+		{
+			auto& entry = m_Entries[discards[step.DiscardBegin + i]];
+			if (entry.Desc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL))
+			{
+				commandList->DiscardResource(entry.pResource, nullptr);
+			}
+		}
+
+		// GPUの区間はパスがリストを取り出した時に始めるので、描画を他のリストに記録するパスはメインのリストでは測らない
+		auto& func = m_pGraph->PassFunction(step.Pass);
+		if (func)
+		{
+			m_PassName = m_pGraph->PassName(step.Pass);
+			m_HasPassGpuScope = false;
+			m_IsPassGpuScopeOnMainList = false;
+			ProfileScope cpuScope(m_PassName);
+			func(*this);
+			if (m_IsPassGpuScopeOnMainList)
+			{
+				m_pProfiler->End(commandList, m_PassGpuScope);
+			}
+		}
+	}
+
+	m_pCommandList = nullptr;
+	m_PassName = nullptr;
+}
+
+ID3D12GraphicsCommandList* RenderGraphExecutor::CommandList()
+{
+	if (m_pProfiler != nullptr && m_PassName != nullptr && !m_HasPassGpuScope)
+	{
+		m_PassGpuScope = m_pProfiler->Begin(m_pCommandList, m_PassName);
+		m_HasPassGpuScope = true;
+		m_IsPassGpuScopeOnMainList = true;
+	}
+	return m_pCommandList;
+}
+
+void RenderGraphExecutor::BeginGpuScopeOn(ID3D12GraphicsCommandList* first)
+{
+	if (m_pProfiler != nullptr && m_PassName != nullptr && !m_HasPassGpuScope)
+	{
+		m_PassGpuScope = m_pProfiler->Begin(first, m_PassName);
+		m_HasPassGpuScope = true;
+	}
+}
+
+void RenderGraphExecutor::EndGpuScopeOn(ID3D12GraphicsCommandList* last)
+{
+	if (m_HasPassGpuScope && !m_IsPassGpuScopeOnMainList)
+	{
+		m_pProfiler->End(last, m_PassGpuScope);
+	}
+}
+
+void RenderGraphExecutor::FlushFinalBarriers(ID3D12GraphicsCommandList* commandList)
+{
+	auto& barriers = m_pGraph->FinalBarriers();
+	m_Barriers.clear();
+	AddBarriers(barriers.data(), static_cast<uint32_t>(barriers.size()));
+	if (!m_Barriers.empty())
+	{
+		commandList->ResourceBarrier(static_cast<UINT>(m_Barriers.size()), m_Barriers.data());
+	}
+}
@@ -0,0 +1,487 @@
+#include "ResourceStateTracker.h"
+#include <stdio.h>
+
+namespace
+{
+	// 読み取りだけの状態（暗黙に昇格した後、実行が終わるとCOMMONに減衰する）
+	const uint32_t ReadOnlyStates = RHI_STATE_VERTEX_AND_CONSTANT_BUFFER | RHI_STATE_INDEX_BUFFER | RHI_STATE_DEPTH_READ
+		| RHI_STATE_NON_PIXEL_SHADER_RESOURCE | RHI_STATE_PIXEL_SHADER_RESOURCE | RHI_STATE_INDIRECT_ARGUMENT | RHI_STATE_COPY_SOURCE;
+	// 同時アクセスでないテクスチャがCOMMONから昇格できる状態
+	const uint32_t TexturePromotableStates = RHI_STATE_NON_PIXEL_SHADER_RESOURCE | RHI_STATE_PIXEL_SHADER_RESOURCE
+		| RHI_STATE_COPY_SOURCE | RHI_STATE_COPY_DEST;
+}
+
+template<typename Backend>
+std::mutex BasicResourceStateTracker<Backend>::s_Mutex;
+template<typename Backend>
+std::unordered_map<typename Backend::Resource*, typename BasicResourceStateTracker<Backend>::TrackedState> BasicResourceStateTracker<Backend>::s_KnownStates;
+
+template<typename Backend>
+RhiResourceStates BasicResourceStateTracker<Backend>::TrackedState::Get(UINT subresource) const
+{
+	if (IsUniform() || subresource == RHI_ALL_SUBRESOURCES)
+	{
+		return State;
+	}
+	return Subresources[subresource];
+}
+
+template<typename Backend>
+void BasicResourceStateTracker<Backend>::Register(Resource* resource, RhiResourceStates state, UINT subresourceCount, bool isBuffer)
+{
+	if (resource == nullptr)
+	{
+		return;
+	}
+
+	TrackedState tracked;
+	tracked.State = state;
+	tracked.SubresourceCount = subresourceCount;
+	tracked.IsBuffer = isBuffer;
+
+	std::lock_guard<std::mutex> lock(s_Mutex);
+	s_KnownStates[resource] = tracked;
+}
+
+template<typename Backend>
+void BasicResourceStateTracker<Backend>::Unregister(Resource* resource)
+{
+	std::lock_guard<std::mutex> lock(s_Mutex);
+	s_KnownStates.erase(resource);
+}
+
+template<typename Backend>
+bool BasicResourceStateTracker<Backend>::GetKnownState(Resource* resource, UINT subresource, RhiResourceStates* pState)
+{
+	std::lock_guard<std::mutex> lock(s_Mutex);
+	auto it = s_KnownStates.find(resource);
+	if (it == s_KnownStates.end())
+	{
+		return false;
+	}
+
+	*pState = it->second.Get(subresource);
+	return true;
+}
+
+template<typename Backend>
+typename BasicResourceStateTracker<Backend>::TrackedState* BasicResourceStateTracker<Backend>::FindOrFetch(Resource* resource)
+{
+	auto it = m_States.find(resource);
+	if (it != m_States.end())
+	{
+		return &it->second;
+	}
+
+	// このコマンドリストで初めて触るリソースは共有の状態から開始する
+	std::lock_guard<std::mutex> lock(s_Mutex);
+	auto known = s_KnownStates.find(resource);
+	if (known == s_KnownStates.end())
+	{
+		return nullptr;
+	}
+
+	return &m_States.emplace(resource, known->second).first->second;
+}
+
+template<typename Backend>
+void BasicResourceStateTracker<Backend>::AddBarrier(Resource* resource, UINT subresource,
+	RhiResourceStates before, RhiResourceStates after, RhiBarrierFlags flags)
+{
+	// 未発行の A->B に続く B->C は A->C にまとめる（A->A になったら消す）
+	if (flags == RHI_BARRIER_FLAG_NONE)
+	{
+		for (auto it = m_PendingBarriers.rbegin(); it != m_PendingBarriers.rend(); ++it)
+		{
+			auto& pending = it->Transition;
+			if (pending.pResource != resource || pending.Subresource != subresource)
+			{
+				continue;
+			}
+
+			if (it->Flags == RHI_BARRIER_FLAG_NONE && pending.StateAfter == before)
+			{
+				pending.StateAfter = after;
+				if (pending.StateBefore == after)
+				{
+					m_PendingBarriers.erase(std::next(it).base());
+				}
+				return;
+			}
+			break;
+		}
+	}
+
+	Barrier barrier = {};
+	barrier.Type = RHI_BARRIER_TYPE_TRANSITION;
+	barrier.Flags = flags;
+	barrier.Transition.pResource = resource;
+	barrier.Transition.Subresource = subresource;
+	barrier.Transition.StateBefore = before;
+	barrier.Transition.StateAfter = after;
+	m_PendingBarriers.push_back(barrier);
+}
+
+// バッファはCOMMONからどの状態にも、テクスチャはシェーダーリソースとコピーの状態にだけ暗黙に昇格できる
+template<typename Backend>
+bool BasicResourceStateTracker<Backend>::CanPromote(const TrackedState& state, RhiResourceStates after)
+{
+	if (state.State != RHI_STATE_COMMON || !state.IsUniform())
+	{
+		return false;
+	}
+	return state.IsBuffer || (static_cast<uint32_t>(after) & ~TexturePromotableStates) == 0;
+}
+
+// ExecuteCommandListsの後の減衰。バッファは全て、テクスチャは読み取りに昇格したものだけCOMMONに戻る
+template<typename Backend>
+void BasicResourceStateTracker<Backend>::Decay(TrackedState& state)
+{
+	bool promotedToRead = state.Promoted && state.IsUniform() && (static_cast<uint32_t>(state.State) & ~ReadOnlyStates) == 0;
+	if (state.IsBuffer || promotedToRead)
+	{
+		state.Subresources.clear();
+		state.State = RHI_STATE_COMMON;
+	}
+	state.Promoted = false;
+}
+
+template<typename Backend>
+void BasicResourceStateTracker<Backend>::ResolveTransition(Resource* resource, TrackedState& state,
+	RhiResourceStates after, UINT subresource, RhiBarrierFlags flags)
+{
+	if (subresource == RHI_ALL_SUBRESOURCES || state.SubresourceCount == 1)
+	{
+		if (state.IsUniform())
+		{
+			if (state.State != after)
+			{
+				if (CanPromote(state, after))
+				{
+					// 最初に使う時にGPUが状態を変えるので、バリアは要らない
+					state.Promoted = true;
+				}
+				else
+				{
+					AddBarrier(resource, RHI_ALL_SUBRESOURCES, state.State, after, flags);
+					state.Promoted = false;
+				}
+			}
+		}
+		else
+		{
+			// サブリソースごとに状態が異なる場合は、異なるものだけ個別に遷移させる
+			for (UINT i = 0; i < state.SubresourceCount; i++)
+			{
+				if (state.Subresources[i] != after)
+				{
+					AddBarrier(resource, i, state.Subresources[i], after, flags);
+				}
+			}
+			state.Subresources.clear();
+		}
+		state.State = after;
+		return;
+	}
+
+	if (state.IsUniform())
+	{
+		if (state.State == after)
+		{
+			return;
+		}
+		state.Subresources.assign(state.SubresourceCount, state.State);
+	}
+
+	if (state.Subresources[subresource] == after)
+	{
+		return;
+	}
+
+	// サブリソースごとの遷移は昇格させずにバリアで行う
+	AddBarrier(resource, subresource, state.Subresources[subresource], after, flags);
+	state.Subresources[subresource] = after;
+	state.Promoted = false;
+
+	// 全サブリソースが同じ状態に揃ったらまとめて扱う
+	for (auto s : state.Subresources)
+	{
+		if (s != after)
+		{
+			return;
+		}
+	}
+	state.Subresources.clear();
+	state.State = after;
+}
+
+template<typename Backend>
+void BasicResourceStateTracker<Backend>::EndSplitTransition(Resource* resource)
+{
+	auto it = m_SplitTransitions.find(resource);
+	if (it == m_SplitTransitions.end())
+	{
+		return;
+	}
+
+	auto& split = it->second;
+	AddBarrier(resource, split.Subresource, split.Before, split.After, RHI_BARRIER_FLAG_END_ONLY);
+	m_SplitTransitions.erase(it);
+}
+
+template<typename Backend>
+void BasicResourceStateTracker<Backend>::Transition(Resource* resource, RhiResourceStates after, UINT subresource)
+{
+	auto split = m_SplitTransitions.find(resource);
+	if (split != m_SplitTransitions.end())
+	{
+		bool matches = split->second.After == after && split->second.Subresource == subresource;
+		EndSplitTransition(resource);
+		if (matches)
+		{
+			return;
+		}
+	}
+
+	auto state = FindOrFetch(resource);
+	if (state == nullptr)
+	{
+		printf("状態が登録されていないリソースへの遷移です\n");
+		return;
+	}
+
+	ResolveTransition(resource, *state, after, subresource, RHI_BARRIER_FLAG_NONE);
+}
+
+template<typename Backend>
+void BasicResourceStateTracker<Backend>::BeginTransition(Resource* resource, RhiResourceStates after, UINT subresource)
+{
+	if (!m_SplitBarriersEnabled)
+	{
+		Transition(resource, after, subresource);
+		return;
+	}
+
+	EndSplitTransition(resource);
+
+	auto state = FindOrFetch(resource);
+	if (state == nullptr)
+	{
+		printf("状態が登録されていないリソースへの遷移です\n");
+		return;
+	}
+
+	// 分割バリアは1つのバリアで表せる場合のみ使う。昇格で済むならバリア自体が要らない
+	bool isWhole = subresource == RHI_ALL_SUBRESOURCES || state->SubresourceCount == 1;
+	if ((isWhole && !state->IsUniform()) || (isWhole && CanPromote(*state, after)))
+	{
+		ResolveTransition(resource, *state, after, subresource, RHI_BARRIER_FLAG_NONE);
+		return;
+	}
+
+	auto before = state->Get(subresource);
+	if (before == after)
+	{
+		return;
+	}
+
+	ResolveTransition(resource, *state, after, subresource, RHI_BARRIER_FLAG_BEGIN_ONLY);
+	m_SplitTransitions[resource] = { subresource, before, after };
+}
+
+template<typename Backend>
+void BasicResourceStateTracker<Backend>::FlushBarriers(typename Backend::CommandList* commandList)
+{
+	if (m_PendingBarriers.empty())
+	{
+		return;
+	}
+
+	commandList->ResourceBarrier(static_cast<UINT>(m_PendingBarriers.size()), m_PendingBarriers.data());
+	m_FlushCount++;
+	m_BarrierCount += static_cast<UINT>(m_PendingBarriers.size());
+	m_PendingBarriers.clear();
+}
+
+template<typename Backend>
+void BasicResourceStateTracker<Backend>::CommitFinalStates()
+{
+	if (!m_SplitTransitions.empty() || !m_PendingBarriers.empty())
+	{
+		printf("発行されていないバリアが残ったままコマンドリストが実行されました\n");
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(s_Mutex);
+		for (auto& [resource, state] : m_States)
+		{
+			auto known = s_KnownStates.find(resource);
+			if (known != s_KnownStates.end())
+			{
+				known->second = state;
+				Decay(known->second);
+			}
+		}
+	}
+
+	Reset();
+}
+
+template<typename Backend>
+void BasicResourceStateTracker<Backend>::Reset()
+{
+	m_States.clear();
+	m_SplitTransitions.clear();
+	m_PendingBarriers.clear();
+	m_FlushCount = 0;
+	m_BarrierCount = 0;
+}
+
+namespace
+{
+	struct ExpectedBarrier
+	{
+		NullBuffer* Resource;
+		UINT Subresource;
+		RhiResourceStates Before;
+		RhiResourceStates After;
+		RhiBarrierFlags Flags;
+	};
+
+	bool Matches(const char* name, const std::vector<NullResourceBarrier>& barriers, const std::vector<ExpectedBarrier>& expected)
+	{
+		bool isValid = barriers.size() == expected.size();
+		for (size_t i = 0; isValid && i < barriers.size(); i++)
+		{
+			auto& transition = barriers[i].Transition;
+			isValid = barriers[i].Type == RHI_BARRIER_TYPE_TRANSITION && barriers[i].Flags == expected[i].Flags
+				&& transition.pResource == expected[i].Resource && transition.Subresource == expected[i].Subresource
+				&& transition.StateBefore == expected[i].Before && transition.StateAfter == expected[i].After;
+		}
+		if (!isValid)
+		{
+			printf("  %s: バリアが違う (%zu個, 期待 %zu個)\n", name, barriers.size(), expected.size());
+		}
+		return isValid;
+	}
+
+	bool IsKnown(const char* name, NullBuffer* resource, UINT subresource, RhiResourceStates expected)
+	{
+		RhiResourceStates state = RHI_STATE_COMMON;
+		bool isValid = BasicResourceStateTracker<NullBackend>::GetKnownState(resource, subresource, &state) && state == expected;
+		if (!isValid)
+		{
+			printf("  %s: 実行後の状態が違う (%x, 期待 %x)\n", name, static_cast<unsigned>(state), static_cast<unsigned>(expected));
+		}
+		return isValid;
+	}
+}
+
+template<>
+bool BasicResourceStateTracker<NullBackend>::RunTest()
+{
+	const UINT All = RHI_ALL_SUBRESOURCES;
+	const auto None = RHI_BARRIER_FLAG_NONE;
+
+	// リソースは中身を使わないので、ヌルのバッファのアドレスを名前の代わりにする
+	NullBuffer target, mips, buffer, sampled, copied, split;
+	for (auto resource : { &target, &mips, &buffer, &sampled, &copied, &split })
+	{
+		resource->Create(16, RHI_HEAP_DEFAULT);
+	}
+	Register(&target, RHI_STATE_RENDER_TARGET);
+	Register(&mips, RHI_STATE_RENDER_TARGET, 4);
+	Register(&buffer, RHI_STATE_COMMON, 1, true);
+	Register(&sampled, RHI_STATE_COMMON);
+	Register(&copied, RHI_STATE_COMMON);
+	Register(&split, RHI_STATE_RENDER_TARGET);
+
+	bool isValid = true;
+	NullCommandList commandList;
+	BasicResourceStateTracker<NullBackend> tracker;
+
+	// 未発行のバリアは続けてまとめ、元に戻れば消す。同じ状態への遷移はバリアを出さない
+	tracker.Transition(&target, RHI_STATE_PIXEL_SHADER_RESOURCE);
+	tracker.Transition(&target, RHI_STATE_COPY_SOURCE);
+	isValid &= Matches("合流", tracker.PendingBarriers(), { { &target, All, RHI_STATE_RENDER_TARGET, RHI_STATE_COPY_SOURCE, None } });
+	tracker.Transition(&target, RHI_STATE_RENDER_TARGET);
+	tracker.Transition(&target, RHI_STATE_RENDER_TARGET);
+	isValid &= Matches("打ち消し", tracker.PendingBarriers(), {});
+
+	// 1つのサブリソースだけ変えた後に全体を変えると、残りのサブリソースだけを個別に遷移させる
+	tracker.Transition(&mips, RHI_STATE_PIXEL_SHADER_RESOURCE, 1);
+	tracker.Transition(&mips, RHI_STATE_PIXEL_SHADER_RESOURCE);
+	isValid &= Matches("サブリソース", tracker.PendingBarriers(),
+	{
+		{ &mips, 1, RHI_STATE_RENDER_TARGET, RHI_STATE_PIXEL_SHADER_RESOURCE, None },
+		{ &mips, 0, RHI_STATE_RENDER_TARGET, RHI_STATE_PIXEL_SHADER_RESOURCE, None },
+		{ &mips, 2, RHI_STATE_RENDER_TARGET, RHI_STATE_PIXEL_SHADER_RESOURCE, None },
+		{ &mips, 3, RHI_STATE_RENDER_TARGET, RHI_STATE_PIXEL_SHADER_RESOURCE, None },
+	});
+	tracker.FlushBarriers(&commandList);
+	isValid &= commandList.Count(NULL_COMMAND_RESOURCE_BARRIER) == 1 && commandList.Commands().back().Args[0] == 4;
+
+	// COMMONからの昇格はバリアを出さない。昇格した後の遷移は昇格した状態から始める
+	// テクスチャはレンダーターゲットには昇格できない
+	tracker.Transition(&buffer, RHI_STATE_COPY_DEST);
+	tracker.Transition(&sampled, RHI_STATE_PIXEL_SHADER_RESOURCE);
+	tracker.Transition(&copied, RHI_STATE_COPY_DEST);
+	isValid &= Matches("昇格", tracker.PendingBarriers(), {});
+	tracker.Transition(&buffer, RHI_STATE_VERTEX_AND_CONSTANT_BUFFER);
+	isValid &= Matches("昇格の後の遷移", tracker.PendingBarriers(),
+		{ { &buffer, All, RHI_STATE_COPY_DEST, RHI_STATE_VERTEX_AND_CONSTANT_BUFFER, None } });
+	tracker.FlushBarriers(&commandList);
+
+	// 実行後はバッファと読み取りに昇格したテクスチャだけがCOMMONに戻る（書き込みに昇格したテクスチャとバリアで変えたものは残る）
+	tracker.CommitFinalStates();
+	isValid &= IsKnown("バッファの減衰", &buffer, All, RHI_STATE_COMMON);
+	isValid &= IsKnown("読み取りの減衰", &sampled, All, RHI_STATE_COMMON);
+	isValid &= IsKnown("書き込みの昇格", &copied, All, RHI_STATE_COPY_DEST);
+	isValid &= IsKnown("サブリソースの揃い", &mips, 2, RHI_STATE_PIXEL_SHADER_RESOURCE);
+
+	// 次のコマンドリストは共有の状態から始める。COMMONに戻ったテクスチャはレンダーターゲットにはバリアで遷移させる
+	tracker.Transition(&sampled, RHI_STATE_RENDER_TARGET);
+	isValid &= Matches("減衰の後", tracker.PendingBarriers(), { { &sampled, All, RHI_STATE_COMMON, RHI_STATE_RENDER_TARGET, None } });
+	tracker.FlushBarriers(&commandList);
+
+	// 分割バリア: 開始側を出しておき、同じ状態への遷移で終了側を出す。違う状態なら終了側の後に続けて遷移させる
+	tracker.SetSplitBarriersEnabled(true);
+	tracker.BeginTransition(&split, RHI_STATE_PIXEL_SHADER_RESOURCE);
+	isValid &= Matches("分割の開始", tracker.PendingBarriers(),
+		{ { &split, All, RHI_STATE_RENDER_TARGET, RHI_STATE_PIXEL_SHADER_RESOURCE, RHI_BARRIER_FLAG_BEGIN_ONLY } });
+	tracker.FlushBarriers(&commandList);
+	tracker.Transition(&split, RHI_STATE_PIXEL_SHADER_RESOURCE);
+	isValid &= Matches("分割の終了", tracker.PendingBarriers(),
+		{ { &split, All, RHI_STATE_RENDER_TARGET, RHI_STATE_PIXEL_SHADER_RESOURCE, RHI_BARRIER_FLAG_END_ONLY } });
+	tracker.FlushBarriers(&commandList);
+	tracker.BeginTransition(&split, RHI_STATE_RENDER_TARGET);
+	tracker.FlushBarriers(&commandList);
+	tracker.Transition(&split, RHI_STATE_COPY_SOURCE);
+	isValid &= Matches("分割の後の遷移", tracker.PendingBarriers(),
+	{
+		{ &split, All, RHI_STATE_PIXEL_SHADER_RESOURCE, RHI_STATE_RENDER_TARGET, RHI_BARRIER_FLAG_END_ONLY },
+		{ &split, All, RHI_STATE_RENDER_TARGET, RHI_STATE_COPY_SOURCE, None },
+	});
+
+	// 昇格で済む遷移は分割しない
+	tracker.BeginTransition(&buffer, RHI_STATE_INDEX_BUFFER);
+	tracker.FlushBarriers(&commandList);
+	tracker.Transition(&buffer, RHI_STATE_INDEX_BUFFER);
+	isValid &= Matches("分割しない昇格", tracker.PendingBarriers(), {});
+	tracker.FlushBarriers(&commandList);
+	tracker.CommitFinalStates();
+	isValid &= IsKnown("分割の後の状態", &split, All, RHI_STATE_COPY_SOURCE);
+
+	for (auto resource : { &target, &mips, &buffer, &sampled, &copied, &split })
+	{
+		Unregister(resource);
+	}
+
+	printf("状態の追跡のテスト: %s\n", isValid ? "成功" : "失敗");
+	return isValid;
+}
+
+template class BasicResourceStateTracker<NullBackend>;
+#ifdef RHI_HAS_D3D12
+template class BasicResourceStateTracker<D3D12Backend>;
+#endif
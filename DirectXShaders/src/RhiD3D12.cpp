@@ -0,0 +1,60 @@
+#include "RhiD3D12.h"
+#include <d3dx12.h>
+#include <stdio.h>
+
+namespace
+{
+	ID3D12Device* s_pDevice = nullptr; // 参照はEngineが持つ
+}
+
+void D3D12Backend::SetDevice(ID3D12Device* device)
+{
+	s_pDevice = device;
+}
+
+ID3D12Device* D3D12Backend::Device()
+{
+	return s_pDevice;
+}
+
+bool D3D12Buffer::Create(size_t size, RhiHeap heap)
+{
+	auto isUpload = heap == RHI_HEAP_UPLOAD;
+	auto prop = CD3DX12_HEAP_PROPERTIES(isUpload ? D3D12_HEAP_TYPE_UPLOAD : D3D12_HEAP_TYPE_DEFAULT);
+	auto desc = CD3DX12_RESOURCE_DESC::Buffer(size);
+
+	// アップロードヒープのバッファはGENERIC_READから変えられない
+	auto hr = s_pDevice->CreateCommittedResource(
+		&prop,
+		D3D12_HEAP_FLAG_NONE,
+		&desc,
+		isUpload ? D3D12_RESOURCE_STATE_GENERIC_READ : D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(m_pResource.ReleaseAndGetAddressOf())
+	);
+
+	if (FAILED(hr))
+	{
+		return false;
+	}
+
+	m_Size = size;
+	return true;
+}
+
+void* D3D12Buffer::Map()
+{
+	void* p = nullptr;
+	auto hr = m_pResource->Map(0, nullptr, &p);
+	return SUCCEEDED(hr) ? p : nullptr;
+}
+
+void D3D12Buffer::Unmap()
+{
+	m_pResource->Unmap(0, nullptr);
+}
+
+RhiGpuAddress D3D12Buffer::GpuAddress() const
+{
+	return m_pResource->GetGPUVirtualAddress();
+}
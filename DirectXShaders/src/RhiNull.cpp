@@ -0,0 +1,136 @@
+#include "RhiNull.h"
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+namespace
+{
+	// D3D12と同じく64KB単位で割り当て、0は無効なアドレスとして使わない
+	const uint64_t AddressAlignment = 64 * 1024;
+	std::atomic<uint64_t> s_NextAddress(AddressAlignment);
+
+	std::atomic<uint64_t> s_LiveBuffers(0);
+	std::atomic<uint64_t> s_LiveBytes(0);
+
+	std::mutex s_ObjectMutex;
+	std::deque<NullRootSignature> s_RootSignatures; // dequeは追加しても要素が動かない
+	std::deque<NullPipelineState> s_PipelineStates;
+	std::deque<NullDescriptorHeap> s_DescriptorHeaps;
+
+	const char* s_CommandNames[NULL_COMMAND_COUNT] =
+	{
+		"SetGraphicsRootSignature",
+		"SetPipelineState",
+		"SetDescriptorHeaps",
+		"SetGraphicsRootConstantBufferView",
+		"SetGraphicsRootShaderResourceView",
+		"SetGraphicsRootDescriptorTable",
+		"SetGraphicsRoot32BitConstant",
+		"IASetPrimitiveTopology",
+		"IASetVertexBuffers",
+		"IASetIndexBuffer",
+		"OMSetRenderTargets",
+		"DrawInstanced",
+		"DrawIndexedInstanced",
+		"CopyBufferRegion",
+		"ResourceBarrier",
+	};
+}
+
+RhiGpuAddress NullDevice::AllocateAddress(size_t size)
+{
+	auto alignedSize = (static_cast<uint64_t>(size) + AddressAlignment - 1) & ~(AddressAlignment - 1);
+	return s_NextAddress.fetch_add(alignedSize > 0 ? alignedSize : AddressAlignment, std::memory_order_relaxed);
+}
+
+NullRootSignature* NullDevice::CreateRootSignature(uint32_t parameterCount)
+{
+	std::lock_guard<std::mutex> lock(s_ObjectMutex);
+	s_RootSignatures.push_back({ parameterCount });
+	return &s_RootSignatures.back();
+}
+
+NullPipelineState* NullDevice::CreatePipelineState(const NullPipelineDesc& desc)
+{
+	std::lock_guard<std::mutex> lock(s_ObjectMutex);
+	s_PipelineStates.push_back({ desc });
+	return &s_PipelineStates.back();
+}
+
+NullDescriptorHeap* NullDevice::CreateDescriptorHeap(UINT count)
+{
+	// ディスクリプタ1つを32バイトとしてアドレスの範囲だけ取る
+	auto start = AllocateAddress(static_cast<size_t>(count) * 32);
+
+	std::lock_guard<std::mutex> lock(s_ObjectMutex);
+	s_DescriptorHeaps.push_back({ { start }, count });
+	return &s_DescriptorHeaps.back();
+}
+
+void NullDevice::BufferCreated(size_t size)
+{
+	s_LiveBuffers.fetch_add(1, std::memory_order_relaxed);
+	s_LiveBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void NullDevice::BufferDestroyed(size_t size)
+{
+	s_LiveBuffers.fetch_sub(1, std::memory_order_relaxed);
+	s_LiveBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+uint64_t NullDevice::LiveBuffers()
+{
+	return s_LiveBuffers.load(std::memory_order_relaxed);
+}
+
+uint64_t NullDevice::LiveBytes()
+{
+	return s_LiveBytes.load(std::memory_order_relaxed);
+}
+
+NullBuffer::~NullBuffer()
+{
+	if (m_pData != nullptr)
+	{
+		NullDevice::BufferDestroyed(m_Size);
+	}
+}
+
+bool NullBuffer::Create(size_t size, RhiHeap /*heap*/)
+{
+	// ヒープの種類によらず、GPUだけが使うバッファも、記録した内容を確かめられるようにCPUのメモリを持つ
+	m_pData.reset(new uint8_t[size > 0 ? size : 1]);
+	m_Size = size;
+	m_Address = NullDevice::AllocateAddress(size);
+	NullDevice::BufferCreated(size);
+	return true;
+}
+
+uint32_t NullCommandList::Count(NullCommandType type) const
+{
+	uint32_t count = 0;
+	for (auto& command : m_Commands)
+	{
+		count += command.Type == type ? 1 : 0;
+	}
+	return count;
+}
+
+void NullCommandList::Dump(std::ostream& out, size_t maxCommands) const
+{
+	for (size_t i = 0; i < m_Commands.size() && i < maxCommands; i++)
+	{
+		auto& command = m_Commands[i];
+		out << i << ": " << Name(command.Type) << " (" << command.Args[0] << ", " << command.Args[1] << ", " << command.Args[2] << ")\n";
+	}
+	if (m_Commands.size() > maxCommands)
+	{
+		out << "... (" << m_Commands.size() - maxCommands << " more)\n";
+	}
+}
+
+const char* NullCommandList::Name(NullCommandType type)
+{
+	return type < NULL_COMMAND_COUNT ? s_CommandNames[type] : "";
+}
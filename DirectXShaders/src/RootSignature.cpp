@@ -1,16 +1,24 @@
 #include "RootSignature.h"
+#ifdef RHI_HAS_D3D12
 #include "Engine.h"
+#include "DescriptorHeap.h"
 #include <d3dx12.h>
+#endif
 
 // パイプラインにバインドされるリソースの種類を定義
-RootSignature::RootSignature()
+// forMeshesがtrueの場合、マテリアル番号用のルート定数(b3)とヒープ全体を指すSRVテーブル(space1)、
+// インスタンスの先頭番号用のルート定数(b4)と物体の定数のSRV(t0, space2)、インスタンスごとの物体の番号のSRV(t3, space2)、
+// 点光源のクラスターの定数(b5)と点光源のSRV(t1, space2)、クラスターごとのライトの並びのSRV(t2, space2)を追加する
+#ifdef RHI_HAS_D3D12
+template<>
+BasicRootSignature<D3D12Backend>::BasicRootSignature(bool forMeshes, uint32_t materialTableSize)
 {
 	auto flag = D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT; // アプリケーションの入力アセンブラを使用する
 	flag |= D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS; // ドメインシェーダーのルートシグネチャへのアクセスを拒否する
 	flag |= D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS; // ハルシェーダーのルートシグネチャへのアクセスを拒否する
 	flag |= D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS; // ジオメトリシェーダーのルートシグネチャへのアクセスを拒否する
 
-	CD3DX12_ROOT_PARAMETER rootParam[4] = {};
+	CD3DX12_ROOT_PARAMETER rootParam[12] = {};
 	rootParam[0].InitAsConstantBufferView(0, 0, D3D12_SHADER_VISIBILITY_ALL); 
 	rootParam[2].InitAsConstantBufferView(1, 0, D3D12_SHADER_VISIBILITY_ALL);
 	rootParam[3].InitAsConstantBufferView(2, 0, D3D12_SHADER_VISIBILITY_ALL);
@@ -19,10 +27,25 @@ RootSignature::RootSignature()
 	range[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 2, 0, 0, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND); // SRVの範囲を定義
 	rootParam[1].InitAsDescriptorTable(1, &range[0], D3D12_SHADER_VISIBILITY_PIXEL); // ピクセルシェーダーで使用するSRVのテーブルを定義
 
+	// テーブルはヒープの末尾を越えてはいけないので、マテリアルごとに張り替える場合は1個にする
+	// シェーダーの_Texturesの数（MATERIAL_TABLE_SIZE）もこれに合わせてコンパイルする
+	CD3DX12_DESCRIPTOR_RANGE bindlessRange[1] = {};
+	bindlessRange[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, materialTableSize != 0 ? materialTableSize : HANDLE_MAX, 0, 1, 0); // ヒープ内の全SRVをspace1に並べる
+	rootParam[4].InitAsConstants(1, 3, 0, D3D12_SHADER_VISIBILITY_PIXEL); // マテリアル番号
+	rootParam[5].InitAsDescriptorTable(1, &bindlessRange[0], D3D12_SHADER_VISIBILITY_PIXEL);
+
+	rootParam[6].InitAsConstants(1, 4, 0, D3D12_SHADER_VISIBILITY_VERTEX); // このバッチの先頭のインスタンス番号
+	rootParam[7].InitAsShaderResourceView(0, 2, D3D12_SHADER_VISIBILITY_VERTEX); // 物体の定数（ヒープを通さずアドレスで渡す）
+	rootParam[11].InitAsShaderResourceView(3, 2, D3D12_SHADER_VISIBILITY_VERTEX); // インスタンスごとの物体の番号
+
+	rootParam[8].InitAsConstantBufferView(5, 0, D3D12_SHADER_VISIBILITY_PIXEL); // クラスターの定数
+	rootParam[9].InitAsShaderResourceView(1, 2, D3D12_SHADER_VISIBILITY_PIXEL); // 点光源
+	rootParam[10].InitAsShaderResourceView(2, 2, D3D12_SHADER_VISIBILITY_PIXEL); // クラスターごとのライトの並び
+
 	auto sampler = CD3DX12_STATIC_SAMPLER_DESC(0, D3D12_FILTER_MIN_MAG_MIP_LINEAR);
 
 	D3D12_ROOT_SIGNATURE_DESC desc = {};
-	desc.NumParameters = std::size(rootParam);
+	desc.NumParameters = forMeshes ? std::size(rootParam) : 4;
 	desc.NumStaticSamplers = 1;
 	desc.pParameters = rootParam;
 	desc.pStaticSamplers = &sampler;
@@ -41,10 +64,10 @@ RootSignature::RootSignature()
 		return;
 	}
 
-	hr = g_Engine->Device()->CreateRootSignature(0, pBlob->GetBufferPointer(), 
-													pBlob->GetBufferSize(), IID_PPV_ARGS(m_pRootSignature.GetAddressOf()));
+	// 同じ内容のルートシグネチャは使い回す
+	m_pRootSignature = g_Engine->PSOCache()->GetRootSignature(pBlob->GetBufferPointer(), pBlob->GetBufferSize());
 
-	if(FAILED(hr))
+	if(m_pRootSignature == nullptr)
 	{
 		printf("ルートシグネチャの生成に失敗\n");
 		return;
@@ -54,12 +77,29 @@ RootSignature::RootSignature()
 
 }
 
-bool RootSignature::IsValid()
+#endif
+
+// ヌルではルート引数の数だけを覚える（D3D12と同じく、メッシュ用は12個でそれ以外は先頭の4個）
+template<>
+BasicRootSignature<NullBackend>::BasicRootSignature(bool forMeshes, uint32_t)
+{
+	m_pRootSignature = NullDevice::CreateRootSignature(forMeshes ? 12 : 4);
+	m_IsValid = true;
+}
+
+template<typename Backend>
+bool BasicRootSignature<Backend>::IsValid()
 {
 	return m_IsValid;
 }
 
-ID3D12RootSignature* RootSignature::Get()
+template<typename Backend>
+typename Backend::RootSignature* BasicRootSignature<Backend>::Get()
 {
 	return m_pRootSignature.Get();
 }
+
+template class BasicRootSignature<NullBackend>;
+#ifdef RHI_HAS_D3D12
+template class BasicRootSignature<D3D12Backend>;
+#endif
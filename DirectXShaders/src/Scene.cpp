@@ -3,15 +3,34 @@
 #include "App.h"
 #include <d3dx12.h>
 #include <vector>
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
 #include "SharedStruct.h"
 #include "VertexBuffer.h"
 #include "IndexBuffer.h"
 #include "ConstantBuffer.h"
+#include "ObjectBuffer.h"
 #include "RootSignature.h"
 #include "PipelineState.h"
 #include "AssimpLoader.h"
 #include "DescriptorHeap.h"
 #include "Texture2D.h"
+#include "DrawPartitioner.h"
+#include "DrawQueue.h"
+#include "CommandListFilter.h"
+#include "IndirectCuller.h"
+#include "OcclusionCuller.h"
+#include "ClusteredLighting.h"
+#include "EntityWorld.h"
+#include "SceneGraph.h"
+#include "SoftwareRenderer.h"
+#include "JobSystem.h"
+#include "EnvironmentBaker.h"
+#include "Timer.h"
+#include "Profiler.h"
+#include "FrameStats.h"
 #include <iostream> // デバッグ用に追加
 
 Scene* g_Scene;
@@ -30,27 +49,254 @@ VertexBuffer* vertexBuffer;
 IndexBuffer* indexBuffer;
 VertexBuffer* skyboxVertexBuffer;
 IndexBuffer* skyboxIndexBuffer;
-ConstantBuffer* constantBuffer[Engine::FRAME_BUFFER_COUNT];
-ConstantBuffer* sceneBuffer[Engine::FRAME_BUFFER_COUNT];
-ConstantBuffer* skyboxBuffer[Engine::FRAME_BUFFER_COUNT];
+// カメラで決まる定数はCPU側で保持し、変わった時だけフレームスロットごとの定数バッファ（viewConstantBuffers）にコピーする
+Transform meshTransform;
+SceneData sceneData;
+Transform skyboxTransform;
 RootSignature* rootSignature;
 PipelineState* pipelineState;
 RootSignature* skyboxRootSignature;
 PipelineState* skyboxPipelineState;
 DescriptorHeap* descriptorHeap;
 std::vector<DescriptorHandle*> materialHandles;
+std::vector<Texture2D*> textures; // ヒープに登録したテクスチャ（SRVが参照している間は保持する）
 DescriptorHandle* skyboxHandle;
-ComPtr<ID3D12Resource> IrradianceMap;
-ComPtr<ID3D12DescriptorHeap> irradianceMapRtvHeap;
+Texture2D* environmentTexture; // スカイボックスの環境マップ（IBL用のマップの焼き込み元）
+// IBL用のマップは計算キューで焼き込み、2組のうち焼き終わった方のイラディアンスマップをスカイボックスに表示する
+EnvironmentBaker* environmentBaker;
+DescriptorHandle* irradianceHandles[BakeScheduler::TARGET_COUNT];
 XMMATRIX perspective;
 
 const wchar_t* modelFile = L"Assets/bunny.fbx";
+const wchar_t* skyboxFile = L"Assets/Texture/BrightSky.dds";
 std::vector<Mesh> meshes;
 std::vector<VertexBuffer*> vertexBuffers;
 std::vector<IndexBuffer*> indexBuffers;
 
+// trueの場合、メッシュのテクスチャはヒープ全体を指すテーブルとマテリアル番号で参照する
+// falseの場合はマテリアルのSRVを指す1個だけのテーブルを描画ごとに張り替える（テーブルがヒープの末尾を越えないようにする）
+const bool UseBindless = true;
+const UINT MaterialTableSize = UseBindless ? HANDLE_MAX : 1;
+
+// 1スレッドに任せる最低の描画数（少ないとスレッドを立てる手間の方が大きい）
+const uint32_t MinDrawsPerRecordThread = 64;
+std::vector<uint32_t> drawCosts; // 並べ替えた後の描画ごとの記録コストの見積もり
+
+// メッシュの描画はキーで並べ替え、変わった状態だけ設定しながら記録する
+const uint32_t MeshPass = 0;
+const uint32_t MeshPipeline = 0;
+DrawQueue meshQueue; // 描画の番号はSceneObjects::Batchesの番号
+DrawStateChanges meshStateChanges = {};
+double meshSortTime = 0.0;
+
+// モデル(meshes)を--instancesの数だけ並べた物体。メッシュごとに1つずつエンティティを作り、部品はInstanceDataとこの3つ
+struct MeshComponent
+{
+	uint32_t Mesh;
+};
+
+struct NodeComponent
+{
+	uint32_t Node; // Scene::m_SceneGraphのノード（並べたモデルごとに1つ）
+};
+
+struct BoundsComponent
+{
+	XMFLOAT3 Center; // ワールド空間での中心（深度の並べ替えに使う）
+	float Radius; // Centerを中心にメッシュ全体を囲む球の半径（カリングに使う）
+};
+
+// 1回の描画で描く、同じメッシュとマテリアルの物体の並び（インスタンスデータもこの順に書く）
+struct MeshBatch
+{
+	uint32_t Mesh;
+	uint32_t FirstInstance;
+	uint32_t InstanceCount;
+	uint32_t Depth; // 一番手前の物体の深度バケット
+};
+
+// 並べたモデルの物体と、描画する物体を選んで並べるための状態。Sceneが持ち、物体を扱う関数と描画のパスには参照で渡す
+struct SceneObjects
+{
+	// 物体はアーキタイプごとのチャンクに部品の配列で持ち、システムはクエリに合うチャンクを頭から回す
+	// 描画の番号はエンティティの番号（Entity::Index）で、並べ替えた後に物体を引く時はComponentを使う
+	EntityWorld Entities;
+	EntityQuery Query{ ComponentMaskOf<MeshComponent, NodeComponent, BoundsComponent, InstanceData>() };
+	std::vector<XMFLOAT3> MeshCenters; // メッシュのローカル空間での中心
+	std::vector<float> MeshRadii;
+	std::vector<MeshBatch> Batches;
+	DrawQueue ObjectQueue; // 同じメッシュとマテリアルの物体が続くように並べたもの（メッシュは変わらないのでInitで一度だけ並べる）
+
+	// 物体のInstanceDataは、フレームをまたいで残るGPUのバッファにエンティティの番号の順で持つ
+	// TransformSystemで変わった物体だけを毎フレームのリングバッファに詰め、ObjectUploadのパスでまとめてコピーする
+	// 描画ではインスタンスごとの物体の番号（4バイト）だけをリングバッファに書き、頂点シェーダーはその番号で引く
+	ObjectBuffer Constants;
+	D3D12_GPU_VIRTUAL_ADDRESS InstanceObjectsAddress = 0;
+
+	// --gpu-culling: 視錐台カリングとコマンドの詰め込みをGPUで行い、ExecuteIndirectで描く
+	IndirectCuller* GpuCuller = nullptr;
+	ConstantBuffer* StaticInstanceObjects = nullptr; // 並べた順のインスタンスごとの物体の番号（変わらないのでInitで一度だけ書く）
+	IndirectCull::CullConstants CullConstants = {}; // このフレームのカリングの定数
+	D3D12_GPU_VIRTUAL_ADDRESS CullConstantsAddress = 0;
+	IndirectCull::CullConstants VerifyConstants = {}; // CullVerifyFrameのカリングの定数
+
+	// --occlusion-culling: 画面で大きく見える物体を遮蔽物としてCPUでラスタライズし、隠れている物体はバッチに入れない
+	OcclusionCuller* Occlusion = nullptr;
+	std::vector<uint32_t> OccluderOrder; // 遮蔽物の候補（大きく見える順）
+	std::vector<uint8_t> Occluded; // このフレームで隠れている物体（物体の番号で引く）
+	uint32_t OccludedCount = 0;
+
+	// 描画の番号（エンティティの番号）から物体の部品を引く
+	template<class T>
+	T& Component(uint32_t draw)
+	{
+		return *Entities.Get<T>(Entities.EntityAt(draw));
+	}
+};
+
+// カメラで決まる定数（ビュー、射影、カメラの位置）。変わった時だけUpdateで作り直して版を上げ、
+// フレームスロットごとのバッファには、そのスロットの版が古い時だけ書き直す（GPUが前のフレームで読んでいるスロットには触らない）
+struct ViewConstants
+{
+	Transform Mesh;
+	SceneData Scene;
+	Transform Skybox;
+};
+std::vector<ConstantBuffer*> viewConstantBuffers;
+std::vector<uint32_t> viewConstantVersions;
+uint32_t viewVersion = 1;
+uint32_t cameraVersion;
+float projectionZoom;
+
+// 1フレームで送った定数の量。SubmitTimeFramesの間を合計して平均を出力する
+uint64_t viewUploadTotal = 0;
+uint64_t objectUploadTotal = 0;
+uint64_t instanceUploadTotal = 0;
+uint64_t objectCopyTotal = 0;
+
+// CPUでの送信時間（並べ替えと記録）を平均するフレーム数
+const UINT SubmitTimeFrames = 120;
+double meshSubmitTimeTotal = 0.0;
+
+const UINT CullVerifyFrame = 0; // --gpu-culling: このフレームのGPUの結果を読み戻し、CPUで求めたものと比べる
+const uint32_t OccluderTriangleBudget = 100000; // --occlusion-culling: 1フレームでラスタライズする遮蔽物の三角形の上限
+
+// --lights: モデルの周りに置いた点光源をCPUでクラスターに振り分け、PBR.hlslは画素のクラスターのライトだけで照らす
+// ライトと振り分けた並びは毎フレームリングバッファに書く。点光源が無ければ定数のLightCountを0にする
+ClusteredLighting clusteredLighting;
+std::vector<PointLight> pointLights;
+
+// クラスターの定数とバッファのアドレス（点光源を使わないフレームは、3つとも定数を指す）
+struct ClusterAddresses
+{
+	D3D12_GPU_VIRTUAL_ADDRESS Constants;
+	D3D12_GPU_VIRTUAL_ADDRESS Lights;
+	D3D12_GPU_VIRTUAL_ADDRESS Lists;
+};
+
+// 行ベクトルの行列をシーングラフのローカルの変換に分ける
+SceneGraph::Transform ToSceneTransform(FXMMATRIX matrix)
+{
+	XMVECTOR scale;
+	XMVECTOR rotation;
+	XMVECTOR translation;
+	XMMatrixDecompose(&scale, &rotation, &translation, matrix);
+	SceneGraph::Transform local;
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(local.Translation), translation);
+	XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(local.Rotation), rotation);
+	XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(local.Scale), scale);
+	return local;
+}
+
+// シーングラフの3x4の行列（列ベクトル）を行ベクトルのXMMATRIXに戻す
+XMMATRIX ToMatrix(const SceneGraph::Matrix& matrix)
+{
+	XMMATRIX rows(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(matrix.Rows[0])),
+		XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(matrix.Rows[1])),
+		XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(matrix.Rows[2])),
+		g_XMIdentityR3);
+	return XMMatrixTranspose(rows);
+}
+
+// 変換のシステム。ワールド行列の変わったノードの物体だけ、インスタンスデータと境界の球を書き直し、物体の定数に送る印を付ける（allなら全て）
+// 物体どうしは依存しないので、チャンクごとに並列に回す
+// GPUカリングの境界の球はInitで一度だけ書くので、物体を動かす時はGPUカリングを使わない（Scene::Init）
+void TransformSystem(SceneObjects& objects, const SceneGraph& graph, bool all)
+{
+	objects.Entities.ParallelEach<const MeshComponent, const NodeComponent, BoundsComponent, InstanceData>(objects.Query,
+		[&objects, &graph, all](Entity entity, const MeshComponent& mesh, const NodeComponent& node, BoundsComponent& bounds, InstanceData& instance)
+	{
+		if (!all && !graph.WorldChanged(node.Node))
+		{
+			return;
+		}
+		auto& world = graph.World(node.Node);
+		auto& inverseTranspose = graph.WorldInvTranspose(node.Node);
+		memcpy(instance.World, world.Rows, sizeof(instance.World));
+		memcpy(instance.WorldInvTranspose, inverseTranspose.Rows, sizeof(instance.WorldInvTranspose));
+		objects.Constants.Write(entity.Index, instance);
+
+		// 半径は一番大きく伸ばす軸に合わせる（拡大率は軸ごとに同じ前提）
+		auto& r = world.Rows;
+		auto& center = objects.MeshCenters[mesh.Mesh];
+		float scale = 0.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			auto length = std::sqrt(r[0][axis] * r[0][axis] + r[1][axis] * r[1][axis] + r[2][axis] * r[2][axis]);
+			scale = length > scale ? length : scale;
+			(&bounds.Center.x)[axis] = r[axis][0] * center.x + r[axis][1] * center.y + r[axis][2] * center.z + r[axis][3];
+		}
+		bounds.Radius = objects.MeshRadii[mesh.Mesh] * scale;
+	});
+}
+
+uint64_t MeshKey(uint32_t mesh, uint32_t depth)
+{
+	return DrawKey::Make(MeshPass, MeshPipeline, materialHandles[mesh]->Index, depth, mesh);
+}
+
+// Drawでこのフレームのリングバッファに書き込んだ定数（レンダーグラフのパスの中で使う）
+D3D12_GPU_VIRTUAL_ADDRESS meshTransformAddress;
+D3D12_GPU_VIRTUAL_ADDRESS sceneDataAddress;
+D3D12_GPU_VIRTUAL_ADDRESS skyboxTransformAddress;
+ClusterAddresses clusterAddresses;
+UINT apiCallCount = 0; // 1フレームで発行した描画APIの数
+UINT apiElidedCount = 0; // 状態が変わらないので発行しなかった呼び出しの数
+double meshRecordTime = 0.0;
+size_t meshRecordThreads = 1;
+
+void DrawSkybox(RenderGraphExecutor& context, RenderGraph::ResourceHandle backBuffer, RenderGraph::ResourceHandle depth);
+void DrawMeshes(SceneObjects& objects, RenderGraphExecutor& context, RenderGraph::ResourceHandle backBuffer, RenderGraph::ResourceHandle depth);
+bool InitGpuCulling(SceneObjects& objects);
+
+// シーンで使うシェーダー（パスはAppOptions::ShaderDirectoryからの相対パス）
+const ShaderDesc SceneShaders[] =
+{
+	{ L"SampleVS", L"src/shaders/SampleVS.hlsl", L"vert", L"vs_6_0" },
+	{ L"PBR", L"PBR.hlsl", L"main", L"ps_6_0", { L"MATERIAL_TABLE_SIZE=" + std::to_wstring(MaterialTableSize) } },
+	{ L"SkyboxVS", L"src/shaders/SkyboxVS.hlsl", L"vert", L"vs_6_0" },
+	{ L"SkyboxPS", L"src/shaders/SkyboxPS.hlsl", L"main", L"ps_6_0" },
+	{ L"IrradianceCS", L"src/shaders/IrradianceCS.hlsl", L"main", L"cs_6_0" },
+	{ L"PrefilterCS", L"src/shaders/PrefilterCS.hlsl", L"main", L"cs_6_0" },
+	{ L"IndirectCullCS", L"src/shaders/IndirectCullCS.hlsl", L"main", L"cs_6_0" },
+};
+
 bool Scene::Init()
 {
+	// シェーダーのコンパイル ---------------------------------------------------------------------------
+	auto shaders = g_Engine->Shaders();
+	for (auto& desc : SceneShaders)
+	{
+		shaders->Add(desc);
+	}
+
+	bool compiled = shaders->CompileAll();
+	shaders->PrintStats();
+	if (!compiled)
+	{
+		printf("シェーダーの準備に失敗\n");
+		return false;
+	}
 
 	// モデルの読み込み ---------------------------------------------------------------------------------
 	ImportSettings importSettings =
@@ -99,6 +345,40 @@ bool Scene::Init()
 		indexBuffers.push_back(pIB);
 	}
 
+	// 深度のキーとカリングに使うメッシュの中心と半径、モデルを並べる間隔を決める大きさ
+	m_pObjects = new SceneObjects();
+	auto& objects = *m_pObjects;
+	objects.MeshCenters.clear();
+	objects.MeshRadii.clear();
+	auto boundsMin = XMVectorReplicate(FLT_MAX);
+	auto boundsMax = XMVectorReplicate(-FLT_MAX);
+	for (auto& mesh : meshes)
+	{
+		auto center = XMVectorZero();
+		for (auto& vertex : mesh.Vertices)
+		{
+			auto position = XMLoadFloat3(&vertex.Position);
+			center = XMVectorAdd(center, position);
+			boundsMin = XMVectorMin(boundsMin, position);
+			boundsMax = XMVectorMax(boundsMax, position);
+		}
+		if (!mesh.Vertices.empty())
+		{
+			center = XMVectorScale(center, 1.0f / static_cast<float>(mesh.Vertices.size()));
+		}
+		XMFLOAT3 localCenter;
+		XMStoreFloat3(&localCenter, center);
+		objects.MeshCenters.push_back(localCenter);
+
+		float radius = 0.0f;
+		for (auto& vertex : mesh.Vertices)
+		{
+			auto distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&vertex.Position), center)));
+			radius = distance > radius ? distance : radius;
+		}
+		objects.MeshRadii.push_back(radius);
+	}
+
 	// モデル用の定数バッファの確保 
 
 	auto targetPos = XMVectorSet(0.0f, 120.0, 0.0, 0.0f);
@@ -112,21 +392,49 @@ bool Scene::Init()
 	m_pCamera = new Camera(eyePos, upward2, 0.0f, 0.0f);
 	auto fov = XMConvertToRadians(m_pCamera->GetZoom());
 
-	for (size_t i = 0; i < Engine::FRAME_BUFFER_COUNT; i++)
+	meshTransform.World = XMMatrixTranslation(0.0f, -60.0f, 0.0f) * XMMatrixRotationX(XMConvertToRadians(0.0f)) * XMMatrixScaling(2.0f, 2.0f, 2.0f);
+	meshTransform.View = m_pCamera->GetViewMatrix();
+	meshTransform.Projection = XMMatrixPerspectiveFovRH(fov, aspect, 0.3f, 1000.0f);
+	meshTransform.WorldInvTranspose = XMMatrixIdentity();
+
+	// モデルを格子状に並べる（1個なら元の位置）
 	{
-		constantBuffer[i] = new ConstantBuffer(sizeof(Transform));
-		if (!constantBuffer[i]->IsValid())
+		auto copyCount = g_AppOptions.InstanceCount > 0 ? g_AppOptions.InstanceCount : 1;
+		auto side = static_cast<UINT>(ceilf(sqrtf(static_cast<float>(copyCount))));
+		auto extent = XMVectorSubtract(boundsMax, boundsMin);
+		auto spacing = 1.5f * (XMVectorGetX(extent) > XMVectorGetZ(extent) ? XMVectorGetX(extent) : XMVectorGetZ(extent));
+
+		m_SceneGraph.Clear();
+		m_SceneGraph.Reserve(copyCount + 1);
+		m_ModelNode = m_SceneGraph.AddNode(SceneGraph::NO_PARENT, ToSceneTransform(meshTransform.World));
+
+		objects.Entities.Clear();
+		m_CopyNodes.clear();
+		m_CopyLocals.clear();
+		for (UINT copy = 0; copy < copyCount; copy++)
+		{
+			// 行ベクトルの Translation(x, 0, z) * World は、モデルのノードの子でローカルの平行移動が(x, 0, z)のノードになる
+			auto x = (static_cast<float>(copy % side) - (side - 1) * 0.5f) * spacing;
+			auto z = -static_cast<float>(copy / side) * spacing;
+			auto local = ToSceneTransform(XMMatrixTranslation(x, 0.0f, z));
+			auto node = m_SceneGraph.AddNode(m_ModelNode, local);
+			m_CopyNodes.push_back(node);
+			m_CopyLocals.push_back(local);
+			for (uint32_t i = 0; i < meshes.size(); i++)
+			{
+				auto entity = objects.Entities.Create(objects.Query.All());
+				objects.Entities.Get<MeshComponent>(entity)->Mesh = i;
+				objects.Entities.Get<NodeComponent>(entity)->Node = node;
+			}
+		}
+		// 最初のフレームで全ての物体の定数を送る
+		if (!objects.Constants.Init(objects.Entities.IndexCount(), sizeof(InstanceData)))
 		{
-			printf("定数バッファの生成に失敗\n");
 			return false;
 		}
-
-		// mapされている
-		auto ptr = constantBuffer[i]->GetPtr<Transform>();
-        ptr->World = XMMatrixTranslation(0.0f, -60.0f, 0.0f) * XMMatrixRotationX(XMConvertToRadians(0.0f)) * XMMatrixScaling(2.0f, 2.0f, 2.0f);
-		ptr->View = m_pCamera->GetViewMatrix();
-		ptr->Projection = XMMatrixPerspectiveFovRH(fov, aspect, 0.3f, 1000.0f);
-		ptr->WorldInvTranspose = XMMatrixIdentity();
+		m_SceneGraph.Update();
+		TransformSystem(objects, m_SceneGraph, true);
+		meshTransform.WorldInvTranspose = XMMatrixTranspose(XMMatrixInverse(nullptr, meshTransform.World));
 	}
 
 	// モデルのテクスチャ準備 
@@ -138,30 +446,67 @@ bool Scene::Init()
 		// auto texPath = ReplaceExtension(meshes[i].DiffuseMapPath, ".tga");
 		auto texPath = meshes[i].DiffuseMapPath;
 		auto mainTex = Texture2D::Get(texPath);
+		textures.push_back(mainTex);
 		auto handle = descriptorHeap->Register(mainTex);
 		materialHandles.push_back(handle);
 	}
 
+	// 深度を除いたキーで並べると、同じメッシュとマテリアルの物体が続けて並ぶ
+	objects.ObjectQueue.Clear();
+	objects.ObjectQueue.Reserve(objects.Entities.EntityCount());
+	objects.Entities.Each<const MeshComponent>(objects.Query, [&objects](Entity entity, const MeshComponent& mesh)
+	{
+		objects.ObjectQueue.Push(MeshKey(mesh.Mesh, 0), entity.Index);
+	});
+	objects.ObjectQueue.Sort();
+
 	// ライトの準備 ----------------------------------------------------------------------------------
-	SceneData sceneData = {};
+	sceneData = {};
 	sceneData.Lights[0].Position = { 1000.0f, 1000.0f, 1000.0f };
 	sceneData.LightCount = 1;
 	sceneData.CameraPosition = eyePos;
 
-	for (size_t i = 0; i < Engine::FRAME_BUFFER_COUNT; i++)
+	// 点光源は並べたモデルを囲む箱の中にばらまき、半径はモデルの大きさに合わせる
+	pointLights.clear();
+	if (g_AppOptions.PointLightCount > 0 && objects.Entities.EntityCount() > 0)
 	{
-		sceneBuffer[i] = new ConstantBuffer(sizeof(SceneData));
-		if (!sceneBuffer[i]->IsValid())
+		auto lightMin = XMVectorReplicate(FLT_MAX);
+		auto lightMax = XMVectorReplicate(-FLT_MAX);
+		float objectRadius = 0.0f;
+		objects.Entities.Each<const BoundsComponent>(objects.Query, [&](Entity, const BoundsComponent& bounds)
 		{
-			printf("ライト用定数バッファの生成に失敗\n");
-			return false;
+			auto center = XMLoadFloat3(&bounds.Center);
+			lightMin = XMVectorMin(lightMin, XMVectorSubtract(center, XMVectorReplicate(bounds.Radius)));
+			lightMax = XMVectorMax(lightMax, XMVectorAdd(center, XMVectorReplicate(bounds.Radius)));
+			objectRadius = bounds.Radius > objectRadius ? bounds.Radius : objectRadius;
+		});
+
+		uint32_t seed = 12345;
+		auto random = [&seed]()
+		{
+			seed = seed * 1664525u + 1013904223u;
+			return (seed >> 8 & 0xffff) / 65535.0f;
+		};
+		XMFLOAT3 boxMin, boxMax;
+		XMStoreFloat3(&boxMin, lightMin);
+		XMStoreFloat3(&boxMax, lightMax);
+		pointLights.resize(g_AppOptions.PointLightCount);
+		for (auto& light : pointLights)
+		{
+			light.Position[0] = boxMin.x + random() * (boxMax.x - boxMin.x);
+			light.Position[1] = boxMin.y + random() * (boxMax.y - boxMin.y);
+			light.Position[2] = boxMin.z + random() * (boxMax.z - boxMin.z);
+			light.Radius = objectRadius * (0.5f + random());
+			light.Color[0] = 0.2f + random() * 0.8f;
+			light.Color[1] = 0.2f + random() * 0.8f;
+			light.Color[2] = 0.2f + random() * 0.8f;
+			light.Intensity = light.Radius * light.Radius; // 減衰が1 / (距離^2 + 1)なので、半径の半分の辺りで1程度になるようにする
 		}
-
-		auto ptr = sceneBuffer[i]->GetPtr<SceneData>();
-		*ptr = sceneData;
+		printf("点光源: %zu個 (クラスター %dx%dx%d)\n", pointLights.size(),
+			ClusteredLighting::CLUSTER_X, ClusteredLighting::CLUSTER_Y, ClusteredLighting::CLUSTER_Z);
 	}
 
-	rootSignature = new RootSignature();
+	rootSignature = new RootSignature(true, MaterialTableSize);
 	if (!rootSignature->IsValid())
 	{
 		printf("ルートシグネチャの生成に失敗\n");
@@ -172,29 +517,49 @@ bool Scene::Init()
 	pipelineState->SetInputLayout(Vertex::InputLayout);
 	pipelineState->SetRootSignature(rootSignature->Get());
 
-	if (IsDebuggerPresent())
+	pipelineState->SetVertexShader(shaders->Get(L"SampleVS"));
+	pipelineState->SetPixelShader(shaders->Get(L"PBR"));
+
+	pipelineState->Create();
+	if (!pipelineState->IsValid())
 	{
-		pipelineState->SetVertexShader(L"../x64/Debug/SampleVS.cso");
-		pipelineState->SetPixelShader(L"../x64/Debug/PBR.cso");
+		printf("パイプラインステートの生成に失敗\n");
+		return false;
 	}
-	else
+
+	// GPUが詰めるコマンドはマテリアル番号しか変えないので、ヒープ全体のテーブルが要る
+	if (g_AppOptions.UseGpuCulling && !UseBindless)
 	{
-		pipelineState->SetVertexShader(L"SampleVS.cso");
-		pipelineState->SetPixelShader(L"PBR.cso");
+		printf("GPUカリングはバインドレスでしか使えないので無効にする\n");
+		g_AppOptions.UseGpuCulling = false;
 	}
 
-	pipelineState->Create();
-	if (!pipelineState->IsValid())
+	// GPUカリングの境界の球はInitで一度だけ書くので、動かす物体があると古い球で判定してしまう
+	if (g_AppOptions.UseGpuCulling && g_AppOptions.MovingObjectCount > 0)
 	{
-		printf("パイプラインステートの生成に失敗\n");
+		printf("GPUカリングは--moving-objectsと併用できないので無効にする\n");
+		g_AppOptions.UseGpuCulling = false;
+	}
+
+	// GPUカリングではCPUで描画を並べないので、オクルージョンカリングはCPUで並べる時だけ使う
+	if (g_AppOptions.UseOcclusionCulling && !g_AppOptions.UseGpuCulling)
+	{
+		objects.Occlusion = new OcclusionCuller();
+		objects.Occlusion->Init(OcclusionCuller::DEFAULT_WIDTH, OcclusionCuller::DEFAULT_HEIGHT);
+	}
+
+	if (g_AppOptions.UseGpuCulling && !InitGpuCulling(objects))
+	{
+		printf("GPUカリングの準備に失敗\n");
 		return false;
 	}
 
 	// スカイボックスの準備 ---------------------------------------------------------------------
 	{
-		auto texPath = L"Assets/Texture/BrightSky.dds";
-		auto skyBox = Texture2D::Get(texPath);
+		auto skyBox = Texture2D::Get(skyboxFile);
+		textures.push_back(skyBox);
 		skyboxHandle = descriptorHeap->Register(skyBox);
+		environmentTexture = skyBox;
 	}
 
      VertexPositionOnly skyboxVertices[] = {
@@ -243,21 +608,24 @@ bool Scene::Init()
 
 	perspective = XMMatrixPerspectiveFovRH(fov, aspect, 0.3f, 1000.0f);
 	// スカイボックスの頂点シェーダーに送る定数バッファ 
-	for (size_t i = 0; i < Engine::FRAME_BUFFER_COUNT; i++)
+	skyboxTransform.World = XMMatrixIdentity() * XMMatrixScaling(500.0f, 500.0f, 500.0f);
+	skyboxTransform.View = m_pCamera->GetViewMatrix();
+	skyboxTransform.Projection = XMMatrixPerspectiveFovRH(fov, aspect, 0.3f, 1000.0f);
+	skyboxTransform.WorldInvTranspose = XMMatrixIdentity();
+	cameraVersion = m_pCamera->GetVersion();
+	projectionZoom = m_pCamera->GetZoom();
+
+	// カメラで決まる定数はスロットごとに1つ持ち、最初に使う時に書く
+	viewConstantBuffers.clear();
+	viewConstantVersions.assign(g_Engine->FramesInFlight(), 0);
+	for (UINT i = 0; i < g_Engine->FramesInFlight(); i++)
 	{
-		skyboxBuffer[i] = new ConstantBuffer(sizeof(Transform));
-		if (!skyboxBuffer[i]->IsValid())
+		viewConstantBuffers.push_back(new ConstantBuffer(sizeof(ViewConstants)));
+		if (!viewConstantBuffers.back()->IsValid())
 		{
-			printf("定数バッファの生成に失敗\n");
+			printf("ビューの定数バッファの生成に失敗\n");
 			return false;
 		}
-
-		// mapされている
-		auto ptr = skyboxBuffer[i]->GetPtr<Transform>();
-		ptr->World = XMMatrixIdentity() * XMMatrixScaling(500.0f, 500.0f, 500.0f);
-		ptr->View = m_pCamera->GetViewMatrix();
-		ptr->Projection = XMMatrixPerspectiveFovRH(fov, aspect, 0.3f, 1000.0f);
-		ptr->WorldInvTranspose = XMMatrixIdentity();
 	}
 
 	
@@ -272,22 +640,81 @@ bool Scene::Init()
 	skyboxPipelineState->SetInputLayout(VertexPositionOnly::InputLayout);
 	skyboxPipelineState->SetRootSignature(skyboxRootSignature->Get());
 
-	if (IsDebuggerPresent())
+	skyboxPipelineState->SetVertexShader(shaders->Get(L"SkyboxVS"));
+	skyboxPipelineState->SetPixelShader(shaders->Get(L"SkyboxPS"));
+
+	skyboxPipelineState->Create();
+	if (!skyboxPipelineState->IsValid())
 	{
-		skyboxPipelineState->SetVertexShader(L"../x64/Debug/SkyboxVS.cso");
-		skyboxPipelineState->SetPixelShader(L"../x64/Debug/SkyboxPS.cso");
+		printf("スカイボックス用パイプラインステートの生成に失敗");
 	}
 
-	else
+	// 描画パスの登録 -----------------------------------------------------------------------
+	// エンジンのクリアの後に、スカイボックス、メッシュの順で同じ出力先に描く
+	auto frameGraph = g_Engine->FrameGraph();
+	auto backBuffer = g_Engine->BackBufferTarget();
+	auto depth = g_Engine->DepthTarget();
+
+	auto skyboxPass = frameGraph->AddPass("Skybox", [backBuffer, depth](RenderGraphExecutor& context)
 	{
-		skyboxPipelineState->SetVertexShader(L"SkyboxVS.cso");
-		skyboxPipelineState->SetPixelShader(L"SkyboxPS.cso");
+		DrawSkybox(context, backBuffer, depth);
+	});
+	frameGraph->Write(skyboxPass, backBuffer, RenderGraph::ACCESS_RENDER_TARGET);
+	frameGraph->Write(skyboxPass, depth, RenderGraph::ACCESS_DEPTH_WRITE);
+
+	// GPUカリングではコマンドと描画数をコンピュートシェーダーで書き、メッシュのパスで間接引数として読む
+	RenderGraph::ResourceHandle cullCommands = RenderGraph::INVALID_RESOURCE;
+	RenderGraph::ResourceHandle cullDrawCount = RenderGraph::INVALID_RESOURCE;
+	if (objects.GpuCuller != nullptr)
+	{
+		auto executor = g_Engine->FrameGraphExecutor();
+		cullCommands = executor->Import("CullCommands", RenderGraph::ACCESS_NONE, RenderGraph::ACCESS_NONE);
+		executor->SetImported(cullCommands, objects.GpuCuller->CommandBuffer());
+		cullDrawCount = executor->Import("CullDrawCount", RenderGraph::ACCESS_NONE, RenderGraph::ACCESS_NONE);
+		executor->SetImported(cullDrawCount, objects.GpuCuller->CountBuffer());
+
+		auto cullPass = frameGraph->AddPass("MeshCulling", [this](RenderGraphExecutor& context)
+		{
+			m_pObjects->GpuCuller->Cull(context.CommandList(), m_pObjects->CullConstantsAddress);
+		});
+		frameGraph->Write(cullPass, cullCommands, RenderGraph::ACCESS_UNORDERED_ACCESS);
+		frameGraph->Write(cullPass, cullDrawCount, RenderGraph::ACCESS_UNORDERED_ACCESS);
+
+		// 確かめるフレームだけ結果をコピーする（読み込み同士なのでメッシュのパスと同じ遷移にまとまる）
+		auto readbackPass = frameGraph->AddPass("CullReadback", [this](RenderGraphExecutor& context)
+		{
+			if (g_Engine->FrameCount() == CullVerifyFrame)
+			{
+				m_pObjects->GpuCuller->CopyResults(context.CommandList());
+			}
+		});
+		frameGraph->Read(readbackPass, cullCommands, RenderGraph::ACCESS_COPY_SOURCE);
+		frameGraph->Read(readbackPass, cullDrawCount, RenderGraph::ACCESS_COPY_SOURCE);
+		frameGraph->SetSideEffect(readbackPass);
 	}
 
-	skyboxPipelineState->Create();
-	if (!skyboxPipelineState->IsValid())
+	// 変わった物体の定数をコピーしてから、メッシュのパスで読む
+	auto objectResource = g_Engine->FrameGraphExecutor()->Import("ObjectConstants", RenderGraph::ACCESS_NONE, RenderGraph::ACCESS_NONE);
+	g_Engine->FrameGraphExecutor()->SetImported(objectResource, objects.Constants.Resource());
+	auto objectUploadPass = frameGraph->AddPass("ObjectUpload", [this](RenderGraphExecutor& context)
 	{
-		printf("スカイボックス用パイプラインステートの生成に失敗");
+		m_pObjects->Constants.RecordCopies(context.CommandList());
+		apiCallCount += static_cast<UINT>(m_pObjects->Constants.Copies().size());
+	});
+	frameGraph->Write(objectUploadPass, objectResource, RenderGraph::ACCESS_COPY_DEST);
+
+	// メッシュはワーカーのリストに記録し、それらはメインのリストの後に実行されるので、このパスは最後にする
+	auto meshPass = frameGraph->AddPass("Meshes", [this, backBuffer, depth](RenderGraphExecutor& context)
+	{
+		DrawMeshes(*m_pObjects, context, backBuffer, depth);
+	});
+	frameGraph->Write(meshPass, backBuffer, RenderGraph::ACCESS_RENDER_TARGET);
+	frameGraph->Write(meshPass, depth, RenderGraph::ACCESS_DEPTH_WRITE);
+	frameGraph->Read(meshPass, objectResource, RenderGraph::ACCESS_NON_PIXEL_SHADER);
+	if (objects.GpuCuller != nullptr)
+	{
+		frameGraph->Read(meshPass, cullCommands, RenderGraph::ACCESS_INDIRECT_ARGUMENT);
+		frameGraph->Read(meshPass, cullDrawCount, RenderGraph::ACCESS_INDIRECT_ARGUMENT);
 	}
 
 	// IBL用のイラディアンスマップをつくる
@@ -303,252 +730,645 @@ bool Scene::Init()
 }
 
 
+// 物体をobjects.ObjectQueueの順（同じメッシュとマテリアルが続く順）に並べてカリング用のバッファを作る
+// 並べた順番がそのままインスタンスの番号になる。物体の定数はCPUで並べる時と同じくobjects.Constantsから読む
+bool InitGpuCulling(SceneObjects& objects)
+{
+	auto& items = objects.ObjectQueue.Items();
+	objects.StaticInstanceObjects = new ConstantBuffer(sizeof(uint32_t) * items.size());
+	if (!objects.StaticInstanceObjects->IsValid())
+	{
+		printf("インスタンスの物体の番号のバッファの生成に失敗\n");
+		return false;
+	}
+
+	auto pInstances = objects.StaticInstanceObjects->GetPtr<uint32_t>();
+	std::vector<IndirectCull::CullObject> cullObjects;
+	cullObjects.reserve(items.size());
+	for (uint32_t i = 0; i < items.size(); i++)
+	{
+		auto mesh = objects.Component<MeshComponent>(items[i].Draw).Mesh;
+		auto& bounds = objects.Component<BoundsComponent>(items[i].Draw);
+		pInstances[i] = items[i].Draw;
+
+		// テーブルは張り替えられないので、GPUカリングでは常にマテリアル番号でテクスチャを引く
+		IndirectCommand command = {};
+		command.VertexBuffer = vertexBuffers[mesh]->View();
+		command.IndexBuffer = indexBuffers[mesh]->View();
+		command.Material = materialHandles[mesh]->Index;
+		command.FirstInstance = i;
+		command.Draw.IndexCountPerInstance = static_cast<UINT>(meshes[mesh].Indices.size());
+		command.Draw.InstanceCount = 1;
+		cullObjects.push_back(IndirectCuller::MakeObject(bounds.Center, bounds.Radius, command));
+	}
+
+	objects.GpuCuller = new IndirectCuller();
+	return objects.GpuCuller->Init(rootSignature->Get(), g_Engine->Shaders()->Get(L"IndirectCullCS"), cullObjects);
+}
+
 float rotateY = 0.0f;
 float rotateX = 90.0f;
 void Scene::Update()
 {
+	PROFILE_SCOPE("Scene::Update");
 	ProcessInput();
 
 	rotateY += 0.02f;
-	auto currentIndex = g_Engine->CurrentBackBufferIndex();
-	auto currentTransform = constantBuffer[currentIndex]->GetPtr<Transform>();
-	// currentTransform->World = XMMatrixRotationY(rotateY);
-	currentTransform->WorldInvTranspose = XMMatrixTranspose(XMMatrixInverse(nullptr, currentTransform->World));
-	// View行列をデバッグ用に出力
-	XMFLOAT4X4 viewMatrix;
-	XMStoreFloat4x4(&viewMatrix, currentTransform->View);
+	auto currentTransform = &meshTransform;
 
-	currentTransform->View = m_pCamera->GetViewMatrix();
+	// --moving-objects: 並べたモデルの先頭からn個をその場で回す（回したモデルの物体の定数だけが送られる）
+	auto movingCount = std::min<size_t>(g_AppOptions.MovingObjectCount, m_CopyNodes.size());
+	for (size_t i = 0; i < movingCount; i++)
+	{
+		auto local = m_CopyLocals[i];
+		local.Rotation[1] = sinf(rotateY * 0.5f);
+		local.Rotation[3] = cosf(rotateY * 0.5f);
+		m_SceneGraph.SetLocal(m_CopyNodes[i], local);
+	}
 
-	currentTransform->Projection = XMMatrixPerspectiveFovRH(XMConvertToRadians(m_pCamera->GetZoom()), 
-		static_cast<float>(WINDOW_WIDTH) / static_cast<float>(WINDOW_HEIGHT), 0.3f, 1000.0f);
+	// 変えたノードとその子孫だけを求め直す。モデル全体の逆転置も変わった時だけ求める
+	m_SceneGraph.Update();
+	TransformSystem(*m_pObjects, m_SceneGraph, false);
+	bool viewChanged = false;
+	if (m_SceneGraph.WorldChanged(m_ModelNode))
+	{
+		currentTransform->World = ToMatrix(m_SceneGraph.World(m_ModelNode));
+		currentTransform->WorldInvTranspose = XMMatrixTranspose(XMMatrixInverse(nullptr, currentTransform->World));
+		viewChanged = true;
+	}
 
-	auto currentScene = sceneBuffer[currentIndex]->GetPtr<SceneData>();
-	currentScene->CameraPosition = m_pCamera->GetCameraPosition();
+	// ビューはカメラが動いた時だけ、射影はズームが変わった時だけ作り直す
+	if (m_pCamera->GetVersion() != cameraVersion)
+	{
+		cameraVersion = m_pCamera->GetVersion();
+		currentTransform->View = m_pCamera->GetViewMatrix();
+		sceneData.CameraPosition = m_pCamera->GetCameraPosition();
+
+		auto currentSkybox = &skyboxTransform;
+		currentSkybox->View = currentTransform->View;
+		currentSkybox->View.r[3] = XMVectorSet(0, 0, 0, 1);
+		viewChanged = true;
+	}
+
+	if (m_pCamera->GetZoom() != projectionZoom)
+	{
+		projectionZoom = m_pCamera->GetZoom();
+		currentTransform->Projection = XMMatrixPerspectiveFovRH(XMConvertToRadians(projectionZoom),
+			static_cast<float>(WINDOW_WIDTH) / static_cast<float>(WINDOW_HEIGHT), 0.3f, 1000.0f);
+		viewChanged = true;
+	}
 
-	auto currentSkybox = skyboxBuffer[currentIndex]->GetPtr<Transform>();
-	currentSkybox->View = m_pCamera->GetViewMatrix();
-	currentSkybox->View.r[3] = XMVectorSet(0, 0, 0, 1);
+	if (viewChanged)
+	{
+		viewVersion++;
+	}
 }
 
-void Scene::Draw()
-{
+// パイプラインが変わった時にRecordMeshesが設定し直す呼び出しの数（ルートシグネチャからテクスチャのテーブルか定数まで）
+const UINT MeshPipelineCallCount = 12;
 
-	auto currentIndex = g_Engine->CurrentBackBufferIndex();
-	auto commandList = g_Engine->CommandList();
-	auto materialHeap = descriptorHeap->Get();
+// 変わったフィールドの分だけ状態を設定した時に発行するAPIの数。RecordMeshesで記録した数と合うことをassertで確かめる
+UINT MeshApiCallCount(uint32_t changed)
+{
+	UINT count = 2; // インスタンスの先頭番号とDrawIndexedInstanced
+	if (changed & (DrawKey::FIELD_PASS | DrawKey::FIELD_PIPELINE))
+	{
+		count += MeshPipelineCallCount;
+		changed |= DrawKey::FIELD_MATERIAL;
+	}
+	count += (changed & DrawKey::FIELD_MATERIAL) ? 1 : 0;
+	count += (changed & DrawKey::FIELD_GEOMETRY) ? 2 : 0;
+	return count;
+}
 
-	auto vbView = skyboxVertexBuffer->View();
-	auto ibView = skyboxIndexBuffer->View();
+// 手前で大きく見える物体から三角形の予算まで遮蔽物としてラスタライズし、隠れている物体に印を付ける
+// 遮蔽物に選んだ物体も判定する（自分の境界の手前側は自分の面より手前にあるので、自分で隠れることは無い）
+void CullOccludedObjects(SceneObjects& objects, const std::function<float(const XMFLOAT3&)>& viewDepth)
+{
+	PROFILE_SCOPE("CullOccludedObjects");
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, meshTransform.View * meshTransform.Projection);
+	objects.Occlusion->BeginFrame(&viewProjection.m[0][0]);
+
+	// 半径 / 距離が大きいほど画面で大きく見える（カメラの後ろの物は候補にしない）
+	std::vector<float> scores(objects.Entities.IndexCount());
+	objects.OccluderOrder.clear();
+	objects.Entities.Each<const BoundsComponent>(objects.Query, [&](Entity entity, const BoundsComponent& bounds)
+	{
+		auto depth = viewDepth(bounds.Center);
+		if (depth + bounds.Radius > 0.0f)
+		{
+			scores[entity.Index] = bounds.Radius / (depth > bounds.Radius ? depth : bounds.Radius);
+			objects.OccluderOrder.push_back(entity.Index);
+		}
+	});
+	std::sort(objects.OccluderOrder.begin(), objects.OccluderOrder.end(), [&](uint32_t a, uint32_t b) { return scores[a] > scores[b]; });
 
-	commandList->SetGraphicsRootSignature(skyboxRootSignature->Get());
-	commandList->SetPipelineState(skyboxPipelineState->Get());
+	size_t triangleCount = 0;
+	for (auto i : objects.OccluderOrder)
+	{
+		auto& mesh = meshes[objects.Component<MeshComponent>(i).Mesh];
+		if (mesh.Vertices.empty() || triangleCount + mesh.Indices.size() / 3 > OccluderTriangleBudget)
+		{
+			continue;
+		}
+		objects.Occlusion->AddOccluder(&mesh.Vertices[0].Position.x, mesh.Vertices.size(), sizeof(Vertex),
+			mesh.Indices.data(), mesh.Indices.size(), &objects.Component<InstanceData>(i).World[0].x);
+		triangleCount += mesh.Indices.size() / 3;
+	}
+	objects.Occlusion->Rasterize();
 
-	commandList->SetGraphicsRootConstantBufferView(3, skyboxBuffer[currentIndex]->GetAddress());
+	// 判定はバッファを読むだけなので、チャンクごとに並列に行う
+	objects.Occluded.resize(objects.Entities.IndexCount());
+	objects.Entities.ParallelEach<const BoundsComponent>(objects.Query, [&objects](Entity entity, const BoundsComponent& bounds)
+	{
+		objects.Occluded[entity.Index] = objects.Occlusion->IsSphereOccluded(&bounds.Center.x, bounds.Radius) ? 1 : 0;
+	});
 
-	commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	commandList->IASetVertexBuffers(0, 1, &vbView);
-	commandList->IASetIndexBuffer(&ibView);
+	objects.OccludedCount = 0;
+	for (auto occluded : objects.Occluded)
+	{
+		objects.OccludedCount += occluded;
+	}
+	objects.Occlusion->CountTests(objects.Entities.EntityCount(), objects.OccludedCount);
+}
 
-	commandList->SetDescriptorHeaps(1, &materialHeap);
-	commandList->SetGraphicsRootDescriptorTable(1, skyboxHandle->HandleGPU);
-	
-	commandList->DrawIndexedInstanced(36, 1, 0, 0, 0);
+// 物体をバッチにまとめてキーで並べ替え、並べた順の記録コストを見積もる
+// インスタンスごとの物体の番号はバッチの順にこのフレームのリングバッファに書く。インスタンシングが無効なら物体ごとに1つのバッチにする
+void BuildMeshQueue(SceneObjects& objects)
+{
+	PROFILE_SCOPE("BuildMeshQueue");
+	// 射影と同じ範囲で深度を0～1にする
+	const float NearZ = 0.3f;
+	const float FarZ = 1000.0f;
+	auto view = meshTransform.View;
+	auto viewDepth = [&](const XMFLOAT3& center)
+	{
+		// 右手系なのでビュー空間では-Zが前
+		auto viewPosition = XMVector3Transform(XMLoadFloat3(&center), view);
+		return -XMVectorGetZ(viewPosition);
+	};
+	auto depthBucket = [&](const XMFLOAT3& center)
+	{
+		return DrawKey::DepthBucket((viewDepth(center) - NearZ) / (FarZ - NearZ));
+	};
 
+	meshQueue.Clear();
+	objects.Batches.clear();
+	drawCosts.clear();
 
-	for (size_t i = 0; i < meshes.size(); i++)
+	// 隠れている物体はインスタンスにも入れない
+	objects.Occluded.assign(objects.Entities.IndexCount(), 0);
+	if (objects.Occlusion != nullptr)
 	{
-		auto vbView = vertexBuffers[i]->View();
-		auto ibView = indexBuffers[i]->View();
+		CullOccludedObjects(objects, viewDepth);
+	}
 
-		commandList->SetGraphicsRootSignature(rootSignature->Get());
-		commandList->SetPipelineState(pipelineState->Get());
-		// slot0にバインドされる
-		commandList->SetGraphicsRootConstantBufferView(0, constantBuffer[currentIndex]->GetAddress());
-	    commandList->SetGraphicsRootConstantBufferView(2, sceneBuffer[currentIndex]->GetAddress());
+	auto objectCount = objects.Entities.EntityCount();
+	auto allocation = g_Engine->FrameConstants()->Allocate(sizeof(uint32_t) * objectCount);
+	if (allocation.Ptr == nullptr)
+	{
+		return;
+	}
+	objects.InstanceObjectsAddress = allocation.Address;
+	instanceUploadTotal += sizeof(uint32_t) * objectCount;
+	auto pInstances = static_cast<uint32_t*>(allocation.Ptr);
 
-		commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		commandList->IASetVertexBuffers(0, 1, &vbView);
-		commandList->IASetIndexBuffer(&ibView);
+	if (g_AppOptions.UseInstancing)
+	{
+		auto& sorted = objects.ObjectQueue.Items();
+		uint32_t instanceCount = 0;
+		uint64_t lastKey = 0;
+		for (uint32_t i = 0; i < objectCount; i++)
+		{
+			if (objects.Occluded[sorted[i].Draw])
+			{
+				continue;
+			}
+			pInstances[instanceCount] = sorted[i].Draw;
+
+			auto depth = depthBucket(objects.Component<BoundsComponent>(sorted[i].Draw).Center);
+			if (instanceCount == 0 || sorted[i].Key != lastKey)
+			{
+				objects.Batches.push_back({ objects.Component<MeshComponent>(sorted[i].Draw).Mesh, instanceCount, 0, depth });
+				lastKey = sorted[i].Key;
+			}
+			instanceCount++;
+
+			auto& batch = objects.Batches.back();
+			batch.InstanceCount++;
+			batch.Depth = depth < batch.Depth ? depth : batch.Depth;
+		}
 
-		commandList->SetDescriptorHeaps(1, &materialHeap);
-		commandList->SetGraphicsRootDescriptorTable(1, materialHandles[i]->HandleGPU);
+		for (uint32_t i = 0; i < objects.Batches.size(); i++)
+		{
+			meshQueue.Push(MeshKey(objects.Batches[i].Mesh, objects.Batches[i].Depth), i);
+		}
+		meshQueue.Sort();
+	}
+	else
+	{
+		objects.Entities.Each<const MeshComponent, const BoundsComponent>(objects.Query,
+			[&](Entity entity, const MeshComponent& mesh, const BoundsComponent& bounds)
+		{
+			if (!objects.Occluded[entity.Index])
+			{
+				meshQueue.Push(MeshKey(mesh.Mesh, depthBucket(bounds.Center)), entity.Index);
+			}
+		});
+		meshQueue.Sort();
+
+		// 描画の番号は物体の番号のままなので、バッチも物体の番号で引けるようにする
+		objects.Batches.resize(objects.Entities.IndexCount());
+		auto& items = meshQueue.Items();
+		for (uint32_t i = 0; i < items.size(); i++)
+		{
+			pInstances[i] = items[i].Draw;
+			objects.Batches[items[i].Draw] = { objects.Component<MeshComponent>(items[i].Draw).Mesh, i, 1, DrawKey::Depth(items[i].Key) };
+		}
+	}
 
-		commandList->DrawIndexedInstanced(meshes[i].Indices.size(), 1, 0, 0, 0);
+	drawCosts.resize(meshQueue.Size());
+	auto& items = meshQueue.Items();
+	for (uint32_t i = 0; i < items.size(); i++)
+	{
+		auto changed = i == 0 ? static_cast<uint32_t>(DrawKey::FIELD_ALL) : DrawKey::ChangedFields(items[i - 1].Key, items[i].Key);
+		drawCosts[i] = MeshApiCallCount(changed);
 	}
-	
 }
 
-bool Scene::CreateIrradianceMapResource()
+// 並べ替えたバッチのbegin～end番目の描画を記録する
+// コマンドリスト間では状態が引き継がれないので、範囲の最初の描画では全ての状態を設定する
+void RecordMeshes(const SceneObjects& objects, CommandListFilter<>& commandList, uint32_t begin, uint32_t end,
+	D3D12_GPU_VIRTUAL_ADDRESS transformAddress, D3D12_GPU_VIRTUAL_ADDRESS sceneAddress,
+	const ClusterAddresses& cluster, DrawStateChanges* pChanges)
 {
-	auto heapProp = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-	auto texDesc = CD3DX12_RESOURCE_DESC::Tex2D(
-		DXGI_FORMAT_R16G16B16A16_FLOAT,
-		32, 32, 6, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET
-	);
-	
-	D3D12_CLEAR_VALUE clearValue = {};
-	clearValue.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
-	clearValue.Color[0] = 0.0f;
-	clearValue.Color[1] = 0.0f;
-	clearValue.Color[2] = 0.0f;
-	clearValue.Color[3] = 1.0f;
-
-	HRESULT hr = g_Engine->Device()->CreateCommittedResource(
-		&heapProp,
-		D3D12_HEAP_FLAG_NONE,
-		&texDesc,
-		D3D12_RESOURCE_STATE_RENDER_TARGET,
-		&clearValue,
-		IID_PPV_ARGS(IrradianceMap.ReleaseAndGetAddressOf())
-		);
-	if (FAILED(hr))
-	{
-		printf("イラディアンスマップリソース作成失敗\n");
-		return false;
-	}
+	auto materialHeap = descriptorHeap->Get();
+
+	*pChanges = meshQueue.Submit(begin, end, [&](const DrawItem& item, uint32_t changed)
+	{
+		auto& batch = objects.Batches[item.Draw];
+		auto i = batch.Mesh;
+#ifndef NDEBUG
+		auto estimatedCalls = MeshApiCallCount(changed);
+		auto callsBefore = commandList.IssuedCount() + commandList.ElidedCount();
+#endif
+
+		if (changed & (DrawKey::FIELD_PASS | DrawKey::FIELD_PIPELINE))
+		{
+			commandList.SetGraphicsRootSignature(rootSignature->Get());
+			commandList.SetPipelineState(pipelineState->Get());
+			commandList.SetGraphicsRootConstantBufferView(0, transformAddress);
+			commandList.SetGraphicsRootConstantBufferView(2, sceneAddress);
+			commandList.SetGraphicsRootShaderResourceView(7, objects.Constants.GpuAddress());
+			commandList.SetGraphicsRootShaderResourceView(11, objects.InstanceObjectsAddress);
+			commandList.SetGraphicsRootConstantBufferView(8, cluster.Constants);
+			commandList.SetGraphicsRootShaderResourceView(9, cluster.Lights);
+			commandList.SetGraphicsRootShaderResourceView(10, cluster.Lists);
+			commandList.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+			commandList.SetDescriptorHeaps(1, &materialHeap);
+			if (UseBindless)
+			{
+				// テクスチャは全てヒープ先頭からのテーブルに入っているので、描画ごとにはマテリアル番号だけを渡す
+				commandList.SetGraphicsRootDescriptorTable(5, materialHeap->GetGPUDescriptorHandleForHeapStart());
+			}
+			else
+			{
+				// 従来通りマテリアルごとにテーブルを張り替える（シェーダー側のマテリアル番号は0）
+				commandList.SetGraphicsRoot32BitConstant(4, 0, 0);
+			}
+
+			// ルートシグネチャを設定し直すとルート引数も無効になるので、マテリアルも設定し直す
+			changed |= DrawKey::FIELD_MATERIAL;
+		}
 
-	D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
-	rtvHeapDesc.NumDescriptors = 6;
-	rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-	rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+		if (changed & DrawKey::FIELD_MATERIAL)
+		{
+			if (UseBindless)
+			{
+				commandList.SetGraphicsRoot32BitConstant(4, materialHandles[i]->Index, 0);
+			}
+			else
+			{
+				commandList.SetGraphicsRootDescriptorTable(5, materialHandles[i]->HandleGPU);
+			}
+		}
 
-	hr = g_Engine->Device()->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&irradianceMapRtvHeap));
-	if (FAILED(hr)) return false;
-	auto irradianceRtvHandle = irradianceMapRtvHeap->GetCPUDescriptorHandleForHeapStart();
+		if (changed & DrawKey::FIELD_GEOMETRY)
+		{
+			auto vbView = vertexBuffers[i]->View();
+			auto ibView = indexBuffers[i]->View();
+			commandList.IASetVertexBuffers(0, 1, &vbView);
+			commandList.IASetIndexBuffer(&ibView);
+		}
+
+		// SV_InstanceIDは描画ごとに0から始まるので、物体の番号の並びの上の先頭はルート定数で渡す
+		commandList.SetGraphicsRoot32BitConstant(6, batch.FirstInstance, 0);
+		commandList.DrawIndexedInstanced(static_cast<UINT>(meshes[i].Indices.size()), batch.InstanceCount, 0, 0, 0);
 
-	for (UINT i = 0; i < 6; ++i)
+		// 記録の分け方の見積もりは、省略した分も含めてここで記録した呼び出しの数と同じでなければならない
+		assert(commandList.IssuedCount() + commandList.ElidedCount() - callsBefore == estimatedCalls);
+
+		FrameStats::Add(STAT_DRAW_CALLS, 1);
+		FrameStats::Add(STAT_INSTANCES, batch.InstanceCount);
+		FrameStats::Add(STAT_TRIANGLES, static_cast<int64_t>(meshes[i].Indices.size() / 3) * batch.InstanceCount);
+	});
+}
+
+// GPUが詰めたコマンドをExecuteIndirectで描く。CPUは共通の状態を設定するだけで、描画の数によらない
+void RecordMeshesIndirect(const SceneObjects& objects, CommandListFilter<>& commandList, D3D12_GPU_VIRTUAL_ADDRESS transformAddress, D3D12_GPU_VIRTUAL_ADDRESS sceneAddress,
+	const ClusterAddresses& cluster)
+{
+	auto materialHeap = descriptorHeap->Get();
+	commandList.SetGraphicsRootSignature(rootSignature->Get());
+	commandList.SetPipelineState(pipelineState->Get());
+	commandList.SetGraphicsRootConstantBufferView(0, transformAddress);
+	commandList.SetGraphicsRootConstantBufferView(2, sceneAddress);
+	commandList.SetGraphicsRootShaderResourceView(7, objects.Constants.GpuAddress());
+	commandList.SetGraphicsRootShaderResourceView(11, objects.StaticInstanceObjects->GetAddress());
+	commandList.SetGraphicsRootConstantBufferView(8, cluster.Constants);
+	commandList.SetGraphicsRootShaderResourceView(9, cluster.Lights);
+	commandList.SetGraphicsRootShaderResourceView(10, cluster.Lists);
+	commandList.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	commandList.SetDescriptorHeaps(1, &materialHeap);
+	commandList.SetGraphicsRootDescriptorTable(5, materialHeap->GetGPUDescriptorHandleForHeapStart());
+	objects.GpuCuller->Draw(commandList.Get());
+
+	// 描く物体と三角形の数はGPUで決まるので、CPUでは発行した1回だけを数える
+	FrameStats::Add(STAT_DRAW_CALLS, 1);
+}
+
+// 点光源をこのフレームのカメラでクラスターに振り分け、ライトと並びをリングバッファに書く
+// 書き込めなければこのフレームは点光源を使わない
+void UploadPointLights(ConstantRing* frameConstants)
+{
+	ClusterConstants constants = {};
+	ConstantAllocation lights;
+	ConstantAllocation lists;
+	if (!pointLights.empty())
 	{
-		D3D12_RENDER_TARGET_VIEW_DESC rtvDesc = {};
-		rtvDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
-		rtvDesc.ViewDimension = D3D12_RTV_DIMENSION_TEXTURE2DARRAY;
-		rtvDesc.Texture2DArray.MipSlice = 0;
-		rtvDesc.Texture2DArray.FirstArraySlice = i;
-		rtvDesc.Texture2DArray.ArraySize = 1;
-		rtvDesc.Texture2DArray.PlaneSlice = 0;
-		g_Engine->Device()->CreateRenderTargetView(IrradianceMap.Get(), &rtvDesc, irradianceRtvHandle);
-		irradianceRtvHandle.ptr += g_Engine->Device()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+		PROFILE_SCOPE("ClusteredLighting");
+		XMFLOAT4X4 view;
+		XMFLOAT4X4 projection;
+		XMStoreFloat4x4(&view, meshTransform.View);
+		XMStoreFloat4x4(&projection, meshTransform.Projection);
+		clusteredLighting.Init(WINDOW_WIDTH, WINDOW_HEIGHT, &projection.m[0][0]);
+		clusteredLighting.Build(&view.m[0][0], pointLights.data(), static_cast<uint32_t>(pointLights.size()));
+
+		auto& clusterLists = clusteredLighting.Lists();
+		lights = frameConstants->Allocate(sizeof(PointLight) * pointLights.size());
+		lists = frameConstants->Allocate(sizeof(uint32_t) * clusterLists.size());
+		if (lights.Ptr != nullptr && lists.Ptr != nullptr)
+		{
+			memcpy(lights.Ptr, pointLights.data(), sizeof(PointLight) * pointLights.size());
+			memcpy(lists.Ptr, clusterLists.data(), sizeof(uint32_t) * clusterLists.size());
+			constants = clusteredLighting.MakeConstants();
+		}
 	}
 
-	return true;
+	clusterAddresses.Constants = frameConstants->Push(constants);
+	clusterAddresses.Lights = constants.LightCount > 0 ? lights.Address : clusterAddresses.Constants;
+	clusterAddresses.Lists = constants.LightCount > 0 ? lists.Address : clusterAddresses.Constants;
 }
 
-void Scene::RenderIrradianceMap()
+void Scene::Draw()
 {
-	
-	RootSignature* irradianceMapRootSignature = new RootSignature();
-	if (!irradianceMapRootSignature->IsValid())
+	PROFILE_SCOPE("Scene::Draw");
+	auto& objects = *m_pObjects;
+
+	// 計算キューでの焼き込みを進め、焼き終わった組をスカイボックスに表示する
+	if (environmentBaker != nullptr)
 	{
-		printf("イラディアンスマップ用のルートシグネチャの生成に失敗\n");
+		environmentBaker->BeginFrame();
+		auto front = environmentBaker->FrontTarget();
+		if (front != BakeScheduler::NO_TARGET)
+		{
+			skyboxHandle = irradianceHandles[front];
+		}
 	}
 
-	PipelineState* irradianceMapPipelineState = new PipelineState();
-	irradianceMapPipelineState->SetInputLayout(VertexPositionOnly::InputLayout);
-	irradianceMapPipelineState->SetRootSignature(irradianceMapRootSignature->Get());
+	// カメラで決まる定数は、このスロットのバッファに書いた版が古い時だけ書き直す
+	auto slot = g_Engine->CurrentFrameSlot();
+	auto viewBuffer = viewConstantBuffers[slot];
+	if (viewConstantVersions[slot] != viewVersion)
+	{
+		auto pView = viewBuffer->GetPtr<ViewConstants>();
+		pView->Mesh = meshTransform;
+		pView->Scene = sceneData;
+		pView->Skybox = skyboxTransform;
+		viewConstantVersions[slot] = viewVersion;
+		FrameStats::Add(STAT_UPLOAD_BYTES, sizeof(ViewConstants));
+		viewUploadTotal += sizeof(ViewConstants);
+	}
+	meshTransformAddress = viewBuffer->GetAddress() + offsetof(ViewConstants, Mesh);
+	sceneDataAddress = viewBuffer->GetAddress() + offsetof(ViewConstants, Scene);
+	skyboxTransformAddress = viewBuffer->GetAddress() + offsetof(ViewConstants, Skybox);
+
+	// 変わった物体の定数とフレームごとの定数は、スロットのリングバッファに書き込む（GPUが前のフレームで読んでいる領域には触らない）
+	// 物体の定数はリングに入らなければ印を残し、次のフレームで送る
+	auto frameConstants = g_Engine->FrameConstants();
+	objects.Constants.Upload(frameConstants);
+	objectUploadTotal += objects.Constants.GetStats().UploadBytes;
+	objectCopyTotal += objects.Constants.GetStats().CopyCount;
+	if (objects.GpuCuller != nullptr)
+	{
+		objects.CullConstants = IndirectCuller::MakeConstants(meshTransform.View * meshTransform.Projection, objects.GpuCuller->ObjectCount());
+		objects.CullConstantsAddress = frameConstants->Push(objects.CullConstants);
+		if (g_Engine->FrameCount() == CullVerifyFrame)
+		{
+			objects.VerifyConstants = objects.CullConstants;
+		}
+	}
+	UploadPointLights(frameConstants);
 
-	if (IsDebuggerPresent())
+	// 描画そのものはInitで登録したパスで行う
+	apiCallCount = 0;
+	apiElidedCount = 0;
+	g_Engine->ExecuteFrameGraph();
+	FrameStats::Add(STAT_API_CALLS, apiCallCount);
+	FrameStats::Add(STAT_STATE_CHANGES, meshStateChanges.Pipeline + meshStateChanges.Material + meshStateChanges.Geometry);
+
+	// 1フレームあたりのAPIコール数を最初のフレームだけ出力する
+	if (g_Engine->FrameCount() == 0)
 	{
-		irradianceMapPipelineState->SetVertexShader(L"../x64/Debug/SkyboxVS.cso");
-		irradianceMapPipelineState->SetPixelShader(L"../x64/Debug/IrradiancePS.cso");
+		printf("描画APIコール数: %u (省略 %u, メッシュ数 %zu, バインドレス %s)\n",
+			apiCallCount, apiElidedCount, meshes.size(), UseBindless ? "有効" : "無効");
+		printf("メッシュの記録: %zuスレッド %.3f ms (並べ替え %.3f ms)\n", meshRecordThreads, meshRecordTime, meshSortTime);
+		printf("メッシュの状態の切り替え: パイプライン %u, マテリアル %u, ジオメトリ %u (描画 %u)\n",
+			meshStateChanges.Pipeline, meshStateChanges.Material, meshStateChanges.Geometry, meshStateChanges.Draws);
+		auto& objectStats = objects.Constants.GetStats();
+		printf("物体の定数: 最初のフレームで %u個 %llu bytes (コピー %u回)\n",
+			objectStats.SentObjects, static_cast<unsigned long long>(objectStats.UploadBytes), objectStats.CopyCount);
 	}
 
-	else
+	// 最初のフレームは準備の分だけ遅いので、しばらく平均してから出力する
+	if (g_Engine->FrameCount() + 1 == SubmitTimeFrames)
 	{
-		irradianceMapPipelineState->SetVertexShader(L"SkyboxVS.cso");
-		irradianceMapPipelineState->SetPixelShader(L"IrradiancePS.cso");
+		printf("メッシュの送信(CPU): %.3f ms (%uフレームの平均, 物体 %u, 描画 %u, インスタンシング %s)\n",
+			meshSubmitTimeTotal / SubmitTimeFrames, SubmitTimeFrames, objects.Entities.EntityCount(), meshQueue.Size(),
+			g_AppOptions.UseInstancing ? "有効" : "無効");
+
+		// 動かない物体は最初のフレームの後は送らないので、動かす物体の数で1フレームの量が決まる
+		printf("定数の送信: 1フレーム平均 %.0f bytes (ビュー %.0f, 物体 %.0f, インスタンスの番号 %.0f, 物体のコピー %.1f回, 動かすモデル %u個)\n",
+			static_cast<double>(viewUploadTotal + objectUploadTotal + instanceUploadTotal) / SubmitTimeFrames,
+			static_cast<double>(viewUploadTotal) / SubmitTimeFrames, static_cast<double>(objectUploadTotal) / SubmitTimeFrames,
+			static_cast<double>(instanceUploadTotal) / SubmitTimeFrames, static_cast<double>(objectCopyTotal) / SubmitTimeFrames,
+			static_cast<UINT>(std::min<size_t>(g_AppOptions.MovingObjectCount, m_CopyNodes.size())));
 	}
 
-	irradianceMapPipelineState->Create();
-	if (!irradianceMapPipelineState->IsValid())
+	if (!pointLights.empty() && g_Engine->FrameCount() + 1 == SubmitTimeFrames)
 	{
-		printf("スカイボックス用パイプラインステートの生成に失敗");
+		auto& stats = clusteredLighting.GetStats();
+		printf("クラスターライティング: 点光源 %u個中 %u個が視錐台に掛かる (番号 %u, 1クラスターの最大 %u, 変換 %.3f ms, 振り分け %.3f ms)\n",
+			stats.LightCount, stats.VisibleLights, stats.IndexCount, stats.MaxClusterLights, stats.TransformTime, stats.BinTime);
 	}
 
-	XMMATRIX captureProjection = XMMatrixPerspectiveFovRH(XMConvertToRadians(90.0f), 1.0f, 0.1f, 10.0f);
-
-	XMMATRIX captureViews[6] =
-	{
-		XMMatrixLookAtRH(
-			XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), // eye
-			XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), // target (+X)
-			XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)  // up
-		),
-		XMMatrixLookAtRH(
-			XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f),
-			XMVectorSet(-1.0f, 0.0f, 0.0f, 0.0f), // -X
-			XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)
-		),
-		XMMatrixLookAtRH(
-			XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f),
-			XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), // +Y
-			XMVectorSet(0.0f, 0.0f, -1.0f, 0.0f)
-		),
-		XMMatrixLookAtRH(
-			XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f),
-			XMVectorSet(0.0f, -1.0f, 0.0f, 0.0f), // -Y
-			XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f)
-		),
-		XMMatrixLookAtRH(
-			XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f),
-			XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), // +Z
-			XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)
-		),
-		XMMatrixLookAtRH(
-			XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f),
-			XMVectorSet(0.0f, 0.0f, -1.0f, 0.0f), // -Z
-			XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)
-		)
-	};
-	// スカイボックスの頂点シェーダーに送る定数バッファ 
-	ConstantBuffer* irradianceMapBuffer = new ConstantBuffer(sizeof(Transform));
-	if (!irradianceMapBuffer->IsValid())
+	if (objects.Occlusion != nullptr && g_Engine->FrameCount() + 1 == SubmitTimeFrames)
 	{
-		printf("イラディアンスマップ用定数バッファの生成に失敗\n");
+		auto& stats = objects.Occlusion->GetStats();
+		printf("オクルージョンカリング: 物体 %u個中 %u個が隠れている (遮蔽物の三角形 %u, 準備 %.3f ms, ラスタライズ %.3f ms)\n",
+			stats.TestedObjects, stats.OccludedObjects, stats.OccluderTriangles, stats.SetupTime, stats.RasterizeTime);
 	}
 
-	auto ptr = irradianceMapBuffer->GetPtr<Transform>();
-	ptr->World = XMMatrixIdentity();
-	ptr->View = captureViews[0];
-	ptr->Projection = captureProjection;
-	ptr->WorldInvTranspose = XMMatrixIdentity();
+	// 読み戻したフレームと同じスロットが回ってきた時には、そのフレームのGPUの処理は終わっている
+	if (objects.GpuCuller != nullptr && g_Engine->FrameCount() == CullVerifyFrame + g_Engine->FramesInFlight())
+	{
+		uint32_t visibleCount = 0;
+		bool matched = objects.GpuCuller->VerifyResults(objects.VerifyConstants, &visibleCount);
+		printf("GPUカリング: 物体 %u個中 %u個を描画 (CPUの結果と%s)\n",
+			objects.GpuCuller->ObjectCount(), visibleCount, matched ? "一致" : "不一致");
+	}
+}
 
-	for (int face = 0; face < 6; ++face){
-		
-		auto currentIndex = g_Engine->CurrentBackBufferIndex();
-		auto commandList = g_Engine->CommandList();
-		auto materialHeap = descriptorHeap->Get();
+void DrawSkybox(RenderGraphExecutor& context, RenderGraph::ResourceHandle backBuffer, RenderGraph::ResourceHandle depth)
+{
+	CommandListFilter<> commandList(context.CommandList());
+	auto materialHeap = descriptorHeap->Get();
 
-		// RTVのDescriptorHeapの先頭
-		auto RtvHandle = irradianceMapRtvHeap->GetCPUDescriptorHandleForHeapStart();
-		auto m_RtvDescriptorSize = g_Engine->Device()->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-		// 現在のRTVの先頭
-		RtvHandle.ptr += face * m_RtvDescriptorSize;
+	auto vbView = skyboxVertexBuffer->View();
+	auto ibView = skyboxIndexBuffer->View();
 
-		commandList->OMSetRenderTargets(1, &RtvHandle, FALSE, nullptr);
+	auto rtv = context.RenderTargetView(backBuffer);
+	auto dsv = context.DepthStencilView(depth);
+	commandList.OMSetRenderTargets(1, &rtv, FALSE, &dsv);
 
-		irradianceMapBuffer->GetPtr<Transform>()->View = captureViews[face];
+	commandList.SetGraphicsRootSignature(skyboxRootSignature->Get());
+	commandList.SetPipelineState(skyboxPipelineState->Get());
 
-		auto vbView = skyboxVertexBuffer->View();
-		auto ibView = skyboxIndexBuffer->View();
+	commandList.SetGraphicsRootConstantBufferView(3, skyboxTransformAddress);
 
-		commandList->SetGraphicsRootSignature(irradianceMapRootSignature->Get());
-		commandList->SetPipelineState(irradianceMapPipelineState->Get());
+	commandList.IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	commandList.IASetVertexBuffers(0, 1, &vbView);
+	commandList.IASetIndexBuffer(&ibView);
 
-		commandList->SetGraphicsRootConstantBufferView(3, irradianceMapBuffer->GetAddress());
+	commandList.SetDescriptorHeaps(1, &materialHeap);
+	commandList.SetGraphicsRootDescriptorTable(1, skyboxHandle->HandleGPU);
+	
+	commandList.DrawIndexedInstanced(36, 1, 0, 0, 0);
+	FrameStats::Add(STAT_DRAW_CALLS, 1);
+	FrameStats::Add(STAT_INSTANCES, 1);
+	FrameStats::Add(STAT_TRIANGLES, 12);
+	apiCallCount += commandList.IssuedCount();
+	apiElidedCount += commandList.ElidedCount();
+}
+
+void DrawMeshes(SceneObjects& objects, RenderGraphExecutor& context, RenderGraph::ResourceHandle backBuffer, RenderGraph::ResourceHandle depth)
+{
+	auto rtv = context.RenderTargetView(backBuffer);
+	auto dsv = context.DepthStencilView(depth);
+
+	if (objects.GpuCuller != nullptr)
+	{
+		Timer recordTimer;
+		CommandListFilter<> commandList(context.CommandList());
+		commandList.OMSetRenderTargets(1, &rtv, FALSE, &dsv);
+		RecordMeshesIndirect(objects, commandList, meshTransformAddress, sceneDataAddress, clusterAddresses);
+		apiCallCount += commandList.IssuedCount() + 1; // ExecuteIndirectはラッパーを通さない
+		apiElidedCount += commandList.ElidedCount();
+		meshSortTime = 0.0;
+		meshRecordTime = recordTimer.GetElapsedTime();
+		meshRecordThreads = 1;
+		meshSubmitTimeTotal += meshRecordTime;
+		return;
+	}
 
-		commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		commandList->IASetVertexBuffers(0, 1, &vbView);
-		commandList->IASetIndexBuffer(&ibView);
+	// 描画を並べ替えてから、並べた順に区切ってワーカースレッドで記録する
+	Timer sortTimer;
+	BuildMeshQueue(objects);
+	meshSortTime = sortTimer.GetElapsedTime();
+
+	// 各スレッドのリストはメインのリストの後に実行する
+	Timer recordTimer;
+	meshStateChanges = {};
+	auto ranges = DrawPartitioner::Partition(drawCosts, g_Engine->RecordThreadCount(), MinDrawsPerRecordThread);
+	if (ranges.size() <= 1)
+	{
+		CommandListFilter<> commandList(context.CommandList());
+		commandList.OMSetRenderTargets(1, &rtv, FALSE, &dsv);
+		RecordMeshes(objects, commandList, 0, meshQueue.Size(), meshTransformAddress, sceneDataAddress, clusterAddresses, &meshStateChanges);
+		apiCallCount += commandList.IssuedCount();
+		apiElidedCount += commandList.ElidedCount();
+	}
+	else
+	{
+		std::vector<UINT> rangeCallCounts(ranges.size());
+		std::vector<UINT> rangeElidedCounts(ranges.size());
+		std::vector<DrawStateChanges> rangeChanges(ranges.size());
+		// ワーカーのリストはメインのリストの後にまとめて実行されるので、パスのGPUの区間は最初と最後のワーカーのリストに置く
+		context.BeginGpuScopeOn(g_Engine->WorkerCommandList(0));
+		DrawPartitioner::Record(ranges, [&](uint32_t index, const DrawRange& range)
+		{
+			PROFILE_SCOPE("RecordMeshes");
+			// コマンドリスト間では出力先が引き継がれないので、リストごとに設定する
+			CommandListFilter<> workerList(g_Engine->WorkerCommandList(index));
+			workerList.OMSetRenderTargets(1, &rtv, FALSE, &dsv);
+			RecordMeshes(objects, workerList, range.Begin, range.End, meshTransformAddress, sceneDataAddress, clusterAddresses, &rangeChanges[index]);
+			rangeCallCounts[index] = workerList.IssuedCount();
+			rangeElidedCounts[index] = workerList.ElidedCount();
+		});
+		context.EndGpuScopeOn(g_Engine->WorkerCommandList(static_cast<UINT>(ranges.size() - 1)));
+		g_Engine->SubmitWorkerLists(static_cast<UINT>(ranges.size()));
+
+		for (uint32_t i = 0; i < ranges.size(); i++)
+		{
+			apiCallCount += rangeCallCounts[i];
+			apiElidedCount += rangeElidedCounts[i];
+			meshStateChanges.Add(rangeChanges[i]);
+		}
+	}
+	meshRecordTime = recordTimer.GetElapsedTime();
+	meshRecordThreads = std::max<size_t>(ranges.size(), 1);
+	meshSubmitTimeTotal += meshSortTime + meshRecordTime;
+}
 
-		commandList->SetDescriptorHeaps(1, &materialHeap);
-		commandList->SetGraphicsRootDescriptorTable(1, skyboxHandle->HandleGPU);
+bool Scene::CreateIrradianceMapResource()
+{
+	auto shaders = g_Engine->Shaders();
+	environmentBaker = new EnvironmentBaker();
+	if (!environmentBaker->Init(environmentTexture->Resource(), shaders->Get(L"IrradianceCS"), shaders->Get(L"PrefilterCS")))
+	{
+		delete environmentBaker;
+		environmentBaker = nullptr;
+		return false;
+	}
 
-		commandList->DrawIndexedInstanced(6, 1, 0, 0, 0);
+	for (uint32_t i = 0; i < BakeScheduler::TARGET_COUNT; i++)
+	{
+		auto irradianceMap = Texture2D::Get(environmentBaker->IrradianceMap(i));
+		textures.push_back(irradianceMap);
+		irradianceHandles[i] = descriptorHeap->Register(irradianceMap);
 	}
 
-	auto skyBox = Texture2D::Get(IrradianceMap.Get());
-	skyboxHandle = descriptorHeap->Register(skyBox);
-	
+	return true;
+}
+
+void Scene::RenderIrradianceMap()
+{
+	// 焼き込みは最初のフレームの始めに計算キューに投げる（描画キューはそのフレームだけ完了を待つ）
+	if (environmentBaker != nullptr)
+	{
+		environmentBaker->RequestBake();
+	}
 }
 
 void Scene::ProcessMouseMovement(int xOffset, int yOffset)
@@ -593,6 +1413,99 @@ void Scene::ProcessInput()
 		if (g_KeyStates['D'])
 			m_pCamera->ProcessKeyboard(RIGHT, g_DeltaTime);
 	}
+
+	// Bキーで環境マップを焼き直す（押した瞬間だけ）
+	static bool wasBakeKeyDown = false;
+	if (g_KeyStates['B'] && !wasBakeKeyDown && environmentBaker != nullptr)
+	{
+		environmentBaker->RequestBake();
+	}
+	wasBakeKeyDown = g_KeyStates['B'];
+}
+
+// 今のフレームと同じ物体、変換、ライトをCPUのリファレンスレンダラーで描いて書き出す（カリングはせず、全ての物体を描く）
+// スカイボックスは焼き込む前の環境マップを描く（イラディアンスマップはGPUで焼くので使わない）
+bool Scene::RenderSoftwareFrame(const std::filesystem::path& path)
+{
+	PROFILE_SCOPE("Scene::RenderSoftwareFrame");
+	auto& objects = *m_pObjects;
+	SoftwareScene scene;
+	for (auto& mesh : meshes)
+	{
+		SoftwareMesh softwareMesh;
+		softwareMesh.Positions.reserve(mesh.Vertices.size() * 3);
+		softwareMesh.Normals.reserve(mesh.Vertices.size() * 3);
+		softwareMesh.UVs.reserve(mesh.Vertices.size() * 2);
+		for (auto& vertex : mesh.Vertices)
+		{
+			softwareMesh.Positions.insert(softwareMesh.Positions.end(), { vertex.Position.x, vertex.Position.y, vertex.Position.z });
+			softwareMesh.Normals.insert(softwareMesh.Normals.end(), { vertex.Normal.x, vertex.Normal.y, vertex.Normal.z });
+			softwareMesh.UVs.insert(softwareMesh.UVs.end(), { vertex.UV.x, vertex.UV.y });
+		}
+		softwareMesh.Indices = mesh.Indices;
+
+		// 読めないテクスチャは白（GPUでも読めなければ何も貼られない）
+		std::vector<SoftwareTexture> images;
+		if (Texture2D::ReadPixels(mesh.DiffuseMapPath, images) && !images.empty())
+		{
+			softwareMesh.Texture = static_cast<uint32_t>(scene.Textures.size());
+			scene.Textures.push_back(std::move(images[0]));
+		}
+		scene.Meshes.push_back(std::move(softwareMesh));
+	}
+
+	scene.Instances.clear();
+	scene.Instances.reserve(objects.Entities.EntityCount());
+	objects.Entities.Each<const MeshComponent, const InstanceData>(objects.Query,
+		[&scene](Entity, const MeshComponent& mesh, const InstanceData& instance)
+	{
+		SoftwareInstance softwareInstance;
+		softwareInstance.Mesh = mesh.Mesh;
+		memcpy(softwareInstance.World, instance.World, sizeof(softwareInstance.World));
+		memcpy(softwareInstance.WorldInvTranspose, instance.WorldInvTranspose, sizeof(softwareInstance.WorldInvTranspose));
+		scene.Instances.push_back(softwareInstance);
+	});
+
+	std::vector<SoftwareTexture> faces;
+	if (Texture2D::ReadPixels(skyboxFile, faces) && faces.size() >= 6)
+	{
+		for (int face = 0; face < 6; face++)
+		{
+			scene.Sky.Faces[face] = std::move(faces[face]);
+		}
+		scene.HasSky = true;
+	}
+
+	auto store = [](FXMMATRIX matrix, float* out)
+	{
+		XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(out), matrix);
+	};
+	store(meshTransform.View, scene.View);
+	store(meshTransform.Projection, scene.Projection);
+	store(skyboxTransform.World, scene.SkyWorld);
+	store(skyboxTransform.View, scene.SkyView);
+	store(skyboxTransform.Projection, scene.SkyProjection);
+	for (int i = 0; i < 4; i++)
+	{
+		scene.Lights[i] = { { sceneData.Lights[i].Position.x, sceneData.Lights[i].Position.y, sceneData.Lights[i].Position.z }, sceneData.Lights[i].Intensity };
+	}
+	scene.LightCount = sceneData.LightCount;
+	scene.PointLights = pointLights;
+	scene.CameraPosition[0] = sceneData.CameraPosition.x;
+	scene.CameraPosition[1] = sceneData.CameraPosition.y;
+	scene.CameraPosition[2] = sceneData.CameraPosition.z;
+
+	SoftwareRenderer renderer;
+	renderer.Init(WINDOW_WIDTH, WINDOW_HEIGHT);
+	renderer.Render(scene);
+	auto& timings = renderer.GetTimings();
+	printf("CPUで描いた: %.2f ms (幾何 %.2f ms, タイル %.2f ms), 三角形 %u\n", timings.Total, timings.Geometry, timings.Tiles, timings.InputTriangles);
+	if (!renderer.Write(path))
+	{
+		return false;
+	}
+	printf("画像を書き出した: %ls (.png, .exr)\n", path.c_str());
+	return true;
 }
 
 void Scene::UpdateCamera(CameraMovement movement, float deltaTime)
@@ -0,0 +1,530 @@
+#include "SceneGraph.h"
+#include "JobSystem.h"
+#include "Timer.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <stdio.h>
+
+// SSE2はx64では必ず使えるので、x64のビルドではSSE2で行列の1行ずつを求める（それ以外は1要素ずつ。
+// 足す順は同じだが、コンパイラーが積和（FMA）にまとめると丸めが変わるので、結果は最後の数ビットだけ違うことがある）
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SCENE_GRAPH_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	// SSE2の方と同じ順に足す。確かめる時はこちらで求め直す
+	void MultiplyScalar(const SceneGraph::Matrix& parent, const SceneGraph::Matrix& local, SceneGraph::Matrix* pOut)
+	{
+		for (int row = 0; row < 3; row++)
+		{
+			auto& p = parent.Rows[row];
+			for (int column = 0; column < 4; column++)
+			{
+				pOut->Rows[row][column] = p[0] * local.Rows[0][column] + p[1] * local.Rows[1][column] + p[2] * local.Rows[2][column]
+					+ (column == 3 ? p[3] : 0.0f);
+			}
+		}
+	}
+
+	// 3x3の部分の逆行列の転置は余因子行列 / 行列式（各行は他の2行の外積）。法線にしか使わないので4列目は0にする
+	void InverseTransposeScalar(const SceneGraph::Matrix& world, SceneGraph::Matrix* pOut)
+	{
+		auto& r = world.Rows;
+		float cofactors[3][3];
+		for (int row = 0; row < 3; row++)
+		{
+			auto& a = r[(row + 1) % 3];
+			auto& b = r[(row + 2) % 3];
+			cofactors[row][0] = a[1] * b[2] - a[2] * b[1];
+			cofactors[row][1] = a[2] * b[0] - a[0] * b[2];
+			cofactors[row][2] = a[0] * b[1] - a[1] * b[0];
+		}
+		auto determinant = r[0][0] * cofactors[0][0] + r[0][1] * cofactors[0][1] + r[0][2] * cofactors[0][2];
+		for (int row = 0; row < 3; row++)
+		{
+			for (int column = 0; column < 3; column++)
+			{
+				pOut->Rows[row][column] = determinant != 0.0f ? cofactors[row][column] / determinant : 0.0f;
+			}
+			pOut->Rows[row][3] = 0.0f;
+		}
+	}
+
+	// 要素ごとの差が、行列の一番大きな要素に対して小さければ一致とみなす（NaNは一致にしない）
+	bool NearlyEqual(const SceneGraph::Matrix& a, const SceneGraph::Matrix& b)
+	{
+		const float RelativeTolerance = 1.0e-4f;
+		float scale = 1.0f;
+		for (int row = 0; row < 3; row++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				scale = std::max(scale, std::max(std::fabs(a.Rows[row][column]), std::fabs(b.Rows[row][column])));
+			}
+		}
+		for (int row = 0; row < 3; row++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				if (!(std::fabs(a.Rows[row][column] - b.Rows[row][column]) <= scale * RelativeTolerance))
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+}
+
+uint32_t SceneGraph::AddNode(uint32_t parent, const Transform& local)
+{
+	auto node = NodeCount();
+	auto slot = static_cast<uint32_t>(m_Parents.size());
+	auto parentSlot = parent != NO_PARENT ? m_SlotOfNode[parent] : NO_PARENT;
+	m_SlotOfNode.push_back(slot);
+	m_NodeOfSlot.push_back(node);
+	m_Parents.push_back(parentSlot);
+	m_Depths.push_back(parentSlot != NO_PARENT ? m_Depths[parentSlot] + 1 : 0);
+	m_Locals.push_back(local);
+	m_World.push_back({});
+	m_WorldInvTranspose.push_back({});
+	m_Flags.push_back(FLAG_LOCAL_DIRTY);
+
+	// 追加した位置は深さの順とは限らないので、次のUpdateで並べ直す
+	m_NeedsSort = true;
+	return node;
+}
+
+void SceneGraph::SetLocal(uint32_t node, const Transform& local)
+{
+	auto slot = m_SlotOfNode[node];
+	m_Locals[slot] = local;
+	m_Flags[slot] |= FLAG_LOCAL_DIRTY;
+	if (!m_NeedsSort)
+	{
+		m_LevelDirty[m_Depths[slot]] = 1;
+	}
+}
+
+uint32_t SceneGraph::GetParent(uint32_t node) const
+{
+	auto parentSlot = m_Parents[m_SlotOfNode[node]];
+	return parentSlot != NO_PARENT ? m_NodeOfSlot[parentSlot] : NO_PARENT;
+}
+
+void SceneGraph::Reserve(uint32_t count)
+{
+	m_SlotOfNode.reserve(count);
+	m_NodeOfSlot.reserve(count);
+	m_Parents.reserve(count);
+	m_Depths.reserve(count);
+	m_Locals.reserve(count);
+	m_World.reserve(count);
+	m_WorldInvTranspose.reserve(count);
+	m_Flags.reserve(count);
+}
+
+void SceneGraph::Clear()
+{
+	*this = SceneGraph();
+}
+
+void SceneGraph::Sort()
+{
+	Timer timer;
+	auto count = static_cast<uint32_t>(m_Parents.size());
+
+	// 親ごとの子の並び（スロットの順）を作り、根から幅優先にたどった順を新しい並びにする
+	std::vector<uint32_t> childStart(count + 1, 0);
+	for (auto parent : m_Parents)
+	{
+		if (parent != NO_PARENT)
+		{
+			childStart[parent + 1]++;
+		}
+	}
+	for (uint32_t slot = 0; slot < count; slot++)
+	{
+		childStart[slot + 1] += childStart[slot];
+	}
+	std::vector<uint32_t> children(childStart[count]);
+	std::vector<uint32_t> cursor(childStart.begin(), childStart.end() - 1);
+	std::vector<uint32_t> order;
+	order.reserve(count);
+	for (uint32_t slot = 0; slot < count; slot++)
+	{
+		if (m_Parents[slot] != NO_PARENT)
+		{
+			children[cursor[m_Parents[slot]]++] = slot;
+		}
+		else
+		{
+			order.push_back(slot);
+		}
+	}
+	for (size_t head = 0; head < order.size(); head++)
+	{
+		auto slot = order[head];
+		order.insert(order.end(), children.begin() + childStart[slot], children.begin() + childStart[slot + 1]);
+	}
+
+	std::vector<uint32_t> newSlot(count);
+	for (uint32_t slot = 0; slot < count; slot++)
+	{
+		newSlot[order[slot]] = slot;
+	}
+	auto permute = [&order](auto& values)
+	{
+		auto previous = std::move(values);
+		values.resize(previous.size());
+		for (size_t slot = 0; slot < order.size(); slot++)
+		{
+			values[slot] = previous[order[slot]];
+		}
+	};
+	permute(m_NodeOfSlot);
+	permute(m_Parents);
+	permute(m_Depths);
+	permute(m_Locals);
+	permute(m_World);
+	permute(m_WorldInvTranspose);
+	permute(m_Flags);
+	for (auto& parent : m_Parents)
+	{
+		parent = parent != NO_PARENT ? newSlot[parent] : NO_PARENT;
+	}
+	for (uint32_t slot = 0; slot < count; slot++)
+	{
+		m_SlotOfNode[m_NodeOfSlot[slot]] = slot;
+	}
+
+	// 幅優先の順なので深さは増えていくだけ。並べ直す前の変わった印は残っているかもしれないので、どの深さも消し直す
+	auto levels = count > 0 ? m_Depths.back() + 1 : 0;
+	m_LevelStart.assign(levels + 1, count);
+	m_LevelDirty.assign(levels, 0);
+	m_LevelChanged.assign(levels, 1);
+	for (uint32_t slot = count; slot-- > 0;)
+	{
+		m_LevelStart[m_Depths[slot]] = slot;
+		if (m_Flags[slot] & FLAG_LOCAL_DIRTY)
+		{
+			m_LevelDirty[m_Depths[slot]] = 1;
+		}
+	}
+	m_NeedsSort = false;
+	m_Stats.SortTime = timer.GetElapsedTime();
+}
+
+void SceneGraph::ComposeLocal(const Transform& local, Matrix* pOut)
+{
+	auto& q = local.Rotation;
+	auto& s = local.Scale;
+	float rotation[3][3] =
+	{
+		{ 1.0f - 2.0f * (q[1] * q[1] + q[2] * q[2]), 2.0f * (q[0] * q[1] - q[3] * q[2]), 2.0f * (q[0] * q[2] + q[3] * q[1]) },
+		{ 2.0f * (q[0] * q[1] + q[3] * q[2]), 1.0f - 2.0f * (q[0] * q[0] + q[2] * q[2]), 2.0f * (q[1] * q[2] - q[3] * q[0]) },
+		{ 2.0f * (q[0] * q[2] - q[3] * q[1]), 2.0f * (q[1] * q[2] + q[3] * q[0]), 1.0f - 2.0f * (q[0] * q[0] + q[1] * q[1]) },
+	};
+	for (int row = 0; row < 3; row++)
+	{
+		for (int column = 0; column < 3; column++)
+		{
+			pOut->Rows[row][column] = rotation[row][column] * s[column];
+		}
+		pOut->Rows[row][3] = local.Translation[row];
+	}
+}
+
+void SceneGraph::Multiply(const Matrix& parent, const Matrix& local, Matrix* pOut)
+{
+#if SCENE_GRAPH_USE_SSE2
+	// 結果の行 = 親の行の各要素 * ローカルの各行 + 親の平行移動
+	auto l0 = _mm_load_ps(local.Rows[0]);
+	auto l1 = _mm_load_ps(local.Rows[1]);
+	auto l2 = _mm_load_ps(local.Rows[2]);
+	for (int row = 0; row < 3; row++)
+	{
+		auto& p = parent.Rows[row];
+		auto value = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p[0]), l0), _mm_mul_ps(_mm_set1_ps(p[1]), l1));
+		value = _mm_add_ps(value, _mm_mul_ps(_mm_set1_ps(p[2]), l2));
+		value = _mm_add_ps(value, _mm_set_ps(p[3], 0.0f, 0.0f, 0.0f));
+		_mm_store_ps(pOut->Rows[row], value);
+	}
+#else
+	MultiplyScalar(parent, local, pOut);
+#endif
+}
+
+void SceneGraph::InverseTranspose(const Matrix& world, Matrix* pOut)
+{
+#if SCENE_GRAPH_USE_SSE2
+	// 外積 a x b = a.yzx * b.zxy - a.zxy * b.yzx（4つ目のレーンは0にする）
+	auto mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	auto r0 = _mm_and_ps(_mm_load_ps(world.Rows[0]), mask);
+	auto r1 = _mm_and_ps(_mm_load_ps(world.Rows[1]), mask);
+	auto r2 = _mm_and_ps(_mm_load_ps(world.Rows[2]), mask);
+	auto cross = [](__m128 a, __m128 b)
+	{
+		auto aYzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+		auto aZxy = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 1, 0, 2));
+		auto bYzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+		auto bZxy = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 1, 0, 2));
+		return _mm_sub_ps(_mm_mul_ps(aYzx, bZxy), _mm_mul_ps(aZxy, bYzx));
+	};
+	auto c0 = cross(r1, r2);
+	auto c1 = cross(r2, r0);
+	auto c2 = cross(r0, r1);
+
+	// 行列式は1要素ずつの方と同じ順に足す
+	float products[4];
+	_mm_storeu_ps(products, _mm_mul_ps(r0, c0));
+	auto determinant = products[0] + products[1] + products[2];
+	if (determinant == 0.0f)
+	{
+		memset(pOut, 0, sizeof(Matrix));
+		return;
+	}
+	auto divisor = _mm_set1_ps(determinant);
+	_mm_store_ps(pOut->Rows[0], _mm_div_ps(c0, divisor));
+	_mm_store_ps(pOut->Rows[1], _mm_div_ps(c1, divisor));
+	_mm_store_ps(pOut->Rows[2], _mm_div_ps(c2, divisor));
+#else
+	InverseTransposeScalar(world, pOut);
+#endif
+}
+
+uint32_t SceneGraph::UpdateRange(uint32_t begin, uint32_t end)
+{
+	// 親は1つ前の深さにあり、その深さの更新は終わっている。同じ深さのノードは別々の要素だけを書く
+	uint32_t updated = 0;
+	for (auto slot = begin; slot < end; slot++)
+	{
+		auto parent = m_Parents[slot];
+		auto parentChanged = parent != NO_PARENT && (m_Flags[parent] & FLAG_WORLD_CHANGED) != 0;
+		if ((m_Flags[slot] & FLAG_LOCAL_DIRTY) == 0 && !parentChanged)
+		{
+			m_Flags[slot] = 0;
+			continue;
+		}
+
+		Matrix local;
+		ComposeLocal(m_Locals[slot], &local);
+		if (parent != NO_PARENT)
+		{
+			Multiply(m_World[parent], local, &m_World[slot]);
+		}
+		else
+		{
+			m_World[slot] = local;
+		}
+		InverseTranspose(m_World[slot], &m_WorldInvTranspose[slot]);
+		m_Flags[slot] = FLAG_WORLD_CHANGED;
+		updated++;
+	}
+	return updated;
+}
+
+void SceneGraph::Update(bool parallel)
+{
+	if (m_NeedsSort)
+	{
+		Sort();
+	}
+
+	Timer timer;
+	parallel = parallel && g_JobSystem != nullptr;
+	uint32_t updated = 0;
+	bool previousChanged = false;
+	auto levels = static_cast<uint32_t>(m_LevelDirty.size());
+	for (uint32_t level = 0; level < levels; level++)
+	{
+		auto begin = m_LevelStart[level];
+		auto end = m_LevelStart[level + 1];
+
+		// 変えたノードも、親の変わったノードも無い深さは飛ばす（前のUpdateの変わった印だけを消す）
+		if (!m_LevelDirty[level] && !previousChanged)
+		{
+			if (m_LevelChanged[level])
+			{
+				memset(&m_Flags[begin], 0, end - begin);
+				m_LevelChanged[level] = 0;
+			}
+			continue;
+		}
+
+		uint32_t levelUpdated = 0;
+		if (parallel && end - begin > UPDATE_GRAIN)
+		{
+			std::atomic<uint32_t> count(0);
+			g_JobSystem->ParallelFor(begin, end, UPDATE_GRAIN, [this, &count](size_t rangeBegin, size_t rangeEnd)
+			{
+				count += UpdateRange(static_cast<uint32_t>(rangeBegin), static_cast<uint32_t>(rangeEnd));
+			});
+			levelUpdated = count;
+		}
+		else
+		{
+			levelUpdated = UpdateRange(begin, end);
+		}
+		m_LevelDirty[level] = 0;
+		m_LevelChanged[level] = levelUpdated > 0 ? 1 : 0;
+		previousChanged = levelUpdated > 0;
+		updated += levelUpdated;
+	}
+
+	m_Stats.NodeCount = NodeCount();
+	m_Stats.Levels = levels;
+	m_Stats.UpdatedNodes = updated;
+	m_Stats.UpdateTime = timer.GetElapsedTime();
+}
+
+bool SceneGraph::Validate() const
+{
+	if (m_NeedsSort)
+	{
+		return false;
+	}
+	// 丸めの違いが深さとともに積み重ならないよう、各ノードは更新済みの親の行列から求め直して比べる
+	// （親が古ければ親のところで食い違うので、根から順に確かめれば全体を確かめたことになる）
+	auto count = static_cast<uint32_t>(m_Parents.size());
+	for (uint32_t slot = 0; slot < count; slot++)
+	{
+		auto parent = m_Parents[slot];
+		if (parent != NO_PARENT && parent >= slot)
+		{
+			return false;
+		}
+		Matrix local;
+		ComposeLocal(m_Locals[slot], &local);
+		Matrix world;
+		if (parent != NO_PARENT)
+		{
+			MultiplyScalar(m_World[parent], local, &world);
+		}
+		else
+		{
+			world = local;
+		}
+		Matrix inverseTranspose;
+		InverseTransposeScalar(m_World[slot], &inverseTranspose);
+		if (!NearlyEqual(world, m_World[slot]) || !NearlyEqual(inverseTranspose, m_WorldInvTranspose[slot]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void SceneGraph::MakeTestHierarchy(uint32_t nodeCount, uint32_t seed, SceneGraph* pGraph)
+{
+	auto random = [&seed]()
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8 & 0xffff) / 65535.0f;
+	};
+
+	// 最初の16個を根にし、その後のノードiの親は[i / 8, i / 2)から選ぶ
+	const uint32_t RootCount = 16;
+	pGraph->Clear();
+	pGraph->Reserve(nodeCount);
+	for (uint32_t node = 0; node < nodeCount; node++)
+	{
+		Transform local;
+		for (auto& value : local.Translation)
+		{
+			value = (random() * 2.0f - 1.0f) * 10.0f;
+		}
+		float length = 0.0f;
+		for (auto& value : local.Rotation)
+		{
+			value = random() * 2.0f - 1.0f;
+			length += value * value;
+		}
+		length = std::sqrt(std::max<float>(length, 1.0e-6f));
+		for (auto& value : local.Rotation)
+		{
+			value /= length;
+		}
+		for (auto& value : local.Scale)
+		{
+			value = 0.8f + random() * 0.4f;
+		}
+
+		uint32_t parent = NO_PARENT;
+		if (node >= RootCount)
+		{
+			auto first = node / 8;
+			parent = first + std::min<uint32_t>(static_cast<uint32_t>(random() * (node / 2 - first)), node / 2 - first - 1);
+		}
+		pGraph->AddNode(parent, local);
+	}
+}
+
+bool SceneGraph::RunBenchmark(uint32_t nodeCount, int iterations)
+{
+	SceneGraph graph;
+	MakeTestHierarchy(nodeCount, 12345, &graph);
+	graph.Update(true);
+	auto sortTime = graph.GetStats().SortTime;
+	bool matched = graph.Validate();
+
+	// 全て、1%（とその子孫）、変更なしの3通り。変えるノードは毎回同じ
+	std::vector<uint32_t> some;
+	uint32_t seed = 678;
+	for (uint32_t i = 0; i < nodeCount / 100; i++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		some.push_back(seed % nodeCount);
+	}
+	const char* Names[] = { "全て", "1%", "変更なし" };
+	double times[3][2] = {};
+	uint32_t updatedNodes[3] = {};
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (int mode = 0; mode < 3; mode++)
+		{
+			for (int i = 0; i < iterations; i++)
+			{
+				if (mode == 0)
+				{
+					for (uint32_t node = 0; node < nodeCount; node++)
+					{
+						auto local = graph.GetLocal(node);
+						local.Translation[0] += 0.001f;
+						graph.SetLocal(node, local);
+					}
+				}
+				else if (mode == 1)
+				{
+					for (auto node : some)
+					{
+						auto local = graph.GetLocal(node);
+						local.Translation[1] += 0.001f;
+						graph.SetLocal(node, local);
+					}
+				}
+				graph.Update(pass == 0);
+				times[mode][pass] += graph.GetStats().UpdateTime;
+				updatedNodes[mode] = graph.GetStats().UpdatedNodes;
+			}
+			matched = matched && graph.Validate();
+		}
+	}
+
+	auto& stats = graph.GetStats();
+	printf("シーングラフ: ノード %u個, 深さ %u段, %d回の平均 (並べ直し %.3f ms)\n", stats.NodeCount, stats.Levels, iterations, sortTime);
+	for (int mode = 0; mode < 3; mode++)
+	{
+		auto parallel = times[mode][0] / iterations;
+		auto single = times[mode][1] / iterations;
+		printf("  %s: 更新 %u個, %.3f ms (%uスレッド), %.3f ms (1スレッド, 1個あたり %.1f ns)\n",
+			Names[mode], updatedNodes[mode], parallel, g_JobSystem != nullptr ? g_JobSystem->WorkerCount() : 1, single,
+			updatedNodes[mode] > 0 ? single / updatedNodes[mode] * 1e6 : 0.0);
+	}
+	printf("  求め直した結果との比較: %s\n", matched ? "一致" : "不一致");
+	return matched;
+}
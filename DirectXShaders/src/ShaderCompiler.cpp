@@ -0,0 +1,318 @@
+#include "ShaderCompiler.h"
+#include "Hash.h"
+#include "JobSystem.h"
+#include "Timer.h"
+#include <d3dcompiler.h>
+#include <dxcapi.h>
+#include <fstream>
+#include <iterator>
+#include <stdio.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	// dxcompiler.dllが無くても起動できるよう、実行時に読み込む
+	DxcCreateInstanceProc DxcCreateInstanceFunc = nullptr;
+
+	bool LoadDxc()
+	{
+		if (DxcCreateInstanceFunc == nullptr)
+		{
+			auto module = LoadLibraryW(L"dxcompiler.dll");
+			if (module != nullptr)
+			{
+				DxcCreateInstanceFunc = reinterpret_cast<DxcCreateInstanceProc>(GetProcAddress(module, "DxcCreateInstance"));
+			}
+		}
+		return DxcCreateInstanceFunc != nullptr;
+	}
+
+	ComPtr<ID3DBlob> CreateBlob(const void* data, size_t size)
+	{
+		ComPtr<ID3DBlob> pBlob;
+		if (FAILED(D3DCreateBlob(size, pBlob.GetAddressOf())))
+		{
+			return nullptr;
+		}
+		memcpy(pBlob->GetBufferPointer(), data, size);
+		return pBlob;
+	}
+}
+
+bool ShaderCompiler::Init(const wchar_t* sourceDir, const wchar_t* cacheDir)
+{
+	m_SourceDir = sourceDir;
+	m_CacheDir = cacheDir;
+
+	std::error_code error;
+	fs::create_directories(m_CacheDir, error);
+
+	m_CompilerHash = QueryCompilerHash();
+	if (m_CompilerHash == 0)
+	{
+		printf("DXCが使えないため、ビルド済みのシェーダーを使います\n");
+	}
+
+	return true;
+}
+
+uint64_t ShaderCompiler::QueryCompilerHash()
+{
+	ComPtr<IDxcCompiler3> pCompiler;
+	if (!LoadDxc() || FAILED(DxcCreateInstanceFunc(CLSID_DxcCompiler, IID_PPV_ARGS(pCompiler.GetAddressOf()))))
+	{
+		return 0;
+	}
+
+	Hasher hasher;
+	hasher.AddString("dxc");
+
+	ComPtr<IDxcVersionInfo> pVersion;
+	if (SUCCEEDED(pCompiler.As(&pVersion)))
+	{
+		UINT32 major = 0;
+		UINT32 minor = 0;
+		pVersion->GetVersion(&major, &minor);
+		hasher.Add(major);
+		hasher.Add(minor);
+	}
+
+	// 同じバージョン番号でもビルドが違えば出力が変わりうるのでコミットも加える
+	ComPtr<IDxcVersionInfo2> pVersion2;
+	if (SUCCEEDED(pCompiler.As(&pVersion2)))
+	{
+		UINT32 commitCount = 0;
+		char* commitHash = nullptr;
+		if (SUCCEEDED(pVersion2->GetCommitInfo(&commitCount, &commitHash)))
+		{
+			hasher.Add(commitCount);
+			hasher.AddString(commitHash);
+			CoTaskMemFree(commitHash);
+		}
+	}
+
+	return hasher.Value();
+}
+
+void ShaderCompiler::Add(const ShaderDesc& desc)
+{
+	Entry entry;
+	entry.Desc = desc;
+	m_Entries.push_back(entry);
+}
+
+fs::path ShaderCompiler::CachePath(uint64_t key) const
+{
+	wchar_t name[32];
+	swprintf(name, std::size(name), L"%016llX.cso", static_cast<unsigned long long>(key));
+	return m_CacheDir / name;
+}
+
+bool ShaderCompiler::Compile(Entry& entry)
+{
+	// IDxcCompiler3はスレッドセーフではないのでコンパイルごとに作る
+	ComPtr<IDxcUtils> pUtils;
+	ComPtr<IDxcCompiler3> pCompiler;
+	ComPtr<IDxcIncludeHandler> pIncludeHandler;
+	if (FAILED(DxcCreateInstanceFunc(CLSID_DxcUtils, IID_PPV_ARGS(pUtils.GetAddressOf())))
+		|| FAILED(DxcCreateInstanceFunc(CLSID_DxcCompiler, IID_PPV_ARGS(pCompiler.GetAddressOf())))
+		|| FAILED(pUtils->CreateDefaultIncludeHandler(pIncludeHandler.GetAddressOf())))
+	{
+		entry.Errors = "DXCの生成に失敗";
+		return false;
+	}
+
+	auto path = (m_SourceDir / entry.Desc.Path).lexically_normal();
+	ComPtr<IDxcBlobEncoding> pSource;
+	if (FAILED(pUtils->LoadFile(path.c_str(), nullptr, pSource.GetAddressOf())))
+	{
+		entry.Errors = "ソースファイルの読み込みに失敗";
+		return false;
+	}
+
+	DxcBuffer buffer = {};
+	buffer.Ptr = pSource->GetBufferPointer();
+	buffer.Size = pSource->GetBufferSize();
+	buffer.Encoding = DXC_CP_ACP;
+
+	auto localDir = path.parent_path().wstring();
+	auto sourceDir = m_SourceDir.wstring();
+	std::vector<LPCWSTR> args =
+	{
+		path.c_str(),
+		L"-E", entry.Desc.EntryPoint.c_str(),
+		L"-T", entry.Desc.Target.c_str(),
+		L"-I", localDir.c_str(),
+		L"-I", sourceDir.c_str(),
+	};
+
+	for (auto& define : entry.Desc.Defines)
+	{
+		args.push_back(L"-D");
+		args.push_back(define.c_str());
+	}
+
+	ComPtr<IDxcResult> pResult;
+	auto hr = pCompiler->Compile(&buffer, args.data(), static_cast<UINT32>(args.size()),
+		pIncludeHandler.Get(), IID_PPV_ARGS(pResult.GetAddressOf()));
+	if (FAILED(hr))
+	{
+		entry.Errors = "コンパイラの呼び出しに失敗";
+		return false;
+	}
+
+	ComPtr<IDxcBlobUtf8> pErrors;
+	pResult->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(pErrors.GetAddressOf()), nullptr);
+	if (pErrors != nullptr && pErrors->GetStringLength() > 0)
+	{
+		entry.Errors = pErrors->GetStringPointer();
+	}
+
+	HRESULT status = E_FAIL;
+	pResult->GetStatus(&status);
+	if (FAILED(status))
+	{
+		return false;
+	}
+
+	ComPtr<IDxcBlob> pObject;
+	pResult->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(pObject.GetAddressOf()), nullptr);
+	if (pObject == nullptr)
+	{
+		return false;
+	}
+
+	entry.pBytecode = CreateBlob(pObject->GetBufferPointer(), pObject->GetBufferSize());
+	return entry.pBytecode != nullptr;
+}
+
+void ShaderCompiler::Process(Entry& entry)
+{
+	Timer timer;
+
+	entry.Key = m_CompilerHash != 0 ? ShaderKey::Compute(entry.Desc, m_SourceDir, m_CompilerHash) : 0;
+	if (entry.Key == 0)
+	{
+		// ソースかDXCが無い場合は、ビルド時に作られた.csoを使う
+		auto prebuilt = entry.Desc.Name + L".cso";
+		entry.State = SUCCEEDED(D3DReadFileToBlob(prebuilt.c_str(), entry.pBytecode.GetAddressOf()))
+			? Status::Prebuilt : Status::Failed;
+		entry.Time = timer.GetElapsedTime();
+		return;
+	}
+
+	auto cachePath = CachePath(entry.Key);
+	if (SUCCEEDED(D3DReadFileToBlob(cachePath.c_str(), entry.pBytecode.GetAddressOf())))
+	{
+		entry.State = Status::CacheHit;
+		entry.Time = timer.GetElapsedTime();
+		return;
+	}
+
+	if (!Compile(entry))
+	{
+		entry.State = Status::Failed;
+		entry.Time = timer.GetElapsedTime();
+		return;
+	}
+
+	// 書きかけのファイルを読まないよう、一時ファイルに書いてから置き換える
+	auto tempPath = cachePath;
+	tempPath += L".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		file.write(static_cast<const char*>(entry.pBytecode->GetBufferPointer()), entry.pBytecode->GetBufferSize());
+	}
+	std::error_code error;
+	fs::rename(tempPath, cachePath, error);
+
+	entry.State = Status::Compiled;
+	entry.Time = timer.GetElapsedTime();
+}
+
+bool ShaderCompiler::CompileAll()
+{
+	Timer timer;
+
+	// 1つずつジョブにする（シェーダーごとのコンパイル時間の差が大きいので細かく分ける）
+	auto compile = [this](size_t begin, size_t end)
+	{
+		for (auto i = begin; i < end; i++)
+		{
+			if (m_Entries[i].State == Status::Pending)
+			{
+				Process(m_Entries[i]);
+			}
+		}
+	};
+
+	if (g_JobSystem != nullptr)
+	{
+		g_JobSystem->ParallelFor(0, m_Entries.size(), 1, compile);
+	}
+	else
+	{
+		compile(0, m_Entries.size());
+	}
+
+	m_TotalTime = timer.GetElapsedTime();
+
+	bool succeeded = true;
+	for (auto& entry : m_Entries)
+	{
+		if (entry.State == Status::Failed)
+		{
+			printf("シェーダーのコンパイルに失敗: %ls\n", entry.Desc.Name.c_str());
+			succeeded = false;
+		}
+		if (!entry.Errors.empty())
+		{
+			printf("%s\n", entry.Errors.c_str());
+		}
+	}
+
+	return succeeded;
+}
+
+ID3DBlob* ShaderCompiler::Get(const wchar_t* name)
+{
+	for (auto& entry : m_Entries)
+	{
+		if (entry.Desc.Name == name)
+		{
+			return entry.pBytecode.Get();
+		}
+	}
+
+	printf("登録されていないシェーダー: %ls\n", name);
+	return nullptr;
+}
+
+void ShaderCompiler::PrintStats() const
+{
+	UINT counts[5] = {};
+	for (auto& entry : m_Entries)
+	{
+		counts[static_cast<int>(entry.State)]++;
+	}
+
+	printf("シェーダー: %zu個 %.2f ms (キャッシュ %u, コンパイル %u, ビルド済み %u, 失敗 %u)\n",
+		m_Entries.size(), m_TotalTime,
+		counts[static_cast<int>(Status::CacheHit)], counts[static_cast<int>(Status::Compiled)],
+		counts[static_cast<int>(Status::Prebuilt)], counts[static_cast<int>(Status::Failed)]);
+
+	for (auto& entry : m_Entries)
+	{
+		const char* state = "未処理";
+		switch (entry.State)
+		{
+		case Status::CacheHit: state = "キャッシュ"; break;
+		case Status::Compiled: state = "コンパイル"; break;
+		case Status::Prebuilt: state = "ビルド済み"; break;
+		case Status::Failed: state = "失敗"; break;
+		default: break;
+		}
+		printf("  %-16ls %-12s %8.2f ms\n", entry.Desc.Name.c_str(), state, entry.Time);
+	}
+}
@@ -0,0 +1,209 @@
+#include "ShaderKey.h"
+#include "Hash.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdio.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	bool ReadFile(const fs::path& path, std::string& data)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+		data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+	bool WriteFile(const fs::path& path, const char* data)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file << data;
+		return static_cast<bool>(file);
+	}
+
+	// 行が #include "name" または #include <name> ならnameを取り出す
+	bool ParseInclude(const std::string& line, std::string& name)
+	{
+		size_t i = line.find_first_not_of(" \t");
+		if (i == std::string::npos || line[i] != '#')
+		{
+			return false;
+		}
+
+		i = line.find_first_not_of(" \t", i + 1);
+		if (i == std::string::npos || line.compare(i, 7, "include") != 0)
+		{
+			return false;
+		}
+
+		i = line.find_first_of("\"<", i + 7);
+		if (i == std::string::npos)
+		{
+			return false;
+		}
+
+		auto close = line.find(line[i] == '"' ? '"' : '>', i + 1);
+		if (close == std::string::npos)
+		{
+			return false;
+		}
+
+		name = line.substr(i + 1, close - i - 1);
+		return true;
+	}
+}
+
+bool ShaderKey::HashSourceFile(const fs::path& path, const fs::path& sourceDir,
+	Hasher& hasher, std::vector<fs::path>& visited)
+{
+	auto normalized = path.lexically_normal();
+	if (std::find(visited.begin(), visited.end(), normalized) != visited.end())
+	{
+		return true; // 既に加えたファイル（#pragma onceや循環）
+	}
+	visited.push_back(normalized);
+
+	std::string source;
+	if (!ReadFile(normalized, source))
+	{
+		return false;
+	}
+	hasher.Add(source.size());
+	hasher.Add(source.data(), source.size());
+
+	// インクルードされるファイルの中身も再帰的に加える
+	size_t begin = 0;
+	while (begin < source.size())
+	{
+		auto end = source.find('\n', begin);
+		if (end == std::string::npos)
+		{
+			end = source.size();
+		}
+
+		std::string name;
+		if (ParseInclude(source.substr(begin, end - begin), name))
+		{
+			hasher.AddString(name.c_str());
+
+			// 読み込み元のディレクトリ、ソースディレクトリの順に探す
+			auto local = normalized.parent_path() / name;
+			auto global = sourceDir / name;
+			if (fs::exists(local))
+			{
+				HashSourceFile(local, sourceDir, hasher, visited);
+			}
+			else if (fs::exists(global))
+			{
+				HashSourceFile(global, sourceDir, hasher, visited);
+			}
+		}
+
+		begin = end + 1;
+	}
+
+	return true;
+}
+
+uint64_t ShaderKey::Compute(const ShaderDesc& desc, const fs::path& sourceDir, uint64_t compilerHash)
+{
+	Hasher hasher;
+	hasher.Add(compilerHash);
+	hasher.AddString(desc.EntryPoint.c_str());
+	hasher.AddString(desc.Target.c_str());
+
+	hasher.Add(desc.Defines.size());
+	for (auto& define : desc.Defines)
+	{
+		hasher.AddString(define.c_str());
+	}
+
+	std::vector<fs::path> visited;
+	if (!HashSourceFile(sourceDir / desc.Path, sourceDir, hasher, visited))
+	{
+		return 0;
+	}
+
+	auto key = hasher.Value();
+	return key != 0 ? key : 1;
+}
+
+bool ShaderKey::RunTest()
+{
+	bool passed = true;
+	auto check = [&passed](bool condition, const char* message)
+	{
+		if (!condition)
+		{
+			printf("  %s\n", message);
+			passed = false;
+		}
+	};
+
+	// shaders/Main.hlslは隣のLocal.hlsliと、ソースディレクトリのCommon.hlsliを読み込む
+	// Common.hlsliは自分自身を読み込む（循環しても止まること）。Unused.hlsliは誰も読み込まない
+	std::error_code error;
+	auto sourceDir = fs::temp_directory_path(error) / "DirectXShadersShaderKeyTest";
+	fs::remove_all(sourceDir, error);
+	fs::create_directories(sourceDir / "shaders", error);
+	const char* Main = "#include \"Local.hlsli\"\n  #  include <Common.hlsli>\nfloat4 main() : SV_Target { return Color * Scale; }\n";
+	const char* Local = "static const float Scale = 0.5;\n";
+	const char* Common = "#include \"Common.hlsli\"\ncbuffer Constants { float4 Color; };\n";
+	bool written = WriteFile(sourceDir / "shaders" / "Main.hlsl", Main)
+		&& WriteFile(sourceDir / "shaders" / "Local.hlsli", Local)
+		&& WriteFile(sourceDir / "Common.hlsli", Common)
+		&& WriteFile(sourceDir / "Unused.hlsli", "float Unused;\n");
+	if (!written)
+	{
+		printf("シェーダーのキーのテスト: 一時ファイルを書けない (%s)\n", sourceDir.string().c_str());
+		return false;
+	}
+
+	const uint64_t CompilerHash = 0x1234;
+	ShaderDesc desc = { L"Main", L"shaders/Main.hlsl", L"main", L"ps_6_0", { L"USE_FOG=1" } };
+	auto key = Compute(desc, sourceDir, CompilerHash);
+	check(key != 0, "ソースがあるのにキーが0");
+	check(Compute(desc, sourceDir, CompilerHash) == key, "何も変えていないのにキーが変わった（キャッシュに当たらない）");
+
+	// インクルードしているファイルは中身で比べる。元に戻せば同じキーに戻る
+	WriteFile(sourceDir / "Common.hlsli", "#include \"Common.hlsli\"\ncbuffer Constants { float4 Color; float4 Fog; };\n");
+	check(Compute(desc, sourceDir, CompilerHash) != key, "ソースディレクトリの.hlsliを変えてもキーが変わらない");
+	WriteFile(sourceDir / "Common.hlsli", Common);
+	check(Compute(desc, sourceDir, CompilerHash) == key, "元に戻した.hlsliでキーが戻らない");
+
+	WriteFile(sourceDir / "shaders" / "Local.hlsli", "static const float Scale = 0.25;\n");
+	check(Compute(desc, sourceDir, CompilerHash) != key, "隣の.hlsliを変えてもキーが変わらない");
+	WriteFile(sourceDir / "shaders" / "Local.hlsli", Local);
+
+	WriteFile(sourceDir / "Unused.hlsli", "float Unused2;\n");
+	check(Compute(desc, sourceDir, CompilerHash) == key, "読み込んでいない.hlsliを変えたらキーが変わった");
+
+	// マクロ・エントリーポイント・ターゲット・コンパイラのどれが変わっても別のキーにする
+	auto changed = desc;
+	changed.Defines[0] = L"USE_FOG=0";
+	check(Compute(changed, sourceDir, CompilerHash) != key, "マクロの値を変えてもキーが変わらない");
+	changed = desc;
+	changed.Defines.push_back(L"USE_SHADOW");
+	check(Compute(changed, sourceDir, CompilerHash) != key, "マクロを加えてもキーが変わらない");
+	changed = desc;
+	changed.Target = L"ps_6_6";
+	check(Compute(changed, sourceDir, CompilerHash) != key, "ターゲットを変えてもキーが変わらない");
+	changed = desc;
+	changed.EntryPoint = L"mainFog";
+	check(Compute(changed, sourceDir, CompilerHash) != key, "エントリーポイントを変えてもキーが変わらない");
+	check(Compute(desc, sourceDir, CompilerHash + 1) != key, "コンパイラが変わってもキーが変わらない");
+
+	changed = desc;
+	changed.Path = L"shaders/Missing.hlsl";
+	check(Compute(changed, sourceDir, CompilerHash) == 0, "無いソースのキーが0ではない");
+
+	fs::remove_all(sourceDir, error);
+	printf("シェーダーのキーのテスト: %s\n", passed ? "成功" : "失敗");
+	return passed;
+}
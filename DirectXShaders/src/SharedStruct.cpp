@@ -26,3 +26,18 @@ const D3D12_INPUT_LAYOUT_DESC VertexPositionOnly::InputLayout =
 };
 
 
+
+void InstanceData::Set(DirectX::FXMMATRIX world)
+{
+	using namespace DirectX;
+
+	// CPU側は行ベクトル(pos * World)なので、転置した行列の各行がワールド座標の各成分になる
+	auto transposed = XMMatrixTranspose(world);
+	// 法線はpos * 逆転置で変換するので、その転置（＝逆行列）の各行を使う
+	auto inverse = XMMatrixInverse(nullptr, world);
+	for (int i = 0; i < 3; i++)
+	{
+		XMStoreFloat4(&World[i], transposed.r[i]);
+		XMStoreFloat4(&WorldInvTranspose[i], inverse.r[i]);
+	}
+}
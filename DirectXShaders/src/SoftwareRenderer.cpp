@@ -0,0 +1,1243 @@
+#include "SoftwareRenderer.h"
+#include "ImageFile.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <stdio.h>
+
+// SSE2はx64では必ず使えるので、x64のビルドではSSE2で4ピクセルずつラスタライズする（それ以外は1ピクセルずつで、結果は同じ）
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SOFTWARE_RENDERER_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+const double SoftwareRenderer::TargetFrameTime1080p = 50.0;
+
+namespace
+{
+	const uint32_t NoTriangle = 0xffffffffu;
+	const uint32_t SkyInstance = 0xffffffffu; // Chunk::Instanceがこれならスカイボックス
+	const uint32_t SkyTexture = 0xfffffffeu; // Triangle::Textureがこれならスカイボックス（キューブマップを引く）
+	const uint32_t WhiteTexture = 0xffffffffu;
+	const uint32_t MaxChunks = 0xffff; // 三角形の番号は塊の番号（上位16ビット）と塊の中の番号
+	// 画面の外にこの倍率まで伸びた三角形はそのままラスタライズし、それより外は切り取る（座標が大きすぎると精度が落ちる）
+	const float GuardBand = 8.0f;
+	const int MaxClipVertices = 3 + 6;
+	const uint32_t VertexCacheSize = 256; // 変換した頂点を番号で覚えておく数（塊の中で同じ頂点を何度も変換しない）
+	const float ClearColor[3] = { 0.25f, 0.25f, 0.25f }; // Engineのレンダーターゲットのクリアの色
+	const float Pi = 3.14159265359f;
+
+	// PBR.hlslの材質。albedoはHLSLでは (0.2, 0.5, 0.3) と書かれているが、カンマ演算子なので3成分とも0.3になる
+	const float Roughness = 0.5f;
+	const float Metallic = 0.5f;
+	const float Albedo = 0.3f;
+
+	// Sceneのスカイボックスの立方体（Scene::Initと同じ頂点と順番）
+	const float SkyPositions[] =
+	{
+		-1.0f, -1.0f, -1.0f,  1.0f, -1.0f, -1.0f,  1.0f,  1.0f, -1.0f, -1.0f,  1.0f, -1.0f,
+		-1.0f, -1.0f,  1.0f,  1.0f, -1.0f,  1.0f,  1.0f,  1.0f,  1.0f, -1.0f,  1.0f,  1.0f,
+	};
+	const uint32_t SkyIndices[] =
+	{
+		0, 1, 2,  0, 2, 3,
+		1, 5, 6,  1, 6, 2,
+		5, 4, 7,  5, 7, 6,
+		4, 0, 3,  4, 3, 7,
+		3, 2, 6,  3, 6, 7,
+		4, 5, 1,  4, 1, 0,
+	};
+
+	// 行ベクトルの4x4行列の積（out = a * b）
+	void Multiply(const float a[16], const float b[16], float out[16])
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				out[row * 4 + column] = a[row * 4 + 0] * b[0 * 4 + column] + a[row * 4 + 1] * b[1 * 4 + column]
+					+ a[row * 4 + 2] * b[2 * 4 + column] + a[row * 4 + 3] * b[3 * 4 + column];
+			}
+		}
+	}
+
+	// v * m（シェーダーのmul(M, v)と同じ）
+	void Transform(const float v[4], const float m[16], float out[4])
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			out[i] = v[0] * m[0 * 4 + i] + v[1] * m[1 * 4 + i] + v[2] * m[2 * 4 + i] + v[3] * m[3 * 4 + i];
+		}
+	}
+
+	float Dot(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	void Normalize(float v[3])
+	{
+		auto length = std::sqrt(Dot(v, v));
+		auto scale = length > 0.0f ? 1.0f / length : 0.0f;
+		v[0] *= scale;
+		v[1] *= scale;
+		v[2] *= scale;
+	}
+
+	float Saturate(float value)
+	{
+		return std::min<float>(std::max<float>(value, 0.0f), 1.0f);
+	}
+
+	// 座標を1/256ピクセルに丸める（D3D12のラスタライザの精度）
+	float Snap(float value)
+	{
+		return std::floor(value * 256.0f + 0.5f) * (1.0f / 256.0f);
+	}
+
+	// PBR.hlslの関数をそのまま写したもの
+	float DistributionGGX(const float n[3], const float h[3], float roughness)
+	{
+		auto a = roughness * roughness;
+		auto a2 = a * a;
+		auto nDotH = Saturate(Dot(n, h));
+		auto denominator = nDotH * nDotH * (a2 - 1.0f) + 1.0f;
+		return a2 / (Pi * denominator * denominator);
+	}
+
+	float GeometrySchlickGGX(float nDotV, float roughness)
+	{
+		auto r = roughness + 1.0f;
+		auto k = (r * r) / 8.0f;
+		return nDotV / (nDotV * (1.0f - k) + k);
+	}
+
+	// テクセルの番号をラップする
+	int Wrap(int value, int size)
+	{
+		value %= size;
+		return value < 0 ? value + size : value;
+	}
+
+	// dirの方向の空の色（テストのシーンの手続きの空）。太陽はSceneのライトと同じ方向
+	void SkyColor(const float direction[3], float out[4])
+	{
+		float d[3] = { direction[0], direction[1], direction[2] };
+		Normalize(d);
+		const float Zenith[3] = { 0.18f, 0.36f, 0.75f };
+		const float Horizon[3] = { 0.75f, 0.82f, 0.9f };
+		const float Ground[3] = { 0.3f, 0.27f, 0.24f };
+		float sun[3] = { 1.0f, 1.0f, 1.0f };
+		Normalize(sun);
+		auto sunAmount = std::pow(std::max<float>(Dot(d, sun), 0.0f), 256.0f);
+		for (int i = 0; i < 3; i++)
+		{
+			auto sky = d[1] >= 0.0f ? Horizon[i] + (Zenith[i] - Horizon[i]) * std::sqrt(d[1]) : Ground[i] + (Horizon[i] - Ground[i]) * std::exp(d[1] * 8.0f);
+			out[i] = sky + sunAmount * 4.0f;
+		}
+		out[3] = 1.0f;
+	}
+
+	// 3x3行列（行ベクトル）の逆行列。法線の変換（WorldInvTranspose）に使う
+	void Inverse3x3(const float m[16], float out[9])
+	{
+		auto a = m[0], b = m[1], c = m[2];
+		auto d = m[4], e = m[5], f = m[6];
+		auto g = m[8], h = m[9], i = m[10];
+		auto determinant = a * (e * i - f * h) - b * (d * i - f * g) + c * (d * h - e * g);
+		auto inverse = 1.0f / determinant;
+		out[0] = (e * i - f * h) * inverse;
+		out[1] = (c * h - b * i) * inverse;
+		out[2] = (b * f - c * e) * inverse;
+		out[3] = (f * g - d * i) * inverse;
+		out[4] = (a * i - c * g) * inverse;
+		out[5] = (c * d - a * f) * inverse;
+		out[6] = (d * h - e * g) * inverse;
+		out[7] = (b * g - a * h) * inverse;
+		out[8] = (a * e - b * d) * inverse;
+	}
+
+	// 行ベクトルの行列worldからInstanceDataと同じ3x4の2つの行列を作る（InstanceData::Setと同じ）
+	void SetInstance(const float world[16], uint32_t mesh, SoftwareInstance* pInstance)
+	{
+		pInstance->Mesh = mesh;
+		float inverse[9];
+		Inverse3x3(world, inverse);
+		for (int row = 0; row < 3; row++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				pInstance->World[row * 4 + column] = world[column * 4 + row];
+				pInstance->WorldInvTranspose[row * 4 + column] = column < 3 ? inverse[row * 3 + column] : 0.0f;
+			}
+		}
+	}
+
+	void Translation(float x, float y, float z, float out[16])
+	{
+		const float m[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, x, y, z, 1 };
+		memcpy(out, m, sizeof(m));
+	}
+
+	void Scaling(float x, float y, float z, float out[16])
+	{
+		const float m[16] = { x, 0, 0, 0, 0, y, 0, 0, 0, 0, z, 0, 0, 0, 0, 1 };
+		memcpy(out, m, sizeof(m));
+	}
+
+	void RotationY(float angle, float out[16])
+	{
+		auto s = std::sin(angle);
+		auto c = std::cos(angle);
+		const float m[16] = { c, 0, -s, 0, 0, 1, 0, 0, s, 0, c, 0, 0, 0, 0, 1 };
+		memcpy(out, m, sizeof(m));
+	}
+
+	// 切り取りに使うクリップ空間の面までの距離（0以上なら内側）。近い面、遠い面、画面の外のガードバンドの4面
+	float PlaneDistance(const float v[4], int plane)
+	{
+		switch (plane)
+		{
+		case 0: return v[2];
+		case 1: return v[3] - v[2];
+		case 2: return GuardBand * v[3] - v[0];
+		case 3: return GuardBand * v[3] + v[0];
+		case 4: return GuardBand * v[3] - v[1];
+		default: return GuardBand * v[3] + v[1];
+		}
+	}
+
+	// 画面の外の判定のビット（全ての頂点で立つビットがあれば、三角形は画面に掛からない）
+	uint32_t OutCode(const float v[4])
+	{
+		uint32_t code = 0;
+		code |= v[0] > v[3] ? 1 : 0;
+		code |= v[0] < -v[3] ? 2 : 0;
+		code |= v[1] > v[3] ? 4 : 0;
+		code |= v[1] < -v[3] ? 8 : 0;
+		code |= v[2] < 0.0f ? 16 : 0;
+		code |= v[2] > v[3] ? 32 : 0;
+		return code;
+	}
+
+	// 切り取りが要るか（近い面、遠い面、ガードバンドの外に出ている）
+	bool NeedsClip(const float v[4])
+	{
+		for (int plane = 0; plane < 6; plane++)
+		{
+			if (PlaneDistance(v, plane) < 0.0f)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+struct SoftwareRenderer::ClipVertex
+{
+	float Position[4]; // クリップ空間
+	float Attributes[8];
+};
+
+namespace
+{
+	// 多角形を6つの面で順に切り取る（Sutherland-Hodgman）。属性もクリップ空間で線形に補間する。残った頂点の数を返す
+	template<typename Vertex>
+	int ClipPolygon(Vertex vertices[MaxClipVertices], int count)
+	{
+		Vertex scratch[MaxClipVertices];
+		for (int plane = 0; plane < 6 && count >= 3; plane++)
+		{
+			int outCount = 0;
+			for (int i = 0; i < count; i++)
+			{
+				auto& a = vertices[i];
+				auto& b = vertices[(i + 1) % count];
+				auto da = PlaneDistance(a.Position, plane);
+				auto db = PlaneDistance(b.Position, plane);
+				if (da >= 0.0f)
+				{
+					scratch[outCount++] = a;
+				}
+				if ((da >= 0.0f) != (db >= 0.0f) && outCount < MaxClipVertices)
+				{
+					auto t = da / (da - db);
+					auto& out = scratch[outCount++];
+					for (int k = 0; k < 4; k++)
+					{
+						out.Position[k] = a.Position[k] + (b.Position[k] - a.Position[k]) * t;
+					}
+					for (int k = 0; k < 8; k++)
+					{
+						out.Attributes[k] = a.Attributes[k] + (b.Attributes[k] - a.Attributes[k]) * t;
+					}
+				}
+			}
+			memcpy(vertices, scratch, sizeof(Vertex) * outCount);
+			count = outCount;
+		}
+		return count;
+	}
+}
+
+void SoftwareTexture::Sample(float u, float v, float out[4]) const
+{
+	if (Width == 0 || Height == 0)
+	{
+		out[0] = out[1] = out[2] = out[3] = 1.0f;
+		return;
+	}
+
+	// テクセルの中心が整数になる座標で、周りの4テクセルを混ぜる
+	auto x = u * Width - 0.5f;
+	auto y = v * Height - 0.5f;
+	auto fx = std::floor(x);
+	auto fy = std::floor(y);
+	auto tx = x - fx;
+	auto ty = y - fy;
+	auto w = static_cast<int>(Width);
+	auto h = static_cast<int>(Height);
+	auto x0 = Wrap(static_cast<int>(fx), w);
+	auto x1 = Wrap(x0 + 1, w);
+	auto y0 = Wrap(static_cast<int>(fy), h);
+	auto y1 = Wrap(y0 + 1, h);
+	auto t00 = &Texels[(y0 * Width + x0) * 4];
+	auto t10 = &Texels[(y0 * Width + x1) * 4];
+	auto t01 = &Texels[(y1 * Width + x0) * 4];
+	auto t11 = &Texels[(y1 * Width + x1) * 4];
+	for (int i = 0; i < 4; i++)
+	{
+		auto top = t00[i] + (t10[i] - t00[i]) * tx;
+		auto bottom = t01[i] + (t11[i] - t01[i]) * tx;
+		out[i] = top + (bottom - top) * ty;
+	}
+}
+
+void SoftwareTexture::SampleClamp(float u, float v, float out[4]) const
+{
+	if (Width == 0 || Height == 0)
+	{
+		out[0] = out[1] = out[2] = out[3] = 1.0f;
+		return;
+	}
+
+	auto x = std::min<float>(std::max<float>(u * Width - 0.5f, 0.0f), static_cast<float>(Width - 1));
+	auto y = std::min<float>(std::max<float>(v * Height - 0.5f, 0.0f), static_cast<float>(Height - 1));
+	auto x0 = static_cast<uint32_t>(x);
+	auto y0 = static_cast<uint32_t>(y);
+	auto x1 = std::min<uint32_t>(x0 + 1, Width - 1);
+	auto y1 = std::min<uint32_t>(y0 + 1, Height - 1);
+	auto tx = x - x0;
+	auto ty = y - y0;
+	auto t00 = &Texels[(y0 * Width + x0) * 4];
+	auto t10 = &Texels[(y0 * Width + x1) * 4];
+	auto t01 = &Texels[(y1 * Width + x0) * 4];
+	auto t11 = &Texels[(y1 * Width + x1) * 4];
+	for (int i = 0; i < 4; i++)
+	{
+		auto top = t00[i] + (t10[i] - t00[i]) * tx;
+		auto bottom = t01[i] + (t11[i] - t01[i]) * tx;
+		out[i] = top + (bottom - top) * ty;
+	}
+}
+
+void SoftwareCubeMap::Sample(const float direction[3], float out[4]) const
+{
+	// 一番大きい成分の軸で面を選び、D3Dと同じ向きで面の中の座標を求める（面の境目はまたがずに端で止める）
+	auto x = direction[0];
+	auto y = direction[1];
+	auto z = direction[2];
+	auto ax = std::fabs(x);
+	auto ay = std::fabs(y);
+	auto az = std::fabs(z);
+	int face;
+	float sc, tc, ma;
+	if (ax >= ay && ax >= az)
+	{
+		face = x >= 0.0f ? 0 : 1;
+		sc = x >= 0.0f ? -z : z;
+		tc = -y;
+		ma = ax;
+	}
+	else if (ay >= az)
+	{
+		face = y >= 0.0f ? 2 : 3;
+		sc = x;
+		tc = y >= 0.0f ? z : -z;
+		ma = ay;
+	}
+	else
+	{
+		face = z >= 0.0f ? 4 : 5;
+		sc = z >= 0.0f ? x : -x;
+		tc = -y;
+		ma = az;
+	}
+	if (ma <= 0.0f)
+	{
+		out[0] = out[1] = out[2] = 0.0f;
+		out[3] = 1.0f;
+		return;
+	}
+	Faces[face].SampleClamp((sc / ma + 1.0f) * 0.5f, (tc / ma + 1.0f) * 0.5f, out);
+}
+
+void SoftwareRenderer::Init(uint32_t width, uint32_t height)
+{
+	m_Width = width;
+	m_Height = height;
+	m_TilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	m_TilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	m_Pixels.assign(static_cast<size_t>(width) * height * 3, 0.0f);
+	m_Chunks.clear();
+	m_Timings = {};
+}
+
+void SoftwareRenderer::Render(const SoftwareScene& scene)
+{
+	auto start = Profiler::Now();
+	m_Timings = {};
+
+	// 描く順に三角形の塊を作る（スカイボックスが先、続いてインスタンスの順）
+	uint32_t chunkCount = 0;
+	auto addChunk = [this, &chunkCount](uint32_t instance, uint32_t first, uint32_t count)
+	{
+		if (chunkCount == m_Chunks.size())
+		{
+			m_Chunks.emplace_back();
+		}
+		auto& chunk = m_Chunks[chunkCount++];
+		chunk.Instance = instance;
+		chunk.FirstTriangle = first;
+		chunk.TriangleCount = count;
+		m_Timings.InputTriangles += count;
+	};
+	if (scene.HasSky)
+	{
+		addChunk(SkyInstance, 0, static_cast<uint32_t>(std::size(SkyIndices) / 3));
+	}
+	for (uint32_t instance = 0; instance < scene.Instances.size(); instance++)
+	{
+		auto triangleCount = static_cast<uint32_t>(scene.Meshes[scene.Instances[instance].Mesh].Indices.size() / 3);
+		for (uint32_t first = 0; first < triangleCount && chunkCount < MaxChunks; first += CHUNK_TRIANGLES)
+		{
+			addChunk(instance, first, std::min<uint32_t>(CHUNK_TRIANGLES, triangleCount - first));
+		}
+	}
+	if (chunkCount >= MaxChunks)
+	{
+		printf("ソフトウェアレンダラー: 三角形が多すぎるので、%u個より後は描かない\n", MaxChunks * CHUNK_TRIANGLES);
+	}
+
+	auto processChunks = [this, &scene](size_t begin, size_t end)
+	{
+		for (auto i = begin; i < end; i++)
+		{
+			ProcessChunk(scene, m_Chunks[i]);
+		}
+	};
+	if (g_JobSystem != nullptr)
+	{
+		g_JobSystem->ParallelFor(0, chunkCount, 1, processChunks);
+	}
+	else
+	{
+		processChunks(0, chunkCount);
+	}
+	auto geometryEnd = Profiler::Now();
+
+	for (uint32_t i = 0; i < chunkCount; i++)
+	{
+		m_Timings.Triangles += static_cast<uint32_t>(m_Chunks[i].Triangles.size());
+		m_Timings.BinnedTriangles += static_cast<uint32_t>(m_Chunks[i].TileTriangles.size());
+	}
+
+	// 塊の数を超えた分（前のフレームの塊）はタイルで読まないように空にする
+	for (auto i = chunkCount; i < m_Chunks.size(); i++)
+	{
+		m_Chunks[i].TriangleCount = 0;
+		m_Chunks[i].Triangles.clear();
+		m_Chunks[i].TileStart.assign(m_TilesX * m_TilesY + 1, 0);
+		m_Chunks[i].TileTriangles.clear();
+	}
+
+	std::atomic<int64_t> rasterTime(0);
+	std::atomic<int64_t> shadeTime(0);
+	std::atomic<uint64_t> shadedPixels(0);
+	auto processTiles = [this, &scene, &rasterTime, &shadeTime, &shadedPixels](size_t begin, size_t end)
+	{
+		int64_t raster = 0;
+		int64_t shade = 0;
+		uint64_t pixels = 0;
+		for (auto tile = begin; tile < end; tile++)
+		{
+			ProcessTile(scene, static_cast<uint32_t>(tile), &raster, &shade, &pixels);
+		}
+		rasterTime += raster;
+		shadeTime += shade;
+		shadedPixels += pixels;
+	};
+	if (g_JobSystem != nullptr)
+	{
+		g_JobSystem->ParallelFor(0, m_TilesX * m_TilesY, 1, processTiles);
+	}
+	else
+	{
+		processTiles(0, m_TilesX * m_TilesY);
+	}
+	auto end = Profiler::Now();
+
+	m_Timings.Geometry = (geometryEnd - start) * 1e-6;
+	m_Timings.Tiles = (end - geometryEnd) * 1e-6;
+	m_Timings.RasterCpu = rasterTime.load() * 1e-6;
+	m_Timings.ShadeCpu = shadeTime.load() * 1e-6;
+	m_Timings.Total = (end - start) * 1e-6;
+	m_Timings.ShadedPixels = shadedPixels.load();
+}
+
+void SoftwareRenderer::ProcessChunk(const SoftwareScene& scene, Chunk& chunk)
+{
+	chunk.Triangles.clear();
+	const bool isSky = chunk.Instance == SkyInstance;
+	const float* positions = SkyPositions;
+	const float* normals = nullptr;
+	const float* uvs = nullptr;
+	const uint32_t* indices = SkyIndices;
+	const SoftwareInstance* instance = nullptr;
+	uint32_t vertexCount = 8;
+	uint32_t texture = SkyTexture;
+	if (!isSky)
+	{
+		instance = &scene.Instances[chunk.Instance];
+		auto& mesh = scene.Meshes[instance->Mesh];
+		positions = mesh.Positions.data();
+		normals = mesh.Normals.size() >= mesh.Positions.size() ? mesh.Normals.data() : nullptr;
+		uvs = mesh.UVs.size() * 3 >= mesh.Positions.size() * 2 ? mesh.UVs.data() : nullptr;
+		indices = mesh.Indices.data();
+		vertexCount = static_cast<uint32_t>(mesh.Positions.size() / 3);
+		texture = mesh.Texture < scene.Textures.size() ? mesh.Texture : WhiteTexture;
+	}
+
+	// SampleVSとSkyboxVSと同じ変換（ワールド、ビュー、射影の順に掛ける）
+	auto transformVertex = [&](uint32_t index, ClipVertex& out)
+	{
+		float local[4] = { positions[index * 3 + 0], positions[index * 3 + 1], positions[index * 3 + 2], 1.0f };
+		float world[4];
+		float view[4];
+		if (isSky)
+		{
+			Transform(local, scene.SkyWorld, world);
+			Transform(world, scene.SkyView, view);
+			Transform(view, scene.SkyProjection, out.Position);
+			memcpy(out.Attributes, local, sizeof(float) * 3);
+			memset(out.Attributes + 3, 0, sizeof(float) * 5);
+			return;
+		}
+
+		for (int row = 0; row < 3; row++)
+		{
+			auto m = &instance->World[row * 4];
+			world[row] = m[0] * local[0] + m[1] * local[1] + m[2] * local[2] + m[3];
+		}
+		world[3] = 1.0f;
+		Transform(world, scene.View, view);
+		Transform(view, scene.Projection, out.Position);
+
+		float normal[3] = {};
+		if (normals != nullptr)
+		{
+			auto n = &normals[index * 3];
+			for (int row = 0; row < 3; row++)
+			{
+				auto m = &instance->WorldInvTranspose[row * 4];
+				normal[row] = m[0] * n[0] + m[1] * n[1] + m[2] * n[2];
+			}
+			Normalize(normal);
+		}
+		memcpy(out.Attributes, world, sizeof(float) * 3);
+		memcpy(out.Attributes + 3, normal, sizeof(normal));
+		out.Attributes[6] = uvs != nullptr ? uvs[index * 2 + 0] : 0.0f;
+		out.Attributes[7] = uvs != nullptr ? uvs[index * 2 + 1] : 0.0f;
+	};
+
+	ClipVertex cache[VertexCacheSize];
+	uint32_t cacheTags[VertexCacheSize];
+	std::fill(std::begin(cacheTags), std::end(cacheTags), 0xffffffffu);
+
+	auto end = chunk.FirstTriangle + chunk.TriangleCount;
+	for (auto triangle = chunk.FirstTriangle; triangle < end; triangle++)
+	{
+		ClipVertex polygon[MaxClipVertices];
+		uint32_t outCodeAnd = 0xffffffffu;
+		bool clip = false;
+		bool valid = true;
+		for (int k = 0; k < 3; k++)
+		{
+			auto index = indices[triangle * 3 + k];
+			if (index >= vertexCount)
+			{
+				valid = false;
+				break;
+			}
+			auto slot = index & (VertexCacheSize - 1);
+			if (cacheTags[slot] != index)
+			{
+				transformVertex(index, cache[slot]);
+				cacheTags[slot] = index;
+			}
+			polygon[k] = cache[slot];
+			outCodeAnd &= OutCode(polygon[k].Position);
+			clip = clip || NeedsClip(polygon[k].Position);
+		}
+		if (!valid || outCodeAnd != 0)
+		{
+			continue;
+		}
+
+		int count = clip ? ClipPolygon(polygon, 3) : 3;
+		for (int i = 1; i + 1 < count; i++)
+		{
+			const ClipVertex* vertices[3] = { &polygon[0], &polygon[i], &polygon[i + 1] };
+			SetupTriangle(vertices, texture, chunk);
+		}
+	}
+
+	// タイルに振り分ける（数えてから詰める）
+	auto tileCount = m_TilesX * m_TilesY;
+	chunk.TileStart.assign(tileCount + 1, 0);
+	for (auto& triangle : chunk.Triangles)
+	{
+		for (auto ty = triangle.MinY / TILE_SIZE; ty <= triangle.MaxY / TILE_SIZE; ty++)
+		{
+			for (auto tx = triangle.MinX / TILE_SIZE; tx <= triangle.MaxX / TILE_SIZE; tx++)
+			{
+				chunk.TileStart[ty * m_TilesX + tx + 1]++;
+			}
+		}
+	}
+	for (uint32_t tile = 0; tile < tileCount; tile++)
+	{
+		chunk.TileStart[tile + 1] += chunk.TileStart[tile];
+	}
+	chunk.TileTriangles.resize(chunk.TileStart[tileCount]);
+	std::vector<uint32_t> cursor(chunk.TileStart.begin(), chunk.TileStart.end() - 1);
+	for (uint32_t i = 0; i < chunk.Triangles.size(); i++)
+	{
+		auto& triangle = chunk.Triangles[i];
+		for (auto ty = triangle.MinY / TILE_SIZE; ty <= triangle.MaxY / TILE_SIZE; ty++)
+		{
+			for (auto tx = triangle.MinX / TILE_SIZE; tx <= triangle.MaxX / TILE_SIZE; tx++)
+			{
+				chunk.TileTriangles[cursor[ty * m_TilesX + tx]++] = static_cast<uint16_t>(i);
+			}
+		}
+	}
+}
+
+void SoftwareRenderer::SetupTriangle(const ClipVertex* vertices[3], uint32_t texture, Chunk& chunk)
+{
+	// 切り取りで1つの三角形から7つまでしか増えないので、塊の中の番号は16ビットに収まる
+	if (chunk.Triangles.size() > 0xffff)
+	{
+		return;
+	}
+
+	float x[3], y[3], z[3], invW[3];
+	for (int k = 0; k < 3; k++)
+	{
+		auto& p = vertices[k]->Position;
+		invW[k] = 1.0f / p[3];
+		x[k] = Snap((p[0] * invW[k] * 0.5f + 0.5f) * m_Width);
+		y[k] = Snap((0.5f - p[1] * invW[k] * 0.5f) * m_Height);
+		z[k] = p[2] * invW[k];
+	}
+
+	// 丸めた座標（2^14より小さく、小数は8ビット）の積はdoubleで誤差なしに求まる
+	auto area = static_cast<double>(x[1] - x[0]) * (y[2] - y[0]) - static_cast<double>(x[2] - x[0]) * (y[1] - y[0]);
+	if (area == 0.0)
+	{
+		return;
+	}
+
+	// 中心が三角形の範囲に入る画素
+	auto minX = std::max<float>(std::ceil(std::min<float>(std::min<float>(x[0], x[1]), x[2]) - 0.5f), 0.0f);
+	auto maxX = std::min<float>(std::floor(std::max<float>(std::max<float>(x[0], x[1]), x[2]) - 0.5f), static_cast<float>(m_Width - 1));
+	auto minY = std::max<float>(std::ceil(std::min<float>(std::min<float>(y[0], y[1]), y[2]) - 0.5f), 0.0f);
+	auto maxY = std::min<float>(std::floor(std::max<float>(std::max<float>(y[0], y[1]), y[2]) - 0.5f), static_cast<float>(m_Height - 1));
+	if (minX > maxX || minY > maxY)
+	{
+		return;
+	}
+
+	Triangle triangle;
+	triangle.MinX = static_cast<int32_t>(minX);
+	triangle.MaxX = static_cast<int32_t>(maxX);
+	triangle.MinY = static_cast<int32_t>(minY);
+	triangle.MaxY = static_cast<int32_t>(maxY);
+	triangle.Texture = texture;
+
+	// 辺の関数は三角形の内側で正になるように符号をそろえる（裏向きの三角形も描く。Sceneのカリングは無し）
+	auto sign = area > 0.0 ? 1.0 : -1.0;
+	for (int k = 0; k < 3; k++)
+	{
+		auto a = (k + 1) % 3;
+		auto b = (k + 2) % 3;
+		auto edgeA = (static_cast<double>(y[a]) - y[b]) * sign;
+		auto edgeB = (static_cast<double>(x[b]) - x[a]) * sign;
+		triangle.EdgeA[k] = static_cast<float>(edgeA);
+		triangle.EdgeB[k] = static_cast<float>(edgeB);
+		triangle.EdgeC[k] = (static_cast<double>(x[a]) * y[b] - static_cast<double>(y[a]) * x[b]) * sign;
+		// 左の辺（内側が右）と上の辺（水平で内側が下）の上の画素は含める
+		triangle.TopLeft[k] = edgeA > 0.0 || (edgeA == 0.0 && edgeB > 0.0) ? 0xffffffffu : 0;
+		triangle.InvW[k] = invW[k];
+		memcpy(triangle.Attributes[k], vertices[k]->Attributes, sizeof(triangle.Attributes[k]));
+	}
+
+	auto depthA = ((static_cast<double>(z[1]) - z[0]) * (y[2] - y[0]) - (static_cast<double>(z[2]) - z[0]) * (y[1] - y[0])) / area;
+	auto depthB = ((static_cast<double>(x[1]) - x[0]) * (z[2] - z[0]) - (static_cast<double>(x[2]) - x[0]) * (z[1] - z[0])) / area;
+	triangle.DepthA = static_cast<float>(depthA);
+	triangle.DepthB = static_cast<float>(depthB);
+	triangle.DepthC = z[0] - depthA * x[0] - depthB * y[0];
+	chunk.Triangles.push_back(triangle);
+}
+
+void SoftwareRenderer::RasterizeTriangle(const Triangle& triangle, int32_t originX, int32_t originY, float* depths, uint32_t* ids, uint32_t id)
+{
+	auto x0 = std::max<int32_t>(triangle.MinX, originX) - originX;
+	auto x1 = std::min<int32_t>(triangle.MaxX, originX + TILE_SIZE - 1) - originX;
+	auto y0 = std::max<int32_t>(triangle.MinY, originY) - originY;
+	auto y1 = std::min<int32_t>(triangle.MaxY, originY + TILE_SIZE - 1) - originY;
+	if (x0 > x1 || y0 > y1)
+	{
+		return;
+	}
+	x0 &= ~3;
+
+	// タイルの原点での値に直すので、タイルの中の座標は小さく、floatでも辺の近くの精度が落ちない
+	float edgeC[3];
+	for (int k = 0; k < 3; k++)
+	{
+		edgeC[k] = static_cast<float>(triangle.EdgeA[k] * static_cast<double>(originX) + triangle.EdgeB[k] * static_cast<double>(originY) + triangle.EdgeC[k]);
+	}
+	auto depthC = static_cast<float>(triangle.DepthA * static_cast<double>(originX) + triangle.DepthB * static_cast<double>(originY) + triangle.DepthC);
+
+#ifdef SOFTWARE_RENDERER_USE_SSE2
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	__m128 edgeA[3], topLeft[3];
+	for (int k = 0; k < 3; k++)
+	{
+		edgeA[k] = _mm_set1_ps(triangle.EdgeA[k]);
+		topLeft[k] = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(triangle.TopLeft[k])));
+	}
+	const __m128 depthA = _mm_set1_ps(triangle.DepthA);
+	const __m128i idVector = _mm_set1_epi32(static_cast<int>(id));
+	for (auto row = y0; row <= y1; row++)
+	{
+		auto py = row + 0.5f;
+		__m128 rowEdge[3];
+		for (int k = 0; k < 3; k++)
+		{
+			rowEdge[k] = _mm_set1_ps(triangle.EdgeB[k] * py + edgeC[k]);
+		}
+		auto rowDepth = _mm_set1_ps(triangle.DepthB * py + depthC);
+		for (auto column = x0; column <= x1; column += 4)
+		{
+			auto px = _mm_add_ps(_mm_set1_ps(static_cast<float>(column)), offsets);
+			__m128 mask = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int k = 0; k < 3; k++)
+			{
+				auto e = _mm_add_ps(_mm_mul_ps(edgeA[k], px), rowEdge[k]);
+				auto inside = _mm_or_ps(_mm_cmpgt_ps(e, zero), _mm_and_ps(_mm_cmpeq_ps(e, zero), topLeft[k]));
+				mask = _mm_and_ps(mask, inside);
+			}
+			if (_mm_movemask_ps(mask) == 0)
+			{
+				continue;
+			}
+
+			auto offset = row * TILE_SIZE + column;
+			auto z = _mm_add_ps(_mm_mul_ps(depthA, px), rowDepth);
+			auto oldDepth = _mm_loadu_ps(depths + offset);
+			auto pass = _mm_and_ps(mask, _mm_cmplt_ps(z, oldDepth));
+			_mm_storeu_ps(depths + offset, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, oldDepth)));
+			auto passInt = _mm_castps_si128(pass);
+			auto oldIds = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ids + offset));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(ids + offset), _mm_or_si128(_mm_and_si128(passInt, idVector), _mm_andnot_si128(passInt, oldIds)));
+		}
+	}
+#else
+	for (auto row = y0; row <= y1; row++)
+	{
+		auto py = row + 0.5f;
+		float rowEdge[3];
+		for (int k = 0; k < 3; k++)
+		{
+			rowEdge[k] = triangle.EdgeB[k] * py + edgeC[k];
+		}
+		auto rowDepth = triangle.DepthB * py + depthC;
+		for (auto column = x0; column < x0 + ((x1 - x0) / 4 + 1) * 4; column++)
+		{
+			auto px = column + 0.5f;
+			bool inside = true;
+			for (int k = 0; k < 3; k++)
+			{
+				auto e = triangle.EdgeA[k] * px + rowEdge[k];
+				inside = inside && (e > 0.0f || (e == 0.0f && triangle.TopLeft[k] != 0));
+			}
+			auto offset = row * TILE_SIZE + column;
+			auto z = triangle.DepthA * px + rowDepth;
+			if (inside && z < depths[offset])
+			{
+				depths[offset] = z;
+				ids[offset] = id;
+			}
+		}
+	}
+#endif
+}
+
+void SoftwareRenderer::ProcessTile(const SoftwareScene& scene, uint32_t tile, int64_t* pRasterTime, int64_t* pShadeTime, uint64_t* pShadedPixels)
+{
+	auto start = Profiler::Now();
+	auto originX = static_cast<int32_t>((tile % m_TilesX) * TILE_SIZE);
+	auto originY = static_cast<int32_t>((tile / m_TilesX) * TILE_SIZE);
+
+	// 深度（クリアは1.0）と、一番手前の三角形の番号だけを持つ
+	alignas(16) float depths[TILE_SIZE * TILE_SIZE];
+	alignas(16) uint32_t ids[TILE_SIZE * TILE_SIZE];
+	std::fill(std::begin(depths), std::end(depths), 1.0f);
+	std::fill(std::begin(ids), std::end(ids), NoTriangle);
+
+	for (uint32_t chunkIndex = 0; chunkIndex < m_Chunks.size(); chunkIndex++)
+	{
+		auto& chunk = m_Chunks[chunkIndex];
+		if (chunk.TriangleCount == 0)
+		{
+			continue;
+		}
+		for (auto i = chunk.TileStart[tile]; i < chunk.TileStart[tile + 1]; i++)
+		{
+			auto local = chunk.TileTriangles[i];
+			RasterizeTriangle(chunk.Triangles[local], originX, originY, depths, ids, (chunkIndex << 16) | local);
+		}
+	}
+	auto rasterized = Profiler::Now();
+
+	auto width = std::min<int32_t>(TILE_SIZE, static_cast<int32_t>(m_Width) - originX);
+	auto height = std::min<int32_t>(TILE_SIZE, static_cast<int32_t>(m_Height) - originY);
+	uint64_t shaded = 0;
+	for (int32_t row = 0; row < height; row++)
+	{
+		auto out = &m_Pixels[(static_cast<size_t>(originY + row) * m_Width + originX) * 3];
+		for (int32_t column = 0; column < width; column++, out += 3)
+		{
+			auto id = ids[row * TILE_SIZE + column];
+			if (id == NoTriangle)
+			{
+				memcpy(out, ClearColor, sizeof(ClearColor));
+				continue;
+			}
+			auto& triangle = m_Chunks[id >> 16].Triangles[id & 0xffff];
+			ShadePixel(scene, triangle, originX + column + 0.5, originY + row + 0.5, out);
+			shaded++;
+		}
+	}
+	auto end = Profiler::Now();
+
+	*pRasterTime += rasterized - start;
+	*pShadeTime += end - rasterized;
+	*pShadedPixels += shaded;
+}
+
+void SoftwareRenderer::ShadePixel(const SoftwareScene& scene, const Triangle& triangle, double x, double y, float* pColor) const
+{
+	// 画面の重心座標から、1/wで補間の重みを直す（透視補正）
+	double weights[3];
+	double total = 0.0;
+	for (int k = 0; k < 3; k++)
+	{
+		auto e = std::max<double>(triangle.EdgeA[k] * x + triangle.EdgeB[k] * y + triangle.EdgeC[k], 0.0);
+		weights[k] = e * triangle.InvW[k];
+		total += weights[k];
+	}
+	// スカイボックスは方向の3つだけを使う
+	const bool isSky = triangle.Texture == SkyTexture;
+	const int attributeCount = isSky ? 3 : 8;
+	float attributes[8];
+	for (int i = 0; i < attributeCount; i++)
+	{
+		auto value = 0.0;
+		for (int k = 0; k < 3; k++)
+		{
+			value += weights[k] * triangle.Attributes[k][i];
+		}
+		attributes[i] = static_cast<float>(total > 0.0 ? value / total : triangle.Attributes[0][i]);
+	}
+
+	// SkyboxPS: キューブマップの色をそのまま返す
+	if (isSky)
+	{
+		float color[4];
+		scene.Sky.Sample(attributes, color);
+		memcpy(pColor, color, sizeof(float) * 3);
+		return;
+	}
+
+	// PBR.hlsl
+	auto position = attributes;
+	float n[3] = { attributes[3], attributes[4], attributes[5] };
+	Normalize(n);
+	float v[3] = { scene.CameraPosition[0] - position[0], scene.CameraPosition[1] - position[1], scene.CameraPosition[2] - position[2] };
+	Normalize(v);
+	auto f0 = 0.04f + (Albedo - 0.04f) * Metallic;
+
+	// EvaluateLight
+	auto evaluate = [&](const float l[3])
+	{
+		float h[3] = { v[0] + l[0], v[1] + l[1], v[2] + l[2] };
+		Normalize(h);
+
+		auto nDotV = Saturate(Dot(n, v));
+		auto nDotL = Saturate(Dot(n, l));
+		auto ndf = DistributionGGX(n, h, Roughness);
+		auto g = GeometrySchlickGGX(nDotL, Roughness) * GeometrySchlickGGX(nDotV, Roughness);
+		// pow(x, 5.0)はシェーダーのコンパイラーと同じく掛け算に展開する
+		auto x = Saturate(1.0f - Saturate(Dot(h, v)));
+		auto f = f0 + (1.0f - f0) * (x * x) * (x * x) * x;
+		auto kd = (1.0f - f) * (1.0f - Metallic);
+		auto specular = ndf * g * f / (4.0f * nDotV * nDotL + 1.0e-5f);
+		return (kd * Albedo / Pi + specular) * nDotL;
+	};
+
+	float lo[3] = {};
+	for (int i = 0; i < scene.LightCount; i++)
+	{
+		auto& light = scene.Lights[i];
+		float l[3] = { light.Position[0] - position[0], light.Position[1] - position[1], light.Position[2] - position[2] };
+		Normalize(l);
+		auto value = evaluate(l);
+		lo[0] += value;
+		lo[1] += value;
+		lo[2] += value;
+	}
+	// 点光源は半径の外では0になる窓を掛けた距離の2乗の減衰
+	for (auto& light : scene.PointLights)
+	{
+		float l[3] = { light.Position[0] - position[0], light.Position[1] - position[1], light.Position[2] - position[2] };
+		auto distance = std::sqrt(Dot(l, l));
+		if (distance >= light.Radius)
+		{
+			continue;
+		}
+		auto ratio = distance / light.Radius;
+		auto window = Saturate(1.0f - ratio * ratio * ratio * ratio);
+		auto attenuation = window * window / (distance * distance + 1.0f);
+		auto length = std::max<float>(distance, 1.0e-4f);
+		for (auto& value : l)
+		{
+			value /= length;
+		}
+		auto value = evaluate(l) * light.Intensity * attenuation;
+		for (int i = 0; i < 3; i++)
+		{
+			lo[i] += value * light.Color[i];
+		}
+	}
+
+	float texel[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	if (triangle.Texture != WhiteTexture)
+	{
+		scene.Textures[triangle.Texture].Sample(attributes[6], attributes[7], texel);
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		auto color = lo[i] * texel[i];
+		color = color / (color + 1.0f);
+		pColor[i] = std::pow(color, 1.0f / 2.2f);
+	}
+}
+
+bool SoftwareRenderer::Write(const std::filesystem::path& path) const
+{
+	auto png = path;
+	auto exr = path;
+	png.replace_extension(".png");
+	exr.replace_extension(".exr");
+	if (!ImageFile::WritePng(png, m_Width, m_Height, m_Pixels) || !ImageFile::WriteExr(exr, m_Width, m_Height, m_Pixels))
+	{
+		printf("画像の書き出しに失敗: %ls\n", path.wstring().c_str());
+		return false;
+	}
+	return true;
+}
+
+bool SoftwareRenderer::Compare(const std::filesystem::path& referencePath, float tolerance, const std::filesystem::path& diffPath) const
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<float> reference;
+	if (!ImageFile::ReadExr(referencePath, &width, &height, reference))
+	{
+		printf("基準の画像の読み込みに失敗: %ls\n", referencePath.wstring().c_str());
+		return false;
+	}
+	if (width != m_Width || height != m_Height)
+	{
+		printf("基準の画像の大きさが違う: %ux%u (描いたのは %ux%u)\n", width, height, m_Width, m_Height);
+		return false;
+	}
+
+	uint64_t differentPixels = 0;
+	float maxDifference = 0.0f;
+	std::vector<float> diff(m_Pixels.size());
+	for (size_t pixel = 0; pixel < m_Pixels.size() / 3; pixel++)
+	{
+		bool different = false;
+		for (int i = 0; i < 3; i++)
+		{
+			auto difference = std::fabs(m_Pixels[pixel * 3 + i] - reference[pixel * 3 + i]);
+			different = different || !(difference <= tolerance); // NaNも違う画素にする
+			maxDifference = std::max<float>(maxDifference, difference);
+			diff[pixel * 3 + i] = difference * 10.0f;
+		}
+		differentPixels += different ? 1 : 0;
+	}
+
+	printf("基準の画像との比較: 違う画素 %llu / %llu (許容 %g), 最大の差 %g\n",
+		static_cast<unsigned long long>(differentPixels), static_cast<unsigned long long>(m_Pixels.size() / 3), tolerance, maxDifference);
+	if (differentPixels > 0 && !diffPath.empty() && ImageFile::WritePng(diffPath, m_Width, m_Height, diff))
+	{
+		printf("差の画像を書き出した: %ls\n", diffPath.wstring().c_str());
+	}
+	return differentPixels == 0;
+}
+
+void SoftwareRenderer::MakeTestScene(uint32_t width, uint32_t height, SoftwareScene* pScene)
+{
+	*pScene = SoftwareScene();
+
+	// 市松模様のテクスチャ（球とトーラスで色を変える）
+	auto makeChecker = [](const float color[3])
+	{
+		const uint32_t Size = 256;
+		const uint32_t Checks = 8;
+		SoftwareTexture texture;
+		texture.Width = Size;
+		texture.Height = Size;
+		texture.Texels.resize(Size * Size * 4);
+		for (uint32_t y = 0; y < Size; y++)
+		{
+			for (uint32_t x = 0; x < Size; x++)
+			{
+				bool odd = ((x * Checks / Size) + (y * Checks / Size)) % 2 != 0;
+				auto texel = &texture.Texels[(y * Size + x) * 4];
+				for (int i = 0; i < 3; i++)
+				{
+					texel[i] = odd ? color[i] : 0.9f;
+				}
+				texel[3] = 1.0f;
+			}
+		}
+		return texture;
+	};
+	const float SphereColor[3] = { 0.8f, 0.3f, 0.2f };
+	const float TorusColor[3] = { 0.2f, 0.5f, 0.9f };
+	pScene->Textures.push_back(makeChecker(SphereColor));
+	pScene->Textures.push_back(makeChecker(TorusColor));
+
+	// 球（半径1）とトーラス（外側の半径1）。UVは経度と緯度
+	const uint32_t Slices = 64;
+	const uint32_t Stacks = 32;
+	auto addGrid = [](SoftwareMesh& mesh)
+	{
+		for (uint32_t stack = 0; stack < Stacks; stack++)
+		{
+			for (uint32_t slice = 0; slice < Slices; slice++)
+			{
+				auto i0 = stack * (Slices + 1) + slice;
+				auto i1 = i0 + Slices + 1;
+				uint32_t quad[6] = { i0, i1, i0 + 1, i0 + 1, i1, i1 + 1 };
+				mesh.Indices.insert(mesh.Indices.end(), std::begin(quad), std::end(quad));
+			}
+		}
+	};
+	SoftwareMesh sphere;
+	SoftwareMesh torus;
+	for (uint32_t stack = 0; stack <= Stacks; stack++)
+	{
+		for (uint32_t slice = 0; slice <= Slices; slice++)
+		{
+			auto u = static_cast<float>(slice) / Slices;
+			auto v = static_cast<float>(stack) / Stacks;
+			auto phi = u * 2.0f * Pi;
+			auto theta = v * Pi;
+			float n[3] = { std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+			sphere.Positions.insert(sphere.Positions.end(), n, n + 3);
+			sphere.Normals.insert(sphere.Normals.end(), n, n + 3);
+			sphere.UVs.push_back(u);
+			sphere.UVs.push_back(v);
+
+			const float Major = 0.7f;
+			const float Minor = 0.3f;
+			auto ring = v * 2.0f * Pi;
+			float tn[3] = { std::cos(ring) * std::cos(phi), std::sin(ring), std::cos(ring) * std::sin(phi) };
+			float tp[3] = { (Major + Minor * std::cos(ring)) * std::cos(phi), Minor * std::sin(ring), (Major + Minor * std::cos(ring)) * std::sin(phi) };
+			torus.Positions.insert(torus.Positions.end(), tp, tp + 3);
+			torus.Normals.insert(torus.Normals.end(), tn, tn + 3);
+			torus.UVs.push_back(u * 4.0f);
+			torus.UVs.push_back(v);
+		}
+	}
+	addGrid(sphere);
+	addGrid(torus);
+	sphere.Texture = 0;
+	torus.Texture = 1;
+	pScene->Meshes.push_back(std::move(sphere));
+	pScene->Meshes.push_back(std::move(torus));
+
+	// Sceneと同じく格子状に並べる（奥へ-zの方向）。向きを変え、トーラスは縦に伸ばして法線の変換も確かめる
+	const uint32_t Side = 6;
+	const float Spacing = 3.0f;
+	for (uint32_t copy = 0; copy < Side * Side; copy++)
+	{
+		auto x = (static_cast<float>(copy % Side) - (Side - 1) * 0.5f) * Spacing;
+		auto z = -static_cast<float>(copy / Side) * Spacing;
+		auto mesh = copy % 2;
+		float scaling[16], rotation[16], translation[16], temporary[16], world[16];
+		Scaling(1.0f, mesh == 0 ? 1.0f : 1.5f, 1.0f, scaling);
+		RotationY(copy * 0.7f, rotation);
+		Translation(x, 0.0f, z, translation);
+		Multiply(scaling, rotation, temporary);
+		Multiply(temporary, translation, world);
+		SoftwareInstance instance;
+		SetInstance(world, mesh, &instance);
+		pScene->Instances.push_back(instance);
+	}
+
+	// 手続きの空のキューブマップ（面の中の座標から方向を求める。SoftwareCubeMap::Sampleの逆）
+	const uint32_t FaceSize = 128;
+	for (int face = 0; face < 6; face++)
+	{
+		auto& texture = pScene->Sky.Faces[face];
+		texture.Width = FaceSize;
+		texture.Height = FaceSize;
+		texture.Texels.resize(FaceSize * FaceSize * 4);
+		for (uint32_t y = 0; y < FaceSize; y++)
+		{
+			for (uint32_t x = 0; x < FaceSize; x++)
+			{
+				auto sc = (x + 0.5f) / FaceSize * 2.0f - 1.0f;
+				auto tc = (y + 0.5f) / FaceSize * 2.0f - 1.0f;
+				float directions[6][3] =
+				{
+					{ 1.0f, -tc, -sc }, { -1.0f, -tc, sc }, { sc, 1.0f, tc },
+					{ sc, -1.0f, -tc }, { sc, -tc, 1.0f }, { -sc, -tc, -1.0f },
+				};
+				SkyColor(directions[face], &texture.Texels[(y * FaceSize + x) * 4]);
+			}
+		}
+	}
+	pScene->HasSky = true;
+
+	// Cameraと同じ作り方のビュー行列（XMMatrixLookAtLH(eye, eye + front, up)）と、Sceneと同じ射影（XMMatrixPerspectiveFovRH）
+	// 射影が右手系なので、見えるのはfrontと反対の方向
+	const float Yaw = 90.0f * Pi / 180.0f;
+	const float Pitch = 15.0f * Pi / 180.0f;
+	float eye[3] = { 0.0f, 4.0f, 7.0f };
+	float front[3] = { std::cos(Yaw) * std::cos(Pitch), std::sin(Pitch), std::sin(Yaw) * std::cos(Pitch) };
+	float worldUp[3] = { 0.0f, 1.0f, 0.0f };
+	float xAxis[3] = { worldUp[1] * front[2] - worldUp[2] * front[1], worldUp[2] * front[0] - worldUp[0] * front[2], worldUp[0] * front[1] - worldUp[1] * front[0] };
+	Normalize(xAxis);
+	float yAxis[3] = { front[1] * xAxis[2] - front[2] * xAxis[1], front[2] * xAxis[0] - front[0] * xAxis[2], front[0] * xAxis[1] - front[1] * xAxis[0] };
+	float view[16] =
+	{
+		xAxis[0], yAxis[0], front[0], 0.0f,
+		xAxis[1], yAxis[1], front[1], 0.0f,
+		xAxis[2], yAxis[2], front[2], 0.0f,
+		-Dot(xAxis, eye), -Dot(yAxis, eye), -Dot(front, eye), 1.0f,
+	};
+
+	const float NearZ = 0.3f;
+	const float FarZ = 1000.0f;
+	auto yScale = 1.0f / std::tan(45.0f * Pi / 180.0f * 0.5f);
+	auto xScale = yScale / (static_cast<float>(width) / height);
+	auto range = FarZ / (NearZ - FarZ);
+	float projection[16] =
+	{
+		xScale, 0.0f, 0.0f, 0.0f,
+		0.0f, yScale, 0.0f, 0.0f,
+		0.0f, 0.0f, range, -1.0f,
+		0.0f, 0.0f, range * NearZ, 0.0f,
+	};
+	memcpy(pScene->View, view, sizeof(view));
+	memcpy(pScene->Projection, projection, sizeof(projection));
+
+	// スカイボックスはScene::Updateと同じく、ビューの平行移動を消して500倍する
+	Scaling(500.0f, 500.0f, 500.0f, pScene->SkyWorld);
+	memcpy(pScene->SkyView, view, sizeof(view));
+	pScene->SkyView[12] = 0.0f;
+	pScene->SkyView[13] = 0.0f;
+	pScene->SkyView[14] = 0.0f;
+	memcpy(pScene->SkyProjection, projection, sizeof(projection));
+
+	pScene->Lights[0] = { { 1000.0f, 1000.0f, 1000.0f }, 1.0f };
+	pScene->LightCount = 1;
+	memcpy(pScene->CameraPosition, eye, sizeof(eye));
+}
+
+bool SoftwareRenderer::RunHeadless(const std::filesystem::path& output, const std::filesystem::path& reference, uint32_t frames)
+{
+	const uint32_t Width = 1920;
+	const uint32_t Height = 1080;
+	SoftwareScene scene;
+	MakeTestScene(Width, Height, &scene);
+
+	SoftwareRenderer renderer;
+	renderer.Init(Width, Height);
+
+	// 最初のフレームは塊のバッファの確保が入るので、計測に含めない
+	frames = std::max<uint32_t>(frames, 1);
+	renderer.Render(scene);
+	Timings total = {};
+	for (uint32_t frame = 0; frame < frames; frame++)
+	{
+		renderer.Render(scene);
+		auto& timings = renderer.GetTimings();
+		total.Geometry += timings.Geometry;
+		total.Tiles += timings.Tiles;
+		total.RasterCpu += timings.RasterCpu;
+		total.ShadeCpu += timings.ShadeCpu;
+		total.Total += timings.Total;
+	}
+
+	auto& last = renderer.GetTimings();
+	printf("ソフトウェアレンダラー: %ux%u, 三角形 %u (切り取りと除去の後 %u, タイルへの登録 %u), シェーディング %llu画素, %uスレッド, %uフレームの平均\n",
+		Width, Height, last.InputTriangles, last.Triangles, last.BinnedTriangles, static_cast<unsigned long long>(last.ShadedPixels),
+		g_JobSystem != nullptr ? g_JobSystem->WorkerCount() : 1, frames);
+	printf("  1フレーム: %.2f ms (目標 %.1f ms: %s)\n", total.Total / frames, TargetFrameTime1080p, total.Total / frames <= TargetFrameTime1080p ? "達成" : "未達");
+	printf("  幾何: %.2f ms, タイル: %.2f ms (全スレッドの合計で ラスタライズ %.2f ms, シェーディング %.2f ms)\n",
+		total.Geometry / frames, total.Tiles / frames, total.RasterCpu / frames, total.ShadeCpu / frames);
+	printf("  1秒あたり: 三角形 %.1f M, 画素 %.1f M\n",
+		last.InputTriangles / (total.Total / frames) * 1e-3, static_cast<double>(Width) * Height / (total.Total / frames) * 1e-3);
+
+	bool succeeded = true;
+	if (!output.empty())
+	{
+		succeeded = renderer.Write(output);
+		if (succeeded)
+		{
+			printf("画像を書き出した: %ls (.png, .exr)\n", output.wstring().c_str());
+		}
+	}
+	if (!reference.empty())
+	{
+		auto diffPath = output.empty() ? std::filesystem::path() : std::filesystem::path(output).replace_extension(".diff.png");
+		succeeded = renderer.Compare(reference, 1.0e-3f, diffPath) && succeeded;
+	}
+	return succeeded;
+}
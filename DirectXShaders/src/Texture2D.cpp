@@ -1,6 +1,8 @@
 #include "Texture2D.h"
 #include <DirectXTex.h>
 #include "Engine.h"
+#include "FrameStats.h"
+#include "SoftwareRenderer.h"
 
 #pragma comment(lib, "DirectXTex.lib")
 
@@ -35,6 +37,29 @@ std::wstring GetFileExtension(const std::wstring& filename)
 	return filename.substr(pos);
 }
 
+// 拡張子に合わせてファイルを読む
+HRESULT LoadImageFile(const std::wstring& path, TexMetadata* pMetadata, ScratchImage& image)
+{
+	auto ext = GetFileExtension(path);
+	if (ext == L".png")
+	{
+		return LoadFromWICFile(path.c_str(), WIC_FLAGS_NONE, pMetadata, image);
+	}
+	else if (ext == L".tga")
+	{
+		return LoadFromTGAFile(path.c_str(), pMetadata, image);
+	}
+	else if (ext == L".dds")
+	{
+		return LoadFromDDSFile(path.c_str(), DDS_FLAGS_NONE, pMetadata, image);
+	}
+	else if (ext == L".hdr")
+	{
+		return LoadFromHDRFile(path.c_str(), pMetadata, image);
+	}
+	return S_FALSE;
+}
+
 Texture2D::Texture2D(std::string path)
 {
 	m_IsValid = Load(path);
@@ -49,6 +74,22 @@ Texture2D::Texture2D(ID3D12Resource* buffer)
 {
 	m_pResource = buffer;
 	m_IsValid = m_pResource != nullptr;
+	if (m_IsValid)
+	{
+		TrackMemory();
+	}
+}
+
+Texture2D::~Texture2D()
+{
+	if (m_MemorySize > 0)
+	{
+		FrameStats::Add(STAT_RESOURCE_COUNT, -1);
+		FrameStats::Add(STAT_RESOURCE_BYTES, -static_cast<int64_t>(m_MemorySize));
+	}
+
+	// SRVから参照されたまま描画中の可能性があるので、フェンスの完了まで解放しない
+	g_Engine->DeferRelease(m_pResource.Detach());
 }
 
 bool Texture2D::Load(std::string& path)
@@ -63,24 +104,7 @@ bool Texture2D::Load(std::wstring& path)
 	ScratchImage scratchImg = {};
 	auto ext = GetFileExtension(path);
 
-	HRESULT hr = S_FALSE;
-	if (ext == L".png")
-	{
-		hr = LoadFromWICFile(path.c_str(), WIC_FLAGS_NONE, &metadata, scratchImg);
-	}
-	else if (ext == L".tga")
-	{
-		hr = LoadFromTGAFile(path.c_str(), &metadata, scratchImg);
-	}
-	else if (ext == L".dds")
-	{
-		hr = LoadFromDDSFile(path.c_str(), DDS_FLAGS_NONE, &metadata, scratchImg);
-	}
-    else if (ext == L".hdr")
-    {
-		 hr = LoadFromHDRFile(path.c_str(), &metadata, scratchImg);
-    }
-
+	HRESULT hr = LoadImageFile(path, &metadata, scratchImg);
 	if (FAILED(hr))
 	{
 		printf("テクスチャの読み込みに失敗\n");
@@ -111,6 +135,7 @@ bool Texture2D::Load(std::wstring& path)
 		printf("テクスチャのリソース作成に失敗aa\n");
 		return false;
 	}
+	TrackMemory();
 
 	if (ext == L".dds")
 	{
@@ -131,6 +156,7 @@ bool Texture2D::Load(std::wstring& path)
 					static_cast<UINT>(img->rowPitch),
 					static_cast<UINT>(img->slicePitch)
 				);
+				FrameStats::Add(STAT_UPLOAD_BYTES, img->slicePitch);
 			}
 		}
 	}
@@ -148,10 +174,19 @@ bool Texture2D::Load(std::wstring& path)
 		printf("テクスチャのリソース書き込みに失敗\n");
 		return false;
 	}
+	FrameStats::Add(STAT_UPLOAD_BYTES, img->slicePitch);
 
 	return true;
 }
 
+void Texture2D::TrackMemory()
+{
+	auto desc = m_pResource->GetDesc();
+	m_MemorySize = g_Engine->Device()->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+	FrameStats::Add(STAT_RESOURCE_COUNT, 1);
+	FrameStats::Add(STAT_RESOURCE_BYTES, m_MemorySize);
+}
+
 Texture2D* Texture2D::Get(std::string path)
 {
 	auto wpath = GetWideString(path);
@@ -163,6 +198,7 @@ Texture2D* Texture2D::Get(std::wstring path)
 	auto tex = new Texture2D(path);
 	if (!tex->IsValid())
 	{
+		delete tex;
 		return GetWhite();
 	}
 	return tex;
@@ -173,6 +209,7 @@ Texture2D* Texture2D::Get(ID3D12Resource* buffer)
 	auto tex = new Texture2D(buffer);
 	if (!tex->IsValid())
 	{
+		delete tex;
 		return GetWhite();
 	}
 
@@ -191,10 +228,66 @@ Texture2D* Texture2D::GetWhite()
 	if (FAILED(hr))
 	{
 		printf("テクスチャのリソース書き込みに失敗\n");
+		buff->Release();
 		return nullptr;
 	}
 
-	return new Texture2D(buff);
+	FrameStats::Add(STAT_UPLOAD_BYTES, data.size());
+
+	auto tex = new Texture2D(buff);
+	buff->Release(); // 参照はTexture2D側が持つ
+	return tex;
+}
+
+bool Texture2D::ReadPixels(const std::wstring& path, std::vector<SoftwareTexture>& images)
+{
+	TexMetadata metadata = {};
+	ScratchImage scratchImg = {};
+	auto hr = LoadImageFile(path, &metadata, scratchImg);
+	if (hr != S_OK)
+	{
+		printf("テクスチャの読み込みに失敗: %ls\n", path.c_str());
+		return false;
+	}
+
+	// 圧縮されたものは展開し、どの形式もRGBAの浮動小数に直す（sRGBの形式は線形になるので、GPUでサンプリングした値と同じ）
+	ScratchImage converted;
+	auto source = &scratchImg;
+	if (metadata.format != DXGI_FORMAT_R32G32B32A32_FLOAT)
+	{
+		if (IsCompressed(metadata.format))
+		{
+			hr = Decompress(scratchImg.GetImages(), scratchImg.GetImageCount(), metadata, DXGI_FORMAT_R32G32B32A32_FLOAT, converted);
+		}
+		else
+		{
+			hr = Convert(scratchImg.GetImages(), scratchImg.GetImageCount(), metadata, DXGI_FORMAT_R32G32B32A32_FLOAT,
+				TEX_FILTER_DEFAULT, TEX_THRESHOLD_DEFAULT, converted);
+		}
+		if (FAILED(hr))
+		{
+			printf("テクスチャの変換に失敗: %ls\n", path.c_str());
+			return false;
+		}
+		source = &converted;
+	}
+
+	// 配列の要素（キューブマップなら6面）ごとに、一番大きいミップだけを取り出す
+	images.clear();
+	for (size_t item = 0; item < metadata.arraySize; item++)
+	{
+		auto image = source->GetImage(0, item, 0);
+		SoftwareTexture texture;
+		texture.Width = static_cast<uint32_t>(image->width);
+		texture.Height = static_cast<uint32_t>(image->height);
+		texture.Texels.resize(image->width * image->height * 4);
+		for (size_t y = 0; y < image->height; y++)
+		{
+			memcpy(&texture.Texels[y * image->width * 4], image->pixels + y * image->rowPitch, image->width * sizeof(float) * 4);
+		}
+		images.push_back(std::move(texture));
+	}
+	return true;
 }
 
 ID3D12Resource* Texture2D::GetDefaultResource(size_t width, size_t height)
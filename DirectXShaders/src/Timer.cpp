@@ -1,23 +1,46 @@
 #include "Timer.h"
 
+#ifndef _WIN32
+#include <chrono>
+
+namespace
+{
+	int64_t NowNanoseconds()
+	{
+		auto now = std::chrono::steady_clock::now().time_since_epoch();
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+	}
+}
+#endif
+
 Timer::Timer()
 {
+#ifdef _WIN32
 	QueryPerformanceFrequency(&m_Frequency);
+#endif
 	Reset();
 }
 
 void Timer::Reset()
 {
+#ifdef _WIN32
 	QueryPerformanceCounter(&m_StartTime);
+#else
+	m_StartTime = NowNanoseconds();
+#endif
 	m_ElapsedTime = 0.0;
 }
 
 double Timer::GetElapsedTime()
 {
+#ifdef _WIN32
 	LARGE_INTEGER currentTime;
 	QueryPerformanceCounter(&currentTime);
 	// microseconds
 	m_ElapsedTime = static_cast<double>(currentTime.QuadPart - m_StartTime.QuadPart) * 1000000 / m_Frequency.QuadPart;
+#else
+	m_ElapsedTime = static_cast<double>(NowNanoseconds() - m_StartTime) / 1000.0;
+#endif
 	// milliseconds
 	return m_ElapsedTime / 1000.0f;
 }
@@ -1,55 +1,63 @@
 #include "VertexBuffer.h"
-#include "Engine.h"
-#include <d3dx12.h>
+#include "FrameStats.h"
+#include <cstring>
+#include <stdio.h>
 
-VertexBuffer::VertexBuffer(size_t size, size_t stride, const void* pInitData)
+template<typename Backend>
+BasicVertexBuffer<Backend>::BasicVertexBuffer(size_t size, size_t stride, const void* pInitData)
 {
-	auto prop = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-	auto desc = CD3DX12_RESOURCE_DESC::Buffer(size);
-
-	auto hr = g_Engine->Device()->CreateCommittedResource(
-		&prop,
-		D3D12_HEAP_FLAG_NONE,
-		&desc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(m_pBuffer.GetAddressOf())
-	);
-
-	if(FAILED(hr))
+	if (!m_Buffer.Create(size, RHI_HEAP_UPLOAD))
 	{
 		printf("頂点バッファリソースの生成に失敗\n");
 		return;
 	}
 
-	m_View.BufferLocation = m_pBuffer->GetGPUVirtualAddress();
+	m_View.BufferLocation = m_Buffer.GpuAddress();
 	m_View.SizeInBytes = static_cast<UINT>(size);
 	m_View.StrideInBytes = static_cast<UINT>(stride);
 
 	if(pInitData != nullptr)
 	{
-		void* p;
-		hr = m_pBuffer->Map(0, nullptr, &p);
-
-		if(FAILED(hr))
+		void* p = m_Buffer.Map();
+		if (p == nullptr)
 		{
 			printf("頂点バッファリソースのマップに失敗\n");
 			return;
 		}
 
 		memcpy(p, pInitData, size);
-		m_pBuffer->Unmap(0, nullptr);
+		m_Buffer.Unmap();
+		FrameStats::Add(STAT_UPLOAD_BYTES, size);
 	}
 
+	FrameStats::Add(STAT_RESOURCE_COUNT, 1);
+	FrameStats::Add(STAT_RESOURCE_BYTES, size);
 	m_IsValid = true;
 }
 
-D3D12_VERTEX_BUFFER_VIEW VertexBuffer::View() const
+template<typename Backend>
+BasicVertexBuffer<Backend>::~BasicVertexBuffer()
+{
+	if (m_IsValid)
+	{
+		FrameStats::Add(STAT_RESOURCE_COUNT, -1);
+		FrameStats::Add(STAT_RESOURCE_BYTES, -static_cast<int64_t>(m_View.SizeInBytes));
+	}
+}
+
+template<typename Backend>
+RhiVertexBufferView BasicVertexBuffer<Backend>::View() const
 {
 	return m_View;
 }
 
-bool VertexBuffer::IsValid()
+template<typename Backend>
+bool BasicVertexBuffer<Backend>::IsValid()
 {
 	return m_IsValid;
 }
+
+template class BasicVertexBuffer<NullBackend>;
+#ifdef RHI_HAS_D3D12
+template class BasicVertexBuffer<D3D12Backend>;
+#endif
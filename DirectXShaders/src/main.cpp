@@ -1,9 +1,454 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <wchar.h>
+
+#ifdef _WIN32
 #include "App.h"
 
 int wmain(int argc, wchar_t* argv[])
 {
 	printf("Hello, World!\n");
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (wcscmp(argv[i], L"--no-pipeline-cache") == 0)
+		{
+			g_AppOptions.UsePipelineCache = false;
+		}
+		else if (wcscmp(argv[i], L"--shader-dir") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.ShaderDirectory = argv[++i];
+		}
+		else if (wcscmp(argv[i], L"--fps") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.TargetFrameRate = _wtof(argv[++i]);
+		}
+		else if (wcscmp(argv[i], L"--record-threads") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.RecordThreads = static_cast<UINT>(_wtoi(argv[++i]));
+		}
+		else if (wcscmp(argv[i], L"--frames-in-flight") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.FramesInFlight = static_cast<UINT>(_wtoi(argv[++i]));
+		}
+		else if (wcscmp(argv[i], L"--job-threads") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.JobThreads = static_cast<UINT>(_wtoi(argv[++i]));
+		}
+		else if (wcscmp(argv[i], L"--job-stress") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.JobStressRounds = static_cast<UINT>(_wtoi(argv[++i]));
+		}
+		else if (wcscmp(argv[i], L"--instances") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.InstanceCount = static_cast<UINT>(_wtoi(argv[++i]));
+		}
+		else if (wcscmp(argv[i], L"--moving-objects") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.MovingObjectCount = static_cast<UINT>(_wtoi(argv[++i]));
+		}
+		else if (wcscmp(argv[i], L"--no-instancing") == 0)
+		{
+			g_AppOptions.UseInstancing = false;
+		}
+		else if (wcscmp(argv[i], L"--gpu-culling") == 0)
+		{
+			g_AppOptions.UseGpuCulling = true;
+		}
+		else if (wcscmp(argv[i], L"--occlusion-culling") == 0)
+		{
+			g_AppOptions.UseOcclusionCulling = true;
+		}
+		else if (wcscmp(argv[i], L"--occlusion-benchmark") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.OcclusionBenchmarkBlocks = static_cast<UINT>(_wtoi(argv[++i]));
+		}
+		else if (wcscmp(argv[i], L"--software-render") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.SoftwareRenderPath = argv[++i];
+		}
+		else if (wcscmp(argv[i], L"--software-reference") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.SoftwareReferencePath = argv[++i];
+		}
+		else if (wcscmp(argv[i], L"--lights") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.PointLightCount = static_cast<UINT>(_wtoi(argv[++i]));
+		}
+		else if (wcscmp(argv[i], L"--light-benchmark") == 0)
+		{
+			g_AppOptions.RunLightBenchmark = true;
+		}
+		else if (wcscmp(argv[i], L"--scene-graph-benchmark") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.SceneGraphBenchmarkNodes = static_cast<UINT>(_wtoi(argv[++i]));
+		}
+		else if (wcscmp(argv[i], L"--entity-benchmark") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.EntityBenchmarkCount = static_cast<UINT>(_wtoi(argv[++i]));
+		}
+		else if (wcscmp(argv[i], L"--sort-benchmark") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.SortBenchmarkDraws = static_cast<UINT>(_wtoi(argv[++i]));
+		}
+		else if (wcscmp(argv[i], L"--null-frame") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.NullFrameMeshes = static_cast<UINT>(_wtoi(argv[++i]));
+		}
+		else if (wcscmp(argv[i], L"--state-tracker-test") == 0)
+		{
+			g_AppOptions.RunStateTrackerTest = true;
+		}
+		else if (wcscmp(argv[i], L"--frame-pacer-test") == 0)
+		{
+			g_AppOptions.RunFramePacerTest = true;
+		}
+		else if (wcscmp(argv[i], L"--frame-scheduler-test") == 0)
+		{
+			g_AppOptions.RunFrameSchedulerTest = true;
+		}
+		else if (wcscmp(argv[i], L"--pipeline-key-test") == 0)
+		{
+			g_AppOptions.RunPipelineKeyTest = true;
+		}
+		else if (wcscmp(argv[i], L"--command-list-filter-test") == 0)
+		{
+			g_AppOptions.RunCommandListFilterTest = true;
+		}
+		else if (wcscmp(argv[i], L"--render-graph-test") == 0)
+		{
+			g_AppOptions.RunRenderGraphTest = true;
+		}
+		else if (wcscmp(argv[i], L"--benchmark-test") == 0)
+		{
+			g_AppOptions.RunBenchmarkTest = true;
+		}
+		else if (wcscmp(argv[i], L"--draw-partitioner-test") == 0)
+		{
+			g_AppOptions.RunDrawPartitionerTest = true;
+		}
+		else if (wcscmp(argv[i], L"--shader-key-test") == 0)
+		{
+			g_AppOptions.RunShaderKeyTest = true;
+		}
+		else if (wcscmp(argv[i], L"--bake-simulation") == 0)
+		{
+			g_AppOptions.RunBakeSimulation = true;
+		}
+		else if (wcscmp(argv[i], L"--profile") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.ProfilePath = argv[++i];
+		}
+		else if (wcscmp(argv[i], L"--profile-frames") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.ProfileFrames = static_cast<UINT>(_wtoi(argv[++i]));
+		}
+		else if (wcscmp(argv[i], L"--profile-test") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.ProfileTestPath = argv[++i];
+		}
+		else if (wcscmp(argv[i], L"--stats") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.StatsPath = argv[++i];
+		}
+		else if (wcscmp(argv[i], L"--stats-test") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.StatsTestPath = argv[++i];
+		}
+		else if (wcscmp(argv[i], L"--stats-monitor") == 0)
+		{
+			g_AppOptions.RunStatsMonitor = true;
+		}
+		else if (wcscmp(argv[i], L"--benchmark") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.BenchmarkPath = argv[++i];
+		}
+		else if (wcscmp(argv[i], L"--benchmark-baseline") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.BenchmarkBaseline = argv[++i];
+		}
+		else if (wcscmp(argv[i], L"--benchmark-threshold") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.BenchmarkThreshold = _wtof(argv[++i]);
+		}
+		else if (wcscmp(argv[i], L"--benchmark-filter") == 0 && i + 1 < argc)
+		{
+			g_AppOptions.BenchmarkFilter = argv[++i];
+		}
+	}
+
 	StartApp(L"DirectXShaders");
-	return 0;
-}
\ No newline at end of file
+	return g_ExitCode;
+}
+#else
+#include <string.h>
+#include "BakeScheduler.h"
+#include "Benchmark.h"
+#include "ClusteredLighting.h"
+#include "CommandListFilter.h"
+#include "DrawPartitioner.h"
+#include "DrawQueue.h"
+#include "EntityWorld.h"
+#include "FramePacer.h"
+#include "FrameScheduler.h"
+#include "FrameStats.h"
+#include "HeadlessFrame.h"
+#include "JobSystem.h"
+#include "OcclusionCuller.h"
+#include "PipelineKey.h"
+#include "Profiler.h"
+#include "RenderGraph.h"
+#include "ResourceStateTracker.h"
+#include "SceneGraph.h"
+#include "ShaderKey.h"
+#include "SoftwareRenderer.h"
+
+// D3D12の無い環境では、ヌルのバックエンドでフレームを記録するか、CPUの処理を計測するだけ
+int main(int argc, char* argv[])
+{
+	uint32_t meshCount = 1000;
+	uint32_t frameCount = 300;
+	uint32_t recordThreads = 4;
+	uint32_t movingObjects = 0;
+	uint32_t jobThreads = 0;
+	uint32_t jobStressRounds = 0;
+	uint32_t sortDraws = 0;
+	const char* benchmarkPath = "";
+	const char* benchmarkBaseline = "";
+	double benchmarkThreshold = 10.0;
+	const char* benchmarkFilter = "";
+	uint32_t occlusionBlocks = 0;
+	const char* softwareRenderPath = "";
+	const char* profileTestPath = "";
+	const char* statsTestPath = "";
+	const char* softwareReferencePath = "";
+	bool lightBenchmark = false;
+	uint32_t sceneGraphNodes = 0;
+	uint32_t entityCount = 0;
+	bool stateTrackerTest = false;
+	bool framePacerTest = false;
+	bool frameSchedulerTest = false;
+	bool pipelineKeyTest = false;
+	bool bakeSimulation = false;
+	bool commandListFilterTest = false;
+	bool renderGraphTest = false;
+	bool benchmarkTest = false;
+	bool drawPartitionerTest = false;
+	bool shaderKeyTest = false;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--null-frame") == 0 && i + 1 < argc)
+		{
+			meshCount = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			frameCount = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--record-threads") == 0 && i + 1 < argc)
+		{
+			recordThreads = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--moving-objects") == 0 && i + 1 < argc)
+		{
+			movingObjects = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--job-threads") == 0 && i + 1 < argc)
+		{
+			jobThreads = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--job-stress") == 0 && i + 1 < argc)
+		{
+			jobStressRounds = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--sort-benchmark") == 0 && i + 1 < argc)
+		{
+			sortDraws = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--occlusion-benchmark") == 0 && i + 1 < argc)
+		{
+			occlusionBlocks = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--profile-test") == 0 && i + 1 < argc)
+		{
+			profileTestPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--stats-test") == 0 && i + 1 < argc)
+		{
+			statsTestPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--software-render") == 0 && i + 1 < argc)
+		{
+			softwareRenderPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--software-reference") == 0 && i + 1 < argc)
+		{
+			softwareReferencePath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--scene-graph-benchmark") == 0 && i + 1 < argc)
+		{
+			sceneGraphNodes = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--entity-benchmark") == 0 && i + 1 < argc)
+		{
+			entityCount = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--state-tracker-test") == 0)
+		{
+			stateTrackerTest = true;
+		}
+		else if (strcmp(argv[i], "--frame-pacer-test") == 0)
+		{
+			framePacerTest = true;
+		}
+		else if (strcmp(argv[i], "--frame-scheduler-test") == 0)
+		{
+			frameSchedulerTest = true;
+		}
+		else if (strcmp(argv[i], "--pipeline-key-test") == 0)
+		{
+			pipelineKeyTest = true;
+		}
+		else if (strcmp(argv[i], "--bake-simulation") == 0)
+		{
+			bakeSimulation = true;
+		}
+		else if (strcmp(argv[i], "--command-list-filter-test") == 0)
+		{
+			commandListFilterTest = true;
+		}
+		else if (strcmp(argv[i], "--render-graph-test") == 0)
+		{
+			renderGraphTest = true;
+		}
+		else if (strcmp(argv[i], "--benchmark-test") == 0)
+		{
+			benchmarkTest = true;
+		}
+		else if (strcmp(argv[i], "--draw-partitioner-test") == 0)
+		{
+			drawPartitionerTest = true;
+		}
+		else if (strcmp(argv[i], "--shader-key-test") == 0)
+		{
+			shaderKeyTest = true;
+		}
+		else if (strcmp(argv[i], "--light-benchmark") == 0)
+		{
+			lightBenchmark = true;
+		}
+		else if (strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc)
+		{
+			benchmarkPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--benchmark-baseline") == 0 && i + 1 < argc)
+		{
+			benchmarkBaseline = argv[++i];
+		}
+		else if (strcmp(argv[i], "--benchmark-threshold") == 0 && i + 1 < argc)
+		{
+			benchmarkThreshold = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--benchmark-filter") == 0 && i + 1 < argc)
+		{
+			benchmarkFilter = argv[++i];
+		}
+	}
+
+	g_JobSystem = new JobSystem();
+	g_JobSystem->Init(jobThreads);
+	printf("ジョブシステム: %uスレッド\n", g_JobSystem->WorkerCount());
+
+	bool passed = false;
+	if (stateTrackerTest)
+	{
+		passed = BasicResourceStateTracker<NullBackend>::RunTest();
+	}
+	else if (framePacerTest)
+	{
+		passed = FramePacer::RunTest();
+	}
+	else if (frameSchedulerTest)
+	{
+		passed = FrameScheduler::RunTest();
+	}
+	else if (pipelineKeyTest)
+	{
+		passed = PipelineKey::RunTest();
+	}
+	else if (commandListFilterTest)
+	{
+		passed = CommandListFilter<NullCommandList>::RunTest();
+	}
+	else if (renderGraphTest)
+	{
+		passed = RenderGraph::RunTest();
+	}
+	else if (benchmarkTest)
+	{
+		passed = Benchmark::RunTest();
+	}
+	else if (drawPartitionerTest)
+	{
+		passed = DrawPartitioner::RunTest();
+	}
+	else if (shaderKeyTest)
+	{
+		passed = ShaderKey::RunTest();
+	}
+	else if (jobStressRounds > 0)
+	{
+		passed = g_JobSystem->RunStressTest(jobStressRounds);
+	}
+	else if (profileTestPath[0] != '\0')
+	{
+		passed = Profiler::RunHeadlessTest(profileTestPath);
+	}
+	else if (statsTestPath[0] != '\0')
+	{
+		passed = FrameStats::RunHeadlessTest(statsTestPath);
+	}
+	else if (bakeSimulation)
+	{
+		passed = BakeScheduler::RunSimulation();
+	}
+	else if (sortDraws > 0)
+	{
+		DrawQueue::RunBenchmark(sortDraws);
+		passed = true;
+	}
+	else if (occlusionBlocks > 0)
+	{
+		passed = OcclusionCuller::RunBenchmark(occlusionBlocks, 20);
+	}
+	else if (softwareRenderPath[0] != '\0' || softwareReferencePath[0] != '\0')
+	{
+		passed = SoftwareRenderer::RunHeadless(softwareRenderPath, softwareReferencePath, 10);
+	}
+	else if (sceneGraphNodes > 0)
+	{
+		passed = SceneGraph::RunBenchmark(sceneGraphNodes, 10);
+	}
+	else if (entityCount > 0)
+	{
+		passed = EntityWorld::RunBenchmark(entityCount, 10);
+	}
+	else if (lightBenchmark)
+	{
+		passed = ClusteredLighting::RunBenchmark(10);
+	}
+	else if (benchmarkPath[0] != '\0' || benchmarkBaseline[0] != '\0')
+	{
+		passed = Benchmark::RunSuite(benchmarkPath, benchmarkBaseline, benchmarkThreshold / 100.0, benchmarkFilter);
+	}
+	else
+	{
+		passed = HeadlessFrame::RunBenchmark(meshCount, frameCount, recordThreads, movingObjects);
+	}
+
+	g_JobSystem->Shutdown();
+	delete g_JobSystem;
+	g_JobSystem = nullptr;
+	return passed ? 0 : 1;
+}
+#endif
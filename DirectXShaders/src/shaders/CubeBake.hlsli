@@ -0,0 +1,46 @@
+#ifndef CUBE_BAKE_HLSLI
+#define CUBE_BAKE_HLSLI
+
+cbuffer BakeParams : register(b0)
+{
+    uint Size;
+    float Roughness;
+    uint SampleCount;
+    uint Padding;
+};
+
+TextureCube Environment : register(t0);
+RWTexture2DArray<float4> Output : register(u0);
+SamplerState LinearSampler : register(s0);
+
+static const float PI = 3.14159265359;
+
+float3 CubeDirection(uint3 id)
+{
+    float2 uv = (float2(id.xy) + 0.5) / float(Size) * 2.0 - 1.0;
+    float3 dir;
+    switch (id.z)
+    {
+    case 0:
+        dir = float3(1.0, -uv.y, -uv.x);
+        break;
+    case 1:
+        dir = float3(-1.0, -uv.y, uv.x);
+        break;
+    case 2:
+        dir = float3(uv.x, 1.0, uv.y);
+        break;
+    case 3:
+        dir = float3(uv.x, -1.0, -uv.y);
+        break;
+    case 4:
+        dir = float3(uv.x, -uv.y, 1.0);
+        break;
+    default:
+        dir = float3(-uv.x, -uv.y, -1.0);
+        break;
+    }
+    return normalize(dir);
+}
+
+#endif
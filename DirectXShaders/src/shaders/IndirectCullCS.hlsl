@@ -0,0 +1,55 @@
+#include "../../includes/IndirectCull.hlsli"
+
+cbuffer CullParams : register(b0)
+{
+    CullConstants Cull;
+};
+
+StructuredBuffer<CullObject> Objects : register(t0);
+RWStructuredBuffer<uint> Commands : register(u0);
+RWStructuredBuffer<uint> DrawCount : register(u1);
+
+groupshared uint Offsets[CULL_GROUP_SIZE];
+
+[numthreads(CULL_GROUP_SIZE, 1, 1)]
+void main(uint index : SV_GroupIndex)
+{
+    uint written = 0;
+    for (uint base = 0; base < Cull.ObjectCount; base += CULL_GROUP_SIZE)
+    {
+        uint objectIndex = base + index;
+        bool visible = false;
+        if (objectIndex < Cull.ObjectCount)
+        {
+            visible = IsSphereVisible(Cull, Objects[objectIndex].Sphere);
+        }
+
+        Offsets[index] = visible ? 1 : 0;
+        GroupMemoryBarrierWithGroupSync();
+
+        for (uint stride = 1; stride < CULL_GROUP_SIZE; stride *= 2)
+        {
+            uint value = index >= stride ? Offsets[index - stride] : 0;
+            GroupMemoryBarrierWithGroupSync();
+            Offsets[index] += value;
+            GroupMemoryBarrierWithGroupSync();
+        }
+
+        if (visible)
+        {
+            uint slot = written + Offsets[index] - 1;
+            for (uint word = 0; word < COMMAND_WORDS; word++)
+            {
+                Commands[slot * COMMAND_WORDS + word] = Objects[objectIndex].Command[word];
+            }
+        }
+
+        written += Offsets[CULL_GROUP_SIZE - 1];
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    if (index == 0)
+    {
+        DrawCount[0] = written;
+    }
+}
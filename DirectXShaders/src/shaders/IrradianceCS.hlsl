@@ -0,0 +1,31 @@
+#include "CubeBake.hlsli"
+
+[numthreads(8, 8, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= Size || id.y >= Size)
+    {
+        return;
+    }
+
+    float3 normal = CubeDirection(id);
+    float3 up = abs(normal.y) < 0.999 ? float3(0.0, 1.0, 0.0) : float3(0.0, 0.0, 1.0);
+    float3 right = normalize(cross(up, normal));
+    up = cross(normal, right);
+
+    float3 irradiance = 0.0;
+    float sampleCount = 0.0;
+    const float delta = 0.05;
+    for (float phi = 0.0; phi < 2.0 * PI; phi += delta)
+    {
+        for (float theta = 0.0; theta < 0.5 * PI; theta += delta)
+        {
+            float3 tangentSample = float3(sin(theta) * cos(phi), sin(theta) * sin(phi), cos(theta));
+            float3 sampleDir = tangentSample.x * right + tangentSample.y * up + tangentSample.z * normal;
+            irradiance += Environment.SampleLevel(LinearSampler, sampleDir, 0).rgb * cos(theta) * sin(theta);
+            sampleCount += 1.0;
+        }
+    }
+
+    Output[id] = float4(PI * irradiance / sampleCount, 1.0);
+}
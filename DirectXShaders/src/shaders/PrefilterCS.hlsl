@@ -0,0 +1,48 @@
+#include "CubeBake.hlsli"
+
+float2 Hammersley(uint i, uint count)
+{
+    return float2(float(i) / float(count), float(reversebits(i)) * 2.3283064365386963e-10);
+}
+
+float3 ImportanceSampleGGX(float2 xi, float3 normal, float roughness)
+{
+    float a = roughness * roughness;
+    float phi = 2.0 * PI * xi.x;
+    float cosTheta = sqrt((1.0 - xi.y) / (1.0 + (a * a - 1.0) * xi.y));
+    float sinTheta = sqrt(1.0 - cosTheta * cosTheta);
+    float3 h = float3(cos(phi) * sinTheta, sin(phi) * sinTheta, cosTheta);
+
+    float3 up = abs(normal.z) < 0.999 ? float3(0.0, 0.0, 1.0) : float3(1.0, 0.0, 0.0);
+    float3 tangent = normalize(cross(up, normal));
+    float3 bitangent = cross(normal, tangent);
+    return normalize(tangent * h.x + bitangent * h.y + normal * h.z);
+}
+
+[numthreads(8, 8, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= Size || id.y >= Size)
+    {
+        return;
+    }
+
+    float3 normal = CubeDirection(id);
+    float3 view = normal;
+
+    float3 color = 0.0;
+    float weight = 0.0;
+    for (uint i = 0; i < SampleCount; i++)
+    {
+        float3 h = ImportanceSampleGGX(Hammersley(i, SampleCount), normal, Roughness);
+        float3 l = normalize(2.0 * dot(view, h) * h - view);
+        float nl = saturate(dot(normal, l));
+        if (nl > 0.0)
+        {
+            color += Environment.SampleLevel(LinearSampler, l, 0).rgb * nl;
+            weight += nl;
+        }
+    }
+
+    Output[id] = float4(color / max(weight, 0.0001), 1.0);
+}
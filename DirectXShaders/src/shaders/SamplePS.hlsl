@@ -6,10 +6,19 @@ struct VSOutput
     float2 uv : TEXCOORD;
 };
 
+cbuffer MaterialConstants : register(b3)
+{
+    uint MaterialIndex;
+};
+
 SamplerState smp : register(s0);
-Texture2D _MainTex : register(t0);
+// same material table as PBR.hlsl (size defaults to HANDLE_MAX)
+#ifndef MATERIAL_TABLE_SIZE
+#define MATERIAL_TABLE_SIZE 512
+#endif
+Texture2D _Textures[MATERIAL_TABLE_SIZE] : register(t0, space1);
 
 float4 frag(VSOutput input) : SV_TARGET
 {
-    return _MainTex.Sample(smp, input.uv);
+    return _Textures[MaterialIndex].Sample(smp, input.uv);
 }
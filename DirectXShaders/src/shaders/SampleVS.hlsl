@@ -6,6 +6,22 @@ cbuffer Transform : register(b0)
     float4x4 WorldInverseTranspose;
 }
 
+struct InstanceData
+{
+    float4 World[3];
+    float4 WorldInverseTranspose[3];
+};
+
+// persistent per-object constants indexed by object; only changed objects are copied from the CPU
+StructuredBuffer<InstanceData> Instances : register(t0, space2);
+// object index per instance, in batch order
+StructuredBuffer<uint> InstanceObjects : register(t3, space2);
+
+cbuffer InstanceBase : register(b4)
+{
+    uint FirstInstance;
+};
+
 struct VSInput
 {
     float3 pos : POSITION;
@@ -24,19 +40,29 @@ struct VSOutput
     float4 pos : TEXCOORD1;
 };
 
-VSOutput vert(VSInput input)
+VSOutput vert(VSInput input, uint instanceID : SV_InstanceID)
 {
     VSOutput output;
     
+    InstanceData instance = Instances[InstanceObjects[FirstInstance + instanceID]];
+    
     float4 localPos = float4(input.pos, 1.0f);
-    float4 worldPos = mul(World, localPos);
+    float4 worldPos = float4(
+        dot(instance.World[0], localPos),
+        dot(instance.World[1], localPos),
+        dot(instance.World[2], localPos),
+        1.0f);
     float4 viewPos = mul(View, worldPos);
     float4 projPos = mul(Proj, viewPos);
     
     output.svpos = projPos;
     
     float4 localNormal = float4(input.normal, 0.0);
-    float4 worldNormal = mul(WorldInverseTranspose, localNormal);
+    float4 worldNormal = float4(
+        dot(instance.WorldInverseTranspose[0], localNormal),
+        dot(instance.WorldInverseTranspose[1], localNormal),
+        dot(instance.WorldInverseTranspose[2], localNormal),
+        0.0);
     
     output.normal = normalize(worldNormal); 
     output.color = input.color;